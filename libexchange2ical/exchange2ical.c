@@ -591,20 +591,232 @@ static uint8_t exchange2ical_exception_from_EmbeddedObj(struct exchange2ical *ex
 	return 0;	
 }
 
+/* Appointment properties read as contents table columns, PR_FID and
+   PR_MID first */
+static struct SPropTagArray *exchange2ical_columns(TALLOC_CTX *mem_ctx)
+{
+	return set_SPropTagArray(mem_ctx, 0x30,
+				 PR_FID,
+				 PR_MID,
+				 PidLidGlobalObjectId,
+				 PidNameKeywords,
+				 PidLidRecurring,
+				 PidLidAppointmentStateFlags,
+				 PidLidTimeZoneDescription,
+				 PidLidTimeZoneStruct,
+				 PidLidContacts,
+				 PidLidAppointmentStartWhole,
+				 PidLidAppointmentEndWhole,
+				 PidLidAppointmentSubType,
+				 PidLidOwnerCriticalChange,
+				 PidLidLocation,
+				 PidLidNonSendableBcc,
+				 PidLidAppointmentSequence,
+				 PidLidBusyStatus,
+				 PidLidIntendedBusyStatus,
+				 PidLidAttendeeCriticalChange,
+				 PidLidAppointmentReplyTime,
+				 PidLidAppointmentNotAllowPropose,
+				 PidLidAllowExternalCheck,
+				 PidLidAppointmentLastSequence,
+				 PidLidAppointmentSequenceTime,
+				 PidLidAutoFillLocation,
+				 PidLidAutoStartCheck,
+				 PidLidCollaborateDoc,
+				 PidLidConferencingCheck,
+				 PidLidConferencingType,
+				 PidLidDirectory,
+				 PidLidMeetingWorkspaceUrl,
+				 PidLidNetShowUrl,
+				 PidLidOnlinePassword,
+				 PidLidOrganizerAlias,
+				 PidLidReminderSet,
+				 PidLidReminderDelta,
+				 PidLidResponseStatus,
+				 PR_MESSAGE_CLASS_UNICODE,
+				 PR_SENSITIVITY,
+				 PR_CREATION_TIME,
+				 PR_LAST_MODIFICATION_TIME,
+				 PR_IMPORTANCE,
+				 PR_RESPONSE_REQUESTED,
+				 PR_SUBJECT_UNICODE,
+				 PR_OWNER_APPT_ID,
+				 PR_SENDER_NAME,
+				 PR_SENDER_EMAIL_ADDRESS,
+				 PR_MESSAGE_LOCALE_ID);
+}
+
+/* Appointment properties truncated in tables, read from the message */
+static struct SPropTagArray *exchange2ical_message_props(TALLOC_CTX *mem_ctx)
+{
+	return set_SPropTagArray(mem_ctx, 0x3,
+				 PR_BODY_UNICODE,
+				 PR_BODY_HTML_UNICODE,
+				 PidLidAppointmentRecur);
+}
+
+/* Map the canonical named property tags of properties to the IDs of
+   the store, with a single GetIDsFromNames call */
+static struct SPropTagArray *exchange2ical_map_properties(TALLOC_CTX *mem_ctx, mapi_object_t *obj,
+							   struct SPropTagArray *properties)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_nameid	*nameid;
+	struct SPropTagArray	*SPropTagArray;
+	struct SPropTagArray	*mapped;
+
+	mapped = talloc_zero(mem_ctx, struct SPropTagArray);
+	if (!mapped) return NULL;
+	mapped->cValues = properties->cValues;
+	mapped->aulPropTag = talloc_memdup(mapped, properties->aulPropTag,
+					   properties->cValues * sizeof (enum MAPITAGS));
+
+	nameid = mapi_nameid_new(mem_ctx);
+	if (mapi_nameid_lookup_SPropTagArray(nameid, mapped) == MAPI_E_SUCCESS) {
+		SPropTagArray = talloc_zero(nameid, struct SPropTagArray);
+		retval = GetIDsFromNames(obj, nameid->count, nameid->nameid, 0, &SPropTagArray);
+		if (retval != MAPI_E_SUCCESS && retval != MAPI_W_ERRORS_RETURNED) {
+			talloc_free(nameid);
+			talloc_free(mapped);
+			return NULL;
+		}
+		mapi_nameid_map_SPropTagArray(nameid, mapped, SPropTagArray);
+	}
+	talloc_free(nameid);
+
+	return mapped;
+}
+
+static enum MAPISTATUS exchange2ical_properties_init(TALLOC_CTX *mem_ctx, mapi_object_t *obj_folder,
+						     struct exchange2ical_properties *properties)
+{
+	properties->columns = exchange2ical_columns(mem_ctx);
+	properties->mapped_columns = exchange2ical_map_properties(mem_ctx, obj_folder, properties->columns);
+	properties->message_props = exchange2ical_message_props(mem_ctx);
+	properties->mapped_message_props = exchange2ical_map_properties(mem_ctx, obj_folder, properties->message_props);
+
+	if (!properties->mapped_columns || !properties->mapped_message_props) {
+		return MAPI_E_CALL_FAILED;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/* Restore the canonical tags of a row read with mapped property tags,
+   keeping the type of the values so errors stay errors */
+static void exchange2ical_unmap_row(struct SRow *aRow, struct SPropTagArray *properties)
+{
+	uint32_t	i;
+
+	for (i = 0; i < aRow->cValues && i < properties->cValues; i++) {
+		aRow->lpProps[i].ulPropTag = (enum MAPITAGS)((properties->aulPropTag[i] & 0xFFFF0000) |
+							     (aRow->lpProps[i].ulPropTag & 0xFFFF));
+	}
+}
+
+/* Add an appointment and its exceptions to exchange2ical->vcalendar,
+   from the row of its properties read in the contents table */
+static int exchange2ical_appointment(struct exchange2ical *exchange2ical,
+				     struct exchange2ical_check *exchange2ical_check,
+				     mapi_object_t *obj_folder,
+				     struct exchange2ical_properties *properties,
+				     struct SRow *aRow)
+{
+	TALLOC_CTX		*mem_ctx = exchange2ical->mem_ctx;
+	enum MAPISTATUS		retval;
+	int			ret;
+	struct SRow		aRowAll;
+	struct SPropValue	*lpProps = NULL;
+	uint32_t		count = 0;
+
+	/*Get Vcal info if first event*/
+	if (!exchange2ical->vcalendar) {
+		ret = exchange2ical_get_properties(mem_ctx, aRow, exchange2ical, VcalFlag);
+		/*TODO: exit nicely*/
+		ical_component_VCALENDAR(exchange2ical);
+	}
+
+	/*Get required properties to check if right event*/
+	ret = exchange2ical_get_properties(mem_ctx, aRow, exchange2ical, exchange2ical_check->eFlags);
+
+	/*Check to see if event is acceptable*/
+	if (!checkEvent(exchange2ical, exchange2ical_check, get_tm_from_FILETIME(exchange2ical->apptStartWhole))) {
+		exchange2ical_reset(exchange2ical);
+		return 0;
+	}
+
+	mapi_object_init(&exchange2ical->obj_message);
+	retval = OpenMessage(obj_folder, aRow->lpProps[0].value.d, aRow->lpProps[1].value.d,
+			     &exchange2ical->obj_message, 0);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_object_release(&exchange2ical->obj_message);
+		exchange2ical_reset(exchange2ical);
+		return -1;
+	}
+
+	/*Set RecipientTable*/
+	retval = GetRecipientTable(&exchange2ical->obj_message,
+				   &exchange2ical->Recipients.SRowSet,
+				   &exchange2ical->Recipients.SPropTagArray);
+
+	/*Add the body, PR_BODY_HTML for x_alt_desc and the recurrence to the row*/
+	aRowAll = *aRow;
+	retval = GetProps(&exchange2ical->obj_message, MAPI_UNICODE | MAPI_PROPS_SKIP_NAMEDID_CHECK,
+			  properties->mapped_message_props, &lpProps, &count);
+	if (retval == MAPI_E_SUCCESS && count) {
+		struct SRow	aRowT;
+
+		aRowT.ulAdrEntryPad = 0;
+		aRowT.cValues = count;
+		aRowT.lpProps = lpProps;
+		exchange2ical_unmap_row(&aRowT, properties->message_props);
+
+		aRowAll.cValues = aRow->cValues + count;
+		aRowAll.lpProps = talloc_array(mem_ctx, struct SPropValue, aRowAll.cValues);
+		memcpy(aRowAll.lpProps, aRow->lpProps, aRow->cValues * sizeof (struct SPropValue));
+		memcpy(aRowAll.lpProps + aRow->cValues, lpProps, count * sizeof (struct SPropValue));
+	}
+	exchange2ical->bodyHTML = (const char *)octool_get_propval(&aRowAll, PR_BODY_HTML_UNICODE);
+
+	/*Get rest of properties*/
+	ret = exchange2ical_get_properties(mem_ctx, &aRowAll, exchange2ical, (exchange2ical_check->eFlags | EntireFlag));
+
+	/*add new vevent*/
+	ical_component_VEVENT(exchange2ical);
+
+	/*Exceptions to event*/
+	if (exchange2ical_check->eFlags != EventFlag) {
+		ret = exchange2ical_exception_from_EmbeddedObj(exchange2ical, exchange2ical_check);
+		if (ret) {
+			ret = exchange2ical_exception_from_ExceptionInfo(exchange2ical, exchange2ical_check);
+		}
+	}
+
+	/*REMOVE once globalobjid is fixed*/
+	exchange2ical->idx++;
+
+	exchange2ical_reset(exchange2ical);
+	if (aRowAll.lpProps != aRow->lpProps) {
+		talloc_free(aRowAll.lpProps);
+	}
+	if (lpProps) {
+		MAPIFreeBuffer(lpProps);
+	}
+	mapi_object_release(&exchange2ical->obj_message);
+
+	return 0;
+}
+
 icalcomponent * _Exchange2Ical(mapi_object_t *obj_folder, struct exchange2ical_check *exchange2ical_check)
 {
 	TALLOC_CTX			*mem_ctx;
 	enum MAPISTATUS			retval;
-	int				ret;
 	struct SRowSet			SRowSet;
-	struct SRow			aRow;
-	struct SRow			aRowT;
-	struct SPropValue		*lpProps;
-	struct SPropTagArray		*SPropTagArray = NULL;
 	struct exchange2ical		exchange2ical;
+	struct exchange2ical_properties	properties;
 	mapi_object_t			obj_table;
 	uint32_t			count;
-	int				i;
+	uint32_t			i;
 
 	mem_ctx = talloc_named(mapi_object_get_session(obj_folder), 0, "exchange2ical");
 	exchange2ical_init(mem_ctx, &exchange2ical);
@@ -619,148 +831,30 @@ icalcomponent * _Exchange2Ical(mapi_object_t *obj_folder, struct exchange2ical_c
 	
 	DEBUG(0, ("MAILBOX (%d appointments)\n", count));
 	if (count == 0) {
+		mapi_object_release(&obj_table);
 		talloc_free(mem_ctx);
 		return NULL;
 	}
 
-	SPropTagArray = set_SPropTagArray(mem_ctx, 0x2,
-					  PR_FID,
-					  PR_MID);
-					  
-	retval = SetColumns(&obj_table, SPropTagArray);
-	MAPIFreeBuffer(SPropTagArray);
+	retval = exchange2ical_properties_init(mem_ctx, obj_folder, &properties);
+	if (retval == MAPI_E_SUCCESS) {
+		retval = SetColumns(&obj_table, properties.mapped_columns);
+	}
 	if (retval != MAPI_E_SUCCESS) {
 		mapi_errstr("SetColumns", retval);
+		mapi_object_release(&obj_table);
 		talloc_free(mem_ctx);
 		return NULL;
 	}
 	
-	while ((retval = QueryRows(&obj_table, count, TBL_ADVANCE, &SRowSet)) != MAPI_E_NOT_FOUND && SRowSet.cRows) {
-		count -= SRowSet.cRows;
-		for (i = (SRowSet.cRows-1); i >= 0; i--) {
-			mapi_object_init(&exchange2ical.obj_message);
-			retval = OpenMessage(obj_folder,
-					     SRowSet.aRow[i].lpProps[0].value.d,
-					     SRowSet.aRow[i].lpProps[1].value.d,
-					     &exchange2ical.obj_message, 0);
-			if (retval != MAPI_E_NOT_FOUND) {
-				SPropTagArray = set_SPropTagArray(mem_ctx, 0x30,
-								  PidLidGlobalObjectId,
-								  PidNameKeywords,
-								  PidLidRecurring,
-								  PidLidAppointmentRecur,
-								  PidLidAppointmentStateFlags,
-								  PidLidTimeZoneDescription,
-								  PidLidTimeZoneStruct,
-								  PidLidContacts,
-								  PidLidAppointmentStartWhole,
-								  PidLidAppointmentEndWhole,
-								  PidLidAppointmentSubType,
-								  PidLidOwnerCriticalChange,
-								  PidLidLocation,
-								  PidLidNonSendableBcc,
-								  PidLidAppointmentSequence,
-								  PidLidBusyStatus,
-								  PidLidIntendedBusyStatus,
-								  PidLidAttendeeCriticalChange,
-								  PidLidAppointmentReplyTime,
-								  PidLidAppointmentNotAllowPropose,
-								  PidLidAllowExternalCheck,
-								  PidLidAppointmentLastSequence,
-								  PidLidAppointmentSequenceTime,
-								  PidLidAutoFillLocation,
-								  PidLidAutoStartCheck,
-								  PidLidCollaborateDoc,
-								  PidLidConferencingCheck,
-								  PidLidConferencingType,
-								  PidLidDirectory,
-								  PidLidMeetingWorkspaceUrl,
-								  PidLidNetShowUrl,
-								  PidLidOnlinePassword,
-								  PidLidOrganizerAlias,
-								  PidLidReminderSet,
-								  PidLidReminderDelta,
-								  PidLidResponseStatus,
-								  PR_MESSAGE_CLASS_UNICODE,
-								  PR_SENSITIVITY,
-								  PR_BODY_UNICODE,
-								  PR_CREATION_TIME,
-								  PR_LAST_MODIFICATION_TIME,
-								  PR_IMPORTANCE,
-								  PR_RESPONSE_REQUESTED,
-								  PR_SUBJECT_UNICODE,
-								  PR_OWNER_APPT_ID,
-								  PR_SENDER_NAME,
-								  PR_SENDER_EMAIL_ADDRESS,
-								  PR_MESSAGE_LOCALE_ID
-								  );
-								  
-								  
-				retval = GetProps(&exchange2ical.obj_message, MAPI_UNICODE, SPropTagArray, &lpProps, &count);
-
-				MAPIFreeBuffer(SPropTagArray);
-	
-				if (retval == MAPI_E_SUCCESS) {
-					aRow.ulAdrEntryPad = 0;
-					aRow.cValues = count;
-					aRow.lpProps = lpProps;
-					
-					/*Get Vcal info if first event*/
-					if(i==(SRowSet.cRows-1)){
-						ret = exchange2ical_get_properties(mem_ctx, &aRow, &exchange2ical, VcalFlag);
-						/*TODO: exit nicely*/
-						ical_component_VCALENDAR(&exchange2ical);
-					}
-					
-					
-					/*Get required properties to check if right event*/
-					ret = exchange2ical_get_properties(mem_ctx, &aRow, &exchange2ical, exchange2ical_check->eFlags);
-					
-					/*Check to see if event is acceptable*/
-					if (!checkEvent(&exchange2ical, exchange2ical_check, get_tm_from_FILETIME(exchange2ical.apptStartWhole))){
-						continue;
-					}
-					
-					/*Set RecipientTable*/
-					retval = GetRecipientTable(&exchange2ical.obj_message, 
-							   &exchange2ical.Recipients.SRowSet,
-							   &exchange2ical.Recipients.SPropTagArray);
-					
-					/*Set PR_BODY_HTML for x_alt_desc property*/
-					SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_BODY_HTML_UNICODE);
-					retval = GetProps(&exchange2ical.obj_message, MAPI_UNICODE, SPropTagArray, &lpProps, &count);
-					MAPIFreeBuffer(SPropTagArray);
-					if (retval == MAPI_E_SUCCESS) {
-						aRowT.ulAdrEntryPad = 0;
-						aRowT.cValues = count;
-						aRowT.lpProps = lpProps;
-						exchange2ical.bodyHTML = (const char *)octool_get_propval(&aRowT, PR_BODY_HTML_UNICODE);
-					}
-					
-					/*Get rest of properties*/
-					ret = exchange2ical_get_properties(mem_ctx, &aRow, &exchange2ical, (exchange2ical_check->eFlags | EntireFlag));
-					
-					/*add new vevent*/
-					ical_component_VEVENT(&exchange2ical);
-					
-					/*Exceptions to event*/
-					if(exchange2ical_check->eFlags != EventFlag){
-						ret = exchange2ical_exception_from_EmbeddedObj(&exchange2ical, exchange2ical_check);
-						if (ret){
-							ret=exchange2ical_exception_from_ExceptionInfo(&exchange2ical, exchange2ical_check);
-						}
-					}
-					
-					/*REMOVE once globalobjid is fixed*/
-					exchange2ical.idx++;
-					
-					MAPIFreeBuffer(lpProps);
-					exchange2ical_reset(&exchange2ical);
-				}
-				
-			}
-			mapi_object_release(&exchange2ical.obj_message);
+	while ((retval = QueryRows(&obj_table, EXCHANGE2ICAL_QUERY_ROWS, TBL_ADVANCE, &SRowSet)) == MAPI_E_SUCCESS &&
+	       SRowSet.cRows) {
+		for (i = 0; i < SRowSet.cRows; i++) {
+			exchange2ical_unmap_row(&SRowSet.aRow[i], properties.columns);
+			exchange2ical_appointment(&exchange2ical, exchange2ical_check, obj_folder,
+						  &properties, &SRowSet.aRow[i]);
 		}
+		MAPIFreeBuffer(SRowSet.aRow);
 	}
 
 	icalcomponent *icalendar = exchange2ical.vcalendar;
@@ -771,3 +865,493 @@ icalcomponent * _Exchange2Ical(mapi_object_t *obj_folder, struct exchange2ical_c
 	talloc_free(mem_ctx);	
 	return icalendar;
 }
+
+/* ICS state property kept between synchronizations */
+struct exchange2ical_sync_state {
+	uint32_t	tag;
+	DATA_BLOB	data;
+};
+
+/* UID of an exported appointment, to cancel it once deleted */
+struct exchange2ical_sync_uid {
+	mapi_id_t	mid;
+	char		*uid;
+};
+
+struct exchange2ical_sync {
+	TALLOC_CTX			*mem_ctx;
+	bool				in_state;
+	uint32_t			depth;		/* attachments and embedded messages */
+	mapi_id_t			*mids;		/* changed appointments */
+	uint32_t			mid_count;
+	uint32_t			mid_size;
+	struct idset			*deleted;
+	struct exchange2ical_sync_state	*state;
+	uint32_t			state_count;
+	struct exchange2ical_sync_uid	*uids;
+	uint32_t			uid_count;
+	uint32_t			uid_sorted;	/* uids sorted by mid */
+};
+
+static int exchange2ical_mid_cmp(const void *a, const void *b)
+{
+	mapi_id_t	mid_a = *(const mapi_id_t *) a;
+	mapi_id_t	mid_b = *(const mapi_id_t *) b;
+
+	if (mid_a < mid_b) return -1;
+	return (mid_a > mid_b);
+}
+
+static int exchange2ical_uid_cmp(const void *a, const void *b)
+{
+	return exchange2ical_mid_cmp(&((const struct exchange2ical_sync_uid *) a)->mid,
+				     &((const struct exchange2ical_sync_uid *) b)->mid);
+}
+
+/*
+   Synchronization state blob: version, ICS state properties as
+   (tag, length, data) and exported appointments as (mid, length, uid)
+ */
+static enum ndr_err_code exchange2ical_sync_pull(struct ndr_pull *ndr, struct exchange2ical_sync *sync)
+{
+	uint32_t	version;
+	uint32_t	length;
+	uint32_t	i;
+
+	NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &version));
+	if (version != EXCHANGE2ICAL_SYNC_VERSION) {
+		return NDR_ERR_BAD_SWITCH;
+	}
+
+	NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &sync->state_count));
+	if (sync->state_count > ndr->data_size) {
+		return NDR_ERR_LENGTH;
+	}
+	sync->state = talloc_zero_array(sync->mem_ctx, struct exchange2ical_sync_state, sync->state_count);
+	NDR_ERR_HAVE_NO_MEMORY(sync->state);
+	for (i = 0; i < sync->state_count; i++) {
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &sync->state[i].tag));
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &length));
+		if (length > ndr->data_size - ndr->offset) {
+			return NDR_ERR_LENGTH;
+		}
+		sync->state[i].data = data_blob_talloc(sync->state, NULL, length);
+		NDR_CHECK(ndr_pull_bytes(ndr, sync->state[i].data.data, length));
+	}
+
+	NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &sync->uid_count));
+	if (sync->uid_count > ndr->data_size) {
+		return NDR_ERR_LENGTH;
+	}
+	sync->uids = talloc_zero_array(sync->mem_ctx, struct exchange2ical_sync_uid, sync->uid_count);
+	NDR_ERR_HAVE_NO_MEMORY(sync->uids);
+	for (i = 0; i < sync->uid_count; i++) {
+		NDR_CHECK(ndr_pull_hyper(ndr, NDR_SCALARS, &sync->uids[i].mid));
+		NDR_CHECK(ndr_pull_uint32(ndr, NDR_SCALARS, &length));
+		if (length > ndr->data_size - ndr->offset) {
+			return NDR_ERR_LENGTH;
+		}
+		sync->uids[i].uid = talloc_zero_array(sync->uids, char, length + 1);
+		NDR_ERR_HAVE_NO_MEMORY(sync->uids[i].uid);
+		NDR_CHECK(ndr_pull_bytes(ndr, (uint8_t *) sync->uids[i].uid, length));
+	}
+	sync->uid_sorted = sync->uid_count;
+
+	return NDR_ERR_SUCCESS;
+}
+
+static enum ndr_err_code exchange2ical_sync_push(struct ndr_push *ndr, struct exchange2ical_sync *sync)
+{
+	uint32_t	uid_count = 0;
+	uint32_t	i;
+
+	NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, EXCHANGE2ICAL_SYNC_VERSION));
+
+	NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, sync->state_count));
+	for (i = 0; i < sync->state_count; i++) {
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, sync->state[i].tag));
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, sync->state[i].data.length));
+		NDR_CHECK(ndr_push_bytes(ndr, sync->state[i].data.data, sync->state[i].data.length));
+	}
+
+	/* cancelled appointments have no uid anymore */
+	for (i = 0; i < sync->uid_count; i++) {
+		if (sync->uids[i].uid) uid_count++;
+	}
+	NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, uid_count));
+	for (i = 0; i < sync->uid_count; i++) {
+		if (!sync->uids[i].uid) continue;
+		NDR_CHECK(ndr_push_hyper(ndr, NDR_SCALARS, sync->uids[i].mid));
+		NDR_CHECK(ndr_push_uint32(ndr, NDR_SCALARS, strlen(sync->uids[i].uid)));
+		NDR_CHECK(ndr_push_bytes(ndr, (const uint8_t *) sync->uids[i].uid, strlen(sync->uids[i].uid)));
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
+static enum MAPISTATUS exchange2ical_sync_marker(uint32_t marker, void *priv)
+{
+	struct exchange2ical_sync	*sync = priv;
+
+	switch (marker) {
+	case IncrSyncChg:
+		if (sync->mid_count == sync->mid_size) {
+			sync->mid_size = sync->mid_size ? sync->mid_size * 2 : 256;
+			sync->mids = talloc_realloc(sync->mem_ctx, sync->mids, mapi_id_t, sync->mid_size);
+			if (!sync->mids) return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		sync->mids[sync->mid_count++] = 0;
+		sync->depth = 0;
+		break;
+	case NewAttach:
+	case StartEmbed:
+		sync->depth++;
+		break;
+	case EndAttach:
+	case EndEmbed:
+		if (sync->depth) sync->depth--;
+		break;
+	case IncrSyncStateBegin:
+		sync->in_state = true;
+		break;
+	case IncrSyncStateEnd:
+		sync->in_state = false;
+		break;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS exchange2ical_sync_property(struct SPropValue prop, void *priv)
+{
+	struct exchange2ical_sync	*sync = priv;
+	struct exchange2ical_sync_state	*state;
+	struct idset			*deleted;
+	struct idset			*last;
+	DATA_BLOB			data;
+	uint32_t			tag = prop.ulPropTag;
+
+	if (sync->in_state) {
+		/* some servers send MetaTagIdsetGiven with a binary type */
+		if ((tag >> 16) == (MetaTagIdsetGiven >> 16)) {
+			tag = MetaTagIdsetGiven;
+		}
+		if (tag != MetaTagIdsetGiven && tag != MetaTagCnsetSeen &&
+		    tag != MetaTagCnsetSeenFAI && tag != MetaTagCnsetRead) {
+			return MAPI_E_SUCCESS;
+		}
+
+		sync->state = talloc_realloc(sync->mem_ctx, sync->state, struct exchange2ical_sync_state,
+					     sync->state_count + 1);
+		if (!sync->state) return MAPI_E_NOT_ENOUGH_MEMORY;
+
+		state = &sync->state[sync->state_count];
+		state->tag = tag;
+		state->data = data_blob_talloc(sync->state, prop.value.bin.lpb, prop.value.bin.cb);
+		sync->state_count++;
+		return MAPI_E_SUCCESS;
+	}
+
+	if (tag == MetaTagIdsetDeleted) {
+		/* deleted IDs are REPLID-based [MS-OXCFXICS 2.2.4.3.2] */
+		data.data = prop.value.bin.lpb;
+		data.length = prop.value.bin.cb;
+		deleted = IDSET_parse(sync->mem_ctx, data, true);
+		if (deleted) {
+			for (last = deleted; last->next; last = last->next);
+			last->next = sync->deleted;
+			sync->deleted = deleted;
+		}
+		return MAPI_E_SUCCESS;
+	}
+
+	if (tag == PR_MID && sync->mid_count && !sync->depth) {
+		sync->mids[sync->mid_count - 1] = prop.value.d;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/* Configure an ICS contents synchronization of the folder from the
+   previous state, and collect the changed and deleted appointments
+   along with the new state */
+static enum MAPISTATUS exchange2ical_sync_download(mapi_object_t *obj_folder, struct exchange2ical_sync *sync)
+{
+	enum MAPISTATUS			retval;
+	mapi_object_t			obj_sync_context;
+	struct SPropTagArray		*SPropTagArray;
+	struct fx_parser_context	*parser;
+	struct exchange2ical_sync_state	*state = sync->state;
+	uint32_t			state_count = sync->state_count;
+	DATA_BLOB			restriction;
+	DATA_BLOB			transfer_data;
+	enum TransferStatus		transfer_status;
+	uint16_t			progress;
+	uint16_t			total_steps;
+	uint32_t			i;
+
+	/* the appointments are read afterwards from the contents table */
+	mapi_object_init(&obj_sync_context);
+	SPropTagArray = set_SPropTagArray(sync->mem_ctx, 0x1, PR_MID);
+	restriction.length = 0;
+	restriction.data = NULL;
+	retval = ICSSyncConfigure(obj_folder, Contents, FastTransfer_Unicode,
+				  SynchronizationFlag_Unicode | SynchronizationFlag_Normal |
+				  SynchronizationFlag_OnlySpecifiedProperties,
+				  Eid | Cn, restriction, SPropTagArray, &obj_sync_context);
+	MAPIFreeBuffer(SPropTagArray);
+	if (retval != MAPI_E_SUCCESS) goto end;
+
+	for (i = 0; i < state_count; i++) {
+		retval = ICSSyncUploadStateBegin(&obj_sync_context, (enum StateProperty) state[i].tag,
+						 state[i].data.length);
+		if (retval != MAPI_E_SUCCESS) goto end;
+		retval = ICSSyncUploadStateContinue(&obj_sync_context, state[i].data);
+		if (retval != MAPI_E_SUCCESS) goto end;
+		retval = ICSSyncUploadStateEnd(&obj_sync_context);
+		if (retval != MAPI_E_SUCCESS) goto end;
+	}
+
+	/* the server sends the whole new state */
+	sync->state = NULL;
+	sync->state_count = 0;
+
+	parser = fxparser_init(sync->mem_ctx, sync);
+	fxparser_set_marker_callback(parser, exchange2ical_sync_marker);
+	fxparser_set_property_callback(parser, exchange2ical_sync_property);
+
+	do {
+		retval = FXGetBuffer(&obj_sync_context, 0, &transfer_status, &progress, &total_steps, &transfer_data);
+		if (retval != MAPI_E_SUCCESS) break;
+		retval = fxparser_parse(parser, &transfer_data);
+		if (retval != MAPI_E_SUCCESS) break;
+	} while ((transfer_status == TransferStatus_Partial) || (transfer_status == TransferStatus_NoRoom));
+
+	talloc_free(parser);
+	talloc_free(state);
+
+end:
+	mapi_object_release(&obj_sync_context);
+
+	return retval;
+}
+
+/* Restrict the contents table to the changed appointments, unless
+   there are too many of them to be worth it */
+static enum MAPISTATUS exchange2ical_sync_restrict(mapi_object_t *obj_table, struct exchange2ical_sync *sync)
+{
+	enum MAPISTATUS			retval;
+	struct mapi_SRestriction	res;
+	uint32_t			i;
+
+	if (sync->mid_count > EXCHANGE2ICAL_SYNC_RESTRICT_MAX) {
+		return MAPI_E_SUCCESS;
+	}
+
+	res.rt = RES_OR;
+	res.res.resOr.cRes = sync->mid_count;
+	res.res.resOr.res = talloc_array(sync->mem_ctx, struct mapi_SRestriction_or, sync->mid_count);
+	OPENCHANGE_RETVAL_IF(!res.res.resOr.res, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	for (i = 0; i < sync->mid_count; i++) {
+		res.res.resOr.res[i].rt = RES_PROPERTY;
+		res.res.resOr.res[i].res.resProperty.relop = RELOP_EQ;
+		res.res.resOr.res[i].res.resProperty.ulPropTag = PR_MID;
+		res.res.resOr.res[i].res.resProperty.lpProp.ulPropTag = PR_MID;
+		res.res.resOr.res[i].res.resProperty.lpProp.value.d = sync->mids[i];
+	}
+
+	retval = Restrict(obj_table, &res, NULL);
+	talloc_free(res.res.resOr.res);
+
+	return retval;
+}
+
+/* Remember the UID of an exported appointment */
+static void exchange2ical_sync_set_uid(struct exchange2ical_sync *sync, mapi_id_t mid, icalcomponent *vcalendar)
+{
+	struct exchange2ical_sync_uid	key;
+	struct exchange2ical_sync_uid	*entry;
+	icalcomponent			*vevent;
+	const char			*uid;
+
+	vevent = icalcomponent_get_first_component(vcalendar, ICAL_VEVENT_COMPONENT);
+	uid = vevent ? icalcomponent_get_uid(vevent) : NULL;
+	if (!uid) return;
+
+	key.mid = mid;
+	entry = bsearch(&key, sync->uids, sync->uid_sorted, sizeof (struct exchange2ical_sync_uid),
+			exchange2ical_uid_cmp);
+	if (!entry) {
+		/* new appointments are sorted in after each batch of rows */
+		sync->uids = talloc_realloc(sync->mem_ctx, sync->uids, struct exchange2ical_sync_uid,
+					    sync->uid_count + 1);
+		if (!sync->uids) {
+			sync->uid_count = 0;
+			sync->uid_sorted = 0;
+			return;
+		}
+		entry = &sync->uids[sync->uid_count++];
+		entry->mid = mid;
+		entry->uid = NULL;
+	}
+	talloc_free(entry->uid);
+	entry->uid = talloc_strdup(sync->uids, uid);
+}
+
+static icalcomponent *exchange2ical_sync_cancel(const char *uid)
+{
+	icalcomponent	*vcalendar;
+	icalcomponent	*vevent;
+	time_t		t;
+
+	vcalendar = icalcomponent_new_vcalendar();
+	if (!vcalendar) return NULL;
+	icalcomponent_add_property(vcalendar, icalproperty_new_version(OPENCHANGE_ICAL_VERSION));
+	icalcomponent_add_property(vcalendar, icalproperty_new_prodid(OPENCHANGE_ICAL_PRODID));
+	icalcomponent_add_property(vcalendar, icalproperty_new_method(ICAL_METHOD_CANCEL));
+
+	vevent = icalcomponent_new_vevent();
+	t = time(NULL);
+	icalcomponent_add_property(vevent, icalproperty_new_uid(uid));
+	icalcomponent_add_property(vevent, icalproperty_new_dtstamp(get_icaltimetype_from_tm_UTC(gmtime(&t))));
+	icalcomponent_add_property(vevent, icalproperty_new_status(ICAL_STATUS_CANCELLED));
+	icalcomponent_add_component(vcalendar, vevent);
+
+	return vcalendar;
+}
+
+/* Send a METHOD:CANCEL calendar for each exported appointment listed
+   in the MetaTagIdsetDeleted sets of the synchronization */
+static enum MAPISTATUS exchange2ical_sync_cancel_deleted(struct exchange2ical_sync *sync,
+							 exchange2ical_sync_callback_t callback,
+							 void *private_data)
+{
+	icalcomponent	*vcalendar;
+	uint32_t	i;
+	int		ret;
+
+	for (i = 0; sync->deleted && i < sync->uid_count; i++) {
+		if (!sync->uids[i].uid || !IDSET_includes_eid(sync->deleted, sync->uids[i].mid)) {
+			continue;
+		}
+
+		vcalendar = exchange2ical_sync_cancel(sync->uids[i].uid);
+		if (vcalendar) {
+			ret = callback(vcalendar, private_data);
+			icalcomponent_free(vcalendar);
+			if (ret) return MAPI_E_USER_CANCEL;
+		}
+		talloc_free(sync->uids[i].uid);
+		sync->uids[i].uid = NULL;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+enum MAPISTATUS _Exchange2IcalSync(TALLOC_CTX *mem_ctx, mapi_object_t *obj_folder, DATA_BLOB *state,
+				   exchange2ical_sync_callback_t callback, void *private_data)
+{
+	enum MAPISTATUS			retval;
+	struct exchange2ical_sync	*sync;
+	struct exchange2ical		exchange2ical;
+	struct exchange2ical_check	exchange2ical_check;
+	struct exchange2ical_properties	properties;
+	struct ndr_pull			*ndr_pull;
+	struct ndr_push			*ndr_push;
+	struct SRowSet			SRowSet;
+	mapi_object_t			obj_table;
+	mapi_id_t			mid;
+	uint32_t			count;
+	uint32_t			i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!obj_folder, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!state, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!callback, MAPI_E_INVALID_PARAMETER, NULL);
+
+	sync = talloc_zero(mapi_object_get_session(obj_folder), struct exchange2ical_sync);
+	OPENCHANGE_RETVAL_IF(!sync, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	sync->mem_ctx = sync;
+
+	if (state->length) {
+		ndr_pull = ndr_pull_init_blob(state, sync);
+		if (!ndr_pull || exchange2ical_sync_pull(ndr_pull, sync) != NDR_ERR_SUCCESS) {
+			DEBUG(0, ("exchange2ical: invalid synchronization state\n"));
+			talloc_free(sync);
+			return MAPI_E_CORRUPT_DATA;
+		}
+		talloc_free(ndr_pull);
+	}
+
+	retval = exchange2ical_sync_download(obj_folder, sync);
+	OPENCHANGE_RETVAL_IF(retval, retval, sync);
+	DEBUG(0, ("exchange2ical: %u appointments changed\n", sync->mid_count));
+
+	exchange2ical_init(sync, &exchange2ical);
+	exchange2ical_check.eFlags = EntireFlag;
+
+	/* Read the changed appointments from the contents table */
+	if (sync->mid_count) {
+		qsort(sync->mids, sync->mid_count, sizeof (mapi_id_t), exchange2ical_mid_cmp);
+
+		mapi_object_init(&obj_table);
+		retval = GetContentsTable(obj_folder, &obj_table, 0, &count);
+		if (retval == MAPI_E_SUCCESS) {
+			retval = exchange2ical_properties_init(sync, obj_folder, &properties);
+		}
+		if (retval == MAPI_E_SUCCESS) {
+			retval = SetColumns(&obj_table, properties.mapped_columns);
+		}
+		if (retval == MAPI_E_SUCCESS) {
+			retval = exchange2ical_sync_restrict(&obj_table, sync);
+		}
+
+		while (retval == MAPI_E_SUCCESS &&
+		       (retval = QueryRows(&obj_table, EXCHANGE2ICAL_QUERY_ROWS, TBL_ADVANCE, &SRowSet)) == MAPI_E_SUCCESS &&
+		       SRowSet.cRows) {
+			for (i = 0; i < SRowSet.cRows && retval == MAPI_E_SUCCESS; i++) {
+				mid = SRowSet.aRow[i].lpProps[1].value.d;
+				if (!bsearch(&mid, sync->mids, sync->mid_count, sizeof (mapi_id_t), exchange2ical_mid_cmp)) {
+					continue;
+				}
+
+				exchange2ical_unmap_row(&SRowSet.aRow[i], properties.columns);
+				if (exchange2ical_appointment(&exchange2ical, &exchange2ical_check, obj_folder,
+							      &properties, &SRowSet.aRow[i])) {
+					retval = MAPI_E_CALL_FAILED;
+				} else if (exchange2ical.vcalendar) {
+					exchange2ical_sync_set_uid(sync, mid, exchange2ical.vcalendar);
+					if (callback(exchange2ical.vcalendar, private_data)) {
+						retval = MAPI_E_USER_CANCEL;
+					}
+				}
+				if (exchange2ical.vcalendar) {
+					icalcomponent_free(exchange2ical.vcalendar);
+				}
+				exchange2ical_clear(&exchange2ical);
+			}
+			MAPIFreeBuffer(SRowSet.aRow);
+			qsort(sync->uids, sync->uid_count, sizeof (struct exchange2ical_sync_uid), exchange2ical_uid_cmp);
+			sync->uid_sorted = sync->uid_count;
+		}
+		mapi_object_release(&obj_table);
+		OPENCHANGE_RETVAL_IF(retval, retval, sync);
+	}
+
+	/* Cancel the deleted appointments exported earlier */
+	retval = exchange2ical_sync_cancel_deleted(sync, callback, private_data);
+	OPENCHANGE_RETVAL_IF(retval, retval, sync);
+
+	/* Hand the new state over */
+	ndr_push = ndr_push_init_ctx(sync);
+	OPENCHANGE_RETVAL_IF(!ndr_push, MAPI_E_NOT_ENOUGH_MEMORY, sync);
+	if (exchange2ical_sync_push(ndr_push, sync) != NDR_ERR_SUCCESS) {
+		talloc_free(sync);
+		return MAPI_E_CALL_FAILED;
+	}
+	*state = data_blob_talloc(mem_ctx, ndr_push->data, ndr_push->offset);
+
+	talloc_free(sync);
+
+	return MAPI_E_SUCCESS;
+}
@@ -63,6 +63,14 @@ struct exchange2ical_check {
 	uint32_t Sequence;
 };
 
+/* Property tags read for each appointment, mapped once per folder */
+struct exchange2ical_properties {
+	struct SPropTagArray	*columns;
+	struct SPropTagArray	*mapped_columns;
+	struct SPropTagArray	*message_props;
+	struct SPropTagArray	*mapped_message_props;
+};
+
 struct exchange2ical {
 	TALLOC_CTX				*mem_ctx;
 	struct message_recipients		Recipients;
@@ -154,10 +162,17 @@ struct ical_class {
 #define	OPENCHANGE_ICAL_PRODID	"-//OpenChange Project/exchange2ical MIMEDIR//EN"
 #define	OPENCHANGE_ICAL_VERSION	"2.0"
 
+#define	EXCHANGE2ICAL_QUERY_ROWS		0x100
+#define	EXCHANGE2ICAL_SYNC_VERSION		1
+#define	EXCHANGE2ICAL_SYNC_RESTRICT_MAX		256
+
+typedef int (*exchange2ical_sync_callback_t)(icalcomponent *, void *);
+
 __BEGIN_DECLS
 
 /* definitions from exchang2ical.c */
 icalcomponent * _Exchange2Ical(mapi_object_t *, struct exchange2ical_check *);
+enum MAPISTATUS _Exchange2IcalSync(TALLOC_CTX *, mapi_object_t *, DATA_BLOB *, exchange2ical_sync_callback_t, void *);
 
 
 /* definitions from exchange2ical_utils.c */
@@ -58,3 +58,10 @@ icalcomponent *Exchange2IcalEvents(mapi_object_t *obj_folder, struct GlobalObjec
 	exchange2ical_check.GlobalObjectId=GlobalObjectId;
 	return _Exchange2Ical(obj_folder, &exchange2ical_check);
 }
+
+
+enum MAPISTATUS Exchange2IcalSync(TALLOC_CTX *mem_ctx, mapi_object_t *obj_folder, DATA_BLOB *state,
+				  exchange2ical_sync_callback_t callback, void *private_data)
+{
+	return _Exchange2IcalSync(mem_ctx, obj_folder, state, callback, private_data);
+}
@@ -91,4 +91,32 @@ icalcomponent *Exchange2IcalEvent(mapi_object_t *obj_folder, struct GlobalObject
  */
 icalcomponent *Exchange2IcalEvents(mapi_object_t *obj_folder, struct GlobalObjectId *GlobalObjectId);
 
+
+/**
+   \details Retrieve the exchange appointments changed since a previous synchronization
+
+   This function uses an ICS contents synchronization of obj_folder to
+   find the appointments created, modified or deleted since the state
+   was saved, and calls callback with an Icalendar for each of them as
+   soon as it is converted. Deleted appointments are reported with a
+   cancelled vevent carrying their UID.
+
+   \param mem_ctx the memory context the new state is allocated with
+   \param obj_folder the folder to operate in
+   \param state the state of the previous synchronization, or an empty
+   blob to retrieve all the appointments. It is replaced with the new
+   state on success.
+   \param callback the function called with each Icalendar. It must not
+   free it, and returns a non-zero value to stop the synchronization.
+   \param private_data pointer passed to callback
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \note On failure state is left untouched, so the appointments
+   already passed to callback are retrieved again next time.
+
+ */
+enum MAPISTATUS Exchange2IcalSync(TALLOC_CTX *mem_ctx, mapi_object_t *obj_folder, DATA_BLOB *state,
+				  exchange2ical_sync_callback_t callback, void *private_data);
+
 #endif /* __LIBEXCHANGE2ICAL_H_ */
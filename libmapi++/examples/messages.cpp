@@ -21,6 +21,7 @@
 
 #include <exception>
 #include <string>
+#include <vector>
 
 #include <libmapi++/libmapi++.h>
 
@@ -38,28 +39,26 @@ int main ()
 		// We start off by fetching the inbox
 		mapi_id_t inbox_id = msg_store.get_default_folder(olFolderInbox);
 		libmapipp::folder inbox_folder(msg_store, inbox_id);
-		// Now get the messages in this folder These are returned as
-		// a std::vector of pointers to messages
-		libmapipp::folder::message_container_type messages = inbox_folder.fetch_messages();
+		// Now walk the messages in this folder. The properties we are
+		// interested in, the "to" addressee and the subject, are read
+		// with the contents table in batches, so the messages themselves
+		// never need to be opened. You can get a lot of other properties
+		// here (e.g. sender, body, etc).
+		std::vector<uint32_t> columns = { PR_DISPLAY_TO, PR_CONVERSATION_TOPIC };
+		libmapipp::message_range messages(inbox_folder, columns);
 		std::cout << "Inbox contains " << messages.size() << " messages" << std::endl;
 
 		// Work through each message
-        	for (unsigned int i = 0; i < messages.size(); ++i) {
-			// Get the properties we are interested in
-			libmapipp::property_container msg_props = messages[i]->get_property_container();
-			// We get the "to" addressee, and the subject
-			// You can get a lot of other properties here (e.g. sender, body, etc).
-			msg_props << PR_DISPLAY_TO << PR_CONVERSATION_TOPIC;
-			msg_props.fetch();
+		for (libmapipp::message_range::iterator Iter = messages.begin(); Iter != messages.end(); ++Iter) {
 			// Display those properties
-			if (msg_props[PR_DISPLAY_TO] != 0) {
-				std::cout << "|-----> " << (const char*)msg_props[PR_DISPLAY_TO];
-				if(msg_props[PR_CONVERSATION_TOPIC] != 0) {
-					std::cout << "\t\t| " << (const char*)msg_props[PR_CONVERSATION_TOPIC];
+			if ((*Iter)[PR_DISPLAY_TO] != 0) {
+				std::cout << "|-----> " << (const char*)(*Iter)[PR_DISPLAY_TO];
+				if ((*Iter)[PR_CONVERSATION_TOPIC] != 0) {
+					std::cout << "\t\t| " << (const char*)(*Iter)[PR_CONVERSATION_TOPIC];
 				}
 				std::cout << std::endl;
 			}
-        	}
+		}
         }
         catch (libmapipp::mapi_exception e) // Catch any MAPI exceptions
         {
@@ -91,6 +91,9 @@ class folder : public object {
 		/**
 		 * \brief Fetch all messages in this %folder
 		 *
+		 * All the messages are opened. Use a message_range to walk large
+		 * folders or when only a few properties of each %message are needed.
+		 *
 		 * \return A container of message shared pointers.
 		 */
 		message_container_type fetch_messages() throw(mapi_exception);
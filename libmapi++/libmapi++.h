@@ -27,6 +27,7 @@
 #include <libmapi++/mapi_exception.h>
 #include <libmapi++/folder.h>
 #include <libmapi++/message.h>
+#include <libmapi++/message_range.h>
 #include <libmapi++/attachment.h>
 #include <libmapi++/property_container.h>
 #include <libmapi++/profile.h>
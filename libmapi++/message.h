@@ -61,6 +61,21 @@ class message : public object {
 				throw mapi_exception(GetLastError(), "message::message : OpenMessage");
 		}
 
+		/**
+		 * \brief Constructor taking over an already opened %message
+		 *
+		 * \param mapi_session The session this %message was retrieved with.
+		 * \param folder_id The id of the folder this %message belongs to.
+		 * \param message_id The %message id.
+		 * \param opened_message The %message object opened by the caller, for instance through a mapi_batch. It is reset and must not be released by the caller.
+		 */
+		message(session& mapi_session, const mapi_id_t folder_id, const mapi_id_t message_id, mapi_object_t& opened_message) throw()
+		: object(mapi_session, "message"), m_folder_id(folder_id), m_id(message_id)
+		{
+			mapi_object_copy(&m_object, &opened_message);
+			mapi_object_init(&opened_message);
+		}
+
 		/**
 		 * \brief Fetches all attachments in this %message.
 		 *
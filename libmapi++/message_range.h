@@ -0,0 +1,254 @@
+/*
+   libmapi C++ Wrapper
+   Message Range Class
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBMAPIPP__MESSAGE_RANGE_H__
+#define LIBMAPIPP__MESSAGE_RANGE_H__
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <libmapi++/clibmapi.h>
+#include <libmapi++/mapi_exception.h>
+#include <libmapi++/session.h>
+#include <libmapi++/folder.h>
+#include <libmapi++/message.h>
+
+namespace libmapipp
+{
+
+/**
+ * \brief A row of a folder contents table.
+ *
+ * It holds the properties requested when the message_range was
+ * created and opens the %message itself only when get_message() is
+ * called, unless the range already opened it. Rows can be moved out of
+ * the range but not copied, as they own the underlying %message handle.
+ */
+class message_row {
+	public:
+		/**
+		 * \brief Constructor
+		 *
+		 * \param mapi_session The session the row was read with.
+		 * \param folder_id The id of the folder the %message belongs to.
+		 * \param rows The batch of contents table rows the row belongs to, each starting with PR_FID and PR_MID. The row values are allocated under it, so it is kept alive as long as the row.
+		 * \param index The index of the row in the batch.
+		 * \param opened_message The %message object if it was already opened, NULL otherwise. It is reset and must not be released by the caller.
+		 */
+		message_row(session& mapi_session, const mapi_id_t folder_id, const std::shared_ptr<SRow>& rows, uint32_t index, mapi_object_t* opened_message) throw();
+
+		/// Move constructor
+		message_row(message_row&& other) throw()
+		: m_session(other.m_session), m_folder_id(other.m_folder_id), m_id(other.m_id),
+		  m_rows(std::move(other.m_rows)), m_row(other.m_row), m_message(std::move(other.m_message))
+		{
+			other.m_row.cValues = 0;
+			other.m_row.lpProps = NULL;
+		}
+
+		/// Move assignment
+		message_row& operator=(message_row&& other) throw()
+		{
+			if (this != &other) {
+				m_session = other.m_session;
+				m_folder_id = other.m_folder_id;
+				m_id = other.m_id;
+				m_rows = std::move(other.m_rows);
+				m_row = other.m_row;
+				m_message = std::move(other.m_message);
+				other.m_row.cValues = 0;
+				other.m_row.lpProps = NULL;
+			}
+			return *this;
+		}
+
+		message_row(const message_row&) = delete;
+		message_row& operator=(const message_row&) = delete;
+
+		/**
+		 * \brief Finds a property value read with the contents table row
+		 *
+		 * \param property_tag The Property Tag to be searched for
+		 *
+		 * \return Property Value as a const void pointer, or NULL if the property was not requested or is not set on the %message
+		 */
+		const void* operator[](uint32_t property_tag) throw()
+		{
+			return find_SPropValue_data(&m_row, property_tag);
+		}
+
+		/**
+		 * \brief Get the %message, opening it if needed.
+		 *
+		 * \return A reference to the %message. It remains owned by this row.
+		 */
+		message& get_message() throw(mapi_exception)
+		{
+			if (!m_message) {
+				m_message.reset(new message(*m_session, m_folder_id, m_id));
+			}
+			return *m_message;
+		}
+
+		/// \brief Whether the %message has already been opened.
+		bool is_open() const throw() { return (bool)m_message; }
+
+		/**
+		 * \brief Take over the %message, opening it if needed.
+		 *
+		 * \return The %message, now owned by the caller.
+		 */
+		std::unique_ptr<message> release_message() throw(mapi_exception)
+		{
+			get_message();
+			return std::move(m_message);
+		}
+
+		/// \brief Get this %message's ID.
+		mapi_id_t get_id() const throw() { return m_id; }
+
+		/// \brief Get this message's parent folder ID.
+		mapi_id_t get_folder_id() const throw() { return m_folder_id; }
+
+	private:
+		session*			m_session;
+		mapi_id_t			m_folder_id;
+		mapi_id_t			m_id;
+		std::shared_ptr<SRow>		m_rows;
+		SRow				m_row;
+		std::unique_ptr<message>	m_message;
+};
+
+/**
+ * \brief A lazily fetched range of the messages in a %folder.
+ *
+ * Contents table rows are read in batches of batch_size rows as the
+ * range is iterated, together with the properties given to the
+ * constructor, so reading these properties needs no OpenMessage. When
+ * open_messages is set, the messages of each batch are also opened
+ * together in as few round trips as possible, otherwise each message is
+ * opened on the first call to message_row::get_message().
+ *
+ * \code
+ * std::vector<uint32_t> columns = { PR_DISPLAY_TO_UNICODE, PR_SUBJECT_UNICODE };
+ * libmapipp::message_range messages(inbox_folder, columns);
+ * for (libmapipp::message_range::iterator Iter = messages.begin(); Iter != messages.end(); ++Iter) {
+ *	const char *subject = static_cast<const char*>((*Iter)[PR_SUBJECT_UNICODE]);
+ * }
+ * \endcode
+ */
+class message_range {
+	public:
+		/// Default number of contents table rows read per batch
+		static const uint16_t default_batch_size = 100;
+
+		/// Single pass iterator over a message_range
+		class iterator : public std::iterator<std::input_iterator_tag, message_row> {
+			public:
+				/// Default Constructor. Creates an end iterator.
+				iterator() throw() : m_range(NULL) {}
+
+				explicit iterator(message_range* range) throw() : m_range(range) {}
+
+				message_row& operator*() const throw() { return m_range->current(); }
+
+				message_row* operator->() const throw() { return &m_range->current(); }
+
+				/// operator++, may read the next batch of rows
+				iterator& operator++() throw(mapi_exception)
+				{
+					if (!m_range->next()) m_range = NULL;
+					return *this;
+				}
+
+				bool operator==(const iterator& rhs) const throw() { return m_range == rhs.m_range; }
+
+				bool operator!=(const iterator& rhs) const throw() { return m_range != rhs.m_range; }
+
+			private:
+				message_range*	m_range;
+		};
+
+		/**
+		 * \brief Constructor
+		 *
+		 * \param mapi_folder The %folder whose messages are enumerated.
+		 * \param property_tags The properties to read with each contents table row.
+		 * \param batch_size Number of rows read per QueryRows round trip.
+		 * \param open_messages Whether to open the messages of each batch together.
+		 */
+		message_range(folder& mapi_folder, const std::vector<uint32_t>& property_tags = std::vector<uint32_t>(),
+			      uint16_t batch_size = default_batch_size, bool open_messages = false) throw(mapi_exception);
+
+		message_range(const message_range&) = delete;
+		message_range& operator=(const message_range&) = delete;
+
+		/**
+		 * \brief Start the iteration, reading the first batch of rows.
+		 *
+		 * A range can only be iterated once.
+		 */
+		iterator begin() throw(mapi_exception)
+		{
+			if (!m_started) {
+				m_started = true;
+				if (!fetch_batch()) return iterator();
+			}
+			return (m_position < m_rows.size()) ? iterator(this) : iterator();
+		}
+
+		iterator end() throw() { return iterator(); }
+
+		/// \brief Number of messages in the %folder when the range was created.
+		uint32_t size() const throw() { return m_row_count; }
+
+		/// Destructor
+		~message_range() throw()
+		{
+			m_rows.clear();
+			mapi_object_release(&m_contents_table);
+		}
+
+	private:
+		session&			m_session;
+		mapi_id_t			m_folder_id;
+		mapi_object_t			m_contents_table;
+		uint32_t			m_row_count;
+		uint16_t			m_batch_size;
+		bool				m_open_messages;
+		bool				m_started;
+		std::vector<message_row>	m_rows;
+		size_t				m_position;
+
+		message_row& current() throw() { return m_rows[m_position]; }
+
+		bool next() throw(mapi_exception)
+		{
+			if (++m_position < m_rows.size()) return true;
+			return fetch_batch();
+		}
+
+		bool fetch_batch() throw(mapi_exception);
+};
+
+} // namespace libmapipp
+
+#endif //!LIBMAPIPP__MESSAGE_RANGE_H__
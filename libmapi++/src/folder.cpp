@@ -19,53 +19,25 @@
 */
 
 #include <libmapi++/folder.h>
+#include <libmapi++/message_range.h>
 
 namespace libmapipp {
 
+/// Number of contents table rows read and opened per round trip by fetch_messages()
+static const uint16_t fetch_messages_batch_size = 500;
+
 folder::message_container_type folder::fetch_messages() throw(mapi_exception)
 {
-	uint32_t 	contents_table_row_count = 0;
-        mapi_object_t	contents_table;
-
-	mapi_object_init(&contents_table);
-	if (GetContentsTable(&m_object, &contents_table, 0, &contents_table_row_count) != MAPI_E_SUCCESS) {
-		mapi_object_release(&contents_table);
-		throw mapi_exception(GetLastError(), "folder::fetch_messages : GetContentsTable");
-	}
-
-	SPropTagArray* property_tag_array = set_SPropTagArray(m_session.get_memory_ctx(), 0x2, PR_FID,
-											       PR_MID);
-
-	if (SetColumns(&contents_table, property_tag_array) != MAPI_E_SUCCESS) {
-		MAPIFreeBuffer(property_tag_array);
-		mapi_object_release(&contents_table);
-		throw mapi_exception(GetLastError(), "folder::fetch_messages : SetColumns");
-	}
-
-	MAPIFreeBuffer(property_tag_array);
-
-	uint32_t rows_to_read = contents_table_row_count;
-	SRowSet  row_set;
+	// Open the messages of each batch of contents table rows together
+	message_range range(*this, std::vector<uint32_t>(), fetch_messages_batch_size, true);
 
 	message_container_type message_container;
-	message_container.reserve(contents_table_row_count);
+	message_container.reserve(range.size());
 
-	while( (QueryRows(&contents_table, rows_to_read, TBL_ADVANCE, &row_set) == MAPI_E_SUCCESS) && row_set.cRows) {
-		rows_to_read -= row_set.cRows;
-		for (unsigned int i = 0; i < row_set.cRows; ++i) {
-			try {
-				message_container.push_back(message_shared_ptr(new message(m_session,
-											   m_id,
-											   row_set.aRow[i].lpProps[1].value.d)));
-			} catch(mapi_exception e) {
-				mapi_object_release(&contents_table);
-				throw;
-			}
-		}
+	for (message_range::iterator Iter = range.begin(); Iter != range.end(); ++Iter) {
+		message_container.push_back(message_shared_ptr(Iter->release_message().release()));
 	}
 
-	mapi_object_release(&contents_table);
-
 	return message_container;
 }
 
@@ -0,0 +1,127 @@
+/*
+   libmapi C++ Wrapper
+   Message Range Class implementation.
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libmapi++/message_range.h>
+
+namespace libmapipp {
+
+message_row::message_row(session& mapi_session, const mapi_id_t folder_id, const std::shared_ptr<SRow>& rows, uint32_t index, mapi_object_t* opened_message) throw()
+: m_session(&mapi_session), m_folder_id(folder_id), m_id(rows.get()[index].lpProps[1].value.d),
+  m_rows(rows), m_row(rows.get()[index])
+{
+	if (opened_message) {
+		m_message.reset(new message(mapi_session, folder_id, m_id, *opened_message));
+	}
+}
+
+message_range::message_range(folder& mapi_folder, const std::vector<uint32_t>& property_tags,
+			     uint16_t batch_size, bool open_messages) throw(mapi_exception)
+: m_session(mapi_folder.get_session()), m_folder_id(mapi_folder.get_id()), m_row_count(0),
+  m_batch_size(batch_size ? batch_size : default_batch_size), m_open_messages(open_messages),
+  m_started(false), m_position(0)
+{
+	mapi_object_init(&m_contents_table);
+	if (GetContentsTable(&mapi_folder.data(), &m_contents_table, 0, &m_row_count) != MAPI_E_SUCCESS) {
+		mapi_object_release(&m_contents_table);
+		throw mapi_exception(GetLastError(), "message_range::message_range : GetContentsTable");
+	}
+
+	// PR_FID and PR_MID always come first, message_row relies on it
+	SPropTagArray* property_tag_array = set_SPropTagArray(m_session.get_memory_ctx(), 0x2, PR_FID, PR_MID);
+	for (std::vector<uint32_t>::const_iterator Iter = property_tags.begin(); Iter != property_tags.end(); ++Iter) {
+		if (*Iter != PR_FID && *Iter != PR_MID) {
+			SPropTagArray_add(m_session.get_memory_ctx(), property_tag_array, (enum MAPITAGS) *Iter);
+		}
+	}
+
+	if (SetColumns(&m_contents_table, property_tag_array) != MAPI_E_SUCCESS) {
+		MAPIFreeBuffer(property_tag_array);
+		mapi_object_release(&m_contents_table);
+		throw mapi_exception(GetLastError(), "message_range::message_range : SetColumns");
+	}
+
+	MAPIFreeBuffer(property_tag_array);
+
+	m_rows.reserve(m_batch_size);
+}
+
+bool message_range::fetch_batch() throw(mapi_exception)
+{
+	SRowSet	row_set;
+
+	m_rows.clear();
+	m_position = 0;
+
+	if (QueryRows(&m_contents_table, m_batch_size, TBL_ADVANCE, &row_set) != MAPI_E_SUCCESS) {
+		throw mapi_exception(GetLastError(), "message_range::fetch_batch : QueryRows");
+	}
+	// Multi-valued and binary row values are allocated under aRow, so
+	// the batch is only released with its last message_row
+	std::shared_ptr<SRow> rows(row_set.aRow, [](SRow* aRow) { MAPIFreeBuffer(aRow); });
+	if (!row_set.cRows) {
+		return false;
+	}
+
+	std::vector<mapi_object_t>	opened_messages;
+
+	if (m_open_messages) {
+		// Open all the messages of the batch in as few round trips as possible
+		mapi_object_t&			store = m_session.get_message_store().data();
+		std::vector<enum MAPISTATUS>	results(row_set.cRows, MAPI_E_CALL_FAILED);
+		enum MAPISTATUS			retval = MAPI_E_SUCCESS;
+
+		opened_messages.resize(row_set.cRows);
+		for (unsigned int i = 0; i < row_set.cRows; ++i) {
+			mapi_object_init(&opened_messages[i]);
+		}
+
+		mapi_batch* batch = mapi_batch_init(m_session.get_memory_ctx(), &store);
+		if (!batch) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		for (unsigned int i = 0; i < row_set.cRows && retval == MAPI_E_SUCCESS; ++i) {
+			retval = mapi_batch_OpenMessage(batch, &store, m_folder_id, row_set.aRow[i].lpProps[1].value.d,
+							&opened_messages[i], 0, &results[i]);
+		}
+		if (retval == MAPI_E_SUCCESS) {
+			retval = mapi_batch_dispatch(batch);
+		}
+		for (unsigned int i = 0; i < row_set.cRows && retval == MAPI_E_SUCCESS; ++i) {
+			retval = results[i];
+		}
+		talloc_free(batch);
+
+		if (retval != MAPI_E_SUCCESS) {
+			for (unsigned int i = 0; i < row_set.cRows; ++i) {
+				mapi_object_release(&opened_messages[i]);
+			}
+			throw mapi_exception(retval, "message_range::fetch_batch : OpenMessage");
+		}
+	}
+
+	for (unsigned int i = 0; i < row_set.cRows; ++i) {
+		m_rows.push_back(message_row(m_session, m_folder_id, rows, i,
+					     m_open_messages ? &opened_messages[i] : NULL));
+	}
+
+	return true;
+}
+
+} // namespace libmapipp
@@ -0,0 +1,129 @@
+/*
+   libmapi C++ Wrapper
+
+   Message range benchmark application
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <sys/time.h>
+
+#include <libmapi++/libmapi++.h>
+
+using namespace std;
+using namespace libmapipp;
+
+// Reads the subject and size of every Inbox message, first by opening
+// each message and fetching its properties, then through a message_range
+// reading them with the contents table rows, and prints the number of
+// EcDoRpc round trips and the time each approach took.
+
+struct benchmark_stats {
+	uint32_t	transactions;
+	uint64_t	bytes;
+	struct timeval	start;
+};
+
+static void benchmark_start(session& mapi_session, benchmark_stats& stats)
+{
+	emsmdb_get_transaction_stats(mapi_session.get_mapi_session(), &stats.transactions, &stats.bytes);
+	gettimeofday(&stats.start, NULL);
+}
+
+static void benchmark_end(session& mapi_session, const benchmark_stats& stats, const char* name, uint32_t message_count)
+{
+	struct timeval	end;
+	uint32_t	transactions = 0;
+	uint64_t	bytes = 0;
+
+	gettimeofday(&end, NULL);
+	emsmdb_get_transaction_stats(mapi_session.get_mapi_session(), &transactions, &bytes);
+
+	double elapsed = (end.tv_sec - stats.start.tv_sec) + (end.tv_usec - stats.start.tv_usec) / 1000000.0;
+	cout << name << ": " << message_count << " messages, "
+	     << (transactions - stats.transactions) << " round trips, "
+	     << (bytes - stats.bytes) << " bytes, "
+	     << elapsed << " seconds" << endl;
+}
+
+static uint32_t read_with_fetch_messages(folder& mapi_folder)
+{
+	uint32_t message_count = 0;
+
+	folder::message_container_type messages = mapi_folder.fetch_messages();
+	for (folder::message_container_type::iterator Iter = messages.begin(); Iter != messages.end(); ++Iter) {
+		property_container message_property_container = (*Iter)->get_property_container();
+		message_property_container << PR_SUBJECT_UNICODE << PR_MESSAGE_SIZE;
+		message_property_container.fetch();
+		if (message_property_container[PR_MESSAGE_SIZE]) {
+			++message_count;
+		}
+	}
+
+	return message_count;
+}
+
+static uint32_t read_with_message_range(folder& mapi_folder)
+{
+	uint32_t		message_count = 0;
+	std::vector<uint32_t>	columns = { PR_SUBJECT_UNICODE, PR_MESSAGE_SIZE };
+
+	message_range messages(mapi_folder, columns);
+	for (message_range::iterator Iter = messages.begin(); Iter != messages.end(); ++Iter) {
+		if ((*Iter)[PR_MESSAGE_SIZE]) {
+			++message_count;
+		}
+	}
+
+	return message_count;
+}
+
+int main()
+{
+	try {
+		session mapi_session;
+		mapi_session.login();
+
+		message_store& msg_store = mapi_session.get_message_store();
+		folder inbox_folder(msg_store, msg_store.get_default_folder(olFolderInbox));
+
+		benchmark_stats stats;
+		uint32_t message_count;
+
+		benchmark_start(mapi_session, stats);
+		message_count = read_with_fetch_messages(inbox_folder);
+		benchmark_end(mapi_session, stats, "fetch_messages", message_count);
+
+		benchmark_start(mapi_session, stats);
+		message_count = read_with_message_range(inbox_folder);
+		benchmark_end(mapi_session, stats, "message_range", message_count);
+	}
+	catch (mapi_exception e) // Catch any mapi exceptions
+	{
+		cout << "MAPI Exception @ main: " <<  e.what() << endl;
+		return 1;
+	}
+	catch (std::runtime_error e) // Catch runtime exceptions
+	{
+		cout << "std::runtime_error exception @ main: " << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
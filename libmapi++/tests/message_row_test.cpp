@@ -0,0 +1,146 @@
+/*
+   libmapi C++ Wrapper
+
+   Test application for message_row ownership of contents table rows
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <unistd.h>
+
+#include <libmapi++/libmapi++.h>
+
+#define PROFILEDB_NAME_TEMPLATE "/tmp/mapidbXXXXXX"
+#define PR_TEST_MV_UNICODE	PROP_TAG(PT_MV_UNICODE, 0x3a56)
+
+using namespace std;
+using namespace libmapipp;
+
+// Builds a batch of rows the way QueryRows does: the property values,
+// the multi-valued strings and the binary data are all allocated under
+// aRow. The rows must still be readable once the batch has been handed
+// over to message_row objects and released by the caller, as
+// message_range::fetch_batch does.
+static SRow* make_batch(TALLOC_CTX* mem_ctx, uint32_t count)
+{
+	SRow* aRow = talloc_zero_array(mem_ctx, SRow, count);
+
+	for (uint32_t i = 0; i < count; ++i) {
+		aRow[i].cValues = 4;
+		aRow[i].lpProps = talloc_zero_array(aRow, SPropValue, 4);
+		aRow[i].lpProps[0].ulPropTag = PR_FID;
+		aRow[i].lpProps[0].value.d = 0x42;
+		aRow[i].lpProps[1].ulPropTag = PR_MID;
+		aRow[i].lpProps[1].value.d = 0x100 + i;
+
+		aRow[i].lpProps[2].ulPropTag = PR_TEST_MV_UNICODE;
+		aRow[i].lpProps[2].value.MVszW.cValues = 2;
+		aRow[i].lpProps[2].value.MVszW.lppszW = talloc_array(aRow, const char*, 2);
+		aRow[i].lpProps[2].value.MVszW.lppszW[0] = talloc_asprintf(aRow, "first-%u", i);
+		aRow[i].lpProps[2].value.MVszW.lppszW[1] = talloc_asprintf(aRow, "second-%u", i);
+
+		aRow[i].lpProps[3].ulPropTag = PR_ENTRYID;
+		aRow[i].lpProps[3].value.bin.cb = 4;
+		aRow[i].lpProps[3].value.bin.lpb = (uint8_t*) talloc_memdup(aRow, "\x01\x02\x03\x04", 4);
+	}
+
+	return aRow;
+}
+
+static bool check_row(message_row& row, uint32_t i)
+{
+	const StringArrayW_r*	values = static_cast<const StringArrayW_r*>(row[PR_TEST_MV_UNICODE]);
+	const Binary_r*		entryid = static_cast<const Binary_r*>(row[PR_ENTRYID]);
+	char			expected[32];
+
+	if (row.get_id() != 0x100 + i || !values || values->cValues != 2 || !entryid || entryid->cb != 4) {
+		return false;
+	}
+	snprintf(expected, sizeof(expected), "first-%u", i);
+	if (strcmp(values->lppszW[0], expected)) return false;
+	snprintf(expected, sizeof(expected), "second-%u", i);
+	if (strcmp(values->lppszW[1], expected)) return false;
+
+	return (memcmp(entryid->lpb, "\x01\x02\x03\x04", 4) == 0);
+}
+
+int main()
+{
+	char	tmpname[] = PROFILEDB_NAME_TEMPLATE;
+	int	failures = 0;
+
+	int fd = mkstemp(tmpname);
+	if (fd < 0 || !profile_database::create_profile_store(tmpname)) {
+		cout << "failed to create a temporary profile store" << endl;
+		return 1;
+	}
+	close(fd);
+
+	try {
+		session			mapi_session(tmpname);
+		vector<message_row>	rows;
+		const uint32_t		count = 3;
+
+		{
+			std::shared_ptr<SRow> batch(make_batch(mapi_session.get_memory_ctx(), count),
+						    [](SRow* aRow) { MAPIFreeBuffer(aRow); });
+			for (uint32_t i = 0; i < count; ++i) {
+				rows.push_back(message_row(mapi_session, 0x42, batch, i, NULL));
+			}
+		}
+
+		// The batch is now only referenced by the rows
+		for (uint32_t i = 0; i < count; ++i) {
+			if (!check_row(rows[i], i)) {
+				cout << "row " << i << ": multi-valued or binary column not readable after the batch was released" << endl;
+				++failures;
+			}
+		}
+
+		// A row moved out of the range keeps the batch alive on its own
+		message_row last(std::move(rows[count - 1]));
+		rows.clear();
+		if (!check_row(last, count - 1)) {
+			cout << "moved row: multi-valued or binary column not readable after the other rows were released" << endl;
+			++failures;
+		}
+	}
+	catch (mapi_exception e)
+	{
+		cout << "MAPI Exception @ main: " << e.what() << endl;
+		++failures;
+	}
+	catch (std::runtime_error e)
+	{
+		cout << "std::runtime_error exception @ main: " << e.what() << endl;
+		++failures;
+	}
+
+	unlink(tmpname);
+
+	if (!failures) {
+		cout << "message_row: all tests passed" << endl;
+	}
+
+	return failures ? 1 : 0;
+}
@@ -768,6 +768,11 @@ _PUBLIC_ enum MAPISTATUS FXCopyProperties(mapi_object_t *obj, uint8_t level, uin
     
    \return MAPI_E_SUCCESS on success, otherwise MAPI error.
 
+   \note When the session rgbOut size was raised with
+   emsmdb_set_max_rgbout(), the server may return several blocks in
+   chained extended buffers. They are concatenated in blob and the
+   status and step counts are the ones of the last block.
+
    \note Developers may also call GetLastError() to retrieve the last
    MAPI error code. Possible MAPI error codes are:
    - MAPI_E_NOT_INITIALIZED: MAPI subsystem has not been initialized
@@ -788,6 +793,7 @@ _PUBLIC_ enum MAPISTATUS FXGetBuffer(mapi_object_t *obj_source_context, uint16_t
 	NTSTATUS					status;
 	enum MAPISTATUS					retval;
 	uint32_t					size = 0;
+	uint32_t					i;
 	TALLOC_CTX					*mem_ctx;
 	uint8_t 					logon_id = 0;
 
@@ -831,20 +837,31 @@ _PUBLIC_ enum MAPISTATUS FXGetBuffer(mapi_object_t *obj_source_context, uint16_t
 	mapi_request->handles[0] = mapi_object_get_handle(obj_source_context);
 
 	// TODO: handle backoff (0x00000480)
-	status = emsmdb_transaction_wrapper(session, mem_ctx, mapi_request, &mapi_response);
+	status = emsmdb_transaction_chained(session, mem_ctx, mapi_request, &mapi_response);
 	OPENCHANGE_RETVAL_IF(!NT_STATUS_IS_OK(status), MAPI_E_CALL_FAILED, mem_ctx);
 	OPENCHANGE_RETVAL_IF(!mapi_response->mapi_repl, MAPI_E_CALL_FAILED, mem_ctx);
 	retval = mapi_response->mapi_repl->error_code;
 	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* Retrieve the result */
-	reply = &(mapi_response->mapi_repl->u.mapi_FastTransferSourceGetBuffer);
-	*transferStatus = reply->TransferStatus;
-	*progressStepCount = reply->InProgressCount;
-	*totalStepCount = reply->TotalStepCount;
-	blob->length = reply->TransferBufferSize;
+	/* Retrieve the result, one reply per chained extended buffer */
+	blob->length = 0;
+	for (i = 0; mapi_response->mapi_repl[i].opnum; i++) {
+		if (mapi_response->mapi_repl[i].opnum != op_MAPI_FastTransferSourceGetBuffer) continue;
+		retval = mapi_response->mapi_repl[i].error_code;
+		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+		blob->length += mapi_response->mapi_repl[i].u.mapi_FastTransferSourceGetBuffer.TransferBufferSize;
+	}
+
 	blob->data = (uint8_t *)talloc_size((TALLOC_CTX *)session, blob->length);
-	memcpy(blob->data, reply->TransferBuffer.data, blob->length);
+	for (i = 0, size = 0; mapi_response->mapi_repl[i].opnum; i++) {
+		if (mapi_response->mapi_repl[i].opnum != op_MAPI_FastTransferSourceGetBuffer) continue;
+		reply = &(mapi_response->mapi_repl[i].u.mapi_FastTransferSourceGetBuffer);
+		memcpy(blob->data + size, reply->TransferBuffer.data, reply->TransferBufferSize);
+		size += reply->TransferBufferSize;
+		*transferStatus = reply->TransferStatus;
+		*progressStepCount = reply->InProgressCount;
+		*totalStepCount = reply->TotalStepCount;
+	}
 
 	talloc_free(mapi_response);
 	talloc_free(mem_ctx);
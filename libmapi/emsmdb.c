@@ -251,6 +251,8 @@ struct emsmdb_context *emsmdb_connect_ex(TALLOC_CTX *mem_ctx,
 	ctx->cred = cred;
 	ctx->max_data = 0xFFF0;
 	ctx->setup = false;
+	ctx->compression = true;
+	ctx->max_rgbout = EMSMDB_RGBOUT_DEFAULT_SIZE;
 
 	talloc_free(tmp_ctx);
 	return ctx;
@@ -474,90 +476,215 @@ start:
 
 
 /**
-   \details Make a EMSMDB EXT2 transaction.
+   \details Build the rgbIn buffer of an EcDoRpcExt2 call
+
+   The MAPI request is compressed when compression is requested and
+   the compressed payload is smaller than the original one, then
+   obfuscated and prefixed with its RPC_HEADER_EXT.
+
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the MAPI request to push
+   \param compression whether the request may be compressed
+   \param rgbIn pointer to the data blob the function returns
+   \param compressed pointer to a boolean set to true if the payload
+   was compressed
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code emsmdb_push_ext2_request(TALLOC_CTX *mem_ctx,
+						    struct mapi_request *req,
+						    bool compression,
+						    DATA_BLOB *rgbIn,
+						    bool *compressed)
+{
+	struct ndr_push		*ndr_uncomp_rgbIn;
+	struct ndr_push		*ndr_comp_rgbIn = NULL;
+	struct ndr_push		*ndr_rgbIn;
+	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
+	enum ndr_err_code	ndr_err;
+
+	/* Step 1. Push mapi_request in a data blob */
+	ndr_uncomp_rgbIn = ndr_push_init_ctx(mem_ctx);
+	NDR_ERR_HAVE_NO_MEMORY(ndr_uncomp_rgbIn);
+	ndr_set_flags(&ndr_uncomp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+	NDR_CHECK(ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req));
+
+	RPC_HEADER_EXT.Version = 0x0000;
+	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
+	RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset;
+
+	/* Step 2. Compress the blob unless it does not save space */
+	if (compression && (ndr_uncomp_rgbIn->offset >= EMSMDB_COMPRESSION_THRESHOLD)) {
+		ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx);
+		NDR_ERR_HAVE_NO_MEMORY(ndr_comp_rgbIn);
+		ndr_set_flags(&ndr_comp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+		ndr_err = ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn);
+		if ((ndr_err != NDR_ERR_SUCCESS) || (ndr_comp_rgbIn->offset >= ndr_uncomp_rgbIn->offset)) {
+			talloc_free(ndr_comp_rgbIn);
+			ndr_comp_rgbIn = NULL;
+		} else {
+			DEBUG(5, ("emsmdb_push_ext2_request: request compressed from %d to %d bytes\n",
+				  ndr_uncomp_rgbIn->offset, ndr_comp_rgbIn->offset));
+			RPC_HEADER_EXT.Flags |= RHEF_Compressed;
+			talloc_free(ndr_uncomp_rgbIn);
+		}
+	}
+
+	if (!ndr_comp_rgbIn) {
+		ndr_comp_rgbIn = ndr_uncomp_rgbIn;
+	}
+
+	/* Step 3. Obfuscate the payload */
+	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
+	RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset;
+
+	/* Step 4. Push the complete rgbIn */
+	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
+	NDR_ERR_HAVE_NO_MEMORY(ndr_rgbIn);
+	ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+	NDR_CHECK(ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT));
+	NDR_CHECK(ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset));
+	talloc_free(ndr_comp_rgbIn);
+
+	rgbIn->data = talloc_steal(mem_ctx, ndr_rgbIn->data);
+	rgbIn->length = ndr_rgbIn->offset;
+	talloc_free(ndr_rgbIn);
+
+	if (compressed) {
+		*compressed = (RPC_HEADER_EXT.Flags & RHEF_Compressed) ? true : false;
+	}
+
+	return NDR_ERR_SUCCESS;
+}
+
+
+/**
+   \details Append the ROP replies of a chained response buffer to
+   the response pulled from the first buffer
+
+   \param mapi_response pointer to the response of the first buffer
+   \param chained pointer to the response of the chained buffer
+ */
+static void emsmdb_chain_response(struct mapi_response *mapi_response,
+				  struct mapi_response *chained)
+{
+	uint32_t	count;
+	uint32_t	extra;
+
+	if (!chained->mapi_repl) return;
+
+	for (count = 0; mapi_response->mapi_repl && mapi_response->mapi_repl[count].opnum; count++);
+	for (extra = 0; chained->mapi_repl[extra].opnum; extra++);
+
+	mapi_response->mapi_repl = talloc_realloc(mapi_response, mapi_response->mapi_repl,
+						  struct EcDoRpc_MAPI_REPL, count + extra + 1);
+	memcpy(&mapi_response->mapi_repl[count], chained->mapi_repl, extra * sizeof (struct EcDoRpc_MAPI_REPL));
+	mapi_response->mapi_repl[count + extra].opnum = 0;
+
+	/* The server object handle table is shared by all buffers */
+	mapi_response->length += chained->length - sizeof (uint16_t);
+	mapi_response->mapi_len += chained->length - sizeof (uint16_t);
+}
+
+
+/**
+   \details Pull the MAPI response from the rgbOut buffer of an
+   EcDoRpcExt2 call
+
+   Each extended buffer is deobfuscated and decompressed according to
+   its RPC_HEADER_EXT. When the server chained several buffers, their
+   ROP replies are returned in a single response.
+
+   \param mem_ctx pointer to the memory context
+   \param rgbOut pointer to the rgbOut data blob
+   \param repl pointer on pointer to the MAPI response the function
+   returns
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code emsmdb_pull_ext2_response(TALLOC_CTX *mem_ctx,
+						     DATA_BLOB *rgbOut,
+						     struct mapi_response **repl)
+{
+	struct ndr_pull		*ndr_pull;
+	struct mapi2k7_response	mapi2k7_response;
+	struct mapi_response	*mapi_response = NULL;
+	uint32_t		buffers = 0;
+
+	ndr_pull = ndr_pull_init_blob(rgbOut, mem_ctx);
+	NDR_ERR_HAVE_NO_MEMORY(ndr_pull);
+	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+
+	do {
+		NDR_CHECK(ndr_pull_mapi2k7_response(ndr_pull, NDR_SCALARS|NDR_BUFFERS, &mapi2k7_response));
+		if (!mapi_response) {
+			mapi_response = mapi2k7_response.mapi_response;
+		} else {
+			emsmdb_chain_response(mapi_response, mapi2k7_response.mapi_response);
+		}
+		buffers++;
+	} while (!(mapi2k7_response.header.Flags & RHEF_Last) && (ndr_pull->offset < ndr_pull->data_size));
+
+	if (buffers > 1) {
+		DEBUG(5, ("emsmdb_pull_ext2_response: %d chained buffers\n", buffers));
+	}
+
+	*repl = mapi_response;
+
+	return NDR_ERR_SUCCESS;
+}
+
+
+/**
+   \details Make a EMSMDB EXT2 transaction, optionally allowing the
+   server to chain extended buffers in its reply
 
    \param emsmdb_ctx pointer to the EMSMDB connection context
    \param mem_ctx pointer to the memory context
    \param req pointer to the MAPI request to send
    \param repl pointer on pointer to the MAPI reply returned by the
    server
+   \param chain whether the server may chain extended buffers
 
    \return NT_STATUS_OK on success, otherwise NT status error
  */
-_PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
-					  TALLOC_CTX *mem_ctx,
-					  struct mapi_request *req,
-					  struct mapi_response **repl)
+static NTSTATUS emsmdb_transaction_ext2_flags(struct emsmdb_context *emsmdb_ctx,
+					      TALLOC_CTX *mem_ctx,
+					      struct mapi_request *req,
+					      struct mapi_response **repl,
+					      bool chain)
 {
 	NTSTATUS		status;
 	struct EcDoRpcExt2	r;
-	struct mapi2k7_response	mapi2k7_response;
-	struct ndr_push		*ndr_uncomp_rgbIn;
-	struct ndr_push		*ndr_comp_rgbIn;
-	struct ndr_push		*ndr_rgbIn;
-	struct ndr_pull		*ndr_pull = NULL;
 	uint32_t		pulFlags = 0x0;
-	uint32_t		pcbOut = 0x8007;
-	uint32_t		pcbAuxOut = 0x1008;
+	uint32_t		pcbOut;
+	uint32_t		pcbAuxOut;
 	uint32_t		pulTransTime = 0;
+	DATA_BLOB		rgbIn;
 	DATA_BLOB		rgbOut;
-	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
-	enum ndr_err_code ndr_err;
+	bool			compressed;
+	enum ndr_err_code	ndr_err;
 
+start:
 	r.in.handle = r.out.handle = &emsmdb_ctx->handle;
-	r.in.pulFlags = r.out.pulFlags = &pulFlags;
 
-	/* Step 1. Push mapi_request in a data blob */
-	ndr_uncomp_rgbIn = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_uncomp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req);
+	/* Ask the server not to compress replies if compression is disabled */
+	pulFlags = emsmdb_ctx->compression ? 0x0 : pulFlags_NoCompression;
+	if (chain && (emsmdb_ctx->max_rgbout > EMSMDB_RGBOUT_DEFAULT_SIZE)) {
+		pulFlags |= pulFlags_Chain;
+	}
+	r.in.pulFlags = r.out.pulFlags = &pulFlags;
 
-	/* Step 2. Compress the blob */
-	/* 	ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx); */
-	/* 	ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn); */
+	ndr_err = emsmdb_push_ext2_request(mem_ctx, req, emsmdb_ctx->compression, &rgbIn, &compressed);
+	if (ndr_err != NDR_ERR_SUCCESS) {
+		return ndr_map_error2ntstatus(ndr_err);
+	}
 
-	/* If the compressed blob is larger than the uncompressed one, use obfuscation */
-	/* 	if (ndr_comp_rgbIn->offset > ndr_uncomp_rgbIn->offset) { */
-	/* 		talloc_free(ndr_comp_rgbIn); */
-	ndr_comp_rgbIn = ndr_uncomp_rgbIn;
-	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
-		
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
-	RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbIn->offset;
+	pcbOut = emsmdb_ctx->max_rgbout;
+	pcbAuxOut = 0x1008;
 
-	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset);
-		/* 	} else { */
-		/* 		RPC_HEADER_EXT.Version = 0x0000; */
-		/* 		RPC_HEADER_EXT.Flags = RHEF_Compressed|RHEF_Last; */
-		/* 		RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset; */
-		/* 		RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* 		ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* 		ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* 		ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* 		ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
-		/* 	} */
-
-		/* Plain request (no obfuscation or compression) */
-		/* ndr_comp_rgbIn = ndr_uncomp_rgbIn; */
-		/* RPC_HEADER_EXT.Version = 0x0000; */
-		/* RPC_HEADER_EXT.Flags = RHEF_Last; */
-		/* RPC_HEADER_EXT.Size = ndr_uncomp_rgbIn->offset; */
-		/* RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* Pull the complete rgbIn */
-		/* ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
-
-	r.in.rgbIn = ndr_rgbIn->data;
-	r.in.cbIn = ndr_rgbIn->offset;
+	r.in.rgbIn = rgbIn.data;
+	r.in.cbIn = rgbIn.length;
 	r.in.pcbOut = r.out.pcbOut = &pcbOut;
 
 	r.in.rgbAuxIn = NULL;
@@ -568,32 +695,146 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 	r.out.pulTransTime = &pulTransTime;
 
 	status = dcerpc_EcDoRpcExt2_r(emsmdb_ctx->rpc_connection->binding_handle, mem_ctx, &r);
-	talloc_free(ndr_rgbIn);
-	talloc_free(ndr_comp_rgbIn);
+	talloc_free(rgbIn.data);
 
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
+	} else if (r.out.result == ecRpcFormat && compressed) {
+		DEBUG(3, ("emsmdb_transaction_ext2: compressed request rejected, disabling compression\n"));
+		emsmdb_ctx->compression = false;
+		goto start;
 	} else if (r.out.result) {
 		return NT_STATUS_UNSUCCESSFUL;
 	}
 
+	emsmdb_ctx->transactions++;
+	emsmdb_ctx->rgbout_bytes += *r.out.pcbOut;
+
 	/* Pull MAPI response form rgbOut */
 	rgbOut.data = r.out.rgbOut;
 	rgbOut.length = *r.out.pcbOut;
-	ndr_pull = ndr_pull_init_blob(&rgbOut, mem_ctx);
-	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
 
-	ndr_err = ndr_pull_mapi2k7_response(ndr_pull, NDR_SCALARS|NDR_BUFFERS, &mapi2k7_response);
+	ndr_err = emsmdb_pull_ext2_response(mem_ctx, &rgbOut, repl);
 	if (ndr_err != NDR_ERR_SUCCESS) {
 		return ndr_map_error2ntstatus(ndr_err);
 	}
 
-	*repl = mapi2k7_response.mapi_response;
-
 	return status;
 }
 
 
+/**
+   \details Make a EMSMDB EXT2 transaction.
+
+   Requests are compressed when the session allows it. If the server
+   rejects a compressed request, compression is disabled for the
+   session and the request is sent again uncompressed.
+
+   \param emsmdb_ctx pointer to the EMSMDB connection context
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the MAPI request to send
+   \param repl pointer on pointer to the MAPI reply returned by the
+   server
+
+   \return NT_STATUS_OK on success, otherwise NT status error
+ */
+_PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
+					  TALLOC_CTX *mem_ctx,
+					  struct mapi_request *req,
+					  struct mapi_response **repl)
+{
+	return emsmdb_transaction_ext2_flags(emsmdb_ctx, mem_ctx, req, repl, false);
+}
+
+
+/**
+   \details Enable or disable the compression of EcDoRpcExt2
+   requests and replies for a session
+
+   Compression is enabled by default. It only applies to sessions
+   using EcDoRpcExt2 and is disabled automatically if the server
+   rejects compressed requests.
+
+   \param session pointer to the MAPI session context
+   \param compression whether compression should be used
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_set_compression(struct mapi_session *session, bool compression)
+{
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_SESSION_LIMIT, NULL);
+	OPENCHANGE_RETVAL_IF(!session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	((struct emsmdb_context *)session->emsmdb->ctx)->compression = compression;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Set the size of the rgbOut buffer requested by EcDoRpcExt2
+   calls of a session
+
+   Sizes above the default of 0x8007 bytes let the server chain
+   extended buffers in the replies of emsmdb_transaction_chained().
+   The size is bounded by EMSMDB_RGBOUT_DEFAULT_SIZE and
+   EMSMDB_RGBOUT_MAX_SIZE.
+
+   \param session pointer to the MAPI session context
+   \param size the requested rgbOut size in bytes
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_set_max_rgbout(struct mapi_session *session, uint32_t size)
+{
+	struct emsmdb_context	*emsmdb_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_SESSION_LIMIT, NULL);
+	OPENCHANGE_RETVAL_IF(!session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	if (size < EMSMDB_RGBOUT_DEFAULT_SIZE) {
+		size = EMSMDB_RGBOUT_DEFAULT_SIZE;
+	} else if (size > EMSMDB_RGBOUT_MAX_SIZE) {
+		size = EMSMDB_RGBOUT_MAX_SIZE;
+	}
+	emsmdb_ctx->max_rgbout = size;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the number of EcDoRpcExt2 calls made by a
+   session and the number of rgbOut bytes received
+
+   \param session pointer to the MAPI session context
+   \param transactions pointer to the number of calls returned
+   \param bytes pointer to the number of bytes returned
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_get_transaction_stats(struct mapi_session *session,
+						      uint32_t *transactions,
+						      uint64_t *bytes)
+{
+	struct emsmdb_context	*emsmdb_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_SESSION_LIMIT, NULL);
+	OPENCHANGE_RETVAL_IF(!session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!transactions || !bytes, MAPI_E_INVALID_PARAMETER, NULL);
+
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+	*transactions = emsmdb_ctx->transactions;
+	*bytes = emsmdb_ctx->rgbout_bytes;
+
+	return MAPI_E_SUCCESS;
+}
+
+
 _PUBLIC_ NTSTATUS emsmdb_transaction_wrapper(struct mapi_session *session,
 					     TALLOC_CTX *mem_ctx,
 					     struct mapi_request *req,
@@ -613,6 +854,41 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_wrapper(struct mapi_session *session,
 }
 
 
+/**
+   \details Make a EMSMDB transaction whose reply may hold chained
+   extended buffers
+
+   The server may execute the ROP of the request again and return each
+   result in a chained extended buffer, up to the rgbOut size set with
+   emsmdb_set_max_rgbout(). The replies of all buffers are returned in
+   the MAPI response, so callers must process every reply instead of
+   the first one only. Sessions not using EcDoRpcExt2 make a regular
+   transaction.
+
+   \param session pointer to the MAPI session context
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the MAPI request to send
+   \param repl pointer on pointer to the MAPI reply returned by the
+   server
+
+   \return NT_STATUS_OK on success, otherwise NT status error
+ */
+_PUBLIC_ NTSTATUS emsmdb_transaction_chained(struct mapi_session *session,
+					     TALLOC_CTX *mem_ctx,
+					     struct mapi_request *req,
+					     struct mapi_response **repl)
+{
+	if (session->emsmdb->ctx == NULL) return NT_STATUS_INVALID_PARAMETER;
+	switch (session->profile->exchange_version) {
+	case 0x1:
+	case 0x2:
+		return emsmdb_transaction_ext2_flags((struct emsmdb_context *)session->emsmdb->ctx, mem_ctx, req, repl, true);
+	default:
+		return emsmdb_transaction_wrapper(session, mem_ctx, req, repl);
+	}
+}
+
+
 /**
    \details Initialize the notify context structure and bind a local
    UDP port to receive notifications from the server
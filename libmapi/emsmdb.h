@@ -47,8 +47,19 @@ struct emsmdb_context {
 	struct emsmdb_info	info;
 	struct policy_handle	async_handle; ///< The handle to use for Async notification requests
 	struct dcerpc_pipe	*async_rpc_connection;
+	bool			compression; ///< Compress EcDoRpcExt2 requests and accept compressed replies
+	uint32_t		max_rgbout; ///< Size of the EcDoRpcExt2 rgbOut buffer requested from the server
+	uint32_t		transactions; ///< Number of EcDoRpcExt2 calls made
+	uint64_t		rgbout_bytes; ///< Number of rgbOut bytes received
 };
 
+/* EcDoRpcExt2 requests smaller than this are never compressed */
+#define	EMSMDB_COMPRESSION_THRESHOLD	1024
+
+/* Bounds of the EcDoRpcExt2 rgbOut buffer, [MS-OXCRPC] 3.1.4.2 */
+#define	EMSMDB_RGBOUT_DEFAULT_SIZE	0x8007
+#define	EMSMDB_RGBOUT_MAX_SIZE		0x40000
+
 #define	MAILBOX_PATH	"/o=%s/ou=%s/cn=Recipients/cn=%s"
 
 #endif /* __EMSMDB_H__ */
@@ -290,6 +290,12 @@ static bool pull_binary(struct fx_parser_context *parser, struct Binary_r *bin)
 */
 static bool fetch_property_value(struct fx_parser_context *parser, DATA_BLOB *buf, struct SPropValue *prop)
 {
+	/* MetaTagIdsetGiven is declared as PtypInteger32 but serialized
+	   as PtypBinary [MS-OXCFXICS] - 2.2.1.1.1 */
+	if (prop->ulPropTag == MetaTagIdsetGiven) {
+		return pull_binary(parser, &prop->value.bin);
+	}
+
 	switch(prop->ulPropTag & 0xFFFF) {
 	case PT_NULL:
 	{
@@ -548,6 +554,9 @@ _PUBLIC_ void fxparser_set_namedprop_callback(struct fx_parser_context *parser,
 
 /**
   \details set a callback function for property output
+
+  The value of MetaTagIdsetGiven is returned in value.bin, as it is
+  serialized as a binary property.
 */
 _PUBLIC_ void fxparser_set_property_callback(struct fx_parser_context *parser, fxparser_property_callback_t property_callback)
 {
@@ -612,6 +621,14 @@ _PUBLIC_ enum MAPISTATUS fxparser_parse(struct fx_parser_context *parser, DATA_B
 					case EndAttach:
 					case StartEmbed:
 					case EndEmbed:
+					case IncrSyncChg:
+					case IncrSyncChgPartial:
+					case IncrSyncDel:
+					case IncrSyncEnd:
+					case IncrSyncRead:
+					case IncrSyncStateBegin:
+					case IncrSyncStateEnd:
+					case IncrSyncMessage:
 						if (parser->op_marker) {
 							ms = parser->op_marker(parser->tag, parser->priv);
 						}
@@ -356,47 +356,72 @@ static void check_idset(const struct idset *idset)
 
 /**
   \details deserialize an IDSET following the format described in [OXCFXICS - 2.2.2.4]
+  and return the first idset of the list, or NULL if the buffer is invalid
 */
 _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool idbased)
 {
-	struct idset		*idset, *prev_idset = NULL;
-        DATA_BLOB		guid_blob, globset;
-	uint32_t		total_bytes, byte_count;
+	struct idset		*idset, *head = NULL, *prev_idset = NULL;
+	DATA_BLOB		guid_blob, globset;
+	uint32_t		total_bytes, byte_count, repl_size;
 
-	if (buffer.length < 17) return NULL;
+	/* each replica is a REPLID (2 bytes) or a REPLGUID (16 bytes) followed by a GLOBSET */
+	repl_size = idbased ? 2 : 16;
+	if (buffer.length <= repl_size) return NULL;
 
 	total_bytes = 0;
 	while (total_bytes < buffer.length) {
-		idset = talloc_zero(mem_ctx, struct idset);
-		if (prev_idset) {
-			prev_idset->next = idset;
+		if (buffer.length - total_bytes <= repl_size) {
+			DEBUG(4, ("%s: truncated idset at position %"PRIu32"\n", __FUNCTION__, total_bytes));
+			goto error;
 		}
 
+		idset = talloc_zero(mem_ctx, struct idset);
+		if (!idset) goto error;
+		idset->idbased = idbased;
+
 		if (idbased) {
 			idset->repl.id = (buffer.data[total_bytes] | (buffer.data[total_bytes+1] << 8));
-			total_bytes += 2;
 		}
 		else {
-			guid_blob.data = buffer.data;
+			guid_blob.data = buffer.data + total_bytes;
 			guid_blob.length = 16;
 			GUID_from_data_blob(&guid_blob, &idset->repl.guid);
-			total_bytes += 16;
 		}
+		total_bytes += repl_size;
 
-		globset.length = buffer.length - 16;
-		globset.data = (uint8_t *) buffer.data + 16;
+		globset.length = buffer.length - total_bytes;
+		globset.data = (uint8_t *) buffer.data + total_bytes;
+		byte_count = 0;
 		idset->ranges = GLOBSET_parse(idset, globset, &idset->range_count, &byte_count);
-		
+		if (byte_count == 0) {
+			/* GLOBSET_parse consumes at least the end command on success */
+			talloc_free(idset);
+			goto error;
+		}
 		total_bytes += byte_count;
 
 		check_idset(idset);
 
+		if (prev_idset) {
+			prev_idset->next = idset;
+		}
+		else {
+			head = idset;
+		}
 		prev_idset = idset;
 	}
 
-	IDSET_dump(idset, "freshly parsed");
+	IDSET_dump(head, "freshly parsed");
 
-	return idset;
+	return head;
+
+error:
+	while (head) {
+		idset = head->next;
+		talloc_free(head);
+		head = idset;
+	}
+	return NULL;
 }
 
 static int IDSET_ID_compar(const void *vap, const void *vbp)
@@ -873,12 +898,116 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 	return data;
 }
 
+static int IDSET_interval_compar(const void *vap, const void *vbp)
+{
+	const struct globset_interval *ap, *bp;
+
+	ap = (const struct globset_interval *) vap;
+	bp = (const struct globset_interval *) vbp;
+
+	if (ap->low < bp->low) {
+		return -1;
+	}
+	else if (ap->low == bp->low) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+  \details returns the sorted and compacted interval array of an idset
+  element, building it from its list of ranges on first use
+
+  The array is cached in the idset and dropped by
+  IDSET_invalidate_intervals whenever the ranges are modified in place.
+*/
+static const struct globset_interval *IDSET_get_intervals(const struct idset *idset, uint32_t *countP)
+{
+	struct idset		*cached_idset;
+	struct globset_interval	*intervals;
+	struct globset_range	*range;
+	uint32_t		i, last, count;
+
+	if (!idset->intervals) {
+		cached_idset = discard_const_p(struct idset, idset);
+		intervals = talloc_array(cached_idset, struct globset_interval, idset->range_count + 1);
+
+		count = 0;
+		for (range = idset->ranges; range && count < idset->range_count; range = range->next) {
+			intervals[count].low = exchange_globcnt(range->low);
+			intervals[count].high = exchange_globcnt(range->high);
+			/* placeholder ranges (low > high) do not include anything */
+			if (intervals[count].low <= intervals[count].high) {
+				count++;
+			}
+		}
+
+		if (count > 1) {
+			qsort(intervals, count, sizeof(struct globset_interval), IDSET_interval_compar);
+			last = 0;
+			for (i = 1; i < count; i++) {
+				if (intervals[i].low <= intervals[last].high + 1) {
+					if (intervals[i].high > intervals[last].high) {
+						intervals[last].high = intervals[i].high;
+					}
+				}
+				else {
+					last++;
+					intervals[last] = intervals[i];
+				}
+			}
+			count = last + 1;
+		}
+
+		cached_idset->intervals = intervals;
+		cached_idset->interval_count = count;
+	}
+
+	*countP = idset->interval_count;
+
+	return idset->intervals;
+}
+
+static void IDSET_invalidate_intervals(struct idset *idset)
+{
+	talloc_free(idset->intervals);
+	idset->intervals = NULL;
+	idset->interval_count = 0;
+}
+
+static bool IDSET_intervals_include(const struct idset *idset, uint64_t globcnt)
+{
+	const struct globset_interval	*intervals;
+	uint32_t			count, low, high, middle;
+	uint64_t			value;
+
+	intervals = IDSET_get_intervals(idset, &count);
+	value = exchange_globcnt(globcnt);
+
+	low = 0;
+	high = count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (value < intervals[middle].low) {
+			high = middle;
+		}
+		else if (value > intervals[middle].high) {
+			low = middle + 1;
+		}
+		else {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
   \details tests the presence of a specific id in the ranges of a ReplID-based idset structure
 */
 _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 {
-	struct globset_range *range;
 	uint16_t eid_id;
 	uint64_t eid_globcnt;
 
@@ -890,15 +1019,8 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 	eid_globcnt = eid >> 16;
 
 	while (idset) {
-		if (idset->repl.id == eid_id) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(eid_globcnt)
-				    && exchange_globcnt(range->high) >= exchange_globcnt(eid_globcnt)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (idset->repl.id == eid_id && IDSET_intervals_include(idset, eid_globcnt)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -911,8 +1033,6 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 */
 _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *replica_guid, uint64_t id)
 {
-	struct globset_range *range;
-
 	if (!idset || idset->idbased) {
 		return false;
 	}
@@ -921,14 +1041,8 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	}
 
 	while (idset) {
-		if (GUID_equal(&idset->repl.guid, replica_guid)) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(id) && exchange_globcnt(range->high) >= exchange_globcnt(id)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (GUID_equal(&idset->repl.guid, replica_guid) && IDSET_intervals_include(idset, id)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -936,6 +1050,95 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	return false;
 }
 
+/**
+  \details tests the presence of a list of ids in the ranges of a
+  ReplGUID-based idset structure
+
+  \param idset pointer to the idset
+  \param replica_guid the replica GUID the ids belong to
+  \param ids array of globcnt values
+  \param count number of elements in ids
+  \param included array of count booleans receiving the result for
+  each id
+
+  \return number of ids included in the idset
+*/
+_PUBLIC_ uint32_t IDSET_filter_guid_globs(const struct idset *idset, const struct GUID *replica_guid,
+					  const uint64_t *ids, uint32_t count, bool *included)
+{
+	uint32_t	i, found = 0;
+
+	if (!ids || !included) {
+		return 0;
+	}
+	memset(included, 0, sizeof(bool) * count);
+
+	if (!replica_guid) {
+		return 0;
+	}
+
+	/* only the element matching the replica can hold the ids */
+	while (idset && (idset->idbased || !GUID_equal(&idset->repl.guid, replica_guid))) {
+		idset = idset->next;
+	}
+	if (!idset) {
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		included[i] = IDSET_intervals_include(idset, ids[i]);
+		if (included[i]) {
+			found++;
+		}
+	}
+
+	return found;
+}
+
+/**
+  \details tests the presence of a list of ids in the ranges of a
+  ReplID-based idset structure
+
+  \param idset pointer to the idset
+  \param eids array of entry ids
+  \param count number of elements in eids
+  \param included array of count booleans receiving the result for
+  each eid
+
+  \return number of eids included in the idset
+*/
+_PUBLIC_ uint32_t IDSET_filter_eids(const struct idset *idset, const uint64_t *eids, uint32_t count, bool *included)
+{
+	const struct idset	*current = NULL;
+	uint32_t		i, found = 0;
+	uint16_t		eid_id;
+
+	if (!eids || !included) {
+		return 0;
+	}
+	memset(included, 0, sizeof(bool) * count);
+
+	if (!idset || !idset->idbased) {
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		eid_id = eids[i] & 0xffff;
+		if (!current || current->repl.id != eid_id) {
+			for (current = idset; current && current->repl.id != eid_id; current = current->next);
+			if (!current) {
+				continue;
+			}
+		}
+		included[i] = IDSET_intervals_include(current, eids[i] >> 16);
+		if (included[i]) {
+			found++;
+		}
+	}
+
+	return found;
+}
+
 static void IDSET_ranges_remove_globcnt(struct idset *idset, uint64_t eid) {
 	struct globset_range *range, *new_range;
 	bool done = false;
@@ -1015,6 +1218,7 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 		for (i = 0; i < rawidset->count; i++) {
 			IDSET_ranges_remove_globcnt(current_idset, rawidset->globcnts[i]);
 		}
+		IDSET_invalidate_intervals(current_idset);
 	}
 
 	check_idset(idset);
@@ -31,6 +31,9 @@ struct idset {
 	bool			single; /* single range */
 	uint32_t		range_count;
 	struct globset_range	*ranges;
+	/* sorted and compacted copy of ranges, built on first lookup */
+	uint32_t		interval_count;
+	struct globset_interval	*intervals;
 	struct idset		*next;
 };
 
@@ -41,6 +44,12 @@ struct globset_range {
 	struct globset_range	*next;
 };
 
+/* bounds are exchange_globcnt() values so they compare numerically */
+struct globset_interval {
+	uint64_t		low;
+	uint64_t		high;
+};
+
 struct rawidset {
 	TALLOC_CTX	*mem_ctx;
 	bool		idbased; /* replid-/replguid based */
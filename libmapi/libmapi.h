@@ -58,6 +58,7 @@
 #include "libmapi/mapi_provider.h"
 #include "libmapi/mapi_object.h"
 #include "libmapi/mapi_id_array.h"
+#include "libmapi/mapi_batch.h"
 #include "libmapi/mapi_notification.h"
 #include "libmapi/mapi_profile.h"
 #include "libmapi/mapidefs.h"
@@ -115,7 +116,11 @@ NTSTATUS		emsmdb_transaction_null(struct emsmdb_context *, struct mapi_response
 NTSTATUS		emsmdb_transaction(struct emsmdb_context *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 NTSTATUS		emsmdb_transaction_ext2(struct emsmdb_context *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 NTSTATUS		emsmdb_transaction_wrapper(struct mapi_session *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
+NTSTATUS		emsmdb_transaction_chained(struct mapi_session *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 struct emsmdb_info	*emsmdb_get_info(struct mapi_session *);
+enum MAPISTATUS		emsmdb_set_compression(struct mapi_session *, bool);
+enum MAPISTATUS		emsmdb_set_max_rgbout(struct mapi_session *, uint32_t);
+enum MAPISTATUS		emsmdb_get_transaction_stats(struct mapi_session *, uint32_t *, uint64_t *);
 void			emsmdb_get_SRowSet(TALLOC_CTX *, struct SRowSet *, struct SPropTagArray *, DATA_BLOB *);
 
 /* The following public definitions come from libmapi/cdo_mapi.c */
@@ -218,6 +223,15 @@ enum MAPISTATUS		mapi_id_array_add_id(mapi_id_array_t *, mapi_id_t);
 enum MAPISTATUS		mapi_id_array_del_id(mapi_id_array_t *, mapi_id_t);
 enum MAPISTATUS		mapi_id_array_del_obj(mapi_id_array_t *, mapi_object_t *);
 
+/* The following public definitions come from libmapi/mapi_batch.c */
+struct mapi_batch	*mapi_batch_init(TALLOC_CTX *, mapi_object_t *);
+enum MAPISTATUS		mapi_batch_OpenMessage(struct mapi_batch *, mapi_object_t *, mapi_id_t, mapi_id_t, mapi_object_t *, uint8_t, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_GetProps(struct mapi_batch *, mapi_object_t *, uint32_t, struct SPropTagArray *, struct SPropValue **, uint32_t *, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_GetAttachmentTable(struct mapi_batch *, mapi_object_t *, mapi_object_t *, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_Release(struct mapi_batch *, mapi_object_t *);
+enum MAPISTATUS		mapi_batch_dispatch(struct mapi_batch *);
+enum MAPISTATUS		mapi_batch_get_stats(struct mapi_batch *, uint32_t *, uint32_t *);
+
 /* The following public definitions come from libmapi/mapi_nameid.c */
 struct mapi_nameid	*mapi_nameid_new(TALLOC_CTX *);
 enum MAPISTATUS		mapi_nameid_OOM_add(struct mapi_nameid *, const char *, const char *);
@@ -503,9 +517,19 @@ char			*x500_get_servername(const char *);
 /* The following public definitions come from libmapi/lzfu.c */
 enum MAPISTATUS		WrapCompressedRTFStream(mapi_object_t *, DATA_BLOB *);
 enum MAPISTATUS		uncompress_rtf(TALLOC_CTX *, uint8_t *, uint32_t, DATA_BLOB *);
+struct lzfu_stream;
+struct lzfu_stream	*uncompress_rtf_stream_init(TALLOC_CTX *);
+uint32_t		uncompress_rtf_stream_raw_size(struct lzfu_stream *);
+enum MAPISTATUS		uncompress_rtf_stream(struct lzfu_stream *, const uint8_t *, uint32_t, uint32_t *, uint8_t *, uint32_t, uint32_t *, bool *);
 uint32_t		calculateCRC(uint8_t *, uint32_t, uint32_t);
+uint32_t		updateCRC(uint32_t, const uint8_t *, uint32_t);
 enum MAPISTATUS		compress_rtf(TALLOC_CTX *, const char*, const size_t, uint8_t **, size_t *);
 
+/* The following public definitions come from libmapi/lzxpress.c */
+#define	LZXPRESS_COMPRESS_BOUND(x)	((x) + ((x) / 8) + 8)
+ssize_t			lzxpress_compress_buffer(const uint8_t *, uint32_t, uint8_t *, uint32_t);
+ssize_t			lzxpress_decompress_buffer(const uint8_t *, uint32_t, uint8_t *, uint32_t);
+
 /* The following public definitions come from libmapi/utils.c */
 char			*guid_delete_dash(TALLOC_CTX *, const char *);
 struct Binary_r		*generate_recipient_entryid(TALLOC_CTX *, const char *);
@@ -546,6 +570,8 @@ struct idset *		IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idset *, co
 struct Binary_r *	IDSET_serialize(TALLOC_CTX *, const struct idset *);
 bool			IDSET_includes_guid_glob(const struct idset *, struct GUID *, uint64_t);
 bool			IDSET_includes_eid(const struct idset *, uint64_t);
+uint32_t		IDSET_filter_guid_globs(const struct idset *, const struct GUID *, const uint64_t *, uint32_t, bool *);
+uint32_t		IDSET_filter_eids(const struct idset *, const uint64_t *, uint32_t, bool *);
 void			IDSET_remove_rawidset(struct idset *, const struct rawidset *);
 void			IDSET_dump(const struct idset *, const char *);
 void			ndr_push_idset(struct ndr_push *, struct idset *);
@@ -73,6 +73,8 @@ struct emsmdb_context	*emsmdb_connect(TALLOC_CTX *, struct mapi_session *, struc
 struct emsmdb_context	*emsmdb_connect_ex(TALLOC_CTX *, struct mapi_session *, struct dcerpc_pipe *, struct cli_credentials *, int *);
 int			emsmdb_disconnect_dtor(void *);
 enum MAPISTATUS		emsmdb_disconnect(struct emsmdb_context *);
+enum ndr_err_code	emsmdb_push_ext2_request(TALLOC_CTX *, struct mapi_request *, bool, DATA_BLOB *, bool *);
+enum ndr_err_code	emsmdb_pull_ext2_response(TALLOC_CTX *, DATA_BLOB *, struct mapi_response **);
 struct mapi_notify_ctx	*emsmdb_bind_notification(struct mapi_context *, TALLOC_CTX *);
 NTSTATUS		emsmdb_register_notification(struct mapi_session *, struct NOTIFKEY *);
 void			free_emsmdb_property(struct SPropValue *, void *);
@@ -118,10 +120,16 @@ uint32_t		get_mapi_SRestriction_size(struct mapi_SRestriction *);
 enum MAPISTATUS		Logon(struct mapi_session *, struct mapi_provider *, enum PROVIDER_ID);
 enum MAPISTATUS		GetNewLogonId(struct mapi_session *, uint8_t *);
 
+/* The following private definitions come from libmapi/IStoreFolder.c */
+mapi_object_message_t	*OpenMessage_get_message(struct mapi_session *, struct OpenMessage_repl *);
+
 /* The following private definitions come from libmapi/IMessage.c */
 uint8_t			mapi_recipients_get_org_length(struct mapi_profile *);
 uint16_t		mapi_recipients_RecipientFlags(struct SRow *);
 
+/* The following private definitions come from libmapi/mapi_batch.c */
+struct mapi_request	*mapi_batch_build_request(TALLOC_CTX *, struct mapi_batch *, uint32_t, uint32_t **);
+
 /* The following private definitions come from libmapi/socket/interface.c  */
 void			openchange_load_interfaces(TALLOC_CTX *, const char **, struct interface **);
 int			iface_count(struct interface *);
@@ -106,13 +106,19 @@ _PUBLIC_ enum MAPISTATUS WrapCompressedRTFStream(mapi_object_t *obj_stream,
 	struct mapi_context	*mapi_ctx;
 	struct mapi_session	*session;
 	TALLOC_CTX		*mem_ctx;
-	uint32_t		in_size;
-	uint8_t			*rtfcomp;
+	struct lzfu_stream	*stream;
+	uint32_t		in_used;
+	uint32_t		out_used;
+	uint32_t		out_size = 0;
+	uint32_t		in_total = 0;
+	uint32_t		offset;
 	uint16_t		read_size;
+	bool			done = false;
 	unsigned char		buf[0x1000];
 
 	/* sanity check and init */
 	OPENCHANGE_RETVAL_IF(!obj_stream, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!rtf, MAPI_E_INVALID_PARAMETER, NULL);
 
 	session = mapi_object_get_session(obj_stream);
 	OPENCHANGE_RETVAL_IF(!session, MAPI_E_NOT_INITIALIZED, NULL);
@@ -122,70 +128,95 @@ _PUBLIC_ enum MAPISTATUS WrapCompressedRTFStream(mapi_object_t *obj_stream,
 
 	mem_ctx = mapi_ctx->mem_ctx;
 
-	/* Read the stream pointed by obj_stream */
-	read_size = 0;
-	in_size = 0;
-	rtfcomp = talloc_zero(mem_ctx, uint8_t);
+	stream = uncompress_rtf_stream_init(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!stream, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	rtf->data = NULL;
+	rtf->length = 0;
+
+	/* Decompress the stream pointed by obj_stream as it is read */
 	do {
 		retval = ReadStream(obj_stream, buf, 0x1000, &read_size);
-		OPENCHANGE_RETVAL_IF(retval, GetLastError(), rtf->data);
-		if (read_size) {
-			rtfcomp = talloc_realloc(mem_ctx, rtfcomp, uint8_t, 
-						   in_size + read_size);
-			memcpy(&(rtfcomp[in_size]), buf, read_size);
-			in_size += read_size;
+		if (retval) goto end;
+
+		offset = 0;
+		while (offset < read_size && !done) {
+			/* The output buffer is sized once the header is read */
+			if (!rtf->data && in_total >= LZFU_HEADERLENGTH) {
+				out_size = uncompress_rtf_stream_raw_size(stream) + LZFU_HEADERLENGTH + 4;
+				rtf->data = talloc_array(mem_ctx, uint8_t, out_size);
+				if (!rtf->data) {
+					retval = MAPI_E_NOT_ENOUGH_MEMORY;
+					goto end;
+				}
+			}
+
+			retval = uncompress_rtf_stream(stream, buf + offset, read_size - offset, &in_used,
+						       rtf->data ? rtf->data + rtf->length : NULL,
+						       out_size - rtf->length, &out_used, &done);
+			if (retval) goto end;
+			if (!in_used && !out_used) {
+				/* the output buffer is full */
+				retval = MAPI_E_CORRUPT_DATA;
+				goto end;
+			}
+			offset += in_used;
+			in_total += in_used;
+			rtf->length += out_used;
+		}
+		if (offset < read_size) {
+			DEBUG(0, ("in_size mismatch: data past cbSize at offset %u\n", in_total));
+			retval = MAPI_E_CORRUPT_DATA;
+			goto end;
 		}
 	} while (read_size);
 
-	return uncompress_rtf(mem_ctx, rtfcomp, in_size, rtf);
-}
-
-typedef struct _decompression_state {
-	uint8_t*	dict;
-	uint32_t	dict_writeoffset;
-	uint8_t*	compressed_data;
-	uint32_t	in_size;
-	uint32_t	in_pos;
-} decompression_state;
-
-/**
-  Initialise the decompression_state
-  
-  \param mem_ctx the memory context to allocate the decompression state on
-  \param dict the resulting decompression_state
-*/
-static void initialise_decompression_state(TALLOC_CTX *mem_ctx, uint8_t *compressed_data,
-					   uint32_t in_size, decompression_state *state)
-{
-	state->dict = talloc_array(mem_ctx, uint8_t, LZFU_DICTLENGTH);
+	if (!done) {
+		DEBUG(0, ("in_size mismatch: stream truncated at %u bytes\n", in_total));
+		retval = MAPI_E_CORRUPT_DATA;
+		goto end;
+	}
 
-	memcpy(state->dict, LZFU_INITDICT, LZFU_INITLENGTH);
-	state->dict_writeoffset = LZFU_INITLENGTH;
-	
-	state->compressed_data = compressed_data;
-	state->in_size = in_size;
-	state->in_pos = LZFU_HEADERLENGTH;
-}
+	/* Do not add \0 twice */
+	if (rtf->length && rtf->data[rtf->length - 1]) {
+		if (rtf->length == out_size) {
+			retval = MAPI_E_CORRUPT_DATA;
+			goto end;
+		}
+		rtf->data[rtf->length++] = '\0';
+	}
 
-static void cleanup_decompression_state(decompression_state *state)
-{
-	talloc_free(state->dict);
+	retval = MAPI_E_SUCCESS;
+end:
+	talloc_free(stream);
+	if (retval) {
+		talloc_free(rtf->data);
+		rtf->data = NULL;
+		rtf->length = 0;
+		OPENCHANGE_RETVAL_ERR(retval, NULL);
+	}
+	return MAPI_E_SUCCESS;
 }
 
-typedef struct _output_state {
-	uint32_t	out_size;
-	uint32_t	out_pos;
-	DATA_BLOB	*output_blob;
-} output_state;
-
-static void initialise_output_state(TALLOC_CTX *mem_ctx, output_state *state, uint32_t rawSize, DATA_BLOB *output_blob)
-{
-	state->out_pos = 0;
-	state->out_size = rawSize + LZFU_HEADERLENGTH + 4;
-	output_blob->data = (uint8_t *) talloc_size(mem_ctx, state->out_size);
-	output_blob->length = 0;
-	state->output_blob = output_blob;
-}
+/*
+  Incremental decompression state. Input can be fed in chunks of any
+  size: a control byte or dictionary reference split across two
+  chunks is kept here until complete.
+ */
+struct lzfu_stream {
+	uint8_t		dict[LZFU_DICTLENGTH];
+	uint32_t	dict_writeoffset;
+	uint8_t		header_data[LZFU_HEADERLENGTH];
+	uint32_t	header_length;
+	lzfuheader	header;
+	uint8_t		control;
+	uint8_t		control_bit;
+	uint8_t		ref[2];
+	uint8_t		ref_length;
+	uint32_t	in_total;
+	uint32_t	out_total;
+	bool		done;
+};
 
 static void parse_header(uint8_t *header_data, lzfuheader *header)
 {
@@ -220,170 +251,296 @@ static enum MAPISTATUS verify_header(uint8_t *header_data, uint32_t in_size, lzf
 	return MAPI_E_SUCCESS;
 }
 
-static uint8_t get_next_byte(decompression_state *state)
-{
-	if (state->in_pos > state->in_size) {
-		return 0;
-	}  
-	uint8_t next_byte = state->compressed_data[state->in_pos];
-	state->in_pos += 1;
-	return next_byte;
-}
+/**
+   \details Initialize a Compressed RTF decompression stream
 
-static uint8_t get_next_control(decompression_state *state)
-{
-	uint8_t c = get_next_byte(state);
-	/* DEBUG(3, ("control: 0x%02x\n", c)); */
-	return c;
-}
+   \param mem_ctx pointer to the memory context
 
-static uint8_t get_next_literal(decompression_state *state)
+   \return Allocated decompression stream on success, otherwise NULL
+ */
+_PUBLIC_ struct lzfu_stream *uncompress_rtf_stream_init(TALLOC_CTX *mem_ctx)
 {
-	uint8_t c = get_next_byte(state);
-	/* if (isprint(c)) {
-		DEBUG(3, ("literal %c\n", c));
-	} else {
-		DEBUG(3, ("literal 0x%02x\n", c));
-		} */
-	return c;
-}
+	struct lzfu_stream	*stream;
 
-typedef struct _dictionaryref {
-	uint8_t		length;
-	uint16_t	 offset;
-} dictionaryref;
+	stream = talloc_zero(mem_ctx, struct lzfu_stream);
+	if (!stream) return NULL;
 
-static dictionaryref get_next_dictionary_reference(decompression_state *state)
-{
-	dictionaryref reference;
-	uint8_t highbyte = get_next_byte(state);
-	uint8_t lowbyte = get_next_byte(state);
-	reference.length = lowbyte & 0x0F; /* low 4 bits are length */
-	reference.length += 2; /* stored as two less than actual length */
-	reference.offset = ((highbyte << 8) + lowbyte);
-	reference.offset &= 0xFFF0; /* high 12 bits are offset */
-	reference.offset >>= 4; /* shift the offset down */
-	return reference;
-}
+	memcpy(stream->dict, LZFU_INITDICT, LZFU_INITLENGTH);
+	stream->dict_writeoffset = LZFU_INITLENGTH;
 
-static void append_to_dictionary(decompression_state *state, char c)
-{
-	state->dict[state->dict_writeoffset] = c;
-	state->dict_writeoffset = (state->dict_writeoffset + 1) % LZFU_DICTLENGTH;
+	return stream;
 }
 
-static void append_to_output(output_state *output, char c)
-{
-	output->output_blob->data[output->out_pos] = c;
-	output->out_pos += 1;
-	output->output_blob->length += 1;
-}
 
-static char get_latest_literal_in_output(output_state output)
-{
-        if (!output.out_pos) return 0;
+/**
+   \details Return the uncompressed size announced in the Compressed
+   RTF header
 
-        return output.output_blob->data[output.out_pos-1];
-}
+   \param stream pointer to the decompression stream
 
-static char get_dictionary_entry(decompression_state *state, uint32_t index)
+   \return uncompressed size, or 0 if the header has not been read yet
+ */
+_PUBLIC_ uint32_t uncompress_rtf_stream_raw_size(struct lzfu_stream *stream)
 {
-	char c = state->dict[index % LZFU_DICTLENGTH];
-	/* if (isprint(c)) {
-		DEBUG(3, ("dict entry %i: %c\n", index, c));
-	} else {
-		DEBUG(3, ("dict entry 0x%04x: 0x%02x\n", index, c));
-		} */
-	return c;
+	if (!stream || stream->header_length < LZFU_HEADERLENGTH) return 0;
+
+	return stream->header.cbRawSize;
 }
 
-static bool output_would_overflow(output_state *output)
+
+/**
+   \details Decompress a chunk of Compressed RTF data into a caller
+   supplied buffer
+
+   Decompression stops when the input is exhausted, when the output
+   buffer cannot hold the next literal or dictionary reference, or
+   when the end marker is reached. The caller then feeds the remaining
+   input, possibly with a new output buffer.
+
+   No input is consumed past the cbSize bytes announced in the
+   header, and the stream is only done once all of them have been
+   consumed: a caller left with unused input once done, or running out
+   of input before, is given a corrupted stream.
+
+   \param stream pointer to the decompression stream
+   \param input pointer to the compressed data chunk
+   \param input_size size of the compressed data chunk
+   \param input_used pointer to the number of input bytes consumed
+   \param output pointer to the output buffer
+   \param output_size size of the output buffer
+   \param output_used pointer to the number of bytes written to output
+   \param done pointer to a boolean set to true once the end marker
+   has been reached
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error. Possible
+   MAPI error codes are:
+   - MAPI_E_INVALID_PARAMETER: one of the parameters is not valid
+   - MAPI_E_CORRUPT_DATA: the header is invalid, or cbSize ends
+     before the end of the compressed data
+ */
+_PUBLIC_ enum MAPISTATUS uncompress_rtf_stream(struct lzfu_stream *stream,
+					       const uint8_t *input, uint32_t input_size,
+					       uint32_t *input_used,
+					       uint8_t *output, uint32_t output_size,
+					       uint32_t *output_used, bool *done)
 {
-	bool would_overflow = (output->out_pos > output->out_size);
-	if (would_overflow) {
-		DEBUG(0, (" overrun on out_pos: %u > %u\n", output->out_pos, output->out_size));
-		DEBUG(0, (" overrun data: %s\n", output->output_blob->data));
+	uint8_t		*dict;
+	uint32_t	dict_writeoffset;
+	uint8_t		control;
+	uint8_t		control_bit;
+	uint8_t		c;
+	uint16_t	ref;
+	uint32_t	in_pos = 0;
+	uint32_t	out_pos = 0;
+	uint32_t	length;
+	uint32_t	offset;
+	uint32_t	remaining;
+	uint32_t	i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!stream, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!input && input_size, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!output && output_size, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!input_used || !output_used || !done, MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Read the header */
+	if (stream->header_length < LZFU_HEADERLENGTH) {
+		length = LZFU_HEADERLENGTH - stream->header_length;
+		if (length > input_size) {
+			length = input_size;
+		}
+		memcpy(stream->header_data + stream->header_length, input, length);
+		stream->header_length += length;
+		in_pos += length;
+
+		if (stream->header_length == LZFU_HEADERLENGTH) {
+			parse_header(stream->header_data, &stream->header);
+			if ((stream->header.dwMagic != LZFU_COMPRESSED) && (stream->header.dwMagic != LZFU_UNCOMPRESSED)) {
+				DEBUG(0, ("bad magic: 0x%x\n", stream->header.dwMagic));
+				OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
+			}
+			/* cbSize does not count itself */
+			if (stream->header.cbSize < LZFU_HEADERLENGTH - 4 || stream->header.cbSize > UINT32_MAX - 4) {
+				DEBUG(0, ("bad cbSize: %u\n", stream->header.cbSize));
+				OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
+			}
+			if (stream->header.dwMagic == LZFU_UNCOMPRESSED &&
+			    stream->header.cbRawSize > stream->header.cbSize - (LZFU_HEADERLENGTH - 4)) {
+				DEBUG(0, ("bad cbRawSize: %u > cbSize %u\n", stream->header.cbRawSize, stream->header.cbSize));
+				OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
+			}
+		}
 	}
-	return would_overflow;
-}
 
-static bool input_would_overflow(decompression_state *state)
-{
-	bool would_overflow = (state->in_pos > state->in_size);
-	if (would_overflow) {
-		DEBUG(0, ("input overrun at in_pos: %i (of %i)\n", state->in_pos, state->in_size));
+	/* Never read past cbSize */
+	if (stream->header_length == LZFU_HEADERLENGTH) {
+		remaining = stream->header.cbSize + 4 - (stream->in_total + in_pos);
+		if (input_size - in_pos > remaining) {
+			input_size = in_pos + remaining;
+		}
 	}
-	return would_overflow;
+
+	/* Step 2. Uncompressed data is copied as is */
+	if (stream->header_length == LZFU_HEADERLENGTH && stream->header.dwMagic == LZFU_UNCOMPRESSED) {
+		length = stream->header.cbRawSize - stream->out_total;
+		if (length > input_size - in_pos) {
+			length = input_size - in_pos;
+		}
+		if (length > output_size) {
+			length = output_size;
+		}
+		memcpy(output, input + in_pos, length);
+		in_pos += length;
+		out_pos += length;
+		stream->out_total += length;
+		stream->done = (stream->out_total == stream->header.cbRawSize);
+	}
+
+	/* Step 3. Decode literals and dictionary references */
+	if (stream->header_length == LZFU_HEADERLENGTH && stream->header.dwMagic == LZFU_COMPRESSED &&
+	    !stream->done) {
+		dict = stream->dict;
+		dict_writeoffset = stream->dict_writeoffset;
+		control = stream->control;
+		control_bit = stream->control_bit;
+
+		while (true) {
+			if (!control_bit) {
+				if (in_pos == input_size) break;
+				control = input[in_pos++];
+				control_bit = 0x01;
+			}
+
+			if (control & control_bit) {
+				/* dictionary reference, possibly split
+				 * across two input chunks */
+				if (!stream->ref_length && in_pos + 2 <= input_size) {
+					ref = (input[in_pos] << 8) | input[in_pos + 1];
+					in_pos += 2;
+				} else {
+					while (stream->ref_length < 2 && in_pos < input_size) {
+						stream->ref[stream->ref_length++] = input[in_pos++];
+					}
+					if (stream->ref_length < 2) break;
+					ref = (stream->ref[0] << 8) | stream->ref[1];
+					stream->ref_length = 0;
+				}
+
+				/* high 12 bits are offset, low 4 bits are length
+				 * stored as two less than actual length */
+				offset = ref >> 4;
+				length = (ref & 0x0F) + 2;
+				if (offset == dict_writeoffset) {
+					DEBUG(4, ("matching offset - done\n"));
+					stream->done = true;
+					break;
+				}
+				if (length > output_size - out_pos) {
+					/* keep the reference until there is room */
+					stream->ref[0] = ref >> 8;
+					stream->ref[1] = ref & 0xFF;
+					stream->ref_length = 2;
+					break;
+				}
+
+				for (i = 0; i < length; i++) {
+					c = dict[(offset + i) % LZFU_DICTLENGTH];
+					output[out_pos++] = c;
+					dict[dict_writeoffset] = c;
+					dict_writeoffset = (dict_writeoffset + 1) % LZFU_DICTLENGTH;
+				}
+			} else {
+				/* literal */
+				if (in_pos == input_size || out_pos == output_size) break;
+				c = input[in_pos++];
+				output[out_pos++] = c;
+				dict[dict_writeoffset] = c;
+				dict_writeoffset = (dict_writeoffset + 1) % LZFU_DICTLENGTH;
+			}
+			control_bit <<= 1;
+		}
+
+		stream->dict_writeoffset = dict_writeoffset;
+		stream->control = control;
+		stream->control_bit = control_bit;
+	}
+
+	/* Step 4. Skip the padding left after the end of the data */
+	if (stream->done) {
+		in_pos = input_size;
+	}
+	stream->in_total += in_pos;
+
+	if (stream->header_length == LZFU_HEADERLENGTH &&
+	    stream->in_total == stream->header.cbSize + 4 &&
+	    !stream->done && stream->ref_length != 2) {
+		DEBUG(0, ("in_size mismatch: end of data not reached within cbSize %u\n", stream->header.cbSize));
+		OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
+	}
+
+	*input_used = in_pos;
+	*output_used = out_pos;
+	*done = stream->done && (stream->in_total == stream->header.cbSize + 4);
+
+	return MAPI_E_SUCCESS;
 }
 
+
+/**
+   \details Decompress a Compressed RTF buffer
+
+   \param mem_ctx pointer to the memory context
+   \param rtfcomp pointer to the compressed data
+   \param in_size size of the compressed data
+   \param rtf pointer to the blob receiving the uncompressed data,
+   including a trailing null character
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_CORRUPT_DATA
+ */
 _PUBLIC_ enum MAPISTATUS uncompress_rtf(TALLOC_CTX *mem_ctx, 
 					 uint8_t *rtfcomp, uint32_t in_size,
 					 DATA_BLOB *rtf)
 {
-	lzfuheader		lzfuhdr;
-	decompression_state	state;
-	uint8_t			bitmask_pos;
-	output_state		output;
-
 	enum MAPISTATUS		retval;
+	lzfuheader		lzfuhdr;
+	struct lzfu_stream	*stream;
+	uint32_t		in_used;
+	uint32_t		out_used;
+	uint32_t		out_size;
+	bool			done = false;
 
 	if (in_size < sizeof(lzfuhdr)+1) {
 		OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
 	}
 
-	initialise_decompression_state(mem_ctx, rtfcomp, in_size, &state);
-
-	retval = verify_header(rtfcomp, state.in_size, &lzfuhdr);
+	retval = verify_header(rtfcomp, in_size, &lzfuhdr);
 	if (retval != MAPI_E_SUCCESS) {
-		cleanup_decompression_state(&state);
 		return retval;
 	}
 
-	if (lzfuhdr.dwMagic == LZFU_UNCOMPRESSED) {
-		// TODO: handle uncompressed case
+	stream = uncompress_rtf_stream_init(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!stream, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	out_size = lzfuhdr.cbRawSize + LZFU_HEADERLENGTH + 4;
+	rtf->data = talloc_array(mem_ctx, uint8_t, out_size);
+	rtf->length = 0;
+	OPENCHANGE_RETVAL_IF(!rtf->data, MAPI_E_NOT_ENOUGH_MEMORY, stream);
+
+	retval = uncompress_rtf_stream(stream, rtfcomp, in_size, &in_used,
+				       rtf->data, out_size - 1, &out_used, &done);
+	talloc_free(stream);
+	if (retval || !done) {
+		DEBUG(0, (" overrun on out_pos: %u > %u\n", out_used, out_size - 1));
+		talloc_free(rtf->data);
+		rtf->data = NULL;
+		OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_DATA, NULL);
 	}
+	rtf->length = out_used;
 
-	initialise_output_state(mem_ctx, &output, lzfuhdr.cbRawSize, rtf);
-
-	while ((state.in_pos + 1) < state.in_size) {
-		uint8_t control = get_next_control(&state);
-		for(bitmask_pos = 0; bitmask_pos < 8; ++bitmask_pos) {
-			if (control & ( 1 << bitmask_pos)) { /* its a dictionary reference */
-				dictionaryref dictref;
-				int i;
-				dictref = get_next_dictionary_reference(&state);
-				if (dictref.offset == state.dict_writeoffset) {
-					DEBUG(4, ("matching offset - done\n"));
-                                        /* Do not add \0 twice */
-                                        if (get_latest_literal_in_output(output)) {
-                                                append_to_output(&output, '\0');
-                                        }
-					cleanup_decompression_state(&state);
-					return MAPI_E_SUCCESS;
-				}
-				for (i = 0; i < dictref.length; ++i) {
-					if (output_would_overflow(&output)) {
-						cleanup_decompression_state(&state);
-						return MAPI_E_CORRUPT_DATA;
-					}
-					char c = get_dictionary_entry(&state, (dictref.offset + i));
-					append_to_output(&output, c);
-					append_to_dictionary(&state, c);
-				}
-			} else { /* its a literal */
-				if ( output_would_overflow(&output) || input_would_overflow(&state) ) {
-					cleanup_decompression_state(&state);
-					talloc_free(rtf->data);
-					return MAPI_E_CORRUPT_DATA;
-				}
-				char c = get_next_literal(&state);
-				append_to_output(&output, c);
-				append_to_dictionary(&state, c);
-			}
-		}
+	/* Do not add \0 twice */
+	if (done && rtf->length && rtf->data[rtf->length - 1]) {
+		rtf->data[rtf->length++] = '\0';
 	}
-	
-	cleanup_decompression_state(&state);
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_SUCCESS, NULL);
 }
@@ -471,110 +628,242 @@ uint32_t calculateCRC(uint8_t *input, uint32_t offset, uint32_t length)
 	}
 	return crc;
 }
-#define MIN(a,b) ((a) < (b) ? (a) : (b))
 
-static size_t longest_match(const char *rtf, const size_t rtf_size, size_t input_idx, uint8_t *dict, size_t *dict_write_idx, size_t *dict_match_offset, size_t *dict_match_length)
+/**
+   \details Update a CRC-32 with the specified data
+
+   Unlike calculateCRC, the initial value is provided by the caller so
+   the CRC of data processed in several chunks can be computed.
+
+   \param crc the CRC of the preceding data, or the initial value
+   \param input pointer to the data
+   \param length the length of the data
+
+   \return the updated CRC
+ */
+uint32_t updateCRC(uint32_t crc, const uint8_t *input, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++) {
+		crc = CRCTable[(crc ^ input[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+#define	LZFU_MIN_MATCH		2
+#define	LZFU_MAX_MATCH		17
+#define	LZFU_HASH_BITS		12
+#define	LZFU_HASH_SIZE		(1 << LZFU_HASH_BITS)
+#define	LZFU_HASH(p)		((((uint32_t)(p)[0] << 16 | (uint32_t)(p)[1] << 8 | (uint32_t)(p)[2]) * 2654435761U) >> (32 - LZFU_HASH_BITS))
+#define	LZFU_DIGRAM(p)		((uint32_t)(p)[0] << 8 | (uint32_t)(p)[1])
+
+/*
+  Positions below are offsets in the stream made of the initial
+  dictionary followed by the RTF input, so that the dictionary write
+  offset is always the stream position modulo LZFU_DICTLENGTH. The
+  compressor only references the part of the dictionary written since
+  the write offset last wrapped to 0, which is a contiguous range of
+  that stream: [window, pos).
+
+  Tables store positions plus one, 0 standing for an empty entry, and
+  entries below the window are stale. 3-byte hash chains are kept in
+  ascending order so that the first match reaching the maximum length
+  is also the one with the lowest dictionary offset.
+ */
+struct lzfu_match_finder {
+	const uint8_t	*stream;
+	uint32_t	stream_size;
+	uint32_t	window;
+	uint32_t	head[LZFU_HASH_SIZE];
+	uint32_t	tail[LZFU_HASH_SIZE];
+	uint32_t	next[LZFU_DICTLENGTH];
+	uint32_t	digram[0x10000];
+};
+
+static void lzfu_insert(struct lzfu_match_finder *mf, uint32_t pos)
+{
+	uint32_t	h;
+	uint32_t	d;
+
+	if (pos + 1 >= mf->stream_size) return;
+
+	d = LZFU_DIGRAM(mf->stream + pos);
+	if (mf->digram[d] <= mf->window) {
+		mf->digram[d] = pos + 1;
+	}
+
+	if (pos + 2 >= mf->stream_size) return;
+
+	h = LZFU_HASH(mf->stream + pos);
+	mf->next[pos % LZFU_DICTLENGTH] = 0;
+	if (mf->head[h] <= mf->window) {
+		mf->head[h] = pos + 1;
+	} else {
+		mf->next[(mf->tail[h] - 1) % LZFU_DICTLENGTH] = pos + 1;
+	}
+	mf->tail[h] = pos + 1;
+}
+
+static uint32_t lzfu_longest_match(struct lzfu_match_finder *mf, uint32_t pos, uint32_t *match_offset)
 {
-	size_t best_match_length = 0;
-	size_t dict_iterator;
-	for (dict_iterator = 0; dict_iterator < MIN(*dict_write_idx, LZFU_DICTLENGTH); ++dict_iterator) {
-		size_t match_length_from_this_pos = 0;
-		while ((rtf[input_idx + match_length_from_this_pos] == dict[dict_iterator + match_length_from_this_pos]) &&
-		       ((dict_iterator + match_length_from_this_pos) < ((*dict_write_idx) % LZFU_DICTLENGTH)) && /* does this line need to have % LZFU_DICTLENGTH? */
-		       ((input_idx + match_length_from_this_pos) < rtf_size) && 
-		       (match_length_from_this_pos < 17)) {
-			match_length_from_this_pos += 1;
-			if (match_length_from_this_pos > best_match_length) {
-				best_match_length = match_length_from_this_pos;
-				dict[(*dict_write_idx) % LZFU_DICTLENGTH] = rtf[input_idx + match_length_from_this_pos - 1];
-				*dict_write_idx += 1;
-				*dict_match_offset = dict_iterator;
+	const uint8_t	*stream = mf->stream;
+	uint32_t	max_len;
+	uint32_t	best_len = 0;
+	uint32_t	candidate;
+	uint32_t	len;
+
+	/* A match can neither run past the end of the input, nor past
+	 * the end of the dictionary buffer */
+	max_len = mf->stream_size - pos;
+	if (max_len > LZFU_MAX_MATCH) {
+		max_len = LZFU_MAX_MATCH;
+	}
+	if (max_len > LZFU_DICTLENGTH - (pos - mf->window)) {
+		max_len = LZFU_DICTLENGTH - (pos - mf->window);
+	}
+	if (max_len < LZFU_MIN_MATCH) return 0;
+
+	if (max_len > LZFU_MIN_MATCH) {
+		candidate = mf->head[LZFU_HASH(stream + pos)];
+		while (candidate > mf->window) {
+			candidate -= 1;
+			for (len = 0; len < max_len && stream[candidate + len] == stream[pos + len]; len++);
+			if (len > best_len) {
+				best_len = len;
+				*match_offset = candidate - mf->window;
+				if (len == max_len) break;
 			}
+			candidate = mf->next[candidate % LZFU_DICTLENGTH];
+		}
+	}
+
+	if (best_len < LZFU_MIN_MATCH + 1) {
+		candidate = mf->digram[LZFU_DIGRAM(stream + pos)];
+		if (candidate > mf->window) {
+			best_len = LZFU_MIN_MATCH;
+			*match_offset = candidate - 1 - mf->window;
 		}
 	}
-	*dict_match_length = best_match_length;
-	return best_match_length;
+
+	return (best_len >= LZFU_MIN_MATCH) ? best_len : 0;
 }
 
+/**
+   \details Compress a buffer in Compressed RTF format
+
+   The dictionary is searched through 3-byte hash chains, so
+   compression is linear in the input size. The output is the same as
+   the one of the exhaustive dictionary search: the longest match with
+   the lowest dictionary offset is always used.
+
+   \param mem_ctx pointer to the memory context
+   \param rtf pointer to the RTF data to compress
+   \param rtf_size size of the RTF data
+   \param rtfcomp pointer on pointer to the compressed data the
+   function returns
+   \param rtfcomp_size pointer to the size of the compressed data
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
 _PUBLIC_ enum MAPISTATUS compress_rtf(TALLOC_CTX *mem_ctx, const char *rtf, const size_t rtf_size,
 				      uint8_t **rtfcomp, size_t *rtfcomp_size)
 {
-	size_t			input_idx = 0;
-	lzfuheader		header;
-	uint8_t			*dict;
-	size_t			output_idx = 0;
-	size_t			control_byte_idx = 0;
-	uint8_t			control_bit = 0x01;
-	size_t			dict_write_idx = 0;
-
-	/* as an upper bound, assume that the output is no larger than 9/8 of the input size, plus the header size */
-	*rtfcomp = (uint8_t *) talloc_size(mem_ctx, 9 * rtf_size / 8 + sizeof(lzfuheader));
+	struct lzfu_match_finder	*mf;
+	uint8_t				*stream;
+	lzfuheader			header;
+	uint32_t			pos;
+	uint32_t			i;
+	uint32_t			match_length;
+	uint32_t			match_offset = 0;
+	uint8_t				*output;
+	size_t				output_idx = 0;
+	size_t				control_byte_idx = 0;
+	uint8_t				control_bit = 0x01;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!rtf && rtf_size, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!rtfcomp || !rtfcomp_size, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(rtf_size > UINT32_MAX - LZFU_INITLENGTH, MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* Each token takes at most one byte per input byte, plus one
+	 * control byte every 8 tokens and the final marker */
+	output = (uint8_t *) talloc_size(mem_ctx, sizeof(lzfuheader) + rtf_size + rtf_size / 8 + 4);
+	OPENCHANGE_RETVAL_IF(!output, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	control_byte_idx = sizeof(lzfuheader);
-	(*rtfcomp)[control_byte_idx] = 0x00;
+	output[control_byte_idx] = 0x00;
 	output_idx = control_byte_idx + 1;
 
-	/* allocate and initialise the dictionary */
-	dict = talloc_zero_array(mem_ctx, uint8_t, LZFU_DICTLENGTH);
-	memcpy(dict, LZFU_INITDICT, LZFU_INITLENGTH);
-	dict_write_idx = LZFU_INITLENGTH;
-
-	while (input_idx < rtf_size) {
-		size_t dict_match_length = 0;
-		size_t dict_match_offset = 0;
-		DEBUG(4, ("compressing byte %zi of %zi\n", input_idx, rtf_size));
-		if (longest_match(rtf, rtf_size, input_idx, dict, &dict_write_idx, &dict_match_offset, &dict_match_length) > 1) {
-			uint16_t dict_ref = dict_match_offset << 4;
-			dict_ref += (dict_match_length - 2);
-			input_idx += dict_match_length;
-			(*rtfcomp)[control_byte_idx] |= control_bit;
+	/* initialise the dictionary stream and the match finder */
+	stream = talloc_array(output, uint8_t, LZFU_INITLENGTH + rtf_size);
+	OPENCHANGE_RETVAL_IF(!stream, MAPI_E_NOT_ENOUGH_MEMORY, output);
+	memcpy(stream, LZFU_INITDICT, LZFU_INITLENGTH);
+	memcpy(stream + LZFU_INITLENGTH, rtf, rtf_size);
+
+	mf = talloc_zero(output, struct lzfu_match_finder);
+	OPENCHANGE_RETVAL_IF(!mf, MAPI_E_NOT_ENOUGH_MEMORY, output);
+	mf->stream = stream;
+	mf->stream_size = LZFU_INITLENGTH + rtf_size;
+	mf->window = 0;
+	for (pos = 0; pos < LZFU_INITLENGTH; pos++) {
+		lzfu_insert(mf, pos);
+	}
+
+	while (pos < mf->stream_size) {
+		match_length = lzfu_longest_match(mf, pos, &match_offset);
+		if (match_length) {
+			uint16_t dict_ref = (match_offset << 4) | (match_length - LZFU_MIN_MATCH);
+			output[control_byte_idx] |= control_bit;
 			/* append dictionary reference to output */
-			(*rtfcomp)[output_idx] = (dict_ref & 0xFF00) >> 8;
-			output_idx += 1;
-			(*rtfcomp)[output_idx] = (dict_ref & 0xFF);
-			output_idx += 1;
+			output[output_idx++] = (dict_ref & 0xFF00) >> 8;
+			output[output_idx++] = (dict_ref & 0xFF);
 		} else {
-			if (dict_match_length == 0) {
-				/* we haven't written a literal to the dict yet */
-				dict[dict_write_idx % LZFU_DICTLENGTH] = rtf[input_idx];
-				dict_write_idx += 1;
+			/* append literal to output */
+			match_length = 1;
+			output[output_idx++] = stream[pos];
+		}
+
+		for (i = 0; i < match_length; i++, pos++) {
+			if (pos % LZFU_DICTLENGTH == 0) {
+				/* dictionary write offset wrapped */
+				mf->window = pos;
 			}
-			/* append to output, and increment the output position */
-			(*rtfcomp)[output_idx] = rtf[input_idx];
-			output_idx += 1;
-			DEBUG(5, ("new output_idx = 0x%08zx (for char value 0x%02x)\n", output_idx, rtf[input_idx]));
-			/* increment the input position */
-			input_idx += 1;
+			lzfu_insert(mf, pos);
+		}
+		if (pos % LZFU_DICTLENGTH == 0) {
+			mf->window = pos;
 		}
+
 		if (control_bit == 0x80) {
 			control_bit = 0x01;
 			control_byte_idx = output_idx;
-			(*rtfcomp)[control_byte_idx] = 0x00;
+			output[control_byte_idx] = 0x00;
 			output_idx = control_byte_idx + 1;
-			DEBUG(5, ("new output_idx cb = 0x%08zx\n", output_idx));
 		} else {
 			control_bit = control_bit << 1;
 		}
 	}
+
 	{
 		/* append final marker dictionary reference to output */
-		uint16_t dict_ref = (dict_write_idx % LZFU_DICTLENGTH) << 4;
-		// printf("dict ref: 0x%04x at 0x%08zx\n", dict_ref, output_idx);
-		(*rtfcomp)[control_byte_idx] |= control_bit;
-		// printf("dict ref hi: 0x%02x\n", (dict_ref & 0xFF00) >> 8);
-		(*rtfcomp)[output_idx] = (dict_ref & 0xFF00) >> 8;
-		output_idx += 1;
-		// printf("dict ref lo: 0x%02x\n", dict_ref & 0xFF);
-		(*rtfcomp)[output_idx] = (dict_ref & 0xFF);
-		output_idx += 1;
+		uint16_t dict_ref = (pos % LZFU_DICTLENGTH) << 4;
+		output[control_byte_idx] |= control_bit;
+		output[output_idx++] = (dict_ref & 0xFF00) >> 8;
+		output[output_idx++] = (dict_ref & 0xFF);
 	}
+	talloc_free(mf);
+	talloc_free(stream);
 
 	header.cbSize = output_idx - sizeof(lzfuheader) + 12;
 	header.cbRawSize = rtf_size;
 	header.dwMagic = LZFU_COMPRESSED;
-	header.dwCRC = calculateCRC(*rtfcomp, sizeof(lzfuheader), output_idx - sizeof(lzfuheader));
-	memcpy(*rtfcomp, &header, sizeof(lzfuheader));
+	header.dwCRC = calculateCRC(output, sizeof(lzfuheader), output_idx - sizeof(lzfuheader));
+	LE32_CPU(header.cbSize);
+	LE32_CPU(header.cbRawSize);
+	LE32_CPU(header.dwMagic);
+	LE32_CPU(header.dwCRC);
+	memcpy(output, &header, sizeof(lzfuheader));
 	*rtfcomp_size = output_idx;
-	*rtfcomp = (uint8_t *) talloc_realloc_size(mem_ctx, *rtfcomp, *rtfcomp_size);
+	*rtfcomp = (uint8_t *) talloc_realloc_size(mem_ctx, output, *rtfcomp_size);
 
 	return MAPI_E_SUCCESS;
 }
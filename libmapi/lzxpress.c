@@ -0,0 +1,311 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/**
+   \file lzxpress.c
+
+   \brief LZ77 (Xpress) compression of RPC_HEADER_EXT payloads
+
+   Implements the LZ77 compression algorithm described in
+   [MS-OXCRPC] 3.1.7.2 (plain LZ77 variant of [MS-XCA]). The
+   compressed stream is a sequence of 32-bit little-endian flag words,
+   each followed by up to 32 literals or matches. A match is encoded
+   on 16 bits (13 bits of offset, 3 bits of length) optionally
+   followed by extended length fields.
+ */
+
+#define	LZXPRESS_MIN_MATCH	3
+#define	LZXPRESS_MAX_MATCH	0xFFFF
+#define	LZXPRESS_WINDOW_SIZE	0x2000
+#define	LZXPRESS_WINDOW_MASK	(LZXPRESS_WINDOW_SIZE - 1)
+#define	LZXPRESS_HASH_BITS	13
+#define	LZXPRESS_HASH_SIZE	(1 << LZXPRESS_HASH_BITS)
+#define	LZXPRESS_MAX_CHAIN	32
+
+#define	LZXPRESS_HASH(p)	((((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16)) * 2654435761U) >> (32 - LZXPRESS_HASH_BITS))
+
+struct lzxpress_match_finder {
+	int32_t		head[LZXPRESS_HASH_SIZE];
+	int32_t		prev[LZXPRESS_WINDOW_SIZE];
+};
+
+
+static inline void lzxpress_insert(struct lzxpress_match_finder *mf,
+				   const uint8_t *input,
+				   uint32_t input_size,
+				   uint32_t pos)
+{
+	uint32_t	h;
+
+	if (pos + LZXPRESS_MIN_MATCH > input_size) return;
+
+	h = LZXPRESS_HASH(input + pos);
+	mf->prev[pos & LZXPRESS_WINDOW_MASK] = mf->head[h];
+	mf->head[h] = pos;
+}
+
+
+static inline uint32_t lzxpress_longest_match(struct lzxpress_match_finder *mf,
+					      const uint8_t *input,
+					      uint32_t input_size,
+					      uint32_t pos,
+					      uint32_t *offset)
+{
+	int32_t		candidate;
+	uint32_t	chain = LZXPRESS_MAX_CHAIN;
+	uint32_t	max_len;
+	uint32_t	len;
+	uint32_t	best_len = 0;
+
+	if (pos + LZXPRESS_MIN_MATCH > input_size) return 0;
+
+	max_len = input_size - pos;
+	if (max_len > LZXPRESS_MAX_MATCH) {
+		max_len = LZXPRESS_MAX_MATCH;
+	}
+
+	candidate = mf->head[LZXPRESS_HASH(input + pos)];
+	while (candidate >= 0 && (pos - candidate) <= LZXPRESS_WINDOW_SIZE && chain--) {
+		if (input[candidate + best_len] == input[pos + best_len]) {
+			for (len = 0; len < max_len && input[candidate + len] == input[pos + len]; len++);
+			if (len > best_len) {
+				best_len = len;
+				*offset = pos - candidate;
+				if (len == max_len) break;
+			}
+		}
+		candidate = mf->prev[candidate & LZXPRESS_WINDOW_MASK];
+	}
+
+	return (best_len >= LZXPRESS_MIN_MATCH) ? best_len : 0;
+}
+
+
+/**
+   \details Compress a buffer using the LZ77 (Xpress) algorithm
+
+   \param input pointer to the uncompressed data
+   \param input_size size of the uncompressed data
+   \param output pointer to the buffer receiving compressed data
+   \param max_output_size size of the output buffer
+
+   \note An output buffer of LZXPRESS_COMPRESS_BOUND(input_size)
+   bytes is always large enough.
+
+   \return size of the compressed data on success, -1 if the output
+   buffer is too small or memory could not be allocated
+ */
+_PUBLIC_ ssize_t lzxpress_compress_buffer(const uint8_t *input,
+					  uint32_t input_size,
+					  uint8_t *output,
+					  uint32_t max_output_size)
+{
+	struct lzxpress_match_finder	*mf;
+	uint32_t			in_pos = 0;
+	uint32_t			out_pos = 0;
+	uint32_t			flags = 0;
+	uint32_t			flag_count = 0;
+	uint32_t			flag_pos = 0;
+	uint32_t			nibble_pos = 0;
+	uint32_t			match_len;
+	uint32_t			match_offset = 0;
+	uint32_t			i;
+
+	if (max_output_size < 4) return -1;
+
+	mf = talloc(NULL, struct lzxpress_match_finder);
+	if (!mf) return -1;
+	memset(mf->head, 0xFF, sizeof (mf->head));
+
+	/* Reserve room for the first flag word */
+	out_pos = 4;
+
+	while (in_pos < input_size) {
+		match_len = lzxpress_longest_match(mf, input, input_size, in_pos, &match_offset);
+		if (!match_len) {
+			if (out_pos + 1 > max_output_size) goto overflow;
+			output[out_pos++] = input[in_pos];
+			lzxpress_insert(mf, input, input_size, in_pos);
+			in_pos++;
+			flags <<= 1;
+		} else {
+			uint32_t	length = match_len - LZXPRESS_MIN_MATCH;
+			uint16_t	token;
+
+			if (out_pos + 2 > max_output_size) goto overflow;
+			token = ((match_offset - 1) << 3) | ((length < 7) ? length : 7);
+			SSVAL(output, out_pos, token);
+			out_pos += 2;
+
+			if (length >= 7) {
+				length -= 7;
+				if (!nibble_pos) {
+					if (out_pos + 1 > max_output_size) goto overflow;
+					nibble_pos = out_pos;
+					output[out_pos++] = (length < 15) ? length : 15;
+				} else {
+					output[nibble_pos] |= ((length < 15) ? length : 15) << 4;
+					nibble_pos = 0;
+				}
+
+				if (length >= 15) {
+					length -= 15;
+					if (out_pos + 1 > max_output_size) goto overflow;
+					output[out_pos++] = (length < 255) ? length : 255;
+
+					if (length >= 255) {
+						length += 15 + 7;
+						if (out_pos + 2 > max_output_size) goto overflow;
+						SSVAL(output, out_pos, length);
+						out_pos += 2;
+					}
+				}
+			}
+
+			for (i = 0; i < match_len; i++) {
+				lzxpress_insert(mf, input, input_size, in_pos + i);
+			}
+			in_pos += match_len;
+			flags = (flags << 1) | 1;
+		}
+
+		flag_count++;
+		if (flag_count == 32) {
+			SIVAL(output, flag_pos, flags);
+			flags = 0;
+			flag_count = 0;
+			if (out_pos + 4 > max_output_size) goto overflow;
+			flag_pos = out_pos;
+			out_pos += 4;
+		}
+	}
+
+	/* Pad the last flag word with match bits: the decoder stops
+	 * on the first match found past the end of input */
+	if (flag_count) {
+		flags <<= (32 - flag_count);
+		flags |= (1U << (32 - flag_count)) - 1;
+	} else {
+		flags = 0xFFFFFFFF;
+	}
+	SIVAL(output, flag_pos, flags);
+
+	talloc_free(mf);
+	return out_pos;
+
+overflow:
+	talloc_free(mf);
+	return -1;
+}
+
+
+/**
+   \details Decompress a LZ77 (Xpress) compressed buffer
+
+   \param input pointer to the compressed data
+   \param input_size size of the compressed data
+   \param output pointer to the buffer receiving uncompressed data
+   \param max_output_size size of the output buffer
+
+   \return size of the uncompressed data on success, -1 if the
+   compressed stream is malformed or does not fit in the output buffer
+ */
+_PUBLIC_ ssize_t lzxpress_decompress_buffer(const uint8_t *input,
+					    uint32_t input_size,
+					    uint8_t *output,
+					    uint32_t max_output_size)
+{
+	uint32_t	in_pos = 0;
+	uint32_t	out_pos = 0;
+	uint32_t	flags = 0;
+	uint32_t	flag_count = 0;
+	uint32_t	nibble_pos = 0;
+	uint32_t	match_len;
+	uint32_t	match_offset;
+	uint16_t	token;
+
+	while (true) {
+		if (!flag_count) {
+			if (in_pos == input_size) break;
+			if (in_pos + 4 > input_size) return -1;
+			flags = IVAL(input, in_pos);
+			in_pos += 4;
+			flag_count = 32;
+		}
+		flag_count--;
+
+		if ((flags & (1U << flag_count)) == 0) {
+			if (in_pos == input_size) break;
+			if (out_pos >= max_output_size) return -1;
+			output[out_pos++] = input[in_pos++];
+			continue;
+		}
+
+		if (in_pos == input_size) break;
+		if (in_pos + 2 > input_size) return -1;
+		token = SVAL(input, in_pos);
+		in_pos += 2;
+		match_len = token & 0x7;
+		match_offset = (token >> 3) + 1;
+
+		if (match_len == 7) {
+			if (!nibble_pos) {
+				if (in_pos >= input_size) return -1;
+				nibble_pos = in_pos;
+				match_len = input[in_pos++] & 0xF;
+			} else {
+				match_len = input[nibble_pos] >> 4;
+				nibble_pos = 0;
+			}
+
+			if (match_len == 15) {
+				if (in_pos >= input_size) return -1;
+				match_len = input[in_pos++];
+				if (match_len == 255) {
+					if (in_pos + 2 > input_size) return -1;
+					match_len = SVAL(input, in_pos);
+					in_pos += 2;
+					if (match_len == 0) {
+						if (in_pos + 4 > input_size) return -1;
+						match_len = IVAL(input, in_pos);
+						in_pos += 4;
+					}
+					if (match_len < 15 + 7) return -1;
+					match_len -= 15 + 7;
+				}
+				match_len += 15;
+			}
+			match_len += 7;
+		}
+		match_len += LZXPRESS_MIN_MATCH;
+
+		if (match_offset > out_pos) return -1;
+		if (match_len > max_output_size - out_pos) return -1;
+
+		/* Source and destination may overlap: copy byte per byte */
+		for (; match_len; match_len--, out_pos++) {
+			output[out_pos] = output[out_pos - match_offset];
+		}
+	}
+
+	return out_pos;
+}
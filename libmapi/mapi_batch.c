@@ -0,0 +1,636 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+
+/**
+   \file mapi_batch.c
+
+   \brief ROP batching
+
+   A ROP batch queues several operations and sends them to the server
+   in a single EcDoRpc transaction. Operations can be chained: an
+   object opened by a queued operation can be used as the input of
+   the following ones before the batch is dispatched. The results of
+   each operation are stored in the output parameters supplied when it
+   was queued, once mapi_batch_dispatch returns.
+
+   The batch is dispatched automatically when the next operation would
+   exceed the ROP buffer size the session negotiated with the server,
+   or the handle table size.
+ */
+
+
+/**
+   \details Retrieve the largest ROP buffer and handle table a batch
+   can send over a session: the reply buffer requested by the session,
+   bounded by the rgbIn limit, minus the RPC_HEADER_EXT
+ */
+static uint32_t mapi_batch_max_size(struct mapi_session *session)
+{
+	struct emsmdb_context	*emsmdb_ctx;
+	uint32_t		size = MAPI_BATCH_MAX_SIZE;
+
+	if (session->emsmdb && session->emsmdb->ctx && session->profile) {
+		emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+		if (session->profile->exchange_version == 0x0) {
+			/* EcDoRpc */
+			size = MIN(size, emsmdb_ctx->max_data);
+		} else {
+			size = MIN(size, emsmdb_ctx->max_rgbout);
+		}
+	}
+
+	return size - MAPI_BATCH_HEADER_SIZE;
+}
+
+
+/**
+   \details Initialize a ROP batch
+
+   \param mem_ctx pointer to the memory context
+   \param obj any MAPI object of the session the batch is used with
+
+   \return Allocated ROP batch on success, otherwise NULL
+
+   \sa mapi_batch_dispatch
+ */
+_PUBLIC_ struct mapi_batch *mapi_batch_init(TALLOC_CTX *mem_ctx, mapi_object_t *obj)
+{
+	struct mapi_batch	*batch;
+	struct mapi_session	*session;
+
+	session = mapi_object_get_session(obj);
+	if (!session) return NULL;
+
+	batch = talloc_zero(mem_ctx, struct mapi_batch);
+	if (!batch) return NULL;
+
+	batch->session = session;
+	batch->mem_ctx = talloc_named(batch, 0, "mapi_batch");
+	batch->max_size = mapi_batch_max_size(session);
+
+	return batch;
+}
+
+
+/**
+   \details Check whether an object is opened by an operation pending
+   in the batch
+ */
+static bool mapi_batch_is_pending(struct mapi_batch *batch, mapi_object_t *obj)
+{
+	uint32_t	i;
+
+	for (i = 0; i < batch->count; i++) {
+		if (batch->ops[i].obj_out == obj) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+   \details Append an operation to the batch, dispatching the pending
+   operations first if the new one does not fit in the same ROP buffer
+ */
+static enum MAPISTATUS mapi_batch_add(struct mapi_batch *batch,
+				      mapi_object_t *obj,
+				      mapi_object_t *obj_out,
+				      uint8_t opnum,
+				      uint32_t size,
+				      struct mapi_batch_op **op)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*ops;
+	uint32_t		handles;
+	uint8_t			logon_id;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!obj, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(mapi_object_get_session(obj) != batch->session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(obj_out && mapi_batch_is_pending(batch, obj_out), MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* input and output handle slots */
+	handles = obj_out ? 2 : 1;
+	if ((batch->size + size + sizeof (uint16_t) + (batch->handles + handles) * sizeof (uint32_t) > batch->max_size) ||
+	    (batch->handles + handles > MAPI_BATCH_MAX_HANDLES)) {
+		/* chained operations keep working: the objects opened
+		   by the pending operations have their handle set once
+		   they are dispatched */
+		retval = mapi_batch_dispatch(batch);
+		OPENCHANGE_RETVAL_IF(retval && retval != MAPI_W_ERRORS_RETURNED, retval, NULL);
+	}
+
+	if (!mapi_batch_is_pending(batch, obj)) {
+		OPENCHANGE_RETVAL_IF(mapi_object_is_invalid(obj), MAPI_E_INVALID_OBJECT, NULL);
+		retval = mapi_object_get_logon_id(obj, &logon_id);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	}
+	else {
+		/* set when the pending operation was queued */
+		logon_id = obj->logon_id;
+	}
+
+	ops = talloc_realloc(batch, batch->ops, struct mapi_batch_op, batch->count + 1);
+	OPENCHANGE_RETVAL_IF(!ops, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	batch->ops = ops;
+
+	*op = &batch->ops[batch->count];
+	memset(*op, 0, sizeof (struct mapi_batch_op));
+	(*op)->mapi_req.opnum = opnum;
+	(*op)->mapi_req.logon_id = logon_id;
+	(*op)->size = size;
+	(*op)->obj = obj;
+	(*op)->obj_out = obj_out;
+
+	if (obj_out) {
+		mapi_object_set_session(obj_out, batch->session);
+		mapi_object_set_handle(obj_out, 0xffffffff);
+		mapi_object_set_logon_id(obj_out, logon_id);
+	}
+
+	batch->count++;
+	batch->size += size;
+	batch->handles += handles;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue an OpenMessage operation
+
+   \param batch pointer to the ROP batch
+   \param obj_store the store to read from
+   \param id_folder the folder ID
+   \param id_message the message ID
+   \param obj_message the resulting message object, which can be used
+   by the operations queued afterwards
+   \param ulFlags the OpenMessage flags
+   \param result pointer to the operation status, set on dispatch, or NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenMessage
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenMessage(struct mapi_batch *batch,
+						mapi_object_t *obj_store,
+						mapi_id_t id_folder,
+						mapi_id_t id_message,
+						mapi_object_t *obj_message,
+						uint8_t ulFlags,
+						enum MAPISTATUS *result)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	uint32_t		size;
+
+	OPENCHANGE_RETVAL_IF(!obj_message, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = sizeof (uint8_t) + sizeof(uint16_t) + sizeof(mapi_id_t) + sizeof(uint8_t) + sizeof(mapi_id_t);
+	size += 3;
+
+	retval = mapi_batch_add(batch, obj_store, obj_message, op_MAPI_OpenMessage, size, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->mapi_req.u.mapi_OpenMessage.CodePageId = 0xfff;
+	op->mapi_req.u.mapi_OpenMessage.FolderId = id_folder;
+	op->mapi_req.u.mapi_OpenMessage.OpenModeFlags = (enum OpenMessage_OpenModeFlags)ulFlags;
+	op->mapi_req.u.mapi_OpenMessage.MessageId = id_message;
+	op->result = result;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetProps operation
+
+   Unlike GetProps, named properties are not mapped: the property tags
+   must already be the ones used by the server.
+
+   \param batch pointer to the ROP batch
+   \param obj the object to get properties on
+   \param flags Flags for behaviour; can be MAPI_UNICODE
+   \param SPropTagArray an array of MAPI property tags
+   \param lpProps the result of the query, set on dispatch
+   \param PropCount the count of property tags, set on dispatch
+   \param result pointer to the operation status, set on dispatch, or NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetProps
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetProps(struct mapi_batch *batch,
+					     mapi_object_t *obj,
+					     uint32_t flags,
+					     struct SPropTagArray *SPropTagArray,
+					     struct SPropValue **lpProps,
+					     uint32_t *PropCount,
+					     enum MAPISTATUS *result)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	uint32_t		size;
+
+	OPENCHANGE_RETVAL_IF(!SPropTagArray, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!lpProps || !PropCount, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = sizeof (uint16_t) * 3 + SPropTagArray->cValues * sizeof (uint32_t);
+	size += 3;
+
+	retval = mapi_batch_add(batch, obj, NULL, op_MAPI_GetProps, size, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	*lpProps = NULL;
+	*PropCount = 0;
+
+	op->properties.cValues = SPropTagArray->cValues;
+	op->properties.aulPropTag = talloc_memdup(batch->mem_ctx, SPropTagArray->aulPropTag, SPropTagArray->cValues * sizeof(enum MAPITAGS));
+	op->mapi_req.u.mapi_GetProps.PropertySizeLimit = 0x0;
+	op->mapi_req.u.mapi_GetProps.WantUnicode = (flags & MAPI_UNICODE) != 0 ? true : 0x0;
+	op->mapi_req.u.mapi_GetProps.prop_count = (uint16_t) SPropTagArray->cValues;
+	op->mapi_req.u.mapi_GetProps.properties = op->properties.aulPropTag;
+	op->lpProps = lpProps;
+	op->PropCount = PropCount;
+	op->result = result;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetAttachmentTable operation
+
+   \param batch pointer to the ROP batch
+   \param obj_message the message to get the attachment table for
+   \param obj_table the resulting table object, which can be used by
+   the operations queued afterwards
+   \param result pointer to the operation status, set on dispatch, or NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetAttachmentTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetAttachmentTable(struct mapi_batch *batch,
+						       mapi_object_t *obj_message,
+						       mapi_object_t *obj_table,
+						       enum MAPISTATUS *result)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	uint32_t		size;
+
+	OPENCHANGE_RETVAL_IF(!obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	size = sizeof (uint8_t) * 2;
+	size += 3;
+
+	retval = mapi_batch_add(batch, obj_message, obj_table, op_MAPI_GetAttachmentTable, size, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->mapi_req.u.mapi_GetAttachmentTable.TableFlags = 0x0;
+	op->result = result;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue the release of an object
+
+   The object is reset once the batch is dispatched, as
+   mapi_object_release does. As with mapi_object_release, objects
+   without a valid handle are skipped, unless they are opened by an
+   operation pending in the batch.
+
+   \param batch pointer to the ROP batch
+   \param obj the object to release
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa mapi_object_release
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_Release(struct mapi_batch *batch,
+					    mapi_object_t *obj)
+{
+	struct mapi_batch_op	*op;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!obj, MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* Nothing to release on the server */
+	if (mapi_object_is_invalid(obj) && !mapi_batch_is_pending(batch, obj)) {
+		return MAPI_E_SUCCESS;
+	}
+
+	return mapi_batch_add(batch, obj, NULL, op_MAPI_Release, 3, &op);
+}
+
+
+/**
+   \details Build the ROP buffer of the pending operations, starting
+   at a given operation.
+
+   \param mem_ctx pointer to the memory context
+   \param batch pointer to the ROP batch
+   \param first index of the first operation to send
+   \param slots pointer on pointer to the handle slot of the input
+   object of each operation, indexed from first
+
+   \return Allocated MAPI request on success, otherwise NULL
+ */
+_PUBLIC_ struct mapi_request *mapi_batch_build_request(TALLOC_CTX *mem_ctx,
+						       struct mapi_batch *batch,
+						       uint32_t first,
+						       uint32_t **slots)
+{
+	struct mapi_request	*mapi_request;
+	struct mapi_batch_op	*op;
+	mapi_object_t		**objects;
+	uint32_t		*handles;
+	uint32_t		handle_count = 0;
+	uint32_t		size = 0;
+	uint32_t		i, j;
+
+	if (!batch || first >= batch->count || !slots) return NULL;
+
+	mapi_request = talloc_zero(mem_ctx, struct mapi_request);
+	mapi_request->mapi_req = talloc_zero_array(mapi_request, struct EcDoRpc_MAPI_REQ, batch->count - first + 1);
+	handles = talloc_array(mapi_request, uint32_t, (batch->count - first) * 2);
+	objects = talloc_array(mapi_request, mapi_object_t *, (batch->count - first) * 2);
+	*slots = talloc_array(mem_ctx, uint32_t, batch->count - first);
+
+	for (i = first; i < batch->count; i++) {
+		op = &batch->ops[i];
+
+		/* Step 1. Resolve the input object slot: objects opened
+		 * earlier in this buffer are referenced by their slot */
+		for (j = handle_count; j > 0; j--) {
+			if (objects[j - 1] == op->obj) break;
+		}
+		if (j == 0) {
+			objects[handle_count] = op->obj;
+			handles[handle_count] = mapi_object_get_handle(op->obj);
+			handle_count++;
+			j = handle_count;
+		}
+		j--;
+		(*slots)[i - first] = j;
+
+		mapi_request->mapi_req[i - first] = op->mapi_req;
+		mapi_request->mapi_req[i - first].handle_idx = j;
+
+		/* Step 2. Allocate the output slot */
+		if (op->obj_out) {
+			objects[handle_count] = op->obj_out;
+			handles[handle_count] = 0xffffffff;
+			switch (op->mapi_req.opnum) {
+			case op_MAPI_OpenMessage:
+				mapi_request->mapi_req[i - first].u.mapi_OpenMessage.handle_idx = handle_count;
+				break;
+			case op_MAPI_GetAttachmentTable:
+				mapi_request->mapi_req[i - first].u.mapi_GetAttachmentTable.handle_idx = handle_count;
+				break;
+			}
+			handle_count++;
+		}
+
+		size += op->size;
+	}
+	mapi_request->mapi_req[i - first].opnum = 0;
+
+	/* Step 3. Fill the mapi_request structure */
+	mapi_request->length = size + sizeof (uint16_t);
+	mapi_request->mapi_len = mapi_request->length + sizeof (uint32_t) * handle_count;
+	mapi_request->handles = handles;
+	talloc_free(objects);
+
+	return mapi_request;
+}
+
+
+/**
+   \details Store the reply of an operation in the output parameters
+   supplied when it was queued
+
+   \return the operation status
+ */
+static enum MAPISTATUS mapi_batch_process_reply(struct mapi_batch *batch,
+						struct mapi_batch_op *op,
+						struct EcDoRpc_MAPI_REPL *mapi_repl,
+						uint32_t *handles)
+{
+	enum MAPISTATUS	retval;
+
+	retval = mapi_repl->error_code;
+	if (retval && (op->mapi_req.opnum != op_MAPI_GetProps || retval != MAPI_W_ERRORS_RETURNED)) {
+		return retval;
+	}
+
+	switch (op->mapi_req.opnum) {
+	case op_MAPI_OpenMessage:
+		mapi_object_set_handle(op->obj_out, handles[mapi_repl->handle_idx]);
+		op->obj_out->private_data = (void *) OpenMessage_get_message(batch->session, &mapi_repl->u.mapi_OpenMessage);
+		break;
+	case op_MAPI_GetAttachmentTable:
+		mapi_object_set_handle(op->obj_out, handles[mapi_repl->handle_idx]);
+		break;
+	case op_MAPI_GetProps:
+		if (!emsmdb_get_SPropValue((TALLOC_CTX *)batch->session,
+					   &mapi_repl->u.mapi_GetProps.prop_data,
+					   &op->properties, op->lpProps, op->PropCount,
+					   mapi_repl->u.mapi_GetProps.layout)) {
+			return retval;
+		}
+		break;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Reset the objects released by the batch
+ */
+static void mapi_batch_release_object(mapi_object_t *obj)
+{
+	if (obj->private_data) {
+		talloc_free(obj->private_data);
+	}
+	if (obj->store == true && obj->session) {
+		obj->session->logon_ids[obj->logon_id] = 0;
+	}
+	mapi_object_init(obj);
+}
+
+
+/**
+   \details Send the queued operations to the server
+
+   The operations are sent in as few EcDoRpc transactions as
+   possible. When the server runs out of response buffer, the
+   remaining operations are sent again in a new transaction.
+
+   \param batch pointer to the ROP batch
+
+   \return MAPI_E_SUCCESS if all the operations succeeded,
+   MAPI_W_ERRORS_RETURNED if some of them failed, otherwise MAPI
+   error. The status of each operation is stored in the result
+   parameter supplied when it was queued.
+
+   \note Developers may also call GetLastError() to retrieve the last
+   MAPI error code. Possible MAPI error codes are:
+   - MAPI_E_NOT_INITIALIZED: batch is undefined
+   - MAPI_E_CALL_FAILED: A network problem was encountered during the
+     transaction
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_dispatch(struct mapi_batch *batch)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct mapi_request	*mapi_request;
+	struct mapi_response	*mapi_response;
+	struct mapi_batch_op	*op;
+	NTSTATUS		status;
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	enum MAPISTATUS		op_retval;
+	uint32_t		*slots;
+	uint32_t		first = 0;
+	uint32_t		next, repl_idx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_NOT_INITIALIZED, NULL);
+
+	while (first < batch->count) {
+		mem_ctx = talloc_named(batch->session, 0, "mapi_batch_dispatch");
+
+		mapi_request = mapi_batch_build_request(mem_ctx, batch, first, &slots);
+		if (!mapi_request) {
+			talloc_free(mem_ctx);
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			break;
+		}
+
+		status = emsmdb_transaction_wrapper(batch->session, mem_ctx, mapi_request, &mapi_response);
+		batch->transactions++;
+		if (!NT_STATUS_IS_OK(status) || !mapi_response->mapi_repl) {
+			talloc_free(mem_ctx);
+			retval = MAPI_E_CALL_FAILED;
+			break;
+		}
+
+		OPENCHANGE_CHECK_NOTIFICATION(batch->session, mapi_response);
+
+		/* Step 1. Route each reply to its operation. Release
+		 * has no reply, and the server stops processing the
+		 * buffer when it runs out of response buffer space */
+		repl_idx = 0;
+		for (next = first; next < batch->count; next++) {
+			op = &batch->ops[next];
+			if (op->mapi_req.opnum == op_MAPI_Release) {
+				batch->rops++;
+				continue;
+			}
+			if (mapi_response->mapi_repl[repl_idx].opnum == 0 ||
+			    mapi_response->mapi_repl[repl_idx].opnum == op_MAPI_BufferTooSmall) {
+				break;
+			}
+			if (mapi_response->mapi_repl[repl_idx].opnum != op->mapi_req.opnum) {
+				op_retval = MAPI_E_CALL_FAILED;
+			}
+			else {
+				op_retval = mapi_batch_process_reply(batch, op, &mapi_response->mapi_repl[repl_idx], mapi_response->handles);
+			}
+			if (op->result) {
+				*op->result = op_retval;
+			}
+			if (op_retval) {
+				retval = MAPI_W_ERRORS_RETURNED;
+			}
+			batch->rops++;
+			repl_idx++;
+		}
+
+		/* Step 2. Reset the objects released so far */
+		for (repl_idx = first; repl_idx < next; repl_idx++) {
+			if (batch->ops[repl_idx].mapi_req.opnum == op_MAPI_Release) {
+				mapi_batch_release_object(batch->ops[repl_idx].obj);
+			}
+		}
+
+		talloc_free(mapi_response);
+		talloc_free(mem_ctx);
+
+		if (next == first) {
+			/* a single operation does not fit in the response buffer */
+			retval = MAPI_E_CALL_FAILED;
+			break;
+		}
+		first = next;
+	}
+
+	/* Step 3. Operations which could not be sent */
+	for (; first < batch->count; first++) {
+		if (batch->ops[first].result) {
+			*batch->ops[first].result = retval;
+		}
+	}
+
+	talloc_free(batch->ops);
+	batch->ops = NULL;
+	batch->count = 0;
+	batch->size = 0;
+	batch->handles = 0;
+	talloc_free(batch->mem_ctx);
+	batch->mem_ctx = talloc_named(batch, 0, "mapi_batch");
+
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the number of operations sent by a batch and the
+   number of transactions used to send them
+
+   \param batch pointer to the ROP batch
+   \param rops pointer to the number of operations sent, or NULL
+   \param transactions pointer to the number of transactions, or NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_get_stats(struct mapi_batch *batch,
+					      uint32_t *rops,
+					      uint32_t *transactions)
+{
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_NOT_INITIALIZED, NULL);
+
+	if (rops) *rops = batch->rops;
+	if (transactions) *transactions = batch->transactions;
+
+	return MAPI_E_SUCCESS;
+}
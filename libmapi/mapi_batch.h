@@ -0,0 +1,56 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef	__MAPI_BATCH_H
+#define	__MAPI_BATCH_H
+
+/* Largest rgbIn buffer, and largest reply buffer without chained
+   extended buffers, [MS-OXCRPC] 3.1.4.2 */
+#define	MAPI_BATCH_MAX_SIZE	0x8000
+/* RPC_HEADER_EXT preceding the ROP buffer */
+#define	MAPI_BATCH_HEADER_SIZE	8
+/* Server object handle table slots available in a ROP buffer */
+#define	MAPI_BATCH_MAX_HANDLES	255
+
+struct mapi_batch_op {
+	struct EcDoRpc_MAPI_REQ	mapi_req;
+	uint32_t		size;
+	mapi_object_t		*obj;
+	mapi_object_t		*obj_out;
+	/* GetProps */
+	struct SPropTagArray	properties;
+	struct SPropValue	**lpProps;
+	uint32_t		*PropCount;
+	enum MAPISTATUS		*result;
+};
+
+struct mapi_batch {
+	TALLOC_CTX		*mem_ctx;
+	struct mapi_session	*session;
+	struct mapi_batch_op	*ops;
+	uint32_t		count;
+	uint32_t		size;
+	uint32_t		handles;
+	uint32_t		max_size;
+	/* statistics */
+	uint32_t		rops;
+	uint32_t		transactions;
+};
+
+#endif /* __MAPI_BATCH_H */
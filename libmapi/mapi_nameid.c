@@ -30,6 +30,122 @@
 */
 
 
+#define	MAPI_NAMEID_INDEX_COUNT(index)	(sizeof (index) / sizeof (index[0]))
+
+typedef int (*mapi_nameid_tags_cmp_t)(const struct mapi_nameid_tags *, const struct mapi_nameid_tags *);
+
+static int mapi_nameid_tags_cmp_tag(const struct mapi_nameid_tags *a, const struct mapi_nameid_tags *b)
+{
+	if (a->proptag == b->proptag) return 0;
+	return (a->proptag < b->proptag) ? -1 : 1;
+}
+
+static int mapi_nameid_tags_cmp_lid(const struct mapi_nameid_tags *a, const struct mapi_nameid_tags *b)
+{
+	int	ret;
+
+	ret = strcmp(a->OLEGUID, b->OLEGUID);
+	if (ret) return ret;
+	if (a->lid == b->lid) return 0;
+	return (a->lid < b->lid) ? -1 : 1;
+}
+
+static int mapi_nameid_tags_cmp_name(const struct mapi_nameid_tags *a, const struct mapi_nameid_tags *b)
+{
+	int	ret;
+
+	ret = strcmp(a->OLEGUID, b->OLEGUID);
+	if (ret) return ret;
+	return strcmp(a->Name, b->Name);
+}
+
+static int mapi_nameid_tags_cmp_OOM(const struct mapi_nameid_tags *a, const struct mapi_nameid_tags *b)
+{
+	int	ret;
+
+	ret = strcmp(a->OLEGUID, b->OLEGUID);
+	if (ret) return ret;
+	return strcmp(a->OOM, b->OOM);
+}
+
+
+/**
+   \details Binary search mapi_nameid_tags through one of the sorted
+   position tables generated in mapi_nameid_private.h
+
+   \param index the sorted positions to search
+   \param count number of elements in index
+   \param key the entry to search for
+   \param cmp comparison function the positions are sorted by
+
+   \return the first matching entry in table order, otherwise NULL
+ */
+static const struct mapi_nameid_tags *mapi_nameid_tags_search(const uint16_t *index,
+							     uint32_t count,
+							     const struct mapi_nameid_tags *key,
+							     mapi_nameid_tags_cmp_t cmp)
+{
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (cmp(&mapi_nameid_tags[index[mid]], key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (low < count && cmp(&mapi_nameid_tags[index[low]], key) == 0) {
+		return &mapi_nameid_tags[index[low]];
+	}
+
+	return NULL;
+}
+
+#define	MAPI_NAMEID_TAGS_FIND(by, key) \
+	mapi_nameid_tags_search(mapi_nameid_tags_by_##by, MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_##by), key, mapi_nameid_tags_cmp_##by)
+
+
+/**
+   \details Append a known named property entry to a mapi_nameid
+   structure
+
+   \param mapi_nameid the structure where results are stored
+   \param entry the mapi_nameid_tags entry to add
+ */
+static void mapi_nameid_add_entry(struct mapi_nameid *mapi_nameid,
+				  const struct mapi_nameid_tags *entry)
+{
+	uint16_t	count;
+
+	mapi_nameid->nameid = talloc_realloc(mapi_nameid,
+					     mapi_nameid->nameid, struct MAPINAMEID,
+					     mapi_nameid->count + 1);
+	mapi_nameid->entries = talloc_realloc(mapi_nameid,
+					      mapi_nameid->entries, struct mapi_nameid_tags,
+					      mapi_nameid->count + 1);
+	count = mapi_nameid->count;
+
+	mapi_nameid->entries[count] = *entry;
+
+	mapi_nameid->nameid[count].ulKind = (enum ulKind) entry->ulKind;
+	GUID_from_string(entry->OLEGUID, &(mapi_nameid->nameid[count].lpguid));
+	switch (entry->ulKind) {
+	case MNID_ID:
+		mapi_nameid->nameid[count].kind.lid = entry->lid;
+		break;
+	case MNID_STRING:
+		mapi_nameid->nameid[count].kind.lpwstr.Name = entry->Name;
+		mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(entry->Name);
+		break;
+	}
+	mapi_nameid->count++;
+}
+
+
 /**
    \details Create a new mapi_nameid structure
 
@@ -81,46 +197,24 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 					     const char *OOM,
 					     const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(OOM, mapi_nameid_tags[i].OOM) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	key.OOM = OOM;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(OOM, &key);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_add_entry(mapi_nameid, entry);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -147,45 +241,24 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_add(struct mapi_nameid *mapi_nameid,
 					     uint16_t lid, const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if ((lid == mapi_nameid_tags[i].lid) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	key.lid = lid;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(lid, &key);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_add_entry(mapi_nameid, entry);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -213,46 +286,24 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_add(struct mapi_nameid *mapi_nameid,
 						const char *Name,
 						const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(Name, mapi_nameid_tags[i].Name) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	key.Name = Name;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(name, &key);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_add_entry(mapi_nameid, entry);
+
+	return MAPI_E_SUCCESS;
 }
 
 /**
@@ -380,43 +431,22 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_custom_string_add(struct mapi_nameid *mapi_
 _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_nameid,
 						   uint32_t proptag)
 {
-	uint32_t	i;
-	uint16_t	count;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!proptag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							      mapi_nameid->entries, struct mapi_nameid_tags,
-							      mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	key.proptag = proptag;
+	entry = MAPI_NAMEID_TAGS_FIND(tag, &key);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	mapi_nameid_add_entry(mapi_nameid, entry);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -430,15 +460,13 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
  */
 _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
-	for (i = 0; mapi_nameid_tags[i].proptag; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			return MAPI_E_SUCCESS;
-		}
-	}
+	key.proptag = proptag;
+	entry = MAPI_NAMEID_TAGS_FIND(tag, &key);
 
-	return MAPI_E_NOT_FOUND;
+	return entry ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
 }
 
 
@@ -460,19 +488,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(mapi_nameid_tags[i].OOM, OOM) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	key.OOM = OOM;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(OOM, &key);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -497,18 +525,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLE
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	key.lid = lid;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(lid, &key);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -533,19 +562,20 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUI
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup_canonical(uint16_t lid, const char *OLEGUID,
 							  uint32_t *propTag)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	key.lid = lid;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(lid, &key);
+	if (entry) {
+		*propTag = entry->proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -571,19 +601,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup(const char *Name,
 						   const char *OLEGUID,
 						   uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	key.Name = Name;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(name, &key);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -609,20 +639,20 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup_canonical(const char *Name,
 							     const char *OLEGUID,
 							     uint32_t *propTag)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags		key;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	key.Name = Name;
+	key.OLEGUID = OLEGUID;
+	entry = MAPI_NAMEID_TAGS_FIND(name, &key);
+	if (entry) {
+		*propTag = entry->proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -966,34 +996,72 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_GetIDsFromNames(struct mapi_nameid *mapi_na
 	return retval;
 }
 
+#define	MAPI_NAMEID_NAMES_COUNT	MAPI_NAMEID_INDEX_COUNT(mapi_nameid_names_by_tag)
+
+/* Position in mapi_nameid_names_by_tag of the first entry not lower
+   than proptag */
+static uint32_t mapi_nameid_names_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_NAMES_COUNT;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (mapi_nameid_names[mapi_nameid_names_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static const char *mapi_nameid_names_find(uint32_t proptag)
+{
+	uint32_t	pos;
+
+	pos = mapi_nameid_names_lower_bound(proptag);
+	if (pos < MAPI_NAMEID_NAMES_COUNT &&
+	    mapi_nameid_names[mapi_nameid_names_by_tag[pos]].proptag == proptag) {
+		return mapi_nameid_names[mapi_nameid_names_by_tag[pos]].propname;
+	}
+
+	return NULL;
+}
+
 _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const char	*propname;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
-		}
+	propname = mapi_nameid_names_find(proptag);
+	if (propname) {
+		return propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
-		}
+		return mapi_nameid_names_find(proptag + 1); /* try as _UNICODE variant */
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 {
-	uint32_t idx;
-
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (!strcmp(mapi_nameid_names[idx].propname, propname)) {
-			return mapi_nameid_names[idx].proptag;
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_NAMES_COUNT;
+	uint32_t	mid;
+	int		ret;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(mapi_nameid_names[mapi_nameid_names_by_name[mid]].propname, propname);
+		if (ret == 0) {
+			return mapi_nameid_names[mapi_nameid_names_by_name[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -1002,17 +1070,26 @@ _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 
 _PUBLIC_ uint16_t get_namedid_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = MAPI_NAMEID_NAMES_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if ((mapi_nameid_names[idx].proptag >> 16) == untypedtag) {
-			current_type = mapi_nameid_names[idx].proptag & 0xFFFF;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Pick the first suitable entry in table order */
+	for (pos = mapi_nameid_names_lower_bound((uint32_t)untypedtag << 16);
+	     pos < MAPI_NAMEID_NAMES_COUNT; pos++) {
+		idx = mapi_nameid_names_by_tag[pos];
+		if ((mapi_nameid_names[idx].proptag >> 16) != untypedtag) {
+			break;
+		}
+		current_type = mapi_nameid_names[idx].proptag & 0xFFFF;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < MAPI_NAMEID_NAMES_COUNT) {
+		return mapi_nameid_names[found].proptag & 0xFFFF;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
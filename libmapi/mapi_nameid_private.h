@@ -1002,4 +1002,222 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 
 };
 
+/* mapi_nameid_tags and mapi_nameid_names positions sorted for binary searches */
+static const uint16_t mapi_nameid_tags_by_tag[] = {
+	 225,  251,  232,  235,  234,  245,  243,  246,  229,  233,  249,  247,
+	 248,  230,  231,  228,  250,  237,  252,  144,  238,  240,  244,  226,
+	 227,  224,  236,  239,  242,  241,  170,  173,  185,  177,  178,  189,
+	  53,   54,   10,   20,   57,   58,   67,   63,   65,    9,    4,   55,
+	   1,    0,   60,   76,   77,   75,    8,    7,  188,   74,   68,   73,
+	  71,   69,   72,   21,    5,    3,   16,   17,   18,   19,   23,   24,
+	  22,   61,   25,   27,   26,   28,   29,   30,   32,   31,   33,   34,
+	  35,   37,   36,   38,   39,   40,   41,   42,   43,   44,   45,   46,
+	  47,   48,   49,   50,   51,   52,   56,   59,   70,   64,    2,    6,
+	  66,   62,   11,   15,   14,   13,   12,  359,  330,  363,  357,  340,
+	 355,  332,  339,  338,  333,  341,  362,  358,  347,  354,  335,  360,
+	 345,  361,  336,  342,  352,  349,  334,  348,  351,  350,  346,  344,
+	 356,  353,  331,  343,  337,   96,   97,   87,  112,  110,  121,   80,
+	 129,  130,  123,  128,  100,   86,   99,   85,   84,   98,   83,   81,
+	 102,   93,  101,  139,   95,  138,  127,  107,  119,  122,  120,  135,
+	 125,   94,  137,  136,  142,  141,  114,  113,  134,   78,  108,  143,
+	 111,  116,  117,  118,  133,  109,   79,  115,  131,  132,   92,   91,
+	  90,   82,   89,   88,  106,  105,  103,  104,  124,  126,  140,  191,
+	 197,  195,  199,  198,  187,  147,  202,  201,  203,  156,  155,  206,
+	 205,  148,  193,  200,  194,  192,  213,  212,  171,  149,  181,  180,
+	 179,  157,  161,  184,  183,  182,  168,  169,  196,  175,  176,  210,
+	 160,  158,  159,  204,  207,  208,  209,  174,  154,  150,  151,  152,
+	 153,  190,  211,  172,  164,  165,  163,  167,  162,  166,  145,  146,
+	 186,  222,  221,  218,  219,  220,  215,  217,  216,  214,  223,  259,
+	 262,  261,  260,  258,  263,  264,  320,  297,  298,  299,  310,  308,
+	 313,  280,  281,  279,  275,  296,  314,  309,  288,  287,  291,  274,
+	 290,  277,  268,  276,  265,  302,  295,  282,  312,  294,  284,  273,
+	 306,  286,  269,  319,  321,  317,  316,  292,  323,  272,  324,  266,
+	 278,  304,  328,  327,  326,  329,  271,  270,  301,  300,  311,  289,
+	 303,  305,  285,  318,  307,  267,  283,  325,  315,  293,  322,  253,
+	 255,  254,  256,  257,  494,  364,  365,  366,  367,  368,  369,  370,
+	 371,  372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,
+	 383,  384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,
+	 395,  396,  397,  398,  399,  400,  401,  402,  403,  404,  405,  406,
+	 407,  408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,
+	 419,  420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,
+	 431,  432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,
+	 443,  444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,
+	 455,  456,  457,  458,  459,  460,  461,  462,  463,  464,  465,  466,
+	 467,  468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,
+	 479,  480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,
+	 491,  492,  493,
+};
+
+static const uint16_t mapi_nameid_tags_by_lid[] = {
+	 364,   96,   97,   87,  112,  110,  121,   80,  129,  130,  123,  128,
+	 100,   86,   99,   85,   84,   98,   83,   81,  102,   93,  101,  139,
+	  95,  138,  127,  107,  119,  122,  120,  135,  125,   94,  137,  136,
+	 142,  141,  114,  113,  134,   78,  108,  143,  111,  116,  117,  118,
+	 133,  109,   79,  115,  131,  132,   92,   91,   90,   82,   89,   88,
+	 106,  105,  103,  104,  124,  126,  140,  359,  330,  363,  357,  340,
+	 355,  332,  339,  338,  333,  341,  362,  358,  347,  354,  335,  360,
+	 345,  361,  336,  342,  352,  349,  334,  348,  351,  350,  346,  344,
+	 356,  353,  331,  343,  337,   53,   54,   10,   20,   57,   58,   67,
+	  63,   65,    9,    4,   55,    1,    0,   60,   76,   77,   75,    8,
+	   7,   74,   68,   73,   71,   69,   72,   21,    5,    3,   16,   17,
+	  18,   19,   23,   24,   22,   61,   25,   27,   26,   28,   29,   30,
+	  32,   31,   33,   34,   35,   37,   36,   38,   39,   40,   41,   42,
+	  43,   44,   45,   46,   47,   48,   49,   50,   51,   52,   56,   59,
+	  70,   64,    2,    6,   66,   62,   11,   15,   14,   13,   12,  170,
+	 173,  185,  177,  178,  189,  188,  191,  197,  195,  199,  198,  187,
+	 147,  202,  201,  203,  156,  155,  206,  205,  148,  193,  200,  194,
+	 192,  213,  212,  171,  149,  181,  180,  179,  157,  161,  184,  183,
+	 182,  168,  169,  196,  175,  176,  210,  160,  158,  159,  204,  207,
+	 208,  209,  174,  154,  150,  151,  152,  153,  190,  211,  172,  164,
+	 165,  163,  167,  162,  166,  186,  222,  221,  218,  219,  220,  215,
+	 217,  216,  214,  223,  253,  255,  254,  256,  257,  494,  320,  297,
+	 298,  299,  310,  308,  313,  280,  281,  279,  275,  296,  314,  309,
+	 288,  287,  291,  274,  290,  277,  268,  276,  265,  302,  295,  282,
+	 312,  294,  284,  273,  306,  286,  269,  319,  321,  317,  316,  292,
+	 323,  272,  324,  266,  278,  304,  328,  327,  326,  329,  271,  270,
+	 301,  300,  311,  289,  303,  305,  285,  318,  307,  267,  283,  325,
+	 315,  293,  322,  259,  262,  261,  260,  258,  263,  264,  144,  145,
+	 146,  225,  251,  232,  235,  234,  245,  243,  246,  229,  233,  249,
+	 247,  248,  230,  231,  228,  250,  237,  252,  238,  240,  244,  226,
+	 227,  224,  236,  239,  242,  241,
+};
+
+static const uint16_t mapi_nameid_tags_by_name[] = {
+	 405,  406,  407,  436,  437,  438,  439,  440,  441,  442,  443,  444,
+	 445,  485,  446,  447,  458,  459,  465,  466,  467,  468,  469,  470,
+	 472,  471,  473,  474,  475,  476,  477,  478,  479,  480,  482,  484,
+	 486,  487,  488,  489,  490,  491,  492,  493,  448,  449,  450,  451,
+	 452,  453,  454,  481,  483,  455,  456,  457,  408,  409,  410,  411,
+	 412,  413,  414,  415,  416,  417,  418,  419,  420,  421,  422,  423,
+	 424,  425,  463,  426,  427,  428,  464,  429,  430,  431,  432,  433,
+	 434,  435,  460,  461,  462,  376,  377,  378,  379,  381,  382,  402,
+	 383,  386,  384,  385,  387,  388,  389,  390,  391,  392,  393,  394,
+	 395,  396,  397,  398,  399,  400,  401,  403,  404,  380,  369,  370,
+	 371,  372,  373,  374,  375,  368,  367,  365,  366,
+};
+
+static const uint16_t mapi_nameid_tags_by_OOM[] = {
+	 364,   78,   79,   80,   81,   82,   83,   84,   85,   86,   87,   88,
+	  89,   90,   91,   92,   93,   94,   95,   97,   96,   98,   99,  100,
+	 101,  102,  103,  104,  105,  106,  107,  108,  109,  110,  111,  112,
+	 113,  114,  115,  116,  117,  118,  119,  120,  121,  122,  125,  124,
+	 123,  126,  127,  140,  128,  129,  130,  131,  132,  133,  134,  135,
+	 136,  137,  138,  139,  141,  142,  143,  330,  332,  333,  336,  337,
+	 338,  339,  331,  334,  340,  341,  342,  343,  344,  345,  346,  347,
+	 348,  349,  335,  350,  351,  352,  353,  354,  355,  356,  360,  357,
+	 358,  359,  361,  362,  363,    0,    1,    2,    3,   66,    6,    4,
+	   7,    8,    5,    9,   10,   12,   13,   14,   15,   11,   16,   17,
+	  18,   19,   21,   22,   23,   24,   25,   20,   26,   27,   28,   29,
+	  30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,   41,
+	  42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   52,   53,
+	  54,   55,   56,   60,   57,   58,   59,   61,   62,   63,   64,   65,
+	  67,   68,   69,   70,   72,   71,   73,   74,   75,   76,   77,  147,
+	 149,  151,  152,  153,  150,  154,  155,  156,  157,  158,  159,  160,
+	 161,  162,  163,  164,  165,  166,  167,  168,  169,  172,  175,  176,
+	 170,  174,  177,  185,  189,  182,  183,  184,  179,  180,  181,  186,
+	 187,  188,  190,  191,  192,  196,  193,  194,  195,  197,  198,  199,
+	 200,  201,  171,  202,  203,  148,  204,  205,  206,  207,  208,  209,
+	 210,  211,  212,  213,  173,  178,  214,  215,  216,  217,  218,  219,
+	 220,  221,  222,  223,  253,  254,  255,  256,  257,  494,  265,  266,
+	 267,  268,  269,  270,  271,  272,  273,  274,  275,  276,  277,  278,
+	 279,  280,  281,  282,  283,  284,  285,  286,  287,  288,  289,  290,
+	 291,  292,  293,  294,  295,  296,  297,  298,  299,  300,  301,  302,
+	 303,  304,  305,  306,  307,  308,  309,  310,  311,  312,  313,  314,
+	 315,  316,  317,  318,  319,  320,  321,  322,  323,  324,  325,  326,
+	 327,  328,  329,  258,  259,  260,  261,  262,  263,  264,  144,  145,
+	 146,  224,  227,  225,  226,  228,  229,  230,  231,  232,  233,  234,
+	 235,  237,  238,  243,  244,  240,  245,  246,  247,  248,  249,  250,
+	 251,  252,  236,  239,  241,  242,
+};
+
+static const uint16_t mapi_nameid_names_by_tag[] = {
+	 227,  253,  234,  237,  236,  247,  245,  248,  231,  235,  251,  249,
+	 250,  232,  233,  230,  252,  239,  254,  146,  240,  242,  246,  228,
+	 229,  226,  238,  241,  244,  243,  172,  175,  187,  179,  180,  191,
+	  53,   54,   10,   20,   57,   58,   67,   63,   65,    9,    4,   55,
+	   1,    0,   60,   76,   77,   75,    8,    7,  190,   74,   68,   73,
+	  71,   69,   72,   21,    5,    3,   16,   17,   18,   19,   23,   24,
+	  22,   61,   25,   27,   26,   28,   29,   30,   32,   31,   33,   34,
+	  35,   37,   36,   38,   39,   40,   41,   42,   43,   44,   45,   46,
+	  47,   48,   49,   50,   51,   52,   56,   59,   70,   64,    2,    6,
+	  66,   62,   11,   15,   14,   13,   12,  361,  332,  365,  359,  342,
+	 357,  334,  341,  340,  335,  343,  364,  360,  349,  356,  337,  362,
+	 347,  363,  338,  344,  354,  351,  336,  350,  353,  352,  348,  346,
+	 358,  355,  333,  345,  339,   96,   97,   87,  112,  110,  121,   80,
+	 129,  130,  123,  128,  100,   86,   99,   85,   84,   98,   83,   81,
+	 102,   93,  101,  139,   95,  138,  127,  107,  119,  122,  120,  135,
+	 125,   94,  137,  136,  142,  141,  114,  113,  134,   78,  108,  143,
+	 111,  116,  117,  118,  133,  109,   79,  115,  131,  132,   92,   91,
+	  90,   82,   89,   88,  106,  105,  103,  104,  124,  126,  140,  193,
+	 199,  197,  201,  200,  189,  149,  204,  203,  205,  158,  157,  208,
+	 207,  150,  195,  202,  196,  194,  215,  214,  173,  151,  183,  182,
+	 181,  159,  163,  186,  185,  184,  170,  171,  198,  177,  178,  212,
+	 162,  160,  161,  206,  209,  210,  211,  176,  156,  152,  153,  154,
+	 155,  192,  213,  174,  166,  167,  165,  169,  164,  168,  147,  148,
+	 188,  224,  223,  220,  221,  222,  217,  219,  218,  216,  225,  261,
+	 264,  263,  262,  260,  265,  266,  322,  299,  300,  301,  312,  310,
+	 315,  282,  283,  281,  277,  298,  316,  311,  290,  289,  293,  276,
+	 292,  279,  270,  278,  267,  304,  297,  284,  314,  296,  286,  275,
+	 308,  288,  271,  321,  323,  319,  318,  294,  325,  274,  326,  268,
+	 280,  306,  330,  329,  328,  331,  273,  272,  303,  302,  313,  291,
+	 305,  307,  287,  320,  309,  269,  285,  327,  317,  295,  324,  255,
+	 257,  256,  258,  259,  404,  144,  145,  366,  367,  368,  369,  370,
+	 371,  372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,
+	 383,  384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,
+	 395,  396,  397,  398,  399,  400,  401,  402,  403,  405,  406,  407,
+	 408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,  419,
+	 420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,  431,
+	 432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,  443,
+	 444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,  455,
+	 456,  457,  458,  459,  460,  461,  462,  463,  464,  465,  466,  467,
+	 468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,  479,
+	 480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,  491,
+	 492,  493,
+};
+
+static const uint16_t mapi_nameid_names_by_name[] = {
+	   0,    1,    2,  149,   78,   79,    3,   80,   81,   82,   83,   84,
+	  85,   86,   87,  226,   88,   89,   90,   91,   92,   93,   94,   95,
+	  96,   97,   98,   99,  100,  101,  102,  103,  104,  105,  106,  107,
+	 227,  108,    4,  150,  109,  151,    5,    6,    7,    8,  110,  228,
+	 404,  111,  112,  152,  153,  154,  155,  156,  229,  146,  113,  114,
+	 115,  157,  158,  159,  116,  117,    9,   10,  160,   12,   13,   14,
+	 161,   15,  162,   11,   16,   17,   18,   19,  163,  164,  165,  166,
+	 167,  168,  169,  170,  171,  230,  172,  231,   20,  118,   21,   22,
+	  23,   24,   25,   26,   27,   28,   29,   30,   31,   32,   33,   34,
+	  35,   36,   37,   38,   39,   40,  232,  233,  119,  120,  121,  122,
+	 125,   41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,
+	  52,   53,   54,   55,  173,  174,  123,  124,   56,  234,   57,   58,
+	  59,   60,  175,  126,  176,   61,  127,  177,  178,   62,  235,  236,
+	 237,  128,  129,  216,  217,  218,  219,  220,  221,  222,  223,  224,
+	 225,  238,  130,  239,  179,  240,  131,  180,  184,  185,  186,  181,
+	 182,  183,  255,  256,  257,  258,  259,  187,  241,  242,  243,  244,
+	 132,  245,  133,  134,   63,   64,  246,  135,  188,  332,  260,  261,
+	 262,  263,  264,  265,  266,   65,  189,  190,  191,  136,  137,  138,
+	 192,  193,  194,  195,  196,  197,  198,  199,  200,  201,  202,  203,
+	 247,  248,  139,  147,  148,  267,  268,  269,  270,  271,  272,  273,
+	 274,  275,  276,  277,  278,  279,  280,  281,  282,  283,  284,  285,
+	 286,  287,  288,  289,  290,  291,  292,  293,  294,  295,  296,  297,
+	 298,  299,  300,  301,  302,  303,  304,  305,  306,  307,  308,  309,
+	 310,  311,  312,  313,  314,  315,  316,  317,  318,  319,  320,  321,
+	 322,  323,  324,  325,  326,  327,  328,  329,  330,  331,  204,  140,
+	 205,  206,  249,  250,  333,  334,  335,  336,  337,  338,  339,  340,
+	 341,  342,  343,  344,  345,  346,  207,  347,  348,  349,  350,  208,
+	 351,  352,  353,  354,  355,  356,  357,  358,  359,  360,  361,  362,
+	 363,  364,  365,  251,  141,  142,  143,  209,  210,  211,  212,  213,
+	 214,  215,   66,  252,  253,   67,   68,   69,   70,   72,   71,   73,
+	  74,  254,   75,   76,   77,  375,  405,  144,  145,  366,  406,  367,
+	 407,  408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,
+	 419,  420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,
+	 431,  432,  433,  434,  435,  436,  437,  438,  439,  376,  377,  378,
+	 440,  379,  441,  442,  443,  444,  445,  446,  447,  456,  457,  455,
+	 448,  449,  450,  451,  452,  453,  454,  368,  369,  370,  371,  372,
+	 373,  374,  380,  458,  459,  460,  461,  462,  463,  464,  381,  465,
+	 466,  467,  468,  469,  470,  471,  472,  473,  474,  475,  476,  477,
+	 478,  479,  480,  481,  482,  483,  484,  485,  486,  487,  488,  489,
+	 490,  491,  492,  493,  382,  383,  384,  385,  386,  387,  388,  389,
+	 390,  391,  392,  393,  394,  395,  396,  397,  398,  399,  400,  401,
+	 402,  403,
+};
+
 #endif /* !MAPI_NAMEID_PRIVATE_H__ */
@@ -1189,34 +1189,275 @@ static struct mapi_proptags canonical_property_tags[] = {
 	{ 0,                                                                  0,            "NULL"                                                              }
 };
 
-_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+/* canonical_property_tags positions sorted by property tag and by name */
+static const uint16_t canonical_property_tags_by_tag[] = {
+	1068, 1067,  145,  144,  217,  960,  216,  959,  219,  218,  315,  314,
+	 333,  332,  369,  368,  463,  464,  562,  561,  676,  675,  706,  705,
+	 727,  728,  751,  750,  758,  757,  798,  797,  659,  660,  824,  823,
+	 836,  835,  840,  839, 1005, 1006, 1052, 1049,  261,  260,  832,  831,
+	1020, 1019, 1051, 1050,  764,  763,  766,  765, 1014, 1013, 1018, 1017,
+	 776,  775,  778,  777,  830,  829,  747,  746,  586,  585,  672,  671,
+	 646,  645,  632,  631,  634,  633,  674,  673,  816,  815,  818,  817,
+	 768,  767,  780,  779,  753,  752,  834,  833,  636,  635,  588,  587,
+	 560,  559,  576,  575,  656,  655,  654,  653,  658,  657,  668,  667,
+	 666,  665,  670,  669, 1036, 1033,  355,  354,  697,  698,  846,  845,
+	1010, 1009, 1012, 1011,  650,  649,  652,  651,  662,  661,  664,  663,
+	 295,  294,  293,  290,  638,  637,  640,  639,  642,  641,  760,  759,
+	 762,  761,  772,  771,  774,  773, 1084, 1083, 1078, 1077,  828,  825,
+	 827,  826,  126,  127,  131,  130,  605,  606,  603,  604,  678,  677,
+	 803,  804,  820,  819,  994,  993,  998,  997, 1054, 1053, 1000,  999,
+	 990,  989,  992,  991,  607,  608,  812,  811,  327,  326,  339,  338,
+	 341,  340,  347,  346,  566,  565,  569,  570,  579,  581,  582,  580,
+	 702,  701,  848,  847,  578,  577,  558,  557,  583,  584,  422,  421,
+	 610,  609,  870,  869,  198,  199,  188,  189,  724,  723,  600,  599,
+	1079, 1080, 1060, 1059, 1058, 1057,  756,  741,  982,  981, 1085, 1086,
+	 365,  364,  375,  374,  377,  376,  378,  379,    0,    5,  863,  864,
+	 476,  475,    3,    4,  548,  547,  806,  805, 1040, 1039,  611,  612,
+	 357,  356,  233,  226,  838,  837,  868,  867,  232,  454,  231,  453,
+	 230,  229,  228,  227,  597,  598,  484,  483,  486,  485,  468,  467,
+	 526,  525,  528,  527,  530,  529,  648,  647,  461,  462,  521,  522,
+	 524,  523,  384,  385,  383,  382,  395,  396,  224,  225,  460,  459,
+	 456,  455,  251,  250,  458,  457,  213,  212,  215,  214,  865,  866,
+	 345,  342,  143,  142,  353,  352,  265,  264,  336,  337,  299,  298,
+	 516,  515,  980,  979, 1062, 1061,  289,  288,  292,  291,  153,  152,
+	 712,  711,  853,  854, 1035, 1034,  850,  849,  851,  852,  150,  151,
+	 149,  148, 1043, 1044, 1041, 1042,  278,  279,  393,  394,  282,  283,
+	 286,  287,  984,  983, 1048, 1047,  147,  146,  281,  280,  277,  276,
+	 389,  388,  275,  274,  488,  487,  490,  489,  494,  493,  496,  495,
+	 498,  497,  810,  809,  492,  491,   11,    8,   10,    9,  373,  372,
+	 627,  628,  400,  399,  311,  310,  169,  171,  170,  168,  173,  172,
+	 175,  174,  177,  176,  184,  185,  181,  180,  191,  190,  197,  196,
+	 201,  200,  813,  814,  203,  202,  183,  182,  187,  186,  161,  160,
+	 163,  162,  165,  164,  167,  166,  178,  179,  195,  194,  193,  192,
+	1072, 1071,  348,  351, 1070, 1069,  349,  350, 1024, 1023,   19,   18,
+	   7,    6,  247,  246,  416,  415,  418,  417,  420,  419,  243,  242,
+	 452,  451,  472,  471,  512,  511,  514,  513,  540,  539,  572,  571,
+	 630,  629, 1056, 1055,  644,  643,  716,  715,  269,  268, 1076, 1075,
+	 335,  334,  614,  613,  726,  725,  235,  237,  234,  236,  596,  595,
+	 740,  739,  249,  248,  694,  693, 1082, 1081,  700,  699, 1088, 1087,
+	 722,  721,  239,  238,  450,  449,  297,  296,  538,  537, 1038, 1037,
+	1046, 1045,  718,  717,  714,  713, 1066, 1065,  500,  499,  156,  155,
+	 434,  436,  433,  435,  157,  154,  988,  987, 1108, 1107,  223,  222,
+	 432,  431,  592,  591,  344,  343,  732,  731,  808,  807, 1032, 1031,
+	 271,  270,  305,  304, 1064, 1063,  410,  409,  413,  414,  546,  545,
+	 602,  601,  710,  709,  241,  240,  267,  266,  257,  256,  438,  437,
+	 440,  439,  444,  443,  446,  445,  448,  447,  442,  441,  682,  681,
+	 684,  683,  688,  687,  690,  689,  692,  691,  686,  685, 1092, 1091,
+	 985,  986,  469,  470,  479,  480,  220,  221,    2,    1,  325,  324,
+	 843,  844,  424,  423,  316,  317,  320,  321,  366,  367,  370,  371,
+	 319,  318,  273,  272,  573,  574,  303,  302,  301,  300,  520,  519,
+	 518,  517,  563,  564, 1015, 1016,  743,  742,  745,  744,  749,  748,
+	 284,  285,  995,  996,  738,  737,  481,  482,  567,  568, 1002, 1001,
+	1022, 1021,  755,  754,  770,  769,  782,  781,  789,  790,  796,  791,
+	 795,  794,  793,  792,  784,  783,  786,  785,  801,  800,  787,  788,
+	 799,  802,  503,  504,  509,  510,  505,  506,  501,  502,  508,  507,
+	 594,  593,  822,  821, 1028, 1027,  708,  707,  253,  252,  720,  719,
+	 899,  900,  901,  902,  896,  893,  892,  891,  889,  890,  895,  894,
+	 897,  898, 1090, 1089,  542,  541,  544,  543,  696,  695,  958,  957,
+	 390,  855,  856,  428,  427,   33,   32,  429,  430,  259,  258,  309,
+	 308,  307,  306,  879,  880,  873,  874,  426,  425,  871,  872,  882,
+	 881,  733,  734,  466,  465,  549,  550,  735,  736,  552,  551,  554,
+	 553,  555,  556,  884,  883,  886,  885,  909,  910,  911,  912,  913,
+	 914,  878,  877,  876,  875,  908,  905,  904,  903,  887,  888,  907,
+	 906,  331,  330,  535,  536,  262,  263,   85,   84, 1025, 1026,  534,
+	 531,  533,  532,  328,  329,  387,  386, 1008, 1007,  313,  312,  392,
+	 391,  704,  703,  590,  589,  474,  473,  477,  478,   93,   92,  255,
+	 254,  159,  158,  622,  621,  623, 1103,  624, 1104,  616,  916, 1004,
+	 615, 1003,  915,  619,  620, 1106, 1105,  380,  381,  618,  617,  626,
+	1102, 1101,  625,  245,  244,  842,  841,  969,  970,  965,  966,  955,
+	 977,  956,  978,  928,  968, 1126,  927, 1125,  967,  936,  935,  926,
+	 972,  971,  923,  922,  962,  961,  921,  973,  412,  974,  411,  405,
+	 975, 1135,  406,  976, 1136,  403,  963,  404,  964, 1141,  402, 1142,
+	 401, 1119,  925, 1120,  924,  930, 1130,  929, 1129, 1118, 1117, 1134,
+	1133, 1140, 1139,  952, 1122, 1121,  951,  943, 1124, 1123,  942,  954,
+	1128, 1127,  953, 1137,  945, 1138,  944, 1113,  950, 1114,  949,  941,
+	1110, 1109,  940,  948,  947,  939,  938,  408,  407,  397,  398,  918,
+	 917,  323,  322,  946,  937,  920,  919,  934,  933,  932,  931, 1116,
+	1115, 1112, 1111, 1131, 1132, 1094, 1093, 1098, 1097, 1096, 1095, 1099,
+	1100,  857,  858,  860,  859,  862,  861,  680,  679,  730,  729,  361,
+	 360,  210,  211,  363,  362,  359,  358,  206,  207,  209,  208,  205,
+	 204,   65,   64,   88,   89,   86,   87,   79,   78,   83,   82,   91,
+	  90,  107,  104,  125,  124,  121,  120,  137,  136,  123,  122,  106,
+	 105,   47,   34,   49,   48,   51,   50,   53,   52,   55,   54,   57,
+	  56,   59,   58,   61,   60,   63,   62,   36,   35,   99,   98,   16,
+	  17,   27,   26,   97,   96,   38,   37,   40,   39,   42,   41,   44,
+	  43,   46,   45,  141,  140,  101,  100,  117,  116,  119,  118,  113,
+	 112,  111,  110,  115,  114,   20,   21,   77,   76,  129,  128,   69,
+	  68,   75,   74,   73,   72,   67,   66, 1074, 1073,  134,  135,  103,
+	 102,  133,  132,   95,   94, 1030, 1029,   13,   12,  139,  138,   29,
+	  28,   31,   30,   71,   70,   24,   25,   22,   23, 1143, 1144, 1145,
+	1146, 1147, 1148, 1149, 1150, 1151, 1152, 1153, 1154, 1155, 1156, 1157,
+	1158, 1159, 1160, 1161, 1162, 1163, 1164, 1165, 1166, 1167, 1168, 1169,
+	1170, 1171, 1172, 1173,   81,   80,  109,  108,   14,   15,
+};
+
+static const uint16_t canonical_property_tags_by_name[] = {
+	   0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,
+	  12,   13,   14,   15,   16,   17,   18,   19,   20,   21,   22,   23,
+	  24,   25,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,
+	  36,   37,   38,   39,   40,   41,   42,   43,   44,   45,   46,   47,
+	  48,   49,   50,   51,   52,   53,   54,   55,   56,   57,   58,   59,
+	  60,   61,   62,   63,   64,   65,   66,   67,   68,   69,   70,   71,
+	  72,   73,   74,   75,   76,   77,   78,   79,   80,   81,   82,   83,
+	  84,   85,   86,   87,   88,   89,   90,   91,   92,   93,   94,   95,
+	  96,   97,   98,   99,  100,  101,  102,  103,  104,  105,  106,  107,
+	 108,  109,  110,  111,  112,  113,  114,  115,  116,  117,  118,  119,
+	 120,  121,  122,  123,  124,  125,  126,  127,  128,  129,  130,  131,
+	 132,  133,  134,  135,  136,  137,  138,  139,  140,  141,  142,  143,
+	 144,  145,  146,  147,  148,  149,  150,  151,  152,  153,  154,  155,
+	 156,  157,  158,  159,  160,  161,  162,  163,  164,  165,  166,  167,
+	 168,  169,  170,  171,  172,  173,  174,  175,  176,  177,  178,  179,
+	 180,  181,  182,  183,  184,  185,  186,  187,  188,  189,  190,  191,
+	 192,  193,  194,  195,  196,  197,  198,  199,  200,  201,  202,  203,
+	 204,  205,  206,  207,  208,  209,  210,  211,  212,  213,  214,  215,
+	 216,  217,  218,  219,  220,  221,  222,  223,  224,  225,  226,  227,
+	 228,  229,  230,  231,  232,  233,  234,  235,  236,  237,  238,  239,
+	 240,  241,  242,  243,  244,  245,  246,  247,  248,  249,  250,  251,
+	 252,  253,  254,  255,  256,  257,  258,  259,  260,  261,  262,  263,
+	 264,  265,  266,  267,  268,  269,  270,  271,  272,  273,  274,  275,
+	 276,  277,  278,  279,  280,  281,  282,  283,  284,  285,  286,  287,
+	 288,  289,  290,  291,  292,  293,  294,  295,  296,  297,  298,  299,
+	 300,  301,  302,  303,  304,  305,  306,  307,  308,  309,  310,  311,
+	 312,  313,  314,  315,  316,  317,  318,  319,  320,  321,  322,  323,
+	 324,  325,  326,  327,  328,  329,  330,  331,  332,  333,  334,  335,
+	 336,  337,  338,  339,  340,  341,  342,  343,  344,  345,  346,  347,
+	 348,  349,  350,  351,  352,  353,  354,  355,  356,  357,  358,  359,
+	 360,  361,  362,  363,  364,  365,  366,  367,  368,  369,  370,  371,
+	 372,  373,  374,  375,  376,  377,  378,  379,  380,  381,  382,  383,
+	 384,  385,  386,  387,  388,  389,  390,  391,  392,  393,  394,  395,
+	 396,  397,  398,  399,  400,  401,  402,  403,  404,  405,  406,  407,
+	 408,  409,  410,  411,  412,  413,  414,  415,  416,  417,  418,  419,
+	 420,  421,  422,  423,  424,  425,  426,  427,  428,  429,  430,  431,
+	 432,  433,  434,  435,  436,  437,  438,  439,  440,  441,  442,  443,
+	 444,  445,  446,  447,  448,  449,  450,  451,  452,  453,  454,  455,
+	 456,  457,  458,  459,  460,  461,  462,  463,  464,  465,  466,  467,
+	 468,  469,  470,  471,  472,  473,  474,  475,  476,  477,  478,  479,
+	 480,  481,  482,  483,  484,  485,  486,  487,  488,  489,  490,  491,
+	 492,  493,  494,  495,  496,  497,  498,  499,  500,  501,  502,  503,
+	 504,  505,  506,  507,  508,  509,  510,  511,  512,  513,  514,  515,
+	 516,  517,  518,  519,  520,  521,  522,  523,  524,  525,  526,  527,
+	 528,  529,  530,  531,  532,  533,  534,  535,  536,  537,  538,  539,
+	 540,  541,  542,  543,  544,  545,  546,  547,  548,  549,  550,  551,
+	 552,  553,  554,  555,  556,  557,  558,  559,  560,  561,  562,  563,
+	 564,  565,  566,  567,  568,  569,  570,  571,  572,  573,  574,  575,
+	 576,  577,  578,  579,  580,  581,  582,  583,  584,  585,  586,  587,
+	 588,  589,  590,  591,  592,  593,  594,  595,  596,  597,  598,  599,
+	 600,  601,  602,  603,  604,  605,  606,  607,  608,  609,  610,  611,
+	 612,  613,  614,  615,  616,  617,  618,  619,  620,  621,  622,  623,
+	 624,  625,  626,  627,  628,  629,  630,  631,  632,  633,  634,  635,
+	 636,  637,  638,  639,  640,  641,  642,  643,  644,  645,  646,  647,
+	 648,  649,  650,  651,  652,  653,  654,  655,  656,  657,  658,  659,
+	 660,  661,  662,  663,  664,  665,  666,  667,  668,  669,  670,  671,
+	 672,  673,  674,  675,  676,  677,  678,  679,  680,  681,  682,  683,
+	 684,  685,  686,  687,  688,  689,  690,  691,  692,  693,  694,  695,
+	 696,  697,  698,  699,  700,  701,  702,  703,  704,  705,  706,  707,
+	 708,  709,  710,  711,  712,  713,  714,  715,  716,  717,  718,  719,
+	 720,  721,  722,  723,  724,  725,  726,  727,  728,  729,  730,  731,
+	 732,  733,  734,  735,  736,  737,  738,  739,  740,  741,  742,  743,
+	 744,  745,  746,  747,  748,  749,  750,  751,  752,  753,  754,  755,
+	 756,  757,  758,  759,  760,  761,  762,  763,  764,  765,  766,  767,
+	 768,  769,  770,  771,  772,  773,  774,  775,  776,  777,  778,  779,
+	 780,  781,  782,  783,  784,  785,  786,  787,  788,  789,  790,  791,
+	 792,  793,  794,  795,  796,  797,  798,  799,  800,  801,  802,  803,
+	 804,  805,  806,  807,  808,  809,  810,  811,  812,  813,  814,  815,
+	 816,  817,  818,  819,  820,  821,  822,  823,  824,  825,  826,  827,
+	 828,  829,  830,  831,  832,  833,  834,  835,  836,  837,  838,  839,
+	 840,  841,  842,  843,  844,  845,  846,  847,  848,  849,  850,  851,
+	 852,  853,  854,  855,  856,  857,  858,  859,  860,  861,  862,  863,
+	 864,  865,  866,  867,  868,  869,  870,  871,  872,  873,  874,  875,
+	 876,  877,  878,  879,  880,  881,  882,  883,  884,  885,  886,  887,
+	 888,  889,  890,  891,  892,  893,  894,  895,  896,  897,  898,  899,
+	 900,  901,  902,  903,  904,  905,  906,  907,  908,  909,  910,  911,
+	 912,  913,  914,  915,  916,  917,  918,  919,  920,  921,  922,  923,
+	 924,  925,  926,  927,  928,  929,  930,  931,  932,  933,  934,  935,
+	 936,  937,  938,  939,  940,  941,  942,  943,  944,  945,  946,  947,
+	 948,  949,  950,  951,  952,  953,  954,  955,  956,  957,  958,  959,
+	 960,  961,  962,  963,  964,  965,  966,  967,  968,  969,  970,  971,
+	 972,  973,  974,  975,  976,  977,  978,  979,  980,  981,  982,  983,
+	 984,  985,  986,  987,  988,  989,  990,  991,  992,  993,  994,  995,
+	 996,  997,  998,  999, 1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007,
+	1008, 1009, 1010, 1011, 1012, 1013, 1014, 1015, 1016, 1017, 1018, 1019,
+	1020, 1021, 1022, 1023, 1024, 1025, 1026, 1027, 1028, 1029, 1030, 1031,
+	1032, 1033, 1034, 1035, 1036, 1037, 1038, 1039, 1040, 1041, 1042, 1043,
+	1044, 1045, 1046, 1047, 1048, 1049, 1050, 1051, 1052, 1053, 1054, 1055,
+	1056, 1057, 1058, 1059, 1060, 1061, 1062, 1063, 1064, 1065, 1066, 1067,
+	1068, 1069, 1070, 1071, 1072, 1073, 1074, 1075, 1076, 1077, 1078, 1079,
+	1080, 1081, 1082, 1083, 1084, 1085, 1086, 1087, 1088, 1089, 1090, 1091,
+	1092, 1093, 1094, 1095, 1096, 1097, 1098, 1099, 1100, 1101, 1102, 1103,
+	1104, 1105, 1106, 1107, 1108, 1109, 1110, 1111, 1112, 1113, 1114, 1115,
+	1116, 1117, 1118, 1119, 1120, 1121, 1122, 1123, 1124, 1125, 1126, 1127,
+	1128, 1129, 1130, 1131, 1132, 1133, 1134, 1135, 1136, 1137, 1138, 1139,
+	1140, 1141, 1142, 1160, 1151, 1159, 1144, 1150, 1164, 1147, 1146, 1161,
+	1156, 1162, 1148, 1168, 1169, 1166, 1171, 1172, 1173, 1167, 1170, 1165,
+	1143, 1158, 1157, 1152, 1153, 1149, 1155, 1145, 1163, 1154,
+};
+
+#define	CANONICAL_PROPERTY_TAGS_COUNT	(sizeof (canonical_property_tags_by_tag) / sizeof (canonical_property_tags_by_tag[0]))
+
+/* Position in canonical_property_tags_by_tag of the first entry not
+   lower than proptag */
+static uint32_t proptag_lower_bound(uint32_t proptag)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
+
+	return low;
+}
+
+static const char *proptag_find_name(uint32_t proptag)
+{
+	uint32_t	pos;
+
+	pos = proptag_lower_bound(proptag);
+	if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
+	}
+
+	return NULL;
+}
+
+_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+{
+	const char	*propname;
+
+	propname = proptag_find_name(proptag);
+	if (propname) {
+		return propname;
+	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+		return proptag_find_name(proptag + 1); /* try as _UNICODE variant */
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+	int		ret;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(canonical_property_tags[canonical_property_tags_by_name[mid]].propname, propname);
+		if (ret == 0) {
+			return canonical_property_tags[canonical_property_tags_by_name[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -1225,17 +1466,27 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Pick the first suitable entry in table order, as a linear
+	   scan of canonical_property_tags would */
+	for (pos = proptag_lower_bound((uint32_t)untypedtag << 16);
+	     pos < CANONICAL_PROPERTY_TAGS_COUNT; pos++) {
+		idx = canonical_property_tags_by_tag[pos];
+		if ((canonical_property_tags[idx].proptag >> 16) != untypedtag) {
+			break;
+		}
+		current_type = canonical_property_tags[idx].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
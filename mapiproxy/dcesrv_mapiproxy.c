@@ -754,6 +754,9 @@ NTSTATUS samba_init_module(void)
 	status = ndr_table_register(&ndr_table_exchange_emsmdb);
 	NT_STATUS_NOT_OK_RETURN(status);
 
+	status = ndr_table_register(&ndr_table_exchange_async_emsmdb);
+	NT_STATUS_NOT_OK_RETURN(status);
+
 	status = ndr_table_register(&ndr_table_exchange_nsp);
 	NT_STATUS_NOT_OK_RETURN(status);
 
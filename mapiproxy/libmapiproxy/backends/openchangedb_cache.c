@@ -0,0 +1,1097 @@
+/*
+   MAPI Proxy - OpenchangeDB read-through cache
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file openchangedb_cache.c
+
+   \brief Read-through cache in front of an openchangedb backend
+
+   Mailbox facts which never change once the mailbox is provisioned
+   (mailbox and replica GUIDs, system and special folder identifiers)
+   are cached per mailbox, together with the parent folder and the
+   mapistore URI of the folders already looked up. The URI to folder
+   identifier mapping is cached for all mailboxes.
+
+   Only successful lookups are cached, and a mailbox entry is only
+   created once the backend knows the mailbox. Folder entries are dropped when
+   create_folder, delete_folder or set_mapistoreURI go through this
+   module; changes made by other processes are not seen.
+ */
+
+#include "openchangedb_cache.h"
+
+#include "../libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+#define	OCDB_CACHE_SYSTEM_IDX_MAX	32
+#define	OCDB_CACHE_MAX_FOLDERS		8192
+
+#define	OCDB_CACHE_MAILBOX_GUID		0x1
+#define	OCDB_CACHE_MAILBOX_REPLICA	0x2
+#define	OCDB_CACHE_PUBLIC_REPLICA	0x4
+
+struct ocdb_cache_folder {
+	uint64_t	fid;
+	bool		has_parent_fid;
+	uint64_t	parent_fid;
+	char		*mapistore_uri;
+};
+
+struct ocdb_cache_uri {
+	char		*mapistore_uri;
+	uint64_t	fid;
+};
+
+struct ocdb_cache_mailbox {
+	char		*username;
+	uint32_t	valid;
+	struct GUID	mailbox_guid;
+	uint16_t	replica_id;
+	struct GUID	replica_guid;
+	uint16_t	public_replica_id;
+	struct GUID	public_replica_guid;
+	uint32_t	system_valid;
+	uint64_t	system_fids[OCDB_CACHE_SYSTEM_IDX_MAX];
+	uint32_t	special_valid;
+	uint64_t	special_fids[OCDB_CACHE_SYSTEM_IDX_MAX];
+	uint32_t	public_valid;
+	uint64_t	public_fids[OCDB_CACHE_SYSTEM_IDX_MAX];
+	struct htable	folders;
+	uint32_t	folder_count;
+};
+
+struct ocdb_cache_data {
+	struct openchangedb_context	*backend;
+	struct htable			mailboxes;
+	struct htable			uris;
+	uint64_t			hits;
+	uint64_t			misses;
+};
+
+static struct ocdb_cache_data * _ocdb_cache_data_get(struct openchangedb_context *self)
+{
+	return talloc_get_type(self->data, struct ocdb_cache_data);
+}
+
+// v cache tables -------------------------------------------------------------
+
+/* Usernames are compared case insensitively, like the backends do */
+static size_t _username_hash(const char *username)
+{
+	size_t	h = 0;
+
+	for (; *username; username++) {
+		h = (h << 5) - h + tolower((unsigned char)*username);
+	}
+
+	return h;
+}
+
+static size_t _mailbox_rehash(const void *e, void *unused)
+{
+	return _username_hash(((const struct ocdb_cache_mailbox *)e)->username);
+}
+
+static bool _mailbox_cmp(const void *e, void *username)
+{
+	return strcasecmp(((const struct ocdb_cache_mailbox *)e)->username, (const char *)username) == 0;
+}
+
+static size_t _fid_hash(uint64_t fid)
+{
+	return (size_t)((fid * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static size_t _folder_rehash(const void *e, void *unused)
+{
+	return _fid_hash(((const struct ocdb_cache_folder *)e)->fid);
+}
+
+static bool _folder_cmp(const void *e, void *fid)
+{
+	return ((const struct ocdb_cache_folder *)e)->fid == *(const uint64_t *)fid;
+}
+
+static size_t _uri_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct ocdb_cache_uri *)e)->mapistore_uri);
+}
+
+static bool _uri_cmp(const void *e, void *uri)
+{
+	return strcmp(((const struct ocdb_cache_uri *)e)->mapistore_uri, (const char *)uri) == 0;
+}
+
+static int _ocdb_cache_mailbox_destructor(struct ocdb_cache_mailbox *mailbox)
+{
+	htable_clear(&mailbox->folders);
+	return 0;
+}
+
+static int _ocdb_cache_data_destructor(struct ocdb_cache_data *data)
+{
+	DEBUG(5, ("openchangedb cache: %"PRIu64" hits, %"PRIu64" misses\n",
+		  data->hits, data->misses));
+	htable_clear(&data->mailboxes);
+	htable_clear(&data->uris);
+	return 0;
+}
+
+static struct ocdb_cache_mailbox *_mailbox_lookup(struct ocdb_cache_data *data,
+						  const char *username,
+						  bool create)
+{
+	struct ocdb_cache_mailbox	*mailbox;
+
+	if (!username) return NULL;
+
+	mailbox = htable_get(&data->mailboxes, _username_hash(username), _mailbox_cmp, username);
+	if (mailbox || !create) return mailbox;
+
+	mailbox = talloc_zero(data, struct ocdb_cache_mailbox);
+	if (!mailbox) return NULL;
+	mailbox->username = talloc_strdup(mailbox, username);
+	if (!mailbox->username) goto fail;
+	htable_init(&mailbox->folders, _folder_rehash, NULL);
+	talloc_set_destructor(mailbox, _ocdb_cache_mailbox_destructor);
+
+	if (!htable_add(&data->mailboxes, _username_hash(username), mailbox)) goto fail;
+
+	return mailbox;
+fail:
+	talloc_free(mailbox);
+	return NULL;
+}
+
+static void _mailbox_flush_folders(struct ocdb_cache_mailbox *mailbox)
+{
+	struct htable_iter		i;
+	struct ocdb_cache_folder	*folder;
+
+	for (folder = htable_first(&mailbox->folders, &i); folder;
+	     folder = htable_next(&mailbox->folders, &i)) {
+		talloc_free(folder);
+	}
+	htable_clear(&mailbox->folders);
+	mailbox->folder_count = 0;
+}
+
+static struct ocdb_cache_folder *_folder_lookup(struct ocdb_cache_mailbox *mailbox,
+						uint64_t fid, bool create)
+{
+	struct ocdb_cache_folder	*folder;
+
+	folder = htable_get(&mailbox->folders, _fid_hash(fid), _folder_cmp, &fid);
+	if (folder || !create) return folder;
+
+	/* Bound the memory used by a mailbox with a lot of folders */
+	if (mailbox->folder_count >= OCDB_CACHE_MAX_FOLDERS) {
+		_mailbox_flush_folders(mailbox);
+	}
+
+	folder = talloc_zero(mailbox, struct ocdb_cache_folder);
+	if (!folder) return NULL;
+	folder->fid = fid;
+	if (!htable_add(&mailbox->folders, _fid_hash(fid), folder)) {
+		talloc_free(folder);
+		return NULL;
+	}
+	mailbox->folder_count++;
+
+	return folder;
+}
+
+static void _folder_drop(struct ocdb_cache_data *data, const char *username, uint64_t fid)
+{
+	struct ocdb_cache_mailbox	*mailbox;
+	struct ocdb_cache_folder	*folder;
+
+	mailbox = _mailbox_lookup(data, username, false);
+	if (!mailbox) return;
+
+	folder = _folder_lookup(mailbox, fid, false);
+	if (!folder) return;
+
+	htable_del(&mailbox->folders, _fid_hash(fid), folder);
+	mailbox->folder_count--;
+	talloc_free(folder);
+}
+
+static void _uris_flush(struct ocdb_cache_data *data)
+{
+	struct htable_iter	i;
+	struct ocdb_cache_uri	*entry;
+
+	for (entry = htable_first(&data->uris, &i); entry;
+	     entry = htable_next(&data->uris, &i)) {
+		talloc_free(entry);
+	}
+	htable_clear(&data->uris);
+}
+
+/* Return the cached folder identifier for SystemIdx, if any */
+static bool _system_idx_get(uint32_t valid, const uint64_t *fids,
+			    uint32_t system_idx, uint64_t *fid)
+{
+	if (system_idx >= OCDB_CACHE_SYSTEM_IDX_MAX) return false;
+	if (!(valid & (1U << system_idx))) return false;
+
+	*fid = fids[system_idx];
+	return true;
+}
+
+static void _system_idx_set(uint32_t *valid, uint64_t *fids,
+			    uint32_t system_idx, uint64_t fid)
+{
+	if (system_idx >= OCDB_CACHE_SYSTEM_IDX_MAX) return;
+
+	fids[system_idx] = fid;
+	*valid |= (1U << system_idx);
+}
+
+// ^ cache tables -------------------------------------------------------------
+
+// v cached openchangedb functions --------------------------------------------
+
+static enum MAPISTATUS get_SpecialFolderID(struct openchangedb_context *self,
+					   const char *recipient, uint32_t system_idx,
+					   uint64_t *folder_id)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	mailbox = _mailbox_lookup(priv_data, recipient, false);
+	if (mailbox && _system_idx_get(mailbox->special_valid, mailbox->special_fids, system_idx, folder_id)) {
+		priv_data->hits++;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_SpecialFolderID(priv_data->backend, recipient, system_idx, folder_id);
+	if (retval == MAPI_E_SUCCESS) {
+		mailbox = _mailbox_lookup(priv_data, recipient, true);
+		if (mailbox) {
+			_system_idx_set(&mailbox->special_valid, mailbox->special_fids, system_idx, *folder_id);
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	mailbox = _mailbox_lookup(priv_data, recipient, false);
+	if (mailbox && _system_idx_get(mailbox->system_valid, mailbox->system_fids, SystemIdx, FolderId)) {
+		priv_data->hits++;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_SystemFolderID(priv_data->backend, recipient, SystemIdx, FolderId);
+	if (retval == MAPI_E_SUCCESS) {
+		mailbox = _mailbox_lookup(priv_data, recipient, true);
+		if (mailbox) {
+			_system_idx_set(&mailbox->system_valid, mailbox->system_fids, SystemIdx, *FolderId);
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
+					  const char *username,
+					  uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	mailbox = _mailbox_lookup(priv_data, username, false);
+	if (mailbox && _system_idx_get(mailbox->public_valid, mailbox->public_fids, SystemIdx, FolderId)) {
+		priv_data->hits++;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_PublicFolderID(priv_data->backend, username, SystemIdx, FolderId);
+	if (retval == MAPI_E_SUCCESS) {
+		mailbox = _mailbox_lookup(priv_data, username, true);
+		if (mailbox) {
+			_system_idx_set(&mailbox->public_valid, mailbox->public_fids, SystemIdx, *FolderId);
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS get_MailboxGuid(struct openchangedb_context *self,
+				       const char *recipient,
+				       struct GUID *MailboxGUID)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	mailbox = _mailbox_lookup(priv_data, recipient, false);
+	if (mailbox && (mailbox->valid & OCDB_CACHE_MAILBOX_GUID)) {
+		priv_data->hits++;
+		*MailboxGUID = mailbox->mailbox_guid;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_MailboxGuid(priv_data->backend, recipient, MailboxGUID);
+	if (retval == MAPI_E_SUCCESS) {
+		mailbox = _mailbox_lookup(priv_data, recipient, true);
+		if (mailbox) {
+			mailbox->mailbox_guid = *MailboxGUID;
+			mailbox->valid |= OCDB_CACHE_MAILBOX_GUID;
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
+					  const char *recipient, uint16_t *ReplID,
+					  struct GUID *ReplGUID)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+	uint16_t			repl_id;
+	struct GUID			repl_guid;
+
+	mailbox = _mailbox_lookup(priv_data, recipient, false);
+	if (mailbox && (mailbox->valid & OCDB_CACHE_MAILBOX_REPLICA)) {
+		priv_data->hits++;
+		if (ReplID) *ReplID = mailbox->replica_id;
+		if (ReplGUID) *ReplGUID = mailbox->replica_guid;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_MailboxReplica(priv_data->backend, recipient, &repl_id, &repl_guid);
+	if (retval != MAPI_E_SUCCESS) {
+		return retval;
+	}
+
+	mailbox = _mailbox_lookup(priv_data, recipient, true);
+	if (mailbox) {
+		mailbox->replica_id = repl_id;
+		mailbox->replica_guid = repl_guid;
+		mailbox->valid |= OCDB_CACHE_MAILBOX_REPLICA;
+	}
+
+	if (ReplID) *ReplID = repl_id;
+	if (ReplGUID) *ReplGUID = repl_guid;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_PublicFolderReplica(struct openchangedb_context *self,
+					       const char *username,
+					       uint16_t *ReplID,
+					       struct GUID *ReplGUID)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+	uint16_t			repl_id;
+	struct GUID			repl_guid;
+
+	mailbox = _mailbox_lookup(priv_data, username, false);
+	if (mailbox && (mailbox->valid & OCDB_CACHE_PUBLIC_REPLICA)) {
+		priv_data->hits++;
+		if (ReplID) *ReplID = mailbox->public_replica_id;
+		if (ReplGUID) *ReplGUID = mailbox->public_replica_guid;
+		return MAPI_E_SUCCESS;
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_PublicFolderReplica(priv_data->backend, username, &repl_id, &repl_guid);
+	if (retval != MAPI_E_SUCCESS) {
+		return retval;
+	}
+
+	mailbox = _mailbox_lookup(priv_data, username, true);
+	if (mailbox) {
+		mailbox->public_replica_id = repl_id;
+		mailbox->public_replica_guid = repl_guid;
+		mailbox->valid |= OCDB_CACHE_PUBLIC_REPLICA;
+	}
+
+	if (ReplID) *ReplID = repl_id;
+	if (ReplGUID) *ReplGUID = repl_guid;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+				        struct openchangedb_context *self,
+				        const char *username,
+				        uint64_t fid, char **mapistoreURL,
+				        bool mailboxstore)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox = NULL;
+	struct ocdb_cache_folder	*folder = NULL;
+
+	/* Public folders are shared between mailboxes, do not cache them */
+	if (mailboxstore) {
+		mailbox = _mailbox_lookup(priv_data, username, false);
+		if (mailbox) {
+			folder = _folder_lookup(mailbox, fid, false);
+		}
+		if (folder && folder->mapistore_uri) {
+			*mapistoreURL = talloc_strdup(parent_ctx, folder->mapistore_uri);
+			OPENCHANGE_RETVAL_IF(!*mapistoreURL, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+			priv_data->hits++;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_mapistoreURI(parent_ctx, priv_data->backend, username, fid, mapistoreURL, mailboxstore);
+	if (retval == MAPI_E_SUCCESS && mailboxstore && *mapistoreURL) {
+		mailbox = _mailbox_lookup(priv_data, username, true);
+		folder = mailbox ? _folder_lookup(mailbox, fid, true) : NULL;
+		if (folder) {
+			folder->mapistore_uri = talloc_strdup(folder, *mapistoreURL);
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					const char *mapistoreURL)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	_folder_drop(priv_data, username, fid);
+	_uris_flush(priv_data);
+
+	return priv_data->backend->set_mapistoreURI(priv_data->backend, username, fid, mapistoreURL);
+}
+
+static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      uint64_t *parent_fidp, bool mailboxstore)
+{
+	enum MAPISTATUS			retval;
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox = NULL;
+	struct ocdb_cache_folder	*folder = NULL;
+
+	if (mailboxstore) {
+		mailbox = _mailbox_lookup(priv_data, username, false);
+		if (mailbox) {
+			folder = _folder_lookup(mailbox, fid, false);
+		}
+		if (folder && folder->has_parent_fid) {
+			*parent_fidp = folder->parent_fid;
+			priv_data->hits++;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_parent_fid(priv_data->backend, username, fid, parent_fidp, mailboxstore);
+	if (retval == MAPI_E_SUCCESS && mailboxstore) {
+		mailbox = _mailbox_lookup(priv_data, username, true);
+		folder = mailbox ? _folder_lookup(mailbox, fid, true) : NULL;
+		if (folder) {
+			folder->parent_fid = *parent_fidp;
+			folder->has_parent_fid = true;
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS get_fid(struct openchangedb_context *self,
+			       const char *mapistoreURL, uint64_t *fidp)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_uri	*entry;
+
+	if (mapistoreURL) {
+		entry = htable_get(&priv_data->uris, hash_string(mapistoreURL), _uri_cmp, mapistoreURL);
+		if (entry) {
+			*fidp = entry->fid;
+			priv_data->hits++;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	priv_data->misses++;
+	retval = priv_data->backend->get_fid(priv_data->backend, mapistoreURL, fidp);
+	if (retval == MAPI_E_SUCCESS && mapistoreURL) {
+		entry = talloc_zero(priv_data, struct ocdb_cache_uri);
+		if (entry) {
+			entry->mapistore_uri = talloc_strdup(entry, mapistoreURL);
+			entry->fid = *fidp;
+			if (!entry->mapistore_uri ||
+			    !htable_add(&priv_data->uris, hash_string(mapistoreURL), entry)) {
+				talloc_free(entry);
+			}
+		}
+	}
+
+	return retval;
+}
+
+static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
+				      const char *username,
+				      const char *organization_name,
+				      const char *groupo_name,
+				      int systemIdx, uint64_t fid,
+				      const char *display_name)
+{
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	/* A mailbox provisioned again gets new identifiers */
+	mailbox = _mailbox_lookup(priv_data, username, false);
+	if (mailbox) {
+		htable_del(&priv_data->mailboxes, _username_hash(mailbox->username), mailbox);
+		talloc_free(mailbox);
+	}
+	_uris_flush(priv_data);
+
+	return priv_data->backend->create_mailbox(priv_data->backend, username, organization_name,
+						  groupo_name, systemIdx, fid, display_name);
+}
+
+static enum MAPISTATUS create_folder(struct openchangedb_context *self,
+				     const char *username,
+				     uint64_t parentFolderID, uint64_t fid,
+				     uint64_t changeNumber,
+				     const char *MAPIStoreURI, int systemIdx)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	_folder_drop(priv_data, username, fid);
+	_uris_flush(priv_data);
+
+	return priv_data->backend->create_folder(priv_data->backend, username, parentFolderID, fid,
+						 changeNumber, MAPIStoreURI, systemIdx);
+}
+
+static enum MAPISTATUS delete_folder(struct openchangedb_context *self,
+				     const char *username, uint64_t fid)
+{
+	struct ocdb_cache_data		*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_mailbox	*mailbox;
+
+	/* Subfolders are deleted along with the folder */
+	mailbox = _mailbox_lookup(priv_data, username, false);
+	if (mailbox) {
+		_mailbox_flush_folders(mailbox);
+	}
+	_uris_flush(priv_data);
+
+	return priv_data->backend->delete_folder(priv_data->backend, username, fid);
+}
+
+// ^ cached openchangedb functions --------------------------------------------
+
+// v forwarded openchangedb functions -----------------------------------------
+
+static enum MAPISTATUS get_ReceiveFolderTable(TALLOC_CTX *mem_ctx,
+					      struct openchangedb_context *self,
+					      const char *recipient,
+					      uint32_t *cValues,
+					      struct ReceiveFolder **entries)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_ReceiveFolderTable(mem_ctx, priv_data->backend, recipient, cValues, entries);
+}
+
+static enum MAPISTATUS get_distinguishedName(TALLOC_CTX *parent_ctx,
+					     struct openchangedb_context *self,
+					     uint64_t fid,
+					     char **distinguishedName)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_distinguishedName(parent_ctx, priv_data->backend, fid, distinguishedName);
+}
+
+static enum MAPISTATUS get_MAPIStoreURIs(struct openchangedb_context *self,
+					 const char *username,
+					 TALLOC_CTX *mem_ctx,
+					 struct StringArrayW_r **urisP)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_MAPIStoreURIs(priv_data->backend, username, mem_ctx, urisP);
+}
+
+static enum MAPISTATUS get_ReceiveFolder(TALLOC_CTX *parent_ctx,
+					 struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass,
+					 uint64_t *fid,
+					 const char **ExplicitMessageClass)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_ReceiveFolder(parent_ctx, priv_data->backend, recipient, MessageClass, fid, ExplicitMessageClass);
+}
+
+static enum MAPISTATUS get_TransportFolder(struct openchangedb_context *self,
+					   const char *recipient,
+					   uint64_t *FolderId)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_TransportFolder(priv_data->backend, recipient, FolderId);
+}
+
+static enum MAPISTATUS get_folder_count(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					uint32_t *RowCount)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_folder_count(priv_data->backend, username, fid, RowCount);
+}
+
+static enum MAPISTATUS lookup_folder_property(struct openchangedb_context *self,
+					      uint32_t proptag, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->lookup_folder_property(priv_data->backend, proptag, fid);
+}
+
+static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
+					    const char *username, uint64_t *cn)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_changeNumber(priv_data->backend, username, cn);
+}
+
+static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
+					     TALLOC_CTX *mem_ctx,
+					     const char *username,
+					     uint64_t max,
+					     struct UI8Array_r **cns_p)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_changeNumbers(priv_data->backend, mem_ctx, username, max, cns_p);
+}
+
+static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t *cn)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_next_changeNumber(priv_data->backend, username, cn);
+}
+
+static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
+					   struct openchangedb_context *self,
+					   const char *username,
+					   uint32_t proptag, uint64_t fid,
+					   void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_folder_property(parent_ctx, priv_data->backend, username, proptag, fid, data);
+}
+
+static enum MAPISTATUS set_folder_properties(struct openchangedb_context *self,
+					     const char *username, uint64_t fid,
+					     struct SRow *row)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->set_folder_properties(priv_data->backend, username, fid, row);
+}
+
+static enum MAPISTATUS get_table_property(TALLOC_CTX *parent_ctx,
+					  struct openchangedb_context *self,
+					  const char *ldb_filter,
+					  uint32_t proptag, uint32_t pos,
+					  void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_table_property(parent_ctx, priv_data->backend, ldb_filter, proptag, pos, data);
+}
+
+static enum MAPISTATUS get_fid_by_name(struct openchangedb_context *self,
+				       const char *username,
+				       uint64_t parent_fid,
+				       const char* foldername, uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_fid_by_name(priv_data->backend, username, parent_fid, foldername, fid);
+}
+
+static enum MAPISTATUS get_mid_by_subject(struct openchangedb_context *self,
+					  const char *username,
+					  uint64_t parent_fid,
+					  const char *subject,
+					  bool mailboxstore, uint64_t *mid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_mid_by_subject(priv_data->backend, username, parent_fid, subject, mailboxstore, mid);
+}
+
+static enum MAPISTATUS set_ReceiveFolder(struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->set_ReceiveFolder(priv_data->backend, recipient, MessageClass, fid);
+}
+
+static enum MAPISTATUS get_fid_from_partial_uri(struct openchangedb_context *self,
+						const char *partialURI, uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_fid_from_partial_uri(priv_data->backend, partialURI, fid);
+}
+
+static enum MAPISTATUS get_users_from_partial_uri(TALLOC_CTX *parent_ctx,
+						  struct openchangedb_context *self,
+						  const char *partialURI,
+						  uint32_t *count,
+						  char ***MAPIStoreURI,
+						  char ***users)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_users_from_partial_uri(parent_ctx, priv_data->backend, partialURI, count, MAPIStoreURI, users);
+}
+
+static enum MAPISTATUS get_message_count(struct openchangedb_context *self,
+					 const char *username, uint64_t fid,
+					 uint32_t *RowCount, bool fai)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_message_count(priv_data->backend, username, fid, RowCount, fai);
+}
+
+static enum MAPISTATUS get_system_idx(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      int *system_idx_p)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_system_idx(priv_data->backend, username, fid, system_idx_p);
+}
+
+static enum MAPISTATUS transaction_start(struct openchangedb_context *self)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->transaction_start(priv_data->backend);
+}
+
+static enum MAPISTATUS transaction_commit(struct openchangedb_context *self)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->transaction_commit(priv_data->backend);
+}
+
+static enum MAPISTATUS get_new_public_folderID(struct openchangedb_context *self,
+					       const char *username,
+					       uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_public_folderID(priv_data->backend, username, fid);
+}
+
+static bool is_public_folder_id(struct openchangedb_context *self, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->is_public_folder_id(priv_data->backend, fid);
+}
+
+static enum MAPISTATUS get_indexing_url(struct openchangedb_context *self,
+					const char *username,
+					const char **indexing_url)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_indexing_url(priv_data->backend, username, indexing_url);
+}
+
+static bool set_locale(struct openchangedb_context *self, const char *username, uint32_t lcid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->set_locale(priv_data->backend, username, lcid);
+}
+
+static const char **get_folders_names(TALLOC_CTX *mem_ctx, struct openchangedb_context *self, const char *locale, const char *type)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_folders_names(mem_ctx, priv_data->backend, locale, type);
+}
+
+static enum MAPISTATUS table_init(TALLOC_CTX *mem_ctx,
+				  struct openchangedb_context *self,
+				  const char *username,
+				  uint8_t table_type, uint64_t folderID,
+				  void **table_object)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_init(mem_ctx, priv_data->backend, username, table_type, folderID, table_object);
+}
+
+static enum MAPISTATUS table_set_sort_order(struct openchangedb_context *self,
+					    void *table_object,
+					    struct SSortOrderSet *lpSortCriteria)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_set_sort_order(priv_data->backend, table_object, lpSortCriteria);
+}
+
+static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
+					      void *table_object,
+					      struct mapi_SRestriction *res)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_set_restrictions(priv_data->backend, table_object, res);
+}
+
+static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
+					  struct openchangedb_context *self,
+					  void *table_object,
+					  enum MAPITAGS proptag, uint32_t pos,
+					  bool live_filtered, void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_get_property(mem_ctx, priv_data->backend, table_object, proptag, pos, live_filtered, data);
+}
+
+static enum MAPISTATUS message_create(TALLOC_CTX *mem_ctx,
+				      struct openchangedb_context *self,
+				      const char *username,
+				      uint64_t messageID, uint64_t folderID,
+				      bool fai, void **message_object)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_create(mem_ctx, priv_data->backend, username, messageID, folderID, fai, message_object);
+}
+
+static enum MAPISTATUS message_save(struct openchangedb_context *self,
+				    void *_msg, uint8_t SaveFlags)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_save(priv_data->backend, _msg, SaveFlags);
+}
+
+static enum MAPISTATUS message_open(TALLOC_CTX *mem_ctx,
+				    struct openchangedb_context *self,
+				    const char *username,
+				    uint64_t messageID, uint64_t folderID,
+				    void **message_object, void **msgp)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_open(mem_ctx, priv_data->backend, username, messageID, folderID, message_object, msgp);
+}
+
+static enum MAPISTATUS message_get_property(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *message_object,
+					    uint32_t proptag, void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_get_property(mem_ctx, priv_data->backend, message_object, proptag, data);
+}
+
+static enum MAPISTATUS message_set_properties(TALLOC_CTX *mem_ctx,
+					      struct openchangedb_context *self,
+					      void *message_object,
+					      struct SRow *row)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_set_properties(mem_ctx, priv_data->backend, message_object, row);
+}
+
+// ^ forwarded openchangedb functions -----------------------------------------
+
+/**
+   \details Initialize a caching openchangedb backend
+
+   \param mem_ctx pointer to the memory context
+   \param backend pointer to the openchangedb backend to cache
+   \param ctx pointer on the openchangedb context the function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_initialize(TALLOC_CTX *mem_ctx,
+						       struct openchangedb_context *backend,
+						       struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx;
+	struct ocdb_cache_data		*data;
+
+	OPENCHANGE_RETVAL_IF(!backend, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	data = talloc_zero(oc_ctx, struct ocdb_cache_data);
+	OPENCHANGE_RETVAL_IF(data == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	data->backend = backend;
+	htable_init(&data->mailboxes, _mailbox_rehash, NULL);
+	htable_init(&data->uris, _uri_rehash, NULL);
+	talloc_set_destructor(data, _ocdb_cache_data_destructor);
+
+	oc_ctx->data = data;
+
+	// Initialize struct with function pointers
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "cache_module");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_new_changeNumber = get_new_changeNumber;
+	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
+	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
+	oc_ctx->get_PublicFolderID = get_PublicFolderID;
+	oc_ctx->get_distinguishedName = get_distinguishedName;
+	oc_ctx->get_MailboxGuid = get_MailboxGuid;
+	oc_ctx->get_MailboxReplica = get_MailboxReplica;
+	oc_ctx->get_PublicFolderReplica = get_PublicFolderReplica;
+	oc_ctx->get_parent_fid = get_parent_fid;
+	oc_ctx->get_MAPIStoreURIs = get_MAPIStoreURIs;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+	oc_ctx->set_mapistoreURI = set_mapistoreURI;
+	oc_ctx->get_fid = get_fid;
+	oc_ctx->get_ReceiveFolder = get_ReceiveFolder;
+	oc_ctx->get_ReceiveFolderTable = get_ReceiveFolderTable;
+	oc_ctx->get_TransportFolder = get_TransportFolder;
+	oc_ctx->lookup_folder_property = lookup_folder_property;
+	oc_ctx->set_folder_properties = set_folder_properties;
+	oc_ctx->get_folder_property = get_folder_property;
+	oc_ctx->get_folder_count = get_folder_count;
+	oc_ctx->get_message_count = get_message_count;
+	oc_ctx->get_system_idx = get_system_idx;
+	oc_ctx->get_table_property = get_table_property;
+	oc_ctx->get_fid_by_name = get_fid_by_name;
+	oc_ctx->get_mid_by_subject = get_mid_by_subject;
+	oc_ctx->set_ReceiveFolder = set_ReceiveFolder;
+	oc_ctx->create_mailbox = create_mailbox;
+	oc_ctx->create_folder = create_folder;
+	oc_ctx->delete_folder = delete_folder;
+	oc_ctx->get_fid_from_partial_uri = get_fid_from_partial_uri;
+	oc_ctx->get_users_from_partial_uri = get_users_from_partial_uri;
+
+	oc_ctx->table_init = table_init;
+	oc_ctx->table_set_sort_order = table_set_sort_order;
+	oc_ctx->table_set_restrictions = table_set_restrictions;
+	oc_ctx->table_get_property = table_get_property;
+
+	oc_ctx->message_create = message_create;
+	oc_ctx->message_save = message_save;
+	oc_ctx->message_open = message_open;
+	oc_ctx->message_get_property = message_get_property;
+	oc_ctx->message_set_properties = message_set_properties;
+
+	oc_ctx->transaction_start = transaction_start;
+	oc_ctx->transaction_commit = transaction_commit;
+
+	oc_ctx->get_new_public_folderID = get_new_public_folderID;
+	oc_ctx->is_public_folder_id = is_public_folder_id;
+
+	oc_ctx->get_indexing_url = get_indexing_url;
+	oc_ctx->set_locale = set_locale;
+	oc_ctx->get_folders_names = get_folders_names;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the hit and miss counters of a caching
+   openchangedb backend. The counters are per process; they are
+   also logged when the cache is released.
+
+   \param oc_ctx pointer to the openchangedb context returned by
+   openchangedb_cache_initialize
+   \param hits pointer on the number of lookups served from the cache
+   \param misses pointer on the number of lookups sent to the backend
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_get_stats(struct openchangedb_context *oc_ctx,
+						      uint64_t *hits, uint64_t *misses)
+{
+	struct ocdb_cache_data	*data;
+
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!hits || !misses, MAPI_E_INVALID_PARAMETER, NULL);
+
+	data = talloc_get_type(oc_ctx->data, struct ocdb_cache_data);
+	OPENCHANGE_RETVAL_IF(!data, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*hits = data->hits;
+	*misses = data->misses;
+
+	return MAPI_E_SUCCESS;
+}
@@ -0,0 +1,33 @@
+/*
+   MAPI Proxy - OpenchangeDB read-through cache
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __OPENCHANGEDB_CACHE_H__
+#define __OPENCHANGEDB_CACHE_H__
+
+#include "openchangedb_backends.h"
+
+enum MAPISTATUS openchangedb_cache_initialize(TALLOC_CTX *mem_ctx,
+					      struct openchangedb_context *backend,
+					      struct openchangedb_context **ctx);
+enum MAPISTATUS openchangedb_cache_get_stats(struct openchangedb_context *oc_ctx,
+					     uint64_t *hits, uint64_t *misses);
+
+#endif /* __OPENCHANGEDB_CACHE_H__ */
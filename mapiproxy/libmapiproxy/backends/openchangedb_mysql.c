@@ -65,30 +65,19 @@ static enum MAPISTATUS get_SpecialFolderID(struct openchangedb_context *self,
 					   uint32_t system_idx,
 					   uint64_t *folder_id)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_SpecialFolderId");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	return status(prepared_select_first_uint(conn,
 		"SELECT f.folder_id FROM folders f "
 		"JOIN mailboxes m ON f.mailbox_id = m.id "
-		"  AND m.name = '%s' "
-		"WHERE f.SystemIdx = %"PRIu32
+		"  AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
 		"  AND f.folder_class = '"SYSTEM_FOLDER"' "
 		"  AND f.parent_folder_id IS NOT NULL",
-		_sql(mem_ctx, recipient), system_idx);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, folder_id));
-
-	talloc_free(mem_ctx);
-	return retval;
+		folder_id, "su", recipient, system_idx));
 }
 
 static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
@@ -96,36 +85,25 @@ static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
 					  uint32_t SystemIdx,
 					  uint64_t *FolderId)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_SystemFolderId");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (SystemIdx == 0x1) {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT folder_id FROM mailboxes WHERE name = '%s'",
-			_sql(mem_ctx, recipient));
-	} else {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f.folder_id FROM folders f "
-			"JOIN mailboxes m ON f.mailbox_id = m.id "
-			"  AND m.name = '%s' "
-			"WHERE f.SystemIdx = %"PRIu32
-			"  AND f.folder_class = '"SYSTEM_FOLDER"' "
-			"ORDER BY parent_folder_id",
-			_sql(mem_ctx, recipient), SystemIdx);
+		return status(prepared_select_first_uint(conn,
+			"SELECT folder_id FROM mailboxes WHERE name = ?",
+			FolderId, "s", recipient));
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, FolderId));
 
-	talloc_free(mem_ctx);
-	return retval;
+	return status(prepared_select_first_uint(conn,
+		"SELECT f.folder_id FROM folders f "
+		"JOIN mailboxes m ON f.mailbox_id = m.id "
+		"  AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
+		"  AND f.folder_class = '"SYSTEM_FOLDER"' "
+		"ORDER BY parent_folder_id",
+		FolderId, "su", recipient, SystemIdx));
 }
 
 static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
@@ -133,28 +111,17 @@ static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
 					  uint32_t SystemIdx,
 					  uint64_t *FolderId)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_PublicFolderID");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	return status(prepared_select_first_uint(conn,
 		"SELECT f.folder_id FROM folders f "
-		"JOIN mailboxes m ON f.ou_id = m.ou_id AND m.name = '%s' "
-		"WHERE f.SystemIdx = %"PRIu32
+		"JOIN mailboxes m ON f.ou_id = m.ou_id AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
 		"  AND f.folder_class = '"PUBLIC_FOLDER"'",
-		_sql(mem_ctx, username), SystemIdx);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, FolderId));
-
-	talloc_free(mem_ctx);
-	return retval;
+		FolderId, "su", username, SystemIdx));
 }
 
 static enum MAPISTATUS get_distinguishedName(TALLOC_CTX *parent_ctx,
@@ -172,7 +139,6 @@ static enum MAPISTATUS get_MailboxGuid(struct openchangedb_context *self,
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql;
 	const char	*guid;
 	NTSTATUS	nt_status;
 
@@ -181,12 +147,9 @@ static enum MAPISTATUS get_MailboxGuid(struct openchangedb_context *self,
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
 
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT MailboxGUID FROM mailboxes WHERE name = '%s'",
-		_sql(mem_ctx, recipient));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_string(mem_ctx, conn, sql, &guid));
+	retval = status(prepared_select_first_string(mem_ctx, conn,
+		"SELECT MailboxGUID FROM mailboxes WHERE name = ?",
+		&guid, "s", recipient));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 	nt_status = GUID_from_string(guid, MailboxGUID);
@@ -204,7 +167,6 @@ static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql;
 	const char	*guid;
 	uint64_t	n = 0;
 	NTSTATUS	nt_status;
@@ -215,22 +177,18 @@ static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
 
 	if (ReplID) {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT ReplicaID FROM mailboxes WHERE name = '%s'",
-			_sql(mem_ctx, recipient));
-		OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-		retval = status(select_first_uint(conn, sql, &n));
+		retval = status(prepared_select_first_uint(conn,
+			"SELECT ReplicaID FROM mailboxes WHERE name = ?",
+			&n, "s", recipient));
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		*ReplID = (uint16_t) n;
 	}
 
 	if (ReplGUID) {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT ReplicaGUID FROM mailboxes WHERE name = '%s'",
-			_sql(mem_ctx, recipient));
-		OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-		retval = status(select_first_string(mem_ctx, conn, sql, &guid));
+		retval = status(prepared_select_first_string(mem_ctx, conn,
+			"SELECT ReplicaGUID FROM mailboxes WHERE name = ?",
+			&guid, "s", recipient));
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		nt_status = GUID_from_string(guid, ReplGUID);
@@ -249,7 +207,6 @@ static enum MAPISTATUS get_PublicFolderReplica(struct openchangedb_context *self
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql;
 	const char	*guid;
 	uint64_t	n = 0;
 	NTSTATUS	nt_status;
@@ -260,24 +217,20 @@ static enum MAPISTATUS get_PublicFolderReplica(struct openchangedb_context *self
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
 
 	if (ReplID) {
-		sql = talloc_asprintf(mem_ctx,
+		retval = status(prepared_select_first_uint(conn,
 			"SELECT pf.ReplicaID FROM public_folders pf "
-			"JOIN mailboxes m ON m.ou_id = pf.ou_id AND m.name = '%s'",
-			_sql(mem_ctx, username));
-		OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-		retval = status(select_first_uint(conn, sql, &n));
+			"JOIN mailboxes m ON m.ou_id = pf.ou_id AND m.name = ?",
+			&n, "s", username));
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		*ReplID = (uint16_t) n;
 	}
 
 	if (ReplGUID) {
-		sql = talloc_asprintf(mem_ctx,
+		retval = status(prepared_select_first_string(mem_ctx, conn,
 			"SELECT StoreGUID FROM public_folders pf "
-			"JOIN mailboxes m ON m.ou_id = pf.ou_id AND m.name = '%s'",
-			_sql(mem_ctx, username));
-		OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-		retval = status(select_first_string(mem_ctx, conn, sql, &guid));
+			"JOIN mailboxes m ON m.ou_id = pf.ou_id AND m.name = ?",
+			&guid, "s", username));
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		nt_status = GUID_from_string(guid, ReplGUID);
@@ -293,32 +246,21 @@ static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
 				        const char *username, uint64_t fid,
 				        char **mapistoreURL, bool mailboxstore)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_mapistoreURI");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (!mailboxstore) {
-		talloc_free(mem_ctx);
 		// TODO is it possible?
 		return _not_implemented("get_mapistoreURI with mailboxstore=false");
 	}
 
-	sql = talloc_asprintf(mem_ctx,
+	return status(prepared_select_first_string(parent_ctx, conn,
 		"SELECT MAPIStoreURI FROM folders f "
-		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = '%s' "
-		"WHERE f.folder_id = %"PRIu64, _sql(mem_ctx, username), fid);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_string(parent_ctx, conn, sql, (const char **)mapistoreURL));
-
-	talloc_free(mem_ctx);
-	return retval;
+		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = ? "
+		"WHERE f.folder_id = ?",
+		(const char **)mapistoreURL, "sU", username, fid));
 }
 
 static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
@@ -356,47 +298,35 @@ static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
 				      const char *username, uint64_t fid,
 				      uint64_t *parent_fidp, bool mailboxstore)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
 
-	mem_ctx = talloc_named(NULL, 0, "get_parent_fid");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (mailboxstore) {
-		sql = talloc_asprintf(mem_ctx,
+		return status(prepared_select_first_uint(conn,
 			"SELECT f1.folder_id FROM folders f1 "
 			"JOIN folders f2 ON f1.id = f2.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64" "
+			"  AND f2.folder_id = ? "
 			"JOIN mailboxes m ON m.id = f2.mailbox_id"
-			"  AND m.name = '%s' "
+			"  AND m.name = ? "
 			"UNION "
 			"SELECT m.folder_id FROM mailboxes m "
 			"JOIN folders f1 ON f1.mailbox_id = m.id"
 			"  AND f1.parent_folder_id IS NULL "
-			"  AND f1.folder_id = %"PRIu64" "
-			"WHERE m.name = '%s'",
-			fid, _sql(mem_ctx, username),
-			fid, _sql(mem_ctx, username));
-	} else {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f1.folder_id FROM folders f1 "
-			"JOIN folders f2 ON f1.id = f2.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64" "
-			"JOIN mailboxes m ON m.ou_id = f2.ou_id"
-			"  AND m.name = '%s' "
-			"WHERE f1.folder_class = '"PUBLIC_FOLDER"'",
-			fid, _sql(mem_ctx, username));
+			"  AND f1.folder_id = ? "
+			"WHERE m.name = ?",
+			parent_fidp, "UsUs", fid, username, fid, username));
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 
-	retval = status(select_first_uint(conn, sql, parent_fidp));
-
-	talloc_free(mem_ctx);
-	return retval;
+	return status(prepared_select_first_uint(conn,
+		"SELECT f1.folder_id FROM folders f1 "
+		"JOIN folders f2 ON f1.id = f2.parent_folder_id"
+		"  AND f2.folder_id = ? "
+		"JOIN mailboxes m ON m.ou_id = f2.ou_id"
+		"  AND m.name = ? "
+		"WHERE f1.folder_class = '"PUBLIC_FOLDER"'",
+		parent_fidp, "Us", fid, username));
 }
 
 static enum MAPISTATUS get_fid(struct openchangedb_context *self,
@@ -405,7 +335,7 @@ static enum MAPISTATUS get_fid(struct openchangedb_context *self,
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql, *mapistore_uri_2;
+	char		*mapistore_uri_2;
 
 	mem_ctx = talloc_named(NULL, 0, "get_fid");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
@@ -421,13 +351,10 @@ static enum MAPISTATUS get_fid(struct openchangedb_context *self,
 		OPENCHANGE_RETVAL_IF(!mapistore_uri_2, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 	}
 
-	sql = talloc_asprintf(mem_ctx,
+	retval = status(prepared_select_first_uint(conn,
 		"SELECT folder_id FROM folders "
-		"WHERE MAPIStoreURI = '%s' OR MAPIStoreURI = '%s'",
-		_sql(mem_ctx, mapistore_uri), _sql(mem_ctx, mapistore_uri_2));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, fidp));
+		"WHERE MAPIStoreURI = ? OR MAPIStoreURI = ?",
+		fidp, "ss", mapistore_uri, mapistore_uri_2));
 
 	talloc_free(mem_ctx);
 	return retval;
@@ -176,6 +176,7 @@ static NTSTATUS mapiproxy_server_load(struct dcesrv_context *dce_ctx)
 	const char				*rfr;
 	const char				*server_name[] = { NDR_EXCHANGE_NSP_NAME, 
 								   NDR_EXCHANGE_EMSMDB_NAME,
+								   NDR_EXCHANGE_ASYNC_EMSMDB_NAME,
 								   NDR_EXCHANGE_DS_RFR_NAME, NULL };
 
 	/* Check server mode */
@@ -21,6 +21,8 @@
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
 
 /**
    \file dcesrv_mapiproxy_session.c
@@ -211,3 +213,164 @@ bool mpm_session_cmp(struct mpm_session *session,
 	return mpm_session_cmp_sub(session, dce_call->conn->server_id, 
 				   dce_call->context->context_id);
 }
+
+
+/* GUID indexed registry of sessions */
+struct mpm_session_registry_entry {
+	struct GUID	uuid;
+	void		*data;
+};
+
+struct mpm_session_registry {
+	struct htable	ht;
+	uint32_t	count;
+};
+
+
+static size_t mpm_session_registry_hash(const struct GUID *uuid)
+{
+	return hash_any(uuid, sizeof (struct GUID), 0);
+}
+
+static size_t mpm_session_registry_rehash(const void *e, void *unused)
+{
+	return mpm_session_registry_hash(&((const struct mpm_session_registry_entry *)e)->uuid);
+}
+
+static bool mpm_session_registry_cmp(const void *e, void *uuid)
+{
+	return GUID_equal(&((const struct mpm_session_registry_entry *)e)->uuid, (const struct GUID *)uuid);
+}
+
+static int mpm_session_registry_destructor(struct mpm_session_registry *registry)
+{
+	htable_clear(&registry->ht);
+	return 0;
+}
+
+static struct mpm_session_registry_entry *mpm_session_registry_lookup(struct mpm_session_registry *registry,
+								     const struct GUID *uuid)
+{
+	return htable_get(&registry->ht, mpm_session_registry_hash(uuid),
+			  mpm_session_registry_cmp, discard_const_p(struct GUID, uuid));
+}
+
+
+/**
+   \details Create a registry mapping session handle GUIDs to the
+   sessions of a mapiproxy server
+
+   Lookups, insertions and removals are performed in constant time
+   using a hash table.
+
+   \param mem_ctx pointer to the memory context
+
+   \return Pointer to an allocated registry on success, otherwise NULL
+ */
+struct mpm_session_registry *mpm_session_registry_init(TALLOC_CTX *mem_ctx)
+{
+	struct mpm_session_registry	*registry;
+
+	registry = talloc_zero(mem_ctx, struct mpm_session_registry);
+	if (!registry) return NULL;
+
+	htable_init(&registry->ht, mpm_session_registry_rehash, NULL);
+	talloc_set_destructor(registry, mpm_session_registry_destructor);
+
+	return registry;
+}
+
+
+/**
+   \details Register a session under a GUID
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the GUID identifying the session
+   \param data pointer to the session
+
+   \return true on success, otherwise false
+ */
+bool mpm_session_registry_add(struct mpm_session_registry *registry,
+			      const struct GUID *uuid, void *data)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!registry || !uuid || !data) return false;
+	if (mpm_session_registry_lookup(registry, uuid)) return false;
+
+	entry = talloc_zero(registry, struct mpm_session_registry_entry);
+	if (!entry) return false;
+
+	entry->uuid = *uuid;
+	entry->data = data;
+
+	if (!htable_add(&registry->ht, mpm_session_registry_hash(uuid), entry)) {
+		talloc_free(entry);
+		return false;
+	}
+	registry->count++;
+
+	return true;
+}
+
+
+/**
+   \details Retrieve the session registered under a GUID
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the GUID identifying the session
+
+   \return Pointer to the session on success, otherwise NULL
+ */
+void *mpm_session_registry_find(struct mpm_session_registry *registry,
+				const struct GUID *uuid)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!registry || !uuid) return NULL;
+
+	entry = mpm_session_registry_lookup(registry, uuid);
+
+	return entry ? entry->data : NULL;
+}
+
+
+/**
+   \details Remove the session registered under a GUID
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the GUID identifying the session
+
+   \return true if a session was removed, otherwise false
+ */
+bool mpm_session_registry_del(struct mpm_session_registry *registry,
+			      const struct GUID *uuid)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!registry || !uuid) return false;
+
+	entry = mpm_session_registry_lookup(registry, uuid);
+	if (!entry) return false;
+
+	htable_del(&registry->ht, mpm_session_registry_hash(uuid), entry);
+	talloc_free(entry);
+	registry->count--;
+
+	return true;
+}
+
+
+/**
+   \details Return the number of sessions in a registry
+
+   \param registry pointer to the session registry
+
+   \return number of registered sessions
+ */
+uint32_t mpm_session_registry_count(struct mpm_session_registry *registry)
+{
+	if (!registry) return 0;
+
+	return registry->count;
+}
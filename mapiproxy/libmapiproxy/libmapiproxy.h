@@ -36,6 +36,8 @@
 #include <gen_ndr/server_id.h>
 #include <gen_ndr/exchange.h>
 
+struct mpm_session_registry;
+
 struct mapiproxy {
 	bool			norelay;
 	bool			ahead;
@@ -124,16 +126,37 @@ struct mapi_handles {
 };
 
 
+/**
+   Slot of the MAPI handles table. A handle value embeds the slot
+   index in its lower bits and the slot generation in its upper
+   bits, so that a released handle never resolves to the slot once
+   it has been reused. Slot 0 is never used and stands for "no
+   slot" in the parent, child and sibling links.
+ */
+struct mapi_handles_slot {
+	struct mapi_handles	*rec;
+	uint32_t		generation;
+	uint32_t		parent;
+	uint32_t		first_child;
+	uint32_t		prev_sibling;
+	uint32_t		next_sibling;
+};
+
+
 struct mapi_handles_context {
-	TDB_CONTEXT	       	*tdb_ctx;
-	uint32_t		last_handle;
-	struct mapi_handles    	*handles;
+	struct mapi_handles_slot	*slots;
+	uint32_t			slot_count;
+	uint32_t			slot_size;
+	uint32_t			free_slot;
+	struct mapi_handles		*handles;
 };
 
 
-#define	MAPI_HANDLES_RESERVED	0xFFFFFFFF
-#define	MAPI_HANDLES_ROOT	"root"
-#define	MAPI_HANDLES_NULL	"null"
+#define	MAPI_HANDLES_RESERVED		0xFFFFFFFF
+#define	MAPI_HANDLES_INDEX_BITS		20
+#define	MAPI_HANDLES_INDEX_MASK		((1 << MAPI_HANDLES_INDEX_BITS) - 1)
+#define	MAPI_HANDLES_GENERATION_MASK	(0xFFFFFFFF >> MAPI_HANDLES_INDEX_BITS)
+#define	MAPI_HANDLES_MAX_SLOTS		MAPI_HANDLES_INDEX_MASK
 
 
 /**
@@ -195,6 +218,11 @@ bool mpm_session_set_private_data(struct mpm_session *, void *);
 bool mpm_session_release(struct mpm_session *);
 bool mpm_session_cmp_sub(struct mpm_session *, struct server_id, uint32_t);
 bool mpm_session_cmp(struct mpm_session *, struct dcesrv_call_state *);
+struct mpm_session_registry *mpm_session_registry_init(TALLOC_CTX *);
+bool mpm_session_registry_add(struct mpm_session_registry *, const struct GUID *, void *);
+void *mpm_session_registry_find(struct mpm_session_registry *, const struct GUID *);
+bool mpm_session_registry_del(struct mpm_session_registry *, const struct GUID *);
+uint32_t mpm_session_registry_count(struct mpm_session_registry *);
 
 struct openchangedb_context;
 
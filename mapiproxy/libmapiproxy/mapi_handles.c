@@ -31,6 +31,13 @@
 #include "libmapiproxy.h"
 
 
+#define	MAPI_HANDLES_INITIAL_SLOTS	64
+
+#define	MAPI_HANDLES_VALUE(idx, gen)	(((gen) << MAPI_HANDLES_INDEX_BITS) | (idx))
+#define	MAPI_HANDLES_SLOT_INDEX(h)	((h) & MAPI_HANDLES_INDEX_MASK)
+#define	MAPI_HANDLES_SLOT_GENERATION(h)	((h) >> MAPI_HANDLES_INDEX_BITS)
+
+
 /**
    \details Initialize MAPI handles context
 
@@ -46,15 +53,19 @@ _PUBLIC_ struct mapi_handles_context *mapi_handles_init(TALLOC_CTX *mem_ctx)
 	handles_ctx = talloc_zero(mem_ctx, struct mapi_handles_context);
 	if (!handles_ctx) return NULL;
 
-	/* Step 2. Initialize the TDB context */
-	handles_ctx->tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	/* Step 2. Initialize the slots table, slot 0 is never used */
+	handles_ctx->slots = talloc_zero_array(handles_ctx, struct mapi_handles_slot, MAPI_HANDLES_INITIAL_SLOTS);
+	if (!handles_ctx->slots) {
+		talloc_free(handles_ctx);
+		return NULL;
+	}
+	handles_ctx->slot_size = MAPI_HANDLES_INITIAL_SLOTS;
+	handles_ctx->slot_count = 1;
+	handles_ctx->free_slot = 0;
 
 	/* Step 3. Initialize the handles list */
 	handles_ctx->handles = NULL;
 
-	/* Step 4. Set last_handle to the first valid value */
-	handles_ctx->last_handle = 1;
-
 	return handles_ctx;
 }
 
@@ -71,7 +82,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	tdb_close(handles_ctx->tdb_ctx);
 	talloc_free(handles_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -79,7 +89,29 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 
 
 /**
-   \details Search for a record in the TDB database
+   \details Resolve a handle value to the index of the slot holding
+   it
+
+   \param handles_ctx pointer to the MAPI handles context
+   \param handle MAPI handle to resolve
+
+   \return slot index on success, 0 if the handle is not in use
+ */
+static inline uint32_t mapi_handles_slot_lookup(struct mapi_handles_context *handles_ctx,
+						uint32_t handle)
+{
+	uint32_t	idx = MAPI_HANDLES_SLOT_INDEX(handle);
+
+	if (!idx || idx >= handles_ctx->slot_count) return 0;
+	if (!handles_ctx->slots[idx].rec) return 0;
+	if (handles_ctx->slots[idx].generation != MAPI_HANDLES_SLOT_GENERATION(handle)) return 0;
+
+	return idx;
+}
+
+
+/**
+   \details Search for a MAPI handle
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle MAPI handle to lookup
@@ -91,168 +123,116 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 _PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
 					     uint32_t handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	struct mapi_handles	*el;
+	uint32_t	idx;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_search");
+	idx = mapi_handles_slot_lookup(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!idx, MAPI_E_NOT_FOUND, NULL);
 
-	/* Step 1. Search for the handle within TDB database */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	*rec = handles_ctx->slots[idx].rec;
 
-	dbuf = tdb_fetch(handles_ctx->tdb_ctx, key);
-	talloc_free(key.dptr);
-	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, mem_ctx);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, mem_ctx);
-
-	talloc_free(mem_ctx);
-	/* Ensure this is not a free'd record */
-	if (dbuf.dsize == (sizeof(MAPI_HANDLES_NULL) - 1) && !strncmp((char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize)) {
-		free(dbuf.dptr);
-		return MAPI_E_NOT_FOUND;
-	}
-	free(dbuf.dptr);
-
-	/* Step 2. Return the record within the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			*rec = el;
-			return MAPI_E_SUCCESS;
-		}
-	}
-
-	return MAPI_E_CORRUPT_STORE;
+	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Set a TDB record data as null meaning it can be reused in
-   the future.
+   \details Reserve a slot in the handles table, either from the free
+   list or by extending the table
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle handle key value to free
 
-   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+   \return slot index on success, 0 if the table is full or memory
+   could not be allocated
  */
-static enum MAPISTATUS mapi_handles_tdb_free(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle)
+static uint32_t mapi_handles_slot_alloc(struct mapi_handles_context *handles_ctx)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	int			ret;
+	struct mapi_handles_slot	*slots;
+	uint32_t			idx;
+	uint32_t			size;
+
+	/* Step 1. Reuse the most recently released slot */
+	if (handles_ctx->free_slot) {
+		idx = handles_ctx->free_slot;
+		handles_ctx->free_slot = handles_ctx->slots[idx].next_sibling;
+		handles_ctx->slots[idx].next_sibling = 0;
+		return idx;
+	}
 
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	/* Step 2. Extend the table if needed */
+	if (handles_ctx->slot_count >= MAPI_HANDLES_MAX_SLOTS) {
+		DEBUG(0, ("[%s:%d]: MAPI handles table is full\n", __FUNCTION__, __LINE__));
+		return 0;
+	}
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_free");
-	
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update existing record */
-	dbuf.dptr = (unsigned char *)MAPI_HANDLES_NULL;
-	dbuf.dsize = sizeof(MAPI_HANDLES_NULL) - 1;
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		return MAPI_E_CORRUPT_STORE;
+	if (handles_ctx->slot_count == handles_ctx->slot_size) {
+		size = handles_ctx->slot_size * 2;
+		if (size > MAPI_HANDLES_MAX_SLOTS) {
+			size = MAPI_HANDLES_MAX_SLOTS;
+		}
+		slots = talloc_realloc(handles_ctx, handles_ctx->slots, struct mapi_handles_slot, size);
+		if (!slots) return 0;
+		memset(&slots[handles_ctx->slot_size], 0, (size - handles_ctx->slot_size) * sizeof (struct mapi_handles_slot));
+		handles_ctx->slots = slots;
+		handles_ctx->slot_size = size;
 	}
 
-	return MAPI_E_SUCCESS;
+	idx = handles_ctx->slot_count;
+	handles_ctx->slot_count += 1;
+
+	return idx;
 }
 
 
 /**
-   \details Update a TDB record
+   \details Return a slot to the free list and bump its generation so
+   the handle value it held becomes stale
 
-   
+   \param handles_ctx pointer to the MAPI handles context
+   \param idx index of the slot to release
  */
-static enum MAPISTATUS mapi_handles_tdb_update(struct mapi_handles_context *handles_ctx,
-					       uint32_t handle, uint32_t container_handle)
+static void mapi_handles_slot_free(struct mapi_handles_context *handles_ctx, uint32_t idx)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	int		ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handle, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_update");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update record */
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to update 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-
-		return MAPI_E_CORRUPT_STORE;	
-	}
-
-	return MAPI_E_SUCCESS;
+	struct mapi_handles_slot	*slot = &handles_ctx->slots[idx];
+
+	slot->rec = NULL;
+	slot->generation = (slot->generation + 1) & MAPI_HANDLES_GENERATION_MASK;
+	slot->parent = 0;
+	slot->first_child = 0;
+	slot->prev_sibling = 0;
+	slot->next_sibling = handles_ctx->free_slot;
+	handles_ctx->free_slot = idx;
 }
 
 
 /**
-   \details Traverse TDB database and search for the first record
-   which dbuf value is "null" string.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key
-   \param dbuf the current TDB value
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
+   \details Detach a slot from the children list of its parent
+
+   \param handles_ctx pointer to the MAPI handles context
+   \param idx index of the slot to detach
+ */
+static void mapi_handles_slot_unlink(struct mapi_handles_context *handles_ctx, uint32_t idx)
 {
-	TALLOC_CTX	*mem_ctx;
-	uint32_t	*handle = (uint32_t *) state;
-	char		*handle_str = NULL;
+	struct mapi_handles_slot	*slot = &handles_ctx->slots[idx];
 
-	if (dbuf.dptr && (dbuf.dsize == sizeof(MAPI_HANDLES_NULL) - 1) && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize) == 0) {
-		mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_null");
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		*handle = strtol((const char *) handle_str, NULL, 16);
-		talloc_free(mem_ctx);
+	if (!slot->parent) return;
 
-		return 1;
+	if (slot->prev_sibling) {
+		handles_ctx->slots[slot->prev_sibling].next_sibling = slot->next_sibling;
+	} else {
+		handles_ctx->slots[slot->parent].first_child = slot->next_sibling;
+	}
+	if (slot->next_sibling) {
+		handles_ctx->slots[slot->next_sibling].prev_sibling = slot->prev_sibling;
 	}
 
-	return 0;
+	slot->parent = 0;
+	slot->prev_sibling = 0;
+	slot->next_sibling = 0;
 }
 
 
@@ -270,84 +250,49 @@ static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_ctx,
 					  uint32_t container_handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	enum MAPISTATUS		retval;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	uint32_t		handle = 0;
-	struct mapi_handles	*el;
-	int			ret;
+	struct mapi_handles_slot	*slot;
+	struct mapi_handles		*el;
+	uint32_t			idx;
+	uint32_t			parent = 0;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_add");
-
-	/* Step 1. Seek the TDB database for the first free record */
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_null, (void *)&handle);
-	if (ret > -1 && handle > 0) {
-		DEBUG(5, ("We have found free record 0x%x\n", handle));
-		retval = mapi_handles_tdb_update(handles_ctx, handle, container_handle);
-		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-		
-		el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-		if (!el) {
-			mapi_handles_tdb_free(handles_ctx, handle);
-			talloc_free(mem_ctx);
-			return MAPI_E_NOT_ENOUGH_RESOURCES;
-		}
-
-		el->handle = handle;
-		el->parent_handle = container_handle;
-		el->private_data = NULL;
-		*rec = el;
-		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
-		talloc_free(mem_ctx);
-
-		return MAPI_E_SUCCESS;
+	/* Step 1. Resolve the container slot, 0 stands for the root */
+	if (container_handle && container_handle != MAPI_HANDLES_RESERVED) {
+		parent = mapi_handles_slot_lookup(handles_ctx, container_handle);
 	}
 
-	/* Step 2. If no record is available, create a new one */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handles_ctx->last_handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	if (container_handle) {
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
-	} else {
-		dbuf.dptr = (unsigned char *) MAPI_HANDLES_ROOT;
-		dbuf.dsize = strlen(MAPI_HANDLES_ROOT);
-	}
+	/* Step 2. Allocate the record and reserve a slot for it */
+	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
+	OPENCHANGE_RETVAL_IF(!el, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handles_ctx->last_handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		talloc_free(mem_ctx);
+	idx = mapi_handles_slot_alloc(handles_ctx);
+	OPENCHANGE_RETVAL_IF(!idx, MAPI_E_NOT_ENOUGH_RESOURCES, el);
 
-		return MAPI_E_CORRUPT_STORE;
-	}
+	slot = &handles_ctx->slots[idx];
+	slot->rec = el;
 
-	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-	if (!el) {
-		mapi_handles_tdb_free(handles_ctx, handles_ctx->last_handle);
-		talloc_free(mem_ctx);
-		return MAPI_E_NOT_ENOUGH_RESOURCES;
+	/* Step 3. Link the slot to the children of its container */
+	if (parent) {
+		slot->parent = parent;
+		slot->prev_sibling = 0;
+		slot->next_sibling = handles_ctx->slots[parent].first_child;
+		if (slot->next_sibling) {
+			handles_ctx->slots[slot->next_sibling].prev_sibling = idx;
+		}
+		handles_ctx->slots[parent].first_child = idx;
 	}
 
-	el->handle = handles_ctx->last_handle;
+	el->handle = MAPI_HANDLES_VALUE(idx, slot->generation);
 	el->parent_handle = container_handle;
 	el->private_data = NULL;
 	*rec = el;
 	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 
 	DEBUG(5, ("handle 0x%.2x is a father of 0x%.2x\n", container_handle, el->handle));
-	handles_ctx->last_handle += 1;
-	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -396,55 +341,10 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_set_private_data(struct mapi_handles *hand
 }
 
 
-struct mapi_handles_private {
-	struct mapi_handles_context	*handles_ctx;
-	uint32_t			container_handle;
-};
-
-/**
-   \details Traverse TDB database and search for records
-   which dbuf value is set to state.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key (potential child handle)
-   \param dbuf the current TDB value (parent handle)
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
-					TDB_DATA key, TDB_DATA dbuf,
-					void *state)
-{
-	TALLOC_CTX			*mem_ctx;
-	struct mapi_handles_private	*handles_private = (struct mapi_handles_private *) state;
-	uint32_t			handle;
-	char				*container_handle_str = NULL;
-	char				*handle_str = NULL;
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_delete");
-	container_handle_str = talloc_asprintf(mem_ctx, "0x%x", handles_private->container_handle);
-
-	if (dbuf.dptr && strlen(container_handle_str) == dbuf.dsize && strncmp((const char *)dbuf.dptr, container_handle_str, dbuf.dsize) == 0) {
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		DEBUG(5, ("handles being released must NOT have child handles attached to them (%s is a child of %s)\n", handle_str, container_handle_str));
-		handle = strtol((const char *) handle_str, NULL, 16);
-		/* abort(); */
-		/* DEBUG(5, ("deleting child handle: %d, %s\n", handle, handle_str)); */
-		mapi_handles_delete(handles_private->handles_ctx, handle);
-	}
-
-	talloc_free(mem_ctx);
-
-	return 0;
-}
-
-
-
 /**
    \details Remove the MAPI handle referenced by the handle parameter
-   from the double chained list and mark its associated TDB record as
-   null
+   from the double chained list, release its slot and recursively
+   delete its children handles
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle the handle to delete
@@ -454,56 +354,46 @@ static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_delete(struct mapi_handles_context *handles_ctx, 
 					     uint32_t handle)
 {
-	TALLOC_CTX			*mem_ctx;
-	enum MAPISTATUS			retval;
-	TDB_DATA			key;
-	struct mapi_handles		*el;
-	struct mapi_handles_private	handles_private;
-	int				ret;
-	bool				found = false;
+	struct mapi_handles	*el;
+	uint32_t		idx;
+	uint32_t		child;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 
-	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p, tdb_ctx: %p)\n", __FUNCTION__, __LINE__,
-		  handle, handles_ctx, handles_ctx->tdb_ctx));
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_delete");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p)\n", __FUNCTION__, __LINE__,
+		  handle, handles_ctx));
 
 	/* Step 1. Make sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Delete this record from the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			DLIST_REMOVE(handles_ctx->handles, el);
-			talloc_free(el);
-			found = true;
-			break;
+	idx = mapi_handles_slot_lookup(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!idx, MAPI_E_NOT_FOUND, NULL);
+
+	/* Step 2. Delete this record from the double chained list. The
+	 * slot is kept reserved, but no longer resolves, until its
+	 * children are gone: private data destructors may add or delete
+	 * handles and reallocate the slots table */
+	el = handles_ctx->slots[idx].rec;
+	handles_ctx->slots[idx].rec = NULL;
+	DLIST_REMOVE(handles_ctx->handles, el);
+	talloc_free(el);
+
+	/* Step 3. Delete hierarchy of children */
+	while ((child = handles_ctx->slots[idx].first_child) != 0) {
+		if (handles_ctx->slots[child].rec) {
+			DEBUG(5, ("handles being released must NOT have child handles attached to them (0x%x is a child of 0x%x)\n",
+				  handles_ctx->slots[child].rec->handle, handle));
+			mapi_handles_delete(handles_ctx, handles_ctx->slots[child].rec->handle);
+		} else {
+			/* child is itself being deleted further up the stack */
+			mapi_handles_slot_unlink(handles_ctx, child);
 		}
 	}
-	/* This case should never occur */
-	OPENCHANGE_RETVAL_IF(found == false, MAPI_E_CORRUPT_STORE, mem_ctx);
-
-	/* Step 3. Free this record within the TDB database */
-	retval = mapi_handles_tdb_free(handles_ctx, handle);
-	/* if (retval) { */
-	/* 	abort(); */
-	/* } */
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-
-	/* Step 4. Delete hierarchy of children */
-	handles_private.handles_ctx = handles_ctx;
-	handles_private.container_handle = handle;
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_delete, (void *)&handles_private);
-
-	talloc_free(mem_ctx);
+
+	/* Step 4. Release the slot */
+	mapi_handles_slot_unlink(handles_ctx, idx);
+	mapi_handles_slot_free(handles_ctx, idx);
 
 	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x COMPLETE\n", __FUNCTION__, __LINE__, handle));
 
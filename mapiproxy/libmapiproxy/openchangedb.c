@@ -37,6 +37,7 @@
 #include "mapiproxy/libmapiproxy/backends/openchangedb_mysql.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_ldb.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_logger.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_cache.h"
 
 const char *nil_string = "<nil>";
 
@@ -67,6 +68,15 @@ _PUBLIC_ enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *mem_ctx,
 						       "openchangedb_logger_prefix");
 		DEBUG(0, ("Loading OpenchangeDB logger module\n"));
 		retval = openchangedb_logger_initialize(mem_ctx, 0, prefix, *oc_ctx, oc_ctx);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
+	}
+
+	/* Cache on top of the logger so it only logs actual backend queries */
+	if (lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "openchangedb_cache", false)) {
+		DEBUG(0, ("Loading OpenchangeDB cache module\n"));
+		retval = openchangedb_cache_initialize(mem_ctx, *oc_ctx, oc_ctx);
 	}
 
 	return retval;
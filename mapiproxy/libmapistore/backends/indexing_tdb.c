@@ -34,6 +34,146 @@
 
 #define	TDB_WRAP(context)	((struct tdb_wrap*)context->data)
 
+/* Length of a "0x%.16"PRIx64 formatted fmid */
+#define	TDB_FMID_STR_LEN	18
+
+
+/**
+   \details Return a copy of the first len bytes of uri, without its
+   trailing '/'. This is the form under which URIs are compared and
+   stored in the reverse index.
+ */
+static char *tdb_uri_normalize(TALLOC_CTX *mem_ctx, const char *uri, size_t len)
+{
+	char	*norm;
+
+	norm = talloc_strndup(mem_ctx, uri, len);
+	if (!norm) return NULL;
+
+	len = strlen(norm);
+	if (len && norm[len - 1] == '/') {
+		norm[len - 1] = 0;
+	}
+
+	return norm;
+}
+
+static const char *tdb_uri_last_segment(const char *uri)
+{
+	const char	*slash;
+
+	slash = strrchr(uri, '/');
+	return slash ? slash + 1 : uri;
+}
+
+static TDB_DATA tdb_uri_index_key(TALLOC_CTX *mem_ctx, const char *tag, const char *str)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", tag, str);
+	key.dsize = strlen((const char *) key.dptr);
+
+	return key;
+}
+
+/**
+   \details Add the reverse index entries of a record
+
+   Two kinds of keys are maintained: URI:<uri> which maps a normalized
+   URI to its fmid, and URI_SUFFIX:<last path segment> which holds the
+   concatenated fmids of every URI ending with this segment. The
+   latter lets wildcard lookups inspect a single bucket instead of the
+   whole database.
+ */
+static void tdb_uri_index_add(struct indexing_context *ictx, uint64_t fmid,
+			      const char *uri, size_t len)
+{
+	TALLOC_CTX	*mem_ctx;
+	char		*norm;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+
+	mem_ctx = talloc_new(NULL);
+	norm = tdb_uri_normalize(mem_ctx, uri, len);
+
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%.16"PRIx64, fmid);
+	dbuf.dsize = TDB_FMID_STR_LEN;
+
+	key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_INDEX_TAG, norm);
+	if (tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_REPLACE) == -1) {
+		DEBUG(3, ("[%s:%d]: Unable to index URI %s\n", __FUNCTION__, __LINE__, norm));
+	}
+
+	key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_SUFFIX_TAG, tdb_uri_last_segment(norm));
+	if (tdb_append(TDB_WRAP(ictx)->tdb, key, dbuf) == -1) {
+		DEBUG(3, ("[%s:%d]: Unable to index URI suffix %s\n", __FUNCTION__, __LINE__, norm));
+	}
+
+	talloc_free(mem_ctx);
+}
+
+/**
+   \details Remove the reverse index entries of a record
+ */
+static void tdb_uri_index_del(struct indexing_context *ictx, uint64_t fmid,
+			      const char *uri, size_t len)
+{
+	TALLOC_CTX	*mem_ctx;
+	char		*norm;
+	char		*fmid_str;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	size_t		offset;
+
+	mem_ctx = talloc_new(NULL);
+	norm = tdb_uri_normalize(mem_ctx, uri, len);
+	fmid_str = talloc_asprintf(mem_ctx, "0x%.16"PRIx64, fmid);
+
+	/* Only drop the URI key if it still points to this record */
+	key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_INDEX_TAG, norm);
+	dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+	if (dbuf.dptr) {
+		if (dbuf.dsize == TDB_FMID_STR_LEN && !memcmp(dbuf.dptr, fmid_str, TDB_FMID_STR_LEN)) {
+			tdb_delete(TDB_WRAP(ictx)->tdb, key);
+		}
+		free(dbuf.dptr);
+	}
+
+	key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_SUFFIX_TAG, tdb_uri_last_segment(norm));
+	dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+	if (dbuf.dptr) {
+		for (offset = 0; offset + TDB_FMID_STR_LEN <= dbuf.dsize; offset += TDB_FMID_STR_LEN) {
+			if (memcmp(dbuf.dptr + offset, fmid_str, TDB_FMID_STR_LEN)) continue;
+
+			memmove(dbuf.dptr + offset, dbuf.dptr + offset + TDB_FMID_STR_LEN,
+				dbuf.dsize - offset - TDB_FMID_STR_LEN);
+			dbuf.dsize -= TDB_FMID_STR_LEN;
+			if (dbuf.dsize) {
+				tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_REPLACE);
+			} else {
+				tdb_delete(TDB_WRAP(ictx)->tdb, key);
+			}
+			break;
+		}
+		free(dbuf.dptr);
+	}
+
+	talloc_free(mem_ctx);
+}
+
+static uint64_t tdb_fmid_from_data(const unsigned char *dptr, size_t dsize)
+{
+	char	buf[TDB_FMID_STR_LEN + 1];
+
+	if (dsize > TDB_FMID_STR_LEN) {
+		dsize = TDB_FMID_STR_LEN;
+	}
+	memcpy(buf, dptr, dsize);
+	buf[dsize] = 0;
+
+	return strtoull(buf, NULL, 16);
+}
+
 
 
 static enum mapistore_error tdb_search_existing_fmid(struct indexing_context *ictx,
@@ -110,6 +250,8 @@ static enum mapistore_error tdb_record_add(struct indexing_context *ictx,
 		return MAPISTORE_ERR_DATABASE_OPS;
 	}
 
+	tdb_uri_index_add(ictx, fmid, mapistore_URI, strlen(mapistore_URI));
+
 	return MAPISTORE_SUCCESS;
 }
 
@@ -121,6 +263,7 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	int		ret;
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
+	TDB_DATA	old_dbuf;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -135,6 +278,9 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	dbuf.dptr = (unsigned char *) talloc_strdup(ictx, mapistore_URI);
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
+	/* Retrieve the previous URI so its index entries can be dropped */
+	old_dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+
 	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_MODIFY);
 	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
@@ -142,9 +288,16 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	if (ret == -1) {
 		DEBUG(3, ("[%s:%d]: Unable to update 0x%.16"PRIx64" record: %s\n", __FUNCTION__, __LINE__,
 			  fmid, mapistore_URI));
+		free(old_dbuf.dptr);
 		return MAPISTORE_ERR_NOT_FOUND;
 	}
 
+	if (old_dbuf.dptr) {
+		tdb_uri_index_del(ictx, fmid, (const char *) old_dbuf.dptr, old_dbuf.dsize);
+		free(old_dbuf.dptr);
+	}
+	tdb_uri_index_add(ictx, fmid, mapistore_URI, strlen(mapistore_URI));
+
 	return MAPISTORE_SUCCESS;
 }
 
@@ -195,9 +348,18 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 		talloc_free(newkey.dptr);
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
+		/* Soft deleted records stay indexed, permanently deleted ones do not */
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
 		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
 		talloc_free(key.dptr);
-		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+		if (ret) {
+			free(dbuf.dptr);
+			return MAPISTORE_ERR_DATABASE_OPS;
+		}
+		if (dbuf.dptr) {
+			tdb_uri_index_del(ictx, fmid, (const char *) dbuf.dptr, dbuf.dsize);
+			free(dbuf.dptr);
+		}
 		break;
 	default:
 		return MAPISTORE_ERR_INVALID_PARAMETER;
@@ -256,94 +418,125 @@ static enum mapistore_error tdb_record_get_uri(struct indexing_context *ictx,
 }
 
 /**
-   \details A slow but effective way to retrieve an fmid from a uri
+   \details Check whether a normalized URI matches a single wildcard
+   pattern split into its start and end parts
+ */
+static bool tdb_uri_match(const char *uri, const char *startswith, const char *endswith)
+{
+	size_t	uri_len = strlen(uri);
+	size_t	start_len = strlen(startswith);
+	size_t	end_len = strlen(endswith);
 
-   \param mstore_ctx pointer to the mapistore context
-   \param mem_ctx pointer to the talloc context
-   \param fmid the fmid/key to the record
-   \param urip pointer to the uri pointer
-   \param soft_deletedp pointer to the soft deleted pointer
+	if (uri_len < start_len + end_len) return false;
 
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
- */
-struct tdb_get_fid_data {
-	bool		found;
-	uint64_t	fmid;
-	char		*uri;
-	size_t		uri_len;
-	uint32_t	wildcard_count;
-	char		*startswith;
-	char		*endswith;
-};
+	return (!strncmp(uri, startswith, start_len) &&
+		!strcmp(uri + uri_len - end_len, endswith));
+}
 
-static int tdb_get_fid_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+/**
+   \details Resolve a candidate fmid coming from the reverse index
+
+   The primary record remains authoritative: the candidate is only
+   accepted if the URI it currently points to matches the request.
+ */
+static bool tdb_uri_index_check(struct indexing_context *ictx, const char *username,
+				uint64_t fmid, const char *uri,
+				const char *startswith, const char *endswith,
+				bool *soft_deletedp)
 {
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
 	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-	if (strcmp(cmp_uri, tdb_data->uri) == 0) {
-		key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		tdb_data->fmid = strtoull(key_str, NULL, 16);
-		tdb_data->found = true;
-		ret = 1;
+	enum mapistore_error	ret;
+	char			*stored_uri;
+	char			*norm;
+	bool			match = false;
+
+	mem_ctx = talloc_new(NULL);
+	ret = tdb_record_get_uri(ictx, username, mem_ctx, fmid, &stored_uri, soft_deletedp);
+	if (ret == MAPISTORE_SUCCESS) {
+		norm = tdb_uri_normalize(mem_ctx, stored_uri, strlen(stored_uri));
+		if (uri) {
+			match = (strcmp(norm, uri) == 0);
+		} else {
+			match = tdb_uri_match(norm, startswith, endswith);
+		}
 	}
-	
 	talloc_free(mem_ctx);
 
-	return ret;
+	return match;
 }
 
+struct tdb_get_fid_data {
+	bool		found;
+	uint64_t	fmid;
+	const char	*startswith;
+	const char	*endswith;
+};
+
 static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
 {
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
+	struct tdb_get_fid_data	*tdb_data = data;
+	size_t			tag_len = strlen(MAPISTORE_URI_INDEX_TAG);
+	size_t			uri_len;
+	size_t			start_len;
+	size_t			end_len;
+	const char		*uri;
+
+	/* Only walk the URI index, it already holds normalized URIs */
+	if (key.dsize < tag_len || memcmp(key.dptr, MAPISTORE_URI_INDEX_TAG, tag_len)) {
+		return 0;
 	}
 
-	if (!strncmp(cmp_uri, tdb_data->startswith, strlen(tdb_data->startswith)) &&
-	    !strncmp(cmp_uri + (strlen(cmp_uri) - strlen(tdb_data->endswith)), tdb_data->endswith, 
-		     strlen(tdb_data->endswith))) {
-		    key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		    tdb_data->fmid = strtoull(key_str, NULL, 16);
-		    tdb_data->found = true;
-		    ret = 1;
+	uri = (const char *) key.dptr + tag_len;
+	uri_len = key.dsize - tag_len;
+	start_len = strlen(tdb_data->startswith);
+	end_len = strlen(tdb_data->endswith);
+
+	if (uri_len < start_len + end_len ||
+	    memcmp(uri, tdb_data->startswith, start_len) ||
+	    memcmp(uri + uri_len - end_len, tdb_data->endswith, end_len)) {
+		return 0;
 	}
-	
-	talloc_free(mem_ctx);
 
-	return ret;
+	tdb_data->fmid = tdb_fmid_from_data(value.dptr, value.dsize);
+	tdb_data->found = true;
+
+	return 1;
 }
 
+/**
+   \details Retrieve the fmid of a given URI
+
+   Exact lookups are served by the URI:<uri> index key. Lookups with a
+   single wildcard use the URI_SUFFIX:<segment> bucket when the part
+   following the wildcard includes the last path segment, and otherwise
+   fall back on a scan of the URI index keys.
+
+   \param ictx pointer to the indexing context
+   \param username the user owning the indexing database
+   \param uri the URI to look up
+   \param partial whether uri may contain a '*' wildcard
+   \param fmidp pointer to the returned fmid
+   \param soft_deletedp pointer to the returned soft deleted status
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
 static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 					        const char *username,
 					        const char *uri, bool partial,
 					        uint64_t *fmidp, bool *soft_deletedp)
 {
-	int				ret;
+	TALLOC_CTX			*mem_ctx;
 	struct tdb_get_fid_data		tdb_data;
-	char				*slash_ptr;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	char				*norm;
+	char				*startswith;
+	const char			*endswith;
+	uint32_t			wildcard_count = 0;
 	uint32_t			i;
+	size_t				offset;
+	uint64_t			fmid;
+	bool				soft_deleted = false;
 
 	/* SANITY checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -352,60 +545,70 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Check if the fmid exists within the database */
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_get_fmid");
+	norm = tdb_uri_normalize(mem_ctx, uri, strlen(uri));
 	tdb_data.found = false;
-	tdb_data.uri = talloc_strdup(NULL, uri);
-	tdb_data.uri_len = strlen(uri);
-
-	tdb_data.startswith = NULL;
-	tdb_data.endswith = NULL;
-	tdb_data.wildcard_count = 0;
 
-	slash_ptr = tdb_data.uri + tdb_data.uri_len - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-		tdb_data.uri_len--;
-	}
-	if (partial == false) {
-		tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
-	} else {
-		for (tdb_data.wildcard_count = 0, i = 0; i < strlen(uri); i++) {
-			if (uri[i] == '*') tdb_data.wildcard_count += 1;
+	if (partial == true) {
+		for (i = 0; norm[i]; i++) {
+			if (norm[i] == '*') wildcard_count += 1;
 		}
+	}
 
-		switch (tdb_data.wildcard_count) {
-		case 0: /* complete URI */
-			partial = true;
-			break;
-		case 1: /* start and end only */
-			tdb_data.endswith = strchr(uri, '*') + 1;
-			tdb_data.startswith = talloc_strndup(NULL, uri, strlen(uri) - strlen(tdb_data.endswith) - 1);
-			break;
-		default:
-			DEBUG(0, ("[%s:%d]: Too many wildcards found (1 maximum)\n", __FUNCTION__, __LINE__));
-			talloc_free(tdb_data.uri);
-			return MAPISTORE_ERR_NOT_FOUND;
+	switch (wildcard_count) {
+	case 0: /* complete URI */
+		key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_INDEX_TAG, norm);
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		if (dbuf.dptr) {
+			fmid = tdb_fmid_from_data(dbuf.dptr, dbuf.dsize);
+			free(dbuf.dptr);
+			if (tdb_uri_index_check(ictx, username, fmid, norm, NULL, NULL, &soft_deleted)) {
+				tdb_data.fmid = fmid;
+				tdb_data.found = true;
+			}
 		}
-
-		if (partial == true) {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
-			talloc_free(tdb_data.startswith);
+		break;
+	case 1: /* start and end only */
+		endswith = strchr(norm, '*') + 1;
+		startswith = talloc_strndup(mem_ctx, norm, endswith - norm - 1);
+
+		if (strchr(endswith, '/')) {
+			key = tdb_uri_index_key(mem_ctx, MAPISTORE_URI_SUFFIX_TAG,
+						tdb_uri_last_segment(endswith));
+			dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+			for (offset = 0; dbuf.dptr && offset + TDB_FMID_STR_LEN <= dbuf.dsize;
+			     offset += TDB_FMID_STR_LEN) {
+				fmid = tdb_fmid_from_data(dbuf.dptr + offset, TDB_FMID_STR_LEN);
+				if (tdb_uri_index_check(ictx, username, fmid, NULL, startswith, endswith, &soft_deleted)) {
+					tdb_data.fmid = fmid;
+					tdb_data.found = true;
+					break;
+				}
+			}
+			free(dbuf.dptr);
 		} else {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
+			tdb_data.startswith = startswith;
+			tdb_data.endswith = endswith;
+			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
+			if (tdb_data.found) {
+				tdb_data.found = tdb_uri_index_check(ictx, username, tdb_data.fmid, NULL,
+								     startswith, endswith, &soft_deleted);
+			}
 		}
+		break;
+	default:
+		DEBUG(0, ("[%s:%d]: Too many wildcards found (1 maximum)\n", __FUNCTION__, __LINE__));
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_NOT_FOUND;
 	}
 
-	talloc_free(tdb_data.uri);
-	if (tdb_data.found) {
-		*fmidp = tdb_data.fmid;
-		*soft_deletedp = false; /* TODO: implement the feature */
-		ret = MAPISTORE_SUCCESS;
-	}
-	else {
-		ret = MAPISTORE_ERR_NOT_FOUND;
-	}
+	talloc_free(mem_ctx);
+	MAPISTORE_RETVAL_IF(!tdb_data.found, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	*fmidp = tdb_data.fmid;
+	*soft_deletedp = soft_deleted;
 
-	return ret;
+	return MAPISTORE_SUCCESS;
 }
 
 
@@ -462,6 +665,83 @@ static enum mapistore_error tdb_record_allocate_fmid(struct indexing_context *ic
 }
 
 
+static int tdb_uri_index_upgrade_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct indexing_context	*ictx = data;
+	size_t			tag_len = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	const unsigned char	*fmid_str = key.dptr;
+	size_t			fmid_len = key.dsize;
+
+	if (fmid_len > tag_len && !memcmp(fmid_str, MAPISTORE_SOFT_DELETED_TAG, tag_len)) {
+		fmid_str += tag_len;
+		fmid_len -= tag_len;
+	}
+
+	/* Skip GlobalCount and the index keys themselves */
+	if (fmid_len != TDB_FMID_STR_LEN || memcmp(fmid_str, "0x", 2)) {
+		return 0;
+	}
+
+	tdb_uri_index_add(ictx, tdb_fmid_from_data(fmid_str, fmid_len),
+			  (const char *) value.dptr, value.dsize);
+
+	return 0;
+}
+
+/**
+   \details Build the reverse URI index of an indexing database
+   created before it existed
+
+   \param ictx pointer to the indexing context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_uri_index_upgrade(struct indexing_context *ictx)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		version[16];
+	int		ret;
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEX_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEX_VERSION_KEY);
+
+	dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+	if (dbuf.dptr) {
+		snprintf(version, sizeof (version), "%.*s", (int) dbuf.dsize, (const char *) dbuf.dptr);
+		free(dbuf.dptr);
+		if (strtoul(version, NULL, 10) >= MAPISTORE_INDEX_VERSION) {
+			return MAPISTORE_SUCCESS;
+		}
+	}
+
+	DEBUG(3, ("[%s:%d]: Building URI index for %s\n", __FUNCTION__, __LINE__, TDB_WRAP(ictx)->name));
+
+	ret = tdb_transaction_start(TDB_WRAP(ictx)->tdb);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	ret = tdb_traverse(TDB_WRAP(ictx)->tdb, tdb_uri_index_upgrade_traverse, ictx);
+	if (ret == -1) {
+		tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	snprintf(version, sizeof (version), "%d", MAPISTORE_INDEX_VERSION);
+	dbuf.dptr = (unsigned char *) version;
+	dbuf.dsize = strlen(version);
+	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_REPLACE);
+	if (ret == -1) {
+		tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	ret = tdb_transaction_commit(TDB_WRAP(ictx)->tdb);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
 /**
    \details Open connection to indexing database for a given user
 
@@ -506,6 +786,14 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 
+	/* Step 2. Build the reverse URI index if needed */
+	if (tdb_uri_index_upgrade(ictx) != MAPISTORE_SUCCESS) {
+		DEBUG(3, ("[%s:%d]: Unable to build the URI index\n", __FUNCTION__, __LINE__));
+		talloc_free(ictx);
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_DATABASE_INIT;
+	}
+
 	/* TODO: extract url from backend mapping, by the moment we use the username */
 	ictx->url = talloc_strdup(ictx, username);
 
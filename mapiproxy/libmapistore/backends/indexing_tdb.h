@@ -27,6 +27,12 @@
 #define	MAPISTORE_DB_INDEXING		"indexing.tdb"
 #define	MAPISTORE_SOFT_DELETED_TAG	"SOFT_DELETED:"
 
+/* Reverse URI -> fmid index */
+#define	MAPISTORE_URI_INDEX_TAG		"URI:"
+#define	MAPISTORE_URI_SUFFIX_TAG	"URI_SUFFIX:"
+#define	MAPISTORE_INDEX_VERSION_KEY	"IndexVersion"
+#define	MAPISTORE_INDEX_VERSION		1
+
 
 enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_context *,
 						 const char *,
@@ -30,6 +30,9 @@
 #include <param.h>
 
 struct MAPINAMEID;
+struct namedprops_cache_entry;
+
+typedef enum mapistore_error (*namedprops_traverse_fn)(void *, const struct MAPINAMEID *, uint16_t, uint16_t);
 
 struct namedprops_context {
 	enum mapistore_error (*get_mapped_id)(struct namedprops_context *, struct MAPINAMEID, uint16_t *);
@@ -39,9 +42,20 @@ struct namedprops_context {
 	enum mapistore_error (*get_nameid_type)(struct namedprops_context *, uint16_t, uint16_t *);
 	enum mapistore_error (*transaction_start)(struct namedprops_context *);
 	enum mapistore_error (*transaction_commit)(struct namedprops_context *);
+	enum mapistore_error (*traverse)(struct namedprops_context *, namedprops_traverse_fn, void *);
+	/* bulk lookups, optional: fn is called for each mapping found,
+	   in creation order when the backend knows it */
+	enum mapistore_error (*get_mapped_ids)(struct namedprops_context *, uint16_t, const struct MAPINAMEID *, namedprops_traverse_fn, void *);
+	enum mapistore_error (*get_nameids)(struct namedprops_context *, uint16_t, const uint16_t *, namedprops_traverse_fn, void *);
 
 	const char *backend_type;
+	const char *backend_url;
 	void *data;
+
+	/* mappings created in the running transaction, published to
+	   the process cache on commit */
+	bool in_transaction;
+	struct namedprops_cache_entry *pending;
 };
 
 
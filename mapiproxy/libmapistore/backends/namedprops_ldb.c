@@ -352,6 +352,207 @@ static enum mapistore_error get_nameid_type(struct namedprops_context *self,
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Search the named properties database and call a function
+   for each mapping returned
+
+   \param self pointer to the namedprops context
+   \param filter the LDB search filter
+   \param fn function called for each mapping
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error search_mappings(struct namedprops_context *self,
+					    const char *filter,
+					    namedprops_traverse_fn fn,
+					    void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval;
+	struct ldb_context	*ldb_ctx;
+	struct ldb_result	*res = NULL;
+	const char * const	attrs[] = { "objectClass", "cn", "oleguid", "mappedId", "propType", NULL };
+	struct MAPINAMEID	nameid;
+	const char		*guid, *oClass, *cn, *val;
+	uint16_t		mapped_id;
+	int			prop_type;
+	int			ret;
+	int			i;
+
+	ldb_ctx = (struct ldb_context *) self->data;
+	MAPISTORE_RETVAL_IF(!ldb_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "namedprops_ldb_search_mappings");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	ret = ldb_search(ldb_ctx, mem_ctx, &res, ldb_get_default_basedn(ldb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "%s", filter);
+	MAPISTORE_RETVAL_IF(ret != LDB_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	for (i = 0; i < res->count; i++) {
+		guid = ldb_msg_find_attr_as_string(res->msgs[i], "oleguid", NULL);
+		cn = ldb_msg_find_attr_as_string(res->msgs[i], "cn", NULL);
+		oClass = ldb_msg_find_attr_as_string(res->msgs[i], "objectClass", NULL);
+		mapped_id = ldb_msg_find_attr_as_uint(res->msgs[i], "mappedId", 0);
+		if (!guid || !cn || !oClass || !mapped_id) continue;
+
+		memset(&nameid, 0, sizeof (struct MAPINAMEID));
+		GUID_from_string(guid, &nameid.lpguid);
+		if (strcmp(oClass, "MNID_ID") == 0) {
+			nameid.ulKind = MNID_ID;
+			nameid.kind.lid = strtol(cn, NULL, 16);
+		} else if (strcmp(oClass, "MNID_STRING") == 0) {
+			nameid.ulKind = MNID_STRING;
+			nameid.kind.lpwstr.NameSize = strlen(cn) * 2 + 2;
+			nameid.kind.lpwstr.Name = cn;
+		} else {
+			continue;
+		}
+
+		/* Same rules as get_nameid_type, 0 when unknown */
+		prop_type = ldb_msg_find_attr_as_int(res->msgs[i], "propType", 0);
+		if (!prop_type) {
+			val = ldb_msg_find_attr_as_string(res->msgs[i], "propType", "");
+			prop_type = mapistore_namedprops_prop_type_from_string(val);
+			if (prop_type == -1) prop_type = 0;
+		}
+
+		retval = fn(private_data, &nameid, mapped_id, prop_type);
+		MAPISTORE_RETVAL_IF(retval != MAPISTORE_SUCCESS, retval, mem_ctx);
+	}
+
+	talloc_free(mem_ctx);
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Walk all the named properties mappings stored in the
+   database with a single search
+
+   \param self pointer to the namedprops context
+   \param fn function called for each mapping
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error traverse(struct namedprops_context *self,
+				     namedprops_traverse_fn fn,
+				     void *private_data)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	return search_mappings(self, "(|(objectClass=MNID_ID)(objectClass=MNID_STRING))", fn, private_data);
+}
+
+/**
+   \details Look up the mappings of several names with a single search
+
+   \param self pointer to the namedprops context
+   \param count number of elements in nameids
+   \param nameids array of MAPINAMEID structures to lookup
+   \param fn function called for each mapping found
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_mapped_ids(struct namedprops_context *self,
+					   uint16_t count,
+					   const struct MAPINAMEID *nameids,
+					   namedprops_traverse_fn fn,
+					   void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval;
+	char			*filter;
+	char			*guid;
+	uint16_t		terms = 0;
+	uint16_t		i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !nameids, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "namedprops_ldb_get_mapped_ids");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	filter = talloc_strdup(mem_ctx, "(|");
+	for (i = 0; i < count; i++) {
+		guid = GUID_string(mem_ctx, &nameids[i].lpguid);
+		if (nameids[i].ulKind == MNID_ID) {
+			filter = talloc_asprintf_append(filter, "(&(objectClass=MNID_ID)(oleguid=%s)(cn=0x%.4x))",
+							guid, nameids[i].kind.lid);
+			terms++;
+		} else if (nameids[i].ulKind == MNID_STRING && nameids[i].kind.lpwstr.Name) {
+			filter = talloc_asprintf_append(filter, "(&(objectClass=MNID_STRING)(oleguid=%s)(cn=%s))",
+							guid, ldb_binary_encode_string(mem_ctx, nameids[i].kind.lpwstr.Name));
+			terms++;
+		}
+		MAPISTORE_RETVAL_IF(!filter, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	}
+	if (!terms) {
+		talloc_free(mem_ctx);
+		return MAPISTORE_SUCCESS;
+	}
+	filter = talloc_strdup_append(filter, ")");
+	MAPISTORE_RETVAL_IF(!filter, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+	retval = search_mappings(self, filter, fn, private_data);
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+/**
+   \details Look up the names of several mapped property IDs with a
+   single search
+
+   \param self pointer to the namedprops context
+   \param count number of elements in propIDs
+   \param propIDs array of mapped property IDs to lookup
+   \param fn function called for each mapping found
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_nameids(struct namedprops_context *self,
+					uint16_t count,
+					const uint16_t *propIDs,
+					namedprops_traverse_fn fn,
+					void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval;
+	char			*filter;
+	uint16_t		i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !propIDs, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (!count) return MAPISTORE_SUCCESS;
+
+	mem_ctx = talloc_named(NULL, 0, "namedprops_ldb_get_nameids");
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	filter = talloc_strdup(mem_ctx, "(|");
+	for (i = 0; i < count; i++) {
+		filter = talloc_asprintf_append(filter, "(mappedId=%u)", propIDs[i]);
+		MAPISTORE_RETVAL_IF(!filter, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+	}
+	filter = talloc_strdup_append(filter, ")");
+	MAPISTORE_RETVAL_IF(!filter, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+	retval = search_mappings(self, filter, fn, private_data);
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
 static enum mapistore_error transaction_start(struct namedprops_context *self)
 {
 	struct ldb_context *ldb_ctx = self->data;
@@ -462,11 +663,15 @@ enum mapistore_error mapistore_namedprops_ldb_init(TALLOC_CTX *mem_ctx,
 	nprops->backend_type = NAMEDPROPS_BACKEND_LDB;
 	nprops->create_id = create_id;
 	nprops->get_mapped_id = get_mapped_id;
+	nprops->get_mapped_ids = get_mapped_ids;
 	nprops->get_nameid = get_nameid;
+	nprops->get_nameids = get_nameids;
 	nprops->get_nameid_type = get_nameid_type;
 	nprops->next_unused_id = next_unused_id;
 	nprops->transaction_commit = transaction_commit;
 	nprops->transaction_start = transaction_start;
+	nprops->traverse = traverse;
+	nprops->backend_url = talloc_strdup(nprops, database);
 	nprops->data = ldb_ctx;
 
 	*nprops_ctx = nprops;
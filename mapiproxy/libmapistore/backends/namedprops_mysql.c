@@ -181,9 +181,10 @@ static enum mapistore_error get_nameid(struct namedprops_context *self,
 {
 	TALLOC_CTX *local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 	MYSQL *conn = self->data;
+	/* mappedId is not unique, the first mapping created wins */
 	const char *sql = talloc_asprintf(local_mem_ctx,
 		"SELECT type, oleguid, propName, propId FROM "NAMEDPROPS_MYSQL_TABLE" "
-		"WHERE mappedId=%d", mapped_id);
+		"WHERE mappedId=%d ORDER BY id LIMIT 1", mapped_id);
 	if (mysql_query(conn, sql) != 0) {
 		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS,
 				    local_mem_ctx);
@@ -228,10 +229,10 @@ static enum mapistore_error get_nameid_type(struct namedprops_context *self,
 {
 	TALLOC_CTX *mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 	MYSQL *conn = self->data;
+	/* mappedId is not unique, the first mapping created wins */
 	const char *sql = talloc_asprintf(mem_ctx,
-		//FIXME mappedId or propId? mappedId is not unique
-		"SELECT propType FROM "NAMEDPROPS_MYSQL_TABLE" WHERE mappedId=%d",
-		mapped_id);
+		"SELECT propType FROM "NAMEDPROPS_MYSQL_TABLE" WHERE mappedId=%d "
+		"ORDER BY id LIMIT 1", mapped_id);
 	if (mysql_query(conn, sql) != 0) {
 		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
 	}
@@ -248,6 +249,212 @@ static enum mapistore_error get_nameid_type(struct namedprops_context *self,
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Run a query on the named properties table and call a
+   function for each mapping returned, in creation order
+
+   \param self pointer to the namedprops context
+   \param where the WHERE clause of the query, or NULL for all the
+   mappings
+   \param fn function called for each mapping
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error query_mappings(struct namedprops_context *self,
+					   const char *where,
+					   namedprops_traverse_fn fn,
+					   void *private_data)
+{
+	enum mapistore_error	retval = MAPISTORE_SUCCESS;
+	MYSQL			*conn;
+	MYSQL_RES		*res;
+	MYSQL_ROW		row;
+	struct MAPINAMEID	nameid;
+	uint16_t		mapped_id;
+	char			*sql;
+	int			ret;
+
+	conn = (MYSQL *) self->data;
+	MAPISTORE_RETVAL_IF(!conn, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	sql = talloc_asprintf(NULL, "SELECT type, oleguid, propId, propName, mappedId, propType "
+			      "FROM "NAMEDPROPS_MYSQL_TABLE"%s%s ORDER BY id",
+			      where ? " WHERE " : "", where ? where : "");
+	MAPISTORE_RETVAL_IF(!sql, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	ret = mysql_query(conn, sql);
+	talloc_free(sql);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	res = mysql_use_result(conn);
+	MAPISTORE_RETVAL_IF(!res, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	while ((row = mysql_fetch_row(res)) != NULL) {
+		if (!row[0] || !row[1] || !row[4]) continue;
+
+		mapped_id = strtol(row[4], NULL, 10);
+		if (!mapped_id) continue;
+
+		memset(&nameid, 0, sizeof (struct MAPINAMEID));
+		GUID_from_string(row[1], &nameid.lpguid);
+		nameid.ulKind = strtol(row[0], NULL, 10);
+		if (nameid.ulKind == MNID_ID && row[2]) {
+			nameid.kind.lid = strtol(row[2], NULL, 10);
+		} else if (nameid.ulKind == MNID_STRING && row[3]) {
+			nameid.kind.lpwstr.NameSize = strlen(row[3]) * 2 + 2;
+			nameid.kind.lpwstr.Name = row[3];
+		} else {
+			continue;
+		}
+
+		retval = fn(private_data, &nameid, mapped_id, row[5] ? strtol(row[5], NULL, 10) : 0);
+		if (retval != MAPISTORE_SUCCESS) break;
+	}
+
+	/* also discards the rows left if the callback bailed out */
+	mysql_free_result(res);
+
+	return retval;
+}
+
+/**
+   \details Walk all the named properties mappings stored in the
+   database with a single query
+
+   \param self pointer to the namedprops context
+   \param fn function called for each mapping
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error traverse(struct namedprops_context *self,
+				     namedprops_traverse_fn fn,
+				     void *private_data)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	return query_mappings(self, NULL, fn, private_data);
+}
+
+/**
+   \details Look up the mappings of several names, with one query per
+   NAMEDPROPS_MYSQL_BULK_SIZE names
+
+   \param self pointer to the namedprops context
+   \param count number of elements in nameids
+   \param nameids array of MAPINAMEID structures to lookup
+   \param fn function called for each mapping found
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_mapped_ids(struct namedprops_context *self,
+					   uint16_t count,
+					   const struct MAPINAMEID *nameids,
+					   namedprops_traverse_fn fn,
+					   void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval = MAPISTORE_SUCCESS;
+	char			*ids;
+	char			*names;
+	char			*guid;
+	char			*where;
+	uint16_t		i, j;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !nameids, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	for (i = 0; i < count && retval == MAPISTORE_SUCCESS; i = j) {
+		mem_ctx = talloc_named(NULL, 0, "namedprops_mysql_get_mapped_ids");
+		MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+		ids = talloc_strdup(mem_ctx, "");
+		names = talloc_strdup(mem_ctx, "");
+		for (j = i; j < count && j - i < NAMEDPROPS_MYSQL_BULK_SIZE; j++) {
+			guid = GUID_string(mem_ctx, &nameids[j].lpguid);
+			if (nameids[j].ulKind == MNID_ID) {
+				ids = talloc_asprintf_append(ids, "%s(%d,'%s',%u)", ids[0] ? "," : "",
+							     MNID_ID, guid, nameids[j].kind.lid);
+			} else if (nameids[j].ulKind == MNID_STRING && nameids[j].kind.lpwstr.Name) {
+				names = talloc_asprintf_append(names, "%s(%d,'%s','%s')", names[0] ? "," : "",
+							       MNID_STRING, guid,
+							       _sql(mem_ctx, nameids[j].kind.lpwstr.Name));
+			}
+			MAPISTORE_RETVAL_IF(!ids || !names, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+		}
+
+		where = NULL;
+		if (ids[0]) {
+			where = talloc_asprintf(mem_ctx, "(type, oleguid, propId) IN (%s)", ids);
+			MAPISTORE_RETVAL_IF(!where, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+		}
+		if (names[0]) {
+			where = talloc_asprintf(mem_ctx, "%s%s(type, oleguid, propName) IN (%s)",
+						where ? where : "", where ? " OR " : "", names);
+			MAPISTORE_RETVAL_IF(!where, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+		}
+		if (where) {
+			retval = query_mappings(self, where, fn, private_data);
+		}
+		talloc_free(mem_ctx);
+	}
+
+	return retval;
+}
+
+/**
+   \details Look up the names of several mapped property IDs, with one
+   query per NAMEDPROPS_MYSQL_BULK_SIZE IDs
+
+   \param self pointer to the namedprops context
+   \param count number of elements in propIDs
+   \param propIDs array of mapped property IDs to lookup
+   \param fn function called for each mapping found
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error get_nameids(struct namedprops_context *self,
+					uint16_t count,
+					const uint16_t *propIDs,
+					namedprops_traverse_fn fn,
+					void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval = MAPISTORE_SUCCESS;
+	char			*where;
+	uint16_t		i, j;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!self, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !propIDs, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fn, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	for (i = 0; i < count && retval == MAPISTORE_SUCCESS; i = j) {
+		mem_ctx = talloc_named(NULL, 0, "namedprops_mysql_get_nameids");
+		MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+		where = talloc_strdup(mem_ctx, "mappedId IN (");
+		for (j = i; j < count && j - i < NAMEDPROPS_MYSQL_BULK_SIZE; j++) {
+			where = talloc_asprintf_append(where, "%s%u", j > i ? "," : "", propIDs[j]);
+			MAPISTORE_RETVAL_IF(!where, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+		}
+		where = talloc_strdup_append(where, ")");
+		MAPISTORE_RETVAL_IF(!where, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+
+		retval = query_mappings(self, where, fn, private_data);
+		talloc_free(mem_ctx);
+	}
+
+	return retval;
+}
+
 static enum mapistore_error transaction_start(struct namedprops_context *self)
 {
 	MYSQL *conn = self->data;
@@ -596,12 +803,17 @@ enum mapistore_error mapistore_namedprops_mysql_init(TALLOC_CTX *mem_ctx,
 
 	nprops->create_id = create_id;
 	nprops->get_mapped_id = get_mapped_id;
+	nprops->get_mapped_ids = get_mapped_ids;
 	nprops->get_nameid = get_nameid;
+	nprops->get_nameids = get_nameids;
 	nprops->get_nameid_type = get_nameid_type;
 	nprops->next_unused_id = next_unused_id;
 	nprops->transaction_commit = transaction_commit;
 	nprops->transaction_start = transaction_start;
+	nprops->traverse = traverse;
 
+	nprops->backend_url = talloc_asprintf(nprops, "mysql://%s@%s:%d/%s", parms.user,
+					      parms.host, parms.port, parms.db);
 	nprops->data = conn;
 	talloc_set_destructor(nprops, mapistore_namedprops_mysql_destructor);
 
@@ -29,6 +29,8 @@
 #define	NAMEDPROPS_BACKEND_MYSQL	"mysql"
 #define	NAMEDPROPS_MYSQL_SCHEMA		"named_properties_schema.sql"
 #define	NAMEDPROPS_MYSQL_TABLE		"named_properties"
+/* Names or IDs looked up by a single query of the bulk lookups */
+#define	NAMEDPROPS_MYSQL_BULK_SIZE	256
 
 struct namedprops_mysql_params {
 	const char	*data;
@@ -226,6 +226,7 @@ struct mapistore_backend {
                 enum mapistore_error	(*set_restrictions)(void *, struct mapi_SRestriction *, uint8_t *);
                 enum mapistore_error	(*set_sort_order)(void *, struct SSortOrderSet *, uint8_t *);
                 enum mapistore_error	(*get_row)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+                enum mapistore_error	(*get_rows)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***, uint32_t *);
                 enum mapistore_error	(*get_row_count)(void *, enum mapistore_query_type, uint32_t *);
 		enum mapistore_error	(*handle_destructor)(void *, uint32_t);
         } table;
@@ -260,14 +261,21 @@ struct backend_context_list {
 };
 
 struct processing_context;
+struct backend_context_index;
+struct mapistore_context;
+
+typedef void (*mapistore_notification_callback_t)(struct mapistore_context *, void *);
 
 struct mapistore_context {
 	struct processing_context		*processing_ctx;
 	struct backend_context_list		*context_list;
+	struct backend_context_index		*context_index;
 	struct indexing_context_list		*indexing_list;
 	struct replica_mapping_context_list	*replica_mapping_list;
 	struct mapistore_subscription_list	*subscriptions;
 	struct mapistore_notification_list	*notifications;
+	mapistore_notification_callback_t	notification_callback;
+	void					*notification_private_data;
 	struct namedprops_context		*nprops_ctx;
 	struct mapistore_connection_info	*conn_info;
 #if 0
@@ -354,6 +362,7 @@ enum mapistore_error mapistore_table_set_columns(struct mapistore_context *, uin
 enum mapistore_error mapistore_table_set_restrictions(struct mapistore_context *, uint32_t, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_table_set_sort_order(struct mapistore_context *, uint32_t, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_table_get_row(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_table_get_rows(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***, uint32_t *);
 enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *, uint32_t, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_table_handle_destructor(struct mapistore_context *, uint32_t, void *, uint32_t);
 
@@ -371,8 +380,8 @@ enum mapistore_error mapistore_set_mapping_path(const char *);
 enum mapistore_error mapistore_backend_register(const void *);
 const char	*mapistore_backend_get_installdir(void);
 init_backend_fn	*mapistore_backend_load(TALLOC_CTX *, const char *);
-struct backend_context *mapistore_backend_lookup(struct backend_context_list *, uint32_t);
-struct backend_context *mapistore_backend_lookup_by_uri(struct backend_context_list *, const char *);
+struct backend_context *mapistore_backend_lookup(struct mapistore_context *, uint32_t);
+struct backend_context *mapistore_backend_lookup_by_uri(struct mapistore_context *, const char *);
 struct backend_context *mapistore_backend_lookup_by_name(TALLOC_CTX *, const char *);
 bool		mapistore_backend_run_init(init_backend_fn *);
 
@@ -401,19 +410,20 @@ struct namedprops_context;
 
 /* definitions from mapistore_namedprops.c */
 enum mapistore_error mapistore_namedprops_get_mapped_id(struct namedprops_context *, struct MAPINAMEID, uint16_t *);
+enum mapistore_error mapistore_namedprops_get_mapped_ids(struct namedprops_context *, uint16_t, struct MAPINAMEID *, uint16_t *);
 enum mapistore_error mapistore_namedprops_next_unused_id(struct namedprops_context *, uint16_t *);
 enum mapistore_error mapistore_namedprops_create_id(struct namedprops_context *, struct MAPINAMEID, uint16_t);
 enum mapistore_error mapistore_namedprops_get_nameid(struct namedprops_context *, uint16_t, TALLOC_CTX *mem_ctx, struct MAPINAMEID **);
+enum mapistore_error mapistore_namedprops_get_nameids(struct namedprops_context *, uint16_t, uint16_t *, TALLOC_CTX *mem_ctx, struct MAPINAMEID ***);
 enum mapistore_error mapistore_namedprops_get_nameid_type(struct namedprops_context *, uint16_t, uint16_t *);
 enum mapistore_error mapistore_namedprops_transaction_start(struct namedprops_context *);
 enum mapistore_error mapistore_namedprops_transaction_commit(struct namedprops_context *);
+void mapistore_namedprops_cache_flush(void);
 
 /* definitions from mapistore_mgmt.c */
 #if 0
 enum mapistore_error mapistore_mgmt_backend_register_user(struct mapistore_connection_info *, const char *, const char *);
 enum mapistore_error mapistore_mgmt_backend_unregister_user(struct mapistore_connection_info *, const char *, const char *);
-enum mapistore_error mapistore_mgmt_interface_register_subscription(struct mapistore_connection_info *, struct mapistore_mgmt_notif *);
-enum mapistore_error mapistore_mgmt_interface_unregister_subscription(struct mapistore_connection_info *, struct mapistore_mgmt_notif *);
 enum mapistore_error mapistore_mgmt_interface_register_bind(struct mapistore_connection_info *, uint16_t, uint8_t *, uint16_t, uint8_t *);
 #endif
 
@@ -444,10 +454,6 @@ struct mapistore_subscription {
 		struct mapistore_table_subscription_parameters table_parameters;
 		struct mapistore_object_subscription_parameters object_parameters;
 	} parameters;
-#if 0
-	char		*mqueue_name;
-	mqd_t		mqueue;
-#endif
 };
 
 struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *, struct mapistore_context *, const char *, uint32_t, uint16_t, void *);
@@ -504,6 +510,10 @@ struct mapistore_context;
 struct mapistore_subscription_list *mapistore_find_matching_subscriptions(struct mapistore_context *, struct mapistore_notification *);
 enum mapistore_error mapistore_delete_subscription(struct mapistore_context *, uint32_t, uint16_t);
 void mapistore_push_notification(struct mapistore_context *, uint8_t, enum mapistore_notification_type, void *);
+enum mapistore_error mapistore_set_notification_callback(struct mapistore_context *, mapistore_notification_callback_t, void *);
+bool mapistore_notification_pending(struct mapistore_context *);
+mqd_t mapistore_notification_newmail_open(const char *);
+enum mapistore_error mapistore_notification_newmail_receive(TALLOC_CTX *, mqd_t, struct mapistore_notification_list **);
 enum mapistore_error mapistore_get_queued_notifications(struct mapistore_context *, struct mapistore_subscription *, struct mapistore_notification_list **);
 enum mapistore_error mapistore_get_queued_notifications_named(struct mapistore_context *, const char *, struct mapistore_notification_list **);
 
@@ -31,6 +31,7 @@
 #include "mapistore.h"
 #include "mapistore_errors.h"
 #include "mapistore_private.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
 #include <dlinklist.h>
 
 #include <samba_util.h>
@@ -437,57 +438,186 @@ _PUBLIC_ enum mapistore_error mapistore_backend_delete_context(struct backend_co
 }
 
 
+static size_t mapistore_backend_index_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct backend_context_list *)e)->ctx->uri);
+}
+
+static bool mapistore_backend_index_cmp(const void *e, void *uri)
+{
+	return !strcmp(((const struct backend_context_list *)e)->ctx->uri, (const char *)uri);
+}
+
+static int mapistore_backend_index_destructor(struct backend_context_index *ctx_index)
+{
+	htable_clear(&ctx_index->uri_ht);
+	return 0;
+}
+
+
+/**
+   \details Initialize the backend contexts lookup tables
+
+   \param mem_ctx pointer to the memory context
+
+   \return Allocated lookup tables on success, otherwise NULL
+ */
+struct backend_context_index *mapistore_backend_index_init(TALLOC_CTX *mem_ctx)
+{
+	struct backend_context_index	*ctx_index;
+
+	ctx_index = talloc_zero(mem_ctx, struct backend_context_index);
+	if (!ctx_index) return NULL;
+
+	htable_init(&ctx_index->uri_ht, mapistore_backend_index_rehash, NULL);
+	talloc_set_destructor(ctx_index, mapistore_backend_index_destructor);
+
+	return ctx_index;
+}
+
+
+/**
+   \details Reference a backend context list element in the lookup
+   tables
+
+   \param ctx_index pointer to the lookup tables
+   \param el pointer to the backend context list element to add
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_backend_index_add(struct backend_context_index *ctx_index,
+						 struct backend_context_list *el)
+{
+	struct backend_context_list	**contexts;
+	uint32_t			context_id;
+	uint32_t			size;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ctx_index, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!el || !el->ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	context_id = el->ctx->context_id;
+	MAPISTORE_RETVAL_IF(context_id == (uint32_t)-1, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Extend the identifier table if needed */
+	if (context_id >= ctx_index->size) {
+		size = ctx_index->size ? ctx_index->size : 32;
+		while (size <= context_id) {
+			size *= 2;
+		}
+		contexts = talloc_realloc(ctx_index, ctx_index->contexts, struct backend_context_list *, size);
+		MAPISTORE_RETVAL_IF(!contexts, MAPISTORE_ERR_NO_MEMORY, NULL);
+		memset(&contexts[ctx_index->size], 0, (size - ctx_index->size) * sizeof (struct backend_context_list *));
+		ctx_index->contexts = contexts;
+		ctx_index->size = size;
+	}
+	MAPISTORE_RETVAL_IF(ctx_index->contexts[context_id], MAPISTORE_ERR_EXIST, NULL);
+
+	/* Step 2. Index the element by URI */
+	if (el->ctx->uri) {
+		MAPISTORE_RETVAL_IF(!htable_add(&ctx_index->uri_ht, hash_string(el->ctx->uri), el),
+				    MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+
+	ctx_index->contexts[context_id] = el;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Remove a backend context list element from the lookup
+   tables
+
+   \param ctx_index pointer to the lookup tables
+   \param el pointer to the backend context list element to remove
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_backend_index_del(struct backend_context_index *ctx_index,
+						 struct backend_context_list *el)
+{
+	uint32_t	context_id;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ctx_index, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!el || !el->ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	context_id = el->ctx->context_id;
+	MAPISTORE_RETVAL_IF(context_id >= ctx_index->size || ctx_index->contexts[context_id] != el,
+			    MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	if (el->ctx->uri) {
+		htable_del(&ctx_index->uri_ht, hash_string(el->ctx->uri), el);
+	}
+	ctx_index->contexts[context_id] = NULL;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Return the backend context list element matching given
+   context identifier
+
+   \param ctx_index pointer to the lookup tables
+   \param context_id the context identifier to search
+
+   \return Pointer to the backend context list element on success,
+   otherwise NULL
+ */
+struct backend_context_list *mapistore_backend_index_get(struct backend_context_index *ctx_index,
+							 uint32_t context_id)
+{
+	if (!ctx_index || context_id >= ctx_index->size) return NULL;
+
+	return ctx_index->contexts[context_id];
+}
+
+
 /**
    \details find the context matching given context identifier
 
-   \param backend_list_ctx pointer to the backend context list
+   \param mstore_ctx pointer to the mapistore context
    \param context_id the context identifier to search
 
    \return Pointer to the mapistore_backend context on success, otherwise NULL
  */
-_PUBLIC_ struct backend_context *mapistore_backend_lookup(struct backend_context_list *backend_list_ctx,
+_PUBLIC_ struct backend_context *mapistore_backend_lookup(struct mapistore_context *mstore_ctx,
 							  uint32_t context_id)
 {
 	struct backend_context_list	*el;
 
 	/* Sanity checks */
-	if (!backend_list_ctx) return NULL;
+	if (!mstore_ctx) return NULL;
 
-	for (el = backend_list_ctx; el; el = el->next) {
-		if (el->ctx && el->ctx->context_id == context_id) {
-			return el->ctx;
-		}
-	}
+	el = mapistore_backend_index_get(mstore_ctx->context_index, context_id);
 
-	return NULL;
+	return el ? el->ctx : NULL;
 }
 
 /**
    \details find the context matching given uri string
 
-   \param backend_list_ctx pointer to the backend context list
+   \param mstore_ctx pointer to the mapistore context
    \param uri the uri string to search
 
    \return Pointer to the mapistore_backend context on success,
    otherwise NULL
  */
-_PUBLIC_ struct backend_context *mapistore_backend_lookup_by_uri(struct backend_context_list *backend_list_ctx,
+_PUBLIC_ struct backend_context *mapistore_backend_lookup_by_uri(struct mapistore_context *mstore_ctx,
 								 const char *uri)
 {
 	struct backend_context_list	*el;
 
 	/* sanity checks */
-	if (!backend_list_ctx) return NULL;
+	if (!mstore_ctx || !mstore_ctx->context_index) return NULL;
 	if (!uri) return NULL;
 
-	for (el = backend_list_ctx; el; el = el->next) {
-		if (el->ctx && el->ctx->uri &&
-		    !strcmp(el->ctx->uri, uri)) {
-			return el->ctx;
-		}
-	}
-	
-	return NULL;
+	el = htable_get(&mstore_ctx->context_index->uri_ht, hash_string(uri),
+			mapistore_backend_index_cmp, uri);
+
+	return el ? el->ctx : NULL;
 }
 
 /**
@@ -736,6 +866,69 @@ enum mapistore_error mapistore_backend_table_get_row(struct backend_context *bct
         return bctx->backend->table.get_row(table, mem_ctx, query_type, rowid, data);
 }
 
+/**
+   \details Retrieve a window of consecutive rows from a backend table
+
+   Backends which do not implement get_rows are served by calling
+   get_row once for each row of the window, the window being clamped
+   to the number of rows reported by get_row_count.
+
+   \param bctx pointer to the backend context
+   \param table pointer to the backend table object
+   \param mem_ctx pointer to the memory context used for the rows
+   \param query_type the type of query (prefiltered or live filtered)
+   \param start index of the first row to fetch
+   \param count maximum number of rows to fetch
+   \param rows pointer on the array of rows to return. Rows which
+   cannot be retrieved (e.g. filtered out by a live restriction) are
+   set to NULL
+   \param rows_count pointer to the number of entries in rows, which
+   can be lower than count when the end of the table is reached
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *bctx, void *table, TALLOC_CTX *mem_ctx,
+						      enum mapistore_query_type query_type, uint32_t start, uint32_t count,
+						      struct mapistore_property_data ***rows, uint32_t *rows_count)
+{
+	enum mapistore_error		ret;
+	struct mapistore_property_data	**row_data;
+	uint32_t			row_count;
+	uint32_t			i;
+
+	if (bctx->backend->table.get_rows) {
+		ret = bctx->backend->table.get_rows(table, mem_ctx, query_type, start, count, rows, rows_count);
+		if (ret != MAPISTORE_ERR_NOT_IMPLEMENTED) {
+			return ret;
+		}
+	}
+
+	/* Do not ask for rows past the end of the table */
+	if (bctx->backend->table.get_row_count &&
+	    bctx->backend->table.get_row_count(table, query_type, &row_count) == MAPISTORE_SUCCESS) {
+		if (start >= row_count) {
+			count = 0;
+		} else if (count > row_count - start) {
+			count = row_count - start;
+		}
+	}
+
+	row_data = talloc_zero_array(mem_ctx, struct mapistore_property_data *, count);
+	MAPISTORE_RETVAL_IF(count && !row_data, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	for (i = 0; i < count; i++) {
+		ret = bctx->backend->table.get_row(table, mem_ctx, query_type, start + i, &row_data[i]);
+		if (ret != MAPISTORE_SUCCESS) {
+			row_data[i] = NULL;
+		}
+	}
+
+	*rows = row_data;
+	*rows_count = count;
+
+	return MAPISTORE_SUCCESS;
+}
+
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *bctx, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
         return bctx->backend->table.get_row_count(table, query_type, row_countp);
@@ -299,6 +299,18 @@ static enum mapistore_error mapistore_op_defaults_get_row(void *table_object,
 	return MAPISTORE_ERR_NOT_IMPLEMENTED;
 }
 
+static enum mapistore_error mapistore_op_defaults_get_rows(void *table_object,
+							   TALLOC_CTX *mem_ctx,
+							   enum mapistore_query_type query_type,
+							   uint32_t start,
+							   uint32_t count,
+							   struct mapistore_property_data ***rows,
+							   uint32_t *rows_count)
+{
+	DEBUG(3, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
 static enum mapistore_error mapistore_op_defaults_get_row_count(void *table_object,
 								enum mapistore_query_type query_type,
 								uint32_t *row_countp)
@@ -390,6 +402,7 @@ extern enum mapistore_error mapistore_backend_init_defaults(struct mapistore_bac
 	backend->table.set_restrictions = mapistore_op_defaults_set_restrictions;
 	backend->table.set_sort_order = mapistore_op_defaults_set_sort_order;
 	backend->table.get_row = mapistore_op_defaults_get_row;
+	backend->table.get_rows = mapistore_op_defaults_get_rows;
 	backend->table.get_row_count = mapistore_op_defaults_get_row_count;
 	backend->table.handle_destructor = mapistore_op_defaults_handle_destructor;
 
@@ -169,7 +169,7 @@ enum mapistore_error mapistore_indexing_record_add_fmid(struct mapistore_context
 	MAPISTORE_RETVAL_IF(invalid_type, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!backend_ctx->indexing, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
@@ -218,7 +218,7 @@ enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context
 	MAPISTORE_RETVAL_IF(!fmid, MAPISTORE_ERROR, NULL);
 
 	/* Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!backend_ctx->indexing, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
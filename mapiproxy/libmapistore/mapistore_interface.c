@@ -90,10 +90,18 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 	}
 
 	mstore_ctx->context_list = NULL;
+	mstore_ctx->context_index = mapistore_backend_index_init(mstore_ctx);
+	if (!mstore_ctx->context_index) {
+		DEBUG(0, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(MAPISTORE_ERR_NO_MEMORY)));
+		talloc_free(mstore_ctx);
+		return NULL;
+	}
 	mstore_ctx->indexing_list = talloc_zero(mstore_ctx, struct indexing_context_list);
 	mstore_ctx->replica_mapping_list = talloc_zero(mstore_ctx, struct replica_mapping_context_list);
 	mstore_ctx->notifications = NULL;
 	mstore_ctx->subscriptions = NULL;
+	mstore_ctx->notification_callback = NULL;
+	mstore_ctx->notification_private_data = NULL;
 	mstore_ctx->conn_info = NULL;
 
 	indexing_url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "indexing_backend");
@@ -141,6 +149,7 @@ _PUBLIC_ enum mapistore_error mapistore_release(struct mapistore_context *mstore
 	talloc_free(mstore_ctx->nprops_ctx);
 	talloc_free(mstore_ctx->processing_ctx);
 	talloc_free(mstore_ctx->context_list);
+	talloc_free(mstore_ctx->context_index);
 	talloc_free(mstore_ctx->indexing_list);
 
 	return MAPISTORE_SUCCESS;
@@ -234,6 +243,13 @@ _PUBLIC_ enum mapistore_error mapistore_add_context(struct mapistore_context *ms
 			talloc_free(mem_ctx);
 			return MAPISTORE_ERR_CONTEXT_FAILED;
 		}
+		retval = mapistore_backend_index_add(mstore_ctx->context_index, backend_list);
+		if (retval != MAPISTORE_SUCCESS) {
+			mapistore_free_context_id(mstore_ctx->processing_ctx, backend_list->ctx->context_id);
+			talloc_free(backend_list);
+			talloc_free(mem_ctx);
+			return MAPISTORE_ERR_CONTEXT_FAILED;
+		}
 		*context_id = backend_list->ctx->context_id;
 		*backend_object = backend_list->ctx->root_folder_object;
 		DLIST_ADD_END(mstore_ctx->context_list, backend_list, struct backend_context_list *);
@@ -270,7 +286,7 @@ _PUBLIC_ enum mapistore_error mapistore_add_context_ref_count(struct mapistore_c
 
 	/* Step 0. Ensure the context exists */
 	DEBUG(0, ("mapistore_add_context_ref_count: context_is to increment is %d\n", context_id));
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 1. Increment the ref count */
@@ -307,7 +323,7 @@ _PUBLIC_ enum mapistore_error mapistore_search_context_by_uri(struct mapistore_c
 
 	if (!uri) return MAPISTORE_ERROR;
 
-	backend_ctx = mapistore_backend_lookup_by_uri(mstore_ctx->context_list, uri);
+	backend_ctx = mapistore_backend_lookup_by_uri(mstore_ctx, uri);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_NOT_FOUND, NULL);
 
 	*context_id = backend_ctx->context_id;
@@ -332,7 +348,6 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 	struct backend_context_list	*backend_list;
 	struct backend_context		*backend_ctx;
 	int				retval;
-	bool				found = false;
 
 	/* Sanity checks */
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
@@ -341,19 +356,9 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 
 	/* Step 0. Ensure the context exists */
 	DEBUG(5, ("mapistore_del_context: context_id to del is %d\n", context_id));
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
-	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
-
-	/* search the backend_list item */
-	for (backend_list = mstore_ctx->context_list; backend_list; backend_list = backend_list->next) {
-		if (backend_list->ctx->context_id == context_id) {
-			found = true;
-			break;
-		}		
-	}
-	if (found == false) {
-		return MAPISTORE_ERROR;
-	}
+	backend_list = mapistore_backend_index_get(mstore_ctx->context_index, context_id);
+	MAPISTORE_RETVAL_IF(!backend_list, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	backend_ctx = backend_list->ctx;
 
 	/* Step 1. Release the indexing context within backend */
 	/* if (backend_ctx->indexing) {
@@ -366,7 +371,11 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 		}
 	} */
 
-	/* Step 2. Delete the context within backend */
+	/* Step 2. Delete the context within backend. The last reference
+	 * frees backend_ctx, unindex it while its uri is still valid */
+	if (backend_ctx->ref_count == 1) {
+		mapistore_backend_index_del(mstore_ctx->context_index, backend_list);
+	}
 	retval = mapistore_backend_delete_context(backend_ctx);
 	
 	switch (retval) {
@@ -374,6 +383,7 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 		return MAPISTORE_SUCCESS;
 	case MAPISTORE_SUCCESS:
 		DLIST_REMOVE(mstore_ctx->context_list, backend_list);
+		talloc_free(backend_list);
 		/* Step 2. Add the free'd context id to the free list */
 		retval = mapistore_free_context_id(mstore_ctx->processing_ctx, context_id);
 		break;
@@ -491,7 +501,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend open_folder */
@@ -520,7 +530,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_create_folder(struct mapistore_co
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);	
 	
 	/* Step 2. Call backend create_folder */
@@ -556,7 +566,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_delete(struct mapistore_context *
 	mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 
 	/* Step 1. Find the backend context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	if (!backend_ctx) {
 		ret = MAPISTORE_ERR_INVALID_PARAMETER;
 		goto end;
@@ -657,7 +667,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_message(struct mapistore_con
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend open_message */
@@ -686,7 +696,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_create_message(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	
 	/* Step 2. Call backend create_message */
@@ -714,7 +724,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_delete_message(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -733,7 +743,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_move_copy_messages(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -752,7 +762,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_move_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -772,7 +782,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_copy_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -802,7 +812,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_deleted_fmids(struct mapistor
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -827,7 +837,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_count(struct mapistore_
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 0. Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend get_child_count */
@@ -914,7 +924,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_fid_by_name(struct mapi
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -930,7 +940,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_table(struct mapistore_conte
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -945,7 +955,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_modify_permissions(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -960,7 +970,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_preload_message_bodies(struct map
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1209,7 +1219,7 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	/* Sanity checks */
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
@@ -1403,7 +1413,7 @@ enum mapistore_error mapistore_message_get_message_data(struct mapistore_context
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend modifyrecipients */
@@ -1430,7 +1440,7 @@ enum mapistore_error mapistore_message_modify_recipients(struct mapistore_contex
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend modifyrecipients */
@@ -1456,7 +1466,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_set_read_flag(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend savechangesmessage */
@@ -1482,7 +1492,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_save(struct mapistore_context *m
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend savechangesmessage */
@@ -1510,7 +1520,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_submit(struct mapistore_context
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend submitmessage */
@@ -1526,7 +1536,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_get_attachment_table(struct mapi
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1542,7 +1552,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_open_attachment(struct mapistore
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1558,7 +1568,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_create_attachment(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1573,7 +1583,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_attachment_open_embedded_message
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1588,7 +1598,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_attachment_create_embedded_messa
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1603,7 +1613,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_available_properties(struct ma
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1618,7 +1628,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_columns(struct mapistore_conte
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1633,7 +1643,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_restrictions(struct mapistore_
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1648,7 +1658,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_sort_order(struct mapistore_co
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1664,13 +1674,48 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_row(struct mapistore_context *
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
 	return mapistore_backend_table_get_row(backend_ctx, table, mem_ctx, query_type, rowid, data);
 }
 
+/**
+   \details Retrieve up to count consecutive rows from a table in a
+   single backend call
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param table pointer to the table object
+   \param mem_ctx pointer to the memory context used for the rows
+   \param query_type the type of query (prefiltered or live filtered)
+   \param start index of the first row to fetch
+   \param count maximum number of rows to fetch
+   \param rows pointer on the array of rows to return, unavailable
+   rows are set to NULL
+   \param rows_count pointer to the number of entries in rows
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_table_get_rows(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, TALLOC_CTX *mem_ctx,
+						       enum mapistore_query_type query_type, uint32_t start, uint32_t count,
+						       struct mapistore_property_data ***rows, uint32_t *rows_count)
+{
+	struct backend_context	*backend_ctx;
+
+	/* Sanity checks */
+	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
+	MAPISTORE_RETVAL_IF(!rows || !rows_count, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Search the context */
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
+	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 2. Call backend operation */
+	return mapistore_backend_table_get_rows(backend_ctx, table, mem_ctx, query_type, start, count, rows, rows_count);
+}
+
 _PUBLIC_ enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
 	struct backend_context	*backend_ctx;
@@ -1679,7 +1724,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_row_count(struct mapistore_con
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1694,7 +1739,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_handle_destructor(struct mapistore
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1709,7 +1754,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_get_available_properties(stru
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1728,7 +1773,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_get_properties(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1746,7 +1791,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_set_properties(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -23,9 +23,414 @@
 #include <stdbool.h>
 #include <string.h>
 #include "mapistore.h"
+#include <dlinklist.h>
 
 #include "backends/namedprops_ldb.h"
 #include "backends/namedprops_mysql.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+/**
+   Named properties mappings are never modified nor removed once
+   created, so they are cached for the lifetime of the process and
+   shared by all the namedprops contexts opened on the same
+   database. The cache is filled with a single traversal of the
+   backend when the first context is opened, then updated by
+   create_id. Lookups missing the cache still go to the backend so
+   mappings created by other processes are found; the array lookups
+   send all their misses to the backend at once.
+
+   Names are unique but mapped IDs are not enforced to be: the MySQL
+   schema allows several names with the same mappedId. The first
+   mapping seen for an ID wins, in creation order for MySQL, and is
+   the one returned by get_nameid for both the cache and the backend.
+ */
+
+struct namedprops_cache_entry {
+	struct namedprops_cache_entry	*prev;
+	struct namedprops_cache_entry	*next;
+	struct MAPINAMEID		nameid;
+	uint16_t			mapped_id;
+	uint16_t			prop_type;
+};
+
+struct namedprops_cache {
+	struct namedprops_cache		*prev;
+	struct namedprops_cache		*next;
+	const char			*url;
+	struct htable			by_name;
+	struct htable			by_id;
+	uint32_t			count;
+};
+
+static struct namedprops_cache *namedprops_cache_list;
+
+static size_t _nameid_hash(const struct MAPINAMEID *nameid)
+{
+	uint32_t	h;
+
+	h = hash(&nameid->lpguid, 1, nameid->ulKind);
+	switch (nameid->ulKind) {
+	case MNID_ID:
+		return hash(&nameid->kind.lid, 1, h);
+	case MNID_STRING:
+		return nameid->kind.lpwstr.Name ? hash_any(nameid->kind.lpwstr.Name,
+							   strlen(nameid->kind.lpwstr.Name), h) : h;
+	}
+
+	return h;
+}
+
+static size_t _by_name_rehash(const void *e, void *unused)
+{
+	return _nameid_hash(&((const struct namedprops_cache_entry *)e)->nameid);
+}
+
+static bool _nameid_equal(const struct MAPINAMEID *a, const struct MAPINAMEID *b)
+{
+	if (a->ulKind != b->ulKind || GUID_compare(&a->lpguid, &b->lpguid)) {
+		return false;
+	}
+
+	switch (a->ulKind) {
+	case MNID_ID:
+		return a->kind.lid == b->kind.lid;
+	case MNID_STRING:
+		return a->kind.lpwstr.Name && b->kind.lpwstr.Name &&
+			strcmp(a->kind.lpwstr.Name, b->kind.lpwstr.Name) == 0;
+	}
+
+	return false;
+}
+
+static bool _by_name_cmp(const void *e, void *key)
+{
+	return _nameid_equal(&((const struct namedprops_cache_entry *)e)->nameid,
+			     (const struct MAPINAMEID *)key);
+}
+
+static size_t _by_id_rehash(const void *e, void *unused)
+{
+	return ((const struct namedprops_cache_entry *)e)->mapped_id;
+}
+
+static bool _by_id_cmp(const void *e, void *mapped_id)
+{
+	return ((const struct namedprops_cache_entry *)e)->mapped_id == *(const uint16_t *)mapped_id;
+}
+
+static int _namedprops_cache_destructor(struct namedprops_cache *cache)
+{
+	DLIST_REMOVE(namedprops_cache_list, cache);
+	htable_clear(&cache->by_name);
+	htable_clear(&cache->by_id);
+	return 0;
+}
+
+/**
+   \details Return the process cache matching the database the
+   namedprops context is opened on
+
+   \param nprops pointer to the namedprops context
+
+   \return pointer to the cache on success, otherwise NULL
+ */
+static struct namedprops_cache *namedprops_cache_get(struct namedprops_context *nprops)
+{
+	struct namedprops_cache	*cache;
+
+	if (!nprops || !nprops->backend_url) return NULL;
+
+	for (cache = namedprops_cache_list; cache; cache = cache->next) {
+		if (strcmp(cache->url, nprops->backend_url) == 0) {
+			return cache;
+		}
+	}
+
+	return NULL;
+}
+
+static struct namedprops_cache_entry *namedprops_cache_entry_new(TALLOC_CTX *mem_ctx,
+								 const struct MAPINAMEID *nameid,
+								 uint16_t mapped_id,
+								 uint16_t prop_type)
+{
+	struct namedprops_cache_entry	*entry;
+
+	entry = talloc_zero(mem_ctx, struct namedprops_cache_entry);
+	if (!entry) return NULL;
+
+	entry->nameid = *nameid;
+	entry->mapped_id = mapped_id;
+	entry->prop_type = prop_type;
+	if (nameid->ulKind == MNID_STRING) {
+		entry->nameid.kind.lpwstr.Name = talloc_strdup(entry, nameid->kind.lpwstr.Name);
+		if (!entry->nameid.kind.lpwstr.Name) {
+			talloc_free(entry);
+			return NULL;
+		}
+	}
+
+	return entry;
+}
+
+/**
+   \details Add a mapping to the cache. The first mapping seen for a
+   name, respectively an identifier, wins.
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error namedprops_cache_add(struct namedprops_cache *cache,
+						 const struct MAPINAMEID *nameid,
+						 uint16_t mapped_id,
+						 uint16_t prop_type)
+{
+	struct namedprops_cache_entry	*entry;
+	bool				by_name;
+	bool				by_id;
+
+	if (nameid->ulKind != MNID_ID && nameid->ulKind != MNID_STRING) {
+		return MAPISTORE_SUCCESS;
+	}
+	if (nameid->ulKind == MNID_STRING && !nameid->kind.lpwstr.Name) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	by_name = !htable_get(&cache->by_name, _nameid_hash(nameid), _by_name_cmp, nameid);
+	by_id = !htable_get(&cache->by_id, mapped_id, _by_id_cmp, &mapped_id);
+	if (!by_name && !by_id) return MAPISTORE_SUCCESS;
+	if (by_name && !by_id) {
+		DEBUG(5, ("[%s:%d] 0x%.4x maps several names, keeping the first one\n",
+			  __FUNCTION__, __LINE__, mapped_id));
+	}
+
+	entry = namedprops_cache_entry_new(cache, nameid, mapped_id, prop_type);
+	MAPISTORE_RETVAL_IF(!entry, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	if (by_name && !htable_add(&cache->by_name, _nameid_hash(nameid), entry)) {
+		talloc_free(entry);
+		return MAPISTORE_ERR_NO_MEMORY;
+	}
+	if (by_id && !htable_add(&cache->by_id, mapped_id, entry)) {
+		if (by_name) {
+			htable_del(&cache->by_name, _nameid_hash(nameid), entry);
+		}
+		talloc_free(entry);
+		return MAPISTORE_ERR_NO_MEMORY;
+	}
+	cache->count++;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error namedprops_cache_traverse_fn(void *private_data,
+							 const struct MAPINAMEID *nameid,
+							 uint16_t mapped_id,
+							 uint16_t prop_type)
+{
+	return namedprops_cache_add((struct namedprops_cache *)private_data,
+				    nameid, mapped_id, prop_type);
+}
+
+/**
+   \details Attach the namedprops context to the process cache of its
+   database, loading all the mappings from the backend the first
+   time the database is opened.
+
+   \param nprops pointer to the namedprops context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error namedprops_cache_load(struct namedprops_context *nprops)
+{
+	enum mapistore_error	retval;
+	struct namedprops_cache	*cache;
+
+	/* Backends without traverse support are not cached */
+	if (!nprops->traverse || !nprops->backend_url) return MAPISTORE_SUCCESS;
+
+	cache = namedprops_cache_get(nprops);
+	if (cache) return MAPISTORE_SUCCESS;
+
+	cache = talloc_zero(NULL, struct namedprops_cache);
+	MAPISTORE_RETVAL_IF(!cache, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	cache->url = talloc_strdup(cache, nprops->backend_url);
+	MAPISTORE_RETVAL_IF(!cache->url, MAPISTORE_ERR_NO_MEMORY, cache);
+
+	htable_init(&cache->by_name, _by_name_rehash, NULL);
+	htable_init(&cache->by_id, _by_id_rehash, NULL);
+	DLIST_ADD(namedprops_cache_list, cache);
+	talloc_set_destructor(cache, _namedprops_cache_destructor);
+
+	retval = nprops->traverse(nprops, namedprops_cache_traverse_fn, cache);
+	if (retval != MAPISTORE_SUCCESS) {
+		DEBUG(1, ("[%s:%d] ERROR: loading named properties from %s failed with %s\n",
+			  __FUNCTION__, __LINE__, cache->url, mapistore_errstr(retval)));
+		talloc_free(cache);
+		return retval;
+	}
+
+	DEBUG(3, ("[%s:%d] %u named properties loaded from %s\n", __FUNCTION__, __LINE__,
+		  cache->count, cache->url));
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Drop all the process caches, the next namedprops context
+   opened reloads the mappings from its backend.
+ */
+_PUBLIC_ void mapistore_namedprops_cache_flush(void)
+{
+	while (namedprops_cache_list) {
+		talloc_free(namedprops_cache_list);
+	}
+}
+
+static struct namedprops_cache_entry *namedprops_cache_by_name(struct namedprops_context *nprops,
+							       const struct MAPINAMEID *nameid)
+{
+	struct namedprops_cache	*cache;
+
+	cache = namedprops_cache_get(nprops);
+	if (!cache) return NULL;
+
+	return htable_get(&cache->by_name, _nameid_hash(nameid), _by_name_cmp, nameid);
+}
+
+static struct namedprops_cache_entry *namedprops_cache_by_id(struct namedprops_context *nprops,
+							     uint16_t mapped_id)
+{
+	struct namedprops_cache	*cache;
+
+	cache = namedprops_cache_get(nprops);
+	if (!cache) return NULL;
+
+	return htable_get(&cache->by_id, mapped_id, _by_id_cmp, &mapped_id);
+}
+
+/**
+   \details Record a mapping found in or added to the backend. Inside
+   a transaction the mapping is only published on commit.
+ */
+static void namedprops_cache_update(struct namedprops_context *nprops,
+				    const struct MAPINAMEID *nameid,
+				    uint16_t mapped_id,
+				    uint16_t prop_type,
+				    bool created)
+{
+	struct namedprops_cache		*cache;
+	struct namedprops_cache_entry	*entry;
+
+	cache = namedprops_cache_get(nprops);
+	if (!cache) return;
+
+	if (!nprops->in_transaction) {
+		namedprops_cache_add(cache, nameid, mapped_id, prop_type);
+		return;
+	}
+
+	/* Lookups inside a transaction may see uncommitted mappings */
+	if (!created) return;
+
+	entry = namedprops_cache_entry_new(nprops, nameid, mapped_id, prop_type);
+	if (!entry) return;
+	DLIST_ADD_END(nprops->pending, entry, struct namedprops_cache_entry *);
+}
+
+static struct MAPINAMEID *namedprops_cache_copy_nameid(TALLOC_CTX *mem_ctx,
+						      const struct MAPINAMEID *src)
+{
+	struct MAPINAMEID	*nameid;
+
+	nameid = talloc_zero(mem_ctx, struct MAPINAMEID);
+	if (!nameid) return NULL;
+
+	*nameid = *src;
+	if (nameid->ulKind == MNID_STRING) {
+		nameid->kind.lpwstr.Name = talloc_strdup(nameid, src->kind.lpwstr.Name);
+		if (!nameid->kind.lpwstr.Name) {
+			talloc_free(nameid);
+			return NULL;
+		}
+	}
+
+	return nameid;
+}
+
+
+/* A name or mapped ID looked up in the backend by an array lookup */
+struct namedprops_lookup {
+	const struct MAPINAMEID	*nameid;
+	uint16_t		*mapped_id;
+	struct MAPINAMEID	**nameidp;
+};
+
+struct namedprops_bulk {
+	struct namedprops_context	*nprops;
+	TALLOC_CTX			*mem_ctx;
+	struct htable			lookups;
+};
+
+static size_t _lookup_by_name_rehash(const void *e, void *unused)
+{
+	return _nameid_hash(((const struct namedprops_lookup *)e)->nameid);
+}
+
+static size_t _lookup_by_id_rehash(const void *e, void *unused)
+{
+	return *((const struct namedprops_lookup *)e)->mapped_id;
+}
+
+static enum mapistore_error namedprops_bulk_mapped_id_fn(void *private_data,
+							 const struct MAPINAMEID *nameid,
+							 uint16_t mapped_id,
+							 uint16_t prop_type)
+{
+	struct namedprops_bulk		*bulk = (struct namedprops_bulk *)private_data;
+	struct namedprops_lookup	*lookup;
+	struct htable_iter		iter;
+	size_t				h = _nameid_hash(nameid);
+	bool				found = false;
+
+	for (lookup = htable_firstval(&bulk->lookups, &iter, h); lookup;
+	     lookup = htable_nextval(&bulk->lookups, &iter, h)) {
+		if (*lookup->mapped_id || !_nameid_equal(lookup->nameid, nameid)) continue;
+		*lookup->mapped_id = mapped_id;
+		found = true;
+	}
+	if (found) {
+		namedprops_cache_update(bulk->nprops, nameid, mapped_id, prop_type, false);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error namedprops_bulk_nameid_fn(void *private_data,
+						      const struct MAPINAMEID *nameid,
+						      uint16_t mapped_id,
+						      uint16_t prop_type)
+{
+	struct namedprops_bulk		*bulk = (struct namedprops_bulk *)private_data;
+	struct namedprops_lookup	*lookup;
+	struct htable_iter		iter;
+	bool				found = false;
+
+	/* The first mapping returned for an ID wins */
+	for (lookup = htable_firstval(&bulk->lookups, &iter, mapped_id); lookup;
+	     lookup = htable_nextval(&bulk->lookups, &iter, mapped_id)) {
+		if (*lookup->nameidp || *lookup->mapped_id != mapped_id) continue;
+		*lookup->nameidp = namedprops_cache_copy_nameid(bulk->mem_ctx, nameid);
+		MAPISTORE_RETVAL_IF(!*lookup->nameidp, MAPISTORE_ERR_NO_MEMORY, NULL);
+		found = true;
+	}
+	if (found) {
+		namedprops_cache_update(bulk->nprops, nameid, mapped_id, prop_type, false);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
 
 
 /**
@@ -55,7 +460,8 @@ enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *mem_ctx,
 					       struct loadparm_context *lp_ctx,
 					       struct namedprops_context **nprops)
 {
-	const char	*backend;
+	enum mapistore_error	retval;
+	const char		*backend;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
@@ -69,15 +475,20 @@ enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *mem_ctx,
 		backend = NAMEDPROPS_BACKEND_LDB;
 	}
 	if (!strncmp(backend, NAMEDPROPS_BACKEND_LDB, strlen(NAMEDPROPS_BACKEND_LDB))) {
-		return mapistore_namedprops_ldb_init(mem_ctx, lp_ctx, nprops);
+		retval = mapistore_namedprops_ldb_init(mem_ctx, lp_ctx, nprops);
 	} else if (!strncmp(backend, NAMEDPROPS_BACKEND_MYSQL, strlen(NAMEDPROPS_BACKEND_MYSQL))) {
-		return mapistore_namedprops_mysql_init(mem_ctx, lp_ctx, nprops);
+		retval = mapistore_namedprops_mysql_init(mem_ctx, lp_ctx, nprops);
 	} else {
 		DEBUG(1, ("[%s:%d] ERROR: Invalid namedproperties backend type '%s'\n",
 			  __FUNCTION__, __LINE__, backend));
+		return MAPISTORE_ERR_INVALID_PARAMETER;
 	}
+	MAPISTORE_RETVAL_IF(retval != MAPISTORE_SUCCESS, retval, NULL);
 
-	return MAPISTORE_ERR_INVALID_PARAMETER;
+	/* Lookups fall back to the backend if the cache can't be loaded */
+	namedprops_cache_load(*nprops);
+
+	return MAPISTORE_SUCCESS;
 }
 
 
@@ -122,9 +533,16 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_create_id(struct namedprops_c
 							     struct MAPINAMEID nameid,
 							     uint16_t mapped_id)
 {
+	enum mapistore_error	retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 
-	return nprops->create_id(nprops, nameid, mapped_id);
+	retval = nprops->create_id(nprops, nameid, mapped_id);
+	if (retval == MAPISTORE_SUCCESS) {
+		namedprops_cache_update(nprops, &nameid, mapped_id, PT_NULL, true);
+	}
+
+	return retval;
 }
 
 /**
@@ -141,10 +559,111 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_mapped_id(struct namedpro
 								 struct MAPINAMEID nameid,
 								 uint16_t *propID)
 {
+	enum mapistore_error		retval;
+	struct namedprops_cache_entry	*entry;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!propID, MAPISTORE_ERROR, NULL);
 
-	return nprops->get_mapped_id(nprops, nameid, propID);
+	entry = namedprops_cache_by_name(nprops, &nameid);
+	if (entry) {
+		*propID = entry->mapped_id;
+		return MAPISTORE_SUCCESS;
+	}
+
+	retval = nprops->get_mapped_id(nprops, nameid, propID);
+	if (retval == MAPISTORE_SUCCESS) {
+		namedprops_cache_update(nprops, &nameid, *propID, 0, false);
+	}
+
+	return retval;
+}
+
+/**
+   \details Return the mapped property IDs matching an array of
+   nameid structures. Names without mapping get a 0x0000 ID.
+
+   \param nprops pointer to the namedprops context
+   \param count number of elements in nameids and propIDs
+   \param nameids array of MAPINAMEID structures to lookup
+   \param propIDs array the function fills with the property IDs
+
+   \return MAPISTORE_SUCCESS if all the names are mapped,
+   MAPISTORE_ERR_NOT_FOUND if some are not, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_namedprops_get_mapped_ids(struct namedprops_context *nprops,
+								  uint16_t count,
+								  struct MAPINAMEID *nameids,
+								  uint16_t *propIDs)
+{
+	TALLOC_CTX			*local_mem_ctx;
+	enum mapistore_error		retval = MAPISTORE_SUCCESS;
+	struct namedprops_cache_entry	*entry;
+	struct namedprops_lookup	*lookups;
+	struct MAPINAMEID		*misses;
+	struct namedprops_bulk		bulk;
+	uint16_t			nmisses = 0;
+	uint16_t			i;
+
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !nameids, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !propIDs, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (!nprops->get_mapped_ids) {
+		for (i = 0; i < count; i++) {
+			if (mapistore_namedprops_get_mapped_id(nprops, nameids[i], &propIDs[i]) != MAPISTORE_SUCCESS) {
+				propIDs[i] = 0x0000;
+				retval = MAPISTORE_ERR_NOT_FOUND;
+			}
+		}
+		return retval;
+	}
+
+	local_mem_ctx = talloc_named(NULL, 0, "mapistore_namedprops_get_mapped_ids");
+	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+	lookups = talloc_array(local_mem_ctx, struct namedprops_lookup, count);
+	MAPISTORE_RETVAL_IF(!lookups, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+	misses = talloc_array(local_mem_ctx, struct MAPINAMEID, count);
+	MAPISTORE_RETVAL_IF(!misses, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+	bulk.nprops = nprops;
+	bulk.mem_ctx = NULL;
+	htable_init(&bulk.lookups, _lookup_by_name_rehash, NULL);
+
+	/* Step 1. Serve what we can from the cache */
+	for (i = 0; i < count; i++) {
+		propIDs[i] = 0x0000;
+		entry = namedprops_cache_by_name(nprops, &nameids[i]);
+		if (entry) {
+			propIDs[i] = entry->mapped_id;
+			continue;
+		}
+		lookups[nmisses].nameid = &nameids[i];
+		lookups[nmisses].mapped_id = &propIDs[i];
+		lookups[nmisses].nameidp = NULL;
+		if (!htable_add(&bulk.lookups, _nameid_hash(&nameids[i]), &lookups[nmisses])) {
+			retval = MAPISTORE_ERR_NO_MEMORY;
+			goto end;
+		}
+		misses[nmisses++] = nameids[i];
+	}
+
+	/* Step 2. Look all the misses up in the backend at once */
+	if (nmisses) {
+		retval = nprops->get_mapped_ids(nprops, nmisses, misses, namedprops_bulk_mapped_id_fn, &bulk);
+		if (retval != MAPISTORE_SUCCESS) goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!propIDs[i]) {
+			retval = MAPISTORE_ERR_NOT_FOUND;
+		}
+	}
+
+end:
+	htable_clear(&bulk.lookups);
+	talloc_free(local_mem_ctx);
+
+	return retval;
 }
 
 /**
@@ -162,11 +681,132 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameid(struct namedprops_
 							      TALLOC_CTX *mem_ctx,
 							      struct MAPINAMEID **nameidp)
 {
+	enum mapistore_error		retval;
+	struct namedprops_cache_entry	*entry;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(propID < 0x8000, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!nameidp, MAPISTORE_ERROR, NULL);
 
-	return nprops->get_nameid(nprops, propID, mem_ctx, nameidp);
+	entry = namedprops_cache_by_id(nprops, propID);
+	if (entry) {
+		*nameidp = namedprops_cache_copy_nameid(mem_ctx, &entry->nameid);
+		MAPISTORE_RETVAL_IF(!*nameidp, MAPISTORE_ERR_NO_MEMORY, NULL);
+		return MAPISTORE_SUCCESS;
+	}
+
+	retval = nprops->get_nameid(nprops, propID, mem_ctx, nameidp);
+	if (retval == MAPISTORE_SUCCESS && *nameidp) {
+		namedprops_cache_update(nprops, *nameidp, propID, 0, false);
+	}
+
+	return retval;
+}
+
+/**
+   \details Return the nameid structures matching an array of mapped
+   property IDs.
+
+   \param nprops pointer to the namedprops context
+   \param count number of elements in propIDs
+   \param propIDs array of property IDs to lookup
+   \param mem_ctx pointer to the memory context
+   \param nameidsp pointer on the array of MAPINAMEID pointers the
+   function returns, NULL for the property IDs without mapping
+
+   \return MAPISTORE_SUCCESS if all the property IDs are mapped,
+   MAPISTORE_ERR_NOT_FOUND if some are not, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameids(struct namedprops_context *nprops,
+							       uint16_t count,
+							       uint16_t *propIDs,
+							       TALLOC_CTX *mem_ctx,
+							       struct MAPINAMEID ***nameidsp)
+{
+	TALLOC_CTX			*local_mem_ctx;
+	enum mapistore_error		retval = MAPISTORE_SUCCESS;
+	struct namedprops_cache_entry	*entry;
+	struct namedprops_lookup	*lookups;
+	struct namedprops_bulk		bulk;
+	struct MAPINAMEID		**nameids;
+	uint16_t			*misses;
+	uint16_t			nmisses = 0;
+	uint16_t			i;
+
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && !propIDs, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!nameidsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	nameids = talloc_zero_array(mem_ctx, struct MAPINAMEID *, count + 1);
+	MAPISTORE_RETVAL_IF(!nameids, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	if (!nprops->get_nameids) {
+		for (i = 0; i < count; i++) {
+			if (propIDs[i] < 0x8000 ||
+			    mapistore_namedprops_get_nameid(nprops, propIDs[i], nameids, &nameids[i]) != MAPISTORE_SUCCESS) {
+				nameids[i] = NULL;
+				retval = MAPISTORE_ERR_NOT_FOUND;
+			}
+		}
+		*nameidsp = nameids;
+		return retval;
+	}
+
+	local_mem_ctx = talloc_named(NULL, 0, "mapistore_namedprops_get_nameids");
+	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, nameids);
+	lookups = talloc_array(local_mem_ctx, struct namedprops_lookup, count);
+	MAPISTORE_RETVAL_IF(!lookups, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+	misses = talloc_array(local_mem_ctx, uint16_t, count);
+	MAPISTORE_RETVAL_IF(!misses, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+	/* the names found are allocated with the array */
+	bulk.nprops = nprops;
+	bulk.mem_ctx = nameids;
+	htable_init(&bulk.lookups, _lookup_by_id_rehash, NULL);
+
+	/* Step 1. Serve what we can from the cache */
+	for (i = 0; i < count; i++) {
+		if (propIDs[i] < 0x8000) continue;
+		entry = namedprops_cache_by_id(nprops, propIDs[i]);
+		if (entry) {
+			nameids[i] = namedprops_cache_copy_nameid(nameids, &entry->nameid);
+			if (!nameids[i]) {
+				retval = MAPISTORE_ERR_NO_MEMORY;
+				goto end;
+			}
+			continue;
+		}
+		lookups[nmisses].nameid = NULL;
+		lookups[nmisses].mapped_id = &propIDs[i];
+		lookups[nmisses].nameidp = &nameids[i];
+		if (!htable_add(&bulk.lookups, propIDs[i], &lookups[nmisses])) {
+			retval = MAPISTORE_ERR_NO_MEMORY;
+			goto end;
+		}
+		misses[nmisses++] = propIDs[i];
+	}
+
+	/* Step 2. Look all the misses up in the backend at once */
+	if (nmisses) {
+		retval = nprops->get_nameids(nprops, nmisses, misses, namedprops_bulk_nameid_fn, &bulk);
+		if (retval != MAPISTORE_SUCCESS) goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!nameids[i]) {
+			retval = MAPISTORE_ERR_NOT_FOUND;
+		}
+	}
+
+end:
+	htable_clear(&bulk.lookups);
+	talloc_free(local_mem_ctx);
+	if (retval != MAPISTORE_SUCCESS && retval != MAPISTORE_ERR_NOT_FOUND) {
+		talloc_free(nameids);
+		return retval;
+	}
+	*nameidsp = nameids;
+
+	return retval;
 }
 
 /**
@@ -186,8 +826,16 @@ _PUBLIC_ enum mapistore_error mapistore_namedprops_get_nameid_type(struct namedp
 	MAPISTORE_RETVAL_IF(propID < 0x8000, MAPISTORE_ERROR, NULL);
 	MAPISTORE_RETVAL_IF(!propTypeP, MAPISTORE_ERROR, NULL);
 
-	int ret = nprops->get_nameid_type(nprops, propID, propTypeP);
-	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
+	struct namedprops_cache_entry *entry = namedprops_cache_by_id(nprops, propID);
+	if (entry && entry->prop_type) {
+		*propTypeP = entry->prop_type;
+	} else {
+		int ret = nprops->get_nameid_type(nprops, propID, propTypeP);
+		MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
+		if (entry) {
+			entry->prop_type = *propTypeP;
+		}
+	}
 
 	switch (*propTypeP) {
 	case PT_UNSPECIFIED:
@@ -301,14 +949,38 @@ int mapistore_namedprops_prop_type_from_string(const char *prop_type_str)
 
 _PUBLIC_ enum mapistore_error mapistore_namedprops_transaction_start(struct namedprops_context *nprops)
 {
+	enum mapistore_error	retval;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	return nprops->transaction_start(nprops);
+	retval = nprops->transaction_start(nprops);
+	if (retval == MAPISTORE_SUCCESS) {
+		nprops->in_transaction = true;
+	}
+
+	return retval;
 }
 
 _PUBLIC_ enum mapistore_error mapistore_namedprops_transaction_commit(struct namedprops_context *nprops)
 {
+	enum mapistore_error		retval;
+	struct namedprops_cache		*cache;
+	struct namedprops_cache_entry	*entry;
+
 	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	return nprops->transaction_commit(nprops);
+	retval = nprops->transaction_commit(nprops);
+	nprops->in_transaction = false;
+
+	/* Publish the mappings created by the transaction */
+	cache = namedprops_cache_get(nprops);
+	while ((entry = nprops->pending) != NULL) {
+		if (retval == MAPISTORE_SUCCESS && cache) {
+			namedprops_cache_add(cache, &entry->nameid, entry->mapped_id, entry->prop_type);
+		}
+		DLIST_REMOVE(nprops->pending, entry);
+		talloc_free(entry);
+	}
+
+	return retval;
 }
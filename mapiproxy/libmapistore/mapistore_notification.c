@@ -28,29 +28,21 @@
 #include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
 #include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
 
-#if 0
-static int mapistore_subscription_destructor(void *data)
-{
-	struct mapistore_subscription	*subscription = (struct mapistore_subscription *) data;
-
-	DEBUG(0, ("#### DELETING SUBSCRIPTION ###\n"));
-
-	if (!data) return -1;
+static bool notification_matches_subscription(struct mapistore_notification *, struct mapistore_subscription *);
 
-	DEBUG(0, ("### 1. NotificationFlags = 0x%x\n", subscription->notification_types));
-	DEBUG(0, ("### 2. handle = 0x%x\n", subscription->handle));
+/**
+   \details Create a new subscription to mapistore notifications
 
-	if (subscription->mqueue != -1) {
-		if (mq_unlink(subscription->mqueue_name) == -1) {
-			perror("mq_unlink");
-		}
-		DEBUG(0, ("%s unlinked\n", subscription->mqueue_name));
-		talloc_free(subscription->mqueue_name);
-	}
-	return 0;
-}
-#endif
+   \param mem_ctx pointer to the memory context
+   \param mstore_ctx pointer to the mapistore context
+   \param username the name of the user the subscription belongs to
+   \param handle the handle of the subscription object
+   \param notification_types the events the subscription is interested in
+   \param notification_parameters pointer to the table or object
+   subscription parameters, depending on notification_types
 
+   \return Allocated subscription on success, otherwise NULL
+ */
 struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx, 
 							  struct mapistore_context *mstore_ctx,
 							  const char *username,
@@ -58,22 +50,17 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
                                                           uint16_t notification_types,
                                                           void *notification_parameters)
 {
-#if 0
-	int						ret;
-	struct mapistore_connection_info		c;
-	struct mapistore_mgmt_notif			n;
         struct mapistore_subscription			*new_subscription;
         struct mapistore_table_subscription_parameters	*table_parameters;
         struct mapistore_object_subscription_parameters *object_parameters;
-	unsigned int					prio;
-	struct mq_attr					attr;
-	DATA_BLOB					data;
+
+	if (!notification_parameters) return NULL;
 
         new_subscription = talloc_zero(mem_ctx, struct mapistore_subscription);
+	if (!new_subscription) return NULL;
+
         new_subscription->handle = handle;
         new_subscription->notification_types = notification_types;
-	new_subscription->mqueue = -1;
-	new_subscription->mqueue_name = NULL;
         if (notification_types == fnevTableModified) {
                 table_parameters = notification_parameters;
                 new_subscription->parameters.table_parameters = *table_parameters;
@@ -81,77 +68,40 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
         else {
                 object_parameters = notification_parameters;
                 new_subscription->parameters.object_parameters = *object_parameters;
-
-		/* NewMail POC: open newmail mail queue */
-		if (notification_types & fnevNewMail || notification_types & fnevObjectCreated) {
-			new_subscription->mqueue_name = talloc_asprintf((TALLOC_CTX *)new_subscription, 
-									MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
-			new_subscription->mqueue = mq_open(new_subscription->mqueue_name, 
-							   O_RDONLY|O_NONBLOCK|O_CREAT, 0777, NULL);
-			if (new_subscription->mqueue == -1) {
-				perror("mq_open");
-				talloc_free(new_subscription->mqueue_name);
-				return new_subscription;
-			}
-			
-			/* Empty queue since we only want to retrieve new data from now */
-			ret = mq_getattr(new_subscription->mqueue, &attr);
-			if (ret == -1) {
-				perror("mq_getattr");
-			} else {
-				data.data = talloc_size(mem_ctx, attr.mq_msgsize);
-				while ((data.length = mq_receive(new_subscription->mqueue, (char *)data.data,
-								 attr.mq_msgsize, &prio)) != -1) {
-					dump_data(0, data.data, data.length);
-					talloc_free(data.data);
-					data.data = talloc_size(mem_ctx, attr.mq_msgsize);
-				}
-				talloc_free(data.data);
-			}
-			
-			/* Set destructor on new_subscription as we want to unlink the queue upon release */
-			talloc_set_destructor((void *)new_subscription, (int (*)(void *))mapistore_subscription_destructor);
-			
-			/* Send notification to tell about newmail */
-			n.WholeStore = object_parameters->whole_store;
-			n.NotificationFlags = notification_types;
-			if (n.WholeStore == true) {
-				n.FolderID = 0;
-				n.MessageID = 0;
-				n.MAPIStoreURI = NULL;
-			} else {
-				n.FolderID = object_parameters->folder_id;
-				n.MessageID = object_parameters->object_id;
-				/* FIXME */
-				n.MAPIStoreURI = NULL;
-			}
-
-			c.username = (char *)username;
-			c.mstore_ctx = mstore_ctx;
-			
-			ret = mapistore_mgmt_interface_register_subscription(&c, &n);
-			DEBUG(0, ("[%s:%d]: registering notification: %d\n", __FUNCTION__, __LINE__, ret));
-		}
 	}
 
         return new_subscription;
-#endif
-
-	return NULL;
 }
 
+/**
+   \details Queue a notification on the mapistore context. If a
+   notification callback is set and one of the subscriptions of the
+   context matches the notification, the callback is invoked once the
+   notification is queued.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param object_type the type of the object the notification is about
+   \param event the notification event
+   \param parameters pointer to the table or object notification
+   parameters, depending on object_type
+ */
 _PUBLIC_ void mapistore_push_notification(struct mapistore_context *mstore_ctx, uint8_t object_type, enum mapistore_notification_type event, void *parameters)
 {
-#if 0
         struct mapistore_notification *new_notification;
         struct mapistore_notification_list *new_list;
         struct mapistore_table_notification_parameters *table_parameters;
         struct mapistore_object_notification_parameters *object_parameters;
+	struct mapistore_subscription_list *el;
 
-        if (!mstore_ctx) return;
+        if (!mstore_ctx || !parameters) return;
 
 	new_list = talloc_zero(mstore_ctx, struct mapistore_notification_list);
+	if (!new_list) return;
 	new_notification = talloc_zero(new_list, struct mapistore_notification);
+	if (!new_notification) {
+		talloc_free(new_list);
+		return;
+	}
 	new_list->notification = new_notification;
 	new_notification->object_type = object_type;
 	new_notification->event = event;
@@ -169,8 +119,198 @@ _PUBLIC_ void mapistore_push_notification(struct mapistore_context *mstore_ctx,
 						sizeof(enum MAPITAGS) * new_notification->parameters.object_parameters.tag_count);
 		}
 	}
-	DLIST_ADD_END(mstore_ctx->notifications, new_list, void);
-#endif
+	DLIST_ADD_END(mstore_ctx->notifications, new_list, struct mapistore_notification_list *);
+
+	if (!mstore_ctx->notification_callback) return;
+
+	for (el = mstore_ctx->subscriptions; el; el = el->next) {
+		if (el->subscription && notification_matches_subscription(new_notification, el->subscription)) {
+			mstore_ctx->notification_callback(mstore_ctx, mstore_ctx->notification_private_data);
+			return;
+		}
+	}
+}
+
+/**
+   \details Set the function called when a notification matching one of
+   the subscriptions of the mapistore context is queued. The callback
+   must not push notifications on the same context.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param callback the function to call, NULL to remove the callback
+   \param private_data generic pointer passed to the callback
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_set_notification_callback(struct mapistore_context *mstore_ctx,
+								  mapistore_notification_callback_t callback,
+								  void *private_data)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	mstore_ctx->notification_callback = callback;
+	mstore_ctx->notification_private_data = private_data;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Check whether one of the notifications queued on the
+   mapistore context matches one of its subscriptions
+
+   \param mstore_ctx pointer to the mapistore context
+
+   \return true if a matching notification is pending, otherwise false
+ */
+_PUBLIC_ bool mapistore_notification_pending(struct mapistore_context *mstore_ctx)
+{
+	struct mapistore_notification_list	*nel;
+	struct mapistore_subscription_list	*sel;
+
+	if (!mstore_ctx) return false;
+
+	for (nel = mstore_ctx->notifications; nel; nel = nel->next) {
+		for (sel = mstore_ctx->subscriptions; sel; sel = sel->next) {
+			if (sel->subscription && notification_matches_subscription(nel->notification, sel->subscription)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/**
+   \details Convert a notification sent by the mapistore management
+   interface on a user newmail queue into a mapistore notification
+ */
+static struct mapistore_notification_list *mapistore_notification_from_mgmt(TALLOC_CTX *mem_ctx, DATA_BLOB data)
+{
+	struct mapistore_notification_list		*nl;
+	struct mapistore_object_notification_parameters	*parameters;
+	struct mapistore_mgmt_command			command;
+	enum ndr_err_code				ndr_err;
+
+	ndr_err = ndr_pull_struct_blob(&data, mem_ctx, &command, (ndr_pull_flags_fn_t)ndr_pull_mapistore_mgmt_command);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		DEBUG(1, ("[%s:%d]: Invalid command received on newmail queue\n", __FUNCTION__, __LINE__));
+		return NULL;
+	}
+
+	if (command.type != MAPISTORE_MGMT_NOTIF || command.command.notification.status != MAPISTORE_MGMT_SEND) {
+		DEBUG(1, ("[%s:%d]: Unexpected command 0x%x received on newmail queue\n",
+			  __FUNCTION__, __LINE__, command.type));
+		return NULL;
+	}
+
+	nl = talloc_zero(mem_ctx, struct mapistore_notification_list);
+	if (!nl) return NULL;
+	nl->notification = talloc_zero(nl, struct mapistore_notification);
+	if (!nl->notification) {
+		talloc_free(nl);
+		return NULL;
+	}
+	parameters = &nl->notification->parameters.object_parameters;
+
+	/* See mapistore_mgmt_send_newmail_folder */
+	if (command.command.notification.NotificationFlags & mgmt_notification_type_Mbit) {
+		nl->notification->object_type = MAPISTORE_MESSAGE;
+		nl->notification->event = MAPISTORE_OBJECT_CREATED;
+		parameters->folder_id = command.command.notification.FolderID;
+		parameters->object_id = command.command.notification.MessageID;
+	} else if (command.command.notification.NotificationFlags & mgmt_notification_type_Tbit) {
+		nl->notification->object_type = MAPISTORE_FOLDER;
+		nl->notification->event = MAPISTORE_OBJECT_MODIFIED;
+		parameters->object_id = command.command.notification.FolderID;
+		parameters->new_message_count = true;
+		parameters->message_count = command.command.notification.TotalNumberOfMessages;
+	} else {
+		DEBUG(3, ("[%s:%d]: Unsupported notification type: 0x%x\n", __FUNCTION__, __LINE__,
+			  command.command.notification.NotificationFlags));
+		talloc_free(nl);
+		return NULL;
+	}
+
+	return nl;
+}
+
+/**
+   \details Open the newmail queue of a user for reading. The queue is
+   created if it does not exist yet, so the management interface can
+   deliver notifications to it.
+
+   \param username the name of the user
+
+   \return the queue descriptor on success, otherwise -1
+ */
+_PUBLIC_ mqd_t mapistore_notification_newmail_open(const char *username)
+{
+	char	*mqueue_name;
+	mqd_t	mqueue;
+
+	if (!username) return (mqd_t)-1;
+
+	mqueue_name = talloc_asprintf(NULL, MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
+	if (!mqueue_name) return (mqd_t)-1;
+
+	mqueue = mq_open(mqueue_name, O_RDONLY|O_NONBLOCK|O_CREAT, 0755, NULL);
+	if (mqueue == (mqd_t)-1) {
+		DEBUG(1, ("[%s:%d]: Unable to open %s: %s\n", __FUNCTION__, __LINE__, mqueue_name, strerror(errno)));
+	}
+	talloc_free(mqueue_name);
+
+	return mqueue;
+}
+
+/**
+   \details Receive the notifications waiting on a newmail queue opened
+   with mapistore_notification_newmail_open
+
+   \param mem_ctx pointer to the memory context
+   \param mqueue the newmail queue descriptor
+   \param nl pointer on pointer to the list of notifications to return
+
+   \return MAPISTORE_SUCCESS if notifications were received,
+   MAPISTORE_ERR_NOT_FOUND if there was none, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_notification_newmail_receive(TALLOC_CTX *mem_ctx, mqd_t mqueue,
+								     struct mapistore_notification_list **nl)
+{
+	struct mapistore_notification_list	*nlist = NULL;
+	struct mapistore_notification_list	*el;
+	struct mq_attr				attr;
+	DATA_BLOB				data;
+	ssize_t					len;
+	unsigned int				prio;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(mqueue == (mqd_t)-1, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!nl, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (mq_getattr(mqueue, &attr) == -1) {
+		perror("mq_getattr");
+		return MAPISTORE_ERR_MSG_RCV;
+	}
+
+	data.data = talloc_size(mem_ctx, attr.mq_msgsize);
+	MAPISTORE_RETVAL_IF(!data.data, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	while ((len = mq_receive(mqueue, (char *)data.data, attr.mq_msgsize, &prio)) != -1) {
+		data.length = len;
+		el = mapistore_notification_from_mgmt(mem_ctx, data);
+		if (el) {
+			DLIST_ADD_END(nlist, el, struct mapistore_notification_list *);
+		}
+	}
+	talloc_free(data.data);
+
+	if (errno != EAGAIN) {
+		perror("mq_receive");
+	}
+
+	*nl = nlist;
+	return nlist ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 }
 
 #if 0
@@ -419,7 +559,6 @@ _PUBLIC_ enum mapistore_error mapistore_get_queued_notifications(struct mapistor
 	return (found == false) ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
 }
 
-#if 0
 static bool notification_matches_subscription(struct mapistore_notification *notification, struct mapistore_subscription *subscription)
 {
         bool result;
@@ -474,7 +613,6 @@ static bool notification_matches_subscription(struct mapistore_notification *not
 
         return result;
 }
-#endif
 
 _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_context *mstore_ctx, uint32_t identifier, 
 							    uint16_t NotificationFlags)
@@ -505,23 +643,21 @@ _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_con
 
 _PUBLIC_ struct mapistore_subscription_list *mapistore_find_matching_subscriptions(struct mapistore_context *mstore_ctx, struct mapistore_notification *notification)
 {
-#if 0
         struct mapistore_subscription_list *matching_subscriptions, *new_element, *current_element;
 
-	if (!mstore_ctx) return NULL;
+	if (!mstore_ctx || !notification) return NULL;
 
         matching_subscriptions = NULL;
 
         current_element = mstore_ctx->subscriptions;
         while (current_element) {
-                if (notification_matches_subscription(notification, current_element->subscription)) {
+                if (current_element->subscription
+                    && notification_matches_subscription(notification, current_element->subscription)) {
                         new_element = talloc_memdup(mstore_ctx, current_element, sizeof(struct mapistore_subscription_list));
-                        DLIST_ADD_END(matching_subscriptions, new_element, void);
+                        DLIST_ADD_END(matching_subscriptions, new_element, struct mapistore_subscription_list *);
                 }
                 current_element = current_element->next;
         }
         
         return matching_subscriptions;
-#endif
-	return NULL;
 }
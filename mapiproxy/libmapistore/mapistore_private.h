@@ -24,6 +24,7 @@
 
 #include <talloc.h>
 #include "backends/namedprops_backend.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
 
 #ifndef	ISDOT
 #define ISDOT(path) ( \
@@ -66,25 +67,35 @@ struct id_mapping_context {
 
 
 /**
-   Free context identifier list
+   Context identifier allocator
 
-   This structure is a double chained list storing unused context
-   identifiers.
+   Context identifiers in use are stored as a bitmap: bit n of word
+   n / 32 is set when identifier n is in use. Identifier 0 is never
+   returned. The hint is the first word which may have a free bit.
  */
-struct context_id_list {
-	uint32_t		context_id;
-	struct context_id_list	*prev;
-	struct context_id_list	*next;
-};
-
+#define	MAPISTORE_CONTEXT_ID_BITS	32
 
 struct processing_context {
 	struct id_mapping_context	*mapping_ctx;
-	struct context_id_list		*free_ctx;
-	uint32_t			last_context_id;
+	uint32_t			*context_ids;
+	uint32_t			context_ids_size;
+	uint32_t			context_ids_hint;
 	uint64_t			dflt_start_id;
 };
 
+
+/**
+   Backend contexts lookup tables
+
+   contexts is indexed by context identifier, uri_ht indexes the
+   backend context list elements by URI.
+ */
+struct backend_context_index {
+	struct backend_context_list	**contexts;
+	uint32_t			size;
+	struct htable			uri_ht;
+};
+
 struct indexing_context_list {
 	struct indexing_context		*ctx;
 	struct indexing_context_list	*prev;
@@ -138,6 +149,10 @@ enum mapistore_error mapistore_backend_create_context(TALLOC_CTX *, struct mapis
 enum mapistore_error mapistore_backend_create_root_folder(const char *, enum mapistore_context_role, uint64_t, const char *, TALLOC_CTX *, char **);
 enum mapistore_error mapistore_backend_add_ref_count(struct backend_context *);
 enum mapistore_error mapistore_backend_delete_context(struct backend_context *);
+struct backend_context_index *mapistore_backend_index_init(TALLOC_CTX *);
+enum mapistore_error mapistore_backend_index_add(struct backend_context_index *, struct backend_context_list *);
+enum mapistore_error mapistore_backend_index_del(struct backend_context_index *, struct backend_context_list *);
+struct backend_context_list *mapistore_backend_index_get(struct backend_context_index *, uint32_t);
 enum mapistore_error mapistore_backend_get_path(struct backend_context *, TALLOC_CTX *, uint64_t, char **);
 
 enum mapistore_error mapistore_backend_folder_open_folder(struct backend_context *, void *, TALLOC_CTX *, uint64_t, void **);
@@ -172,6 +187,7 @@ enum mapistore_error mapistore_backend_table_set_columns(struct backend_context
 enum mapistore_error mapistore_backend_table_set_restrictions(struct backend_context *, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_backend_table_set_sort_order(struct backend_context *, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_backend_table_get_row(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***, uint32_t *);
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_backend_table_handle_destructor(struct backend_context *, void *, uint32_t);
 
@@ -23,6 +23,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 
 #include "mapistore.h"
@@ -173,40 +174,57 @@ enum mapistore_error mapistore_init_mapping_context(struct processing_context *p
 /**
    \details Return an unused or new context identifier
 
+   The lowest unused identifier is returned, the bitmap of identifiers
+   in use is extended when all of them are taken.
+
    \param pctx pointer to the processing context
    \param context_id pointer to the context identifier the function
    returns
 
-   \return a non zero context identifier on success, otherwise 0.
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
 enum mapistore_error mapistore_get_context_id(struct processing_context *pctx, uint32_t *context_id)
 {
-	struct context_id_list	*el;
+	uint32_t	*context_ids;
+	uint32_t	size;
+	uint32_t	i;
+	int		bit;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!pctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!context_id, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Step 1. The free context list doesn't exist yet */
-	if (!pctx->free_ctx) {
-		pctx->last_context_id++;
-		*context_id = pctx->last_context_id;
+	/* Step 1. Look for a word with a free bit */
+	for (i = pctx->context_ids_hint; i < pctx->context_ids_size; i++) {
+		if (pctx->context_ids[i] != 0xFFFFFFFF) break;
 	}
 
-	/* Step 2. We have a free list */
-	for (el = pctx->free_ctx; el; el = el->next) {
-		if (el->context_id) {
-			*context_id = el->context_id;
-			DLIST_REMOVE(pctx->free_ctx, el);
-			break;
+	/* Step 2. Extend the bitmap if all identifiers are in use */
+	if (i == pctx->context_ids_size) {
+		size = pctx->context_ids_size ? pctx->context_ids_size * 2 : 4;
+		context_ids = talloc_realloc(pctx, pctx->context_ids, uint32_t, size);
+		MAPISTORE_RETVAL_IF(!context_ids, MAPISTORE_ERR_NO_MEMORY, NULL);
+		memset(&context_ids[pctx->context_ids_size], 0, (size - pctx->context_ids_size) * sizeof (uint32_t));
+		if (!pctx->context_ids_size) {
+			/* 0 is not a valid context identifier */
+			context_ids[0] = 0x1;
 		}
+		pctx->context_ids = context_ids;
+		pctx->context_ids_size = size;
 	}
 
+	/* Step 3. Mark the lowest free identifier as used */
+	bit = ffs(~pctx->context_ids[i]) - 1;
+	pctx->context_ids[i] |= (1U << bit);
+	pctx->context_ids_hint = i;
+	*context_id = i * MAPISTORE_CONTEXT_ID_BITS + bit;
+
 	return MAPISTORE_SUCCESS;
 }
 
 
 /**
-   \details Add a context identifier to the list
+   \details Release a context identifier so it can be reused
 
    \param pctx pointer to the processing context
    \param context_id the identifier referencing the context to free
@@ -215,22 +233,22 @@ enum mapistore_error mapistore_get_context_id(struct processing_context *pctx, u
  */
 enum mapistore_error mapistore_free_context_id(struct processing_context *pctx, uint32_t context_id)
 {
-	struct context_id_list	*el;
+	uint32_t	i = context_id / MAPISTORE_CONTEXT_ID_BITS;
+	uint32_t	mask = 1U << (context_id % MAPISTORE_CONTEXT_ID_BITS);
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!pctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
-	/* Step 1. Ensure the list is not corrupted */
-	for (el = pctx->free_ctx; el; el = el->next) {
-		if (el->context_id == context_id) {
-			return MAPISTORE_ERR_CORRUPTED;
-		}
+	/* Step 1. Ensure the identifier is in use */
+	if (!context_id || i >= pctx->context_ids_size || !(pctx->context_ids[i] & mask)) {
+		return MAPISTORE_ERR_CORRUPTED;
 	}
 
-	/* Step 2. Create the element and add it to the list */
-	el = talloc_zero((TALLOC_CTX *)pctx, struct context_id_list);
-	el->context_id = context_id;
-	DLIST_ADD_END(pctx->free_ctx, el, struct context_id_list *);
+	/* Step 2. Release it */
+	pctx->context_ids[i] &= ~mask;
+	if (i < pctx->context_ids_hint) {
+		pctx->context_ids_hint = i;
+	}
 
 	return MAPISTORE_SUCCESS;
 }
@@ -73,56 +73,75 @@ static void mgmt_ipc_process_notif(struct mapistore_mgmt_context *mgmt_ctx,
 	talloc_free(ndr_pull);
 }
 
-#if 0
-static void mgmt_ipc_notif_handler(int signo, siginfo_t *info, void *unused)
+/**
+   \details Receive and process all the messages waiting on the IPC
+   queue. The queue is opened non-blocking, so this returns as soon as
+   it is empty.
+
+   \param mgmt_ctx pointer to the mapistore management context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_process_ipc(struct mapistore_mgmt_context *mgmt_ctx)
 {
-	struct mapistore_mgmt_context	*mgmt_ctx;
 	struct mq_attr			attr;
-	struct sigevent			se;
 	DATA_BLOB			data;
+	ssize_t				len;
 	unsigned int			prio;
 
-	mgmt_ctx = (struct mapistore_mgmt_context *)info->si_value.sival_ptr;
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
-	if (mq_getattr(mgmt_ctx->mq_ipc, &attr) != 0) {
+	if (mq_getattr(mgmt_ctx->mq_ipc, &attr) == -1) {
 		perror("mq_getattr");
-		return;
+		return MAPISTORE_ERR_MSG_RCV;
 	}
 
+	/* A single buffer is enough as messages are processed one at a time */
 	data.data = talloc_size(mgmt_ctx, attr.mq_msgsize);
-	data.length = mq_receive(mgmt_ctx->mq_ipc, (char *)data.data, attr.mq_msgsize, &prio);
-	if (data.length == -1) {
-		talloc_free(data.data);
-		perror("mq_receive");
-		return;
+	MAPISTORE_RETVAL_IF(!data.data, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	while ((len = mq_receive(mgmt_ctx->mq_ipc, (char *)data.data, attr.mq_msgsize, &prio)) != -1) {
+		data.length = len;
+		mgmt_ctx->stats.ipc_received++;
+		mgmt_ipc_process_notif(mgmt_ctx, data);
 	}
-	mgmt_ipc_process_notif(mgmt_ctx, data);
 	talloc_free(data.data);
 
-	/* Reset notification as it resets each time */
-	se.sigev_signo = info->si_signo;
-	se.sigev_value = info->si_value;
-	se.sigev_notify = SIGEV_SIGNAL;
-	if (mq_notify(mgmt_ctx->mq_ipc, &se) == -1) {
-		perror("mq_notify");
-		return;
+	if (errno != EAGAIN) {
+		perror("mq_receive");
+		return MAPISTORE_ERR_MSG_RCV;
 	}
 
-	data.data = talloc_size(mgmt_ctx, attr.mq_msgsize);
-	while ((data.length = mq_receive(mgmt_ctx->mq_ipc, (char *)data.data, attr.mq_msgsize, NULL)) != -1) {
-		if (data.length == -1) {
-			talloc_free(data.data);
-			return;
-		} else {
-			mgmt_ipc_process_notif(mgmt_ctx, data);
-			talloc_free(data.data);
-			data.data = talloc_size(mgmt_ctx, attr.mq_msgsize);
-		}
-	}
+	return MAPISTORE_SUCCESS;
+}
 
-	talloc_free(data.data);
+static void mgmt_ipc_fd_handler(struct tevent_context *ev, struct tevent_fd *fde,
+				uint16_t flags, void *private_data)
+{
+	struct mapistore_mgmt_context	*mgmt_ctx = (struct mapistore_mgmt_context *) private_data;
+
+	mapistore_mgmt_process_ipc(mgmt_ctx);
+}
+
+static void mgmt_ipc_timer_handler(struct tevent_context *ev, struct tevent_timer *te,
+				   struct timeval current_time, void *private_data)
+{
+	struct mapistore_mgmt_context	*mgmt_ctx = (struct mapistore_mgmt_context *) private_data;
+
+	/* The timer is released with the event */
+	mgmt_ctx->ipc_te = NULL;
+	mapistore_mgmt_process_ipc(mgmt_ctx);
+
+	mgmt_ctx->ipc_te = tevent_add_timer(ev, mgmt_ctx,
+					    timeval_current_ofs(MAPISTORE_MGMT_IPC_POLL_INTERVAL / 1000,
+								(MAPISTORE_MGMT_IPC_POLL_INTERVAL % 1000) * 1000),
+					    mgmt_ipc_timer_handler, mgmt_ctx);
+	if (!mgmt_ctx->ipc_te) {
+		DEBUG(0, ("[%s:%d]: Unable to schedule the next read of the IPC queue\n",
+			  __FUNCTION__, __LINE__));
+	}
 }
-#endif
 
 /**
    \details Initialize a mapistore manager context.
@@ -134,14 +153,6 @@ static void mgmt_ipc_notif_handler(int signo, siginfo_t *info, void *unused)
 _PUBLIC_ struct mapistore_mgmt_context *mapistore_mgmt_init(struct mapistore_context *mstore_ctx)
 {
 	struct mapistore_mgmt_context	*mgmt_ctx;
-	int				ret;
-	unsigned int			prio;
-	DATA_BLOB			data;
-	struct mq_attr			attr;
-/*
-	struct sigaction		sa;
-	struct sigevent			se;
-*/
 
 	if (!mstore_ctx) return NULL;
 
@@ -160,41 +171,13 @@ _PUBLIC_ struct mapistore_mgmt_context *mapistore_mgmt_init(struct mapistore_con
 		return NULL;
 	}
 
-	/* Setup asynchronous notification request on this message queue */
+	mgmt_ctx->newmail_max_pending = MAPISTORE_MGMT_NEWMAIL_MAX_PENDING;
+	mgmt_ctx->newmail_flush_delay = MAPISTORE_MGMT_NEWMAIL_FLUSH_DELAY;
 
-	/** TODO: fix signal handler before restoring this code
-	sa.sa_sigaction = mgmt_ipc_notif_handler;
-	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = SA_SIGINFO;
-	if (sigaction(SIGIO, &sa, NULL) == -1) {
-		perror("sigaction");
-		talloc_free(mgmt_ctx);
-		return NULL;
-	}
-	se.sigev_notify = SIGEV_SIGNAL;
-	se.sigev_signo = SIGIO;
-	se.sigev_value.sival_ptr = (void *) mgmt_ctx;
-	if (mq_notify(mgmt_ctx->mq_ipc, &se) == -1) {
-		perror("mq_notify");
-		talloc_free(mgmt_ctx);
-		return NULL;
-	}
-	*/
-
-	/* Empty queue since new notification only occurs flushed/empty queue */
-	ret = mq_getattr(mgmt_ctx->mq_ipc, &attr);
-	if (ret == -1) {
-		perror("mq_getattr");
-		return mgmt_ctx;
-	}
-	data.data = talloc_size(mgmt_ctx, attr.mq_msgsize);
-
-	while ((data.length = mq_receive(mgmt_ctx->mq_ipc, (char *)data.data, attr.mq_msgsize, &prio)) != -1) {
-		mgmt_ipc_process_notif(mgmt_ctx, data);
-		talloc_free(data.data);
-		data.data = talloc_size(mgmt_ctx, attr.mq_msgsize);
-	}
-	talloc_free(data.data);
+	/* Process the messages sent before we were started. Later
+	 * ones are processed when the caller attaches an event
+	 * context or calls mapistore_mgmt_process_ipc() */
+	mapistore_mgmt_process_ipc(mgmt_ctx);
 
 	return mgmt_ctx;
 }
@@ -214,6 +197,12 @@ _PUBLIC_ enum mapistore_error mapistore_mgmt_release(struct mapistore_mgmt_conte
 	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!mgmt_ctx->mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 
+	/* Do not lose the notifications still being coalesced */
+	mapistore_mgmt_flush_notifications(mgmt_ctx);
+	TALLOC_FREE(mgmt_ctx->flush_te);
+	TALLOC_FREE(mgmt_ctx->ipc_fde);
+	TALLOC_FREE(mgmt_ctx->ipc_te);
+
 	if (mq_close(mgmt_ctx->mq_ipc) == -1) {
 		perror("mq_close");
 		talloc_free(mgmt_ctx);
@@ -246,6 +235,81 @@ _PUBLIC_ enum mapistore_error mapistore_mgmt_set_verbosity(struct mapistore_mgmt
 	return MAPISTORE_SUCCESS;
 }
 
+/**
+   \details Serve the IPC queue from an event loop. Messages are then
+   processed as soon as the queue becomes readable and newmail
+   notifications are coalesced until the flush delay expires instead of
+   being sent immediately.
+
+   \param mgmt_ctx pointer to the mapistore management context
+   \param ev pointer to the event context, or NULL to stop serving the
+   queue from the current one
+
+   \note Message queue descriptors are file descriptors on Linux
+   only. Elsewhere, or if the descriptor cannot be watched, the queue
+   is read every MAPISTORE_MGMT_IPC_POLL_INTERVAL milliseconds.
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_set_event_context(struct mapistore_mgmt_context *mgmt_ctx,
+							       struct tevent_context *ev)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	/* Timers and fd events belong to the previous loop */
+	mapistore_mgmt_flush_notifications(mgmt_ctx);
+	TALLOC_FREE(mgmt_ctx->flush_te);
+	TALLOC_FREE(mgmt_ctx->ipc_fde);
+	TALLOC_FREE(mgmt_ctx->ipc_te);
+	mgmt_ctx->ev = NULL;
+
+	if (!ev) return MAPISTORE_SUCCESS;
+
+#ifdef __linux__
+	mgmt_ctx->ipc_fde = tevent_add_fd(ev, mgmt_ctx, (int)mgmt_ctx->mq_ipc, TEVENT_FD_READ,
+					  mgmt_ipc_fd_handler, mgmt_ctx);
+#endif
+	if (!mgmt_ctx->ipc_fde) {
+		DEBUG(3, ("[%s:%d]: IPC queue not pollable, reading it every %d msec\n",
+			  __FUNCTION__, __LINE__, MAPISTORE_MGMT_IPC_POLL_INTERVAL));
+		mgmt_ctx->ipc_te = tevent_add_timer(ev, mgmt_ctx,
+						    timeval_current_ofs(MAPISTORE_MGMT_IPC_POLL_INTERVAL / 1000,
+									(MAPISTORE_MGMT_IPC_POLL_INTERVAL % 1000) * 1000),
+						    mgmt_ipc_timer_handler, mgmt_ctx);
+		MAPISTORE_RETVAL_IF(!mgmt_ctx->ipc_te, MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+	mgmt_ctx->ev = ev;
+
+	/* Readiness is only reported for messages arriving from now */
+	return mapistore_mgmt_process_ipc(mgmt_ctx);
+}
+
+/**
+   \details Set how newmail notifications are queued
+
+   \param mgmt_ctx pointer to the mapistore management context
+   \param max_pending maximum number of user/folder notifications
+   waiting to be sent. Notifications above it are dropped.
+   \param flush_delay delay in milliseconds notifications for the same
+   user and folder are coalesced for, when an event context is set
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_set_newmail_limits(struct mapistore_mgmt_context *mgmt_ctx,
+								uint32_t max_pending,
+								uint32_t flush_delay)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!max_pending, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	mgmt_ctx->newmail_max_pending = max_pending;
+	mgmt_ctx->newmail_flush_delay = flush_delay;
+
+	return MAPISTORE_SUCCESS;
+}
+
 /**
    \details Check if the specified backend is registered in mapistore
 
@@ -610,101 +674,6 @@ _PUBLIC_ enum mapistore_error mapistore_mgmt_registered_folder_subscription(stru
 	return ((found == true) ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND);
 }
 
-#if 0
-static int mgmt_notification_registration_cmd(enum mapistore_mgmt_status status,
-					      unsigned msg_prio,
-					      struct mapistore_connection_info *conn_info,
-					      struct mapistore_mgmt_notif *notification)
-{
-	int				ret;
-	TALLOC_CTX			*mem_ctx;
-	DATA_BLOB			data;
-	struct mapistore_mgmt_command	cmd;
-	enum ndr_err_code		ndr_err;
-
-	/* Sanity checks */
-	MAPISTORE_RETVAL_IF(!conn_info, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(!conn_info->mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(!conn_info->username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(!notification, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
-	MAPISTORE_RETVAL_IF(notification->WholeStore == false && !notification->MAPIStoreURI,
-			    MAPISTORE_ERR_INVALID_PARAMETER, NULL);
-
-	/* TotalNumberOfMessages and UnreadNumberOfMessages are not initialized here, triggering a warning in valgrind */
-	memset(&cmd, 0, sizeof(struct mapistore_mgmt_command));
-	cmd.type = MAPISTORE_MGMT_NOTIF;
-	cmd.command.notification.status = status;
-	printf("NotificationFlags = 0x%x\n", notification->NotificationFlags);
-	cmd.command.notification.NotificationFlags = notification->NotificationFlags;
-	cmd.command.notification.username = conn_info->username;
-	cmd.command.notification.WholeStore = notification->WholeStore;
-	if (notification->WholeStore == false) {
-		cmd.command.notification.FolderID = notification->FolderID;
-		cmd.command.notification.MessageID = notification->MessageID;
-		cmd.command.notification.MAPIStoreURI = notification->MAPIStoreURI;
-	} else {
-		cmd.command.notification.FolderID = 0;
-		cmd.command.notification.MessageID = 0;
-		cmd.command.notification.MAPIStoreURI = NULL;
-	}
-
-	mem_ctx = talloc_new(NULL);
-	ndr_err = ndr_push_struct_blob(&data, mem_ctx, &cmd, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		DEBUG(0, ("! [%s:%d][%s]: Failed to push mapistore_mgmt_command into NDR blob\n", 
-			  __FILE__, __LINE__, __FUNCTION__));
-		talloc_free(mem_ctx);
-		return MAPISTORE_ERR_INVALID_DATA;
-	}
-
-	ret = mq_send(conn_info->mstore_ctx->mq_ipc, (const char *)data.data, data.length, msg_prio);
-	if (ret == -1) {
-		talloc_free(mem_ctx);
-		return MAPISTORE_ERR_MSG_SEND;
-	}
-
-	talloc_free(mem_ctx);
-	return MAPISTORE_SUCCESS;
-}
-#endif
-
-/**
-   \details Register a subscription for the given user
-
-   \param conn_info pointer to the connection information
-   \param notification pointer to the structure holding notification data
-
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
- */
-#if 0
-_PUBLIC_ enum mapistore_error mapistore_mgmt_interface_register_subscription(struct mapistore_connection_info *conn_info,
-									     struct mapistore_mgmt_notif *notification)
-{
-	return mgmt_notification_registration_cmd(MAPISTORE_MGMT_REGISTER,
-						  MAPISTORE_COMMAND_NOTIF_REGISTER_PRIO,
-						  conn_info, notification);
-}
-#endif
-
-/**
-   \details Unregister a subscription for the given user
-
-   \param conn_info pointer to the connection information
-   \param notification pointer to the structure holding notification data
-
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
- */
-#if 0
-_PUBLIC_ enum mapistore_error mapistore_mgmt_interface_unregister_subscription(struct mapistore_connection_info *conn_info,
-									       struct mapistore_mgmt_notif *notification)
-{
-	return mgmt_notification_registration_cmd(MAPISTORE_MGMT_UNREGISTER,
-						  MAPISTORE_COMMAND_NOTIF_UNREGISTER_PRIO,
-						  conn_info, notification);
-}
-#endif
-
-
 #if 0
 static enum mapistore_error mgmt_bind_registration_command(enum mapistore_mgmt_status status,
 							   unsigned msg_prio,
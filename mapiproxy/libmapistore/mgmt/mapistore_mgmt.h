@@ -30,6 +30,7 @@
 #include <signal.h>
 #include <stdbool.h>
 
+#include <tevent.h>
 #include <dlinklist.h>
 
 #include "gen_ndr/mapistore_mgmt.h"
@@ -37,6 +38,14 @@
 /* forward declaration */
 struct mapistore_context;
 
+/* Default maximum number of newmail notifications waiting to be sent */
+#define	MAPISTORE_MGMT_NEWMAIL_MAX_PENDING	1024
+/* Default delay in milliseconds newmail notifications are coalesced for */
+#define	MAPISTORE_MGMT_NEWMAIL_FLUSH_DELAY	100
+/* Delay in milliseconds between two reads of the IPC queue, when it
+   cannot be watched from the event loop */
+#define	MAPISTORE_MGMT_IPC_POLL_INTERVAL	500
+
 struct mapistore_mgmt_users_list {
 	uint32_t	count;
 	const char	**user;
@@ -69,11 +78,38 @@ struct mapistore_mgmt_users {
 	struct mapistore_mgmt_users		*next;
 };
 
+struct mapistore_mgmt_newmail {
+	const char			*username;
+	uint64_t			FolderID;
+	uint64_t			MessageID;
+	const char			*MAPIStoreURI;
+	uint32_t			count;
+	struct mapistore_mgmt_newmail	*prev;
+	struct mapistore_mgmt_newmail	*next;
+};
+
+struct mapistore_mgmt_stats {
+	uint64_t	ipc_received;
+	uint64_t	newmail_received;
+	uint64_t	newmail_coalesced;
+	uint64_t	newmail_dropped;
+	uint64_t	newmail_sent;
+};
+
 struct mapistore_mgmt_context {
 	struct mapistore_context	*mstore_ctx;
 	struct mapistore_mgmt_users	*users;
 	mqd_t				mq_ipc;
 	bool				verbose;
+	struct tevent_context		*ev;
+	struct tevent_fd		*ipc_fde;
+	struct tevent_timer		*ipc_te;
+	struct tevent_timer		*flush_te;
+	struct mapistore_mgmt_newmail	*newmail;
+	uint32_t			newmail_count;
+	uint32_t			newmail_max_pending;
+	uint32_t			newmail_flush_delay;
+	struct mapistore_mgmt_stats	stats;
 };
 
 #ifndef __BEGIN_DECLS
@@ -95,6 +131,9 @@ enum mapistore_error mapistore_mgmt_registered_backend(struct mapistore_mgmt_con
 struct mapistore_mgmt_users_list *mapistore_mgmt_existing_users(struct mapistore_mgmt_context *, void *, const char *, const char *, const char *);
 struct mapistore_mgmt_users_list *mapistore_mgmt_registered_users(struct mapistore_mgmt_context *, const char *, const char *);
 enum mapistore_error mapistore_mgmt_set_verbosity(struct mapistore_mgmt_context *, bool);
+enum mapistore_error mapistore_mgmt_set_event_context(struct mapistore_mgmt_context *, struct tevent_context *);
+enum mapistore_error mapistore_mgmt_set_newmail_limits(struct mapistore_mgmt_context *, uint32_t, uint32_t);
+enum mapistore_error mapistore_mgmt_process_ipc(struct mapistore_mgmt_context *);
 
 enum mapistore_error mapistore_mgmt_generate_uri(struct mapistore_mgmt_context *, const char *, const char *, const char *, const char *, const char *, char **);
 enum mapistore_error mapistore_mgmt_registered_message(struct mapistore_mgmt_context *, const char *, const char *, const char *,const char *, const char *, const char *);
@@ -109,6 +148,7 @@ enum mapistore_error mapistore_mgmt_message_bind_command(struct mapistore_mgmt_c
 /* definitions from mapistore_mgmt_send.c */
 enum mapistore_error mapistore_mgmt_send_newmail_notification(struct mapistore_mgmt_context *, const char *, uint64_t, uint64_t, const char *);
 enum mapistore_error mapistore_mgmt_send_udp_notification(struct mapistore_mgmt_context *, const char *);
+enum mapistore_error mapistore_mgmt_flush_notifications(struct mapistore_mgmt_context *);
 
 __END_DECLS
 
@@ -157,85 +157,43 @@ static enum mapistore_error mapistore_mgmt_push_send(TALLOC_CTX *mem_ctx, mqd_t
 	int			ret;
 
 	/* Sanity checks */
-	MAPISTORE_RETVAL_IF(!mqfd, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(mqfd == -1, MAPISTORE_ERR_NOT_FOUND, NULL);
 
 	/* Prepare DATA_BLOB with data pushed */
 	ndr_err = ndr_push_struct_blob(&data, mem_ctx, &cmd, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command);
 	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
 		DEBUG(0, ("! [%s:%d][%s]: Failed to push mapistore_mgmt_command into NDR blob\n",
 			  __FUNCTION__, __LINE__, __FUNCTION__));
-		mq_close(mqfd);
 		return MAPISTORE_ERR_INVALID_DATA;
 	}
 
-	/* Send the message */
+	/* Send the message, the queue is full when it fails with EAGAIN */
 	ret = mq_send(mqfd, (const char *)data.data, data.length, 0);
+	talloc_free(data.data);
 	if (ret == -1) {
-		printf("Notification Pushed with error: ret = %d\n", ret);
 		perror("mq_send");
-		mq_close(mqfd);
 		return MAPISTORE_ERR_MSG_SEND;
 	}
 
-	printf("Notification Pushed successfully: ret = %d\n", ret);
 	return MAPISTORE_SUCCESS;
 }
 
 
 /**
-   \details Send notifications 
+   \details Push the notifications a pending newmail stands for on the
+   user queue. The folder modified notification is only sent for
+   subscriptions registered with the management interface.
  */
-enum mapistore_error mapistore_mgmt_send_newmail_notification(struct mapistore_mgmt_context *mgmt_ctx,
-							      const char *username,
-							      uint64_t FolderID,
-							      uint64_t MessageID,
-							      const char *MAPIStoreURI)
+static enum mapistore_error mapistore_mgmt_send_newmail_folder(struct mapistore_mgmt_context *mgmt_ctx,
+							       TALLOC_CTX *mem_ctx, mqd_t mqfd,
+							       struct mapistore_mgmt_newmail *newmail)
 {
-	mqd_t					mqfd;
+	enum mapistore_error			retval = MAPISTORE_SUCCESS;
 	int					ret;
-	TALLOC_CTX				*mem_ctx;
 	struct mapistore_mgmt_command		cmd;
-	char					*queue;
-
-	/* Sanity checks */
-	printf("[%s:%d]: mapistore_mgmt_send_newmail_global_notification\n", __FUNCTION__, __LINE__);
-	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-	MAPISTORE_RETVAL_IF(!MAPIStoreURI, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_new(NULL);
-
-	/* Try to open the newmail queue for specified user */
-	queue = talloc_asprintf(mem_ctx, MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
-	mqfd = mq_open(queue, O_WRONLY|O_NONBLOCK);
-	if (mqfd == -1) {
-		ret = mapistore_mgmt_send_udp_notification(mgmt_ctx, username);
-		perror("mq_open");
-		talloc_free(mem_ctx);
-		return MAPISTORE_ERR_NOT_FOUND;
-	}
-
-	/* fnevNewmail subscription case */
-	ret = mapistore_mgmt_registered_folder_subscription(mgmt_ctx, username, NULL, 
-							    mgmt_notification_type_newmail);
-	/* if (ret == MAPISTORE_SUCCESS) { */
-	/* 	memset(&cmd, 0x0, sizeof (struct mapistore_mgmt_command)); */
-	/* 	cmd.type = MAPISTORE_MGMT_NOTIF; */
-	/* 	cmd.command.notification.status = MAPISTORE_MGMT_SEND; */
-	/* 	cmd.command.notification.NotificationFlags = mgmt_notification_type_newmail | mgmt_notification_type_Mbit; */
-	/* 	cmd.command.notification.username = username; */
-	/* 	cmd.command.notification.WholeStore = 0; */
-	/* 	cmd.command.notification.FolderID = FolderID; */
-	/* 	cmd.command.notification.MessageID = MessageID; */
-	/* 	cmd.command.notification.MAPIStoreURI = MAPIStoreURI; */
-	/* 	cmd.command.notification.TotalNumberOfMessages = 0; */
-	/* 	cmd.command.notification.UnreadNumberOfMessages = 0; */
-	/* 	mapistore_mgmt_push_send(mem_ctx, mqfd, cmd); */
-	/* 	printf("NEWMAIL notification sent on %s\n", queue); */
-	/* } */
 
 	/* fnevObjectModified subscription case (fntevTbit + fnevUbit) (0x3010) but only 0x10 looked up */
-	ret = mapistore_mgmt_registered_folder_subscription(mgmt_ctx, username, NULL,
+	ret = mapistore_mgmt_registered_folder_subscription(mgmt_ctx, newmail->username, NULL,
 							    mgmt_notification_type_objectmodified);
 	if (ret == MAPISTORE_SUCCESS) {
 		memset(&cmd, 0x0, sizeof (struct mapistore_mgmt_command));
@@ -244,55 +202,201 @@ enum mapistore_error mapistore_mgmt_send_newmail_notification(struct mapistore_m
 		cmd.command.notification.NotificationFlags = mgmt_notification_type_objectmodified | 
 			mgmt_notification_type_Tbit | mgmt_notification_type_Ubit;
 		cmd.command.notification.WholeStore = 0;
-		cmd.command.notification.FolderID = FolderID;
-		cmd.command.notification.MessageID = MessageID;
+		cmd.command.notification.FolderID = newmail->FolderID;
+		cmd.command.notification.MessageID = newmail->MessageID;
 		cmd.command.notification.MAPIStoreURI = NULL;
 		/* Calculate the total number of messages and unread messages */
 		cmd.command.notification.TotalNumberOfMessages = 4;
 		cmd.command.notification.UnreadNumberOfMessages = 1;
-		mapistore_mgmt_push_send(mgmt_ctx, mqfd, cmd);
-		printf("0x3010 notification sent on %s\n", queue);
+		if (mapistore_mgmt_push_send(mem_ctx, mqfd, cmd) != MAPISTORE_SUCCESS) {
+			retval = MAPISTORE_ERR_MSG_SEND;
+		}
+	}
 
+	/* fnevObjectCreated (0x8004). The queue only exists while
+	 * sessions of the user wait for notifications, and they match it
+	 * against their own subscriptions */
+	memset(&cmd, 0x0, sizeof (struct mapistore_mgmt_command));
+	cmd.type = MAPISTORE_MGMT_NOTIF;
+	cmd.command.notification.status = MAPISTORE_MGMT_SEND;
+	cmd.command.notification.NotificationFlags = mgmt_notification_type_objectcreated | mgmt_notification_type_Mbit;
+	cmd.command.notification.WholeStore = 0;
+	cmd.command.notification.FolderID = newmail->FolderID;
+	cmd.command.notification.MessageID = newmail->MessageID;
+	cmd.command.notification.MAPIStoreURI = newmail->MAPIStoreURI;
+	cmd.command.notification.TotalNumberOfMessages = 0;
+	cmd.command.notification.UnreadNumberOfMessages = 0;
+	if (mapistore_mgmt_push_send(mem_ctx, mqfd, cmd) != MAPISTORE_SUCCESS) {
+		retval = MAPISTORE_ERR_MSG_SEND;
 	}
 
-	/* fnevObjectCreated subscription case (0x8004) but only 0x4 looked up */
-	ret = mapistore_mgmt_registered_folder_subscription(mgmt_ctx, username, NULL,
-							    mgmt_notification_type_objectcreated);
-	if (ret == MAPISTORE_SUCCESS) {
-		memset(&cmd, 0x0, sizeof (struct mapistore_mgmt_command));
-		cmd.type = MAPISTORE_MGMT_NOTIF;
-		cmd.command.notification.status = MAPISTORE_MGMT_SEND;
-		cmd.command.notification.NotificationFlags = mgmt_notification_type_objectcreated | mgmt_notification_type_Mbit;
-		cmd.command.notification.WholeStore = 0;
-		cmd.command.notification.FolderID = FolderID;
-		cmd.command.notification.MessageID = MessageID;
-		cmd.command.notification.MAPIStoreURI = MAPIStoreURI;
-		cmd.command.notification.TotalNumberOfMessages = 0;
-		cmd.command.notification.UnreadNumberOfMessages = 0;
-		mapistore_mgmt_push_send(mgmt_ctx, mqfd, cmd);
-		printf("0x8004 notification sent on %s\n", queue);
+	return retval;
+}
+
+
+/**
+   \details Send all the pending newmail notifications. The user queue
+   is opened and the UDP notification sent once per user, whatever the
+   number of folders which received mails.
+
+   \param mgmt_ctx pointer to the mapistore management context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error. The
+   notifications which could not be queued are counted as dropped.
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_flush_notifications(struct mapistore_mgmt_context *mgmt_ctx)
+{
+	enum mapistore_error		retval = MAPISTORE_SUCCESS;
+	TALLOC_CTX			*mem_ctx;
+	struct mapistore_mgmt_newmail	*el;
+	struct mapistore_mgmt_newmail	*next;
+	mqd_t				mqfd;
+	char				*username;
+	char				*queue;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	TALLOC_FREE(mgmt_ctx->flush_te);
+
+	while (mgmt_ctx->newmail) {
+		mem_ctx = talloc_new(NULL);
+		MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+		username = talloc_strdup(mem_ctx, mgmt_ctx->newmail->username);
+		queue = talloc_asprintf(mem_ctx, MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
+		mqfd = mq_open(queue, O_WRONLY|O_NONBLOCK);
+		if (mqfd == -1) {
+			perror("mq_open");
+			retval = MAPISTORE_ERR_NOT_FOUND;
+		}
+
+		for (el = mgmt_ctx->newmail; el; el = next) {
+			next = el->next;
+			if (strcmp(el->username, username)) continue;
+
+			if (mqfd != -1 && mapistore_mgmt_send_newmail_folder(mgmt_ctx, mem_ctx, mqfd, el) == MAPISTORE_SUCCESS) {
+				mgmt_ctx->stats.newmail_sent++;
+			} else {
+				mgmt_ctx->stats.newmail_dropped++;
+				if (retval == MAPISTORE_SUCCESS) {
+					retval = MAPISTORE_ERR_MSG_SEND;
+				}
+			}
+
+			DLIST_REMOVE(mgmt_ctx->newmail, el);
+			mgmt_ctx->newmail_count--;
+			talloc_free(el);
+		}
+
+		if (mqfd != -1) {
+			mq_close(mqfd);
+		}
+
+		/* Send UDP notification */
+		mapistore_mgmt_send_udp_notification(mgmt_ctx, username);
+
+		talloc_free(mem_ctx);
 	}
 
-	/* fnevObjectModified (0x10) subscription case */
-	ret = mapistore_mgmt_registered_folder_subscription(mgmt_ctx, username, NULL,
-							    mgmt_notification_type_objectmodified);
-	if (ret == MAPISTORE_SUCCESS) {
-		memset(&cmd, 0x0, sizeof (struct mapistore_mgmt_command));
-		cmd.type = MAPISTORE_MGMT_NOTIF;
-		cmd.command.notification.status = MAPISTORE_MGMT_SEND;
-		cmd.command.notification.NotificationFlags = mgmt_notification_type_objectmodified;
-		cmd.command.notification.FolderID = FolderID;
-		cmd.command.notification.MessageID = MessageID;
-		cmd.command.notification.MAPIStoreURI = MAPIStoreURI;
-		cmd.command.notification.TotalNumberOfMessages = 0;
-		cmd.command.notification.UnreadNumberOfMessages = 0;
+	return retval;
+}
+
+static void mapistore_mgmt_flush_handler(struct tevent_context *ev, struct tevent_timer *te,
+					 struct timeval current_time, void *private_data)
+{
+	struct mapistore_mgmt_context	*mgmt_ctx = (struct mapistore_mgmt_context *) private_data;
+
+	/* The timer is released with the event */
+	mgmt_ctx->flush_te = NULL;
+	mapistore_mgmt_flush_notifications(mgmt_ctx);
+}
+
+
+/**
+   \details Queue a newmail notification for the specified user.
+
+   When the management context is served from an event loop, the
+   notifications for the same user and folder received within the flush
+   delay are coalesced into one carrying the last message. Otherwise it
+   is sent immediately.
+
+   \param mgmt_ctx pointer to the mapistore management context
+   \param username the openchange user to deliver the notification to
+   \param FolderID the identifier of the folder which received the newmail
+   \param MessageID the identifier of the received message
+   \param MAPIStoreURI the URI of the new message
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_mgmt_send_newmail_notification(struct mapistore_mgmt_context *mgmt_ctx,
+								       const char *username,
+								       uint64_t FolderID,
+								       uint64_t MessageID,
+								       const char *MAPIStoreURI)
+{
+	struct mapistore_mgmt_newmail	*el;
+	char				*uri;
+	uint32_t			delay;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mgmt_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!MAPIStoreURI, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	mgmt_ctx->stats.newmail_received++;
+
+	for (el = mgmt_ctx->newmail; el; el = el->next) {
+		if ((el->FolderID == FolderID) && !strcmp(el->username, username)) break;
 	}
 
-	/* Send UDP notification */
-	ret = mapistore_mgmt_send_udp_notification(mgmt_ctx, username);
-	printf("[%s:%d] mapistore_mgmt_send_udp_notification: %d\n", __FUNCTION__, __LINE__, ret);
+	if (el) {
+		/* The pending notification now stands for this message too */
+		uri = talloc_strdup(el, MAPIStoreURI);
+		MAPISTORE_RETVAL_IF(!uri, MAPISTORE_ERR_NO_MEMORY, NULL);
+		talloc_free(discard_const_p(char, el->MAPIStoreURI));
+		el->MAPIStoreURI = uri;
+		el->MessageID = MessageID;
+		el->count++;
+		mgmt_ctx->stats.newmail_coalesced++;
+	} else {
+		if (mgmt_ctx->newmail_count >= mgmt_ctx->newmail_max_pending) {
+			DEBUG(1, ("[%s:%d]: Dropping newmail notification for %s: %u notifications pending\n",
+				  __FUNCTION__, __LINE__, username, mgmt_ctx->newmail_count));
+			mgmt_ctx->stats.newmail_dropped++;
+			return MAPISTORE_ERR_MSG_SEND;
+		}
+
+		el = talloc_zero(mgmt_ctx, struct mapistore_mgmt_newmail);
+		MAPISTORE_RETVAL_IF(!el, MAPISTORE_ERR_NO_MEMORY, NULL);
+		el->username = talloc_strdup(el, username);
+		el->MAPIStoreURI = talloc_strdup(el, MAPIStoreURI);
+		if (!el->username || !el->MAPIStoreURI) {
+			talloc_free(el);
+			return MAPISTORE_ERR_NO_MEMORY;
+		}
+		el->FolderID = FolderID;
+		el->MessageID = MessageID;
+		el->count = 1;
+
+		DLIST_ADD_END(mgmt_ctx->newmail, el, struct mapistore_mgmt_newmail *);
+		mgmt_ctx->newmail_count++;
+	}
 
-	talloc_free(mem_ctx);
+	/* Nothing else will flush the notification without an event loop */
+	delay = mgmt_ctx->newmail_flush_delay;
+	if (!mgmt_ctx->ev || !delay) {
+		return mapistore_mgmt_flush_notifications(mgmt_ctx);
+	}
+
+	if (!mgmt_ctx->flush_te) {
+		mgmt_ctx->flush_te = tevent_add_timer(mgmt_ctx->ev, mgmt_ctx,
+						      timeval_current_ofs(delay / 1000, (delay % 1000) * 1000),
+						      mapistore_mgmt_flush_handler, mgmt_ctx);
+		if (!mgmt_ctx->flush_te) {
+			return mapistore_mgmt_flush_notifications(mgmt_ctx);
+		}
+	}
 
 	return MAPISTORE_SUCCESS;
 }
@@ -31,21 +31,17 @@
 #include "mapiproxy/libmapiproxy/fault_util.h"
 #include "mapiproxy/libmapiserver/libmapiserver.h"
 #include "dcesrv_exchange_emsmdb.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
 
 struct exchange_emsmdb_session		*emsmdb_session = NULL;
+static struct mpm_session_registry	*emsmdb_session_registry = NULL;
+static struct mpm_session_registry	*emsmdb_async_registry = NULL;
+static struct mapistore_mgmt_context	*emsmdb_mgmt_ctx = NULL;
 void					*openchange_db_ctx = NULL;
 
 static struct exchange_emsmdb_session *dcesrv_find_emsmdb_session(struct GUID *uuid)
 {
-	struct exchange_emsmdb_session	*session, *found_session = NULL;
-
-	for (session = emsmdb_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
-		}
-	}
-
-	return found_session;
+	return (struct exchange_emsmdb_session *) mpm_session_registry_find(emsmdb_session_registry, uuid);
 }
 
 /* FIXME: See _unbind below */
@@ -225,6 +221,7 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
 		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
 
 		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+		mpm_session_registry_add(emsmdb_session_registry, &session->uuid, session);
 	}
 
 	return MAPI_E_SUCCESS;
@@ -263,6 +260,7 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
                 if (session) {
                         ret = mpm_session_release(session->session);
                         if (ret == true) {
+                                mpm_session_registry_del(emsmdb_session_registry, &session->uuid);
                                 DLIST_REMOVE(emsmdb_session, session);
                                 DEBUG(5, ("[%s:%d]: Session found and released\n", 
                                           __FUNCTION__, __LINE__));
@@ -1554,6 +1552,46 @@ static bool clientVersionIsTooLow(const uint16_t rgwClientVersion[3])
 	}
 }
 
+/**
+   \details Serve the mapistore management IPC queue from the server
+   event loop, when dcerpc_mapiproxy:mgmt is enabled. The management
+   context is created once per server process, by the first connection.
+
+   \param dce_call pointer to the session context
+ */
+static void dcesrv_exchange_emsmdb_mgmt_start(struct dcesrv_call_state *dce_call)
+{
+	struct loadparm_context		*lp_ctx = dce_call->conn->dce_ctx->lp_ctx;
+	struct mapistore_context	*mstore_ctx;
+	struct mapistore_mgmt_context	*mgmt_ctx;
+
+	if (emsmdb_mgmt_ctx || !lpcfg_parm_bool(lp_ctx, NULL, "dcerpc_mapiproxy", "mgmt", false)) {
+		return;
+	}
+
+	mstore_ctx = mapistore_init(emsmdb_session, lp_ctx, NULL);
+	if (!mstore_ctx) {
+		DEBUG(0, ("[%s:%d]: MAPISTORE initialization failed\n", __FUNCTION__, __LINE__));
+		return;
+	}
+
+	mgmt_ctx = mapistore_mgmt_init(mstore_ctx);
+	if (!mgmt_ctx) {
+		DEBUG(0, ("[%s:%d]: MAPISTORE management initialization failed\n", __FUNCTION__, __LINE__));
+		mapistore_release(mstore_ctx);
+		return;
+	}
+
+	if (mapistore_mgmt_set_event_context(mgmt_ctx, dce_call->event_ctx) != MAPISTORE_SUCCESS) {
+		DEBUG(0, ("[%s:%d]: Unable to serve the MAPISTORE management queue\n", __FUNCTION__, __LINE__));
+		mapistore_mgmt_release(mgmt_ctx);
+		mapistore_release(mstore_ctx);
+		return;
+	}
+
+	emsmdb_mgmt_ctx = mgmt_ctx;
+}
+
 /**
    \details exchange_emsmdb EcDoConnectEx (0xA) function
 
@@ -1630,6 +1668,7 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 		r->out.result = MAPI_E_LOGON_FAILED;
 		goto failure;
 	}
+	dcesrv_exchange_emsmdb_mgmt_start(dce_call);
 
 	/* Step 2. Check if incoming user belongs to the Exchange organization */
 	if (emsmdbp_verify_user(dce_call, emsmdbp_ctx) == false) {
@@ -1733,11 +1772,278 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
 
 		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+		mpm_session_registry_add(emsmdb_session_registry, &session->uuid, session);
 	}
 
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Push a MAPI response as an extended buffer of an
+   EcDoRpcExt2 rgbOut buffer
+
+   The response is compressed unless the client opted out, the payload
+   is too small or compression does not save space. Otherwise it is
+   obfuscated if the client obfuscated its request.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param ndr_rgbOut pointer to the rgbOut buffer being built
+   \param mapi_response pointer to the MAPI response to push, released
+   by the function
+   \param pulFlags the pulFlags sent by the client
+   \param xormagic the RHEF_XorMagic flag of the client request header
+   \param last whether this is the last extended buffer of rgbOut
+ */
+static void dcesrv_EcDoRpcExt2_push_buffer(TALLOC_CTX *mem_ctx,
+					   struct emsmdbp_context *emsmdbp_ctx,
+					   struct ndr_push *ndr_rgbOut,
+					   struct mapi_response *mapi_response,
+					   uint32_t pulFlags,
+					   uint16_t xormagic,
+					   bool last)
+{
+	enum ndr_err_code		ndr_err;
+	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
+	struct ndr_push			*ndr_uncomp_rgbOut;
+	struct ndr_push			*ndr_comp_rgbOut;
+
+	/* Push MAPI response into a DATA blob */
+	ndr_uncomp_rgbOut = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_uncomp_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
+	talloc_free(mapi_response);
+
+	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
+	RPC_HEADER_EXT.Version = 0x0000;
+	RPC_HEADER_EXT.Flags = last ? RHEF_Last : 0;
+	RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbOut->offset;
+
+	/* Compress the response unless the client opted out or the
+	 * payload is too small to benefit from it */
+	ndr_comp_rgbOut = NULL;
+	if (!(pulFlags & pulFlags_NoCompression) && emsmdbp_ctx->compression_threshold &&
+	    (ndr_uncomp_rgbOut->offset >= emsmdbp_ctx->compression_threshold)) {
+		ndr_comp_rgbOut = ndr_push_init_ctx(mem_ctx);
+		ndr_set_flags(&ndr_comp_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
+		ndr_err = ndr_push_lzxpress_compress(ndr_comp_rgbOut, ndr_uncomp_rgbOut);
+		if ((ndr_err != NDR_ERR_SUCCESS) || (ndr_comp_rgbOut->offset >= ndr_uncomp_rgbOut->offset)) {
+			talloc_free(ndr_comp_rgbOut);
+			ndr_comp_rgbOut = NULL;
+		} else {
+			DEBUG(5, ("exchange_emsmdb: EcDoRpcExt2 response compressed from %d to %d bytes\n",
+				  ndr_uncomp_rgbOut->offset, ndr_comp_rgbOut->offset));
+			RPC_HEADER_EXT.Flags |= RHEF_Compressed;
+			talloc_free(ndr_uncomp_rgbOut);
+		}
+	}
+
+	/* Otherwise obfuscate content if applicable */
+	if (!ndr_comp_rgbOut) {
+		ndr_comp_rgbOut = ndr_uncomp_rgbOut;
+		RPC_HEADER_EXT.Flags |= (xormagic & RHEF_XorMagic);
+		if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
+			obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
+		}
+	}
+	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
+
+	/* Push the constructed blob */
+	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
+	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	talloc_free(ndr_comp_rgbOut);
+}
+
+/**
+   \details Return the number of bytes a RopReadStream request reads,
+   capped as EcDoRpc_RopReadStream does when MaximumByteCount is used
+ */
+static uint32_t dcesrv_EcDoRpcExt2_ReadStream_count(struct EcDoRpc_MAPI_REQ *mapi_req)
+{
+	uint32_t	ByteCount;
+
+	ByteCount = mapi_req->u.mapi_ReadStream.ByteCount;
+	if (ByteCount == 0xBABE) {
+		ByteCount = mapi_req->u.mapi_ReadStream.MaximumByteCount.value;
+		if (ByteCount > 0xFFF0) {
+			ByteCount = 0xFFF0;
+		}
+	}
+
+	return ByteCount;
+}
+
+/**
+   \details Check whether the ROP of an EcDoRpcExt2 request can be
+   executed again to fill a chained extended buffer
+
+   Only requests made of a single RopFastTransferSourceGetBuffer,
+   RopReadStream or RopQueryRows are repeated, and only while the
+   previous execution succeeded and left data to return.
+
+   \param mapi_request pointer to the MAPI request
+   \param mapi_response pointer to the MAPI response of the last
+   execution of the request
+
+   \return true if the request can be repeated, otherwise false
+ */
+static bool dcesrv_EcDoRpcExt2_chainable(struct mapi_request *mapi_request,
+					 struct mapi_response *mapi_response)
+{
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	struct EcDoRpc_MAPI_REPL	*mapi_repl;
+	uint32_t			ByteCount;
+
+	if (!mapi_request->mapi_req || !mapi_response->mapi_repl) return false;
+
+	mapi_req = &mapi_request->mapi_req[0];
+	mapi_repl = &mapi_response->mapi_repl[0];
+	if (!mapi_req->opnum || mapi_request->mapi_req[1].opnum) return false;
+	if ((mapi_repl->opnum != mapi_req->opnum) || (mapi_repl->error_code != MAPI_E_SUCCESS)) return false;
+
+	switch (mapi_req->opnum) {
+	case op_MAPI_FastTransferSourceGetBuffer:
+		return (mapi_repl->u.mapi_FastTransferSourceGetBuffer.TransferStatus == TransferStatus_Partial);
+	case op_MAPI_ReadStream:
+		/* A short read means the end of the stream was reached */
+		ByteCount = dcesrv_EcDoRpcExt2_ReadStream_count(mapi_req);
+		return (ByteCount && (mapi_repl->u.mapi_ReadStream.data.length >= ByteCount));
+	case op_MAPI_QueryRows:
+		if (mapi_req->u.mapi_QueryRows.QueryRowsFlags & TBL_NOADVANCE) return false;
+		return (mapi_req->u.mapi_QueryRows.RowCount &&
+			(mapi_repl->u.mapi_QueryRows.RowCount == mapi_req->u.mapi_QueryRows.RowCount));
+	default:
+		return false;
+	}
+}
+
+/**
+   \details Return the largest response the next execution of a
+   chained EcDoRpcExt2 request can produce
+
+   The size of the data returned by RopFastTransferSourceGetBuffer and
+   RopReadStream is bounded by the request, the rest of the response
+   is the same as the one of the previous execution.
+
+   \param mapi_request pointer to the MAPI request
+   \param mapi_response pointer to the MAPI response of the last
+   execution of the request
+
+   \return the size bound, or 0 if the response size cannot be
+   bounded from the request
+ */
+static uint32_t dcesrv_EcDoRpcExt2_next_size(struct mapi_request *mapi_request,
+					     struct mapi_response *mapi_response)
+{
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	struct EcDoRpc_MAPI_REPL	*mapi_repl;
+	uint32_t			BufferSize;
+
+	mapi_req = &mapi_request->mapi_req[0];
+	mapi_repl = &mapi_response->mapi_repl[0];
+
+	switch (mapi_req->opnum) {
+	case op_MAPI_FastTransferSourceGetBuffer:
+		BufferSize = mapi_req->u.mapi_FastTransferSourceGetBuffer.BufferSize;
+		if (BufferSize == 0xBABE) {
+			BufferSize = mapi_req->u.mapi_FastTransferSourceGetBuffer.MaximumBufferSize.MaximumBufferSize;
+		}
+		return mapi_response->mapi_len - mapi_repl->u.mapi_FastTransferSourceGetBuffer.TransferBuffer.length + BufferSize;
+	case op_MAPI_ReadStream:
+		return mapi_response->mapi_len - mapi_repl->u.mapi_ReadStream.data.length +
+			dcesrv_EcDoRpcExt2_ReadStream_count(mapi_req);
+	default:
+		return 0;
+	}
+}
+
+/**
+   \details Retrieve the table a RopQueryRows request is sent to
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param mapi_request pointer to the MAPI request
+
+   \return pointer to the table on success, otherwise NULL
+ */
+static struct emsmdbp_object_table *dcesrv_EcDoRpcExt2_table(struct emsmdbp_context *emsmdbp_ctx,
+							     struct mapi_request *mapi_request)
+{
+	struct mapi_handles	*rec;
+	struct emsmdbp_object	*object;
+	void			*data;
+
+	if (mapi_request->mapi_req[0].opnum != op_MAPI_QueryRows) return NULL;
+	if (mapi_handles_search(emsmdbp_ctx->handles_ctx,
+				mapi_request->handles[mapi_request->mapi_req[0].handle_idx], &rec)) return NULL;
+	if (mapi_handles_get_private_data(rec, &data)) return NULL;
+
+	object = (struct emsmdbp_object *) data;
+	if (!object || object->type != EMSMDBP_OBJECT_TABLE) return NULL;
+
+	return object->object.table;
+}
+
+/**
+   \details Execute an EcDoRpcExt2 request again to fill a chained
+   extended buffer, if its response fits in the room left in rgbOut
+
+   The request is only executed when the size of its response can be
+   bounded beforehand. QueryRows responses cannot: the rows are read
+   and the table cursor is moved back if they do not fit.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param mapi_request pointer to the MAPI request
+   \param mapi_response pointer to the MAPI response of the last
+   execution of the request
+   \param room number of bytes left in rgbOut
+
+   \return the MAPI response of the new execution, otherwise NULL
+ */
+static struct mapi_response *dcesrv_EcDoRpcExt2_chain(TALLOC_CTX *mem_ctx,
+						      struct emsmdbp_context *emsmdbp_ctx,
+						      struct mapi_request *mapi_request,
+						      struct mapi_response *mapi_response,
+						      uint32_t room)
+{
+	struct mapi_response		*next_response;
+	struct emsmdbp_object_table	*table = NULL;
+	uint32_t			next_size;
+	uint32_t			numerator = 0;
+
+	/* Room for the RPC_HEADER_EXT of the next extended buffer */
+	if (room <= 8) return NULL;
+	room -= 8;
+
+	if (!dcesrv_EcDoRpcExt2_chainable(mapi_request, mapi_response)) return NULL;
+
+	/* Pending notifications are returned with the next request: they
+	 * would make the size of a chained response unpredictable */
+	if (emsmdbp_ctx->mstore_ctx->notifications) return NULL;
+
+	next_size = dcesrv_EcDoRpcExt2_next_size(mapi_request, mapi_response);
+	if (next_size) {
+		if (next_size > room) return NULL;
+	} else {
+		table = dcesrv_EcDoRpcExt2_table(emsmdbp_ctx, mapi_request);
+		if (!table) return NULL;
+		numerator = table->numerator;
+	}
+
+	next_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi_request);
+	if (next_response && (next_response->mapi_len > room)) {
+		DEBUG(5, ("exchange_emsmdb: EcDoRpcExt2 chained response of %d bytes does not fit in %d bytes\n",
+			  next_response->mapi_len, room));
+		talloc_free(next_response);
+		next_response = NULL;
+		if (table) {
+			table->numerator = numerator;
+		}
+	}
+
+	return next_response;
+}
+
 /**
    \details exchange_emsmdb EcDoRpcExt2 (0xB) function
 
@@ -1756,13 +2062,14 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi2k7_request		mapi2k7_request;
 	struct mapi_response		*mapi_response;
-	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
+	struct mapi_response		*next_response;
 	struct ndr_pull			*ndr_pull = NULL;
-	struct ndr_push			*ndr_uncomp_rgbOut;
-	struct ndr_push			*ndr_comp_rgbOut;
 	struct ndr_push			*ndr_rgbOut;
 	uint32_t			pulFlags = 0x0;
 	uint32_t			pulTransTime = 0;
+	uint32_t			max_rgbOut = 0;
+	uint32_t			used = 0;
+	uint32_t			buffers = 0;
 	DATA_BLOB			rgbIn;
 
 	DEBUG(3, ("exchange_emsmdb: EcDoRpcExt2 (0xB)\n"));
@@ -1817,39 +2124,40 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 		return ecRpcFormat;
 	}
 
-	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request);
-	talloc_free(mapi2k7_request.mapi_request);
+	/* Chained extended buffers may fill rgbOut up to the size
+	 * requested by the client, within the configured limit */
+	if ((*r->in.pulFlags & pulFlags_Chain) && emsmdbp_ctx->chain_max_size) {
+		max_rgbOut = MIN(*r->in.pcbOut, emsmdbp_ctx->chain_max_size);
+	}
 
 	/* Fill EcDoRpcExt2 reply */
 	r->out.handle = r->in.handle;
 	*r->out.pulFlags = pulFlags;
 
-	/* Push MAPI response into a DATA blob */
-	ndr_uncomp_rgbOut = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_uncomp_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
-	talloc_free(mapi_response);
-
-	/* TODO: compress if requested */
-	ndr_comp_rgbOut = ndr_uncomp_rgbOut;
-
-	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_Last;
-	RPC_HEADER_EXT.Flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
-	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbOut->offset;
+	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
 
-	/* Obfuscate content if applicable*/
-	if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
-		obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
+	/* Process the request, then execute it again for each chained
+	 * extended buffer while its response fits in rgbOut */
+	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request);
+	while (mapi_response) {
+		next_response = NULL;
+		used += 8 + mapi_response->mapi_len;
+		if (used < max_rgbOut) {
+			next_response = dcesrv_EcDoRpcExt2_chain(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request,
+								 mapi_response, max_rgbOut - used);
+		}
+		dcesrv_EcDoRpcExt2_push_buffer(mem_ctx, emsmdbp_ctx, ndr_rgbOut, mapi_response, *r->in.pulFlags,
+					       mapi2k7_request.header.Flags, (next_response == NULL));
+		mapi_response = next_response;
+		buffers++;
 	}
+	talloc_free(mapi2k7_request.mapi_request);
 
-	/* Push the constructed blob */
-	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	if (buffers > 1) {
+		DEBUG(5, ("exchange_emsmdb: EcDoRpcExt2 response chained in %d buffers (%d bytes)\n",
+			  buffers, ndr_rgbOut->offset));
+	}
 
 	/* Push MAPI response into a DATA blob */
 	r->out.rgbOut = ndr_rgbOut->data;
@@ -1897,11 +2205,11 @@ static void dcesrv_EcUnknown0xD(struct dcesrv_call_state *dce_call,
 
 
 /**
-   \details exchange_emsmdb EcGetMoreRpc (0xe) function
+   \details exchange_emsmdb EcDoAsyncConnectEx (0xe) function
 
    \param dce_call pointer to the session context
    \param mem_ctx pointer to the memory context
-   \param r pointer to the EcDoAsyncConnectExt request data
+   \param r pointer to the EcDoAsyncConnectEx request data
 
    \return MAPI_E_SUCCESS on success
  */
@@ -1909,9 +2217,43 @@ static enum MAPISTATUS dcesrv_EcDoAsyncConnectEx(struct dcesrv_call_state *dce_c
 						 TALLOC_CTX *mem_ctx,
 						 struct EcDoAsyncConnectEx *r)
 {
-	DEBUG(3, ("exchange_emsmdb: EcDoAsyncConnectEx (0xe) not implemented\n"));
-	r->out.result = ecRejected;
-	DCESRV_FAULT(DCERPC_FAULT_OP_RNG_ERROR);
+	struct exchange_emsmdb_session	*session;
+	struct emsmdbp_context		*emsmdbp_ctx;
+
+	DEBUG(3, ("exchange_emsmdb: EcDoAsyncConnectEx (0xe)\n"));
+
+	r->out.async_handle->handle_type = 0;
+	r->out.async_handle->uuid = GUID_zero();
+
+	/* Step 0. Ensure incoming user is authenticated */
+	if (!dcesrv_call_authenticated(dce_call)) {
+		DEBUG(1, ("No challenge requested by client, cannot authenticate\n"));
+		r->out.result = MAPI_E_LOGON_FAILED;
+		return MAPI_E_LOGON_FAILED;
+	}
+
+	/* Step 1. Retrieve the emsmdbp_context from the session management system */
+	session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
+	if (!session) {
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+	emsmdbp_ctx = (struct emsmdbp_context *)session->session->private_data;
+
+	/* Step 2. Every async handle of the session shares its notifications */
+	if (!emsmdbp_ctx->async_ctx) {
+		emsmdbp_ctx->async_ctx = emsmdbp_async_init(emsmdbp_ctx->mem_ctx, emsmdbp_ctx->mstore_ctx,
+							    emsmdb_async_registry, emsmdbp_ctx->username,
+							    emsmdbp_ctx->async_wait_timeout);
+		if (!emsmdbp_ctx->async_ctx) {
+			r->out.result = MAPI_E_NOT_ENOUGH_RESOURCES;
+			return MAPI_E_NOT_ENOUGH_RESOURCES;
+		}
+	}
+
+	r->out.async_handle->handle_type = EXCHANGE_HANDLE_EMSMDB;
+	r->out.async_handle->uuid = emsmdbp_ctx->async_ctx->uuid;
+	r->out.result = MAPI_E_SUCCESS;
 
 	return MAPI_E_SUCCESS;
 }
@@ -1995,6 +2337,113 @@ static NTSTATUS dcesrv_exchange_emsmdb_dispatch(struct dcesrv_call_state *dce_ca
 }
 
 
+/**
+   \details Reply to a parked EcDoAsyncWaitEx call
+
+   \param private_data pointer to the call state
+   \param flags the pulFlagsOut value to reply with
+ */
+static void dcesrv_EcDoAsyncWaitEx_reply(void *private_data, uint32_t flags)
+{
+	struct dcesrv_call_state	*dce_call = (struct dcesrv_call_state *) private_data;
+	struct EcDoAsyncWaitEx		*r = (struct EcDoAsyncWaitEx *) dce_call->r;
+	NTSTATUS			status;
+
+	*r->out.pulFlagsOut = flags;
+	r->out.result = MAPI_E_SUCCESS;
+
+	status = dcesrv_reply(dce_call);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("exchange_async_emsmdb: EcDoAsyncWaitEx reply failed: %s\n", nt_errstr(status)));
+	}
+}
+
+
+/**
+   \details exchange_async_emsmdb EcDoAsyncWaitEx (0x0) function
+
+   The call is parked on the event loop until a notification matching
+   one of the session subscriptions is queued, or until the
+   dcerpc_mapiproxy:async_wait_timeout delay expires.
+
+   \param dce_call pointer to the session context
+   \param mem_ctx pointer to the memory context
+   \param r pointer to the EcDoAsyncWaitEx request data
+
+   \return MAPI_E_SUCCESS on success
+ */
+static enum MAPISTATUS dcesrv_EcDoAsyncWaitEx(struct dcesrv_call_state *dce_call,
+					      TALLOC_CTX *mem_ctx,
+					      struct EcDoAsyncWaitEx *r)
+{
+	enum MAPISTATUS		retval;
+	struct tevent_context	*ev = NULL;
+	bool			parked;
+
+	DEBUG(3, ("exchange_async_emsmdb: EcDoAsyncWaitEx (0x0)\n"));
+
+	*r->out.pulFlagsOut = 0;
+
+	/* Step 0. Ensure incoming user is authenticated */
+	if (!dcesrv_call_authenticated(dce_call)) {
+		DEBUG(1, ("No challenge requested by client, cannot authenticate\n"));
+		r->out.result = MAPI_E_LOGON_FAILED;
+		return MAPI_E_LOGON_FAILED;
+	}
+
+	/* Step 1. Park the call on the session the async handle was
+	 * created for, it is released with the connection. Reply
+	 * immediately if the call cannot be parked */
+	if (dce_call->state_flags & DCESRV_CALL_STATE_FLAG_MAY_ASYNC) {
+		ev = dce_call->event_ctx;
+	}
+	retval = emsmdbp_async_wait_handle(dce_call, emsmdb_async_registry, &r->in.async_handle->uuid, ev,
+					   dcesrv_EcDoAsyncWaitEx_reply, dce_call, r->out.pulFlagsOut, &parked);
+	r->out.result = retval;
+	if (retval == MAPI_E_SUCCESS && parked) {
+		dce_call->state_flags |= DCESRV_CALL_STATE_FLAG_ASYNC;
+	}
+
+	return retval;
+}
+
+
+/**
+   \details Dispatch incoming asynchronous EMSMDB call to the correct
+   OpenChange server function
+
+   \param dce_call pointer to the session context
+   \param mem_ctx pointer to the memory context
+   \param r generic pointer on asynchronous EMSMDB data
+   \param mapiproxy pointer to the mapiproxy structure controlling
+   mapiproxy behavior
+
+   \return NT_STATUS_OK;
+ */
+static NTSTATUS dcesrv_exchange_async_emsmdb_dispatch(struct dcesrv_call_state *dce_call,
+						      TALLOC_CTX *mem_ctx,
+						      void *r, struct mapiproxy *mapiproxy)
+{
+	const struct ndr_interface_table	*table;
+	uint16_t				opnum;
+
+	table = (const struct ndr_interface_table *) dce_call->context->iface->private_data;
+	opnum = dce_call->pkt.u.request.opnum;
+
+	/* Sanity checks */
+	if (!table) return NT_STATUS_UNSUCCESSFUL;
+	if (table->name && strcmp(table->name, NDR_EXCHANGE_ASYNC_EMSMDB_NAME)) return NT_STATUS_UNSUCCESSFUL;
+
+	switch (opnum) {
+	case NDR_ECDOASYNCWAITEX:
+		dcesrv_EcDoAsyncWaitEx(dce_call, mem_ctx, (struct EcDoAsyncWaitEx *)r);
+		break;
+	}
+
+	return NT_STATUS_OK;
+}
+
+
 /**
    \details Initialize the EMSMDB OpenChange server
 
@@ -2009,6 +2458,12 @@ static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 	if (!emsmdb_session) return NT_STATUS_NO_MEMORY;
 	emsmdb_session->session = NULL;
 
+	emsmdb_session_registry = mpm_session_registry_init(dce_ctx);
+	if (!emsmdb_session_registry) return NT_STATUS_NO_MEMORY;
+
+	emsmdb_async_registry = mpm_session_registry_init(dce_ctx);
+	if (!emsmdb_async_registry) return NT_STATUS_NO_MEMORY;
+
 	/* Open read/write context on OpenChange dispatcher database */
 	openchange_db_ctx = emsmdbp_openchangedb_init(dce_ctx->lp_ctx);
 	if (!openchange_db_ctx) {
@@ -2043,6 +2498,7 @@ static NTSTATUS dcesrv_exchange_emsmdb_unbind(struct server_id server_id, uint32
 	/* if (session) { */
 	/* 	ret = mpm_session_release(session->session); */
 	/* 	if (ret == true) { */
+	/* 		mpm_session_registry_del(emsmdb_session_registry, &session->uuid); */
 	/* 		DLIST_REMOVE(emsmdb_session, session); */
 	/* 		DEBUG(5, ("[%s:%d]: Session found and released\n",  */
 	/* 			  __FUNCTION__, __LINE__)); */
@@ -2087,5 +2543,19 @@ NTSTATUS samba_init_module(void)
 		return ret;
 	}
 
+	/* Asynchronous EMSMDB calls share the EMSMDB sessions */
+	server.name = "exchange_async_emsmdb";
+	server.description = "OpenChange asynchronous EMSMDB server";
+	server.endpoint = "exchange_async_emsmdb";
+	server.init = NULL;
+	server.unbind = NULL;
+	server.dispatch = dcesrv_exchange_async_emsmdb_dispatch;
+
+	ret = mapiproxy_server_register(&server);
+	if (!NT_STATUS_IS_OK(ret)) {
+		DEBUG(0, ("Failed to register the 'exchange_async_emsmdb' default mapiproxy server!\n"));
+		return ret;
+	}
+
 	return ret;
 }
@@ -56,6 +56,15 @@ struct emsmdbp_context {
 	struct ldb_context			*samdb_ctx;
 	struct mapistore_context		*mstore_ctx;
 	struct mapi_handles_context		*handles_ctx;
+	uint32_t				compression_threshold;
+	uint32_t				chain_max_size;
+	uint32_t				sync_min_chunk_size;
+	uint32_t				sync_max_chunk_size;
+	uint32_t				sync_chunk_time;
+	uint32_t				sync_min_preload;
+	uint32_t				sync_max_preload;
+	uint32_t				async_wait_timeout;
+	struct emsmdbp_async_context		*async_ctx;
 
 	TALLOC_CTX				*mem_ctx;
 };
@@ -73,6 +82,48 @@ struct emsmdbp_stream {
 	DATA_BLOB		buffer;
 };
 
+struct emsmdbp_cutmark {
+	uint32_t		min_value_size;
+	uint32_t		offset;
+};
+
+/* Offsets where a FastTransfer buffer may end, sorted by offset */
+struct emsmdbp_cutmarks {
+	struct emsmdbp_cutmark	*marks;
+	uint32_t		count;
+	uint32_t		size;
+	uint32_t		next;
+};
+
+typedef void (*emsmdbp_async_reply_fn_t)(void *, uint32_t);
+
+/* An EcDoAsyncWaitEx call parked until a notification or its timeout */
+struct emsmdbp_async_wait {
+	struct emsmdbp_async_context	*async_ctx;
+	struct tevent_timer		*te;
+	emsmdbp_async_reply_fn_t	reply_fn;
+	void				*private_data;
+	struct emsmdbp_async_wait	*prev;
+	struct emsmdbp_async_wait	*next;
+};
+
+/* Asynchronous notification state of an EMSMDB session */
+struct emsmdbp_async_context {
+	struct GUID			uuid;
+	char				*username;
+	struct mapistore_context	*mstore_ctx;
+	struct mpm_session_registry	*registry;
+	struct tevent_context		*ev;
+	struct tevent_immediate		*im;
+	mqd_t				mq_newmail;
+	struct tevent_fd		*newmail_fde;
+	uint32_t			timeout;
+	uint32_t			wait_count;
+	struct emsmdbp_async_wait	*waits;
+	struct emsmdbp_async_context	*prev;
+	struct emsmdbp_async_context	*next;
+};
+
 struct emsmdbp_syncconfigure_request {
 	bool is_collector;
 	bool contents_mode;
@@ -204,8 +255,30 @@ struct emsmdbp_object_synccontext {
 
 	/* download buffers */
 	struct emsmdbp_stream	stream;
-	uint32_t		*cutmarks;
-	uint32_t		next_cutmark_idx;
+	struct emsmdbp_cutmarks	*cutmarks;
+};
+
+struct emsmdbp_ftcontext_producer;
+
+typedef void (*emsmdbp_ftcontext_push_fn_t)(struct emsmdbp_ftcontext_producer *, struct emsmdbp_cutmarks *, uint32_t);
+
+/* Properties still to be serialized by a FastTransfer download. Only
+ * a window of the stream slightly larger than the client buffer is
+ * kept in memory */
+struct emsmdbp_ftcontext_producer {
+	uint32_t			count;
+	uint32_t			next_property;
+	size_t				estimated_length;
+	emsmdbp_ftcontext_push_fn_t	push_property;
+	void				*private_data;
+
+	/* remainder of a large value being copied */
+	TALLOC_CTX			*pending_ctx;
+	const uint8_t			*pending_data;
+	uint32_t			pending_length;
+	uint32_t			pending_min_value_size;
+
+	struct ndr_push			*ndr;
 };
 
 struct emsmdbp_object_ftcontext {
@@ -213,8 +286,9 @@ struct emsmdbp_object_ftcontext {
 	uint16_t		total_steps;
 
 	struct emsmdbp_stream	stream;
-	uint32_t		*cutmarks;
-	uint32_t		next_cutmark_idx;
+	struct emsmdbp_cutmarks	*cutmarks;
+
+	struct emsmdbp_ftcontext_producer	*producer;
 };
 
 union emsmdbp_objects {
@@ -242,6 +316,9 @@ struct emsmdbp_object {
 #define	EMSMDB_PCRETRY			6
 #define	EMSMDB_PCRETRYDELAY		10000
 
+/* EcDoAsyncWaitEx pulFlagsOut */
+#define	EMSMDB_ASYNC_NOTIFICATION_PENDING	0x00000001
+
 enum emsmdbp_mailbox_systemidx {
 	EMSMDBP_MAILBOX_ROOT = 1,
 	EMSMDBP_DEFERRED_ACTION,
@@ -319,6 +396,26 @@ int		      emsmdbp_get_uri_from_fid(TALLOC_CTX *, struct emsmdbp_context *, uint
 int		      emsmdbp_get_fid_from_uri(struct emsmdbp_context *, const char *, uint64_t *);
 uint32_t	      emsmdbp_get_contextID(struct emsmdbp_object *);
 
+/* definitions from emsmdbp_cutmarks.c */
+struct emsmdbp_cutmarks	*emsmdbp_cutmarks_init(TALLOC_CTX *);
+bool			emsmdbp_cutmarks_push(struct emsmdbp_cutmarks *, uint32_t, uint32_t);
+void			emsmdbp_cutmarks_pop(struct emsmdbp_cutmarks *);
+void			emsmdbp_cutmarks_rebase(struct emsmdbp_cutmarks *, uint32_t);
+uint32_t		emsmdbp_cutmarks_lookup(struct emsmdbp_cutmarks *, uint32_t);
+uint32_t		emsmdbp_cutmarks_next_buffer_size(struct emsmdbp_cutmarks *, uint32_t, uint32_t);
+
+/* definitions from emsmdbp_ftcontext.c */
+struct emsmdbp_ftcontext_producer	*emsmdbp_ftcontext_producer_init(TALLOC_CTX *, uint32_t, emsmdbp_ftcontext_push_fn_t, void *);
+bool					emsmdbp_ftcontext_producer_push_value(struct emsmdbp_ftcontext_producer *, struct emsmdbp_cutmarks *, TALLOC_CTX *, DATA_BLOB, uint32_t);
+void					emsmdbp_ftcontext_producer_fill(struct emsmdbp_object_ftcontext *, uint32_t);
+
+/* definitions from emsmdbp_async.c */
+struct emsmdbp_async_context	*emsmdbp_async_init(TALLOC_CTX *, struct mapistore_context *, struct mpm_session_registry *, const char *, uint32_t);
+struct emsmdbp_async_wait	*emsmdbp_async_wait(TALLOC_CTX *, struct emsmdbp_async_context *, struct tevent_context *, emsmdbp_async_reply_fn_t, void *);
+enum MAPISTATUS			emsmdbp_async_wait_handle(TALLOC_CTX *, struct mpm_session_registry *, struct GUID *, struct tevent_context *, emsmdbp_async_reply_fn_t, void *, uint32_t *, bool *);
+void				emsmdbp_async_complete(struct emsmdbp_async_context *, uint32_t);
+void				emsmdbp_async_push_notification(struct mapistore_context *, const char *, uint8_t, enum mapistore_notification_type, void *);
+
 /* definitions from emsmdbp_provisioning.c */
 enum MAPISTATUS       emsmdbp_mailbox_provision(struct emsmdbp_context *, const char *);
 enum MAPISTATUS       emsmdbp_mailbox_provision_public_freebusy(struct emsmdbp_context *, const char *);
@@ -344,6 +441,7 @@ struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *, struct emsmdbp_ob
 struct emsmdbp_object *emsmdbp_object_table_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_table_get_available_properties(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, struct SPropTagArray **);
 void **emsmdbp_object_table_get_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, enum mapistore_query_type, enum MAPISTATUS **);
+void ***emsmdbp_object_table_get_rows_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, uint32_t, enum mapistore_query_type, enum MAPISTATUS ***, uint32_t *);
 struct emsmdbp_object *emsmdbp_object_message_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum mapistore_error emsmdbp_object_message_open(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint64_t, bool, struct emsmdbp_object **, struct mapistore_message **);
 struct emsmdbp_object *emsmdbp_object_message_open_attachment_table(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
@@ -84,6 +84,34 @@ static int emsmdbp_mapi_handles_destructor(void *data)
 	return (retval == MAPI_E_SUCCESS) ? 0 : -1;
 }
 
+/**
+   \details Retrieve a non-negative dcerpc_mapiproxy parametric option
+
+   Negative values would wrap to huge unsigned values once stored, so
+   they are rejected and the default value is used instead.
+
+   \param lp_ctx pointer to the loadparm context
+   \param option name of the parametric option
+   \param default_v value to use when the option is unset or invalid
+
+   \return the option value
+ */
+static uint32_t emsmdbp_parm_uint(struct loadparm_context *lp_ctx,
+				  const char *option,
+				  uint32_t default_v)
+{
+	int	value;
+
+	value = lpcfg_parm_int(lp_ctx, NULL, "dcerpc_mapiproxy", option, default_v);
+	if (value < 0) {
+		DEBUG(0, ("[%s:%d]: invalid negative value %d for dcerpc_mapiproxy:%s, using %u\n",
+			  __FUNCTION__, __LINE__, value, option, default_v));
+		return default_v;
+	}
+
+	return value;
+}
+
 /**
    \details Initialize the EMSMDBP context and open connections to
    Samba databases.
@@ -128,6 +156,28 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 	/* Save a pointer to the loadparm context */
 	emsmdbp_ctx->lp_ctx = lp_ctx;
 
+	/* Responses smaller than this threshold are not worth compressing */
+	emsmdbp_ctx->compression_threshold = emsmdbp_parm_uint(lp_ctx, "compression_threshold", 1024);
+
+	/* Largest rgbOut buffer filled with chained extended buffers */
+	emsmdbp_ctx->chain_max_size = emsmdbp_parm_uint(lp_ctx, "chain_max_size", 262144);
+
+	/* Bounds of the adaptive ICS contents synchronization chunks */
+	emsmdbp_ctx->sync_min_chunk_size = emsmdbp_parm_uint(lp_ctx, "sync_min_chunk_size", 65536);
+	emsmdbp_ctx->sync_max_chunk_size = emsmdbp_parm_uint(lp_ctx, "sync_max_chunk_size", 4194304);
+	emsmdbp_ctx->sync_chunk_time = emsmdbp_parm_uint(lp_ctx, "sync_chunk_time", 1000);
+	emsmdbp_ctx->sync_min_preload = emsmdbp_parm_uint(lp_ctx, "sync_min_preload", 16);
+	emsmdbp_ctx->sync_max_preload = emsmdbp_parm_uint(lp_ctx, "sync_max_preload", 1000);
+	if (emsmdbp_ctx->sync_max_chunk_size && emsmdbp_ctx->sync_max_chunk_size < emsmdbp_ctx->sync_min_chunk_size) {
+		emsmdbp_ctx->sync_max_chunk_size = emsmdbp_ctx->sync_min_chunk_size;
+	}
+	if (emsmdbp_ctx->sync_max_preload && emsmdbp_ctx->sync_max_preload < emsmdbp_ctx->sync_min_preload) {
+		emsmdbp_ctx->sync_max_preload = emsmdbp_ctx->sync_min_preload;
+	}
+
+	/* Seconds an EcDoAsyncWaitEx call stays parked without notification */
+	emsmdbp_ctx->async_wait_timeout = emsmdbp_parm_uint(lp_ctx, "async_wait_timeout", 300);
+
 	/* Retrieve samdb url (local or external) */
 	samdb_url = lpcfg_parm_string(lp_ctx, NULL, "dcerpc_mapiproxy", "samdb_url");
 
@@ -0,0 +1,390 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_async.c
+
+   \brief Parked EcDoAsyncWaitEx calls of an EMSMDB session
+
+   A wait only holds a timer on the event loop while it is parked. It
+   is completed with EMSMDB_ASYNC_NOTIFICATION_PENDING as soon as a
+   notification matching one of the session subscriptions is queued on
+   the session mapistore context, or with no flag when its timeout
+   expires so the client issues a new one.
+
+   Changes made from another session of the mailbox owner and newmail
+   notifications received on the owner newmail queue are queued on
+   every session of the owner, so they complete its parked waits.
+ */
+
+#include "dcesrv_exchange_emsmdb.h"
+
+/* Sessions of the process having asynchronous notifications enabled */
+static struct emsmdbp_async_context	*emsmdbp_async_sessions = NULL;
+
+/**
+   \details Detach a wait from its session and call its reply
+   function. The wait must not be used once this function returns, as
+   the reply function may release it.
+ */
+static void emsmdbp_async_wait_reply(struct emsmdbp_async_wait *wait, uint32_t flags)
+{
+	struct emsmdbp_async_context	*async_ctx = wait->async_ctx;
+
+	DLIST_REMOVE(async_ctx->waits, wait);
+	async_ctx->wait_count--;
+	talloc_set_destructor(wait, NULL);
+	TALLOC_FREE(wait->te);
+
+	wait->reply_fn(wait->private_data, flags);
+}
+
+static int emsmdbp_async_wait_destructor(struct emsmdbp_async_wait *wait)
+{
+	DLIST_REMOVE(wait->async_ctx->waits, wait);
+	wait->async_ctx->wait_count--;
+
+	return 0;
+}
+
+static void emsmdbp_async_wait_timeout(struct tevent_context *ev, struct tevent_timer *te,
+				       struct timeval current_time, void *private_data)
+{
+	struct emsmdbp_async_wait	*wait = (struct emsmdbp_async_wait *) private_data;
+
+	/* The timer is released with the event */
+	wait->te = NULL;
+	emsmdbp_async_wait_reply(wait, 0);
+}
+
+static void emsmdbp_async_immediate(struct tevent_context *ev, struct tevent_immediate *im,
+				    void *private_data)
+{
+	struct emsmdbp_async_context	*async_ctx = (struct emsmdbp_async_context *) private_data;
+
+	if (mapistore_notification_pending(async_ctx->mstore_ctx)) {
+		emsmdbp_async_complete(async_ctx, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+	}
+}
+
+/**
+   \details Complete the parked waits from the event loop rather than
+   from the mapistore backend pushing the notification
+ */
+static void emsmdbp_async_schedule(struct emsmdbp_async_context *async_ctx)
+{
+	if (!async_ctx->waits || !async_ctx->ev) return;
+
+	if (!async_ctx->im) {
+		async_ctx->im = tevent_create_immediate(async_ctx);
+		if (!async_ctx->im) return;
+	}
+	tevent_schedule_immediate(async_ctx->im, async_ctx->ev, emsmdbp_async_immediate, async_ctx);
+}
+
+static void emsmdbp_async_notification(struct mapistore_context *mstore_ctx, void *private_data)
+{
+	emsmdbp_async_schedule((struct emsmdbp_async_context *) private_data);
+}
+
+static void emsmdbp_async_newmail_handler(struct tevent_context *ev, struct tevent_fd *fde,
+					  uint16_t flags, void *private_data)
+{
+	struct emsmdbp_async_context		*async_ctx = (struct emsmdbp_async_context *) private_data;
+	struct mapistore_notification_list	*nl = NULL;
+	struct mapistore_notification_list	*el;
+	TALLOC_CTX				*mem_ctx;
+
+	mem_ctx = talloc_new(async_ctx);
+	if (!mem_ctx) return;
+
+	if (mapistore_notification_newmail_receive(mem_ctx, async_ctx->mq_newmail, &nl) == MAPISTORE_SUCCESS) {
+		for (el = nl; el; el = el->next) {
+			emsmdbp_async_push_notification(NULL, async_ctx->username, el->notification->object_type,
+							el->notification->event,
+							&el->notification->parameters.object_parameters);
+		}
+	}
+	talloc_free(mem_ctx);
+}
+
+/**
+   \details Receive the owner newmail notifications from the event loop
+   the session waits are served from
+
+   \note Message queue descriptors are file descriptors on Linux only
+ */
+static void emsmdbp_async_newmail_listen(struct emsmdbp_async_context *async_ctx)
+{
+#ifdef __linux__
+	if (async_ctx->newmail_fde) return;
+
+	if (async_ctx->mq_newmail == (mqd_t)-1) {
+		async_ctx->mq_newmail = mapistore_notification_newmail_open(async_ctx->username);
+		if (async_ctx->mq_newmail == (mqd_t)-1) return;
+	}
+
+	async_ctx->newmail_fde = tevent_add_fd(async_ctx->ev, async_ctx, (int)async_ctx->mq_newmail,
+					       TEVENT_FD_READ, emsmdbp_async_newmail_handler, async_ctx);
+	if (!async_ctx->newmail_fde) return;
+
+	/* Deliver what was queued before the session listened */
+	emsmdbp_async_newmail_handler(async_ctx->ev, async_ctx->newmail_fde, TEVENT_FD_READ, async_ctx);
+#endif
+}
+
+static int emsmdbp_async_destructor(struct emsmdbp_async_context *async_ctx)
+{
+	DLIST_REMOVE(emsmdbp_async_sessions, async_ctx);
+	TALLOC_FREE(async_ctx->newmail_fde);
+	if (async_ctx->mq_newmail != (mqd_t)-1) {
+		mq_close(async_ctx->mq_newmail);
+	}
+	mpm_session_registry_del(async_ctx->registry, &async_ctx->uuid);
+
+	/* Let clients issue a new wait rather than leave them hanging */
+	emsmdbp_async_complete(async_ctx, 0);
+	mapistore_set_notification_callback(async_ctx->mstore_ctx, NULL, NULL);
+
+	return 0;
+}
+
+/**
+   \details Initialize the asynchronous notification state of a
+   session, register it on the session mapistore context and add it to
+   the registry under the GUID of the async handle returned to the
+   client
+
+   \param mem_ctx pointer to the memory context. It must be released
+   before the mapistore context.
+   \param mstore_ctx pointer to the session mapistore context
+   \param registry pointer to the registry of async handles
+   \param username the name of the user the session is opened for
+   \param timeout number of seconds after which a parked wait is
+   completed without notification
+
+   \return Allocated context on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_async_context *emsmdbp_async_init(TALLOC_CTX *mem_ctx,
+							   struct mapistore_context *mstore_ctx,
+							   struct mpm_session_registry *registry,
+							   const char *username,
+							   uint32_t timeout)
+{
+	struct emsmdbp_async_context	*async_ctx;
+
+	/* Sanity checks */
+	if (!mstore_ctx || !registry || !username) return NULL;
+
+	async_ctx = talloc_zero(mem_ctx, struct emsmdbp_async_context);
+	if (!async_ctx) return NULL;
+
+	async_ctx->uuid = GUID_random();
+	async_ctx->username = talloc_strdup(async_ctx, username);
+	async_ctx->mstore_ctx = mstore_ctx;
+	async_ctx->registry = registry;
+	async_ctx->mq_newmail = (mqd_t)-1;
+	async_ctx->timeout = timeout;
+	if (!async_ctx->username) {
+		talloc_free(async_ctx);
+		return NULL;
+	}
+
+	if (mpm_session_registry_add(registry, &async_ctx->uuid, async_ctx) == false) {
+		talloc_free(async_ctx);
+		return NULL;
+	}
+
+	if (mapistore_set_notification_callback(mstore_ctx, emsmdbp_async_notification, async_ctx) != MAPISTORE_SUCCESS) {
+		mpm_session_registry_del(registry, &async_ctx->uuid);
+		talloc_free(async_ctx);
+		return NULL;
+	}
+	DLIST_ADD(emsmdbp_async_sessions, async_ctx);
+	talloc_set_destructor(async_ctx, emsmdbp_async_destructor);
+
+	return async_ctx;
+}
+
+/**
+   \details Park a wait until a notification is pending on the session
+   or its timeout expires. If a notification is already pending, the
+   wait is completed on the next event loop iteration.
+
+   \param mem_ctx pointer to the memory context the wait lives in,
+   usually the call it replies to. Releasing it cancels the wait.
+   \param async_ctx pointer to the session asynchronous context
+   \param ev pointer to the event context the call is served from
+   \param reply_fn function called with the pulFlagsOut value when the
+   wait completes
+   \param private_data generic pointer passed to reply_fn
+
+   \return Parked wait on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_async_wait *emsmdbp_async_wait(TALLOC_CTX *mem_ctx,
+						       struct emsmdbp_async_context *async_ctx,
+						       struct tevent_context *ev,
+						       emsmdbp_async_reply_fn_t reply_fn,
+						       void *private_data)
+{
+	struct emsmdbp_async_wait	*wait;
+
+	/* Sanity checks */
+	if (!async_ctx || !ev || !reply_fn) return NULL;
+
+	/* Waits of a session are all served by the same event loop */
+	if (async_ctx->ev && async_ctx->ev != ev) {
+		if (async_ctx->waits) return NULL;
+		TALLOC_FREE(async_ctx->im);
+		TALLOC_FREE(async_ctx->newmail_fde);
+	}
+	async_ctx->ev = ev;
+	emsmdbp_async_newmail_listen(async_ctx);
+
+	wait = talloc_zero(mem_ctx, struct emsmdbp_async_wait);
+	if (!wait) return NULL;
+
+	wait->async_ctx = async_ctx;
+	wait->reply_fn = reply_fn;
+	wait->private_data = private_data;
+	wait->te = tevent_add_timer(ev, wait, timeval_current_ofs(async_ctx->timeout, 0),
+				    emsmdbp_async_wait_timeout, wait);
+	if (!wait->te) {
+		talloc_free(wait);
+		return NULL;
+	}
+
+	DLIST_ADD_END(async_ctx->waits, wait, struct emsmdbp_async_wait *);
+	async_ctx->wait_count++;
+	talloc_set_destructor(wait, emsmdbp_async_wait_destructor);
+
+	if (mapistore_notification_pending(async_ctx->mstore_ctx)) {
+		emsmdbp_async_schedule(async_ctx);
+	}
+
+	return wait;
+}
+
+/**
+   \details Serve an EcDoAsyncWaitEx call: park it on the session the
+   async handle was returned for, or reply immediately when it cannot
+   be parked
+
+   \param mem_ctx pointer to the memory context the wait lives in
+   \param registry pointer to the registry of async handles
+   \param uuid pointer to the GUID of the async handle
+   \param ev pointer to the event context the call is served from, NULL
+   if the call cannot be parked
+   \param reply_fn function called with the pulFlagsOut value when the
+   parked call completes
+   \param private_data generic pointer passed to reply_fn
+   \param pulFlagsOut pointer to the flags to reply with when the call
+   is not parked
+   \param parked pointer set to true when the call is parked and
+   reply_fn will be called
+
+   \return MAPI_E_SUCCESS on success, ecRejected if the async handle is
+   unknown, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_async_wait_handle(TALLOC_CTX *mem_ctx,
+						   struct mpm_session_registry *registry,
+						   struct GUID *uuid,
+						   struct tevent_context *ev,
+						   emsmdbp_async_reply_fn_t reply_fn,
+						   void *private_data,
+						   uint32_t *pulFlagsOut,
+						   bool *parked)
+{
+	struct emsmdbp_async_context	*async_ctx;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!registry, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!uuid || !pulFlagsOut || !parked, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*pulFlagsOut = 0;
+	*parked = false;
+
+	async_ctx = (struct emsmdbp_async_context *) mpm_session_registry_find(registry, uuid);
+	OPENCHANGE_RETVAL_IF(!async_ctx, ecRejected, NULL);
+
+	if (!ev) {
+		if (mapistore_notification_pending(async_ctx->mstore_ctx)) {
+			*pulFlagsOut = EMSMDB_ASYNC_NOTIFICATION_PENDING;
+		}
+		return MAPI_E_SUCCESS;
+	}
+
+	OPENCHANGE_RETVAL_IF(!emsmdbp_async_wait(mem_ctx, async_ctx, ev, reply_fn, private_data),
+			     MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	*parked = true;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Queue a notification about a change in the mailbox of a user
+   on the session the change was made from and on every other session
+   of the user having subscriptions, completing their parked waits if
+   the notification matches one of them
+
+   \param mstore_ctx pointer to the mapistore context of the session the
+   change was made from, NULL if it does not come from a session
+   \param username the name of the mailbox owner
+   \param object_type the type of the object the notification is about
+   \param event the notification event
+   \param parameters pointer to the table or object notification
+   parameters, depending on object_type
+ */
+_PUBLIC_ void emsmdbp_async_push_notification(struct mapistore_context *mstore_ctx,
+					      const char *username,
+					      uint8_t object_type,
+					      enum mapistore_notification_type event,
+					      void *parameters)
+{
+	struct emsmdbp_async_context	*el;
+
+	if (mstore_ctx && mstore_ctx->subscriptions) {
+		mapistore_push_notification(mstore_ctx, object_type, event, parameters);
+	}
+
+	if (!username) return;
+
+	for (el = emsmdbp_async_sessions; el; el = el->next) {
+		if (el->mstore_ctx == mstore_ctx || !el->mstore_ctx->subscriptions) continue;
+		if (strcmp(el->username, username)) continue;
+		mapistore_push_notification(el->mstore_ctx, object_type, event, parameters);
+	}
+}
+
+/**
+   \details Complete all the waits parked on a session
+
+   \param async_ctx pointer to the session asynchronous context
+   \param flags the pulFlagsOut value to reply with
+ */
+_PUBLIC_ void emsmdbp_async_complete(struct emsmdbp_async_context *async_ctx, uint32_t flags)
+{
+	if (!async_ctx) return;
+
+	while (async_ctx->waits) {
+		emsmdbp_async_wait_reply(async_ctx->waits, flags);
+	}
+}
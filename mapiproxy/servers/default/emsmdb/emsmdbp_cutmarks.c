@@ -0,0 +1,183 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_cutmarks.c
+
+   \brief Cutmark index of FastTransfer download streams
+
+   A cutmark is an offset of the stream where a FastTransfer buffer may
+   end: before or after a marker, or before or after a property
+   value. Cutmarks following a variable size value also record the
+   minimum number of value bytes that must fit in the buffer for the
+   value to be split instead.
+ */
+
+#include "dcesrv_exchange_emsmdb.h"
+
+#define	EMSMDBP_CUTMARKS_INITIAL_SIZE	64
+
+/**
+   \details Initialize an empty cutmark index
+
+   \param mem_ctx pointer to the memory context
+
+   \return Allocated cutmark index on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_cutmarks *emsmdbp_cutmarks_init(TALLOC_CTX *mem_ctx)
+{
+	return talloc_zero(mem_ctx, struct emsmdbp_cutmarks);
+}
+
+/**
+   \details Append a cutmark to the index. Cutmarks must be pushed in
+   increasing offset order, which is the case when they are pushed
+   while the stream is being serialized.
+
+   \param cutmarks pointer to the cutmark index
+   \param min_value_size minimum value size required to split the
+   value ending at this cutmark, 0 if it cannot be split
+   \param offset offset of the cutmark in the stream
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_cutmarks_push(struct emsmdbp_cutmarks *cutmarks, uint32_t min_value_size, uint32_t offset)
+{
+	struct emsmdbp_cutmark	*marks;
+	uint32_t		size;
+
+	if (!cutmarks) return false;
+
+	if (cutmarks->count == cutmarks->size) {
+		size = cutmarks->size ? cutmarks->size * 2 : EMSMDBP_CUTMARKS_INITIAL_SIZE;
+		marks = talloc_realloc(cutmarks, cutmarks->marks, struct emsmdbp_cutmark, size);
+		if (!marks) return false;
+		cutmarks->marks = marks;
+		cutmarks->size = size;
+	}
+
+	cutmarks->marks[cutmarks->count].min_value_size = min_value_size;
+	cutmarks->marks[cutmarks->count].offset = offset;
+	cutmarks->count++;
+
+	return true;
+}
+
+/**
+   \details Remove the last cutmark of the index
+
+   \param cutmarks pointer to the cutmark index
+ */
+_PUBLIC_ void emsmdbp_cutmarks_pop(struct emsmdbp_cutmarks *cutmarks)
+{
+	if (!cutmarks || !cutmarks->count) return;
+
+	cutmarks->count--;
+	if (cutmarks->next > cutmarks->count) {
+		cutmarks->next = cutmarks->count;
+	}
+}
+
+/**
+   \details Drop the cutmarks located before a stream position and make
+   the remaining ones relative to it. This is used when the beginning
+   of the stream is discarded.
+
+   \param cutmarks pointer to the cutmark index
+   \param position new start of the stream
+ */
+_PUBLIC_ void emsmdbp_cutmarks_rebase(struct emsmdbp_cutmarks *cutmarks, uint32_t position)
+{
+	uint32_t	i, first;
+
+	if (!cutmarks || !position) return;
+
+	cutmarks->next = 0;
+	first = emsmdbp_cutmarks_lookup(cutmarks, position + 1);
+	for (i = first; i < cutmarks->count; i++) {
+		cutmarks->marks[i - first].min_value_size = cutmarks->marks[i].min_value_size;
+		cutmarks->marks[i - first].offset = cutmarks->marks[i].offset - position;
+	}
+	cutmarks->count -= first;
+}
+
+/**
+   \details Find the first cutmark located at or after an offset
+
+   \param cutmarks pointer to the cutmark index
+   \param offset the offset to look up
+
+   \return index of the cutmark, or the number of cutmarks if there is
+   none
+ */
+_PUBLIC_ uint32_t emsmdbp_cutmarks_lookup(struct emsmdbp_cutmarks *cutmarks, uint32_t offset)
+{
+	uint32_t	low, high, middle;
+
+	if (!cutmarks) return 0;
+
+	low = cutmarks->next;
+	high = cutmarks->count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (cutmarks->marks[middle].offset < offset) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+   \details Compute the size of the next FastTransfer buffer. The buffer
+   ends at the last cutmark which fits in the requested size, unless
+   the value following that cutmark is large enough to be split.
+
+   \param cutmarks pointer to the cutmark index
+   \param position current position in the stream
+   \param request_buffer_size the buffer size requested by the client
+
+   \return the size of the next buffer
+ */
+_PUBLIC_ uint32_t emsmdbp_cutmarks_next_buffer_size(struct emsmdbp_cutmarks *cutmarks, uint32_t position, uint32_t request_buffer_size)
+{
+	uint32_t	buffer_size, min_value_size, mark_idx;
+
+	buffer_size = request_buffer_size;
+	if (!cutmarks) return buffer_size;
+
+	mark_idx = emsmdbp_cutmarks_lookup(cutmarks, position + request_buffer_size);
+	if (mark_idx > cutmarks->next && cutmarks->marks[mark_idx - 1].offset > position) {
+		buffer_size = cutmarks->marks[mark_idx - 1].offset - position;
+	}
+	if (buffer_size < request_buffer_size && mark_idx < cutmarks->count) {
+		min_value_size = cutmarks->marks[mark_idx].min_value_size;
+		if (min_value_size && (request_buffer_size - buffer_size > min_value_size)) {
+			buffer_size = request_buffer_size;
+		}
+	}
+	cutmarks->next = mark_idx;
+
+	return buffer_size;
+}
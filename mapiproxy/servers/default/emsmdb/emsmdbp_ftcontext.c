@@ -0,0 +1,174 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_ftcontext.c
+
+   \brief On demand serialization of FastTransfer download streams
+
+   A producer serializes the properties of a FastTransfer download
+   into a window slightly larger than two client buffers, one property
+   at a time, each time FastTransferSourceGetBuffer needs more
+   data. Large values are not serialized at once: they are copied to
+   the window piece by piece, and released as soon as they are fully
+   copied.
+ */
+
+#include "dcesrv_exchange_emsmdb.h"
+
+/**
+   \details Initialize a FastTransfer producer
+
+   \param mem_ctx pointer to the memory context
+   \param count number of properties to serialize
+   \param push_property function serializing the property at a given
+   index to the producer window
+   \param private_data pointer passed to push_property through the
+   producer
+
+   \return Allocated producer on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_ftcontext_producer *emsmdbp_ftcontext_producer_init(TALLOC_CTX *mem_ctx, uint32_t count,
+									     emsmdbp_ftcontext_push_fn_t push_property,
+									     void *private_data)
+{
+	struct emsmdbp_ftcontext_producer	*producer;
+
+	if (!push_property) return NULL;
+
+	producer = talloc_zero(mem_ctx, struct emsmdbp_ftcontext_producer);
+	if (!producer) return NULL;
+
+	producer->ndr = ndr_push_init_ctx(producer);
+	if (!producer->ndr) {
+		talloc_free(producer);
+		return NULL;
+	}
+	ndr_set_flags(&producer->ndr->flags, LIBNDR_FLAG_NOALIGN);
+	producer->ndr->offset = 0;
+
+	producer->count = count;
+	producer->push_property = push_property;
+	producer->private_data = private_data;
+
+	return producer;
+}
+
+/**
+   \details Start copying a large value to the producer window. The
+   value length is serialized immediately, the value itself by the
+   following calls to emsmdbp_ftcontext_producer_fill.
+
+   \param producer pointer to the FastTransfer producer
+   \param cutmarks pointer to the cutmark index of the stream
+   \param value_ctx memory context of the value, stolen by the
+   producer and released once the value is copied
+   \param value the serialized value, without its length
+   \param min_value_size minimum number of value bytes a buffer must
+   hold for the value to be split
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool emsmdbp_ftcontext_producer_push_value(struct emsmdbp_ftcontext_producer *producer,
+						     struct emsmdbp_cutmarks *cutmarks,
+						     TALLOC_CTX *value_ctx, DATA_BLOB value,
+						     uint32_t min_value_size)
+{
+	if (!producer || producer->pending_length) return false;
+
+	ndr_push_uint32(producer->ndr, NDR_SCALARS, value.length);
+	if (!value.length) {
+		talloc_free(value_ctx);
+		emsmdbp_cutmarks_push(cutmarks, min_value_size, producer->ndr->offset);
+		return true;
+	}
+
+	producer->pending_ctx = talloc_steal(producer, value_ctx);
+	producer->pending_data = value.data;
+	producer->pending_length = value.length;
+	producer->pending_min_value_size = min_value_size;
+
+	return true;
+}
+
+/**
+   \details Drop the part of the window already sent, then serialize
+   properties until the window holds more than two client buffers or
+   until there is nothing left to serialize
+
+   \param ftcontext pointer to the FastTransfer context
+   \param request_buffer_size the buffer size requested by the client
+ */
+_PUBLIC_ void emsmdbp_ftcontext_producer_fill(struct emsmdbp_object_ftcontext *ftcontext, uint32_t request_buffer_size)
+{
+	struct emsmdbp_ftcontext_producer	*producer;
+	struct ndr_push				*ndr;
+	uint32_t				position, target, length;
+
+	if (!ftcontext || !ftcontext->producer) return;
+	producer = ftcontext->producer;
+	ndr = producer->ndr;
+
+	/* Step 1. Move the unsent bytes and their cutmarks to the start
+	 * of the window. The cutmark ending the window while a value is
+	 * pending is not a real one */
+	if (producer->pending_length) {
+		emsmdbp_cutmarks_pop(ftcontext->cutmarks);
+	}
+	position = ftcontext->stream.position;
+	if (position > 0) {
+		memmove(ndr->data, ndr->data + position, ndr->offset - position);
+		ndr->offset -= position;
+		emsmdbp_cutmarks_rebase(ftcontext->cutmarks, position);
+	}
+
+	/* Step 2. Serialize the next properties */
+	target = 2 * request_buffer_size;
+	while (ndr->offset <= target) {
+		if (producer->pending_length) {
+			length = MIN(producer->pending_length, target + 1 - ndr->offset);
+			ndr_push_bytes(ndr, producer->pending_data, length);
+			producer->pending_data += length;
+			producer->pending_length -= length;
+			if (producer->pending_length == 0) {
+				emsmdbp_cutmarks_push(ftcontext->cutmarks, producer->pending_min_value_size, ndr->offset);
+				talloc_free(producer->pending_ctx);
+				producer->pending_ctx = NULL;
+				producer->pending_data = NULL;
+			}
+		}
+		else if (producer->next_property < producer->count) {
+			producer->push_property(producer, ftcontext->cutmarks, producer->next_property++);
+		}
+		else {
+			break;
+		}
+	}
+
+	/* Step 3. A value continuing past the window may be split at its end */
+	if (producer->pending_length) {
+		emsmdbp_cutmarks_push(ftcontext->cutmarks, producer->pending_min_value_size, ndr->offset);
+	}
+
+	ftcontext->stream.position = 0;
+	ftcontext->stream.buffer.data = ndr->data;
+	ftcontext->stream.buffer.length = ndr->offset;
+}
@@ -1590,6 +1590,25 @@ _PUBLIC_ int emsmdbp_object_table_get_available_properties(TALLOC_CTX *mem_ctx,
 	return retval;
 }
 
+static void emsmdbp_object_table_convert_row_props(uint32_t num_props, struct mapistore_property_data *properties,
+						   void **data_pointers, enum MAPISTATUS *retvals)
+{
+	uint32_t	i;
+
+	for (i = 0; i < num_props; i++) {
+		data_pointers[i] = properties[i].data;
+
+		if (properties[i].error != MAPISTORE_SUCCESS) {
+			retvals[i] = mapistore_error_to_mapi(properties[i].error);
+		}
+		else {
+			if (properties[i].data == NULL) {
+				retvals[i] = MAPI_E_NOT_FOUND;
+			}
+		}
+	}
+}
+
 _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
 {
         void				**data_pointers;
@@ -1621,18 +1640,7 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
 					      table_object->backend_object, data_pointers,
 					      query_type, row_id, &properties);
 		if (ret == MAPISTORE_SUCCESS) {
-			for (i = 0; i < num_props; i++) {
-				data_pointers[i] = properties[i].data;
-                                        
-				if (properties[i].error != MAPISTORE_SUCCESS) {
-					retvals[i] = mapistore_error_to_mapi(properties[i].error);
-				}
-				else {
-					if (properties[i].data == NULL) {
-						retvals[i] = MAPI_E_NOT_FOUND;
-					}
-				}
-			}
+			emsmdbp_object_table_convert_row_props(num_props, properties, data_pointers, retvals);
 		}
 		else {
 			DEBUG(5, ("%s: invalid object (likely due to a restriction)\n", __location__));
@@ -1800,6 +1808,82 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
         return data_pointers;
 }
 
+/**
+   \details Retrieve the properties of a window of consecutive table
+   rows
+
+   Rows of mapistore tables are fetched with a single backend call,
+   other tables are read row by row.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param start index of the first row to fetch
+   \param count number of rows to fetch
+   \param query_type the type of query (prefiltered or live filtered)
+   \param retvalsp pointer on the array of property status arrays to
+   return, one per row
+   \param rows_countp pointer to the number of rows returned
+
+   \return an array of rows_countp entries on success, each entry
+   being the data pointers of a row or NULL if the row is not
+   available, otherwise NULL
+ */
+_PUBLIC_ void ***emsmdbp_object_table_get_rows_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t start, uint32_t count, enum mapistore_query_type query_type, enum MAPISTATUS ***retvalsp, uint32_t *rows_countp)
+{
+	void				***rows;
+	enum MAPISTATUS			**retvals;
+	struct mapistore_property_data	**properties;
+	enum mapistore_error		ret;
+	uint32_t			contextID;
+	uint32_t			num_props;
+	uint32_t			rows_count;
+	uint32_t			i;
+
+	rows = talloc_zero_array(mem_ctx, void **, count);
+	OPENCHANGE_RETVAL_IF(rows == NULL, 0, NULL);
+	retvals = talloc_zero_array(rows, enum MAPISTATUS *, count);
+	OPENCHANGE_RETVAL_IF(retvals == NULL, 0, rows);
+
+	if (emsmdbp_is_mapistore(table_object)) {
+		num_props = table_object->object.table->prop_count;
+		contextID = emsmdbp_get_contextID(table_object);
+		ret = mapistore_table_get_rows(emsmdbp_ctx->mstore_ctx, contextID,
+					       table_object->backend_object, rows,
+					       query_type, start, count, &properties, &rows_count);
+		if (ret != MAPISTORE_SUCCESS) {
+			DEBUG(5, ("%s: unable to fetch rows %d-%d: %s\n", __location__,
+				  start, start + count, mapistore_errstr(ret)));
+			talloc_free(rows);
+			return NULL;
+		}
+		if (rows_count > count) {
+			rows_count = count;
+		}
+
+		for (i = 0; i < rows_count; i++) {
+			if (!properties[i]) continue;
+
+			rows[i] = talloc_zero_array(rows, void *, num_props);
+			retvals[i] = talloc_zero_array(rows, enum MAPISTATUS, num_props);
+			OPENCHANGE_RETVAL_IF(!rows[i] || !retvals[i], 0, rows);
+			emsmdbp_object_table_convert_row_props(num_props, properties[i], rows[i], retvals[i]);
+		}
+	} else {
+		for (i = 0; i < count; i++) {
+			rows[i] = emsmdbp_object_table_get_row_props(rows, emsmdbp_ctx, table_object, start + i, query_type, &retvals[i]);
+		}
+		rows_count = count;
+	}
+
+	if (retvalsp) {
+		*retvalsp = retvals;
+	}
+	*rows_countp = rows_count;
+
+	return rows;
+}
+
 _PUBLIC_ void emsmdbp_fill_table_row_blob(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx,
 					  DATA_BLOB *table_row, uint16_t num_props,
 					  enum MAPITAGS *properties,
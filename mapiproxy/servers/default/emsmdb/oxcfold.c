@@ -655,6 +655,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopDeleteMessages(TALLOC_CTX *mem_ctx,
 	enum MAPISTATUS		retval;
 	uint32_t		contextID;
 	int 			i;
+	struct mapistore_object_notification_parameters	parameters;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCFOLD] DeleteMessage (0x1e)\n"));
 
@@ -711,6 +712,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopDeleteMessages(TALLOC_CTX *mem_ctx,
 			mapi_repl->error_code = MAPI_E_CALL_FAILED;
 			goto delete_message_response;
 		}
+
+		memset(&parameters, 0, sizeof (parameters));
+		parameters.folder_id = parent_object->object.folder->folderID;
+		parameters.object_id = mid;
+		emsmdbp_async_push_notification(emsmdbp_ctx->mstore_ctx, owner, MAPISTORE_MESSAGE,
+						MAPISTORE_OBJECT_DELETED, &parameters);
 	}
 
 delete_message_response:
@@ -32,9 +32,12 @@
 /* a constant time offset by which the first change number ever can be produced by OpenChange */
 #define oc_version_time 0x4dbb2dbe
 
-/* the maximum buffer that will be populated during msg synchronization operations (note: this is a soft limit) */
-static const size_t max_message_sync_size = 262144;
-static const uint32_t message_preload_interval = 150;
+static const uint32_t ftcontext_large_value_size = 4096;
+/* the first chunk size and preload window of a message synchronization, before any message has been measured */
+static const uint32_t message_sync_initial_chunk_size = 262144;
+static const uint32_t message_preload_initial_window = 150;
+/* weight of the last message in the running averages used to size message synchronization chunks */
+static const double message_sync_average_weight = 0.125;
 
 /** notes:
  * conventions:
@@ -74,7 +77,7 @@ struct oxcfxics_sync_data {
 	struct oxcfxics_prop_index	prop_index;
 
 	struct ndr_push			*ndr;
-	struct ndr_push			*cutmarks_ndr;
+	struct emsmdbp_cutmarks		*cutmarks;
 
 	struct rawidset			*eid_set;
 	struct rawidset			*cnset_seen;
@@ -85,10 +88,38 @@ struct oxcfxics_sync_data {
 	struct oxcfxics_message_sync_data	*message_sync_data;
 };
 
+/* The properties of a FastTransferSourceCopyTo download */
+struct oxcfxics_ftcontext_data {
+	struct emsmdbp_context		*emsmdbp_ctx;
+	struct emsmdbp_object		*object;
+	void				*nprops_ctx;
+	struct SPropTagArray		*properties;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+};
+
 struct oxcfxics_message_sync_data {
 	uint64_t	*mids;
 	uint64_t	count;
 	uint64_t	max;
+
+	/* the buffer that will be populated during the next chunk (note: this is a soft limit) */
+	uint32_t	chunk_size;
+	/* number of messages whose bodies are preloaded at once */
+	uint32_t	preload_window;
+	/* preloading of the following window starts when count reaches preload_mark */
+	uint64_t	preload_mark;
+	uint64_t	preload_end;
+
+	/* running averages of the serialization cost of a message */
+	double		message_usec;
+	double		message_bytes;
+
+	/* statistics */
+	struct timeval	tv_start;
+	uint64_t	sent_messages;
+	uint64_t	sent_bytes;
+	uint32_t	chunks;
 };
 
 /** ndr helpers */
@@ -112,38 +143,30 @@ static void oxcfxics_ndr_check(struct ndr_push *ndr, const char *label)
 #if 1
 #define oxcfxics_check_cutmark_buffer(x,y)
 #else
-static void oxcfxics_check_cutmark_buffer(void *cutmark_buffer, DATA_BLOB *data_buffer)
+static void oxcfxics_check_cutmark_buffer(struct emsmdbp_cutmarks *cutmarks, DATA_BLOB *data_buffer)
 {
-	uint32_t *digits_ptr;
 	uint32_t min_size, prev_cutmark, cutmark;
-	bool done;
+	uint32_t i;
 
-	digits_ptr = cutmark_buffer;
 	prev_cutmark = 0;
-	done = false;
-	while (!done) {
-		cutmark = digits_ptr[1];
-		if (cutmark == 0xffffffff) {
-			done = true;
-		}
-		else {
-			min_size = digits_ptr[0];
-			if (min_size > 0) {
-				if (min_size != 4 && min_size != 8) {
-					DEBUG(0, ("invalid min_size: %d\n", min_size));
-					abort();
-				}
-			}
-			if (cutmark < prev_cutmark && prev_cutmark > 0) {
-				DEBUG(0, ("cutmark goes backward\n"));
+	for (i = 0; i < cutmarks->count; i++) {
+		cutmark = cutmarks->marks[i].offset;
+		min_size = cutmarks->marks[i].min_value_size;
+		if (min_size > 0) {
+			if (min_size != 4 && min_size != 8) {
+				DEBUG(0, ("invalid min_size: %d\n", min_size));
 				abort();
 			}
-			if (cutmark > data_buffer->length) {
-				DEBUG(0, ("cutmark goes beyond the buffer size\n"));
-				abort();
-			}
-			digits_ptr += 2;
 		}
+		if (cutmark < prev_cutmark && prev_cutmark > 0) {
+			DEBUG(0, ("cutmark goes backward\n"));
+			abort();
+		}
+		if (cutmark > data_buffer->length) {
+			DEBUG(0, ("cutmark goes beyond the buffer size\n"));
+			abort();
+		}
+		prev_cutmark = cutmark;
 	}
 }
 #endif
@@ -252,51 +275,62 @@ static uint32_t oxcfxics_compute_cutmark_min_value_buffer(uint16_t prop_type)
 	return min_value_buffer;
 }
 
-static void oxcfxics_ndr_push_properties(struct ndr_push *ndr, struct ndr_push *cutmarks_ndr, void *nprops_ctx, struct SPropTagArray *properties, void **data_pointers, enum MAPISTATUS *retvals)
+/* Push the property tag, followed by the property name for named properties */
+static bool oxcfxics_ndr_push_property_tag(struct ndr_push *ndr, void *nprops_ctx, enum MAPITAGS property)
+{
+        struct MAPINAMEID       *nameid;
+	uint16_t		propID;
+        int                     retval;
+	uint32_t		saved_flags;
+
+	ndr_push_uint32(ndr, NDR_SCALARS, property);
+	if (property > 0x80000000) {
+		propID = property >> 16;
+		retval = mapistore_namedprops_get_nameid(nprops_ctx, propID, NULL, &nameid);
+		if (retval != MAPISTORE_SUCCESS) {
+			DEBUG(0, ("no definition found for named property with id '%.8x'\n", property));
+			return false;
+		}
+		ndr_push_GUID(ndr, NDR_SCALARS, &nameid->lpguid);
+		switch (nameid->ulKind) {
+		case MNID_ID:
+			ndr_push_uint8(ndr, NDR_SCALARS, 0);
+			ndr_push_uint32(ndr, NDR_SCALARS, nameid->kind.lid);
+			break;
+		case MNID_STRING:
+			saved_flags = ndr->flags;
+			ndr_push_uint8(ndr, NDR_SCALARS, 1);
+			ndr_set_flags(&ndr->flags, LIBNDR_FLAG_STR_NULLTERM);
+			ndr_push_string(ndr, NDR_SCALARS, nameid->kind.lpwstr.Name);
+			ndr->flags = saved_flags;
+			break;
+		}
+		talloc_free(nameid);
+	}
+
+	return true;
+}
+
+static void oxcfxics_ndr_push_properties(struct ndr_push *ndr, struct emsmdbp_cutmarks *cutmarks, void *nprops_ctx, struct SPropTagArray *properties, void **data_pointers, enum MAPISTATUS *retvals)
 {
 	uint32_t		i, j, min_value_buffer;
 	enum MAPITAGS		property;
-        struct MAPINAMEID       *nameid;
 	struct BinaryArray_r	*bin_array;
 	struct StringArrayW_r	*unicode_array;
 	struct ShortArray_r	*short_array;
 	struct LongArray_r	*long_array;
 	struct UI8Array_r	*ui8_array;
-	uint16_t		prop_type, propID;
-        int                     retval;
-	uint32_t		saved_flags;
+	uint16_t		prop_type;
 
         for (i = 0; i < properties->cValues; i++) {
                 if (retvals[i] == MAPI_E_SUCCESS) {
                         property = properties->aulPropTag[i];
 			prop_type = property & 0xffff;
 
-			ndr_push_uint32(ndr, NDR_SCALARS, property);
-			if (property > 0x80000000) {
-				propID = property >> 16;
-				retval = mapistore_namedprops_get_nameid(nprops_ctx, propID, NULL, &nameid);
-				if (retval != MAPISTORE_SUCCESS) {
-					DEBUG(0, ("no definition found for named property with id '%.8x'\n", property));
-					continue;
-				}
-				ndr_push_GUID(ndr, NDR_SCALARS, &nameid->lpguid);
-				switch (nameid->ulKind) {
-				case MNID_ID:
-					ndr_push_uint8(ndr, NDR_SCALARS, 0);
-					ndr_push_uint32(ndr, NDR_SCALARS, nameid->kind.lid);
-					break;
-				case MNID_STRING:
-					saved_flags = ndr->flags;
-					ndr_push_uint8(ndr, NDR_SCALARS, 1);
-					ndr_set_flags(&ndr->flags, LIBNDR_FLAG_STR_NULLTERM);
-					ndr_push_string(ndr, NDR_SCALARS, nameid->kind.lpwstr.Name);
-					ndr->flags = saved_flags;
-					break;
-				}
-				talloc_free(nameid);
+			if (!oxcfxics_ndr_push_property_tag(ndr, nprops_ctx, property)) {
+				continue;
 			}
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, ndr->offset);
+			emsmdbp_cutmarks_push(cutmarks, 0, ndr->offset);
 
 			if ((prop_type & MV_FLAG)) {
 				prop_type &= 0x0fff;
@@ -346,8 +380,7 @@ static void oxcfxics_ndr_push_properties(struct ndr_push *ndr, struct ndr_push *
 				oxcfxics_ndr_push_simple_data(ndr, prop_type, data_pointers[i]);
 			}
 			min_value_buffer = oxcfxics_compute_cutmark_min_value_buffer(prop_type);
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, min_value_buffer);
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, ndr->offset);
+			emsmdbp_cutmarks_push(cutmarks, min_value_buffer, ndr->offset);
 		}
         }
 
@@ -416,6 +449,105 @@ static inline struct Binary_r *oxcfxics_make_gid(TALLOC_CTX *mem_ctx, struct GUI
 	return oxcfxics_make_xid(mem_ctx, replica_guid, &id, 6);
 }
 
+/* Rough size of the serialized properties, only used to report
+ * progress. Values fetched on demand only count once fetched */
+static size_t oxcfxics_estimate_properties_size(struct SPropTagArray *properties, void **data_pointers, enum MAPISTATUS *retvals)
+{
+	struct Binary_r	*bin_value;
+	size_t		size = 0;
+	uint32_t	i;
+
+	for (i = 0; i < properties->cValues; i++) {
+		if (retvals[i] != MAPI_E_SUCCESS) continue;
+
+		size += 8;
+		if (data_pointers[i] == NULL) continue;
+		switch (properties->aulPropTag[i] & 0xffff) {
+		case PT_SVREID:
+		case PT_BINARY:
+			bin_value = data_pointers[i];
+			size += bin_value->cb;
+			break;
+		case PT_STRING8:
+			size += strlen(data_pointers[i]) + 1;
+			break;
+		case PT_UNICODE:
+			size += strlen(data_pointers[i]) * 2 + 2;
+			break;
+		default:
+			size += 8;
+			break;
+		}
+	}
+
+	return size;
+}
+
+/* Binary and string values are only fetched when the producer
+ * reaches them, the way RopOpenStream fetches them */
+static inline bool oxcfxics_ftcontext_streamed_property(enum MAPITAGS property)
+{
+	uint16_t	prop_type = property & 0xffff;
+
+	return (prop_type == PT_BINARY || prop_type == PT_UNICODE);
+}
+
+static void oxcfxics_ftcontext_push_property(struct emsmdbp_ftcontext_producer *producer, struct emsmdbp_cutmarks *cutmarks, uint32_t i)
+{
+	struct oxcfxics_ftcontext_data	*ft_data = producer->private_data;
+	struct SPropTagArray		property;
+	TALLOC_CTX			*value_ctx;
+	struct emsmdbp_stream_data	*stream_data;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	DATA_BLOB			value;
+	uint16_t			prop_type;
+
+	if (ft_data->retvals[i] != MAPI_E_SUCCESS) return;
+
+	property.cValues = 1;
+	property.aulPropTag = ft_data->properties->aulPropTag + i;
+
+	if (!oxcfxics_ftcontext_streamed_property(property.aulPropTag[0])) {
+		oxcfxics_ndr_push_properties(producer->ndr, cutmarks, ft_data->nprops_ctx, &property, ft_data->data_pointers + i, ft_data->retvals + i);
+		return;
+	}
+
+	value_ctx = talloc_new(NULL);
+	data_pointers = emsmdbp_object_get_properties(value_ctx, ft_data->emsmdbp_ctx, ft_data->object, &property, &retvals);
+	if (data_pointers == NULL || retvals[0] != MAPI_E_SUCCESS) {
+		talloc_free(value_ctx);
+		return;
+	}
+
+	stream_data = emsmdbp_stream_data_from_value(value_ctx, property.aulPropTag[0], data_pointers[0], false);
+	if (stream_data == NULL) {
+		talloc_free(value_ctx);
+		return;
+	}
+	prop_type = property.aulPropTag[0] & 0xffff;
+	value = stream_data->data;
+	if (prop_type == PT_UNICODE) {
+		/* the terminating null character is part of the value */
+		value.length += 2;
+	}
+	producer->estimated_length += value.length;
+
+	if (value.length <= ftcontext_large_value_size) {
+		oxcfxics_ndr_push_properties(producer->ndr, cutmarks, ft_data->nprops_ctx, &property, data_pointers, retvals);
+		talloc_free(value_ctx);
+		return;
+	}
+
+	/* large values are copied to the window piece by piece */
+	if (!oxcfxics_ndr_push_property_tag(producer->ndr, ft_data->nprops_ctx, property.aulPropTag[0])) {
+		talloc_free(value_ctx);
+		return;
+	}
+	emsmdbp_cutmarks_push(cutmarks, 0, producer->ndr->offset);
+	emsmdbp_ftcontext_producer_push_value(producer, cutmarks, value_ctx, value, oxcfxics_compute_cutmark_min_value_buffer(prop_type));
+}
+
 /**
    \details EcDoRpc EcDoRpc_RopFastTransferSourceCopyTo (0x4d) Rop. This operation initializes a FastTransfer operation to download content from a given messaging object and its descendant subobjects.
 
@@ -438,12 +570,14 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFastTransferSourceCopyTo(TALLOC_CTX *mem_ctx
 	struct mapi_handles			*parent_object_handle = NULL, *object_handle;
 	struct emsmdbp_object			*parent_object = NULL, *object;
 	struct FastTransferSourceCopyTo_req	 *request;
-	uint32_t				parent_handle_id, i;
+	uint32_t				parent_handle_id, i, j;
 	void					*data;
 	struct SPropTagArray			*needed_properties;
+	struct SPropTagArray			prefetch_properties;
 	void					**data_pointers;
 	enum MAPISTATUS				*retvals;
-	struct ndr_push				*ndr, *cutmarks_ndr;
+	struct oxcfxics_ftcontext_data		*ft_data;
+	struct emsmdbp_ftcontext_producer	*producer;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCFXICS] FastTransferSourceCopyTo (0x4d)\n"));
 
@@ -485,49 +619,67 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFastTransferSourceCopyTo(TALLOC_CTX *mem_ctx
 				SPropTagArray_delete(mem_ctx, needed_properties, request->PropertyTags.aulPropTag[i]);
 			}
 
-			data_pointers = emsmdbp_object_get_properties(mem_ctx, emsmdbp_ctx, parent_object, needed_properties, &retvals);
-			if (data_pointers == NULL) {
-				mapi_repl->error_code = MAPI_E_INVALID_OBJECT;
-				DEBUG(5, ("  unexpected error\n"));
-				goto end;
+			/* The properties are serialized on demand by
+			 * FastTransferSourceGetBuffer and must live as
+			 * long as the context */
+			ft_data = talloc_zero(NULL, struct oxcfxics_ftcontext_data);
+			ft_data->emsmdbp_ctx = emsmdbp_ctx;
+			ft_data->object = parent_object;
+			ft_data->nprops_ctx = emsmdbp_ctx->mstore_ctx->nprops_ctx;
+			ft_data->properties = talloc_steal(ft_data, needed_properties);
+			ft_data->data_pointers = talloc_zero_array(ft_data, void *, needed_properties->cValues);
+			ft_data->retvals = talloc_array(ft_data, enum MAPISTATUS, needed_properties->cValues);
+
+			/* Only fetch the fixed size values now */
+			prefetch_properties.cValues = 0;
+			prefetch_properties.aulPropTag = talloc_array(ft_data, enum MAPITAGS, needed_properties->cValues);
+			for (i = 0; i < needed_properties->cValues; i++) {
+				ft_data->retvals[i] = MAPI_E_SUCCESS;
+				if (!oxcfxics_ftcontext_streamed_property(needed_properties->aulPropTag[i])) {
+					prefetch_properties.aulPropTag[prefetch_properties.cValues++] = needed_properties->aulPropTag[i];
+				}
+			}
+			if (prefetch_properties.cValues > 0) {
+				data_pointers = emsmdbp_object_get_properties(ft_data, emsmdbp_ctx, parent_object, &prefetch_properties, &retvals);
+				if (data_pointers == NULL) {
+					talloc_free(ft_data);
+					mapi_repl->error_code = MAPI_E_INVALID_OBJECT;
+					DEBUG(5, ("  unexpected error\n"));
+					goto end;
+				}
+				for (i = 0, j = 0; i < needed_properties->cValues; i++) {
+					if (!oxcfxics_ftcontext_streamed_property(needed_properties->aulPropTag[i])) {
+						ft_data->data_pointers[i] = data_pointers[j];
+						ft_data->retvals[i] = retvals[j];
+						j++;
+					}
+				}
 			}
-
-			ndr = ndr_push_init_ctx(NULL);
-			ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
-			ndr->offset = 0;
-
-			cutmarks_ndr = ndr_push_init_ctx(NULL);
-			ndr_set_flags(&cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
-			cutmarks_ndr->offset = 0;
-
-			oxcfxics_ndr_push_properties(ndr, cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, needed_properties, data_pointers, retvals);
 
 			retval = mapi_handles_add(emsmdbp_ctx->handles_ctx, parent_handle_id, &object_handle);
 			object = emsmdbp_object_ftcontext_init(object_handle, emsmdbp_ctx, parent_object);
 			if (object == NULL) {
+				talloc_free(ft_data);
 				mapi_repl->error_code = MAPI_E_INVALID_OBJECT;
 				DEBUG(5, ("  context object not created\n"));
 				goto end;
 			}
 
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(cutmarks_ndr, NDR_SCALARS, 0xffffffff);
-
-			(void) talloc_reference(object, ndr->data);
-			(void) talloc_reference(object, cutmarks_ndr->data);
-
-			object->object.ftcontext->cutmarks = (uint32_t *) cutmarks_ndr->data;
-			object->object.ftcontext->stream.buffer.data = ndr->data;
-			object->object.ftcontext->stream.buffer.length = ndr->offset;
+			producer = emsmdbp_ftcontext_producer_init(object->object.ftcontext, needed_properties->cValues,
+								   oxcfxics_ftcontext_push_property, ft_data);
+			if (producer == NULL) {
+				talloc_free(ft_data);
+				mapi_repl->error_code = MAPI_E_NOT_ENOUGH_MEMORY;
+				goto end;
+			}
+			producer->private_data = talloc_steal(producer, ft_data);
+			producer->estimated_length = oxcfxics_estimate_properties_size(needed_properties, ft_data->data_pointers, ft_data->retvals);
 
-			talloc_free(ndr);
-			talloc_free(cutmarks_ndr);
+			object->object.ftcontext->cutmarks = emsmdbp_cutmarks_init(object->object.ftcontext);
+			object->object.ftcontext->producer = producer;
 
 			mapi_handles_set_private_data(object_handle, object);
 			handles[mapi_repl->handle_idx] = object_handle->handle;
-
-			talloc_free(data_pointers);
-			talloc_free(retvals);
 		}
 	}
 
@@ -547,8 +699,7 @@ static void oxcfxics_push_messageChange_recipients(struct emsmdbp_context *emsmd
 
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagFXDelProp);
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagMessageRecipients);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 	min_string_value_buffer = oxcfxics_compute_cutmark_min_value_buffer(PT_UNICODE);
 
@@ -570,34 +721,28 @@ static void oxcfxics_push_messageChange_recipients(struct emsmdbp_context *emsmd
 			recipient = msg->recipients + i;
 
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, StartRecip);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagRowid);
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, i);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 			if (email_idx != (uint32_t) -1 && recipient->data[email_idx]) {
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagAddressType);
 				oxcfxics_ndr_push_simple_data(sync_data->ndr, 0x1f, "SMTP");
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, min_string_value_buffer);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, min_string_value_buffer, sync_data->ndr->offset);
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagEmailAddress);
 				oxcfxics_ndr_push_simple_data(sync_data->ndr, 0x1f, recipient->data[email_idx]);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, min_string_value_buffer);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, min_string_value_buffer, sync_data->ndr->offset);
 			}
 			if (cn_idx != (uint32_t) -1 && recipient->data[cn_idx]) {
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagDisplayName);
 				oxcfxics_ndr_push_simple_data(sync_data->ndr, 0x1f, recipient->data[cn_idx]);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, min_string_value_buffer);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, min_string_value_buffer, sync_data->ndr->offset);
 			}
 
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagRecipientType);
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, recipient->type);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 			for (j = 0; j < msg->columns->cValues; j++) {
 				if (recipient->data[j] == NULL) {
@@ -608,10 +753,9 @@ static void oxcfxics_push_messageChange_recipients(struct emsmdbp_context *emsmd
 				}
 			}
 
-			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, msg->columns, recipient->data, retvals);
+			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, msg->columns, recipient->data, retvals);
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, EndToRecip);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 		}
 
 		talloc_free(local_mem_ctx);
@@ -637,8 +781,7 @@ static void oxcfxics_push_messageChange_attachment_embedded_message(struct emsmd
 	ret = mapistore_message_attachment_open_embedded_message(emsmdbp_ctx->mstore_ctx, contextID, attachment, mem_ctx, &embedded_message, &messageID, &msg);
 	if (ret == MAPISTORE_SUCCESS) {
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, StartEmbed);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 
 		properties = &synccontext->properties;
@@ -667,18 +810,15 @@ static void oxcfxics_push_messageChange_attachment_embedded_message(struct emsmd
 				retvals[i] = MAPI_E_NOT_FOUND;
 			}
 		}
-		oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, properties, data_pointers, retvals);
+		oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, properties, data_pointers, retvals);
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagFXDelProp);
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagMessageRecipients);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagFXDelProp);
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagMessageAttachments);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, EndEmbed);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		RAWIDSET_push_guid_glob(sync_data->eid_set, &sync_data->replica_guid, (messageID >> 16) & 0x0000ffffffffffff);
 	}
@@ -720,15 +860,13 @@ static void oxcfxics_push_messageChange_attachments(struct emsmdbp_context *emsm
 			data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, table_object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
 			if (data_pointers) {
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, NewAttach);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, PidTagAttachNumber);
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, i);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 				query_props.cValues = prop_count;
 				query_props.aulPropTag = prop_tags;
-				oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers, (enum MAPISTATUS *) retvals);
+				oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers, (enum MAPISTATUS *) retvals);
 
 				if (retvals[0] == MAPI_E_SUCCESS) {
 					method = *((uint32_t *) data_pointers[0]);
@@ -739,8 +877,7 @@ static void oxcfxics_push_messageChange_attachments(struct emsmdbp_context *emsm
 				}
 
 				ndr_push_uint32(sync_data->ndr, NDR_SCALARS, EndAttach);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-				ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+				emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			}
 			else {
 				DEBUG(5, ("no data returned for attachment row %d\n", i));
@@ -788,6 +925,92 @@ static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ct
 	mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object), table_object->backend_object, &cn_restriction, &state);
 }
 
+static uint32_t oxcfxics_clamp(uint32_t value, uint32_t min, uint32_t max)
+{
+	if (value < min) return min;
+	if (max && value > max) return max;
+
+	return value;
+}
+
+static void oxcfxics_message_sync_data_init(struct emsmdbp_context *emsmdbp_ctx, struct oxcfxics_message_sync_data *message_sync_data)
+{
+	message_sync_data->chunk_size = oxcfxics_clamp(message_sync_initial_chunk_size, emsmdbp_ctx->sync_min_chunk_size, emsmdbp_ctx->sync_max_chunk_size);
+	message_sync_data->preload_window = oxcfxics_clamp(message_preload_initial_window, emsmdbp_ctx->sync_min_preload, emsmdbp_ctx->sync_max_preload);
+	if (!message_sync_data->preload_window) {
+		message_sync_data->preload_window = 1;
+	}
+	message_sync_data->tv_start = timeval_current();
+}
+
+/**
+   \details Ask the backend to preload the bodies of the next window of
+   messages which are not yet preloaded. The window following the one
+   being serialized is requested when serialization reaches its start,
+   so that the backend can fetch it in the meantime.
+ */
+static void oxcfxics_preload_message_window(struct emsmdbp_context *emsmdbp_ctx, uint32_t contextID, struct emsmdbp_object *folder_object, enum mapistore_table_type mstore_type, struct oxcfxics_message_sync_data *message_sync_data)
+{
+	struct UI8Array_r	preload_mids;
+	uint64_t		start;
+
+	start = message_sync_data->count;
+	if (message_sync_data->preload_end > start) {
+		start = message_sync_data->preload_end;
+	}
+	if (start >= message_sync_data->max) {
+		message_sync_data->preload_mark = message_sync_data->max;
+		return;
+	}
+
+	preload_mids.lpui8 = message_sync_data->mids + start;
+	if ((start + message_sync_data->preload_window) < message_sync_data->max) {
+		preload_mids.cValues = message_sync_data->preload_window;
+	}
+	else {
+		preload_mids.cValues = message_sync_data->max - start;
+	}
+	mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
+
+	message_sync_data->preload_mark = start;
+	message_sync_data->preload_end = start + preload_mids.cValues;
+}
+
+/**
+   \details Resize the next chunk and preload window from the observed
+   cost of the messages serialized so far. A chunk holds as many
+   messages as can be serialized within the configured time, within
+   the configured size bounds.
+ */
+static void oxcfxics_adapt_message_sync(struct emsmdbp_context *emsmdbp_ctx, struct oxcfxics_message_sync_data *message_sync_data)
+{
+	double		messages;
+	double		elapsed;
+
+	message_sync_data->chunks++;
+	if (message_sync_data->message_usec > 0 && message_sync_data->message_bytes > 0) {
+		messages = (emsmdbp_ctx->sync_chunk_time * 1000.0) / message_sync_data->message_usec;
+		if (messages < 1) {
+			messages = 1;
+		}
+		message_sync_data->chunk_size = oxcfxics_clamp((uint32_t) MIN(messages * message_sync_data->message_bytes, (double) UINT32_MAX),
+							       emsmdbp_ctx->sync_min_chunk_size, emsmdbp_ctx->sync_max_chunk_size);
+		message_sync_data->preload_window = oxcfxics_clamp((uint32_t) MIN(message_sync_data->chunk_size / message_sync_data->message_bytes + 1, (double) UINT32_MAX),
+								   emsmdbp_ctx->sync_min_preload, emsmdbp_ctx->sync_max_preload);
+		if (!message_sync_data->preload_window) {
+			message_sync_data->preload_window = 1;
+		}
+	}
+
+	elapsed = timeval_elapsed(&message_sync_data->tv_start);
+	if (elapsed > 0) {
+		DEBUG(5, ("[%s:%d]: chunk %u: %"PRIu64" messages, %"PRIu64" bytes, %.1f messages/s, %.0f bytes/s, next chunk %u bytes, preload window %u\n",
+			  __FUNCTION__, __LINE__, message_sync_data->chunks, message_sync_data->sent_messages, message_sync_data->sent_bytes,
+			  message_sync_data->sent_messages / elapsed, message_sync_data->sent_bytes / elapsed,
+			  message_sync_data->chunk_size, message_sync_data->preload_window));
+	}
+}
+
 static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object)
 {
 	TALLOC_CTX			*mem_ctx, *msg_ctx;
@@ -799,8 +1022,10 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	void				**data_pointers, **header_data_pointers;
 	struct FILETIME			*lm_time;
 	NTTIME				nt_time;
-	uint32_t			unix_time, contextID;
+	uint32_t			unix_time, contextID, message_offset;
 	struct UI8Array_r		preload_mids;
+	struct timeval			tv_message;
+	double				elapsed;
 	enum mapistore_table_type	mstore_type;
 	struct SPropTagArray		query_props;
 	struct Binary_r			predecessors_data;
@@ -833,6 +1058,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	else {
 		message_sync_data = talloc_zero(NULL, struct oxcfxics_message_sync_data);
 		sync_data->message_sync_data = message_sync_data;
+		oxcfxics_message_sync_data_init(emsmdbp_ctx, message_sync_data);
 
 		/* we only push "messageChangeFull" since we don't handle property-based changes */
 		/* messageChangeFull = IncrSyncChg messageChangeHeader IncrSyncMessage propList messageChildren */
@@ -877,20 +1103,20 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	}
 
 	/* open each message and fetch properties */
-	for (; sync_data->ndr->offset < max_message_sync_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
+	for (; sync_data->ndr->offset < message_sync_data->chunk_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
 		msg_ctx = talloc_zero(NULL, TALLOC_CTX);
 
-		if (folder_is_mapistore && (message_sync_data->count % message_preload_interval) == 0) {
-			preload_mids.lpui8 = message_sync_data->mids + message_sync_data->count;
-			if ((message_sync_data->count + message_preload_interval) < message_sync_data->max) {
-				preload_mids.cValues = message_preload_interval;
+		if (folder_is_mapistore && message_sync_data->count >= message_sync_data->preload_mark) {
+			if (message_sync_data->preload_end <= message_sync_data->count) {
+				/* nothing is preloaded ahead of us: the current window is needed first */
+				oxcfxics_preload_message_window(emsmdbp_ctx, contextID, folder_object, mstore_type, message_sync_data);
 			}
-			else {
-				preload_mids.cValues = message_sync_data->max - message_sync_data->count;
-			}
-			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
+			oxcfxics_preload_message_window(emsmdbp_ctx, contextID, folder_object, mstore_type, message_sync_data);
 		}
 
+		tv_message = timeval_current();
+		message_offset = sync_data->ndr->offset;
+
 		eid = *(message_sync_data->mids + message_sync_data->count);
 		if (eid == 0x7fffffffffffffffLL) {
 			DEBUG(0, ("message without a valid eid\n"));
@@ -909,7 +1135,6 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		}
 
 		oxcfxics_ndr_check(sync_data->ndr, "sync_data->ndr");
-		oxcfxics_ndr_check(sync_data->cutmarks_ndr, "sync_data->cutmarks_ndr");
 
 		/** fixed header props */
 		header_data_pointers = talloc_array(data_pointers, void *, 9);
@@ -1029,20 +1254,18 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		query_props.cValues = i;
 
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncChg);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
-		oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, header_data_pointers, (enum MAPISTATUS *) header_retvals);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
+		oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, header_data_pointers, (enum MAPISTATUS *) header_retvals);
 
 		/** remaining props */
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncMessage);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		/* we shift the number of remaining properties to the amount of properties explicitly requested in RopSyncConfigure that were used above */
 		if (properties->cValues > message_properties_shift) {
 			query_props.cValues = properties->cValues - message_properties_shift;
 			query_props.aulPropTag = properties->aulPropTag + message_properties_shift;
-			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers + message_properties_shift, (enum MAPISTATUS *) retvals + message_properties_shift);
+			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers + message_properties_shift, (enum MAPISTATUS *) retvals + message_properties_shift);
 		}
 
 		/* messageChildren:
@@ -1054,13 +1277,26 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		oxcfxics_push_messageChange_attachments(emsmdbp_ctx, synccontext, sync_data, message_object);
 
 		synccontext->sent_objects++;
+		message_sync_data->sent_messages++;
+		message_sync_data->sent_bytes += sync_data->ndr->offset - message_offset;
+
+		elapsed = timeval_elapsed(&tv_message) * 1000000;
+		if (message_sync_data->message_usec > 0) {
+			message_sync_data->message_usec += message_sync_average_weight * (elapsed - message_sync_data->message_usec);
+			message_sync_data->message_bytes += message_sync_average_weight * ((sync_data->ndr->offset - message_offset) - message_sync_data->message_bytes);
+		}
+		else {
+			message_sync_data->message_usec = elapsed;
+			message_sync_data->message_bytes = sync_data->ndr->offset - message_offset;
+		}
 	end_row:
 		talloc_free(msg_ctx);
 	}
 
-	if (sync_data->ndr->offset >= max_message_sync_size) {
-		DEBUG(5, ("reached max sync size: %u >= %zu\n", sync_data->ndr->offset, max_message_sync_size));
+	if (sync_data->ndr->offset >= message_sync_data->chunk_size) {
+		DEBUG(5, ("reached max sync size: %u >= %u\n", sync_data->ndr->offset, message_sync_data->chunk_size));
 	}
+	oxcfxics_adapt_message_sync(emsmdbp_ctx, message_sync_data);
 
 	if (message_sync_data->count < message_sync_data->max) {
 		end_of_table = false;
@@ -1087,6 +1323,12 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
 		}
 		DEBUG(5, ("end of table reached: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max));
+		elapsed = timeval_elapsed(&message_sync_data->tv_start);
+		DEBUG(3, ("[%s:%d]: %s table synchronized: %"PRIu64" messages, %"PRIu64" bytes in %u chunks, %.3fs, %.1f messages/s, %.0f bytes/s\n",
+			  __FUNCTION__, __LINE__, (mstore_type == MAPISTORE_FAI_TABLE) ? "FAI" : "message",
+			  message_sync_data->sent_messages, message_sync_data->sent_bytes, message_sync_data->chunks, elapsed,
+			  elapsed > 0 ? message_sync_data->sent_messages / elapsed : 0.0,
+			  elapsed > 0 ? message_sync_data->sent_bytes / elapsed : 0.0));
 		talloc_free(message_sync_data);
 		sync_data->message_sync_data = NULL;
 		end_of_table = true;
@@ -1126,14 +1368,12 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 	else {
 		sync_data = synccontext->sync_data;
 		talloc_free(sync_data->ndr);
-		talloc_free(sync_data->cutmarks_ndr);
+		talloc_free(sync_data->cutmarks);
 	}
 	sync_data->ndr = ndr_push_init_ctx(sync_data);
 	ndr_set_flags(&sync_data->ndr->flags, LIBNDR_FLAG_NOALIGN);
 	sync_data->ndr->offset = 0;
-	sync_data->cutmarks_ndr = ndr_push_init_ctx(sync_data);
-	ndr_set_flags(&sync_data->cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
-	sync_data->cutmarks_ndr->offset = 0;
+	sync_data->cutmarks = emsmdbp_cutmarks_init(sync_data);
 
 	if (synccontext->sync_stage == 1) {
 		/* 2a. we build the message stream (normal messages) */
@@ -1194,22 +1434,18 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 			new_idset->idbased = true;
 			new_idset->repl.id = 1;
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncDel);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagIdsetDeleted);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			ndr_push_idset(sync_data->ndr, new_idset);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			/* IDSET_dump (new_idset, "cnset_deleted"); */
 			talloc_free(new_idset);
 		}
 
 		/* state */
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncStateBegin);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->eid_set);
 		old_idset = synccontext->idset_given;
@@ -1221,20 +1457,16 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 
 		IDSET_dump (synccontext->cnset_seen, "cnset_seen");
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagCnsetSeen);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 		ndr_push_idset(sync_data->ndr, synccontext->cnset_seen);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		if (synccontext->request.fai) {
 			IDSET_dump (synccontext->cnset_seen_fai, "cnset_seen_fai");
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagCnsetSeenFAI);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 			ndr_push_idset(sync_data->ndr, synccontext->cnset_seen_fai);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 		}
 		IDSET_dump (synccontext->idset_given, "idset_given");
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagIdsetGiven);
@@ -1245,29 +1477,24 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 			ndr_push_idset(sync_data->ndr, synccontext->cnset_read);
 		}
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncStateEnd);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		/* end of stream */
 		ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncEnd);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-		ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+		emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 		synccontext->sync_stage = 4;
 	}
 
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0xffffffff);
 
-	synccontext->cutmarks = (uint32_t *) sync_data->cutmarks_ndr->data;
-	synccontext->next_cutmark_idx = 1;
+	synccontext->cutmarks = sync_data->cutmarks;
 	synccontext->stream.position = 0;
 	synccontext->stream.buffer.data = sync_data->ndr->data;
 	synccontext->stream.buffer.length = sync_data->ndr->offset;
 
 	if (synccontext->sync_stage == 4) {
 		(void) talloc_reference(synccontext, sync_data->ndr->data);
-		(void) talloc_reference(synccontext, sync_data->cutmarks_ndr->data);
+		(void) talloc_reference(synccontext, sync_data->cutmarks);
 		talloc_free(sync_data);
 		synccontext->sync_data = NULL;
 	}
@@ -1438,15 +1665,14 @@ static void oxcfxics_push_folderChange(struct emsmdbp_context *emsmdbp_ctx, stru
 			query_props.cValues = j;
 
 			ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncChg);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-			ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
-			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, header_data_pointers, (enum MAPISTATUS *) header_retvals);
+			emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
+			oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, header_data_pointers, (enum MAPISTATUS *) header_retvals);
 
 			/** remaining props */
 			if (table_object->object.table->prop_count > folder_properties_shift) {
 				query_props.cValues = table_object->object.table->prop_count - folder_properties_shift;
 				query_props.aulPropTag = table_object->object.table->properties + folder_properties_shift;
-				oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks_ndr, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers + folder_properties_shift, (enum MAPISTATUS *) retvals + folder_properties_shift);
+				oxcfxics_ndr_push_properties(sync_data->ndr, sync_data->cutmarks, emsmdbp_ctx->mstore_ctx->nprops_ctx, &query_props, data_pointers + folder_properties_shift, (enum MAPISTATUS *) retvals + folder_properties_shift);
 			}
 
 			synccontext->sent_objects++;
@@ -1487,9 +1713,7 @@ static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object
 	sync_data->ndr = ndr_push_init_ctx(sync_data);
 	ndr_set_flags(&sync_data->ndr->flags, LIBNDR_FLAG_NOALIGN);
 	sync_data->ndr->offset = 0;
-	sync_data->cutmarks_ndr = ndr_push_init_ctx(sync_data);
-	ndr_set_flags(&sync_data->cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
-	sync_data->cutmarks_ndr->offset = 0;
+	sync_data->cutmarks = emsmdbp_cutmarks_init(sync_data);
 	sync_data->cnset_seen = RAWIDSET_make(sync_data, false, true);
 	sync_data->eid_set = RAWIDSET_make(sync_data, false, false);
 
@@ -1509,11 +1733,9 @@ static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object
 	talloc_free(new_idset);
 
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagCnsetSeen);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 	ndr_push_idset(sync_data->ndr, synccontext->cnset_seen);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 	new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->eid_set);
 	old_idset = synccontext->idset_given;
@@ -1524,68 +1746,70 @@ static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object
 	talloc_free(new_idset);
 
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, MetaTagIdsetGiven);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 	ndr_push_idset(sync_data->ndr, synccontext->idset_given);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncStateEnd);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
 	/* end of stream */
 	ndr_push_uint32(sync_data->ndr, NDR_SCALARS, IncrSyncEnd);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, sync_data->ndr->offset);
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
+	emsmdbp_cutmarks_push(sync_data->cutmarks, 0, sync_data->ndr->offset);
 
-	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0xffffffff);
-
-	synccontext->cutmarks = (uint32_t *) sync_data->cutmarks_ndr->data;
-	synccontext->next_cutmark_idx = 1;
+	synccontext->cutmarks = sync_data->cutmarks;
 	synccontext->stream.position = 0;
 	synccontext->stream.buffer.data = sync_data->ndr->data;
 	synccontext->stream.buffer.length = sync_data->ndr->offset;
 
 	(void) talloc_reference(synccontext, sync_data->ndr->data);
-	(void) talloc_reference(synccontext, sync_data->cutmarks_ndr->data);
+	(void) talloc_reference(synccontext, sync_data->cutmarks);
 	talloc_free(sync_data);
 }
 
 static inline void oxcfxics_fill_ftcontext_fasttransfer_response(struct FastTransferSourceGetBuffer_repl *response, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_ftcontext *ftcontext, struct emsmdbp_context *emsmdbp_ctx)
 {
-	uint32_t buffer_size, min_value_buffer, mark_idx, max_cutmark;
+	uint32_t buffer_size;
+	size_t total_length;
 
 	buffer_size = request_buffer_size;
 
 	if (ftcontext->stream.position == 0) {
 		ftcontext->steps = 0;
-		ftcontext->total_steps = (ftcontext->stream.buffer.length / request_buffer_size) + 1;
-		ftcontext->next_cutmark_idx = 1;
-		oxcfxics_check_cutmark_buffer(ftcontext->cutmarks, &ftcontext->stream.buffer);
-		DEBUG(5, ("fast transfer buffer is %d bytes long\n", (uint32_t) ftcontext->stream.buffer.length));
+		if (ftcontext->cutmarks) {
+			ftcontext->cutmarks->next = 0;
+		}
+		if (ftcontext->producer) {
+			total_length = ftcontext->producer->estimated_length;
+		}
+		else {
+			total_length = ftcontext->stream.buffer.length;
+			oxcfxics_check_cutmark_buffer(ftcontext->cutmarks, &ftcontext->stream.buffer);
+		}
+		ftcontext->total_steps = (total_length / request_buffer_size) + 1;
+		DEBUG(5, ("fast transfer buffer is %d bytes long\n", (uint32_t) total_length));
 	}
 	ftcontext->steps += 1;
 
-	if (ftcontext->stream.position + request_buffer_size < ftcontext->stream.buffer.length) {
-		mark_idx = ftcontext->next_cutmark_idx;
-		max_cutmark = ftcontext->stream.position + request_buffer_size;
-		/* FIXME: cutmark lookups would be faster using a binary search */
-		while (ftcontext->cutmarks[mark_idx] != 0xffffffff && ftcontext->cutmarks[mark_idx] < max_cutmark) {
-			buffer_size = ftcontext->cutmarks[mark_idx] - ftcontext->stream.position;
-			mark_idx += 2;
-		}
-		if (buffer_size < request_buffer_size && ftcontext->cutmarks[mark_idx] != 0xffffffff) {
-			min_value_buffer = ftcontext->cutmarks[mark_idx-1];
-			if (min_value_buffer && (request_buffer_size - buffer_size > min_value_buffer)) {
-				buffer_size = request_buffer_size;
-			}
+	if (ftcontext->producer) {
+		emsmdbp_ftcontext_producer_fill(ftcontext, request_buffer_size);
+		/* values fetched on demand make the estimate grow */
+		total_length = ftcontext->producer->estimated_length;
+		if ((total_length / request_buffer_size) + 1 > ftcontext->total_steps) {
+			ftcontext->total_steps = (total_length / request_buffer_size) + 1;
 		}
-		ftcontext->next_cutmark_idx = mark_idx;
+	}
+
+	if (ftcontext->stream.position + request_buffer_size < ftcontext->stream.buffer.length) {
+		buffer_size = emsmdbp_cutmarks_next_buffer_size(ftcontext->cutmarks, ftcontext->stream.position, request_buffer_size);
 	}
 	
 	response->TransferBuffer = emsmdbp_stream_read_buffer(&ftcontext->stream, buffer_size);
+	if (ftcontext->producer) {
+		/* the window is overwritten by the next GetBuffer on
+		 * this context, possibly within the same request */
+		response->TransferBuffer.data = talloc_memdup(mem_ctx, response->TransferBuffer.data, response->TransferBuffer.length);
+	}
 	response->TotalStepCount = ftcontext->total_steps;
 	if (ftcontext->stream.position == ftcontext->stream.buffer.length) {
 		response->TransferStatus = TransferStatus_Done;
@@ -1599,29 +1823,9 @@ static inline void oxcfxics_fill_ftcontext_fasttransfer_response(struct FastTran
 
 static uint32_t oxcfxics_advance_cutmarks(struct emsmdbp_object_synccontext *synccontext, uint32_t request_buffer_size)
 {
-	uint32_t buffer_size, min_value_buffer, mark_idx, max_cutmark;
-
-	buffer_size = request_buffer_size;
-
-	mark_idx = synccontext->next_cutmark_idx;
-	max_cutmark = synccontext->stream.position + request_buffer_size;
-	/* FIXME: cutmark lookups would be faster using a binary search */
-	while (synccontext->cutmarks[mark_idx] != 0xffffffff && synccontext->cutmarks[mark_idx] < max_cutmark) {
-		buffer_size = synccontext->cutmarks[mark_idx] - synccontext->stream.position;
-		mark_idx += 2;
-	}
-	if (buffer_size < request_buffer_size && synccontext->cutmarks[mark_idx] != 0xffffffff) {
-		min_value_buffer = synccontext->cutmarks[mark_idx-1];
-		if (min_value_buffer && (request_buffer_size - buffer_size > min_value_buffer)) {
-			buffer_size = request_buffer_size;
-		}
-	}
-	synccontext->next_cutmark_idx = mark_idx;
-
-	return buffer_size;
+	return emsmdbp_cutmarks_next_buffer_size(synccontext->cutmarks, synccontext->stream.position, request_buffer_size);
 }
 
-
 static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTransferSourceGetBuffer_repl *response, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_object *parent_object)
 {
 	char		*owner;
@@ -3407,9 +3611,7 @@ static enum MAPISTATUS oxcfxics_ndr_push_transfer_state(struct ndr_push *ndr, co
 	OPENCHANGE_RETVAL_IF(!synccontext->properties.aulPropTag, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 	synccontext->properties.aulPropTag[1] = PidTagChangeNumber;
 	sync_data->ndr = ndr;
-	sync_data->cutmarks_ndr = ndr_push_init_ctx(sync_data);
-	ndr_set_flags(&sync_data->cutmarks_ndr->flags, LIBNDR_FLAG_NOALIGN);
-	sync_data->cutmarks_ndr->offset = 0;
+	sync_data->cutmarks = emsmdbp_cutmarks_init(sync_data);
 	sync_data->cnset_seen = RAWIDSET_make(sync_data, false, true);
 	sync_data->eid_set = RAWIDSET_make(sync_data, false, false);
 
@@ -3550,16 +3752,8 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncGetTransferState(TALLOC_CTX *mem_ctx,
 
 	talloc_free(ndr);
 
-	/* cutmarks */
-	ndr = ndr_push_init_ctx(ftcontext);
-	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
-	ndr->offset = 0;
-	ndr_push_uint32(ndr, NDR_SCALARS, 0);
-	ndr_push_uint32(ndr, NDR_SCALARS, 0xffffffff);
-
-	ftcontext->cutmarks = (uint32_t *) ndr->data;
-	(void) talloc_reference(ftcontext, ndr->data);
-	talloc_free(ndr);
+	/* no cutmarks, the state stream can be cut anywhere */
+	ftcontext->cutmarks = emsmdbp_cutmarks_init(ftcontext);
 
 end:
 	*size += libmapiserver_RopSyncGetTransferState_size(mapi_repl);
@@ -567,8 +567,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSaveChangesMessage(TALLOC_CTX *mem_ctx,
 	uint64_t		messageID;
 	uint32_t		contextID;
 	char			*owner;
+	char			*uri;
+	bool			soft_deleted;
 	uint8_t			flags;
 	enum mapistore_error	ret;
+	enum mapistore_notification_type		event;
+	struct mapistore_object_notification_parameters	parameters;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCMSG] SaveChangesMessage (0x0c)\n"));
 
@@ -608,13 +612,27 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSaveChangesMessage(TALLOC_CTX *mem_ctx,
 	case true:
                 contextID = emsmdbp_get_contextID(object);
 		messageID = object->object.message->messageID;
+		owner = emsmdbp_get_owner(object);
+		/* Messages are indexed when they are first saved */
+		event = MAPISTORE_OBJECT_MODIFIED;
+		if (mapistore_indexing_record_get_uri(emsmdbp_ctx->mstore_ctx, owner, mem_ctx, messageID,
+						      &uri, &soft_deleted) != MAPISTORE_SUCCESS) {
+			event = MAPISTORE_OBJECT_CREATED;
+		}
 		ret = mapistore_message_save(emsmdbp_ctx->mstore_ctx, contextID, object->backend_object, mem_ctx);
 		if (ret == MAPISTORE_ERR_DENIED) {
 			mapi_repl->error_code = MAPI_E_NO_ACCESS;
 			goto end;
 		}
-		owner = emsmdbp_get_owner(object);
 		mapistore_indexing_record_add_mid(emsmdbp_ctx->mstore_ctx, contextID, owner, messageID);
+
+		/* Let the other sessions of the owner know about the change */
+		if (object->parent_object && object->parent_object->type == EMSMDBP_OBJECT_FOLDER) {
+			memset(&parameters, 0, sizeof (parameters));
+			parameters.folder_id = object->parent_object->object.folder->folderID;
+			parameters.object_id = messageID;
+			emsmdbp_async_push_notification(emsmdbp_ctx->mstore_ctx, owner, MAPISTORE_MESSAGE, event, &parameters);
+		}
 		break;
 	}
 
@@ -1160,11 +1160,18 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetPropertyIdsFromNames(TALLOC_CTX *mem_ctx,
 	mapi_repl->u.mapi_GetIDsFromNames.propID = talloc_array(mem_ctx, uint16_t, 
 								mapi_req->u.mapi_GetIDsFromNames.count);
 
-	for (i = 0; i < mapi_req->u.mapi_GetIDsFromNames.count; i++) {
-		ret = mapistore_namedprops_get_mapped_id(emsmdbp_ctx->mstore_ctx->nprops_ctx, 
-							 mapi_req->u.mapi_GetIDsFromNames.nameid[i],
-							 &mapi_repl->u.mapi_GetIDsFromNames.propID[i]);
-		if (ret == MAPISTORE_SUCCESS)
+	ret = mapistore_namedprops_get_mapped_ids(emsmdbp_ctx->mstore_ctx->nprops_ctx,
+						  mapi_req->u.mapi_GetIDsFromNames.count,
+						  mapi_req->u.mapi_GetIDsFromNames.nameid,
+						  mapi_repl->u.mapi_GetIDsFromNames.propID);
+	for (i = 0; ret != MAPISTORE_SUCCESS && i < mapi_req->u.mapi_GetIDsFromNames.count; i++) {
+		if (mapi_repl->u.mapi_GetIDsFromNames.propID[i])
+			continue;
+		/* The name may have been created earlier in this request */
+		if (has_transaction &&
+		    mapistore_namedprops_get_mapped_id(emsmdbp_ctx->mstore_ctx->nprops_ctx,
+						       mapi_req->u.mapi_GetIDsFromNames.nameid[i],
+						       &mapi_repl->u.mapi_GetIDsFromNames.propID[i]) == MAPISTORE_SUCCESS)
 			continue;
 		// It doesn't exist, let's create it!
 		if (mapi_req->u.mapi_GetIDsFromNames.ulFlags == GetIDsFromNames_GetOrCreate) {
@@ -1246,7 +1253,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetNamesFromIDs(TALLOC_CTX *mem_ctx,
 	uint16_t			i;
 	struct GetNamesFromIDs_req	*request;
 	struct GetNamesFromIDs_repl	*response;
-	struct MAPINAMEID		*nameid;
+	struct MAPINAMEID		**nameids = NULL;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCPRPT] GetNamesFromIDs (0x55)\n"));
 
@@ -1266,14 +1273,16 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetNamesFromIDs(TALLOC_CTX *mem_ctx,
 
 	response->nameid = talloc_array(mem_ctx, struct MAPINAMEID, request->PropertyIdCount);
 	response->count = request->PropertyIdCount;
+	mapistore_namedprops_get_nameids(emsmdbp_ctx->mstore_ctx->nprops_ctx, request->PropertyIdCount,
+					 request->PropertyIds, mem_ctx, &nameids);
 	for (i = 0; i < request->PropertyIdCount; i++) {
 		if (request->PropertyIds[i] < 0x8000) {
 			response->nameid[i].ulKind = MNID_ID;
 			GUID_from_string(PS_MAPI, &response->nameid[i].lpguid);
 			response->nameid[i].kind.lid = (uint32_t) request->PropertyIds[i] << 16 | get_property_type(request->PropertyIds[i]);
 		}
-		else if (mapistore_namedprops_get_nameid(emsmdbp_ctx->mstore_ctx->nprops_ctx, request->PropertyIds[i], mem_ctx, &nameid) == MAPISTORE_SUCCESS) {
-			response->nameid[i] = *nameid;
+		else if (nameids && nameids[i]) {
+			response->nameid[i] = *nameids[i];
 		}
 		else {
 			response->nameid[i].ulKind = 0xff;
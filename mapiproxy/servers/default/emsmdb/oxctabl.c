@@ -31,6 +31,9 @@
 #include "dcesrv_exchange_emsmdb.h"
 #include "libmapi/libmapi_private.h"
 
+/* Number of rows fetched at once by FindRow while looking for a match */
+#define	OXCTABL_FINDROW_WINDOW	32
+
 /**
    \details EcDoRpc SetColumns (0x12) Rop. This operation sets the
    properties to be included in the table.
@@ -375,9 +378,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 	struct QueryRows_repl		*response;
 	enum MAPISTATUS			retval;
 	void				*data;
-	enum MAPISTATUS			*retvals;
+	enum MAPISTATUS			**rows_retvals = NULL;
+	void				***rows = NULL;
 	void				**data_pointers;
 	uint32_t			count, max;
+	uint32_t			rows_count = 0;
 	uint32_t			handle;
 	uint32_t			i = 0;
 
@@ -439,19 +444,23 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 		abort();
 	}
 
-        /* Lookup the properties */
+        /* Lookup the properties of the whole window at once */
 	max = table->numerator + request->RowCount;
 	if (max > table->denominator) {
 		max = table->denominator;
 	}
+	if (max > table->numerator) {
+		rows = emsmdbp_object_table_get_rows_props(mem_ctx, emsmdbp_ctx, object, table->numerator,
+							   max - table->numerator, MAPISTORE_PREFILTERED_QUERY,
+							   &rows_retvals, &rows_count);
+	}
         for (i = table->numerator; i < max; i++) {
-		data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
+		data_pointers = (rows && (i - table->numerator) < rows_count) ? rows[i - table->numerator] : NULL;
 		if (data_pointers) {
 			emsmdbp_fill_table_row_blob(mem_ctx, emsmdbp_ctx,
 						    &response->RowData, table->prop_count,
-						    table->properties, data_pointers, retvals);
-			talloc_free(retvals);
-			talloc_free(data_pointers);
+						    table->properties, data_pointers,
+						    rows_retvals[i - table->numerator]);
 			count++;
 		}
 		else {
@@ -461,6 +470,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 	}
 
 finish:
+	talloc_free(rows);
 	if ((request->QueryRowsFlags & TBL_NOADVANCE) != TBL_NOADVANCE) {
 		table->numerator = i;
 	}
@@ -677,6 +687,102 @@ end:
 }
 
 
+/**
+   \details Move the table cursor to the next row matching the
+   current restriction and push its properties into a PropertyRow
+   blob. Rows are fetched by windows of OXCTABL_FINDROW_WINDOW.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param object pointer to the table object
+   \param row pointer to the DATA_BLOB receiving the row
+
+   \return true if a row was found, otherwise false
+ */
+static bool oxctabl_find_next_row(TALLOC_CTX *mem_ctx,
+				  struct emsmdbp_context *emsmdbp_ctx,
+				  struct emsmdbp_object *object,
+				  DATA_BLOB *row)
+{
+	struct emsmdbp_object_table	*table = object->object.table;
+	void				***rows = NULL;
+	enum MAPISTATUS			**rows_retvals = NULL;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	enum MAPISTATUS			retval;
+	void				*data;
+	uint32_t			window_start = 0;
+	uint32_t			window_size;
+	uint32_t			rows_count = 0;
+	uint32_t			property;
+	uint32_t			i;
+	uint8_t				flagged;
+	bool				found = false;
+
+	while (!found && table->numerator < table->denominator) {
+		if (!rows || table->numerator >= window_start + rows_count) {
+			talloc_free(rows);
+			window_start = table->numerator;
+			window_size = table->denominator - window_start;
+			if (window_size > OXCTABL_FINDROW_WINDOW) {
+				window_size = OXCTABL_FINDROW_WINDOW;
+			}
+			rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, object, window_start, window_size,
+								   MAPISTORE_LIVEFILTERED_QUERY, &rows_retvals, &rows_count);
+			if (!rows || !rows_count) {
+				break;
+			}
+		}
+
+		data_pointers = rows[table->numerator - window_start];
+		if (!data_pointers) {
+			table->numerator++;
+			continue;
+		}
+		retvals = rows_retvals[table->numerator - window_start];
+		found = true;
+
+		flagged = 0;
+		for (i = 0; i < table->prop_count; i++) {
+			if (retvals[i] != MAPI_E_SUCCESS) {
+				flagged = 1;
+			}
+		}
+
+		if (flagged) {
+			libmapiserver_push_property(mem_ctx, 
+						    0x0000000b, (const void *)&flagged,
+						    row, 0, 0, 0);
+		}
+		else {
+			libmapiserver_push_property(mem_ctx, 
+						    0x00000000, (const void *)&flagged,
+						    row, 0, 1, 0);
+		}
+
+		/* Push the properties */
+		for (i = 0; i < table->prop_count; i++) {
+			property = table->properties[i];
+			retval = retvals[i];
+			if (retval == MAPI_E_NOT_FOUND) {
+				property = (property & 0xFFFF0000) + PT_ERROR;
+				data = &retval;
+			}
+			else {
+				data = data_pointers[i];
+			}
+
+			libmapiserver_push_property(mem_ctx,
+						    property, data, row,
+						    flagged?PT_ERROR:0, flagged, 0);
+		}
+	}
+	talloc_free(rows);
+
+	return found;
+}
+
+
 /**
    \details EcDoRpc FindRow (0x4f) Rop. This operation moves the
    cursor to a row in a table that matches specific search criteria.
@@ -703,14 +809,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 	enum MAPISTATUS			retval;
 	enum mapistore_error		mretval;
 	void				*data = NULL;
-	enum MAPISTATUS			*retvals;
-	void				**data_pointers;
 	uint32_t			handle;
 	DATA_BLOB			row;
-	uint32_t			property;
-	uint8_t				flagged;
 	uint8_t				status = 0;
-	uint32_t			i;
 	bool				found = false;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCTABL] FindRow (0x4f)\n"));
@@ -782,54 +883,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 			DEBUG(5, ("[%s:%d] mapistore_table_set_restrictions: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(mretval)));
 		}
 		/* Then fetch rows */
-		/* Lookup the properties and check if we need to flag the PropertyRow blob */
-
-		while (!found && table->numerator < table->denominator) {
-                        flagged = 0;
-
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
-				found = true;
-				for (i = 0; i < table->prop_count; i++) {
-					if (retvals[i] != MAPI_E_SUCCESS) {
-						flagged = 1;
-					}
-				}
-
-				if (flagged) {
-					libmapiserver_push_property(mem_ctx, 
-								    0x0000000b, (const void *)&flagged,
-								    &row, 0, 0, 0);
-				}
-				else {
-					libmapiserver_push_property(mem_ctx, 
-								    0x00000000, (const void *)&flagged,
-								    &row, 0, 1, 0);
-				}
-                                
-				/* Push the properties */
-				for (i = 0; i < table->prop_count; i++) {
-					property = table->properties[i];
-					retval = retvals[i];
-					if (retval == MAPI_E_NOT_FOUND) {
-						property = (property & 0xFFFF0000) + PT_ERROR;
-						data = &retval;
-					}
-					else {
-						data = data_pointers[i];
-					}
-                                
-					libmapiserver_push_property(mem_ctx,
-								    property, data, &row,
-								    flagged?PT_ERROR:0, flagged, 0);
-				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        }
-                        else {
-				table->numerator++;
-			}
-		}
+		found = oxctabl_find_next_row(mem_ctx, emsmdbp_ctx, object, &row);
 
 		mretval = mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object), object->backend_object, NULL, &status);
 		if (mretval != MAPISTORE_SUCCESS) {
@@ -853,52 +907,8 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 		/* Restrict rows to be fetched */
 		retval = openchangedb_table_set_restrictions(emsmdbp_ctx->oc_ctx, object->backend_object, &request.res);
 		/* Then fetch rows */
-		/* Lookup the properties and check if we need to flag the PropertyRow blob */
-		while (!found && table->numerator < table->denominator) {
-                        flagged = 0;
-
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
-				found = true;
-				for (i = 0; i < table->prop_count; i++) {
-					if (retvals[i] != MAPI_E_SUCCESS) {
-						flagged = 1;
-					}
-				}
-
-				if (flagged) {
-					libmapiserver_push_property(mem_ctx, 
-								    0x0000000b, (const void *)&flagged,
-								    &row, 0, 0, 0);
-				}
-				else {
-					libmapiserver_push_property(mem_ctx, 
-								    0x00000000, (const void *)&flagged,
-								    &row, 0, 1, 0);
-				}
-                                
-				/* Push the properties */
-				for (i = 0; i < table->prop_count; i++) {
-					property = table->properties[i];
-					retval = retvals[i];
-					if (retval == MAPI_E_NOT_FOUND) {
-						property = (property & 0xFFFF0000) + PT_ERROR;
-						data = &retval;
-					}
-					else {
-						data = data_pointers[i];
-					}
-                                
-					libmapiserver_push_property(mem_ctx,
-								    property, data, &row,
-								    flagged?PT_ERROR:0, flagged, 0);
-				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        } else {
-				table->numerator++;
-			}
-		}
+		found = oxctabl_find_next_row(mem_ctx, emsmdbp_ctx, object, &row);
+
 		/* Reset restrictions */
 		openchangedb_table_set_restrictions(emsmdbp_ctx->oc_ctx, object->backend_object, NULL);
 
@@ -30,19 +30,12 @@
 #include "dcesrv_exchange_nsp.h"
 
 static struct exchange_nsp_session	*nsp_session = NULL;
+static struct mpm_session_registry	*nsp_session_registry = NULL;
 static TDB_CONTEXT			*emsabp_tdb_ctx = NULL;
 
 static struct exchange_nsp_session *dcesrv_find_nsp_session(struct GUID *uuid)
 {
-	struct exchange_nsp_session *session, *found_session = NULL;
-
-	for (session = nsp_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
-		}
-	}
-
-	return found_session;
+	return (struct exchange_nsp_session *) mpm_session_registry_find(nsp_session_registry, uuid);
 }
 
 static struct emsabp_context *dcesrv_find_emsabp_context(struct GUID *uuid)
@@ -174,6 +167,7 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 		mpm_session_set_destructor(session->session, emsabp_destructor);
 
 		DLIST_ADD_END(nsp_session, session, struct exchange_nsp_session *);
+		mpm_session_registry_add(nsp_session_registry, &session->uuid, session);
 	}
 
 	DCESRV_NSP_RETURN(r, MAPI_E_SUCCESS, NULL);
@@ -216,6 +210,7 @@ static void dcesrv_NspiUnbind(struct dcesrv_call_state *dce_call,
 		session = dcesrv_find_nsp_session(&r->in.handle->uuid);
 		if (session) {
 			if (mpm_session_release(session->session)) {
+				mpm_session_registry_del(nsp_session_registry, &session->uuid);
 				DLIST_REMOVE(nsp_session, session);
 				DEBUG(5, ("[%s:%d]: Session found and released\n",
 					  __FUNCTION__, __LINE__));
@@ -254,6 +249,7 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
 	uint32_t			row, row_max;
 	TALLOC_CTX			*local_mem_ctx;
 	struct PropertyTagArray_r	*mids;
+	struct emsabp_gal_snapshot	*gal = NULL;
 
 	DEBUG(3, ("exchange_nsp: NspiUpdateStat (0x2)"));
 
@@ -276,21 +272,27 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
 		goto end;
 	}
 
-	mids = talloc_zero(local_mem_ctx, struct PropertyTagArray_r);
-        if (!mids) {
-                DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
-        }
-
-        ret = emsabp_search(local_mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
-	if (ret != MAPI_E_SUCCESS) {
-		row_max = 0;
-                if (ret == MAPI_E_CALL_FAILED) {
-                        retval = ret;
-                        goto end;
-                }
-	}
-	else {
+	if (emsabp_gal_get(emsabp_ctx, r->in.pStat->ContainerID, &gal) == MAPI_E_SUCCESS) {
+		mids = &gal->MIds;
 		row_max = mids->cValues;
+	} else {
+		gal = NULL;
+		mids = talloc_zero(local_mem_ctx, struct PropertyTagArray_r);
+		if (!mids) {
+			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+		}
+
+		ret = emsabp_search(local_mem_ctx, emsabp_ctx, mids, NULL, r->in.pStat, 0);
+		if (ret != MAPI_E_SUCCESS) {
+			row_max = 0;
+			if (ret == MAPI_E_CALL_FAILED) {
+				retval = ret;
+				goto end;
+			}
+		}
+		else {
+			row_max = mids->cValues;
+		}
 	}
 
 	if (r->in.pStat->CurrentRec == MID_CURRENT) {
@@ -307,6 +309,12 @@ static void dcesrv_NspiUpdateStat(struct dcesrv_call_state *dce_call, TALLOC_CTX
 		else if (r->in.pStat->CurrentRec == MID_END_OF_TABLE) {
 			row = row_max;
 		}
+		else if (gal) {
+			retval = emsabp_gal_find_MId(gal, r->in.pStat->CurrentRec, &row);
+			if (retval == MAPI_E_NOT_FOUND) {
+				goto end;
+			}
+		}
 		else {
 			retval = MAPI_E_NOT_FOUND;
 			row = 0;
@@ -406,21 +414,29 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call,
 	/* Step 2. Fill ppRows  */
 	if (r->in.lpETable == NULL) {
 		/* Step 2.1 Fill ppRows for supplied Container ID */
-		struct ldb_result	*ldb_res;
+		struct ldb_result		*ldb_res = NULL;
+		struct emsabp_gal_snapshot	*gal = NULL;
+		uint32_t			total;
 
-		retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
-						  r->in.pStat->ContainerID, &ldb_res);
-		if (retval != MAPI_E_SUCCESS)  {
-			goto failure;
+		if (emsabp_gal_get(emsabp_ctx, r->in.pStat->ContainerID, &gal) == MAPI_E_SUCCESS) {
+			total = gal->count;
+		} else {
+			gal = NULL;
+			retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
+							  r->in.pStat->ContainerID, &ldb_res);
+			if (retval != MAPI_E_SUCCESS)  {
+				goto failure;
+			}
+			total = ldb_res->count;
 		}
 
-		if (ldb_res->count < r->in.pStat->NumPos) {
+		if (total < r->in.pStat->NumPos) {
 			/* Bad position */
 			retval = MAPI_E_INVALID_PARAMETER;
 			goto failure;
 		}
 
-		count = ldb_res->count - r->in.pStat->NumPos;
+		count = total - r->in.pStat->NumPos;
 
 		if (r->in.Count < count) {
 			count = r->in.Count;
@@ -432,8 +448,16 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call,
 
 		/* fetch required attributes for every entry found */
 		for (i = 0; i < count; i++) {
-			retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
-							     ldb_res->msgs[i+r->in.pStat->NumPos], 0, r->in.dwFlags, pPropTags);
+			if (gal) {
+				retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
+								     gal->entries[i+r->in.pStat->NumPos].msg,
+								     gal->entries[i+r->in.pStat->NumPos].MId,
+								     r->in.dwFlags, pPropTags);
+			} else {
+				retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
+								     ldb_res->msgs[i+r->in.pStat->NumPos], 0,
+								     r->in.dwFlags, pPropTags);
+			}
 			if (retval != MAPI_E_SUCCESS) {
 				goto failure;
 			}
@@ -493,6 +517,7 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call,
 	uint32_t			row;
 	struct PropertyTagArray_r	*mids, *all_mids;
 	struct Restriction_r		*seek_restriction;
+	struct emsabp_gal_snapshot	*gal = NULL;
 
 	DEBUG(3, ("exchange_nsp: NspiSeekEntries (0x4)\n"));
 
@@ -512,34 +537,55 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call,
 		goto end;
 	}
 
-	if (r->in.lpETable) {
-		all_mids = r->in.lpETable;
-	}
-	else {
-		all_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-		emsabp_search(mem_ctx, emsabp_ctx, all_mids, NULL, r->in.pStat, 0);
-	}
+	/* Display names are sorted in the container snapshot, seek there */
+	if (!r->in.lpETable && (r->in.pTarget->ulPropTag == PR_DISPLAY_NAME ||
+				r->in.pTarget->ulPropTag == PR_DISPLAY_NAME_UNICODE) &&
+	    emsabp_gal_get(emsabp_ctx, r->in.pStat->ContainerID, &gal) == MAPI_E_SUCCESS) {
+		all_mids = &gal->MIds;
+		row = emsabp_gal_seek(gal, (const char *)get_PropertyValue_data(r->in.pTarget));
 
-	/* find the records matching the qualifier */
-	seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
-	seek_restriction->rt = RES_PROPERTY;
-	seek_restriction->res.resProperty.relop = RELOP_GE;
-	seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
-	seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		mids->cValues = all_mids->cValues - row;
+		mids->aulPropTag = all_mids->aulPropTag + row;
+		if (!mids->cValues) {
+			mids = all_mids;
+			row = 0;
+			retval = MAPI_E_NOT_FOUND;
+		}
 
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
-		mids = all_mids;
-		retval = MAPI_E_NOT_FOUND;
-	}
+		r->in.pStat->TotalRecs = all_mids->cValues;
+		r->in.pStat->NumPos = row;
+		r->in.pStat->CurrentRec = all_mids->cValues ? all_mids->aulPropTag[row] : MID_END_OF_TABLE;
+	} else {
+		if (r->in.lpETable) {
+			all_mids = r->in.lpETable;
+		}
+		else {
+			all_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+			emsabp_search(mem_ctx, emsabp_ctx, all_mids, NULL, r->in.pStat, 0);
+		}
 
-	r->in.pStat->CurrentRec = MID_END_OF_TABLE;
-	r->in.pStat->NumPos = r->in.pStat->TotalRecs = all_mids->cValues;
-	for (row = 0; row < all_mids->cValues; row++) {
-		if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
-			r->in.pStat->CurrentRec = mids->aulPropTag[0];
-			r->in.pStat->NumPos = row;
-			break;
+		/* find the records matching the qualifier */
+		seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
+		seek_restriction->rt = RES_PROPERTY;
+		seek_restriction->res.resProperty.relop = RELOP_GE;
+		seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
+		seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
+			mids = all_mids;
+			retval = MAPI_E_NOT_FOUND;
+		}
+
+		r->in.pStat->CurrentRec = MID_END_OF_TABLE;
+		r->in.pStat->NumPos = r->in.pStat->TotalRecs = all_mids->cValues;
+		for (row = 0; row < all_mids->cValues; row++) {
+			if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
+				r->in.pStat->CurrentRec = mids->aulPropTag[0];
+				r->in.pStat->NumPos = row;
+				break;
+			}
 		}
 	}
 
@@ -586,6 +632,7 @@ static void dcesrv_NspiGetMatches(struct dcesrv_call_state *dce_call,
 	enum MAPISTATUS			retval;
 	struct emsabp_context		*emsabp_ctx = NULL;
 	struct PropertyTagArray_r	*ppOutMIds = NULL;
+	struct emsabp_gal_snapshot	*gal = NULL;
 	uint32_t			i;
 	
 
@@ -607,7 +654,21 @@ static void dcesrv_NspiGetMatches(struct dcesrv_call_state *dce_call,
 	ppOutMIds->cValues = 0;
 	ppOutMIds->aulPropTag = NULL;
 
-	retval = emsabp_search(mem_ctx, emsabp_ctx, ppOutMIds, r->in.Filter, r->in.pStat, r->in.ulRequested);
+	/* Rows of the container records are built from its snapshot */
+	if (emsabp_gal_get(emsabp_ctx, r->in.pStat->ContainerID, &gal) == MAPI_E_SUCCESS && !r->in.Filter) {
+		if (!gal->count) {
+			retval = MAPI_E_NOT_FOUND;
+		} else if (r->in.ulRequested && gal->count > r->in.ulRequested) {
+			retval = MAPI_E_TABLE_TOO_BIG;
+		} else {
+			ppOutMIds->cValues = gal->count;
+			ppOutMIds->aulPropTag = (uint32_t *) talloc_memdup(mem_ctx, gal->MIds.aulPropTag,
+									   gal->count * sizeof (uint32_t));
+			retval = ppOutMIds->aulPropTag ? MAPI_E_SUCCESS : MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+	} else {
+		retval = emsabp_search(mem_ctx, emsabp_ctx, ppOutMIds, r->in.Filter, r->in.pStat, r->in.ulRequested);
+	}
 	if (retval != MAPI_E_SUCCESS) {
 	failure:
 		r->out.pStat = r->in.pStat;
@@ -1438,6 +1499,9 @@ static NTSTATUS dcesrv_exchange_nsp_init(struct dcesrv_context *dce_ctx)
 	if (!nsp_session) return NT_STATUS_NO_MEMORY;
 	nsp_session->session = NULL;
 
+	nsp_session_registry = mpm_session_registry_init(dce_ctx);
+	if (!nsp_session_registry) return NT_STATUS_NO_MEMORY;
+
 	/* Open a read-write pointer on the EMSABP TDB database */
 	emsabp_tdb_ctx = emsabp_tdb_init((TALLOC_CTX *)dce_ctx, dce_ctx->lp_ctx);
 	if (!emsabp_tdb_ctx) {
@@ -41,15 +41,59 @@
 #endif
 #endif
 
+struct emsabp_gal_entry {
+	uint32_t		MId;
+	const char		*display_name;
+	struct ldb_message	*msg;
+};
+
+struct emsabp_gal_mid {
+	uint32_t		MId;
+	uint32_t		row;
+};
+
+/**
+   In-memory copy of an address book container, sorted by display
+   name with the mapped attributes of each record prefetched
+ */
+struct emsabp_gal_snapshot {
+	struct emsabp_context		*emsabp_ctx;
+	uint32_t			ContainerID;
+	uint32_t			count;
+	struct emsabp_gal_entry		*entries;	/* sorted by display name */
+	struct emsabp_gal_mid		*mids;		/* sorted by MId */
+	struct PropertyTagArray_r	MIds;		/* MIds in display name order */
+	uint64_t			usn;
+	time_t				checked;
+	size_t				size;
+	struct emsabp_gal_snapshot	*prev;
+	struct emsabp_gal_snapshot	*next;
+};
+
 struct emsabp_context {
-	const char		*account_name;
-	const char		*organization_name;
-	struct loadparm_context	*lp_ctx;
-	struct ldb_context	*samdb_ctx;
-	void			*ldb_ctx;
-	TDB_CONTEXT		*tdb_ctx;
-	TDB_CONTEXT		*ttdb_ctx;
-	TALLOC_CTX		*mem_ctx;
+	const char			*account_name;
+	const char			*organization_name;
+	struct loadparm_context		*lp_ctx;
+	struct ldb_context		*samdb_ctx;
+	void				*ldb_ctx;
+	TDB_CONTEXT			*tdb_ctx;
+	TDB_CONTEXT			*ttdb_ctx;
+	TALLOC_CTX			*mem_ctx;
+	struct emsabp_gal_snapshot	*gal;
+	size_t				gal_max_size;
+	uint32_t			gal_refresh;
+};
+
+/**
+   Result of an offline address book generation
+ */
+struct emsabp_oab_stats {
+	uint32_t			sequence;
+	uint32_t			serial;
+	uint32_t			records;
+	uint32_t			added;
+	uint32_t			modified;
+	uint32_t			deleted;
 };
 
 struct exchange_nsp_session {
@@ -107,6 +151,17 @@ struct EphemeralEntryID {
 #define	EMSABP_TDB_TMP_MID_START	0x5000
 #define	EMSABP_TDB_DATA_REC		"MId_index"
 
+/* Default memory limit of the GAL snapshots of the process, in MB */
+#define	EMSABP_GAL_MAX_SIZE		64
+/* Default number of seconds between two GAL snapshot freshness checks */
+#define	EMSABP_GAL_REFRESH		60
+
+/* Offline address book files, relative to the output directory */
+#define	EMSABP_OAB_VERSION		0x00000020
+#define	EMSABP_OAB_STATE		"oab.tdb"
+#define	EMSABP_OAB_FULL			"data-%u.oab"
+#define	EMSABP_OAB_CHANGES		"changes-%u.oab"
+
 #define DCESRV_NSP_RETURN_IF(x,r,c,ctx)		\
 do {						\
 	if (x) {				\
@@ -160,6 +215,16 @@ enum MAPISTATUS		emsabp_ab_fetch_filter(TALLOC_CTX *, struct emsabp_context *, u
 enum MAPISTATUS		emsabp_ab_container_enum(TALLOC_CTX *, struct emsabp_context *, uint32_t, struct ldb_result **);
 
 
+/* definitions from emsabp_gal.c */
+enum MAPISTATUS		emsabp_gal_get(struct emsabp_context *, uint32_t, struct emsabp_gal_snapshot **);
+enum MAPISTATUS		emsabp_gal_find_MId(struct emsabp_gal_snapshot *, uint32_t, uint32_t *);
+uint32_t		emsabp_gal_seek(struct emsabp_gal_snapshot *, const char *);
+struct ldb_message	*emsabp_gal_lookup_MId(struct emsabp_context *, uint32_t);
+size_t			emsabp_gal_size(void);
+
+/* definitions from emsabp_oab.c */
+enum MAPISTATUS		emsabp_oab_generate(struct emsabp_context *, const char *, struct emsabp_oab_stats *);
+
 /* definitions from emsabp_tdb.c */
 TDB_CONTEXT		*emsabp_tdb_init(TALLOC_CTX *, struct loadparm_context *);
 enum MAPISTATUS		emsabp_tdb_close(TDB_CONTEXT *);
@@ -173,6 +238,7 @@ TDB_CONTEXT		*emsabp_tdb_init_tmp(TALLOC_CTX *);
 
 /* definitions from emsabp_property.c */
 const char		*emsabp_property_get_attribute(uint32_t);
+const char		**emsabp_property_get_attributes(TALLOC_CTX *);
 uint32_t		emsabp_property_get_ulPropTag(const char *);
 int			emsabp_property_is_ref(uint32_t);
 const char		*emsabp_property_get_ref_attr(uint32_t);
@@ -38,6 +38,32 @@ struct ldb_context *samdb_connect(TALLOC_CTX *, struct tevent_context *,
 				  struct auth_session_info *,
 				  unsigned int);
 
+/**
+   \details Read an unsigned integer dcerpc_mapiproxy option, falling
+   back to its default value when it is negative
+
+   \param lp_ctx pointer to the loadparm context
+   \param option name of the option
+   \param default_v default value of the option
+
+   \return the option value
+ */
+static uint32_t emsabp_parm_uint(struct loadparm_context *lp_ctx,
+				 const char *option,
+				 uint32_t default_v)
+{
+	int	value;
+
+	value = lpcfg_parm_int(lp_ctx, NULL, "dcerpc_mapiproxy", option, default_v);
+	if (value < 0) {
+		DEBUG(0, ("[%s:%d]: invalid negative value %d for dcerpc_mapiproxy:%s, using %u\n",
+			  __FUNCTION__, __LINE__, value, option, default_v));
+		return default_v;
+	}
+
+	return value;
+}
+
 /**
    \details Initialize the EMSABP context and open connections to
    Samba databases.
@@ -78,6 +104,10 @@ _PUBLIC_ struct emsabp_context *emsabp_init(struct loadparm_context *lp_ctx,
 	/* Save a pointer to the loadparm context */
 	emsabp_ctx->lp_ctx = lp_ctx;
 
+	/* Container snapshots, a zero memory limit disables them */
+	emsabp_ctx->gal_max_size = (size_t) emsabp_parm_uint(lp_ctx, "nspi_gal_max_size", EMSABP_GAL_MAX_SIZE) * 1024 * 1024;
+	emsabp_ctx->gal_refresh = emsabp_parm_uint(lp_ctx, "nspi_gal_refresh", EMSABP_GAL_REFRESH);
+
 
 	/* Retrieve samdb url (local or external) */
 	samdb_url = lpcfg_parm_string(lp_ctx, NULL, "dcerpc_mapiproxy", "samdb_url");
@@ -720,12 +750,19 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs(TALLOC_CTX *mem_ctx, struct emsabp_c
 	char			*dn;
 	const char * const	recipient_attrs[] = { "*", NULL };
 	struct ldb_result	*res = NULL;
+	struct ldb_message	*msg;
 	struct ldb_dn		*ldb_dn = NULL;
 	int			ret;
 	uint32_t		ulPropTag;
 	void			*data;
 	int			i;
 
+	/* Use the record prefetched in a container snapshot if any */
+	msg = emsabp_gal_lookup_MId(emsabp_ctx, MId);
+	if (msg) {
+		return emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, aRow, msg, MId, dwFlags, pPropTags);
+	}
+
 	/* Step 0. Try to Retrieve the dn associated to the MId first from temp TDB (users) */
 	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, emsabp_ctx->ttdb_ctx, MId, &dn);
 	if (retval != MAPI_E_SUCCESS) {
@@ -0,0 +1,371 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_gal.c
+
+   \brief EMSABP address book container snapshots
+
+   Paging through a container used to search the whole directory, sort
+   it by display name and search each returned record again. A
+   snapshot keeps the container records sorted in memory with the
+   attributes properties are mapped to, so table positioning and row
+   fetching only use the directory when it has changed. The
+   highestCommittedUSN of the directory is checked every gal_refresh
+   seconds to find out.
+
+   Snapshots hold MIds from the temporary TDB of their session, so
+   each session builds its own. The memory they use is accounted for
+   the whole process against gal_max_size.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "dcesrv_exchange_nsp.h"
+#include <util/debug.h>
+
+/* Memory used by the snapshots of all the sessions of the process */
+static size_t	emsabp_gal_total_size = 0;
+
+static int emsabp_gal_entry_cmp(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*entry_a = (const struct emsabp_gal_entry *) a;
+	const struct emsabp_gal_entry	*entry_b = (const struct emsabp_gal_entry *) b;
+	int				ret;
+
+	ret = strcasecmp(entry_a->display_name, entry_b->display_name);
+	if (ret) return ret;
+
+	/* Keep the order stable between two snapshots */
+	return (entry_a->MId < entry_b->MId) ? -1 : (entry_a->MId > entry_b->MId);
+}
+
+static int emsabp_gal_mid_cmp(const void *a, const void *b)
+{
+	const struct emsabp_gal_mid	*mid_a = (const struct emsabp_gal_mid *) a;
+	const struct emsabp_gal_mid	*mid_b = (const struct emsabp_gal_mid *) b;
+
+	return (mid_a->MId < mid_b->MId) ? -1 : (mid_a->MId > mid_b->MId);
+}
+
+static int emsabp_gal_snapshot_destructor(struct emsabp_gal_snapshot *snapshot)
+{
+	DLIST_REMOVE(snapshot->emsabp_ctx->gal, snapshot);
+	emsabp_gal_total_size -= snapshot->size;
+
+	return 0;
+}
+
+/**
+   \details Return the highestCommittedUSN of the directory, or 0 if
+   the backend does not provide it
+ */
+static uint64_t emsabp_gal_highest_usn(struct emsabp_context *emsabp_ctx)
+{
+	TALLOC_CTX		*mem_ctx;
+	const char * const	attrs[] = { "highestCommittedUSN", NULL };
+	struct ldb_result	*res = NULL;
+	uint64_t		usn = 0;
+	int			ret;
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_gal_highest_usn");
+	if (!mem_ctx) return 0;
+
+	ret = ldb_search(emsabp_ctx->samdb_ctx, mem_ctx, &res, ldb_dn_new(mem_ctx, emsabp_ctx->samdb_ctx, NULL),
+			 LDB_SCOPE_BASE, attrs, NULL);
+	if (ret == LDB_SUCCESS && res->count == 1) {
+		usn = ldb_msg_find_attr_as_uint64(res->msgs[0], "highestCommittedUSN", 0);
+	}
+	talloc_free(mem_ctx);
+
+	return usn;
+}
+
+/**
+   \details Search the records of an address book container and build
+   its snapshot
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param ContainerID id of the container, 0 for the GAL
+   \param snapshotp pointer on pointer to the snapshot returned by the
+   function
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_ENOUGH_RESOURCES if
+   the snapshot does not fit the session memory limit, otherwise MAPI
+   error
+ */
+static enum MAPISTATUS emsabp_gal_build(struct emsabp_context *emsabp_ctx, uint32_t ContainerID,
+					struct emsabp_gal_snapshot **snapshotp)
+{
+	enum MAPISTATUS			retval;
+	TALLOC_CTX			*mem_ctx;
+	struct emsabp_gal_snapshot	*snapshot;
+	struct ldb_result		*res = NULL;
+	const char			**attrs;
+	char				*filter;
+	const char			*dn;
+	uint32_t			i;
+	int				ret;
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_gal_build");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	snapshot = talloc_zero(emsabp_ctx->mem_ctx, struct emsabp_gal_snapshot);
+	OPENCHANGE_RETVAL_IF(!snapshot, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	snapshot->emsabp_ctx = emsabp_ctx;
+	snapshot->ContainerID = ContainerID;
+	snapshot->checked = time(NULL);
+
+	/* Changes made during the search are picked up by the next check */
+	snapshot->usn = emsabp_gal_highest_usn(emsabp_ctx);
+
+	retval = emsabp_ab_fetch_filter(mem_ctx, emsabp_ctx, ContainerID, &filter);
+	if (retval != MAPI_E_SUCCESS) {
+		talloc_free(snapshot);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_INVALID_BOOKMARK, mem_ctx);
+	}
+
+	attrs = emsabp_property_get_attributes(mem_ctx);
+	if (!attrs) {
+		talloc_free(filter);
+		talloc_free(snapshot);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	}
+
+	ret = ldb_search(emsabp_ctx->samdb_ctx, snapshot, &res, ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "%s", filter);
+	talloc_free(filter);
+	if (ret != LDB_SUCCESS) {
+		talloc_free(snapshot);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, mem_ctx);
+	}
+
+	snapshot->count = res->count;
+	snapshot->entries = talloc_array(snapshot, struct emsabp_gal_entry, res->count);
+	snapshot->mids = talloc_array(snapshot, struct emsabp_gal_mid, res->count);
+	snapshot->MIds.cValues = res->count;
+	snapshot->MIds.aulPropTag = talloc_array(snapshot, uint32_t, res->count);
+	if (res->count && (!snapshot->entries || !snapshot->mids || !snapshot->MIds.aulPropTag)) {
+		talloc_free(snapshot);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	}
+
+	/* Step 1. Create session MId for all fetched records */
+	for (i = 0; i < res->count; i++) {
+		dn = ldb_msg_find_attr_as_string(res->msgs[i], "distinguishedName", NULL);
+		if (!dn) {
+			dn = ldb_dn_get_linearized(res->msgs[i]->dn);
+		}
+		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &snapshot->entries[i].MId);
+		if (retval) {
+			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
+			if (retval == MAPI_E_SUCCESS) {
+				retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &snapshot->entries[i].MId);
+			}
+			if (retval) {
+				talloc_free(snapshot);
+				OPENCHANGE_RETVAL_ERR(MAPI_E_CORRUPT_STORE, mem_ctx);
+			}
+		}
+		snapshot->entries[i].display_name = ldb_msg_find_attr_as_string(res->msgs[i], "displayName", "");
+		snapshot->entries[i].msg = res->msgs[i];
+	}
+
+	/* Step 2. Sort records the way tables are presented and index MIds */
+	if (res->count) {
+		qsort(snapshot->entries, res->count, sizeof (struct emsabp_gal_entry), emsabp_gal_entry_cmp);
+	}
+	for (i = 0; i < res->count; i++) {
+		snapshot->mids[i].MId = snapshot->entries[i].MId;
+		snapshot->mids[i].row = i;
+		snapshot->MIds.aulPropTag[i] = snapshot->entries[i].MId;
+	}
+	if (res->count) {
+		qsort(snapshot->mids, res->count, sizeof (struct emsabp_gal_mid), emsabp_gal_mid_cmp);
+	}
+
+	/* Step 3. Account the snapshot against the process limit */
+	snapshot->size = talloc_total_size(snapshot);
+	if (emsabp_gal_total_size + snapshot->size > emsabp_ctx->gal_max_size) {
+		DEBUG(3, ("[%s:%d]: Container 0x%x snapshot of %u records needs %zu bytes, %zu out of %zu are used\n",
+			  __FUNCTION__, __LINE__, ContainerID, snapshot->count, snapshot->size,
+			  emsabp_gal_total_size, emsabp_ctx->gal_max_size));
+		talloc_free(snapshot);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_RESOURCES, mem_ctx);
+	}
+
+	emsabp_gal_total_size += snapshot->size;
+	DLIST_ADD(emsabp_ctx->gal, snapshot);
+	talloc_set_destructor(snapshot, emsabp_gal_snapshot_destructor);
+
+	DEBUG(5, ("[%s:%d]: Container 0x%x snapshot built: %u records, %zu bytes\n",
+		  __FUNCTION__, __LINE__, ContainerID, snapshot->count, snapshot->size));
+
+	*snapshotp = snapshot;
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Return the snapshot of an address book container, building
+   it on first use and rebuilding it when the directory has changed
+   since
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param ContainerID id of the container, 0 for the GAL
+   \param snapshotp pointer on pointer to the snapshot returned by the
+   function
+
+   \note Callers fall back to searching the directory when this
+   function fails, in particular when snapshots are disabled or do not
+   fit the memory limit.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_get(struct emsabp_context *emsabp_ctx, uint32_t ContainerID,
+					struct emsabp_gal_snapshot **snapshotp)
+{
+	struct emsabp_gal_snapshot	*snapshot;
+	time_t				now;
+	uint64_t			usn;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!snapshotp, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx->gal_max_size, MAPI_E_NO_SUPPORT, NULL);
+
+	for (snapshot = emsabp_ctx->gal; snapshot; snapshot = snapshot->next) {
+		if (snapshot->ContainerID == ContainerID) break;
+	}
+
+	if (snapshot) {
+		now = time(NULL);
+		if (now - snapshot->checked >= emsabp_ctx->gal_refresh) {
+			usn = emsabp_gal_highest_usn(emsabp_ctx);
+			if (!usn || usn != snapshot->usn) {
+				talloc_free(snapshot);
+				return emsabp_gal_build(emsabp_ctx, ContainerID, snapshotp);
+			}
+			snapshot->checked = now;
+		}
+		*snapshotp = snapshot;
+		return MAPI_E_SUCCESS;
+	}
+
+	return emsabp_gal_build(emsabp_ctx, ContainerID, snapshotp);
+}
+
+/**
+   \details Find the row of a MId within a snapshot
+
+   \param snapshot pointer to the container snapshot
+   \param MId the MId to lookup
+   \param row pointer to the row returned by the function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_find_MId(struct emsabp_gal_snapshot *snapshot, uint32_t MId, uint32_t *row)
+{
+	struct emsabp_gal_mid	key;
+	struct emsabp_gal_mid	*mid;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!snapshot, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!row, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!snapshot->count, MAPI_E_NOT_FOUND, NULL);
+
+	key.MId = MId;
+	mid = (struct emsabp_gal_mid *) bsearch(&key, snapshot->mids, snapshot->count,
+						 sizeof (struct emsabp_gal_mid), emsabp_gal_mid_cmp);
+	OPENCHANGE_RETVAL_IF(!mid, MAPI_E_NOT_FOUND, NULL);
+
+	*row = mid->row;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Return the row of the first record whose display name is
+   greater than or equal to the specified one
+
+   \param snapshot pointer to the container snapshot
+   \param display_name the display name to seek to
+
+   \return row on success, the number of records if all display names
+   are lower
+ */
+_PUBLIC_ uint32_t emsabp_gal_seek(struct emsabp_gal_snapshot *snapshot, const char *display_name)
+{
+	uint32_t	low = 0;
+	uint32_t	high;
+	uint32_t	middle;
+
+	if (!snapshot) return 0;
+	high = snapshot->count;
+	if (!display_name) return high;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (strcasecmp(snapshot->entries[middle].display_name, display_name) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+   \details Return the prefetched record of a MId from the snapshots of
+   the session, without checking whether they are still fresh
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param MId the MId to lookup
+
+   \return pointer to the LDB message on success, otherwise NULL
+ */
+_PUBLIC_ struct ldb_message *emsabp_gal_lookup_MId(struct emsabp_context *emsabp_ctx, uint32_t MId)
+{
+	struct emsabp_gal_snapshot	*snapshot;
+	uint32_t			row;
+
+	if (!emsabp_ctx) return NULL;
+
+	for (snapshot = emsabp_ctx->gal; snapshot; snapshot = snapshot->next) {
+		if (emsabp_gal_find_MId(snapshot, MId, &row) == MAPI_E_SUCCESS) {
+			return snapshot->entries[row].msg;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+   \details Return the memory used by the snapshots of all the
+   sessions of the process
+
+   \return size in bytes
+ */
+_PUBLIC_ size_t emsabp_gal_size(void)
+{
+	return emsabp_gal_total_size;
+}
@@ -0,0 +1,760 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_oab.c
+
+   \brief Offline address book generation
+
+   The GAL is exported to an output directory as a version 4 full
+   details file (data-<sequence>.oab), made of the OAB_HDR header, the
+   OAB_META_DATA property tables, the header record and one OAB_V4_REC
+   record per recipient. Properties are read through the same mapping
+   as NSPI.
+
+   Records are written as the directory search returns them, so the
+   GAL is never held in memory. The CRC-32 of each record is kept in
+   an on-disk TDB database (oab.tdb) keyed by PidTagEmailAddress, which
+   is how the next generation finds out which records were added,
+   modified or deleted and writes them to changes-<sequence>.oab:
+
+   - OAB_HDR: ulVersion, ulSerial, ulTotRecs, followed by the serial of
+     the full details file the changes apply to, the serial of the
+     resulting one, the number of added or modified records and the
+     number of deleted records
+   - OAB_META_DATA and the header record, as in the full details file
+   - the added and modified records
+   - the deleted records, only carrying PidTagEmailAddress
+
+   Serials are the CRC-32 of the file data following OAB_HDR.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "dcesrv_exchange_nsp.h"
+#include <util/debug.h>
+
+#define	EMSABP_OAB_ANR			0x1
+#define	EMSABP_OAB_RDN			0x2
+#define	EMSABP_OAB_INDEX		0x4
+
+#define	EMSABP_OAB_HDR_SIZE		12
+#define	EMSABP_OAB_CHANGES_HDR_SIZE	28
+
+#define	EMSABP_OAB_KEY_SEQUENCE		"OAB_SEQUENCE"
+#define	EMSABP_OAB_KEY_SERIAL		"OAB_SERIAL"
+
+struct emsabp_oab_prop {
+	uint32_t	ulPropTag;
+	uint32_t	ulFlags;
+};
+
+static const struct emsabp_oab_prop emsabp_oab_hdr_props[] = {
+	{ PidTagOfflineAddressBookName,			0				},
+	{ PidTagOfflineAddressBookDistinguishedName,	0				},
+	{ PidTagOfflineAddressBookSequence,		0				},
+	{ PidTagOfflineAddressBookContainerGuid,	0				},
+	{ 0,						0				}
+};
+
+/* The first property is the key records are matched on */
+static const struct emsabp_oab_prop emsabp_oab_props[] = {
+	{ PidTagEmailAddress,				EMSABP_OAB_RDN			},
+	{ PidTagDisplayName,				EMSABP_OAB_ANR|EMSABP_OAB_INDEX	},
+	{ PidTagSmtpAddress,				EMSABP_OAB_ANR			},
+	{ PidTagAccount,				EMSABP_OAB_ANR			},
+	{ PidTagSurname,				EMSABP_OAB_ANR			},
+	{ PidTagGivenName,				0				},
+	{ PidTagTitle,					0				},
+	{ PidTagDepartmentName,				0				},
+	{ PidTagCompanyName,				0				},
+	{ PidTagAddressBookProxyAddresses,		EMSABP_OAB_ANR			},
+	{ PidTagObjectType,				0				},
+	{ PidTagDisplayType,				0				},
+	{ PidTagAddressBookObjectGuid,			0				},
+	{ 0,						0				}
+};
+
+struct emsabp_oab_file {
+	FILE			*fp;
+	char			*path;
+	char			*tmp_path;
+	uint32_t		crc;
+};
+
+struct emsabp_oab_state {
+	struct emsabp_context	*emsabp_ctx;
+	TDB_CONTEXT		*prev_tdb;
+	TDB_CONTEXT		*tdb;
+	struct emsabp_oab_file	*full;
+	struct emsabp_oab_file	*changes;
+	DATA_BLOB		meta;
+	struct emsabp_oab_stats	*stats;
+	enum MAPISTATUS		retval;
+};
+
+static uint32_t emsabp_oab_count(const struct emsabp_oab_prop *props)
+{
+	uint32_t	i;
+
+	for (i = 0; props[i].ulPropTag; i++);
+
+	return i;
+}
+
+/**
+   \details Push an integer in the compressed format: values up to
+   0x7F are a single byte, others are prefixed with 0x80 plus the
+   number of bytes following
+ */
+static enum ndr_err_code emsabp_oab_push_int(struct ndr_push *ndr, uint32_t value)
+{
+	if (value <= 0x7F) {
+		return ndr_push_uint8(ndr, NDR_SCALARS, value);
+	}
+
+	if (value <= 0xFF) {
+		NDR_CHECK(ndr_push_uint8(ndr, NDR_SCALARS, 0x81));
+		return ndr_push_uint8(ndr, NDR_SCALARS, value);
+	}
+
+	if (value <= 0xFFFF) {
+		NDR_CHECK(ndr_push_uint8(ndr, NDR_SCALARS, 0x82));
+		return ndr_push_uint16(ndr, NDR_SCALARS, value);
+	}
+
+	if (value <= 0xFFFFFF) {
+		NDR_CHECK(ndr_push_uint8(ndr, NDR_SCALARS, 0x83));
+		NDR_CHECK(ndr_push_uint16(ndr, NDR_SCALARS, value & 0xFFFF));
+		return ndr_push_uint8(ndr, NDR_SCALARS, value >> 16);
+	}
+
+	NDR_CHECK(ndr_push_uint8(ndr, NDR_SCALARS, 0x84));
+	return ndr_push_uint32(ndr, NDR_SCALARS, value);
+}
+
+static enum ndr_err_code emsabp_oab_push_string(struct ndr_push *ndr, const char *str)
+{
+	return ndr_push_bytes(ndr, (const uint8_t *) str, strlen(str) + 1);
+}
+
+static enum ndr_err_code emsabp_oab_push_value(struct ndr_push *ndr, uint32_t ulPropTag, const void *data)
+{
+	const struct Binary_r		*bin;
+	const struct StringArray_r	*mvszA;
+	uint32_t			i;
+
+	switch (ulPropTag & 0xFFFF) {
+	case PT_LONG:
+		return emsabp_oab_push_int(ndr, *((const uint32_t *) data));
+	case PT_BOOLEAN:
+		return ndr_push_uint8(ndr, NDR_SCALARS, *((const uint8_t *) data));
+	case PT_STRING8:
+	case PT_UNICODE:
+		return emsabp_oab_push_string(ndr, (const char *) data);
+	case PT_BINARY:
+		bin = (const struct Binary_r *) data;
+		NDR_CHECK(emsabp_oab_push_int(ndr, bin->cb));
+		return ndr_push_bytes(ndr, bin->lpb, bin->cb);
+	case PT_MV_STRING8:
+	case PT_MV_UNICODE:
+		mvszA = (const struct StringArray_r *) data;
+		NDR_CHECK(emsabp_oab_push_int(ndr, mvszA->cValues));
+		for (i = 0; i < mvszA->cValues; i++) {
+			NDR_CHECK(emsabp_oab_push_string(ndr, mvszA->lppszA[i]));
+		}
+		return NDR_ERR_SUCCESS;
+	default:
+		return NDR_ERR_BAD_SWITCH;
+	}
+}
+
+/**
+   \details Build an OAB_V4_REC record: its size, the presence bit
+   array and the values of the present properties
+
+   \param mem_ctx pointer to the memory context
+   \param props the properties of the record
+   \param values the values of the properties, NULL when absent
+   \param blob pointer to the record returned by the function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_oab_push_record(TALLOC_CTX *mem_ctx, const struct emsabp_oab_prop *props,
+					      void **values, DATA_BLOB *blob)
+{
+	struct ndr_push		*ndr;
+	uint32_t		count;
+	uint32_t		presence;
+	uint32_t		i;
+
+	count = emsabp_oab_count(props);
+	presence = (count + 7) / 8;
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!ndr, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	ndr_push_uint32(ndr, NDR_SCALARS, 0);
+	ndr_push_zero(ndr, presence);
+
+	for (i = 0; i < count; i++) {
+		if (!values[i]) continue;
+
+		if (emsabp_oab_push_value(ndr, props[i].ulPropTag, values[i]) != NDR_ERR_SUCCESS) {
+			DEBUG(3, ("[%s:%d]: Unable to push property 0x%.8x\n", __FUNCTION__, __LINE__,
+				  props[i].ulPropTag));
+			talloc_free(ndr);
+			return MAPI_E_CALL_FAILED;
+		}
+		ndr->data[4 + i / 8] |= 0x80 >> (i % 8);
+	}
+	SIVAL(ndr->data, 0, ndr->offset);
+
+	blob->data = talloc_steal(mem_ctx, ndr->data);
+	blob->length = ndr->offset;
+	talloc_free(ndr);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Build the OAB_META_DATA structure describing the header
+   and recipient records
+ */
+static enum MAPISTATUS emsabp_oab_push_meta(TALLOC_CTX *mem_ctx, DATA_BLOB *blob)
+{
+	const struct emsabp_oab_prop	*tables[] = { emsabp_oab_hdr_props, emsabp_oab_props };
+	struct ndr_push			*ndr;
+	uint32_t			i, j;
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	OPENCHANGE_RETVAL_IF(!ndr, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	ndr_push_uint32(ndr, NDR_SCALARS, 0);
+	for (i = 0; i < 2; i++) {
+		ndr_push_uint32(ndr, NDR_SCALARS, emsabp_oab_count(tables[i]));
+		for (j = 0; tables[i][j].ulPropTag; j++) {
+			ndr_push_uint32(ndr, NDR_SCALARS, tables[i][j].ulPropTag);
+			ndr_push_uint32(ndr, NDR_SCALARS, tables[i][j].ulFlags);
+		}
+	}
+	SIVAL(ndr->data, 0, ndr->offset);
+
+	blob->data = talloc_steal(mem_ctx, ndr->data);
+	blob->length = ndr->offset;
+	talloc_free(ndr);
+
+	return MAPI_E_SUCCESS;
+}
+
+static int emsabp_oab_file_destructor(struct emsabp_oab_file *file)
+{
+	/* The file was not committed */
+	if (file->fp) {
+		fclose(file->fp);
+		unlink(file->tmp_path);
+	}
+
+	return 0;
+}
+
+/**
+   \details Create the temporary file an OAB file is written to, and
+   reserve room for its header
+ */
+static enum MAPISTATUS emsabp_oab_file_open(TALLOC_CTX *mem_ctx, const char *path, size_t hdr_size,
+					    struct emsabp_oab_file **filep)
+{
+	struct emsabp_oab_file	*file;
+	uint8_t			hdr[EMSABP_OAB_CHANGES_HDR_SIZE];
+
+	file = talloc_zero(mem_ctx, struct emsabp_oab_file);
+	OPENCHANGE_RETVAL_IF(!file, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	file->path = talloc_strdup(file, path);
+	file->tmp_path = talloc_asprintf(file, "%s.tmp", path);
+	OPENCHANGE_RETVAL_IF(!file->path || !file->tmp_path, MAPI_E_NOT_ENOUGH_MEMORY, file);
+
+	file->fp = fopen(file->tmp_path, "wb");
+	if (!file->fp) {
+		DEBUG(0, ("[%s:%d]: Unable to create %s: %s\n", __FUNCTION__, __LINE__,
+			  file->tmp_path, strerror(errno)));
+		talloc_free(file);
+		return MAPI_E_NO_ACCESS;
+	}
+	talloc_set_destructor(file, emsabp_oab_file_destructor);
+
+	memset(hdr, 0, sizeof (hdr));
+	OPENCHANGE_RETVAL_IF(fwrite(hdr, hdr_size, 1, file->fp) != 1, MAPI_E_DISK_ERROR, file);
+	file->crc = 0xFFFFFFFF;
+
+	*filep = file;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS emsabp_oab_file_write(struct emsabp_oab_file *file, DATA_BLOB *blob)
+{
+	if (fwrite(blob->data, blob->length, 1, file->fp) != 1) {
+		DEBUG(0, ("[%s:%d]: Unable to write %s: %s\n", __FUNCTION__, __LINE__,
+			  file->tmp_path, strerror(errno)));
+		return MAPI_E_DISK_ERROR;
+	}
+	file->crc = updateCRC(file->crc, blob->data, blob->length);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Write the header of an OAB file and move it to its final
+   path
+ */
+static enum MAPISTATUS emsabp_oab_file_commit(struct emsabp_oab_file *file, const uint32_t *hdr, uint32_t count)
+{
+	uint8_t		data[EMSABP_OAB_CHANGES_HDR_SIZE];
+	uint32_t	i;
+	int		ret;
+
+	for (i = 0; i < count; i++) {
+		SIVAL(data, i * 4, hdr[i]);
+	}
+
+	ret = fseek(file->fp, 0, SEEK_SET);
+	if (!ret && fwrite(data, count * 4, 1, file->fp) != 1) ret = -1;
+	if (!ret) ret = fflush(file->fp);
+	if (!ret) ret = fsync(fileno(file->fp));
+	if (ret) {
+		DEBUG(0, ("[%s:%d]: Unable to write %s: %s\n", __FUNCTION__, __LINE__,
+			  file->tmp_path, strerror(errno)));
+		return MAPI_E_DISK_ERROR;
+	}
+
+	fclose(file->fp);
+	file->fp = NULL;
+
+	if (rename(file->tmp_path, file->path) == -1) {
+		DEBUG(0, ("[%s:%d]: Unable to rename %s: %s\n", __FUNCTION__, __LINE__,
+			  file->tmp_path, strerror(errno)));
+		unlink(file->tmp_path);
+		return MAPI_E_DISK_ERROR;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static bool emsabp_oab_tdb_fetch_uint32(TDB_CONTEXT *tdb_ctx, const char *keyname, uint32_t *value)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*str;
+
+	key.dptr = (unsigned char *) keyname;
+	key.dsize = strlen(keyname);
+
+	dbuf = tdb_fetch(tdb_ctx, key);
+	if (!dbuf.dptr) return false;
+
+	str = talloc_strndup(NULL, (const char *) dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+	if (!str) return false;
+
+	*value = strtoul(str, NULL, 16);
+	talloc_free(str);
+
+	return true;
+}
+
+static bool emsabp_oab_tdb_store_uint32(TDB_CONTEXT *tdb_ctx, const char *keyname, uint32_t value)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		str[11];
+
+	key.dptr = (unsigned char *) keyname;
+	key.dsize = strlen(keyname);
+
+	snprintf(str, sizeof (str), "0x%x", value);
+	dbuf.dptr = (unsigned char *) str;
+	dbuf.dsize = strlen(str);
+
+	return tdb_store(tdb_ctx, key, dbuf, TDB_REPLACE) == 0;
+}
+
+/**
+   \details Write a recipient record to the full details file, and to
+   the changes file if it differs from the previous generation
+ */
+static enum MAPISTATUS emsabp_oab_add_entry(struct emsabp_oab_state *state, struct ldb_message *msg)
+{
+	enum MAPISTATUS		retval;
+	TALLOC_CTX		*mem_ctx;
+	void			**values;
+	DATA_BLOB		blob;
+	uint32_t		count;
+	uint32_t		crc;
+	uint32_t		prev_crc;
+	uint32_t		i;
+	const char		*keyname;
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_oab_add_entry");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	count = emsabp_oab_count(emsabp_oab_props);
+	values = talloc_array(mem_ctx, void *, count);
+	OPENCHANGE_RETVAL_IF(!values, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	for (i = 0; i < count; i++) {
+		values[i] = emsabp_query(mem_ctx, state->emsabp_ctx, msg, emsabp_oab_props[i].ulPropTag, 0, 0);
+	}
+
+	/* Records can only be matched between generations on their key */
+	keyname = (const char *) values[0];
+	if (!keyname) {
+		DEBUG(3, ("[%s:%d]: Skipping %s without %s\n", __FUNCTION__, __LINE__,
+			  ldb_dn_get_linearized(msg->dn), emsabp_property_get_attribute(PidTagEmailAddress)));
+		talloc_free(mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	retval = emsabp_oab_push_record(mem_ctx, emsabp_oab_props, values, &blob);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+
+	retval = emsabp_oab_file_write(state->full, &blob);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	state->stats->records++;
+
+	crc = updateCRC(0xFFFFFFFF, blob.data, blob.length);
+	OPENCHANGE_RETVAL_IF(!emsabp_oab_tdb_store_uint32(state->tdb, keyname, crc), MAPI_E_DISK_ERROR, mem_ctx);
+
+	if (state->changes) {
+		if (!emsabp_oab_tdb_fetch_uint32(state->prev_tdb, keyname, &prev_crc)) {
+			state->stats->added++;
+		} else if (prev_crc != crc) {
+			state->stats->modified++;
+		} else {
+			talloc_free(mem_ctx);
+			return MAPI_E_SUCCESS;
+		}
+
+		retval = emsabp_oab_file_write(state->changes, &blob);
+		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	}
+
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+static int emsabp_oab_search_callback(struct ldb_request *req, struct ldb_reply *ares)
+{
+	struct emsabp_oab_state	*state = (struct emsabp_oab_state *) req->context;
+
+	if (!ares) {
+		return ldb_request_done(req, LDB_ERR_OPERATIONS_ERROR);
+	}
+	if (ares->error != LDB_SUCCESS) {
+		return ldb_request_done(req, ares->error);
+	}
+
+	switch (ares->type) {
+	case LDB_REPLY_ENTRY:
+		state->retval = emsabp_oab_add_entry(state, ares->message);
+		talloc_free(ares);
+		if (state->retval != MAPI_E_SUCCESS) {
+			return ldb_request_done(req, LDB_ERR_OPERATIONS_ERROR);
+		}
+		break;
+	case LDB_REPLY_REFERRAL:
+		talloc_free(ares);
+		break;
+	case LDB_REPLY_DONE:
+		talloc_free(ares);
+		return ldb_request_done(req, LDB_SUCCESS);
+	}
+
+	return LDB_SUCCESS;
+}
+
+/**
+   \details Write a deleted record to the changes file for each
+   recipient of the previous generation missing from this one
+ */
+static int emsabp_oab_traverse_deleted(TDB_CONTEXT *tdb_ctx, TDB_DATA key, TDB_DATA dbuf, void *private_data)
+{
+	struct emsabp_oab_state	*state = (struct emsabp_oab_state *) private_data;
+	TALLOC_CTX		*mem_ctx;
+	void			**values;
+	DATA_BLOB		blob;
+
+	/* Recipient keys are legacyExchangeDN values */
+	if (!key.dsize || key.dptr[0] != '/') return 0;
+	if (tdb_exists(state->tdb, key)) return 0;
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_oab_traverse_deleted");
+	values = talloc_zero_array(mem_ctx, void *, emsabp_oab_count(emsabp_oab_props));
+	if (!values) {
+		state->retval = MAPI_E_NOT_ENOUGH_MEMORY;
+		talloc_free(mem_ctx);
+		return -1;
+	}
+	values[0] = talloc_strndup(values, (const char *) key.dptr, key.dsize);
+
+	state->retval = emsabp_oab_push_record(mem_ctx, emsabp_oab_props, values, &blob);
+	if (state->retval == MAPI_E_SUCCESS) {
+		state->retval = emsabp_oab_file_write(state->changes, &blob);
+	}
+	talloc_free(mem_ctx);
+	if (state->retval != MAPI_E_SUCCESS) return -1;
+
+	state->stats->deleted++;
+
+	return 0;
+}
+
+/**
+   \details Build the header record describing the GAL
+ */
+static enum MAPISTATUS emsabp_oab_push_hdr_record(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx,
+						  uint32_t sequence, DATA_BLOB *blob)
+{
+	enum MAPISTATUS		retval;
+	const char * const	attrs[] = { "globalAddressList", NULL };
+	struct ldb_result	*res = NULL;
+	struct ldb_message	*msg = NULL;
+	const struct ldb_val	*ldb_val;
+	const char		*dn;
+	struct GUID		guid;
+	void			*values[4];
+	int			ret;
+
+	ret = ldb_search(emsabp_ctx->samdb_ctx, mem_ctx, &res, ldb_get_config_basedn(emsabp_ctx->samdb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "(globalAddressList=*)");
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_CORRUPT_STORE, NULL);
+
+	dn = ldb_msg_find_attr_as_string(res->msgs[0], "globalAddressList", NULL);
+	OPENCHANGE_RETVAL_IF(!dn, MAPI_E_CORRUPT_STORE, NULL);
+
+	retval = emsabp_search_dn(emsabp_ctx, dn, &msg);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	(void) talloc_steal(mem_ctx, msg);
+
+	values[0] = discard_const(ldb_msg_find_attr_as_string(msg, "displayName",
+							      ldb_msg_find_attr_as_string(msg, "cn", "Global Address List")));
+	values[1] = discard_const(ldb_msg_find_attr_as_string(msg, "legacyExchangeDN", "/"));
+	values[2] = &sequence;
+	values[3] = NULL;
+
+	ldb_val = ldb_msg_find_ldb_val(msg, "objectGUID");
+	if (ldb_val && NT_STATUS_IS_OK(GUID_from_data_blob(ldb_val, &guid))) {
+		values[3] = GUID_string(mem_ctx, &guid);
+	}
+
+	return emsabp_oab_push_record(mem_ctx, emsabp_oab_hdr_props, values, blob);
+}
+
+/**
+   \details Generate the next offline address book of the GAL in the
+   specified directory: a full details file and, if a previous
+   generation exists, the changes from it
+
+   \param emsabp_ctx pointer to the EMSABP context. Its organization
+   name must be set.
+   \param path the output directory
+   \param stats pointer to the result of the generation, filled by the
+   function
+
+   \note The full details file of the previous generation is removed,
+   changes files are kept.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_oab_generate(struct emsabp_context *emsabp_ctx, const char *path,
+					     struct emsabp_oab_stats *stats)
+{
+	enum MAPISTATUS		retval;
+	TALLOC_CTX		*mem_ctx;
+	struct emsabp_oab_state	state;
+	struct ldb_request	*req = NULL;
+	DATA_BLOB		hdr_record;
+	const char		**attrs;
+	char			*filter;
+	char			*state_path;
+	char			*tmp_state_path;
+	uint32_t		prev_sequence = 0;
+	uint32_t		prev_serial = 0;
+	uint32_t		hdr[7];
+	int			ret;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!path, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx->organization_name, MAPI_E_NOT_INITIALIZED, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_oab_generate");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	memset(stats, 0, sizeof (struct emsabp_oab_stats));
+	memset(&state, 0, sizeof (struct emsabp_oab_state));
+	state.emsabp_ctx = emsabp_ctx;
+	state.stats = stats;
+
+	/* Step 1. Open the state of the previous generation */
+	state_path = talloc_asprintf(mem_ctx, "%s/" EMSABP_OAB_STATE, path);
+	tmp_state_path = talloc_asprintf(mem_ctx, "%s/" EMSABP_OAB_STATE ".tmp", path);
+	OPENCHANGE_RETVAL_IF(!state_path || !tmp_state_path, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	state.prev_tdb = tdb_open(state_path, 0, TDB_DEFAULT, O_RDONLY, 0600);
+	if (state.prev_tdb) {
+		if (!emsabp_oab_tdb_fetch_uint32(state.prev_tdb, EMSABP_OAB_KEY_SEQUENCE, &prev_sequence) ||
+		    !emsabp_oab_tdb_fetch_uint32(state.prev_tdb, EMSABP_OAB_KEY_SERIAL, &prev_serial)) {
+			DEBUG(1, ("[%s:%d]: Incomplete %s, generating a full details file only\n",
+				  __FUNCTION__, __LINE__, state_path));
+			tdb_close(state.prev_tdb);
+			state.prev_tdb = NULL;
+			prev_sequence = 0;
+		}
+	}
+	stats->sequence = prev_sequence + 1;
+
+	state.tdb = tdb_open(tmp_state_path, 0, TDB_DEFAULT, O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if (!state.tdb) {
+		DEBUG(0, ("[%s:%d]: Unable to create %s: %s\n", __FUNCTION__, __LINE__,
+			  tmp_state_path, strerror(errno)));
+		retval = MAPI_E_NO_ACCESS;
+		goto end;
+	}
+
+	/* Step 2. Create the files and write what precedes the records */
+	retval = emsabp_oab_file_open(mem_ctx, talloc_asprintf(mem_ctx, "%s/" EMSABP_OAB_FULL, path, stats->sequence),
+				      EMSABP_OAB_HDR_SIZE, &state.full);
+	if (retval) goto end;
+
+	if (state.prev_tdb) {
+		retval = emsabp_oab_file_open(mem_ctx, talloc_asprintf(mem_ctx, "%s/" EMSABP_OAB_CHANGES, path, stats->sequence),
+					      EMSABP_OAB_CHANGES_HDR_SIZE, &state.changes);
+		if (retval) goto end;
+	}
+
+	retval = emsabp_oab_push_meta(mem_ctx, &state.meta);
+	if (retval) goto end;
+	retval = emsabp_oab_push_hdr_record(mem_ctx, emsabp_ctx, stats->sequence, &hdr_record);
+	if (retval) goto end;
+
+	retval = emsabp_oab_file_write(state.full, &state.meta);
+	if (!retval) retval = emsabp_oab_file_write(state.full, &hdr_record);
+	if (!retval && state.changes) retval = emsabp_oab_file_write(state.changes, &state.meta);
+	if (!retval && state.changes) retval = emsabp_oab_file_write(state.changes, &hdr_record);
+	if (retval) goto end;
+
+	/* Step 3. Stream the GAL records */
+	retval = emsabp_ab_fetch_filter(mem_ctx, emsabp_ctx, 0, &filter);
+	if (retval) goto end;
+	(void) talloc_steal(mem_ctx, filter);
+
+	attrs = emsabp_property_get_attributes(mem_ctx);
+	if (!attrs) {
+		retval = MAPI_E_NOT_ENOUGH_MEMORY;
+		goto end;
+	}
+
+	ret = ldb_build_search_req(&req, emsabp_ctx->samdb_ctx, mem_ctx,
+				   ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
+				   LDB_SCOPE_SUBTREE, filter, attrs, NULL,
+				   &state, emsabp_oab_search_callback, NULL);
+	if (ret == LDB_SUCCESS) {
+		ret = ldb_request(emsabp_ctx->samdb_ctx, req);
+	}
+	if (ret == LDB_SUCCESS) {
+		ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+	}
+	if (ret != LDB_SUCCESS) {
+		DEBUG(0, ("[%s:%d]: GAL search failed: %s\n", __FUNCTION__, __LINE__,
+			  ldb_errstring(emsabp_ctx->samdb_ctx)));
+		retval = state.retval ? state.retval : MAPI_E_CALL_FAILED;
+		goto end;
+	}
+
+	/* Step 4. Find the deleted records */
+	if (state.changes) {
+		if (tdb_traverse_read(state.prev_tdb, emsabp_oab_traverse_deleted, &state) == -1) {
+			retval = state.retval ? state.retval : MAPI_E_CORRUPT_STORE;
+			goto end;
+		}
+	}
+
+	/* Step 5. Write the headers and commit the generation */
+	stats->serial = state.full->crc;
+
+	hdr[0] = EMSABP_OAB_VERSION;
+	hdr[1] = state.full->crc;
+	hdr[2] = stats->records;
+	retval = emsabp_oab_file_commit(state.full, hdr, 3);
+	if (retval) goto end;
+
+	if (state.changes) {
+		hdr[0] = EMSABP_OAB_VERSION;
+		hdr[1] = state.changes->crc;
+		hdr[2] = stats->added + stats->modified + stats->deleted;
+		hdr[3] = prev_serial;
+		hdr[4] = stats->serial;
+		hdr[5] = stats->added + stats->modified;
+		hdr[6] = stats->deleted;
+		retval = emsabp_oab_file_commit(state.changes, hdr, 7);
+		if (retval) goto end;
+	}
+
+	if (!emsabp_oab_tdb_store_uint32(state.tdb, EMSABP_OAB_KEY_SEQUENCE, stats->sequence) ||
+	    !emsabp_oab_tdb_store_uint32(state.tdb, EMSABP_OAB_KEY_SERIAL, stats->serial)) {
+		retval = MAPI_E_DISK_ERROR;
+		goto end;
+	}
+	tdb_close(state.tdb);
+	state.tdb = NULL;
+
+	if (rename(tmp_state_path, state_path) == -1) {
+		DEBUG(0, ("[%s:%d]: Unable to rename %s: %s\n", __FUNCTION__, __LINE__,
+			  tmp_state_path, strerror(errno)));
+		retval = MAPI_E_DISK_ERROR;
+		goto end;
+	}
+
+	if (prev_sequence) {
+		unlink(talloc_asprintf(mem_ctx, "%s/" EMSABP_OAB_FULL, path, prev_sequence));
+	}
+
+	DEBUG(3, ("[%s:%d]: OAB %u generated: %u records, %u added, %u modified, %u deleted\n",
+		  __FUNCTION__, __LINE__, stats->sequence, stats->records, stats->added,
+		  stats->modified, stats->deleted));
+
+end:
+	if (state.prev_tdb) {
+		tdb_close(state.prev_tdb);
+	}
+	if (state.tdb) {
+		tdb_close(state.tdb);
+		unlink(tmp_state_path);
+	}
+	talloc_free(mem_ctx);
+
+	return retval;
+}
@@ -114,6 +114,43 @@ _PUBLIC_ const char *emsabp_property_get_attribute(uint32_t ulPropTag)
 }
 
 
+/**
+   \details Return the list of AD attributes property tags are mapped
+   to, suitable for an ldb search
+
+   \param mem_ctx pointer to the memory context
+
+   \return NULL terminated list of attribute names on success,
+   otherwise NULL
+ */
+_PUBLIC_ const char **emsabp_property_get_attributes(TALLOC_CTX *mem_ctx)
+{
+	const char	**attrs;
+	uint32_t	count = 0;
+	uint32_t	i, j;
+
+	attrs = talloc_array(mem_ctx, const char *, ARRAY_SIZE(emsabp_property) + 1);
+	if (!attrs) return NULL;
+
+	/* distinguishedName is needed to map records to MIds */
+	attrs[count++] = "distinguishedName";
+	for (i = 0; emsabp_property[i].attribute; i++) {
+		/* anr is a search operator, not an attribute */
+		if (!strcmp(emsabp_property[i].attribute, "anr")) continue;
+
+		for (j = 0; j < count; j++) {
+			if (!strcmp(attrs[j], emsabp_property[i].attribute)) break;
+		}
+		if (j == count) {
+			attrs[count++] = emsabp_property[i].attribute;
+		}
+	}
+	attrs[count] = NULL;
+
+	return attrs;
+}
+
+
 /**
    \details Return the property tag associated to AD attribute name
 
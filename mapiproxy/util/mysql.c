@@ -22,6 +22,10 @@
 #include "mysql.h"
 
 #include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
 #include <util/debug.h>
 #include "ccan/htable/htable.h"
 #include "ccan/hash/hash.h"
@@ -52,6 +56,43 @@ static bool _ht_cmp(const void *e, void *string)
 static struct htable ht = HTABLE_INITIALIZER(ht, _ht_rehash, NULL);
 
 
+/* Items stored on stmt_ht table */
+struct stmt_v {
+	MYSQL		*conn;
+	const char	*sql;
+	MYSQL_STMT	*stmt;
+};
+
+/* Lookup key for stmt_ht table */
+struct stmt_k {
+	MYSQL		*conn;
+	const char	*sql;
+};
+
+static size_t _stmt_hash(MYSQL *conn, const char *sql)
+{
+	return hash_string(sql) + ((uintptr_t)conn >> 4);
+}
+
+/* Rehash function for stmt_ht table */
+static size_t _stmt_ht_rehash(const void *e, void *unused)
+{
+	return _stmt_hash(((struct stmt_v *)e)->conn, ((struct stmt_v *)e)->sql);
+}
+
+/* Comparison function to get items from stmt_ht table */
+static bool _stmt_ht_cmp(const void *e, void *key)
+{
+	const struct stmt_v	*v = (const struct stmt_v *)e;
+	const struct stmt_k	*k = (const struct stmt_k *)key;
+
+	return v->conn == k->conn && strcmp(v->sql, k->sql) == 0;
+}
+
+/* This is a dictionary [conn, query template] -> [MYSQL_STMT *] (actually struct stmt_v) */
+static struct htable stmt_ht = HTABLE_INITIALIZER(stmt_ht, _stmt_ht_rehash, NULL);
+
+
 static float timespec_diff_in_seconds(struct timespec *end, struct timespec *start)
 {
 	return ((float)((end->tv_sec * 1000000000 + end->tv_nsec) -
@@ -67,6 +108,8 @@ void close_all_connections(void)
 	struct htable_iter 	i;
 	struct conn_v		*entry;
 
+	close_all_statements();
+
 	entry = htable_first(&ht, &i);
 	while (entry) {
 		DEBUG(3, ("Closing %s\n", entry->connection_string));
@@ -446,6 +489,330 @@ enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql,
 }
 
 
+/**
+   \details Close and delete all prepared statements
+ */
+void close_all_statements(void)
+{
+	struct htable_iter	i;
+	struct stmt_v		*entry;
+
+	entry = htable_first(&stmt_ht, &i);
+	while (entry) {
+		mysql_stmt_close(entry->stmt);
+		talloc_free(entry);
+		entry = htable_next(&stmt_ht, &i);
+	}
+	htable_clear(&stmt_ht);
+}
+
+
+static void _stmt_drop(struct stmt_v *entry)
+{
+	htable_del(&stmt_ht, _stmt_hash(entry->conn, entry->sql), entry);
+	mysql_stmt_close(entry->stmt);
+	talloc_free(entry);
+}
+
+
+static struct stmt_v *_stmt_lookup(MYSQL *conn, const char *sql)
+{
+	struct stmt_v	*entry;
+	struct stmt_k	key;
+
+	key.conn = conn;
+	key.sql = sql;
+	entry = htable_get(&stmt_ht, _stmt_hash(conn, sql), _stmt_ht_cmp, &key);
+	if (entry) return entry;
+
+	// These entries are released by close_all_statements
+	entry = talloc_zero(talloc_autofree_context(), struct stmt_v);
+	if (!entry) return NULL;
+	entry->conn = conn;
+	entry->sql = talloc_strdup(entry, sql);
+	entry->stmt = mysql_stmt_init(conn);
+	if (!entry->sql || !entry->stmt) {
+		DEBUG(1, ("[MYSQL] Can't allocate statement for `%s`\n", sql));
+		goto fail;
+	}
+
+	if (mysql_stmt_prepare(entry->stmt, sql, strlen(sql)) != 0) {
+		DEBUG(1, ("[MYSQL] Error preparing `%s`: %s\n", sql,
+			  mysql_stmt_error(entry->stmt)));
+		goto fail;
+	}
+
+	if (!htable_add(&stmt_ht, _stmt_hash(conn, sql), entry)) {
+		DEBUG(1, ("[MYSQL] ERROR adding new statement to internal cache of statements\n"));
+		goto fail;
+	}
+	DEBUG(5, ("[MYSQL] Prepared new statement `%s`\n", sql));
+
+	return entry;
+fail:
+	if (entry->stmt) mysql_stmt_close(entry->stmt);
+	talloc_free(entry);
+	return NULL;
+}
+
+
+/**
+   \details Return the prepared statement for a query template on a
+   connection. Statements are prepared on first use and cached until
+   close_all_statements is called.
+
+   \param conn pointer to the MySQL connection
+   \param sql the query template, using ? as parameter markers
+
+   \return pointer to the prepared statement on success, otherwise NULL
+ */
+MYSQL_STMT *get_prepared_statement(MYSQL *conn, const char *sql)
+{
+	struct stmt_v	*entry;
+
+	if (!conn || !sql) return NULL;
+
+	entry = _stmt_lookup(conn, sql);
+	return entry ? entry->stmt : NULL;
+}
+
+
+static enum MYSQLRESULT _stmt_execute(struct stmt_v *entry, MYSQL_BIND *params)
+{
+	struct timespec	start, end;
+	float		seconds_spent;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (mysql_stmt_bind_param(entry->stmt, params) != 0 ||
+	    mysql_stmt_execute(entry->stmt) != 0) {
+		return MYSQL_ERROR;
+	}
+	if (mysql_stmt_store_result(entry->stmt) != 0) {
+		return MYSQL_ERROR;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds_spent = timespec_diff_in_seconds(&end, &start);
+	if (seconds_spent > THRESHOLD_SLOW_QUERIES) {
+		printf("MySQL slow query!\n"
+		       "\tQuery: `%s`\n\tTime: %.3f\n", entry->sql, seconds_spent);
+		DEBUG(5, ("MySQL slow query!\n"
+			  "\tQuery: `%s`\n\tTime: %.3f\n", entry->sql, seconds_spent));
+	}
+
+	return MYSQL_SUCCESS;
+}
+
+
+/* Shared by the prepared_select_first_* functions */
+static enum MYSQLRESULT _prepared_select_first_string(TALLOC_CTX *mem_ctx, MYSQL *conn,
+						     const char *sql, const char **s,
+						     const char *types, va_list ap)
+{
+	struct stmt_v		*entry;
+	MYSQL_BIND		params[MYSQL_STMT_MAX_PARAMS];
+	MYSQL_BIND		result;
+	union {
+		uint32_t	u32;
+		uint64_t	u64;
+	}			values[MYSQL_STMT_MAX_PARAMS];
+	unsigned long		lengths[MYSQL_STMT_MAX_PARAMS];
+	unsigned long		length = 0;
+	my_bool			is_null = 0;
+	char			*buffer;
+	const char		*str;
+	size_t			count, i;
+	unsigned int		err;
+	int			ret;
+	bool			retried = false;
+
+	if (!conn || !sql || !s || !types) {
+		DEBUG(0, ("Bad parameters when calling prepared select\n"));
+		return MYSQL_ERROR;
+	}
+
+	count = strlen(types);
+	if (count > MYSQL_STMT_MAX_PARAMS) {
+		DEBUG(0, ("Too many parameters for `%s`\n", sql));
+		return MYSQL_ERROR;
+	}
+
+	/* Step 1. Bind the parameters */
+	memset(params, 0, count * sizeof (MYSQL_BIND));
+	for (i = 0; i < count; i++) {
+		switch (types[i]) {
+		case 's':
+			str = va_arg(ap, const char *);
+			if (!str) str = "";
+			lengths[i] = strlen(str);
+			params[i].buffer_type = MYSQL_TYPE_STRING;
+			params[i].buffer = (void *)str;
+			params[i].buffer_length = lengths[i];
+			params[i].length = &lengths[i];
+			break;
+		case 'u':
+			values[i].u32 = va_arg(ap, uint32_t);
+			params[i].buffer_type = MYSQL_TYPE_LONG;
+			params[i].buffer = &values[i].u32;
+			params[i].is_unsigned = 1;
+			break;
+		case 'U':
+			values[i].u64 = va_arg(ap, uint64_t);
+			params[i].buffer_type = MYSQL_TYPE_LONGLONG;
+			params[i].buffer = &values[i].u64;
+			params[i].is_unsigned = 1;
+			break;
+		default:
+			DEBUG(0, ("Invalid parameter type '%c' for `%s`\n", types[i], sql));
+			return MYSQL_ERROR;
+		}
+	}
+
+retry:
+	/* Step 2. Lookup or prepare the statement and execute it */
+	entry = _stmt_lookup(conn, sql);
+	if (!entry) return MYSQL_ERROR;
+
+	if (mysql_stmt_param_count(entry->stmt) != count) {
+		DEBUG(0, ("Wrong number of parameters for `%s`\n", sql));
+		return MYSQL_ERROR;
+	}
+
+	if (_stmt_execute(entry, params) != MYSQL_SUCCESS) {
+		err = mysql_stmt_errno(entry->stmt);
+		DEBUG(3, ("Error on prepared query `%s`: %s\n", sql,
+			  mysql_stmt_error(entry->stmt)));
+		_stmt_drop(entry);
+		if (!retried && (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST ||
+				 err == ER_UNKNOWN_STMT_HANDLER || err == ER_NEED_REPREPARE)) {
+			retried = true;
+			goto retry;
+		}
+		return MYSQL_ERROR;
+	}
+
+	/* Step 3. Fetch the first column of the first row */
+	memset(&result, 0, sizeof (MYSQL_BIND));
+	result.buffer_type = MYSQL_TYPE_STRING;
+	result.length = &length;
+	result.is_null = &is_null;
+	if (mysql_stmt_bind_result(entry->stmt, &result) != 0) {
+		DEBUG(0, ("Error binding results of `%s`: %s\n", sql,
+			  mysql_stmt_error(entry->stmt)));
+		mysql_stmt_free_result(entry->stmt);
+		return MYSQL_ERROR;
+	}
+
+	ret = mysql_stmt_fetch(entry->stmt);
+	if (ret == MYSQL_NO_DATA) {
+		mysql_stmt_free_result(entry->stmt);
+		return MYSQL_NOT_FOUND;
+	}
+	if (ret != 0 && ret != MYSQL_DATA_TRUNCATED) {
+		DEBUG(0, ("Error getting row of `%s`: %s\n", sql,
+			  mysql_stmt_error(entry->stmt)));
+		mysql_stmt_free_result(entry->stmt);
+		return MYSQL_ERROR;
+	}
+
+	if (is_null) {
+		*s = NULL;
+	} else {
+		buffer = talloc_array(mem_ctx, char, length + 1);
+		if (!buffer) {
+			mysql_stmt_free_result(entry->stmt);
+			return MYSQL_ERROR;
+		}
+		result.buffer = buffer;
+		result.buffer_length = length + 1;
+		if (length && mysql_stmt_fetch_column(entry->stmt, &result, 0, 0) != 0) {
+			DEBUG(0, ("Error getting column of `%s`: %s\n", sql,
+				  mysql_stmt_error(entry->stmt)));
+			talloc_free(buffer);
+			mysql_stmt_free_result(entry->stmt);
+			return MYSQL_ERROR;
+		}
+		buffer[length] = '\0';
+		*s = buffer;
+	}
+	mysql_stmt_free_result(entry->stmt);
+
+	return MYSQL_SUCCESS;
+}
+
+
+/**
+   \details Execute a prepared select and fetch the first column of
+   its first row as a string
+
+   \param mem_ctx pointer to the memory context
+   \param conn pointer to the MySQL connection
+   \param sql the query template, using ? as parameter markers
+   \param s pointer on the string the function returns
+   \param types one character per parameter marker: 's' for a const
+   char *, 'u' for a uint32_t, 'U' for a uint64_t
+   \param ... parameter values, in the order given by types
+
+   \note A statement invalidated by a reconnection is prepared again
+   and executed a second time.
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if the query
+   returned no rows, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT prepared_select_first_string(TALLOC_CTX *mem_ctx, MYSQL *conn,
+					      const char *sql, const char **s,
+					      const char *types, ...)
+{
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+
+	va_start(ap, types);
+	ret = _prepared_select_first_string(mem_ctx, conn, sql, s, types, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+
+/**
+   \details Execute a prepared select and fetch the first column of
+   its first row as an unsigned integer
+
+   \param conn pointer to the MySQL connection
+   \param sql the query template, using ? as parameter markers
+   \param n pointer on the integer the function returns
+   \param types parameter types, see prepared_select_first_string
+   \param ... parameter values, in the order given by types
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if the query
+   returned no rows, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT prepared_select_first_uint(MYSQL *conn, const char *sql,
+					    uint64_t *n, const char *types, ...)
+{
+	TALLOC_CTX		*mem_ctx;
+	const char		*result = NULL;
+	enum MYSQLRESULT	ret;
+	va_list			ap;
+
+	if (!n) return MYSQL_ERROR;
+
+	mem_ctx = talloc_named(NULL, 0, "prepared_select_first_uint");
+	if (!mem_ctx) return MYSQL_ERROR;
+
+	va_start(ap, types);
+	ret = _prepared_select_first_string(mem_ctx, conn, sql, &result, types, ap);
+	va_end(ap);
+
+	if (ret == MYSQL_SUCCESS && (!result || !convert_string_to_ull(result, n))) {
+		ret = MYSQL_ERROR;
+	}
+
+	talloc_free(mem_ctx);
+	return ret;
+}
+
+
 bool table_exists(MYSQL *conn, char *table_name)
 {
 	MYSQL_RES *res;
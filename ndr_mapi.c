@@ -25,8 +25,6 @@
 #include "gen_ndr/ndr_exchange.h"
 #include "gen_ndr/ndr_property.h"
 
-#define MIN(a,b) ((a)<(b)?(a):(b))
-
 _PUBLIC_ void obfuscate_data(uint8_t *data, uint32_t size, uint8_t salt)
 {
 	uint32_t i;
@@ -36,135 +34,49 @@ _PUBLIC_ void obfuscate_data(uint8_t *data, uint32_t size, uint8_t salt)
 	}
 }
 
-ssize_t lzxpress_compress(const uint8_t *input,
-			  uint32_t input_size,
-			  uint8_t *output,
-			  uint32_t max_output_size);
-
-ssize_t lzxpress_decompress(const uint8_t *input,
-			    uint32_t input_size,
-			    uint8_t *output,
-			    uint32_t max_output_size);
-
 /**
-   \details Compress a LZXPRESS chunk
+   \details Decompress a LZXPRESS blob
 
-   \param ndrpush pointer to the compressed data to return
-   \param ndrpull pointer to the uncompressed data used for compression
-   \param last pointer on boolean to define whether or not this is the
-   last chunk
+   \param subndr pointer to the compressed blob
+   \param _comndr pointer on pointer to the uncompressed blob the
+   function returns
+   \param decompressed_len expected length of the uncompressed data
 
    \return NDR_ERR_SUCCESS on success, otherwise NDR error
  */
-static enum ndr_err_code ndr_push_lxpress_chunk(struct ndr_push *ndrpush,
-						struct ndr_pull *ndrpull,
-						bool *last)
-{
-	DATA_BLOB	comp_chunk;
-	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_size;
-	uint32_t	plain_chunk_offset;
-	uint32_t	max_plain_size = 0x00010000;
-	uint32_t	max_comp_size = 0x00020000 + 2; /* TODO: use the correct value here */
-	ssize_t		ret;
-
-	/* Step 1. Retrieve the uncompressed buf */
-	plain_chunk_size = MIN(max_plain_size, ndrpull->data_size - ndrpull->offset);
-	plain_chunk_offset = ndrpull->offset;
-	NDR_CHECK(ndr_pull_advance(ndrpull, plain_chunk_size));
-
-	plain_chunk.data = ndrpull->data + plain_chunk_offset;
-	plain_chunk.length = plain_chunk_size;
-	
-	if (plain_chunk_size < max_plain_size) {
-		*last = true;
-	};
-
-	NDR_CHECK(ndr_push_expand(ndrpush, max_comp_size));
-
-	comp_chunk.data = ndrpush->data + ndrpush->offset;
-	comp_chunk.length = max_comp_size;
-
-	/* Compressing the buffer using LZ Xpress algorithm */
-	ret = lzxpress_compress(plain_chunk.data,
-				plain_chunk.length,
-				comp_chunk.data,
-				comp_chunk.length);
-
-	if (ret < 0) {
-		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_compress() returned %d\n",
-				      (int)ret);
-	}
-	comp_chunk.length = ret;
-
-	ndrpush->offset += comp_chunk.length;
-	return NDR_ERR_SUCCESS;
-}
-
-static enum ndr_err_code ndr_pull_lxpress_chunk(struct ndr_pull *ndrpull,
-						struct ndr_push *ndrpush,
-						ssize_t decompressed_len,
-						bool *last)
-{
-	DATA_BLOB	comp_chunk;
-	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_offset;
-	int		ret;
-
-	/* Step 1. Retrieve the compressed buf */
-	comp_chunk.length = ndrpull->data_size;
-	comp_chunk.data = ndrpull->data;
-
-	plain_chunk_offset = ndrpush->offset;
-	NDR_CHECK(ndr_push_zero(ndrpush, decompressed_len));
-	plain_chunk.length = decompressed_len;
-	plain_chunk.data = ndrpush->data + plain_chunk_offset;
-
-	ret = lzxpress_decompress(comp_chunk.data,
-				  comp_chunk.length,
-				  plain_chunk.data,
-				  plain_chunk.length);
-	if (ret < 0) {
-		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_decompress() returned %d\n",
-				      (int)ret);
-	}
-	plain_chunk.length = ret;
-	ndrpush->offset = ret;
-
-	if ((decompressed_len < 0x00010000) || (ndrpull->offset+4 >= ndrpull->data_size)) {
-		/* this is the last chunk */
-		*last = true;
-	}
-
-	return NDR_ERR_SUCCESS;
-}
-
 _PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
 							struct ndr_pull **_comndr,
 							ssize_t decompressed_len)
 {
-	struct ndr_push *ndrpush;
 	struct ndr_pull *comndr;
 	DATA_BLOB	uncompressed;
-	bool		last = false;
+	ssize_t		ret;
 
-	ndrpush = ndr_push_init_ctx(subndr);
-	NDR_ERR_HAVE_NO_MEMORY(ndrpush);
+	if (decompressed_len < 0) {
+		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
+				      "Bad uncompressed_len [%d] (PULL)",
+				      (int)decompressed_len);
+	}
 
-	while (!last) {
-		NDR_CHECK(ndr_pull_lxpress_chunk(subndr, ndrpush, decompressed_len, &last));
+	uncompressed = data_blob_talloc(subndr, NULL, decompressed_len);
+	if (decompressed_len && !uncompressed.data) {
+		return ndr_pull_error(subndr, NDR_ERR_ALLOC,
+				      "Failed to allocate %d bytes (PULL)",
+				      (int)decompressed_len);
 	}
 
-	uncompressed = ndr_push_blob(ndrpush);
-	if (uncompressed.length != decompressed_len) {
+	ret = lzxpress_decompress_buffer(subndr->data + subndr->offset,
+					 subndr->data_size - subndr->offset,
+					 uncompressed.data,
+					 uncompressed.length);
+	if (ret != decompressed_len) {
 		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
-				      "Bad uncompressed_len [%u] != [%u](0x%08X) (PULL)",
-				      (int)uncompressed.length,
+				      "Bad uncompressed_len [%d] != [%u](0x%08X) (PULL)",
+				      (int)ret,
 				      (int)decompressed_len,
 				      (int)decompressed_len);
 	}
+	subndr->offset = subndr->data_size;
 
 	comndr = talloc_zero(subndr, struct ndr_pull);
 	NDR_ERR_HAVE_NO_MEMORY(comndr);
@@ -182,27 +94,30 @@ _PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
    \details Push a compressed LZXPRESS blob
 
    \param subndr pointer to the compressed blob the function returns
-   \param _uncomndr pointer on pointer to the uncompressed DATA blob
+   \param uncomndr pointer to the uncompressed DATA blob
 
    \return NDR_ERR_SUCCESS on success, otherwise NDR error
  */
 _PUBLIC_ enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *subndr,
 						      struct ndr_push *uncomndr)
 {
-	struct ndr_pull	*ndrpull;
-	bool		last = false;
+	uint32_t	max_comp_size;
+	ssize_t		ret;
 
-	ndrpull = talloc_zero(uncomndr, struct ndr_pull);
-	NDR_ERR_HAVE_NO_MEMORY(ndrpull);
-	ndrpull->flags = uncomndr->flags;
-	ndrpull->data = uncomndr->data;
-	ndrpull->data_size = uncomndr->offset;
-	ndrpull->offset = 0;
+	max_comp_size = LZXPRESS_COMPRESS_BOUND(uncomndr->offset);
+	NDR_CHECK(ndr_push_expand(subndr, max_comp_size));
 
-	while (!last) {
-		NDR_CHECK(ndr_push_lxpress_chunk(subndr, ndrpull, &last));
+	ret = lzxpress_compress_buffer(uncomndr->data,
+				       uncomndr->offset,
+				       subndr->data + subndr->offset,
+				       max_comp_size);
+	if (ret < 0) {
+		return ndr_push_error(subndr, NDR_ERR_COMPRESSION,
+				      "XPRESS lzxpress_compress_buffer() returned %d\n",
+				      (int)ret);
 	}
 
+	subndr->offset += ret;
 	return NDR_ERR_SUCCESS;
 }
 
@@ -276,7 +191,11 @@ _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_response(struct ndr_pull *ndr, int n
 				{
 					if (r->header.Flags & RHEF_Compressed) {
 						struct ndr_pull *_ndr_data_compressed = NULL;
-						
+
+						/* Obfuscation is applied on top of compression */
+						if (r->header.Flags & RHEF_XorMagic) {
+							obfuscate_data(_ndr_buffer->data, _ndr_buffer->data_size, 0xA5);
+						}
 						NDR_CHECK(ndr_pull_lzxpress_decompress(_ndr_buffer, &_ndr_data_compressed, r->header.SizeActual));
 						NDR_CHECK(ndr_pull_mapi_response(_ndr_data_compressed, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
 					} else if (r->header.Flags & RHEF_XorMagic) {
@@ -76,6 +76,7 @@ static PyObject *py_MAPIStoreContext_register_subscription(PyMAPIStoreContextObj
 		n.FolderID = 0;
 		n.MessageID = 0;
 		n.MAPIStoreURI = NULL;
+		ret = MAPISTORE_SUCCESS;
 	} else {
 		/* Retrieve folderID from mapistoreURI in openchange.ldb */
 
@@ -97,9 +98,6 @@ static PyObject *py_MAPIStoreContext_register_subscription(PyMAPIStoreContextObj
 	}
 	
 
-#if 0
-	ret = mapistore_mgmt_interface_register_subscription(self->mstore_ctx->conn_info, &n);
-#endif
 
 	/* Upon success attach subscription to session object using
 	 * existing mapistore_notification.c implementation */
@@ -148,6 +146,7 @@ static PyObject *py_MAPIStoreContext_unregister_subscription(PyMAPIStoreContextO
 		n.FolderID = 0;
 		n.MessageID = 0;
 		n.MAPIStoreURI = NULL;
+		ret = MAPISTORE_SUCCESS;
 	} else {
 		/* Retrieve folderID from mapistoreURI in openchange.ldb */
 		globals = get_PyMAPIStoreGlobals();
@@ -161,9 +160,6 @@ static PyObject *py_MAPIStoreContext_unregister_subscription(PyMAPIStoreContextO
 		n.MAPIStoreURI = mapistoreURI;
 	}
 	
-#if 0
-	ret = mapistore_mgmt_interface_unregister_subscription(self->mstore_ctx->conn_info, &n);
-#endif
 
 	/* Remove matching notifications from mapistore_notification system */
 	if (ret == MAPISTORE_SUCCESS) {
@@ -28,6 +28,7 @@ static void py_MAPIStoreMGMT_dealloc(PyObject *_self)
 
 	printf("deallocate MGMT object\n");
 	mapistore_mgmt_release(self->mgmt_ctx);
+	talloc_free(self->ev);
 
 	Py_XDECREF(self->parent);
 	PyObject_Del(_self);
@@ -251,6 +252,81 @@ static PyObject *py_MAPIStoreMGMT_send_newmail(PyMAPIStoreMGMTObject *self, PyOb
 	return PyBool_FromLong((ret == MAPISTORE_SUCCESS) ? true : false);
 }
 
+static PyObject *py_MAPIStoreMGMT_process_ipc(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	return PyBool_FromLong((mapistore_mgmt_process_ipc(self->mgmt_ctx) == MAPISTORE_SUCCESS) ? true : false);
+}
+
+static PyObject *py_MAPIStoreMGMT_set_event_loop(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	PyObject	*enabled;
+	int		ret;
+
+	if (!PyArg_ParseTuple(args, "O", &enabled)) {
+		return NULL;
+	}
+
+	if (!PyObject_IsTrue(enabled)) {
+		ret = mapistore_mgmt_set_event_context(self->mgmt_ctx, NULL);
+		return PyBool_FromLong((ret == MAPISTORE_SUCCESS) ? true : false);
+	}
+
+	if (!self->ev) {
+		self->ev = tevent_context_init(self->mem_ctx);
+		if (!self->ev) {
+			PyErr_SetMAPIStoreError(MAPISTORE_ERR_NO_MEMORY);
+			return NULL;
+		}
+	}
+
+	ret = mapistore_mgmt_set_event_context(self->mgmt_ctx, self->ev);
+	return PyBool_FromLong((ret == MAPISTORE_SUCCESS) ? true : false);
+}
+
+static PyObject *py_MAPIStoreMGMT_loop_once(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	if (!self->ev || !self->mgmt_ctx->ev) {
+		PyErr_SetMAPIStoreError(MAPISTORE_ERR_NOT_INITIALIZED);
+		return NULL;
+	}
+
+	return PyBool_FromLong((tevent_loop_once(self->ev) == 0) ? true : false);
+}
+
+static PyObject *py_MAPIStoreMGMT_set_newmail_limits(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	unsigned int	max_pending;
+	unsigned int	flush_delay;
+	int		ret;
+
+	if (!PyArg_ParseTuple(args, "II", &max_pending, &flush_delay)) {
+		return NULL;
+	}
+
+	ret = mapistore_mgmt_set_newmail_limits(self->mgmt_ctx, max_pending, flush_delay);
+	return PyBool_FromLong((ret == MAPISTORE_SUCCESS) ? true : false);
+}
+
+static PyObject *py_MAPIStoreMGMT_flush_newmail(PyMAPIStoreMGMTObject *self, PyObject *args)
+{
+	return PyBool_FromLong((mapistore_mgmt_flush_notifications(self->mgmt_ctx) == MAPISTORE_SUCCESS) ? true : false);
+}
+
+static PyObject *obj_get_stats(PyMAPIStoreMGMTObject *self, void *closure)
+{
+	PyObject	*dict;
+
+	dict = PyDict_New();
+	PyDict_SetItemString(dict, "ipc_received", PyLong_FromUnsignedLongLong(self->mgmt_ctx->stats.ipc_received));
+	PyDict_SetItemString(dict, "newmail_received", PyLong_FromUnsignedLongLong(self->mgmt_ctx->stats.newmail_received));
+	PyDict_SetItemString(dict, "newmail_coalesced", PyLong_FromUnsignedLongLong(self->mgmt_ctx->stats.newmail_coalesced));
+	PyDict_SetItemString(dict, "newmail_dropped", PyLong_FromUnsignedLongLong(self->mgmt_ctx->stats.newmail_dropped));
+	PyDict_SetItemString(dict, "newmail_sent", PyLong_FromUnsignedLongLong(self->mgmt_ctx->stats.newmail_sent));
+	PyDict_SetItemString(dict, "newmail_pending", PyLong_FromLong(self->mgmt_ctx->newmail_count));
+
+	return dict;
+}
+
 static PyObject *obj_get_verbose(PyMAPIStoreMGMTObject *self, void *closure)
 {
 	return PyBool_FromLong(self->mgmt_ctx->verbose);
@@ -272,12 +348,19 @@ static PyMethodDef mapistore_mgmt_methods[] = {
 	{ "registered_subscription", (PyCFunction)py_MAPIStoreMGMT_registered_subscription, METH_VARARGS },
 	{ "existing_users", (PyCFunction)py_MAPIStoreMGMT_existing_users, METH_VARARGS },
 	{ "send_newmail", (PyCFunction)py_MAPIStoreMGMT_send_newmail, METH_VARARGS },
+	{ "process_ipc", (PyCFunction)py_MAPIStoreMGMT_process_ipc, METH_NOARGS },
+	{ "set_event_loop", (PyCFunction)py_MAPIStoreMGMT_set_event_loop, METH_VARARGS },
+	{ "loop_once", (PyCFunction)py_MAPIStoreMGMT_loop_once, METH_NOARGS },
+	{ "set_newmail_limits", (PyCFunction)py_MAPIStoreMGMT_set_newmail_limits, METH_VARARGS },
+	{ "flush_newmail", (PyCFunction)py_MAPIStoreMGMT_flush_newmail, METH_NOARGS },
 	{ NULL },
 };
 
 static PyGetSetDef mapistore_mgmt_getsetters[] = {
 	{ (char *)"verbose", (getter)obj_get_verbose, (setter)obj_set_verbose, 
 	  "Enable/Disable verbosity for management object" },
+	{ (char *)"stats", (getter)obj_get_stats, NULL,
+	  "Management IPC and newmail notification counters" },
 	{ NULL }
 };
 
@@ -199,6 +199,7 @@ static PyObject *py_MAPIStore_new_mgmt(PyMAPIStoreObject *self, PyObject *args)
 		return NULL;
 	}
 	obj->mem_ctx = self->mem_ctx;
+	obj->ev = NULL;
 	obj->parent = self;
 	Py_INCREF(obj->parent);
 
@@ -48,6 +48,7 @@ typedef struct {
 	PyObject_HEAD
 	TALLOC_CTX			*mem_ctx;
 	struct mapistore_mgmt_context	*mgmt_ctx;
+	struct tevent_context		*ev;
 	PyMAPIStoreObject		*parent;
 } PyMAPIStoreMGMTObject;
 
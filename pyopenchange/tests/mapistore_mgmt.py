@@ -42,3 +42,10 @@ print "Registered message: %s" % mgmt.registered_message("SOGo", "Administrator"
 print "Registered message: %s" % mgmt.registered_message("SOGo", "Administrator", "Administrator", "inbox", "74")
 
 mgmt.existing_users("SOGo", "Administrator", "inbox")
+
+# Serve the IPC queue and coalesce newmail notifications from an event loop
+print "Set newmail limits: %s" % mgmt.set_newmail_limits(1024, 500)
+print "Serve IPC from an event loop: %s" % mgmt.set_event_loop(True)
+print "Loop once: %s" % mgmt.loop_once()
+print "Stats: %s" % mgmt.stats
+print "Stop serving IPC from the event loop: %s" % mgmt.set_event_loop(False)
@@ -539,6 +539,12 @@ temporary_private_tags_struct = """\t{ openchange_private_ROOT_FOLDER_FID,		PT_I
 	{ openchange_private_PF_LOCAL_OAB,		PT_I8, "openchange_private_PF_LOCAL_OAB" },
 """
 
+def write_sorted_index(f, name, positions):
+	f.write("static const uint16_t %s[] = {\n" % name)
+	for i in range(0, len(positions), 12):
+		f.write("\t" + ", ".join("%4d" % pos for pos in positions[i:i + 12]) + ",\n")
+	f.write("};\n")
+
 def make_mapi_properties_file():
 	proplines = []
 	altnamelines = []
@@ -675,6 +681,7 @@ def make_mapi_properties_file():
 	proplines = []
 	f = open('libmapi/property_tags.c', 'w')
 	proplines = []
+	proptag_values = {}
 	f.write("/* Automatically generated by script/makepropslist.py. Do not edit */\n")
 	f.write("#include \"libmapi/libmapi.h\"\n")
 	f.write("#include \"libmapi/libmapi_private.h\"\n")
@@ -700,49 +707,104 @@ def make_mapi_properties_file():
 			propline += string.ljust(datatypemap[entry["DataTypeName"]] + ",", 14)
 			propline += string.ljust("\"" + entry["CanonicalName"] + "\"" , 68) + "},\n"
 			proplines.append(propline)
+			proptag_values[entry["CanonicalName"]] = (entry["PropertyId"] << 16) | int(knowndatatypes[entry["DataTypeName"]], 16)
 			propline = "\t{ "
 			propline += string.ljust(entry["CanonicalName"] + "_Error,", 68)
 			propline += string.ljust("PT_ERROR,", 14)
 			propline += string.ljust("\"" + entry["CanonicalName"] + "_Error" + "\"" , 68) + "},\n"
 			proplines.append(propline)
+			proptag_values[entry["CanonicalName"] + "_Error"] = (entry["PropertyId"] << 16) | 0x000A
 	proplines.append(extra_private_tags_struct)
+	proptag_values["PidTagFolderChildCount"] = 0x66380003
 	# this is just a temporary hack till we properly support named properties
 	proplines.append(temporary_private_tags_struct)
+	for match in re.finditer(r"#define (\w+)\s+PROP_TAG\(.*\) /\* (0x[0-9a-fA-F]+) \*/", temporary_private_tags):
+		proptag_values[match.group(1)] = int(match.group(2), 16)
 	sortedproplines = sorted(proplines)
 	f.write("static struct mapi_proptags canonical_property_tags[] = {\n")
 	for propline in sortedproplines:
 		f.write(propline)
 	f.write("\t{ 0,                                                                  0,            \"NULL\"                                                              }\n")
 	f.write("};\n")
+
+	# sorted positions in canonical_property_tags for binary searches
+	canonical = []
+	for propline in "".join(sortedproplines).splitlines():
+		propname = re.match(r"\t\{ (\w+),", propline).group(1)
+		canonical.append((len(canonical), propname, proptag_values[propname]))
+	f.write("\n/* canonical_property_tags positions sorted by property tag and by name */\n")
+	write_sorted_index(f, "canonical_property_tags_by_tag",
+			   [pos for (pos, propname, proptag) in sorted(canonical, key=lambda c: (c[2], c[0]))])
+	f.write("\n")
+	write_sorted_index(f, "canonical_property_tags_by_name",
+			   [pos for (pos, propname, proptag) in sorted(canonical, key=lambda c: (c[1], c[0]))])
 	f.write("""
+#define	CANONICAL_PROPERTY_TAGS_COUNT	(sizeof (canonical_property_tags_by_tag) / sizeof (canonical_property_tags_by_tag[0]))
+
+/* Position in canonical_property_tags_by_tag of the first entry not
+   lower than proptag */
+static uint32_t proptag_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static const char *proptag_find_name(uint32_t proptag)
+{
+	uint32_t	pos;
+
+	pos = proptag_lower_bound(proptag);
+	if (pos < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[pos]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[pos]].propname;
+	}
+
+	return NULL;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const char	*propname;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	propname = proptag_find_name(proptag);
+	if (propname) {
+		return propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+		return proptag_find_name(proptag + 1); /* try as _UNICODE variant */
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
-
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+	int		ret;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(canonical_property_tags[canonical_property_tags_by_name[mid]].propname, propname);
+		if (ret == 0) {
+			return canonical_property_tags[canonical_property_tags_by_name[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -751,17 +813,27 @@ _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
+	uint32_t	pos;
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* Pick the first suitable entry in table order, as a linear
+	   scan of canonical_property_tags would */
+	for (pos = proptag_lower_bound((uint32_t)untypedtag << 16);
+	     pos < CANONICAL_PROPERTY_TAGS_COUNT; pos++) {
+		idx = canonical_property_tags_by_tag[pos];
+		if ((canonical_property_tags[idx].proptag >> 16) != untypedtag) {
+			break;
+		}
+		current_type = canonical_property_tags[idx].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 && idx < found) {
+			found = idx;
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\\n", __FUNCTION__, untypedtag));
 	return 0;
@@ -1127,6 +1199,16 @@ def find_key(dic, val):
 	except ValueError:
 		print "Value %s not found" % val
 
+def read_oleguids():
+	oleguids = {}
+	f = open('libmapi/mapidefs.h', 'r')
+	for line in f:
+		match = re.match(r"#define\s+(PS\w+)\s+\"([^\"]*)\"", line)
+		if match:
+			oleguids[match.group(1)] = match.group(2)
+	f.close()
+	return oleguids
+
 def make_mapi_named_properties_file():
 	content = ""
 	attributes = ""
@@ -1320,9 +1402,11 @@ struct mapi_nameid {
 /* MNID_ID named properties */
 """)
 
+	namedprop_values = {}
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
-			proptag = "0x%.8x" % (int(line[2], 16) << 16 | int(line[4], 16))
+			namedprop_values[line[0]] = int(line[2], 16) << 16 | int(line[4], 16)
+			proptag = "0x%.8x" % namedprop_values[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			f.write(propline)
 
@@ -1330,12 +1414,14 @@ struct mapi_nameid {
 	mnstring_id = 0xa000
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
-			proptag = "0x%.8x" % ((mnstring_id << 16) | int(line[4], 16))
+			namedprop_values[line[0]] = (mnstring_id << 16) | int(line[4], 16)
+			proptag = "0x%.8x" % namedprop_values[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			mnstring_id += 1
 			f.write(propline)
 
 	# Additional properties
+	namedprop_values["PidLidRemoteTransferSize"] = 0x8f050003
 	propline = "#define %s %s\n" % (string.ljust("PidLidRemoteTransferSize", 60), string.ljust("0x8f050003", 20))
 	f.write(propline)
 
@@ -1352,8 +1438,11 @@ struct mapi_nameid {
 static struct mapi_nameid_tags mapi_nameid_tags[] = {
 """)
 
+	oleguids = read_oleguids()
+	nameid_tags = []
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
+			nameid_tags.append((len(nameid_tags), namedprop_values[line[0]], line[1], int(line[2], 16), None, oleguids[line[6]]))
 			OOM = "\"%s\"" % line[1]
 			key = find_key(knowndatatypes, line[4])
 			datatype = datatypemap[key]
@@ -1364,6 +1453,7 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
+			nameid_tags.append((len(nameid_tags), namedprop_values[line[0]], None, int(line[2], 16), line[3], oleguids[line[6]]))
 			OOM = "%s" % line[1]
 			key = find_key(knowndatatypes, line[4])
 			datatype = datatypemap[key]
@@ -1373,6 +1463,7 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 			f.write(propline)
 
 	# Addtional named properties
+	nameid_tags.append((len(nameid_tags), namedprop_values["PidLidRemoteTransferSize"], "RemoteTransferSize", 0x8f05, None, oleguids["PSETID_Remote"]))
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s },\n" % (
 		string.ljust("PidLidRemoteTransferSize", 60), string.ljust("\"RemoteTransferSize\"", 65), "0x8f05",
 		"NULL", string.ljust("PT_LONG", 15), "MNID_ID", "PSETID_Remote", "0x0")
@@ -1400,7 +1491,29 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 	f.write(propline)
 	f.write("""
 };
+""")
 
+	# sorted positions in the tables above for binary searches
+	nameid_names = [(pos, namedprop_values[line[0]], line[0]) for (pos, line) in enumerate(sortednamedprops)]
+	f.write("\n/* mapi_nameid_tags and mapi_nameid_names positions sorted for binary searches */\n")
+	write_sorted_index(f, "mapi_nameid_tags_by_tag",
+			   [t[0] for t in sorted(nameid_tags, key=lambda t: (t[1], t[0]))])
+	f.write("\n")
+	write_sorted_index(f, "mapi_nameid_tags_by_lid",
+			   [t[0] for t in sorted([t for t in nameid_tags if t[3]], key=lambda t: (t[5], t[3], t[0]))])
+	f.write("\n")
+	write_sorted_index(f, "mapi_nameid_tags_by_name",
+			   [t[0] for t in sorted([t for t in nameid_tags if t[4] is not None], key=lambda t: (t[5], t[4], t[0]))])
+	f.write("\n")
+	write_sorted_index(f, "mapi_nameid_tags_by_OOM",
+			   [t[0] for t in sorted([t for t in nameid_tags if t[2] is not None], key=lambda t: (t[5], t[2], t[0]))])
+	f.write("\n")
+	write_sorted_index(f, "mapi_nameid_names_by_tag",
+			   [n[0] for n in sorted(nameid_names, key=lambda n: (n[1], n[0]))])
+	f.write("\n")
+	write_sorted_index(f, "mapi_nameid_names_by_name",
+			   [n[0] for n in sorted(nameid_names, key=lambda n: (n[2], n[0]))])
+	f.write("""
 #endif /* !MAPI_NAMEID_PRIVATE_H__ */
 """)
 	f.close()
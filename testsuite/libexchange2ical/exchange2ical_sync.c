@@ -0,0 +1,182 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libexchange2ical/exchange2ical.c"
+
+#define	SYNC_TEST_REPLID	0x0001
+#define	SYNC_TEST_DELETED	0x1234
+#define	SYNC_TEST_KEPT		0x1235
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct exchange2ical_sync	*test_sync;
+static uint32_t				cancel_count;
+static char				*cancel_uid;
+
+/* MetaTagIdsetDeleted as sent by Exchange for a single deleted message:
+   REPLID 0x0001, then a GLOBSET pushing the 6 bytes of the GLOBCNT */
+static const uint8_t idset_deleted[] = {
+	0x01, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34,
+	0x00
+};
+
+static mapi_id_t _sync_test_mid(uint64_t globcnt)
+{
+	return (exchange_globcnt(globcnt) << 16) | SYNC_TEST_REPLID;
+}
+
+static void _sync_test_export(mapi_id_t mid, const char *uid)
+{
+	icalcomponent	*vcalendar;
+	icalcomponent	*vevent;
+
+	vcalendar = icalcomponent_new_vcalendar();
+	vevent = icalcomponent_new_vevent();
+	icalcomponent_add_property(vevent, icalproperty_new_uid(uid));
+	icalcomponent_add_component(vcalendar, vevent);
+	exchange2ical_sync_set_uid(test_sync, mid, vcalendar);
+	icalcomponent_free(vcalendar);
+}
+
+static int _sync_test_callback(icalcomponent *vcalendar, void *private_data)
+{
+	icalcomponent	*vevent;
+
+	cancel_count++;
+	ck_assert_int_eq(icalcomponent_get_method(vcalendar), ICAL_METHOD_CANCEL);
+	vevent = icalcomponent_get_first_component(vcalendar, ICAL_VEVENT_COMPONENT);
+	ck_assert(vevent != NULL);
+	ck_assert_int_eq(icalcomponent_get_status(vevent), ICAL_STATUS_CANCELLED);
+	cancel_uid = talloc_strdup(mem_ctx, icalcomponent_get_uid(vevent));
+
+	return 0;
+}
+
+/* Feed an incremental synchronization stream deleting the message */
+static void _sync_test_download(void)
+{
+	struct fx_parser_context	*parser;
+	struct ndr_push			*ndr;
+	DATA_BLOB			transfer_data;
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_push_uint32(ndr, NDR_SCALARS, IncrSyncDel);
+	ndr_push_uint32(ndr, NDR_SCALARS, MetaTagIdsetDeleted);
+	ndr_push_uint32(ndr, NDR_SCALARS, sizeof (idset_deleted));
+	ndr_push_bytes(ndr, idset_deleted, sizeof (idset_deleted));
+	ndr_push_uint32(ndr, NDR_SCALARS, IncrSyncEnd);
+	transfer_data.data = ndr->data;
+	transfer_data.length = ndr->offset;
+
+	parser = fxparser_init(mem_ctx, test_sync);
+	fxparser_set_marker_callback(parser, exchange2ical_sync_marker);
+	fxparser_set_property_callback(parser, exchange2ical_sync_property);
+	ck_assert_int_eq(fxparser_parse(parser, &transfer_data), MAPI_E_SUCCESS);
+	talloc_free(parser);
+}
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_sync_idset_deleted) {
+	struct idset	*deleted;
+	DATA_BLOB	data;
+
+	data.data = (uint8_t *) idset_deleted;
+	data.length = sizeof (idset_deleted);
+	deleted = IDSET_parse(mem_ctx, data, true);
+	ck_assert(deleted != NULL);
+	ck_assert(deleted->idbased);
+	ck_assert_int_eq(deleted->repl.id, SYNC_TEST_REPLID);
+	ck_assert_int_eq(deleted->range_count, 1);
+	ck_assert(deleted->next == NULL);
+	ck_assert(IDSET_includes_eid(deleted, _sync_test_mid(SYNC_TEST_DELETED)));
+	ck_assert(!IDSET_includes_eid(deleted, _sync_test_mid(SYNC_TEST_KEPT)));
+
+	/* truncated sets are rejected */
+	data.length = sizeof (idset_deleted) - 1;
+	ck_assert(IDSET_parse(mem_ctx, data, true) == NULL);
+	data.length = 2;
+	ck_assert(IDSET_parse(mem_ctx, data, true) == NULL);
+} END_TEST
+
+START_TEST (test_sync_cancel_deleted) {
+	struct ndr_push	*ndr;
+	struct ndr_pull	*ndr_pull;
+	DATA_BLOB	state;
+
+	_sync_test_export(_sync_test_mid(SYNC_TEST_DELETED), "deleted-uid");
+	_sync_test_export(_sync_test_mid(SYNC_TEST_KEPT), "kept-uid");
+	_sync_test_download();
+	ck_assert(test_sync->deleted != NULL);
+
+	ck_assert_int_eq(exchange2ical_sync_cancel_deleted(test_sync, _sync_test_callback, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(cancel_count, 1);
+	ck_assert_str_eq(cancel_uid, "deleted-uid");
+
+	/* the cancelled appointment is dropped from the new state */
+	ndr = ndr_push_init_ctx(mem_ctx);
+	ck_assert_int_eq(exchange2ical_sync_push(ndr, test_sync), NDR_ERR_SUCCESS);
+	state.data = ndr->data;
+	state.length = ndr->offset;
+
+	test_sync = talloc_zero(mem_ctx, struct exchange2ical_sync);
+	test_sync->mem_ctx = test_sync;
+	ndr_pull = ndr_pull_init_blob(&state, test_sync);
+	ck_assert_int_eq(exchange2ical_sync_pull(ndr_pull, test_sync), NDR_ERR_SUCCESS);
+	ck_assert_int_eq(test_sync->uid_count, 1);
+	ck_assert_str_eq(test_sync->uids[0].uid, "kept-uid");
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_sync_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libexchange2ical_sync_suite");
+	test_sync = talloc_zero(mem_ctx, struct exchange2ical_sync);
+	test_sync->mem_ctx = test_sync;
+	cancel_count = 0;
+	cancel_uid = NULL;
+}
+
+static void tc_sync_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libexchange2ical_sync_suite(void)
+{
+	Suite *s = suite_create("libexchange2ical sync");
+
+	TCase *tc = tcase_create("deleted appointments");
+	tcase_add_checked_fixture(tc, tc_sync_setup, tc_sync_teardown);
+
+	tcase_add_test(tc, test_sync_idset_deleted);
+	tcase_add_test(tc, test_sync_cancel_deleted);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,258 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/* Global test variables */
+static TALLOC_CTX *mem_ctx;
+
+
+/* Build a request made of count Release ROPs */
+static struct mapi_request *_make_request(uint32_t count)
+{
+	struct mapi_request	*req;
+	uint32_t		i;
+
+	req = talloc_zero(mem_ctx, struct mapi_request);
+	req->mapi_req = talloc_zero_array(req, struct EcDoRpc_MAPI_REQ, count + 1);
+	for (i = 0; i < count; i++) {
+		req->mapi_req[i].opnum = op_MAPI_Release;
+		req->mapi_req[i].logon_id = 0;
+		req->mapi_req[i].handle_idx = 0;
+	}
+	req->length = 2 + 3 * count;
+	req->mapi_len = req->length + sizeof (uint32_t);
+	req->handles = talloc_array(req, uint32_t, 1);
+	req->handles[0] = 0x1234;
+
+	return req;
+}
+
+static void _pull_request(DATA_BLOB *rgbIn, struct mapi2k7_request *mapi2k7_request)
+{
+	struct ndr_pull	*ndr_pull;
+
+	ndr_pull = ndr_pull_init_blob(rgbIn, mem_ctx);
+	ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+	ck_assert_int_eq(ndr_pull_mapi2k7_request(ndr_pull, NDR_SCALARS|NDR_BUFFERS, mapi2k7_request), NDR_ERR_SUCCESS);
+}
+
+/* Push an extended buffer holding count failed OpenMessage replies */
+static void _push_response_buffer(struct ndr_push *ndr_rgbOut, uint32_t count,
+				  enum MAPISTATUS error_code, uint16_t flags)
+{
+	struct mapi_response	response;
+	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
+	struct ndr_push		*ndr_uncomp;
+	struct ndr_push		*ndr_payload;
+	uint32_t		i;
+
+	response.mapi_repl = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REPL, count + 1);
+	for (i = 0; i < count; i++) {
+		response.mapi_repl[i].opnum = op_MAPI_OpenMessage;
+		response.mapi_repl[i].handle_idx = i;
+		response.mapi_repl[i].error_code = error_code;
+	}
+	response.length = 2 + 6 * count;
+	response.mapi_len = response.length + sizeof (uint32_t);
+	response.handles = talloc_array(mem_ctx, uint32_t, 1);
+	response.handles[0] = 0x1234;
+
+	ndr_uncomp = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_uncomp->flags, LIBNDR_FLAG_NOALIGN);
+	ck_assert_int_eq(ndr_push_mapi_response(ndr_uncomp, NDR_SCALARS|NDR_BUFFERS, &response), NDR_ERR_SUCCESS);
+
+	ndr_payload = ndr_uncomp;
+	if (flags & RHEF_Compressed) {
+		ndr_payload = ndr_push_init_ctx(mem_ctx);
+		ndr_set_flags(&ndr_payload->flags, LIBNDR_FLAG_NOALIGN);
+		ck_assert_int_eq(ndr_push_lzxpress_compress(ndr_payload, ndr_uncomp), NDR_ERR_SUCCESS);
+	}
+	if (flags & RHEF_XorMagic) {
+		obfuscate_data(ndr_payload->data, ndr_payload->offset, 0xA5);
+	}
+
+	RPC_HEADER_EXT.Version = 0x0000;
+	RPC_HEADER_EXT.Flags = flags;
+	RPC_HEADER_EXT.Size = ndr_payload->offset;
+	RPC_HEADER_EXT.SizeActual = ndr_uncomp->offset;
+	ck_assert_int_eq(ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT), NDR_ERR_SUCCESS);
+	ck_assert_int_eq(ndr_push_bytes(ndr_rgbOut, ndr_payload->data, ndr_payload->offset), NDR_ERR_SUCCESS);
+}
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_ext2_request_small) {
+	struct mapi_request	*req;
+	struct mapi2k7_request	mapi2k7_request;
+	DATA_BLOB		rgbIn;
+	bool			compressed = true;
+
+	/* Requests below the threshold are only obfuscated */
+	req = _make_request(4);
+	ck_assert_int_eq(emsmdb_push_ext2_request(mem_ctx, req, true, &rgbIn, &compressed), NDR_ERR_SUCCESS);
+	ck_assert(compressed == false);
+	ck_assert_int_eq(rgbIn.length, 8 + req->mapi_len);
+
+	_pull_request(&rgbIn, &mapi2k7_request);
+	ck_assert_int_eq(mapi2k7_request.header.Flags, RHEF_XorMagic|RHEF_Last);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->length, req->length);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->mapi_req[3].opnum, op_MAPI_Release);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->mapi_req[4].opnum, 0);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->handles[0], 0x1234);
+} END_TEST
+
+START_TEST (test_ext2_request_compressed) {
+	struct mapi_request	*req;
+	struct mapi2k7_request	mapi2k7_request;
+	DATA_BLOB		rgbIn;
+	bool			compressed = false;
+
+	req = _make_request(1000);
+	ck_assert_int_eq(emsmdb_push_ext2_request(mem_ctx, req, true, &rgbIn, &compressed), NDR_ERR_SUCCESS);
+	ck_assert(compressed == true);
+	ck_assert(rgbIn.length < req->mapi_len / 4);
+
+	_pull_request(&rgbIn, &mapi2k7_request);
+	ck_assert_int_eq(mapi2k7_request.header.Flags, RHEF_Compressed|RHEF_XorMagic|RHEF_Last);
+	ck_assert_int_eq(mapi2k7_request.header.SizeActual, req->mapi_len);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->length, req->length);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->mapi_req[999].opnum, op_MAPI_Release);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->mapi_req[1000].opnum, 0);
+	ck_assert_int_eq(mapi2k7_request.mapi_request->handles[0], 0x1234);
+
+	/* Compression disabled on the session */
+	ck_assert_int_eq(emsmdb_push_ext2_request(mem_ctx, req, false, &rgbIn, &compressed), NDR_ERR_SUCCESS);
+	ck_assert(compressed == false);
+	ck_assert_int_eq(rgbIn.length, 8 + req->mapi_len);
+} END_TEST
+
+START_TEST (test_ext2_response_chained) {
+	struct ndr_push		*ndr_rgbOut;
+	struct mapi_response	*response;
+	DATA_BLOB		rgbOut;
+
+	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
+	_push_response_buffer(ndr_rgbOut, 2, MAPI_E_NOT_FOUND, RHEF_XorMagic);
+	_push_response_buffer(ndr_rgbOut, 1, MAPI_E_NO_ACCESS, 0);
+	_push_response_buffer(ndr_rgbOut, 3, MAPI_E_CALL_FAILED, RHEF_Compressed|RHEF_XorMagic|RHEF_Last);
+	rgbOut.data = ndr_rgbOut->data;
+	rgbOut.length = ndr_rgbOut->offset;
+
+	ck_assert_int_eq(emsmdb_pull_ext2_response(mem_ctx, &rgbOut, &response), NDR_ERR_SUCCESS);
+	ck_assert(response != NULL);
+	ck_assert_int_eq(response->mapi_repl[0].error_code, MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(response->mapi_repl[1].error_code, MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(response->mapi_repl[1].handle_idx, 1);
+	ck_assert_int_eq(response->mapi_repl[2].error_code, MAPI_E_NO_ACCESS);
+	ck_assert_int_eq(response->mapi_repl[3].error_code, MAPI_E_CALL_FAILED);
+	ck_assert_int_eq(response->mapi_repl[5].error_code, MAPI_E_CALL_FAILED);
+	ck_assert_int_eq(response->mapi_repl[5].handle_idx, 2);
+	ck_assert_int_eq(response->mapi_repl[6].opnum, 0);
+	ck_assert_int_eq(response->length, 2 + 6 * 6);
+	ck_assert_int_eq(response->handles[0], 0x1234);
+} END_TEST
+
+START_TEST (test_ext2_response_single) {
+	struct ndr_push		*ndr_rgbOut;
+	struct mapi_response	*response;
+	DATA_BLOB		rgbOut;
+
+	/* A trailing buffer after RHEF_Last is ignored */
+	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
+	_push_response_buffer(ndr_rgbOut, 2, MAPI_E_NOT_FOUND, RHEF_Compressed|RHEF_Last);
+	_push_response_buffer(ndr_rgbOut, 1, MAPI_E_NO_ACCESS, RHEF_Last);
+	rgbOut.data = ndr_rgbOut->data;
+	rgbOut.length = ndr_rgbOut->offset;
+
+	ck_assert_int_eq(emsmdb_pull_ext2_response(mem_ctx, &rgbOut, &response), NDR_ERR_SUCCESS);
+	ck_assert_int_eq(response->mapi_repl[1].error_code, MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(response->mapi_repl[2].opnum, 0);
+	ck_assert_int_eq(response->length, 2 + 6 * 2);
+
+	/* Truncated buffer */
+	rgbOut.length = 10;
+	ck_assert(emsmdb_pull_ext2_response(mem_ctx, &rgbOut, &response) != NDR_ERR_SUCCESS);
+} END_TEST
+
+START_TEST (test_ext2_max_rgbout) {
+	struct mapi_session	*session;
+	struct emsmdb_context	*emsmdb_ctx;
+	uint32_t		transactions;
+	uint64_t		bytes;
+
+	session = talloc_zero(mem_ctx, struct mapi_session);
+	ck_assert_int_eq(emsmdb_set_max_rgbout(NULL, 0x10000), MAPI_E_SESSION_LIMIT);
+	ck_assert_int_eq(emsmdb_set_max_rgbout(session, 0x10000), MAPI_E_NOT_INITIALIZED);
+
+	session->emsmdb = talloc_zero(session, struct mapi_provider);
+	emsmdb_ctx = talloc_zero(session->emsmdb, struct emsmdb_context);
+	emsmdb_ctx->max_rgbout = EMSMDB_RGBOUT_DEFAULT_SIZE;
+	emsmdb_ctx->transactions = 3;
+	emsmdb_ctx->rgbout_bytes = 0x18000;
+	session->emsmdb->ctx = emsmdb_ctx;
+
+	ck_assert_int_eq(emsmdb_set_max_rgbout(session, 0x10000), MAPI_E_SUCCESS);
+	ck_assert_int_eq(emsmdb_ctx->max_rgbout, 0x10000);
+	ck_assert_int_eq(emsmdb_set_max_rgbout(session, 0x100), MAPI_E_SUCCESS);
+	ck_assert_int_eq(emsmdb_ctx->max_rgbout, EMSMDB_RGBOUT_DEFAULT_SIZE);
+	ck_assert_int_eq(emsmdb_set_max_rgbout(session, 0x100000), MAPI_E_SUCCESS);
+	ck_assert_int_eq(emsmdb_ctx->max_rgbout, EMSMDB_RGBOUT_MAX_SIZE);
+
+	ck_assert_int_eq(emsmdb_get_transaction_stats(session, NULL, &bytes), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsmdb_get_transaction_stats(session, &transactions, &bytes), MAPI_E_SUCCESS);
+	ck_assert_int_eq(transactions, 3);
+	ck_assert(bytes == 0x18000);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_emsmdb_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libmapi_emsmdb_suite");
+}
+
+static void tc_emsmdb_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_emsmdb_suite(void)
+{
+	Suite *s = suite_create("libmapi emsmdb");
+
+	TCase *tc = tcase_create("EcDoRpcExt2 buffers");
+	tcase_add_checked_fixture(tc, tc_emsmdb_setup, tc_emsmdb_teardown);
+
+	tcase_add_test(tc, test_ext2_request_small);
+	tcase_add_test(tc, test_ext2_request_compressed);
+	tcase_add_test(tc, test_ext2_response_chained);
+	tcase_add_test(tc, test_ext2_response_single);
+	tcase_add_test(tc, test_ext2_max_rgbout);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
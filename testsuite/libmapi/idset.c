@@ -0,0 +1,217 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+
+#define	IDSET_TEST_MAX_GLOBCNT	4096
+#define	IDSET_TEST_REPLID	0x0001
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static struct GUID	replica_guid;
+
+
+/* Globcnt n is in the set when n is a multiple of 3 or 7 */
+static bool _in_test_set(uint64_t n)
+{
+	return (n % 3 == 0) || (n % 7 == 0);
+}
+
+static struct idset *_make_test_idset(bool idbased)
+{
+	struct rawidset	*rawidset;
+	uint64_t	n;
+
+	rawidset = RAWIDSET_make(mem_ctx, idbased, false);
+	/* push values in descending order, the idset must sort them */
+	for (n = IDSET_TEST_MAX_GLOBCNT; n > 0; n--) {
+		if (!_in_test_set(n)) continue;
+		if (idbased) {
+			RAWIDSET_push_eid(rawidset, (exchange_globcnt(n) << 16) | IDSET_TEST_REPLID);
+		} else {
+			RAWIDSET_push_guid_glob(rawidset, &replica_guid, exchange_globcnt(n));
+		}
+	}
+
+	return RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+}
+
+START_TEST (test_idset_includes_guid_glob) {
+	struct idset	*idset;
+	struct GUID	other_guid;
+	uint64_t	n;
+
+	idset = _make_test_idset(false);
+	ck_assert(idset != NULL);
+
+	for (n = 1; n <= IDSET_TEST_MAX_GLOBCNT + 8; n++) {
+		ck_assert_int_eq(IDSET_includes_guid_glob(idset, &replica_guid, exchange_globcnt(n)),
+				 n <= IDSET_TEST_MAX_GLOBCNT && _in_test_set(n));
+	}
+
+	other_guid = GUID_random();
+	ck_assert(!IDSET_includes_guid_glob(idset, &other_guid, exchange_globcnt(3)));
+	ck_assert(!IDSET_includes_guid_glob(idset, NULL, exchange_globcnt(3)));
+} END_TEST
+
+START_TEST (test_idset_includes_eid) {
+	struct idset	*idset;
+	uint64_t	n;
+
+	idset = _make_test_idset(true);
+	ck_assert(idset != NULL);
+
+	for (n = 1; n <= IDSET_TEST_MAX_GLOBCNT + 8; n++) {
+		ck_assert_int_eq(IDSET_includes_eid(idset, (exchange_globcnt(n) << 16) | IDSET_TEST_REPLID),
+				 n <= IDSET_TEST_MAX_GLOBCNT && _in_test_set(n));
+	}
+
+	ck_assert(!IDSET_includes_eid(idset, (exchange_globcnt(3) << 16) | (IDSET_TEST_REPLID + 1)));
+} END_TEST
+
+START_TEST (test_idset_filter) {
+	struct idset	*idset;
+	uint64_t	ids[IDSET_TEST_MAX_GLOBCNT];
+	bool		included[IDSET_TEST_MAX_GLOBCNT];
+	uint32_t	i, expected = 0;
+
+	for (i = 0; i < IDSET_TEST_MAX_GLOBCNT; i++) {
+		ids[i] = exchange_globcnt(i + 1);
+		if (_in_test_set(i + 1)) expected++;
+	}
+
+	idset = _make_test_idset(false);
+	ck_assert_int_eq(IDSET_filter_guid_globs(idset, &replica_guid, ids, IDSET_TEST_MAX_GLOBCNT, included), expected);
+	for (i = 0; i < IDSET_TEST_MAX_GLOBCNT; i++) {
+		ck_assert_int_eq(included[i], _in_test_set(i + 1));
+	}
+
+	for (i = 0; i < IDSET_TEST_MAX_GLOBCNT; i++) {
+		ids[i] = (ids[i] << 16) | IDSET_TEST_REPLID;
+	}
+
+	idset = _make_test_idset(true);
+	ck_assert_int_eq(IDSET_filter_eids(idset, ids, IDSET_TEST_MAX_GLOBCNT, included), expected);
+	for (i = 0; i < IDSET_TEST_MAX_GLOBCNT; i++) {
+		ck_assert_int_eq(included[i], _in_test_set(i + 1));
+	}
+} END_TEST
+
+START_TEST (test_idset_merge_and_remove) {
+	struct idset	*left, *right, *merged;
+	struct rawidset	*rawidset;
+	uint64_t	n;
+
+	left = _make_test_idset(false);
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	for (n = IDSET_TEST_MAX_GLOBCNT + 1; n <= IDSET_TEST_MAX_GLOBCNT + 16; n++) {
+		RAWIDSET_push_guid_glob(rawidset, &replica_guid, exchange_globcnt(n));
+	}
+	right = RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+
+	/* lookups on the inputs must not leak into the merged idset */
+	ck_assert(IDSET_includes_guid_glob(left, &replica_guid, exchange_globcnt(3)));
+	ck_assert(!IDSET_includes_guid_glob(left, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 1)));
+
+	merged = IDSET_merge_idsets(mem_ctx, left, right);
+	ck_assert(IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(3)));
+	ck_assert(!IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(4)));
+	ck_assert(IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 1)));
+	ck_assert(IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 16)));
+
+	/* removing ids updates the lookup array */
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	RAWIDSET_push_guid_glob(rawidset, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 8));
+	IDSET_remove_rawidset(merged, rawidset);
+	ck_assert(!IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 8)));
+	ck_assert(IDSET_includes_guid_glob(merged, &replica_guid, exchange_globcnt(IDSET_TEST_MAX_GLOBCNT + 9)));
+} END_TEST
+
+START_TEST (test_idset_parse) {
+	struct idset	*parsed;
+	struct rawidset	*rawidset;
+	struct Binary_r	*bin;
+	struct GUID	other_guid;
+	DATA_BLOB	data;
+	uint64_t	n;
+
+	/* REPLID-based, as in MetaTagIdsetDeleted */
+	bin = IDSET_serialize(mem_ctx, _make_test_idset(true));
+	data.data = bin->lpb;
+	data.length = bin->cb;
+	parsed = IDSET_parse(mem_ctx, data, true);
+	ck_assert(parsed != NULL);
+	ck_assert(parsed->idbased);
+	for (n = 1; n <= IDSET_TEST_MAX_GLOBCNT + 8; n++) {
+		ck_assert_int_eq(IDSET_includes_eid(parsed, (exchange_globcnt(n) << 16) | IDSET_TEST_REPLID),
+				 n <= IDSET_TEST_MAX_GLOBCNT && _in_test_set(n));
+	}
+
+	/* REPLGUID-based with two replicas, each followed by its own GLOBSET */
+	other_guid = GUID_random();
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	RAWIDSET_push_guid_glob(rawidset, &replica_guid, exchange_globcnt(3));
+	RAWIDSET_push_guid_glob(rawidset, &other_guid, exchange_globcnt(5));
+	bin = IDSET_serialize(mem_ctx, RAWIDSET_convert_to_idset(mem_ctx, rawidset));
+	data.data = bin->lpb;
+	data.length = bin->cb;
+	parsed = IDSET_parse(mem_ctx, data, false);
+	ck_assert(parsed != NULL);
+	ck_assert(parsed->next != NULL);
+	ck_assert(parsed->next->next == NULL);
+	ck_assert(IDSET_includes_guid_glob(parsed, &replica_guid, exchange_globcnt(3)));
+	ck_assert(IDSET_includes_guid_glob(parsed, &other_guid, exchange_globcnt(5)));
+	ck_assert(!IDSET_includes_guid_glob(parsed, &other_guid, exchange_globcnt(3)));
+
+	/* truncated buffers are rejected */
+	data.length--;
+	ck_assert(IDSET_parse(mem_ctx, data, false) == NULL);
+} END_TEST
+
+static void tc_idset_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libmapi_idset_suite");
+	replica_guid = GUID_random();
+}
+
+static void tc_idset_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_idset_suite(void)
+{
+	Suite *s = suite_create("libmapi idset");
+
+	TCase *tc = tcase_create("idset lookups");
+	tcase_add_checked_fixture(tc, tc_idset_setup, tc_idset_teardown);
+
+	tcase_add_test(tc, test_idset_includes_guid_glob);
+	tcase_add_test(tc, test_idset_includes_eid);
+	tcase_add_test(tc, test_idset_filter);
+	tcase_add_test(tc, test_idset_merge_and_remove);
+	tcase_add_test(tc, test_idset_parse);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
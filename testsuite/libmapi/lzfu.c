@@ -0,0 +1,167 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#define	TEST_RTF	"{\\rtf1\\ansi\\ansicpg1252\\pard hello world hello world hello world}"
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static uint8_t		*comp;
+static size_t		comp_size;
+
+
+static void set_cbsize(uint8_t *data, uint32_t cbSize)
+{
+	data[0] = cbSize & 0xFF;
+	data[1] = (cbSize >> 8) & 0xFF;
+	data[2] = (cbSize >> 16) & 0xFF;
+	data[3] = (cbSize >> 24) & 0xFF;
+}
+
+/* Feed data to a decompression stream in chunks of chunk_size bytes */
+static enum MAPISTATUS stream_feed(const uint8_t *data, uint32_t size, uint32_t chunk_size,
+				   uint32_t *consumed, bool *done)
+{
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	struct lzfu_stream	*stream;
+	uint8_t			out[0x400];
+	uint32_t		in_used;
+	uint32_t		out_used;
+	uint32_t		chunk;
+
+	stream = uncompress_rtf_stream_init(mem_ctx);
+	ck_assert(stream != NULL);
+
+	*consumed = 0;
+	*done = false;
+	while (*consumed < size && !*done) {
+		chunk = size - *consumed;
+		if (chunk > chunk_size) {
+			chunk = chunk_size;
+		}
+		retval = uncompress_rtf_stream(stream, data + *consumed, chunk, &in_used,
+					       out, sizeof (out), &out_used, done);
+		if (retval) break;
+		*consumed += in_used;
+	}
+
+	talloc_free(stream);
+	return retval;
+}
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_lzfu_round_trip) {
+	DATA_BLOB	rtf;
+	uint32_t	consumed;
+	bool		done;
+
+	ck_assert_int_eq(uncompress_rtf(mem_ctx, comp, comp_size, &rtf), MAPI_E_SUCCESS);
+	ck_assert_int_eq(rtf.length, strlen(TEST_RTF) + 1);
+	ck_assert_str_eq((char *)rtf.data, TEST_RTF);
+
+	ck_assert_int_eq(stream_feed(comp, comp_size, 7, &consumed, &done), MAPI_E_SUCCESS);
+	ck_assert(done);
+	ck_assert_int_eq(consumed, comp_size);
+} END_TEST
+
+START_TEST (test_lzfu_truncated) {
+	DATA_BLOB	rtf;
+	uint32_t	consumed;
+	bool		done;
+
+	/* cbSize no longer matches the buffer size */
+	ck_assert_int_eq(uncompress_rtf(mem_ctx, comp, comp_size - 3, &rtf), MAPI_E_CORRUPT_DATA);
+
+	/* cbSize matches but the end marker is missing */
+	set_cbsize(comp, comp_size - 3 - 4);
+	ck_assert_int_eq(uncompress_rtf(mem_ctx, comp, comp_size - 3, &rtf), MAPI_E_CORRUPT_DATA);
+	ck_assert_int_eq(stream_feed(comp, comp_size - 3, 5, &consumed, &done), MAPI_E_CORRUPT_DATA);
+
+	/* The stream runs out before cbSize bytes */
+	set_cbsize(comp, comp_size - 4);
+	ck_assert_int_eq(stream_feed(comp, comp_size - 3, 5, &consumed, &done), MAPI_E_SUCCESS);
+	ck_assert(!done);
+	ck_assert_int_eq(consumed, comp_size - 3);
+
+	/* cbSize shorter than the header */
+	set_cbsize(comp, 4);
+	ck_assert_int_eq(stream_feed(comp, comp_size, 5, &consumed, &done), MAPI_E_CORRUPT_DATA);
+	set_cbsize(comp, UINT32_MAX);
+	ck_assert_int_eq(stream_feed(comp, comp_size, 5, &consumed, &done), MAPI_E_CORRUPT_DATA);
+} END_TEST
+
+START_TEST (test_lzfu_past_cbsize) {
+	DATA_BLOB	rtf;
+	uint8_t		*padded;
+	uint32_t	consumed;
+	bool		done;
+
+	/* Input past cbSize is never consumed */
+	padded = talloc_zero_array(mem_ctx, uint8_t, comp_size + 16);
+	memcpy(padded, comp, comp_size);
+	ck_assert_int_eq(stream_feed(padded, comp_size + 16, 3, &consumed, &done), MAPI_E_SUCCESS);
+	ck_assert(done);
+	ck_assert_int_eq(consumed, comp_size);
+	ck_assert_int_eq(uncompress_rtf(mem_ctx, padded, comp_size + 16, &rtf), MAPI_E_CORRUPT_DATA);
+
+	/* Padding within cbSize after the end marker is skipped */
+	set_cbsize(padded, comp_size + 16 - 4);
+	ck_assert_int_eq(stream_feed(padded, comp_size + 16, 3, &consumed, &done), MAPI_E_SUCCESS);
+	ck_assert(done);
+	ck_assert_int_eq(consumed, comp_size + 16);
+	ck_assert_int_eq(uncompress_rtf(mem_ctx, padded, comp_size + 16, &rtf), MAPI_E_SUCCESS);
+	ck_assert_str_eq((char *)rtf.data, TEST_RTF);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_lzfu_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libmapi_lzfu_suite");
+	ck_assert_int_eq(compress_rtf(mem_ctx, TEST_RTF, strlen(TEST_RTF), &comp, &comp_size), MAPI_E_SUCCESS);
+}
+
+static void tc_lzfu_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_lzfu_suite(void)
+{
+	Suite *s = suite_create("libmapi lzfu");
+
+	TCase *tc = tcase_create("Compressed RTF");
+	tcase_add_checked_fixture(tc, tc_lzfu_setup, tc_lzfu_teardown);
+
+	tcase_add_test(tc, test_lzfu_round_trip);
+	tcase_add_test(tc, test_lzfu_truncated);
+	tcase_add_test(tc, test_lzfu_past_cbsize);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
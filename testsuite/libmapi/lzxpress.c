@@ -0,0 +1,154 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/* Global test variables */
+static TALLOC_CTX *mem_ctx;
+
+
+static void check_round_trip(const uint8_t *input, uint32_t input_size)
+{
+	uint8_t	*comp;
+	uint8_t	*plain;
+	ssize_t	comp_len;
+	ssize_t	plain_len;
+
+	comp = talloc_array(mem_ctx, uint8_t, LZXPRESS_COMPRESS_BOUND(input_size));
+	plain = talloc_array(mem_ctx, uint8_t, input_size + 1);
+
+	comp_len = lzxpress_compress_buffer(input, input_size, comp, LZXPRESS_COMPRESS_BOUND(input_size));
+	ck_assert(comp_len > 0);
+
+	plain_len = lzxpress_decompress_buffer(comp, comp_len, plain, input_size + 1);
+	ck_assert_int_eq(plain_len, input_size);
+	ck_assert(memcmp(input, plain, input_size) == 0);
+
+	talloc_free(comp);
+	talloc_free(plain);
+}
+
+// v unit tests ---------------------------------------------------------------
+
+/* Sample outputs from [MS-XCA] 3.1 */
+START_TEST (test_lzxpress_spec_samples) {
+	const uint8_t	alphabet_comp[] = { 0x3f, 0x00, 0x00, 0x00 };
+	const uint8_t	abc_comp[] = { 0xff, 0xff, 0xff, 0x1f, 0x61, 0x62, 0x63,
+				       0x17, 0x00, 0x0f, 0xff, 0x26, 0x01 };
+	const char	*alphabet = "abcdefghijklmnopqrstuvwxyz";
+	uint8_t		input[300];
+	uint8_t		comp[LZXPRESS_COMPRESS_BOUND(300)];
+	ssize_t		comp_len;
+	int		i;
+
+	comp_len = lzxpress_compress_buffer((const uint8_t *)alphabet, 26, comp, sizeof (comp));
+	ck_assert_int_eq(comp_len, 30);
+	ck_assert(memcmp(comp, alphabet_comp, sizeof (alphabet_comp)) == 0);
+	ck_assert(memcmp(comp + 4, alphabet, 26) == 0);
+
+	for (i = 0; i < 300; i++) {
+		input[i] = "abc"[i % 3];
+	}
+	comp_len = lzxpress_compress_buffer(input, 300, comp, sizeof (comp));
+	ck_assert_int_eq(comp_len, sizeof (abc_comp));
+	ck_assert(memcmp(comp, abc_comp, sizeof (abc_comp)) == 0);
+} END_TEST
+
+START_TEST (test_lzxpress_round_trip) {
+	uint8_t		*input;
+	uint32_t	size = 0x10000 + 17;
+	uint32_t	i;
+
+	input = talloc_array(mem_ctx, uint8_t, size);
+
+	/* Empty and tiny buffers */
+	check_round_trip(input, 0);
+	input[0] = 'a';
+	check_round_trip(input, 1);
+
+	/* Long runs use the extended length encodings */
+	memset(input, 'x', size);
+	check_round_trip(input, size);
+
+	/* Mostly incompressible data */
+	for (i = 0; i < size; i++) {
+		input[i] = (i * 2654435761U) >> 24;
+	}
+	check_round_trip(input, size);
+
+	/* Repetitive data with distant matches */
+	for (i = 0; i < size; i++) {
+		input[i] = (i % 5000) & 0x3F;
+	}
+	check_round_trip(input, size);
+
+	talloc_free(input);
+} END_TEST
+
+START_TEST (test_lzxpress_bad_input) {
+	const uint8_t	bad_offset[] = { 0x00, 0x00, 0x00, 0x80, 0x08, 0x00 };
+	uint8_t		input[64];
+	uint8_t		comp[LZXPRESS_COMPRESS_BOUND(64)];
+	uint8_t		plain[64];
+	ssize_t		comp_len;
+
+	/* Match referencing data before the start of the output */
+	ck_assert_int_eq(lzxpress_decompress_buffer(bad_offset, sizeof (bad_offset), plain, sizeof (plain)), -1);
+
+	/* Output buffer too small */
+	memset(input, 'z', sizeof (input));
+	comp_len = lzxpress_compress_buffer(input, sizeof (input), comp, sizeof (comp));
+	ck_assert(comp_len > 0);
+	ck_assert_int_eq(lzxpress_decompress_buffer(comp, comp_len, plain, 32), -1);
+	ck_assert_int_eq(lzxpress_compress_buffer(input, sizeof (input), comp, 4), -1);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_lzxpress_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libmapi_lzxpress_suite");
+}
+
+static void tc_lzxpress_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_lzxpress_suite(void)
+{
+	Suite *s = suite_create("libmapi lzxpress");
+
+	TCase *tc = tcase_create("lzxpress");
+	tcase_add_checked_fixture(tc, tc_lzxpress_setup, tc_lzxpress_teardown);
+
+	tcase_add_test(tc, test_lzxpress_spec_samples);
+	tcase_add_test(tc, test_lzxpress_round_trip);
+	tcase_add_test(tc, test_lzxpress_bad_input);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,234 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#define	MAPI_BATCH_TEST_STORE_HANDLE	0x1234
+#define	MAPI_BATCH_TEST_FOLDER_HANDLE	0x5678
+#define	MAPI_BATCH_TEST_MESSAGES	60
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct mapi_session	*session;
+static mapi_object_t		obj_store;
+static mapi_object_t		obj_folder;
+static struct mapi_batch	*batch;
+
+
+static void _make_object(mapi_object_t *obj, mapi_handle_t handle)
+{
+	mapi_object_init(obj);
+	mapi_object_set_session(obj, session);
+	mapi_object_set_handle(obj, handle);
+	mapi_object_set_logon_id(obj, 0);
+}
+
+START_TEST (test_batch_sanity) {
+	struct mapi_session	*other_session;
+	mapi_object_t		obj_other;
+	mapi_object_t		obj_message;
+	mapi_object_t		obj_closed;
+	struct SPropValue	*lpProps;
+	uint32_t		count;
+	uint32_t		*slots;
+
+	mapi_object_init(&obj_message);
+	mapi_object_init(&obj_closed);
+
+	ck_assert(mapi_batch_init(mem_ctx, NULL) == NULL);
+	ck_assert(mapi_batch_init(mem_ctx, &obj_closed) == NULL);
+	ck_assert_int_eq(mapi_batch_OpenMessage(NULL, &obj_store, 1, 2, &obj_message, 0, NULL), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(mapi_batch_OpenMessage(batch, &obj_store, 1, 2, NULL, 0, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_folder, 0, NULL, &lpProps, &count, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert(mapi_batch_build_request(mem_ctx, batch, 0, &slots) == NULL);
+
+	/* objects must be opened or opened by a pending operation */
+	mapi_object_set_session(&obj_closed, session);
+	ck_assert_int_eq(mapi_batch_GetAttachmentTable(batch, &obj_closed, &obj_message, NULL), MAPI_E_INVALID_OBJECT);
+
+	/* releasing an object without a valid handle is a no-op */
+	ck_assert_int_eq(mapi_batch_Release(NULL, &obj_closed), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(mapi_batch_Release(batch, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(mapi_batch_Release(batch, &obj_closed), MAPI_E_SUCCESS);
+	ck_assert_int_eq(batch->count, 0);
+
+	/* objects must belong to the session of the batch */
+	other_session = talloc_zero(mem_ctx, struct mapi_session);
+	mapi_object_init(&obj_other);
+	mapi_object_set_session(&obj_other, other_session);
+	mapi_object_set_handle(&obj_other, 1);
+	ck_assert_int_eq(mapi_batch_Release(batch, &obj_other), MAPI_E_INVALID_PARAMETER);
+
+	/* an object cannot be opened twice by pending operations */
+	ck_assert_int_eq(mapi_batch_OpenMessage(batch, &obj_store, 1, 2, &obj_message, 0, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_OpenMessage(batch, &obj_store, 1, 3, &obj_message, 0, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(batch->count, 1);
+} END_TEST
+
+/* OpenMessage -> GetProps -> GetAttachmentTable -> Release chain */
+START_TEST (test_batch_chaining) {
+	struct mapi_request	*mapi_request;
+	struct SPropTagArray	*SPropTagArray;
+	struct SPropValue	*lpProps;
+	mapi_object_t		obj_message;
+	mapi_object_t		obj_table;
+	uint32_t		count;
+	uint32_t		*slots;
+	uint32_t		length;
+
+	mapi_object_init(&obj_message);
+	mapi_object_init(&obj_table);
+	SPropTagArray = set_SPropTagArray(mem_ctx, 0x2, PR_HASATTACH, PR_SUBJECT_UNICODE);
+
+	ck_assert_int_eq(mapi_batch_OpenMessage(batch, &obj_store, 1, 2, &obj_message, 0, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_message, MAPI_UNICODE, SPropTagArray, &lpProps, &count, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_GetAttachmentTable(batch, &obj_message, &obj_table, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_folder, 0, SPropTagArray, &lpProps, &count, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_Release(batch, &obj_table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_Release(batch, &obj_message), MAPI_E_SUCCESS);
+
+	/* objects opened by pending operations have no handle yet */
+	ck_assert_int_eq(obj_message.handle, 0xffffffff);
+	ck_assert(obj_message.session == session);
+
+	mapi_request = mapi_batch_build_request(mem_ctx, batch, 0, &slots);
+	ck_assert(mapi_request != NULL);
+
+	ck_assert_int_eq(mapi_request->mapi_req[0].opnum, op_MAPI_OpenMessage);
+	ck_assert_int_eq(mapi_request->mapi_req[0].handle_idx, 0);
+	ck_assert_int_eq(mapi_request->mapi_req[0].u.mapi_OpenMessage.handle_idx, 1);
+	ck_assert_int_eq(mapi_request->mapi_req[1].opnum, op_MAPI_GetProps);
+	ck_assert_int_eq(mapi_request->mapi_req[1].handle_idx, 1);
+	ck_assert_int_eq(mapi_request->mapi_req[2].opnum, op_MAPI_GetAttachmentTable);
+	ck_assert_int_eq(mapi_request->mapi_req[2].handle_idx, 1);
+	ck_assert_int_eq(mapi_request->mapi_req[2].u.mapi_GetAttachmentTable.handle_idx, 2);
+	ck_assert_int_eq(mapi_request->mapi_req[3].opnum, op_MAPI_GetProps);
+	ck_assert_int_eq(mapi_request->mapi_req[3].handle_idx, 3);
+	ck_assert_int_eq(mapi_request->mapi_req[4].opnum, op_MAPI_Release);
+	ck_assert_int_eq(mapi_request->mapi_req[4].handle_idx, 2);
+	ck_assert_int_eq(mapi_request->mapi_req[5].opnum, op_MAPI_Release);
+	ck_assert_int_eq(mapi_request->mapi_req[5].handle_idx, 1);
+	ck_assert_int_eq(mapi_request->mapi_req[6].opnum, 0);
+	ck_assert_int_eq(slots[3], 3);
+
+	ck_assert_int_eq(mapi_request->handles[0], MAPI_BATCH_TEST_STORE_HANDLE);
+	ck_assert_int_eq(mapi_request->handles[1], 0xffffffff);
+	ck_assert_int_eq(mapi_request->handles[2], 0xffffffff);
+	ck_assert_int_eq(mapi_request->handles[3], MAPI_BATCH_TEST_FOLDER_HANDLE);
+
+	/* RopSize, then each ROP: OpenMessage, 2 GetProps with 2
+	 * properties, GetAttachmentTable and 2 Release */
+	length = 2 + 23 + 2 * (3 + 6 + 2 * 4) + 5 + 2 * 3;
+	ck_assert_int_eq(mapi_request->length, length);
+	ck_assert_int_eq(mapi_request->mapi_len, length + 4 * sizeof (uint32_t));
+
+	/* a buffer can be rebuilt from any pending operation */
+	mapi_request = mapi_batch_build_request(mem_ctx, batch, 3, &slots);
+	ck_assert(mapi_request != NULL);
+	ck_assert_int_eq(mapi_request->mapi_req[0].handle_idx, 0);
+	ck_assert_int_eq(mapi_request->handles[0], MAPI_BATCH_TEST_FOLDER_HANDLE);
+	ck_assert_int_eq(mapi_request->mapi_req[3].opnum, 0);
+	ck_assert_int_eq(mapi_request->mapi_len, 2 + 17 + 2 * 3 + 3 * sizeof (uint32_t));
+} END_TEST
+
+/* The batch fits the buffer the session negotiated */
+START_TEST (test_batch_max_size) {
+	struct mapi_provider	provider;
+	struct emsmdb_context	emsmdb_ctx;
+	struct mapi_profile	profile;
+	struct mapi_batch	*ext2_batch;
+	mapi_object_t		obj_messages[MAPI_BATCH_TEST_MESSAGES];
+	uint32_t		i;
+
+	/* a session without provider gets the rgbIn limit */
+	ck_assert_int_eq(batch->max_size, MAPI_BATCH_MAX_SIZE - MAPI_BATCH_HEADER_SIZE);
+
+	memset(&provider, 0, sizeof (provider));
+	memset(&emsmdb_ctx, 0, sizeof (emsmdb_ctx));
+	memset(&profile, 0, sizeof (profile));
+	provider.ctx = &emsmdb_ctx;
+	session->emsmdb = &provider;
+	session->profile = &profile;
+
+	/* EcDoRpc sessions are bound by max_data */
+	emsmdb_ctx.max_data = 0x1000;
+	emsmdb_ctx.max_rgbout = EMSMDB_RGBOUT_MAX_SIZE;
+	ck_assert(talloc_free(batch) == 0);
+	batch = mapi_batch_init(mem_ctx, &obj_store);
+	ck_assert_int_eq(batch->max_size, 0x1000 - MAPI_BATCH_HEADER_SIZE);
+
+	/* EcDoRpcExt2 sessions by the requested rgbOut, up to the rgbIn limit */
+	profile.exchange_version = 0x2;
+	ext2_batch = mapi_batch_init(mem_ctx, &obj_store);
+	ck_assert_int_eq(ext2_batch->max_size, MAPI_BATCH_MAX_SIZE - MAPI_BATCH_HEADER_SIZE);
+	emsmdb_ctx.max_rgbout = 0x800;
+	ck_assert(talloc_free(ext2_batch) == 0);
+	ext2_batch = mapi_batch_init(mem_ctx, &obj_store);
+	ck_assert_int_eq(ext2_batch->max_size, 0x800 - MAPI_BATCH_HEADER_SIZE);
+
+	/* the handle table is accounted for: 60 OpenMessage take 23
+	 * bytes and 2 handles each, the 66th would not fit */
+	for (i = 0; i < MAPI_BATCH_TEST_MESSAGES; i++) {
+		mapi_object_init(&obj_messages[i]);
+		ck_assert_int_eq(mapi_batch_OpenMessage(ext2_batch, &obj_store, 1, i, &obj_messages[i], 0, NULL), MAPI_E_SUCCESS);
+	}
+	ck_assert_int_eq(ext2_batch->count, MAPI_BATCH_TEST_MESSAGES);
+	ck_assert_int_eq(ext2_batch->handles, 2 * MAPI_BATCH_TEST_MESSAGES);
+	ck_assert(ext2_batch->size + sizeof (uint16_t) + ext2_batch->handles * sizeof (uint32_t) <= ext2_batch->max_size);
+	ck_assert(ext2_batch->size + 6 * (23 + 2 * sizeof (uint32_t)) + sizeof (uint16_t) +
+		  ext2_batch->handles * sizeof (uint32_t) > ext2_batch->max_size);
+
+	session->emsmdb = NULL;
+	session->profile = NULL;
+} END_TEST
+
+static void tc_batch_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "libmapi_mapi_batch_suite");
+	session = talloc_zero(mem_ctx, struct mapi_session);
+	_make_object(&obj_store, MAPI_BATCH_TEST_STORE_HANDLE);
+	_make_object(&obj_folder, MAPI_BATCH_TEST_FOLDER_HANDLE);
+	batch = mapi_batch_init(mem_ctx, &obj_store);
+	ck_assert(batch != NULL);
+}
+
+static void tc_batch_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_mapi_batch_suite(void)
+{
+	Suite *s = suite_create("libmapi ROP batch");
+
+	TCase *tc = tcase_create("mapi_batch");
+	tcase_add_checked_fixture(tc, tc_batch_setup, tc_batch_teardown);
+
+	tcase_add_test(tc, test_batch_sanity);
+	tcase_add_test(tc, test_batch_chaining);
+	tcase_add_test(tc, test_batch_max_size);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,120 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/mapi_nameid.h"
+
+/* Properties looked up for every row by mapidump and the NSPI server */
+static const uint32_t row_proptags[] = {
+	PidTagDisplayName,
+	PidTagSubject,
+	PidTagMessageClass,
+	PidTagEmailAddress,
+	PidTagAddressBookDisplayNamePrintable,
+	PidTagLastModificationTime,
+	PidTagMessageSize,
+	PidTagInstanceKey,
+	PidTagAccess,
+	openchange_private_PF_LOCAL_OAB,
+	0x12340003,
+	0
+};
+
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_proptag_lookups) {
+	ck_assert_str_eq(get_proptag_name(PidTagDisplayName), "PidTagDisplayName");
+	ck_assert_str_eq(get_proptag_name(PidTagDisplayName_Error), "PidTagDisplayName_Error");
+	ck_assert_str_eq(get_proptag_name(openchange_private_MailboxGUID), "openchange_private_MailboxGUID");
+	/* PT_STRING8 tags resolve to their _UNICODE variant */
+	ck_assert_str_eq(get_proptag_name(PROP_TAG(PT_STRING8, 0x3001)), "PidTagDisplayName");
+	ck_assert(get_proptag_name(0x12340003) == NULL);
+	ck_assert(get_proptag_name(0) == NULL);
+
+	ck_assert_int_eq(get_proptag_value("PidTagSubject"), PidTagSubject);
+	ck_assert_int_eq(get_proptag_value("PidTagFolderChildCount"), PidTagFolderChildCount);
+	ck_assert_int_eq(get_proptag_value("openchange_private_PF_LOCAL_OAB"), openchange_private_PF_LOCAL_OAB);
+	ck_assert_int_eq(get_proptag_value("PidTagSubjec"), 0);
+	ck_assert_int_eq(get_proptag_value(""), 0);
+
+	ck_assert_int_eq(get_property_type(0x3001), PT_UNICODE);
+	ck_assert_int_eq(get_property_type(0xd00f), PT_SHORT);
+	ck_assert_int_eq(get_property_type(0x1234), 0);
+} END_TEST
+
+START_TEST (test_namedid_lookups) {
+	uint32_t	proptag;
+	uint16_t	propType;
+
+	ck_assert_int_eq(mapi_nameid_lid_lookup_canonical(0x8005, PSETID_Address, &proptag), MAPI_E_SUCCESS);
+	ck_assert_int_eq(proptag, PidLidFileUnder);
+	ck_assert_int_eq(mapi_nameid_lid_lookup(0x8005, PSETID_Address, &propType), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_UNICODE);
+	ck_assert_int_eq(mapi_nameid_lid_lookup(0x8005, PSETID_Common, &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_string_lookup_canonical("Title", PS_PUBLIC_STRINGS, &proptag), MAPI_E_SUCCESS);
+	ck_assert_int_eq(proptag, PidNameTitle);
+	ck_assert_int_eq(mapi_nameid_string_lookup("Title", PSETID_Address, &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_OOM_lookup("FileUnder", PSETID_Address, &propType), MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_UNICODE);
+	ck_assert_int_eq(mapi_nameid_OOM_lookup("FileUnde", PSETID_Address, &propType), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_property_lookup(PidLidRemoteTransferSize), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_nameid_property_lookup(0x12340003), MAPI_E_NOT_FOUND);
+
+	ck_assert_str_eq(get_namedid_name(PidNameTitle), "PidNameTitle");
+	ck_assert(get_namedid_name(0x12340003) == NULL);
+	ck_assert_int_eq(get_namedid_value("PidLidFileUnder"), PidLidFileUnder);
+	ck_assert_int_eq(get_namedid_value("PidLidFileUnde"), 0);
+	ck_assert_int_eq(get_namedid_type(0x8005), PT_UNICODE);
+} END_TEST
+
+START_TEST (test_proptag_round_trip) {
+	uint32_t	i;
+	const char	*propname;
+
+	for (i = 0; row_proptags[i]; i++) {
+		propname = get_proptag_name(row_proptags[i]);
+		if (propname) {
+			ck_assert_int_eq(get_proptag_value(propname), row_proptags[i]);
+		}
+	}
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+Suite *libmapi_property_tags_suite(void)
+{
+	Suite *s = suite_create("libmapi property tags");
+
+	TCase *tc = tcase_create("property tag lookups");
+
+	tcase_add_test(tc, test_proptag_lookups);
+	tcase_add_test(tc, test_namedid_lookups);
+	tcase_add_test(tc, test_proptag_round_trip);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,157 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+
+#define	MAPI_HANDLES_STRESS_COUNT	10000
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct mapi_handles_context	*handles_ctx;
+
+
+START_TEST (test_handles_sanity) {
+	struct mapi_handles	*rec;
+
+	ck_assert_int_eq(mapi_handles_add(NULL, 0, &rec), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(mapi_handles_search(NULL, 1, &rec), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, MAPI_HANDLES_RESERVED, &rec), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, 0, &rec), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, 1, &rec), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_handles_delete(handles_ctx, 1), MAPI_E_NOT_FOUND);
+} END_TEST
+
+START_TEST (test_handles_add_search) {
+	struct mapi_handles	*root;
+	struct mapi_handles	*child;
+	struct mapi_handles	*rec;
+
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &root), MAPI_E_SUCCESS);
+	ck_assert_int_eq(root->handle, 1);
+	ck_assert_int_eq(root->parent_handle, 0);
+
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, root->handle, &child), MAPI_E_SUCCESS);
+	ck_assert_int_ne(child->handle, root->handle);
+	ck_assert_int_ne(child->handle, 0);
+	ck_assert_int_eq(child->parent_handle, root->handle);
+
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, root->handle, &rec), MAPI_E_SUCCESS);
+	ck_assert(rec == root);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, child->handle, &rec), MAPI_E_SUCCESS);
+	ck_assert(rec == child);
+
+	ck_assert_int_eq(mapi_handles_set_private_data(child, mem_ctx), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_set_private_data(child, mem_ctx), MAPI_E_UNABLE_TO_COMPLETE);
+} END_TEST
+
+START_TEST (test_handles_recursive_delete) {
+	struct mapi_handles	*root;
+	struct mapi_handles	*folder;
+	struct mapi_handles	*message;
+	struct mapi_handles	*other;
+	struct mapi_handles	*rec;
+	uint32_t		folder_handle;
+	uint32_t		message_handle;
+
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &root), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, root->handle, &folder), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, folder->handle, &message), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, root->handle, &other), MAPI_E_SUCCESS);
+	folder_handle = folder->handle;
+	message_handle = message->handle;
+
+	/* releasing the folder releases the message opened from it */
+	ck_assert_int_eq(mapi_handles_delete(handles_ctx, folder_handle), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, folder_handle, &rec), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, message_handle, &rec), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, other->handle, &rec), MAPI_E_SUCCESS);
+	ck_assert(rec == other);
+	ck_assert_int_eq(mapi_handles_delete(handles_ctx, folder_handle), MAPI_E_NOT_FOUND);
+
+	/* released slots are reused under a different handle value */
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, root->handle, &folder), MAPI_E_SUCCESS);
+	ck_assert_int_ne(folder->handle, folder_handle);
+	ck_assert_int_ne(folder->handle, message_handle);
+	ck_assert_int_eq(mapi_handles_search(handles_ctx, folder_handle, &rec), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_handles_delete(handles_ctx, root->handle), MAPI_E_SUCCESS);
+	ck_assert(handles_ctx->handles == NULL);
+} END_TEST
+
+START_TEST (test_handles_stress) {
+	struct mapi_handles	*root;
+	struct mapi_handles	*rec;
+	uint32_t		*handles;
+	uint32_t		root_handle;
+	uint32_t		i;
+
+	handles = talloc_array(mem_ctx, uint32_t, MAPI_HANDLES_STRESS_COUNT);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &root), MAPI_E_SUCCESS);
+	root_handle = root->handle;
+
+	for (i = 0; i < MAPI_HANDLES_STRESS_COUNT; i++) {
+		ck_assert_int_eq(mapi_handles_add(handles_ctx, i ? handles[i / 2] : root_handle, &rec), MAPI_E_SUCCESS);
+		handles[i] = rec->handle;
+	}
+
+	for (i = 0; i < MAPI_HANDLES_STRESS_COUNT; i++) {
+		ck_assert_int_eq(mapi_handles_search(handles_ctx, handles[i], &rec), MAPI_E_SUCCESS);
+		ck_assert_int_eq(rec->handle, handles[i]);
+	}
+
+	ck_assert_int_eq(mapi_handles_delete(handles_ctx, root_handle), MAPI_E_SUCCESS);
+	for (i = 0; i < MAPI_HANDLES_STRESS_COUNT; i++) {
+		ck_assert_int_eq(mapi_handles_search(handles_ctx, handles[i], &rec), MAPI_E_NOT_FOUND);
+	}
+	ck_assert(handles_ctx->handles == NULL);
+} END_TEST
+
+static void tc_handles_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_mapi_handles_suite");
+	handles_ctx = mapi_handles_init(mem_ctx);
+	ck_assert(handles_ctx != NULL);
+}
+
+static void tc_handles_teardown(void)
+{
+	mapi_handles_release(handles_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_mapi_handles_suite(void)
+{
+	Suite *s = suite_create("libmapiproxy mapi handles");
+
+	TCase *tc = tcase_create("mapi_handles");
+	tcase_add_checked_fixture(tc, tc_handles_setup, tc_handles_teardown);
+
+	tcase_add_test(tc, test_handles_sanity);
+	tcase_add_test(tc, test_handles_add_search);
+	tcase_add_test(tc, test_handles_recursive_delete);
+	tcase_add_test(tc, test_handles_stress);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,134 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+
+#define	SESSION_REGISTRY_STRESS_COUNT	10000
+
+struct test_session {
+	struct GUID	uuid;
+	uint32_t	index;
+};
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct mpm_session_registry	*registry;
+
+
+START_TEST (test_registry_sanity) {
+	struct GUID	uuid = GUID_random();
+	int		data;
+
+	ck_assert(!mpm_session_registry_add(NULL, &uuid, &data));
+	ck_assert(!mpm_session_registry_add(registry, NULL, &data));
+	ck_assert(!mpm_session_registry_add(registry, &uuid, NULL));
+	ck_assert(mpm_session_registry_find(NULL, &uuid) == NULL);
+	ck_assert(mpm_session_registry_find(registry, NULL) == NULL);
+	ck_assert(!mpm_session_registry_del(registry, NULL));
+	ck_assert_int_eq(mpm_session_registry_count(NULL), 0);
+} END_TEST
+
+START_TEST (test_registry_add_find_del) {
+	struct GUID	uuid = GUID_random();
+	struct GUID	other = GUID_random();
+	int		data, data2;
+
+	ck_assert(mpm_session_registry_find(registry, &uuid) == NULL);
+
+	ck_assert(mpm_session_registry_add(registry, &uuid, &data));
+	ck_assert(mpm_session_registry_find(registry, &uuid) == &data);
+	ck_assert(mpm_session_registry_find(registry, &other) == NULL);
+	ck_assert_int_eq(mpm_session_registry_count(registry), 1);
+
+	/* a GUID can only be registered once */
+	ck_assert(!mpm_session_registry_add(registry, &uuid, &data2));
+	ck_assert(mpm_session_registry_find(registry, &uuid) == &data);
+
+	ck_assert(!mpm_session_registry_del(registry, &other));
+	ck_assert(mpm_session_registry_del(registry, &uuid));
+	ck_assert(!mpm_session_registry_del(registry, &uuid));
+	ck_assert(mpm_session_registry_find(registry, &uuid) == NULL);
+	ck_assert_int_eq(mpm_session_registry_count(registry), 0);
+} END_TEST
+
+START_TEST (test_registry_stress) {
+	struct test_session	*sessions;
+	struct test_session	*session;
+	uint32_t		i;
+
+	sessions = talloc_array(mem_ctx, struct test_session, SESSION_REGISTRY_STRESS_COUNT);
+	for (i = 0; i < SESSION_REGISTRY_STRESS_COUNT; i++) {
+		sessions[i].uuid = GUID_random();
+		sessions[i].index = i;
+		ck_assert(mpm_session_registry_add(registry, &sessions[i].uuid, &sessions[i]));
+	}
+	ck_assert_int_eq(mpm_session_registry_count(registry), SESSION_REGISTRY_STRESS_COUNT);
+
+	for (i = 0; i < SESSION_REGISTRY_STRESS_COUNT; i++) {
+		session = mpm_session_registry_find(registry, &sessions[i].uuid);
+		ck_assert(session != NULL);
+		ck_assert_int_eq(session->index, i);
+	}
+
+	/* disconnect every other session */
+	for (i = 0; i < SESSION_REGISTRY_STRESS_COUNT; i += 2) {
+		ck_assert(mpm_session_registry_del(registry, &sessions[i].uuid));
+	}
+	ck_assert_int_eq(mpm_session_registry_count(registry), SESSION_REGISTRY_STRESS_COUNT / 2);
+
+	for (i = 0; i < SESSION_REGISTRY_STRESS_COUNT; i++) {
+		session = mpm_session_registry_find(registry, &sessions[i].uuid);
+		if (i % 2) {
+			ck_assert(session == &sessions[i]);
+		} else {
+			ck_assert(session == NULL);
+		}
+	}
+} END_TEST
+
+static void tc_registry_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_session_registry_suite");
+	registry = mpm_session_registry_init(mem_ctx);
+	ck_assert(registry != NULL);
+}
+
+static void tc_registry_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_session_registry_suite(void)
+{
+	Suite *s = suite_create("libmapiproxy session registry");
+
+	TCase *tc = tcase_create("mpm_session_registry");
+	tcase_add_checked_fixture(tc, tc_registry_setup, tc_registry_teardown);
+
+	tcase_add_test(tc, test_registry_sanity);
+	tcase_add_test(tc, test_registry_add_find_del);
+	tcase_add_test(tc, test_registry_stress);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
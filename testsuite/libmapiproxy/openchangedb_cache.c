@@ -0,0 +1,286 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_cache.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#define	FOLDER_ID_EXPECTED	289356276058554369ul
+#define	PARENT_FID_EXPECTED	72057594037927937ul
+#define	MAPISTORE_URI_EXPECTED	"sogo://usera@mail/folderINBOX/"
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct openchangedb_context	*oc_ctx;
+static struct openchangedb_context	functions_called;
+
+
+// v Mocked backend -----------------------------------------------------------
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	functions_called.get_SystemFolderID++;
+	if (strcmp(recipient, "unknown") == 0) {
+		return MAPI_E_NOT_FOUND;
+	}
+	*FolderId = FOLDER_ID_EXPECTED + SystemIdx;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
+					  const char *recipient, uint16_t *ReplID,
+					  struct GUID *ReplGUID)
+{
+	functions_called.get_MailboxReplica++;
+	if (ReplID) *ReplID = 1;
+	if (ReplGUID) GUID_from_string("c4898b91-da9d-4f3e-9ae4-8a8bd5051b89", ReplGUID);
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+				        struct openchangedb_context *self,
+				        const char *username,
+				        uint64_t fid, char **mapistoreURL,
+				        bool mailboxstore)
+{
+	functions_called.get_mapistoreURI++;
+	*mapistoreURL = talloc_strdup(parent_ctx, MAPISTORE_URI_EXPECTED);
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					const char *mapistoreURL)
+{
+	functions_called.set_mapistoreURI++;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      uint64_t *parent_fidp, bool mailboxstore)
+{
+	functions_called.get_parent_fid++;
+	*parent_fidp = PARENT_FID_EXPECTED;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_fid(struct openchangedb_context *self,
+			       const char *mapistoreURL, uint64_t *fidp)
+{
+	functions_called.get_fid++;
+	*fidp = FOLDER_ID_EXPECTED;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS create_folder(struct openchangedb_context *self,
+				     const char *username,
+				     uint64_t parentFolderID, uint64_t fid,
+				     uint64_t changeNumber,
+				     const char *MAPIStoreURI, int systemIdx)
+{
+	functions_called.create_folder++;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS delete_folder(struct openchangedb_context *self,
+				     const char *username, uint64_t fid)
+{
+	functions_called.delete_folder++;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS mock_backend_init(TALLOC_CTX *mem_ctx,
+					 struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "mocked_backend");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_MailboxReplica = get_MailboxReplica;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+	oc_ctx->set_mapistoreURI = set_mapistoreURI;
+	oc_ctx->get_parent_fid = get_parent_fid;
+	oc_ctx->get_fid = get_fid;
+	oc_ctx->create_folder = create_folder;
+	oc_ctx->delete_folder = delete_folder;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+// ^ Mocked backend -----------------------------------------------------------
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_cache_system_folder_id) {
+	uint64_t	folder_id;
+	uint64_t	hits, misses;
+
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "usera", 2, &folder_id), MAPI_E_SUCCESS);
+	ck_assert(folder_id == FOLDER_ID_EXPECTED + 2);
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "USERA", 2, &folder_id), MAPI_E_SUCCESS);
+	ck_assert(folder_id == FOLDER_ID_EXPECTED + 2);
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "usera", 3, &folder_id), MAPI_E_SUCCESS);
+	ck_assert(folder_id == FOLDER_ID_EXPECTED + 3);
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 2);
+
+	/* failures are not cached */
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "unknown", 2, &folder_id), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "unknown", 2, &folder_id), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 4);
+
+	ck_assert_int_eq(openchangedb_cache_get_stats(oc_ctx, &hits, &misses), MAPI_E_SUCCESS);
+	ck_assert_int_eq(hits, 1);
+	ck_assert_int_eq(misses, 4);
+} END_TEST
+
+START_TEST (test_cache_unknown_mailbox) {
+	uint64_t	folder_id;
+	size_t		blocks;
+	uint32_t	i;
+
+	/* lookups of unknown users do not grow the cache */
+	blocks = talloc_total_blocks(oc_ctx);
+	for (i = 0; i < 100; i++) {
+		ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "unknown", i, &folder_id), MAPI_E_NOT_FOUND);
+	}
+	ck_assert_int_eq(talloc_total_blocks(oc_ctx), blocks);
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 100);
+} END_TEST
+
+START_TEST (test_cache_mailbox_replica) {
+	uint16_t	repl_id;
+	struct GUID	repl_guid;
+	struct GUID	expected_guid;
+
+	GUID_from_string("c4898b91-da9d-4f3e-9ae4-8a8bd5051b89", &expected_guid);
+
+	ck_assert_int_eq(openchangedb_get_MailboxReplica(oc_ctx, "usera", &repl_id, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl_id, 1);
+	ck_assert_int_eq(openchangedb_get_MailboxReplica(oc_ctx, "usera", NULL, &repl_guid), MAPI_E_SUCCESS);
+	ck_assert(GUID_equal(&repl_guid, &expected_guid));
+	ck_assert_int_eq(functions_called.get_MailboxReplica, 1);
+} END_TEST
+
+START_TEST (test_cache_folder_tree) {
+	char		*uri;
+	uint64_t	parent_fid;
+
+	ck_assert_int_eq(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &uri, true), MAPI_E_SUCCESS);
+	ck_assert_str_eq(uri, MAPISTORE_URI_EXPECTED);
+	ck_assert_int_eq(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &uri, true), MAPI_E_SUCCESS);
+	ck_assert_str_eq(uri, MAPISTORE_URI_EXPECTED);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 1);
+
+	ck_assert_int_eq(openchangedb_get_parent_fid(oc_ctx, "usera", FOLDER_ID_EXPECTED, &parent_fid, true), MAPI_E_SUCCESS);
+	ck_assert_int_eq(openchangedb_get_parent_fid(oc_ctx, "usera", FOLDER_ID_EXPECTED, &parent_fid, true), MAPI_E_SUCCESS);
+	ck_assert(parent_fid == PARENT_FID_EXPECTED);
+	ck_assert_int_eq(functions_called.get_parent_fid, 1);
+
+	/* public folders are not cached */
+	ck_assert_int_eq(openchangedb_get_parent_fid(oc_ctx, "usera", FOLDER_ID_EXPECTED, &parent_fid, false), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.get_parent_fid, 2);
+
+	/* updating the URI invalidates the folder entry */
+	ck_assert_int_eq(openchangedb_set_mapistoreURI(oc_ctx, "usera", FOLDER_ID_EXPECTED, MAPISTORE_URI_EXPECTED), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.set_mapistoreURI, 1);
+	ck_assert_int_eq(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &uri, true), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 2);
+
+	/* deleting a folder flushes the whole tree */
+	ck_assert_int_eq(openchangedb_delete_folder(oc_ctx, "usera", PARENT_FID_EXPECTED), MAPI_E_SUCCESS);
+	ck_assert_int_eq(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "usera", FOLDER_ID_EXPECTED, &uri, true), MAPI_E_SUCCESS);
+	ck_assert_int_eq(openchangedb_get_parent_fid(oc_ctx, "usera", FOLDER_ID_EXPECTED, &parent_fid, true), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 3);
+	ck_assert_int_eq(functions_called.get_parent_fid, 3);
+} END_TEST
+
+START_TEST (test_cache_fid_by_uri) {
+	uint64_t	fid;
+
+	ck_assert_int_eq(openchangedb_get_fid(oc_ctx, MAPISTORE_URI_EXPECTED, &fid), MAPI_E_SUCCESS);
+	ck_assert_int_eq(openchangedb_get_fid(oc_ctx, MAPISTORE_URI_EXPECTED, &fid), MAPI_E_SUCCESS);
+	ck_assert(fid == FOLDER_ID_EXPECTED);
+	ck_assert_int_eq(functions_called.get_fid, 1);
+
+	ck_assert_int_eq(openchangedb_create_folder(oc_ctx, "usera", PARENT_FID_EXPECTED, FOLDER_ID_EXPECTED + 1, 1,
+						    MAPISTORE_URI_EXPECTED, 0), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.create_folder, 1);
+	ck_assert_int_eq(openchangedb_get_fid(oc_ctx, MAPISTORE_URI_EXPECTED, &fid), MAPI_E_SUCCESS);
+	ck_assert_int_eq(functions_called.get_fid, 2);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void ocdb_cache_setup(void)
+{
+	struct openchangedb_context	*backend_ctx;
+
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_openchangedb_cache_suite");
+	memset(&functions_called, 0, sizeof (functions_called));
+
+	ck_assert_int_eq(mock_backend_init(mem_ctx, &backend_ctx), MAPI_E_SUCCESS);
+	ck_assert_int_eq(openchangedb_cache_initialize(mem_ctx, backend_ctx, &oc_ctx), MAPI_E_SUCCESS);
+}
+
+static void ocdb_cache_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_openchangedb_cache_suite(void)
+{
+	Suite *s = suite_create("libmapiproxy openchangedb cache");
+
+	TCase *tc = tcase_create("openchangedb cache");
+	tcase_add_checked_fixture(tc, ocdb_cache_setup, ocdb_cache_teardown);
+
+	tcase_add_test(tc, test_cache_system_folder_id);
+	tcase_add_test(tc, test_cache_unknown_mailbox);
+	tcase_add_test(tc, test_cache_mailbox_replica);
+	tcase_add_test(tc, test_cache_folder_tree);
+	tcase_add_test(tc, test_cache_fid_by_uri);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+// ^ Suite definition ---------------------------------------------------------
@@ -0,0 +1,162 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+#define	TEST_TABLE_ROWS		5
+/* Row filtered out by the live restriction of the test table */
+#define	TEST_TABLE_FILTERED	1
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct mapistore_backend	*backend;
+static struct backend_context	*bctx;
+static uint32_t			get_row_calls;
+
+
+static enum mapistore_error test_get_row(void *table, TALLOC_CTX *mem_ctx,
+					 enum mapistore_query_type query_type,
+					 uint32_t rowid, struct mapistore_property_data **data)
+{
+	get_row_calls++;
+	if (rowid >= TEST_TABLE_ROWS) return MAPISTORE_ERR_NOT_FOUND;
+	if (rowid == TEST_TABLE_FILTERED) return MAPISTORE_ERR_NOT_FOUND;
+
+	*data = talloc_zero_array(mem_ctx, struct mapistore_property_data, 1);
+	(*data)[0].data = talloc_memdup(*data, &rowid, sizeof (uint32_t));
+	(*data)[0].error = MAPISTORE_SUCCESS;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error test_get_row_count(void *table,
+					       enum mapistore_query_type query_type,
+					       uint32_t *row_countp)
+{
+	*row_countp = TEST_TABLE_ROWS;
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error test_get_rows_not_implemented(void *table, TALLOC_CTX *mem_ctx,
+							  enum mapistore_query_type query_type,
+							  uint32_t start, uint32_t count,
+							  struct mapistore_property_data ***rows,
+							  uint32_t *rows_count)
+{
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
+static void tc_backend_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapistore_backend_suite");
+	backend = talloc_zero(mem_ctx, struct mapistore_backend);
+	backend->table.get_row = test_get_row;
+	backend->table.get_row_count = test_get_row_count;
+	backend->table.get_rows = test_get_rows_not_implemented;
+
+	bctx = talloc_zero(mem_ctx, struct backend_context);
+	bctx->backend = backend;
+	get_row_calls = 0;
+}
+
+static void tc_backend_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+START_TEST (test_get_rows_fallback) {
+	enum mapistore_error		retval;
+	struct mapistore_property_data	**rows = NULL;
+	uint32_t			rows_count = 0;
+
+	retval = mapistore_backend_table_get_rows(bctx, NULL, mem_ctx, MAPISTORE_PREFILTERED_QUERY,
+						  0, 3, &rows, &rows_count);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(rows_count, 3);
+	ck_assert_int_eq(get_row_calls, 3);
+
+	ck_assert(rows[0] != NULL);
+	ck_assert_int_eq(*(uint32_t *)rows[0][0].data, 0);
+	/* Filtered out rows are reported as NULL entries */
+	ck_assert(rows[TEST_TABLE_FILTERED] == NULL);
+	ck_assert(rows[2] != NULL);
+	ck_assert_int_eq(*(uint32_t *)rows[2][0].data, 2);
+} END_TEST
+
+START_TEST (test_get_rows_fallback_end_of_table) {
+	enum mapistore_error		retval;
+	struct mapistore_property_data	**rows = NULL;
+	uint32_t			rows_count = 0;
+
+	/* The window is clamped to the rows left in the table */
+	retval = mapistore_backend_table_get_rows(bctx, NULL, mem_ctx, MAPISTORE_PREFILTERED_QUERY,
+						  3, 10, &rows, &rows_count);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(rows_count, TEST_TABLE_ROWS - 3);
+	ck_assert_int_eq(get_row_calls, TEST_TABLE_ROWS - 3);
+	ck_assert_int_eq(*(uint32_t *)rows[0][0].data, 3);
+	ck_assert_int_eq(*(uint32_t *)rows[1][0].data, 4);
+
+	/* Nothing is fetched past the end of the table */
+	get_row_calls = 0;
+	retval = mapistore_backend_table_get_rows(bctx, NULL, mem_ctx, MAPISTORE_PREFILTERED_QUERY,
+						  TEST_TABLE_ROWS, 10, &rows, &rows_count);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(rows_count, 0);
+	ck_assert_int_eq(get_row_calls, 0);
+} END_TEST
+
+START_TEST (test_get_rows_fallback_no_row_count) {
+	enum mapistore_error		retval;
+	struct mapistore_property_data	**rows = NULL;
+	uint32_t			rows_count = 0;
+
+	/* Without get_row_count the requested window is kept */
+	backend->table.get_row_count = NULL;
+	backend->table.get_rows = NULL;
+
+	retval = mapistore_backend_table_get_rows(bctx, NULL, mem_ctx, MAPISTORE_PREFILTERED_QUERY,
+						  3, 4, &rows, &rows_count);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(rows_count, 4);
+	ck_assert(rows[1] != NULL);
+	ck_assert(rows[2] == NULL);
+	ck_assert(rows[3] == NULL);
+} END_TEST
+
+Suite *mapistore_backend_suite(void)
+{
+	Suite *s = suite_create("libmapistore backend");
+
+	TCase *tc = tcase_create("table get_rows");
+	tcase_add_checked_fixture(tc, tc_backend_setup, tc_backend_teardown);
+
+	tcase_add_test(tc, test_get_rows_fallback);
+	tcase_add_test(tc, test_get_rows_fallback_end_of_table);
+	tcase_add_test(tc, test_get_rows_fallback_no_row_count);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
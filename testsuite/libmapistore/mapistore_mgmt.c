@@ -0,0 +1,226 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
+#include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
+
+/* No newmail queue is ever created for this user */
+#define	NEWMAIL_USER		"mgmt-testsuite-nobody"
+/* A user with a session waiting for notifications */
+#define	NEWMAIL_LISTENER	"mgmt-testsuite-listener"
+#define	NEWMAIL_STRESS_COUNT	10000
+#define	NEWMAIL_STRESS_FOLDERS	10
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct tevent_context		*ev;
+static struct mapistore_context		*mstore_ctx;
+static struct mapistore_mgmt_context	*mgmt_ctx;
+
+
+START_TEST (test_newmail_coalesce) {
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(NULL, NEWMAIL_USER, 1, 1, "uri"),
+			 MAPISTORE_ERR_NOT_INITIALIZED);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 1, NULL),
+			 MAPISTORE_ERR_INVALID_PARAMETER);
+
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 1, "uri1"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 2, "uri2"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 3, "uri3"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 1);
+	ck_assert_int_eq(mgmt_ctx->newmail->count, 3);
+	ck_assert(mgmt_ctx->newmail->MessageID == 3);
+	ck_assert_str_eq(mgmt_ctx->newmail->MAPIStoreURI, "uri3");
+
+	/* other folders and users are not coalesced together */
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 2, 4, "uri4"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER "2", 1, 5, "uri5"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 3);
+
+	ck_assert(mgmt_ctx->stats.newmail_received == 5);
+	ck_assert(mgmt_ctx->stats.newmail_coalesced == 2);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 0);
+} END_TEST
+
+START_TEST (test_newmail_bounded) {
+	ck_assert_int_eq(mapistore_mgmt_set_newmail_limits(mgmt_ctx, 0, 1000), MAPISTORE_ERR_INVALID_PARAMETER);
+	ck_assert_int_eq(mapistore_mgmt_set_newmail_limits(mgmt_ctx, 2, 1000), MAPISTORE_SUCCESS);
+
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 1, "uri1"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 2, 2, "uri2"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 3, 3, "uri3"), MAPISTORE_ERR_MSG_SEND);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 2);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 1);
+
+	/* a full queue still coalesces pending folders */
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 2, 4, "uri4"), MAPISTORE_SUCCESS);
+	ck_assert(mgmt_ctx->stats.newmail_coalesced == 1);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 1);
+} END_TEST
+
+START_TEST (test_newmail_flush) {
+	ck_assert_int_eq(mapistore_mgmt_set_newmail_limits(mgmt_ctx, MAPISTORE_MGMT_NEWMAIL_MAX_PENDING, 1), MAPISTORE_SUCCESS);
+
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 1, "uri1"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 2, 2, "uri2"), MAPISTORE_SUCCESS);
+	ck_assert(mgmt_ctx->flush_te != NULL);
+
+	/* the flush timer sends every pending notification at once */
+	ck_assert_int_eq(tevent_loop_once(ev), 0);
+	ck_assert(mgmt_ctx->flush_te == NULL);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 0);
+	ck_assert(mgmt_ctx->newmail == NULL);
+
+	/* the user has no newmail queue */
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 2);
+	ck_assert(mgmt_ctx->stats.newmail_sent == 0);
+} END_TEST
+
+START_TEST (test_newmail_no_event_context) {
+	ck_assert_int_eq(mapistore_mgmt_set_event_context(mgmt_ctx, NULL), MAPISTORE_SUCCESS);
+
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, 1, 1, "uri1"), MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 0);
+	ck_assert(mgmt_ctx->flush_te == NULL);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 1);
+} END_TEST
+
+/* Commands sent on the IPC queue are processed from the event loop */
+START_TEST (test_ipc_event_context) {
+	struct mapistore_mgmt_command	cmd;
+	enum ndr_err_code		ndr_err;
+	DATA_BLOB			data;
+	mqd_t				mqfd;
+
+	memset(&cmd, 0, sizeof (cmd));
+	cmd.type = MAPISTORE_MGMT_NOTIF;
+	cmd.command.notification.status = MAPISTORE_MGMT_REGISTER;
+	cmd.command.notification.username = NEWMAIL_USER;
+	cmd.command.notification.WholeStore = 1;
+	ndr_err = ndr_push_struct_blob(&data, mem_ctx, &cmd, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command);
+	ck_assert(NDR_ERR_CODE_IS_SUCCESS(ndr_err));
+
+	mqfd = mq_open(MAPISTORE_MQUEUE_IPC, O_WRONLY|O_NONBLOCK);
+	ck_assert(mqfd != (mqd_t)-1);
+	ck_assert_int_eq(mq_send(mqfd, (const char *)data.data, data.length, 0), 0);
+	ck_assert(mgmt_ctx->stats.ipc_received == 0);
+
+	ck_assert_int_eq(tevent_loop_once(ev), 0);
+	ck_assert(mgmt_ctx->stats.ipc_received == 1);
+
+	/* detached from the loop, the queue is only read on request */
+	ck_assert_int_eq(mapistore_mgmt_set_event_context(mgmt_ctx, NULL), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mq_send(mqfd, (const char *)data.data, data.length, 0), 0);
+	ck_assert(mgmt_ctx->stats.ipc_received == 1);
+	ck_assert_int_eq(mapistore_mgmt_process_ipc(mgmt_ctx), MAPISTORE_SUCCESS);
+	ck_assert(mgmt_ctx->stats.ipc_received == 2);
+	mq_close(mqfd);
+} END_TEST
+
+/* Newmail reaches the sessions listening on the user queue, whatever
+ * subscription was registered with the management interface */
+START_TEST (test_newmail_delivered) {
+	struct mapistore_notification_list	*nl = NULL;
+	mqd_t					mqueue;
+	char					*mqueue_name;
+
+	mqueue = mapistore_notification_newmail_open(NEWMAIL_LISTENER);
+	ck_assert(mqueue != (mqd_t)-1);
+
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_LISTENER, 1, 1, "uri1"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_LISTENER, 1, 2, "uri2"), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_flush_notifications(mgmt_ctx), MAPISTORE_SUCCESS);
+	ck_assert(mgmt_ctx->stats.newmail_sent == 1);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == 0);
+
+	/* the coalesced newmail is a single message created notification */
+	ck_assert_int_eq(mapistore_notification_newmail_receive(mem_ctx, mqueue, &nl), MAPISTORE_SUCCESS);
+	ck_assert(nl != NULL);
+	ck_assert(nl->next == NULL);
+	ck_assert_int_eq(nl->notification->object_type, MAPISTORE_MESSAGE);
+	ck_assert_int_eq(nl->notification->event, MAPISTORE_OBJECT_CREATED);
+	ck_assert(nl->notification->parameters.object_parameters.folder_id == 1);
+	ck_assert(nl->notification->parameters.object_parameters.object_id == 2);
+
+	mq_close(mqueue);
+	mqueue_name = talloc_asprintf(mem_ctx, MAPISTORE_MQUEUE_NEWMAIL_FMT, NEWMAIL_LISTENER);
+	mq_unlink(mqueue_name);
+} END_TEST
+
+START_TEST (test_newmail_stress) {
+	uint32_t	i;
+
+	for (i = 0; i < NEWMAIL_STRESS_COUNT; i++) {
+		ck_assert_int_eq(mapistore_mgmt_send_newmail_notification(mgmt_ctx, NEWMAIL_USER, i % NEWMAIL_STRESS_FOLDERS,
+									   i, "uri"), MAPISTORE_SUCCESS);
+	}
+	ck_assert_int_eq(mgmt_ctx->newmail_count, NEWMAIL_STRESS_FOLDERS);
+	ck_assert(mgmt_ctx->stats.newmail_coalesced == NEWMAIL_STRESS_COUNT - NEWMAIL_STRESS_FOLDERS);
+
+	mapistore_mgmt_flush_notifications(mgmt_ctx);
+	ck_assert_int_eq(mgmt_ctx->newmail_count, 0);
+	ck_assert(mgmt_ctx->stats.newmail_dropped == NEWMAIL_STRESS_FOLDERS);
+} END_TEST
+
+static void tc_mgmt_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapistore_mgmt_suite");
+	ev = tevent_context_init(mem_ctx);
+	ck_assert(ev != NULL);
+	mstore_ctx = talloc_zero(mem_ctx, struct mapistore_context);
+	ck_assert(mstore_ctx != NULL);
+
+	mgmt_ctx = mapistore_mgmt_init(mstore_ctx);
+	ck_assert(mgmt_ctx != NULL);
+	ck_assert_int_eq(mapistore_mgmt_set_event_context(mgmt_ctx, ev), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_mgmt_set_newmail_limits(mgmt_ctx, MAPISTORE_MGMT_NEWMAIL_MAX_PENDING, 1000),
+			 MAPISTORE_SUCCESS);
+}
+
+static void tc_mgmt_teardown(void)
+{
+	mapistore_mgmt_release(mgmt_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapistore_mgmt_suite(void)
+{
+	Suite *s = suite_create("libmapistore mgmt");
+
+	TCase *tc = tcase_create("newmail notifications");
+	tcase_add_checked_fixture(tc, tc_mgmt_setup, tc_mgmt_teardown);
+
+	tcase_add_test(tc, test_newmail_coalesce);
+	tcase_add_test(tc, test_newmail_bounded);
+	tcase_add_test(tc, test_newmail_flush);
+	tcase_add_test(tc, test_newmail_no_event_context);
+	tcase_add_test(tc, test_ipc_event_context);
+	tcase_add_test(tc, test_newmail_delivered);
+	tcase_add_test(tc, test_newmail_stress);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
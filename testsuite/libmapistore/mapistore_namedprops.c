@@ -61,17 +61,320 @@ START_TEST (test_init) {
 
 } END_TEST
 
+#define NAMEDPROPS_CACHE_LDB_PATH	"/tmp/nprops_cache.ldb"
+#define NAMEDPROPS_CACHE_SCHEMA_PATH	"setup/mapistore"
+
+static TALLOC_CTX			*g_mem_ctx;
+static struct loadparm_context		*g_lp_ctx;
+static struct namedprops_context	*g_nprops;
+
+static void cache_setup(void)
+{
+	enum mapistore_error	retval;
+
+	g_mem_ctx = talloc_named(NULL, 0, "cache_setup");
+	ck_assert(g_mem_ctx != NULL);
+
+	g_lp_ctx = loadparm_init(g_mem_ctx);
+	ck_assert(g_lp_ctx != NULL);
+
+	mapistore_namedprops_cache_flush();
+	unlink(NAMEDPROPS_CACHE_LDB_PATH);
+	ck_assert(lpcfg_set_cmdline(g_lp_ctx, "mapistore:namedproperties", "ldb"));
+	ck_assert(lpcfg_set_cmdline(g_lp_ctx, "namedproperties:ldb_url", NAMEDPROPS_CACHE_LDB_PATH));
+	ck_assert(lpcfg_set_cmdline(g_lp_ctx, "namedproperties:ldb_data", NAMEDPROPS_CACHE_SCHEMA_PATH));
+
+	retval = mapistore_namedprops_init(g_mem_ctx, g_lp_ctx, &g_nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+}
+
+static void cache_teardown(void)
+{
+	mapistore_namedprops_cache_flush();
+	unlink(NAMEDPROPS_CACHE_LDB_PATH);
+	talloc_free(g_mem_ctx);
+}
+
+static enum mapistore_error backend_get_mapped_id_fail(struct namedprops_context *self,
+						       struct MAPINAMEID nameid,
+						       uint16_t *propID)
+{
+	return MAPISTORE_ERR_DATABASE_OPS;
+}
+
+static enum mapistore_error backend_get_nameid_fail(struct namedprops_context *self,
+						    uint16_t propID,
+						    TALLOC_CTX *mem_ctx,
+						    struct MAPINAMEID **nameidp)
+{
+	return MAPISTORE_ERR_DATABASE_OPS;
+}
+
+static void set_nameid(struct MAPINAMEID *nameid, uint32_t time_low, uint16_t kind)
+{
+	memset(nameid, 0, sizeof (struct MAPINAMEID));
+	nameid->ulKind = kind;
+	nameid->lpguid.time_low = time_low;
+	nameid->lpguid.clock_seq[0] = 0xc0;
+	nameid->lpguid.node[5] = 0x46;
+}
+
+START_TEST (test_cache_get_mapped_ids) {
+	enum mapistore_error	retval;
+	struct MAPINAMEID	nameids[4];
+	uint16_t		propIDs[4];
+
+	/* check sanity checks compliance */
+	retval = mapistore_namedprops_get_mapped_ids(NULL, 1, nameids, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 1, NULL, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 1, nameids, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	/* PidLidPercentComplete, PidNameSmallicon and two more from the ldif */
+	set_nameid(&nameids[0], 0x62003, MNID_ID);
+	nameids[0].kind.lid = 33026;
+	set_nameid(&nameids[1], 0x20329, MNID_STRING);
+	nameids[1].kind.lpwstr.Name = "http://schemas.microsoft.com/exchange/smallicon";
+	set_nameid(&nameids[2], 0x62004, MNID_ID);
+	nameids[2].kind.lid = 32978;
+	set_nameid(&nameids[3], 0x20329, MNID_STRING);
+	nameids[3].kind.lpwstr.Name = "http://schemas.microsoft.com/exchange/searchfolder";
+
+	/* All the mappings are served from the cache loaded by init */
+	g_nprops->get_mapped_id = backend_get_mapped_id_fail;
+
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 4, nameids, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(propIDs[0], 37153);
+	ck_assert_int_eq(propIDs[1], 38342);
+	ck_assert_int_eq(propIDs[2], 37524);
+	ck_assert_int_eq(propIDs[3], 38365);
+
+	/* Unknown names get a 0x0000 ID */
+	nameids[1].kind.lpwstr.Name = "unknown";
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 4, nameids, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(propIDs[0], 37153);
+	ck_assert_int_eq(propIDs[1], 0);
+	ck_assert_int_eq(propIDs[2], 37524);
+
+} END_TEST
+
+START_TEST (test_cache_get_nameids) {
+	enum mapistore_error	retval;
+	TALLOC_CTX		*mem_ctx;
+	struct MAPINAMEID	**nameids = NULL;
+	uint16_t		propIDs[] = { 38212, 38306, 42, 38111 };
+	uint16_t		prop_type = 0;
+
+	mem_ctx = talloc_named(NULL, 0, "test_cache_get_nameids");
+	ck_assert(mem_ctx != NULL);
+
+	g_nprops->get_nameid = backend_get_nameid_fail;
+
+	retval = mapistore_namedprops_get_nameids(g_nprops, 4, propIDs, mem_ctx, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	retval = mapistore_namedprops_get_nameids(g_nprops, 4, propIDs, mem_ctx, &nameids);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert(nameids != NULL);
+
+	ck_assert(nameids[0] != NULL);
+	ck_assert_int_eq(nameids[0]->ulKind, MNID_ID);
+	ck_assert_int_eq(nameids[0]->kind.lid, 32778);
+
+	ck_assert(nameids[1] != NULL);
+	ck_assert_int_eq(nameids[1]->ulKind, MNID_STRING);
+	ck_assert_str_eq(nameids[1]->kind.lpwstr.Name, "urn:schemas:httpmail:junkemail");
+
+	ck_assert(nameids[2] == NULL);
+
+	ck_assert(nameids[3] != NULL);
+	ck_assert_int_eq(nameids[3]->kind.lid, 34063);
+
+	/* The property type is loaded along with the mapping */
+	retval = mapistore_namedprops_get_nameid_type(g_nprops, 37090, &prop_type);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(prop_type, PT_SYSTIME);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST (test_cache_create_id) {
+	enum mapistore_error		retval;
+	TALLOC_CTX			*mem_ctx;
+	struct namedprops_context	*nprops;
+	struct MAPINAMEID		nameid;
+	struct MAPINAMEID		*result = NULL;
+	uint16_t			mapped_id = 0;
+	uint16_t			propID = 0;
+
+	mem_ctx = talloc_named(NULL, 0, "test_cache_create_id");
+	ck_assert(mem_ctx != NULL);
+
+	set_nameid(&nameid, 0x12345678, MNID_STRING);
+	nameid.kind.lpwstr.Name = "urn:openchange:cache-test";
+
+	retval = mapistore_namedprops_next_unused_id(g_nprops, &mapped_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = mapistore_namedprops_transaction_start(g_nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_namedprops_create_id(g_nprops, nameid, mapped_id);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_namedprops_transaction_commit(g_nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* Another context on the same database shares the mapping */
+	retval = mapistore_namedprops_init(mem_ctx, g_lp_ctx, &nprops);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	nprops->get_mapped_id = backend_get_mapped_id_fail;
+	nprops->get_nameid = backend_get_nameid_fail;
+
+	retval = mapistore_namedprops_get_mapped_id(nprops, nameid, &propID);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(propID, mapped_id);
+
+	retval = mapistore_namedprops_get_nameid(nprops, mapped_id, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(result != NULL);
+	ck_assert_int_eq(result->ulKind, MNID_STRING);
+	ck_assert_str_eq(result->kind.lpwstr.Name, "urn:openchange:cache-test");
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+static enum mapistore_error (*backend_get_mapped_ids)(struct namedprops_context *, uint16_t, const struct MAPINAMEID *, namedprops_traverse_fn, void *);
+static enum mapistore_error (*backend_get_nameids)(struct namedprops_context *, uint16_t, const uint16_t *, namedprops_traverse_fn, void *);
+static uint32_t backend_bulk_calls;
+
+static enum mapistore_error backend_get_mapped_ids_count(struct namedprops_context *self, uint16_t count,
+							  const struct MAPINAMEID *nameids,
+							  namedprops_traverse_fn fn, void *private_data)
+{
+	backend_bulk_calls++;
+	return backend_get_mapped_ids(self, count, nameids, fn, private_data);
+}
+
+static enum mapistore_error backend_get_nameids_count(struct namedprops_context *self, uint16_t count,
+						       const uint16_t *propIDs,
+						       namedprops_traverse_fn fn, void *private_data)
+{
+	backend_bulk_calls++;
+	return backend_get_nameids(self, count, propIDs, fn, private_data);
+}
+
+/* Store a mapping in the backend only, as another process would */
+static uint16_t backend_create_id(struct MAPINAMEID *nameid, uint32_t time_low, const char *name)
+{
+	uint16_t	mapped_id = 0;
+
+	set_nameid(nameid, time_low, MNID_STRING);
+	nameid->kind.lpwstr.Name = name;
+
+	ck_assert_int_eq(g_nprops->next_unused_id(g_nprops, &mapped_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_nprops->transaction_start(g_nprops), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_nprops->create_id(g_nprops, *nameid, mapped_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_nprops->transaction_commit(g_nprops), MAPISTORE_SUCCESS);
+
+	return mapped_id;
+}
+
+START_TEST (test_cache_bulk_miss) {
+	enum mapistore_error	retval;
+	TALLOC_CTX		*mem_ctx;
+	struct MAPINAMEID	nameids[4];
+	struct MAPINAMEID	**result = NULL;
+	uint16_t		mapped_ids[4];
+	uint16_t		propIDs[4];
+
+	mem_ctx = talloc_named(NULL, 0, "test_cache_bulk_miss");
+	ck_assert(mem_ctx != NULL);
+
+	ck_assert(g_nprops->get_mapped_ids != NULL);
+	ck_assert(g_nprops->get_nameids != NULL);
+	backend_get_mapped_ids = g_nprops->get_mapped_ids;
+	backend_get_nameids = g_nprops->get_nameids;
+	g_nprops->get_mapped_ids = backend_get_mapped_ids_count;
+	g_nprops->get_nameids = backend_get_nameids_count;
+	g_nprops->get_mapped_id = backend_get_mapped_id_fail;
+	g_nprops->get_nameid = backend_get_nameid_fail;
+
+	/* PidLidPercentComplete is cached, the others are cache misses */
+	set_nameid(&nameids[0], 0x62003, MNID_ID);
+	nameids[0].kind.lid = 33026;
+	mapped_ids[1] = backend_create_id(&nameids[1], 0x12345678, "urn:openchange:bulk-1");
+	mapped_ids[2] = backend_create_id(&nameids[2], 0x12345678, "urn:openchange:bulk-2");
+	set_nameid(&nameids[3], 0x12345678, MNID_STRING);
+	nameids[3].kind.lpwstr.Name = "urn:openchange:bulk-unknown";
+
+	/* All the misses are looked up at once */
+	backend_bulk_calls = 0;
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 4, nameids, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(backend_bulk_calls, 1);
+	ck_assert_int_eq(propIDs[0], 37153);
+	ck_assert_int_eq(propIDs[1], mapped_ids[1]);
+	ck_assert_int_eq(propIDs[2], mapped_ids[2]);
+	ck_assert_int_eq(propIDs[3], 0);
+
+	/* and cached afterwards */
+	backend_bulk_calls = 0;
+	retval = mapistore_namedprops_get_mapped_ids(g_nprops, 3, nameids, propIDs);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(backend_bulk_calls, 0);
+
+	/* Same for the reverse lookup */
+	mapped_ids[0] = 38212;
+	mapped_ids[1] = backend_create_id(&nameids[1], 0x12345678, "urn:openchange:bulk-3");
+	mapped_ids[2] = backend_create_id(&nameids[2], 0x12345678, "urn:openchange:bulk-4");
+	mapped_ids[3] = 42;
+
+	backend_bulk_calls = 0;
+	retval = mapistore_namedprops_get_nameids(g_nprops, 4, mapped_ids, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(backend_bulk_calls, 1);
+	ck_assert(result != NULL);
+	ck_assert(result[0] != NULL);
+	ck_assert_int_eq(result[0]->kind.lid, 32778);
+	ck_assert(result[1] != NULL);
+	ck_assert_str_eq(result[1]->kind.lpwstr.Name, "urn:openchange:bulk-3");
+	ck_assert(result[2] != NULL);
+	ck_assert_str_eq(result[2]->kind.lpwstr.Name, "urn:openchange:bulk-4");
+	ck_assert(result[3] == NULL);
+
+	backend_bulk_calls = 0;
+	retval = mapistore_namedprops_get_nameids(g_nprops, 3, mapped_ids, mem_ctx, &result);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(backend_bulk_calls, 0);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
 Suite *mapistore_namedprops_suite(void)
 {
 	Suite	*s;
 	TCase	*tc_intf;
+	TCase	*tc_cache;
 
 	s = suite_create("libmapistore named properties: interface");
 
 	tc_intf = tcase_create("Interface");
 	tcase_add_test(tc_intf, test_init);
 
+	tc_cache = tcase_create("Process cache");
+	tcase_add_checked_fixture(tc_cache, cache_setup, cache_teardown);
+	tcase_add_test(tc_cache, test_cache_get_mapped_ids);
+	tcase_add_test(tc_cache, test_cache_get_nameids);
+	tcase_add_test(tc_cache, test_cache_create_id);
+	tcase_add_test(tc_cache, test_cache_bulk_miss);
+
 	suite_add_tcase(s, tc_intf);
+	suite_add_tcase(s, tc_cache);
 
 	return s;
 }
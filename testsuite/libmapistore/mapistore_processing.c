@@ -0,0 +1,154 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+#define	CONTEXT_ID_STRESS_COUNT		1000
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct processing_context	*pctx;
+static struct backend_context_index	*ctx_index;
+
+
+static struct backend_context_list *_make_context(uint32_t context_id, const char *uri)
+{
+	struct backend_context_list	*el;
+
+	el = talloc_zero(mem_ctx, struct backend_context_list);
+	el->ctx = talloc_zero(el, struct backend_context);
+	el->ctx->context_id = context_id;
+	el->ctx->uri = uri ? talloc_strdup(el->ctx, uri) : NULL;
+
+	return el;
+}
+
+START_TEST (test_context_id_alloc) {
+	uint32_t	context_id;
+	uint32_t	i;
+
+	ck_assert_int_eq(mapistore_get_context_id(NULL, &context_id), MAPISTORE_ERR_NOT_INITIALIZED);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, NULL), MAPISTORE_ERR_INVALID_PARAMETER);
+
+	/* identifiers start at 1 and are allocated in sequence */
+	for (i = 1; i <= CONTEXT_ID_STRESS_COUNT; i++) {
+		ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+		ck_assert_int_eq(context_id, i);
+	}
+
+	/* the lowest released identifier is reused first */
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 700), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 42), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, 42);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, 700);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, CONTEXT_ID_STRESS_COUNT + 1);
+} END_TEST
+
+START_TEST (test_context_id_free) {
+	uint32_t	context_id;
+
+	ck_assert_int_eq(mapistore_free_context_id(NULL, 1), MAPISTORE_ERR_NOT_INITIALIZED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 1), MAPISTORE_ERR_CORRUPTED);
+
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 0), MAPISTORE_ERR_CORRUPTED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, context_id + 1), MAPISTORE_ERR_CORRUPTED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 0x100000), MAPISTORE_ERR_CORRUPTED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, context_id), MAPISTORE_SUCCESS);
+	/* double free */
+	ck_assert_int_eq(mapistore_free_context_id(pctx, context_id), MAPISTORE_ERR_CORRUPTED);
+} END_TEST
+
+START_TEST (test_backend_index) {
+	struct backend_context_list	*el;
+	struct backend_context_list	*other;
+	struct backend_context_list	*unnamed;
+	struct mapistore_context	mstore_ctx;
+
+	el = _make_context(1, "fsocpf://folder/");
+	other = _make_context(300, "sogo://user@mail/folderINBOX/");
+	unnamed = _make_context(2, NULL);
+
+	ck_assert_int_eq(mapistore_backend_index_add(NULL, el), MAPISTORE_ERR_NOT_INITIALIZED);
+	ck_assert_int_eq(mapistore_backend_index_add(ctx_index, NULL), MAPISTORE_ERR_INVALID_PARAMETER);
+
+	ck_assert_int_eq(mapistore_backend_index_add(ctx_index, el), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_index_add(ctx_index, other), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_index_add(ctx_index, unnamed), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_index_add(ctx_index, el), MAPISTORE_ERR_EXIST);
+
+	ck_assert(mapistore_backend_index_get(ctx_index, 1) == el);
+	ck_assert(mapistore_backend_index_get(ctx_index, 2) == unnamed);
+	ck_assert(mapistore_backend_index_get(ctx_index, 300) == other);
+	ck_assert(mapistore_backend_index_get(ctx_index, 3) == NULL);
+	ck_assert(mapistore_backend_index_get(ctx_index, 0x100000) == NULL);
+
+	memset(&mstore_ctx, 0, sizeof (mstore_ctx));
+	mstore_ctx.context_index = ctx_index;
+	ck_assert(mapistore_backend_lookup(&mstore_ctx, 300) == other->ctx);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, "fsocpf://folder/") == el->ctx);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, "sogo://user@mail/folderINBOX/") == other->ctx);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, "fsocpf://folder") == NULL);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, NULL) == NULL);
+	ck_assert(mapistore_backend_lookup(NULL, 1) == NULL);
+
+	ck_assert_int_eq(mapistore_backend_index_del(ctx_index, el), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_index_del(ctx_index, el), MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(mapistore_backend_index_del(ctx_index, unnamed), MAPISTORE_SUCCESS);
+	ck_assert(mapistore_backend_lookup(&mstore_ctx, 1) == NULL);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, "fsocpf://folder/") == NULL);
+	ck_assert(mapistore_backend_lookup_by_uri(&mstore_ctx, "sogo://user@mail/folderINBOX/") == other->ctx);
+} END_TEST
+
+static void tc_processing_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapistore_processing_suite");
+	pctx = talloc_zero(mem_ctx, struct processing_context);
+	ctx_index = mapistore_backend_index_init(mem_ctx);
+	ck_assert(ctx_index != NULL);
+}
+
+static void tc_processing_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapistore_processing_suite(void)
+{
+	Suite *s = suite_create("libmapistore processing");
+
+	TCase *tc = tcase_create("context lookups");
+	tcase_add_checked_fixture(tc, tc_processing_setup, tc_processing_teardown);
+
+	tcase_add_test(tc, test_context_id_alloc);
+	tcase_add_test(tc, test_context_id_free);
+	tcase_add_test(tc, test_backend_index);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
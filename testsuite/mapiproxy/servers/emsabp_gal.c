@@ -0,0 +1,282 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#define	GAL_ORGANIZATION		"Example"
+#define	GAL_DOMAIN_DN			"DC=example,DC=com"
+#define	GAL_CONFIG_DN			"CN=Configuration," GAL_DOMAIN_DN
+#define	GAL_EXCHANGE_DN			"CN=Microsoft Exchange,CN=Services," GAL_CONFIG_DN
+#define	GAL_DN				"CN=Default Global Address List,CN=All Global Address Lists," \
+					"CN=Address Lists Container,CN=" GAL_ORGANIZATION "," GAL_EXCHANGE_DN
+#define	GAL_TEST_USERS			200
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct emsabp_context	*emsabp_ctx;
+static char			*ldb_path;
+
+
+static void _add_entry(struct ldb_context *ldb_ctx, const char *dn, const char *attr, ...)
+{
+	struct ldb_message	*msg;
+	va_list			ap;
+	const char		*value;
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new(msg, ldb_ctx, dn);
+
+	va_start(ap, attr);
+	for (; attr; attr = va_arg(ap, const char *)) {
+		value = va_arg(ap, const char *);
+		ldb_msg_add_string(msg, attr, value);
+	}
+	va_end(ap);
+
+	ck_assert_int_eq(ldb_add(ldb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+}
+
+/* A directory with the GAL container and users whose display names are
+ * not added in sort order */
+static void _make_directory(uint32_t users)
+{
+	struct ldb_context	*ldb_ctx;
+	char			*dn;
+	char			*display_name;
+	char			*legacy_dn;
+	uint32_t		i, n;
+
+	ldb_path = talloc_asprintf(mem_ctx, "/tmp/emsabp_gal_%d.ldb", (int)getpid());
+	unlink(ldb_path);
+
+	ldb_ctx = ldb_init(mem_ctx, NULL);
+	ck_assert(ldb_ctx != NULL);
+	ck_assert_int_eq(ldb_connect(ldb_ctx, ldb_path, 0, NULL), LDB_SUCCESS);
+	ldb_set_opaque(ldb_ctx, "defaultNamingContext", ldb_dn_new(ldb_ctx, ldb_ctx, GAL_DOMAIN_DN));
+	ldb_set_opaque(ldb_ctx, "configurationNamingContext", ldb_dn_new(ldb_ctx, ldb_ctx, GAL_CONFIG_DN));
+
+	ck_assert_int_eq(ldb_transaction_start(ldb_ctx), LDB_SUCCESS);
+	_add_entry(ldb_ctx, GAL_EXCHANGE_DN, "objectClass", "msExchConfigurationContainer",
+		   "globalAddressList", GAL_DN, NULL);
+	_add_entry(ldb_ctx, GAL_DN, "objectClass", "addressBookContainer",
+		   "purportedSearch", "(&(objectClass=user)(displayName=*))", NULL);
+	for (i = 0; i < users; i++) {
+		n = (i * 7919) % users;
+		dn = talloc_asprintf(mem_ctx, "CN=user%05u,CN=Users," GAL_DOMAIN_DN, n);
+		display_name = talloc_asprintf(mem_ctx, "%s %05u", (n % 2) ? "user" : "User", n);
+		legacy_dn = talloc_asprintf(mem_ctx, "/o=" GAL_ORGANIZATION "/ou=First Administrative Group"
+					    "/cn=Recipients/cn=user%05u", n);
+		_add_entry(ldb_ctx, dn, "objectClass", "user", "displayName", display_name,
+			   "legacyExchangeDN", legacy_dn, "sAMAccountName", dn + 3, NULL);
+		talloc_free(dn);
+		talloc_free(display_name);
+		talloc_free(legacy_dn);
+	}
+	ck_assert_int_eq(ldb_transaction_commit(ldb_ctx), LDB_SUCCESS);
+
+	emsabp_ctx = talloc_zero(mem_ctx, struct emsabp_context);
+	emsabp_ctx->mem_ctx = emsabp_ctx;
+	emsabp_ctx->organization_name = GAL_ORGANIZATION;
+	emsabp_ctx->samdb_ctx = ldb_ctx;
+	emsabp_ctx->tdb_ctx = emsabp_tdb_init_tmp(emsabp_ctx);
+	emsabp_ctx->ttdb_ctx = emsabp_tdb_init_tmp(emsabp_ctx);
+	ck_assert(emsabp_ctx->tdb_ctx && emsabp_ctx->ttdb_ctx);
+	emsabp_ctx->gal_max_size = EMSABP_GAL_MAX_SIZE * 1024 * 1024;
+	emsabp_ctx->gal_refresh = EMSABP_GAL_REFRESH;
+}
+
+START_TEST (test_gal_build) {
+	struct emsabp_gal_snapshot	*gal = NULL;
+	struct emsabp_gal_snapshot	*gal2 = NULL;
+	uint32_t			i;
+
+	ck_assert_int_eq(emsabp_gal_get(NULL, 0, &gal), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, NULL), MAPI_E_INVALID_PARAMETER);
+
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+	ck_assert_int_eq(gal->count, GAL_TEST_USERS);
+	ck_assert_int_eq(gal->MIds.cValues, GAL_TEST_USERS);
+	ck_assert(emsabp_gal_size() == gal->size);
+
+	/* sorted by display name, case insensitive */
+	for (i = 1; i < gal->count; i++) {
+		ck_assert(strcasecmp(gal->entries[i - 1].display_name, gal->entries[i].display_name) <= 0);
+		ck_assert_int_eq(gal->MIds.aulPropTag[i], gal->entries[i].MId);
+	}
+	ck_assert_str_eq(gal->entries[0].display_name, "User 00000");
+	ck_assert_str_eq(gal->entries[1].display_name, "user 00001");
+
+	/* the snapshot is reused until the refresh interval expires */
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal2), MAPI_E_SUCCESS);
+	ck_assert(gal == gal2);
+
+	/* unknown containers are reported as such */
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0x1234, &gal2), MAPI_E_INVALID_BOOKMARK);
+	ck_assert(emsabp_ctx->gal == gal);
+} END_TEST
+
+START_TEST (test_gal_find) {
+	struct emsabp_gal_snapshot	*gal = NULL;
+	struct ldb_message		*msg;
+	uint32_t			row;
+	uint32_t			i;
+
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+
+	for (i = 0; i < gal->count; i++) {
+		ck_assert_int_eq(emsabp_gal_find_MId(gal, gal->entries[i].MId, &row), MAPI_E_SUCCESS);
+		ck_assert_int_eq(row, i);
+		msg = emsabp_gal_lookup_MId(emsabp_ctx, gal->entries[i].MId);
+		ck_assert(msg == gal->entries[i].msg);
+		ck_assert_str_eq(ldb_msg_find_attr_as_string(msg, "displayName", ""), gal->entries[i].display_name);
+		ck_assert(ldb_msg_find_attr_as_string(msg, "legacyExchangeDN", NULL) != NULL);
+	}
+
+	ck_assert_int_eq(emsabp_gal_find_MId(gal, 0x1, &row), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(emsabp_gal_find_MId(gal, 0x1, NULL), MAPI_E_INVALID_PARAMETER);
+	ck_assert(emsabp_gal_lookup_MId(emsabp_ctx, 0x1) == NULL);
+} END_TEST
+
+START_TEST (test_gal_seek) {
+	struct emsabp_gal_snapshot	*gal = NULL;
+	uint32_t			row;
+
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+
+	row = emsabp_gal_seek(gal, "user 00100");
+	ck_assert_str_eq(gal->entries[row].display_name, "User 00100");
+	row = emsabp_gal_seek(gal, "User 00100x");
+	ck_assert_str_eq(gal->entries[row].display_name, "user 00101");
+	ck_assert_int_eq(emsabp_gal_seek(gal, ""), 0);
+	ck_assert_int_eq(emsabp_gal_seek(gal, "A"), 0);
+	ck_assert_int_eq(emsabp_gal_seek(gal, "zzz"), gal->count);
+	ck_assert_int_eq(emsabp_gal_seek(gal, NULL), gal->count);
+} END_TEST
+
+START_TEST (test_gal_refresh) {
+	struct emsabp_gal_snapshot	*gal = NULL;
+	struct emsabp_gal_snapshot	*gal2 = NULL;
+	uint32_t			MId;
+
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+	MId = gal->entries[0].MId;
+
+	/* the test directory has no highestCommittedUSN, so it is
+	 * rebuilt on each check */
+	emsabp_ctx->gal_refresh = 0;
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal2), MAPI_E_SUCCESS);
+	ck_assert(emsabp_ctx->gal == gal2);
+	ck_assert(gal2->next == NULL);
+	ck_assert(emsabp_gal_size() == gal2->size);
+
+	/* MIds are kept for the session */
+	ck_assert_int_eq(gal2->entries[0].MId, MId);
+} END_TEST
+
+START_TEST (test_gal_memory_limit) {
+	struct emsabp_gal_snapshot	*gal = NULL;
+
+	emsabp_ctx->gal_max_size = 0;
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_NO_SUPPORT);
+
+	emsabp_ctx->gal_max_size = 1024;
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_NOT_ENOUGH_RESOURCES);
+	ck_assert(emsabp_ctx->gal == NULL);
+	ck_assert(emsabp_gal_size() == 0);
+
+	emsabp_ctx->gal_max_size = EMSABP_GAL_MAX_SIZE * 1024 * 1024;
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+	talloc_free(gal);
+	ck_assert(emsabp_ctx->gal == NULL);
+	ck_assert(emsabp_gal_size() == 0);
+} END_TEST
+
+START_TEST (test_gal_process_limit) {
+	struct emsabp_context		*emsabp_ctx2;
+	struct emsabp_gal_snapshot	*gal = NULL;
+	struct emsabp_gal_snapshot	*gal2 = NULL;
+
+	/* a second session on the same directory */
+	emsabp_ctx2 = talloc_zero(mem_ctx, struct emsabp_context);
+	emsabp_ctx2->mem_ctx = emsabp_ctx2;
+	emsabp_ctx2->organization_name = GAL_ORGANIZATION;
+	emsabp_ctx2->samdb_ctx = emsabp_ctx->samdb_ctx;
+	emsabp_ctx2->tdb_ctx = emsabp_tdb_init_tmp(emsabp_ctx2);
+	emsabp_ctx2->ttdb_ctx = emsabp_tdb_init_tmp(emsabp_ctx2);
+	ck_assert(emsabp_ctx2->tdb_ctx && emsabp_ctx2->ttdb_ctx);
+	emsabp_ctx2->gal_refresh = EMSABP_GAL_REFRESH;
+
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx, 0, &gal), MAPI_E_SUCCESS);
+
+	/* the limit applies to the snapshots of all the sessions */
+	emsabp_ctx2->gal_max_size = gal->size + gal->size / 2;
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx2, 0, &gal2), MAPI_E_NOT_ENOUGH_RESOURCES);
+	ck_assert(emsabp_ctx2->gal == NULL);
+	ck_assert(emsabp_gal_size() == gal->size);
+
+	/* and the memory is available again once the other session is done */
+	talloc_free(gal);
+	ck_assert(emsabp_gal_size() == 0);
+	ck_assert_int_eq(emsabp_gal_get(emsabp_ctx2, 0, &gal2), MAPI_E_SUCCESS);
+	ck_assert(emsabp_gal_size() == gal2->size);
+
+	tdb_close(emsabp_ctx2->ttdb_ctx);
+	tdb_close(emsabp_ctx2->tdb_ctx);
+	talloc_free(emsabp_ctx2);
+	ck_assert(emsabp_gal_size() == 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_gal_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_emsabp_gal_suite");
+	_make_directory(GAL_TEST_USERS);
+}
+
+static void tc_gal_teardown(void)
+{
+	tdb_close(emsabp_ctx->ttdb_ctx);
+	tdb_close(emsabp_ctx->tdb_ctx);
+	unlink(ldb_path);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_gal_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsabp gal");
+
+	TCase *tc = tcase_create("emsabp_gal");
+	tcase_add_checked_fixture(tc, tc_gal_setup, tc_gal_teardown);
+
+	tcase_add_test(tc, test_gal_build);
+	tcase_add_test(tc, test_gal_find);
+	tcase_add_test(tc, test_gal_seek);
+	tcase_add_test(tc, test_gal_refresh);
+	tcase_add_test(tc, test_gal_memory_limit);
+	tcase_add_test(tc, test_gal_process_limit);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,412 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+#include <dirent.h>
+
+#define	OAB_ORGANIZATION		"Example"
+#define	OAB_DOMAIN_DN			"DC=example,DC=com"
+#define	OAB_CONFIG_DN			"CN=Configuration," OAB_DOMAIN_DN
+#define	OAB_EXCHANGE_DN			"CN=Microsoft Exchange,CN=Services," OAB_CONFIG_DN
+#define	OAB_GAL_DN			"CN=Default Global Address List,CN=All Global Address Lists," \
+					"CN=Address Lists Container,CN=" OAB_ORGANIZATION "," OAB_EXCHANGE_DN
+#define	OAB_TEST_USERS			100
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct emsabp_context	*emsabp_ctx;
+static struct ldb_context	*ldb_ctx;
+static char			*ldb_path;
+static char			*oab_path;
+
+/* A parsed OAB file */
+struct oab_file {
+	uint32_t	hdr[7];
+	uint32_t	crc;
+	uint32_t	hdr_count;
+	uint32_t	oab_count;
+	uint32_t	*hdr_tags;
+	uint32_t	*oab_tags;
+	uint32_t	records;
+	const char	**keys;
+	const char	**display_names;
+};
+
+
+static void _add_user(uint32_t n, const char *display_name)
+{
+	struct ldb_message	*msg;
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new_fmt(msg, ldb_ctx, "CN=user%05u,CN=Users," OAB_DOMAIN_DN, n);
+	ldb_msg_add_string(msg, "objectClass", "user");
+	ldb_msg_add_string(msg, "displayName", display_name);
+	ldb_msg_add_fmt(msg, "sAMAccountName", "user%05u", n);
+	ldb_msg_add_fmt(msg, "mail", "user%05u@example.com", n);
+	ldb_msg_add_fmt(msg, "legacyExchangeDN", "/o=" OAB_ORGANIZATION "/ou=First Administrative Group"
+			"/cn=Recipients/cn=user%05u", n);
+	ldb_msg_add_fmt(msg, "proxyAddresses", "SMTP:user%05u@example.com", n);
+	ldb_msg_add_fmt(msg, "proxyAddresses", "smtp:alias%05u@example.com", n);
+	ck_assert_int_eq(ldb_add(ldb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+}
+
+static uint32_t _pull_int(const uint8_t **p, const uint8_t *end)
+{
+	uint32_t	value = 0;
+	uint32_t	len;
+	uint32_t	i;
+
+	ck_assert(*p < end);
+	if (**p <= 0x7F) {
+		return *(*p)++;
+	}
+
+	len = *(*p)++ & 0x7F;
+	ck_assert(len >= 1 && len <= 4);
+	ck_assert(*p + len <= end);
+	for (i = 0; i < len; i++) {
+		value |= (uint32_t)(*p)[i] << (8 * i);
+	}
+	*p += len;
+
+	return value;
+}
+
+static const char *_pull_string(const uint8_t **p, const uint8_t *end)
+{
+	const char	*str = (const char *) *p;
+	size_t		len;
+
+	len = strnlen(str, end - *p);
+	ck_assert(*p + len < end);
+	*p += len + 1;
+
+	return str;
+}
+
+/* Walk a record and return its first and second string values */
+static const uint8_t *_pull_record(const uint8_t *p, const uint8_t *end, uint32_t count, const uint32_t *tags,
+				   const char **first, const char **second)
+{
+	const uint8_t	*rec_end;
+	const uint8_t	*bits;
+	const char	*str;
+	uint32_t	size;
+	uint32_t	i, j, n;
+
+	ck_assert(p + 4 <= end);
+	size = IVAL(p, 0);
+	rec_end = p + size;
+	ck_assert(rec_end <= end);
+	bits = p + 4;
+	p += 4 + (count + 7) / 8;
+
+	if (first) *first = NULL;
+	if (second) *second = NULL;
+	for (i = 0; i < count; i++) {
+		if (!(bits[i / 8] & (0x80 >> (i % 8)))) continue;
+
+		switch (tags[i] & 0xFFFF) {
+		case PT_LONG:
+			_pull_int(&p, rec_end);
+			break;
+		case PT_BOOLEAN:
+			p++;
+			break;
+		case PT_STRING8:
+		case PT_UNICODE:
+			str = _pull_string(&p, rec_end);
+			if (i == 0 && first) *first = str;
+			if (i == 1 && second) *second = str;
+			break;
+		case PT_BINARY:
+			n = _pull_int(&p, rec_end);
+			p += n;
+			break;
+		case PT_MV_STRING8:
+		case PT_MV_UNICODE:
+			n = _pull_int(&p, rec_end);
+			for (j = 0; j < n; j++) {
+				_pull_string(&p, rec_end);
+			}
+			break;
+		default:
+			ck_abort_msg("unexpected property type 0x%x", tags[i]);
+		}
+	}
+	ck_assert(p == rec_end);
+
+	return rec_end;
+}
+
+static void _parse_oab(const char *filename, uint32_t hdr_size, struct oab_file *oab)
+{
+	const uint8_t	*data;
+	const uint8_t	*p;
+	const uint8_t	*end;
+	size_t		size;
+	uint32_t	i;
+
+	data = (const uint8_t *) file_load(talloc_asprintf(mem_ctx, "%s/%s", oab_path, filename),
+					   &size, 0, mem_ctx);
+	ck_assert(data != NULL);
+	ck_assert(size > hdr_size);
+	end = data + size;
+
+	memset(oab, 0, sizeof (struct oab_file));
+	for (i = 0; i < hdr_size / 4; i++) {
+		oab->hdr[i] = IVAL(data, i * 4);
+	}
+	ck_assert_int_eq(oab->hdr[0], EMSABP_OAB_VERSION);
+	oab->crc = updateCRC(0xFFFFFFFF, data + hdr_size, size - hdr_size);
+
+	/* OAB_META_DATA */
+	p = data + hdr_size;
+	ck_assert(p + IVAL(p, 0) <= end);
+	oab->hdr_count = IVAL(p, 4);
+	oab->hdr_tags = talloc_array(mem_ctx, uint32_t, oab->hdr_count);
+	for (i = 0; i < oab->hdr_count; i++) {
+		oab->hdr_tags[i] = IVAL(p, 8 + i * 8);
+	}
+	oab->oab_count = IVAL(p, 8 + oab->hdr_count * 8);
+	oab->oab_tags = talloc_array(mem_ctx, uint32_t, oab->oab_count);
+	for (i = 0; i < oab->oab_count; i++) {
+		oab->oab_tags[i] = IVAL(p, 12 + oab->hdr_count * 8 + i * 8);
+	}
+	ck_assert_int_eq(IVAL(p, 0), 12 + (oab->hdr_count + oab->oab_count) * 8);
+	p += IVAL(p, 0);
+
+	/* Header record, then recipient records */
+	p = _pull_record(p, end, oab->hdr_count, oab->hdr_tags, NULL, NULL);
+
+	oab->keys = talloc_array(mem_ctx, const char *, 0);
+	oab->display_names = talloc_array(mem_ctx, const char *, 0);
+	while (p < end) {
+		oab->keys = talloc_realloc(mem_ctx, oab->keys, const char *, oab->records + 1);
+		oab->display_names = talloc_realloc(mem_ctx, oab->display_names, const char *, oab->records + 1);
+		p = _pull_record(p, end, oab->oab_count, oab->oab_tags,
+				 &oab->keys[oab->records], &oab->display_names[oab->records]);
+		oab->records++;
+	}
+}
+
+static bool _file_exists(const char *filename)
+{
+	struct stat	st;
+	char		*path;
+	bool		ret;
+
+	path = talloc_asprintf(mem_ctx, "%s/%s", oab_path, filename);
+	ret = (stat(path, &st) == 0);
+	talloc_free(path);
+
+	return ret;
+}
+
+START_TEST (test_oab_params) {
+	struct emsabp_oab_stats	stats;
+	const char		*organization_name;
+
+	ck_assert_int_eq(emsabp_oab_generate(NULL, oab_path, &stats), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, NULL, &stats), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, NULL), MAPI_E_INVALID_PARAMETER);
+
+	organization_name = emsabp_ctx->organization_name;
+	emsabp_ctx->organization_name = NULL;
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, &stats), MAPI_E_NOT_INITIALIZED);
+	emsabp_ctx->organization_name = organization_name;
+
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, "/nonexistent/oab", &stats), MAPI_E_NO_ACCESS);
+	ck_assert(!_file_exists("data-1.oab"));
+} END_TEST
+
+START_TEST (test_oab_full) {
+	struct emsabp_oab_stats	stats;
+	struct oab_file		oab;
+	uint32_t		i;
+
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.sequence, 1);
+	ck_assert_int_eq(stats.records, OAB_TEST_USERS);
+	ck_assert_int_eq(stats.added + stats.modified + stats.deleted, 0);
+	ck_assert(_file_exists("data-1.oab"));
+	ck_assert(!_file_exists("changes-1.oab"));
+	ck_assert(_file_exists(EMSABP_OAB_STATE));
+
+	_parse_oab("data-1.oab", 12, &oab);
+	ck_assert_int_eq(oab.hdr[1], stats.serial);
+	ck_assert_int_eq(oab.hdr[1], oab.crc);
+	ck_assert_int_eq(oab.hdr[2], OAB_TEST_USERS);
+	ck_assert_int_eq(oab.records, OAB_TEST_USERS);
+	ck_assert_int_eq(oab.oab_tags[0], PidTagEmailAddress);
+
+	for (i = 0; i < oab.records; i++) {
+		ck_assert(oab.keys[i] != NULL);
+		ck_assert(strncmp(oab.keys[i], "/o=" OAB_ORGANIZATION "/", 3 + strlen(OAB_ORGANIZATION) + 1) == 0);
+		ck_assert(oab.display_names[i] != NULL);
+	}
+} END_TEST
+
+START_TEST (test_oab_changes) {
+	struct emsabp_oab_stats	stats;
+	struct emsabp_oab_stats	stats2;
+	struct ldb_message	*msg;
+	struct oab_file		oab;
+	struct oab_file		changes;
+	uint32_t		i;
+	bool			found;
+
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, &stats), MAPI_E_SUCCESS);
+
+	/* One of each change */
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new(msg, ldb_ctx, "CN=user00001,CN=Users," OAB_DOMAIN_DN);
+	ldb_msg_add_empty(msg, "displayName", LDB_FLAG_MOD_REPLACE, NULL);
+	ldb_msg_add_string(msg, "displayName", "Renamed User");
+	ck_assert_int_eq(ldb_modify(ldb_ctx, msg), LDB_SUCCESS);
+	ck_assert_int_eq(ldb_delete(ldb_ctx, ldb_dn_new(mem_ctx, ldb_ctx, "CN=user00002,CN=Users," OAB_DOMAIN_DN)),
+			 LDB_SUCCESS);
+	_add_user(OAB_TEST_USERS, "New User");
+
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, &stats2), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats2.sequence, 2);
+	ck_assert_int_eq(stats2.records, OAB_TEST_USERS);
+	ck_assert_int_eq(stats2.added, 1);
+	ck_assert_int_eq(stats2.modified, 1);
+	ck_assert_int_eq(stats2.deleted, 1);
+	ck_assert(stats2.serial != stats.serial);
+
+	/* Only the latest full details file is kept */
+	ck_assert(!_file_exists("data-1.oab"));
+	ck_assert(_file_exists("data-2.oab"));
+	ck_assert(_file_exists("changes-2.oab"));
+
+	_parse_oab("data-2.oab", 12, &oab);
+	ck_assert_int_eq(oab.hdr[1], oab.crc);
+	ck_assert_int_eq(oab.records, OAB_TEST_USERS);
+
+	_parse_oab("changes-2.oab", 28, &changes);
+	ck_assert_int_eq(changes.hdr[1], changes.crc);
+	ck_assert_int_eq(changes.hdr[2], 3);
+	ck_assert_int_eq(changes.hdr[3], stats.serial);
+	ck_assert_int_eq(changes.hdr[4], stats2.serial);
+	ck_assert_int_eq(changes.hdr[5], 2);
+	ck_assert_int_eq(changes.hdr[6], 1);
+	ck_assert_int_eq(changes.records, 3);
+
+	/* Deleted records come last with their key only */
+	ck_assert(strstr(changes.keys[2], "/cn=user00002") != NULL);
+	ck_assert(changes.display_names[2] == NULL);
+	for (found = false, i = 0; i < 2; i++) {
+		if (changes.display_names[i] && !strcmp(changes.display_names[i], "Renamed User")) found = true;
+	}
+	ck_assert(found);
+
+	/* Nothing changed since */
+	ck_assert_int_eq(emsabp_oab_generate(emsabp_ctx, oab_path, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.sequence, 3);
+	ck_assert_int_eq(stats.added + stats.modified + stats.deleted, 0);
+	_parse_oab("changes-3.oab", 28, &changes);
+	ck_assert_int_eq(changes.records, 0);
+} END_TEST
+
+static void tc_oab_setup(void)
+{
+	struct ldb_message	*msg;
+	uint32_t		i;
+	char			*display_name;
+
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_emsabp_oab_suite");
+
+	oab_path = talloc_strdup(mem_ctx, "/tmp/emsabp_oab_XXXXXX");
+	ck_assert(mkdtemp(oab_path) != NULL);
+	ldb_path = talloc_asprintf(mem_ctx, "%s.ldb", oab_path);
+
+	ldb_ctx = ldb_init(mem_ctx, NULL);
+	ck_assert(ldb_ctx != NULL);
+	ck_assert_int_eq(ldb_connect(ldb_ctx, ldb_path, 0, NULL), LDB_SUCCESS);
+	ldb_set_opaque(ldb_ctx, "defaultNamingContext", ldb_dn_new(ldb_ctx, ldb_ctx, OAB_DOMAIN_DN));
+	ldb_set_opaque(ldb_ctx, "configurationNamingContext", ldb_dn_new(ldb_ctx, ldb_ctx, OAB_CONFIG_DN));
+
+	ck_assert_int_eq(ldb_transaction_start(ldb_ctx), LDB_SUCCESS);
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new(msg, ldb_ctx, OAB_EXCHANGE_DN);
+	ldb_msg_add_string(msg, "objectClass", "msExchConfigurationContainer");
+	ldb_msg_add_string(msg, "globalAddressList", OAB_GAL_DN);
+	ck_assert_int_eq(ldb_add(ldb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new(msg, ldb_ctx, OAB_GAL_DN);
+	ldb_msg_add_string(msg, "objectClass", "addressBookContainer");
+	ldb_msg_add_string(msg, "displayName", "Default Global Address List");
+	ldb_msg_add_string(msg, "purportedSearch", "(&(objectClass=user)(displayName=*))");
+	ck_assert_int_eq(ldb_add(ldb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+
+	for (i = 0; i < OAB_TEST_USERS; i++) {
+		display_name = talloc_asprintf(mem_ctx, "User %05u", i);
+		_add_user(i, display_name);
+		talloc_free(display_name);
+	}
+	ck_assert_int_eq(ldb_transaction_commit(ldb_ctx), LDB_SUCCESS);
+
+	emsabp_ctx = talloc_zero(mem_ctx, struct emsabp_context);
+	emsabp_ctx->mem_ctx = emsabp_ctx;
+	emsabp_ctx->organization_name = OAB_ORGANIZATION;
+	emsabp_ctx->samdb_ctx = ldb_ctx;
+}
+
+static void tc_oab_teardown(void)
+{
+	DIR		*dir;
+	struct dirent	*dirent;
+
+	dir = opendir(oab_path);
+	if (dir) {
+		while ((dirent = readdir(dir))) {
+			if (dirent->d_name[0] == '.') continue;
+			unlink(talloc_asprintf(mem_ctx, "%s/%s", oab_path, dirent->d_name));
+		}
+		closedir(dir);
+	}
+	rmdir(oab_path);
+	unlink(ldb_path);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_oab_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsabp oab");
+
+	TCase *tc = tcase_create("emsabp_oab");
+	tcase_add_checked_fixture(tc, tc_oab_setup, tc_oab_teardown);
+
+	tcase_add_test(tc, test_oab_params);
+	tcase_add_test(tc, test_oab_full);
+	tcase_add_test(tc, test_oab_changes);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,370 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+#include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
+#include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
+
+#define	ASYNC_TEST_FID			0x10001
+#define	ASYNC_TEST_TIMEOUT		300
+#define	ASYNC_TEST_USER			"emsmdbp-async-testsuite"
+
+struct test_reply {
+	bool		replied;
+	uint32_t	flags;
+};
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct tevent_context		*ev;
+static struct mpm_session_registry	*registry;
+static uint32_t				replies;
+
+
+static void _test_reply(void *private_data, uint32_t flags)
+{
+	struct test_reply	*reply = (struct test_reply *) private_data;
+
+	ck_assert(!reply->replied);
+	reply->replied = true;
+	reply->flags = flags;
+	replies++;
+}
+
+/* A bare mapistore context with the subscription RegisterNotification
+ * creates for new messages of a folder */
+static struct mapistore_context *_make_mstore_ctx(TALLOC_CTX *ctx, uint64_t fid)
+{
+	struct mapistore_context			*mstore_ctx;
+	struct mapistore_subscription_list		*subscription_list;
+	struct mapistore_object_subscription_parameters	parameters;
+
+	mstore_ctx = talloc_zero(ctx, struct mapistore_context);
+	ck_assert(mstore_ctx != NULL);
+
+	parameters.whole_store = false;
+	parameters.folder_id = fid;
+	parameters.object_id = 0;
+
+	subscription_list = talloc_zero(mstore_ctx, struct mapistore_subscription_list);
+	ck_assert(subscription_list != NULL);
+	subscription_list->subscription = mapistore_new_subscription(subscription_list, mstore_ctx, ASYNC_TEST_USER,
+								     0x1, fnevObjectCreated, &parameters);
+	ck_assert(subscription_list->subscription != NULL);
+	DLIST_ADD(mstore_ctx->subscriptions, subscription_list);
+
+	return mstore_ctx;
+}
+
+/* A message saved from the session of mstore_ctx in a mailbox of
+ * username, as SaveChangesMessage reports it */
+static void _push_new_message(struct mapistore_context *mstore_ctx, const char *username,
+			      uint64_t fid, uint64_t mid)
+{
+	struct mapistore_object_notification_parameters	parameters;
+
+	memset(&parameters, 0, sizeof (parameters));
+	parameters.folder_id = fid;
+	parameters.object_id = mid;
+	emsmdbp_async_push_notification(mstore_ctx, username, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_CREATED, &parameters);
+}
+
+/* A newmail notification sent by the management interface */
+static void _send_newmail(const char *username, uint64_t fid, uint64_t mid)
+{
+	struct mapistore_mgmt_command	cmd;
+	enum ndr_err_code		ndr_err;
+	DATA_BLOB			data;
+	char				*mqueue_name;
+	mqd_t				mqfd;
+
+	memset(&cmd, 0, sizeof (cmd));
+	cmd.type = MAPISTORE_MGMT_NOTIF;
+	cmd.command.notification.status = MAPISTORE_MGMT_SEND;
+	cmd.command.notification.NotificationFlags = mgmt_notification_type_objectcreated | mgmt_notification_type_Mbit;
+	cmd.command.notification.FolderID = fid;
+	cmd.command.notification.MessageID = mid;
+	cmd.command.notification.MAPIStoreURI = "uri";
+	ndr_err = ndr_push_struct_blob(&data, mem_ctx, &cmd, (ndr_push_flags_fn_t)ndr_push_mapistore_mgmt_command);
+	ck_assert(NDR_ERR_CODE_IS_SUCCESS(ndr_err));
+
+	mqueue_name = talloc_asprintf(mem_ctx, MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
+	mqfd = mq_open(mqueue_name, O_WRONLY|O_NONBLOCK);
+	ck_assert(mqfd != (mqd_t)-1);
+	ck_assert_int_eq(mq_send(mqfd, (const char *)data.data, data.length, 0), 0);
+	mq_close(mqfd);
+}
+
+static void _loop_until_replies(uint32_t count)
+{
+	uint32_t	loops = 0;
+
+	while (replies < count) {
+		ck_assert_int_eq(tevent_loop_once(ev), 0);
+		ck_assert_int_lt(++loops, 1000000);
+	}
+}
+
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_async_sanity) {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply;
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	ck_assert(emsmdbp_async_init(mem_ctx, NULL, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT) == NULL);
+	ck_assert(emsmdbp_async_init(mem_ctx, mstore_ctx, NULL, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT) == NULL);
+	ck_assert(emsmdbp_async_init(mem_ctx, mstore_ctx, registry, NULL, ASYNC_TEST_TIMEOUT) == NULL);
+
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+	ck_assert(mpm_session_registry_find(registry, &async_ctx->uuid) == async_ctx);
+
+	ck_assert(emsmdbp_async_wait(mem_ctx, NULL, ev, _test_reply, &reply) == NULL);
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, NULL, _test_reply, &reply) == NULL);
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, ev, NULL, &reply) == NULL);
+	ck_assert_int_eq(async_ctx->wait_count, 0);
+
+	/* no parked wait, nothing to complete */
+	emsmdbp_async_complete(NULL, 0);
+	emsmdbp_async_complete(async_ctx, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+	ck_assert_int_eq(replies, 0);
+} END_TEST
+
+START_TEST (test_async_notification) {
+	struct mapistore_context	*mstore_ctx;
+	struct mapistore_context	*other_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply = { false, 0 };
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+	other_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, ev, _test_reply, &reply) != NULL);
+	ck_assert_int_eq(async_ctx->wait_count, 1);
+
+	/* messages created in another folder or another mailbox do not
+	 * complete the wait */
+	_push_new_message(other_ctx, ASYNC_TEST_USER, ASYNC_TEST_FID + 1, 0x20001);
+	_push_new_message(other_ctx, ASYNC_TEST_USER "2", ASYNC_TEST_FID, 0x20002);
+	ck_assert(!mapistore_notification_pending(mstore_ctx));
+	ck_assert(!reply.replied);
+
+	/* a message saved from another session of the owner does, the
+	 * reply being deferred to the event loop */
+	_push_new_message(other_ctx, ASYNC_TEST_USER, ASYNC_TEST_FID, 0x20003);
+	ck_assert(mapistore_notification_pending(mstore_ctx));
+	ck_assert(mapistore_notification_pending(other_ctx));
+	ck_assert(!reply.replied);
+
+	_loop_until_replies(1);
+	ck_assert(reply.replied);
+	ck_assert_int_eq(reply.flags, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+	ck_assert_int_eq(async_ctx->wait_count, 0);
+} END_TEST
+
+START_TEST (test_async_pending_before_wait) {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply = { false, 0 };
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+
+	_push_new_message(mstore_ctx, ASYNC_TEST_USER, ASYNC_TEST_FID, 0x20001);
+
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, ev, _test_reply, &reply) != NULL);
+	_loop_until_replies(1);
+	ck_assert_int_eq(reply.flags, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+} END_TEST
+
+START_TEST (test_async_timeout) {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply = { false, 0xffffffff };
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, 0);
+	ck_assert(async_ctx != NULL);
+
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, ev, _test_reply, &reply) != NULL);
+	_loop_until_replies(1);
+	ck_assert_int_eq(reply.flags, 0);
+	ck_assert_int_eq(async_ctx->wait_count, 0);
+} END_TEST
+
+START_TEST (test_async_release) {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct emsmdbp_async_wait	*wait;
+	struct test_reply		reply[2] = { { false, 0xffffffff }, { false, 0xffffffff } };
+	struct GUID			uuid;
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+	uuid = async_ctx->uuid;
+
+	/* releasing the call cancels the wait without reply */
+	wait = emsmdbp_async_wait(mem_ctx, async_ctx, ev, _test_reply, &reply[0]);
+	ck_assert(wait != NULL);
+	ck_assert(emsmdbp_async_wait(mem_ctx, async_ctx, ev, _test_reply, &reply[1]) != NULL);
+	ck_assert_int_eq(async_ctx->wait_count, 2);
+	talloc_free(wait);
+	ck_assert_int_eq(async_ctx->wait_count, 1);
+
+	/* releasing the session completes the remaining waits */
+	talloc_free(async_ctx);
+	ck_assert(!reply[0].replied);
+	ck_assert(reply[1].replied);
+	ck_assert_int_eq(reply[1].flags, 0);
+	ck_assert(mpm_session_registry_find(registry, &uuid) == NULL);
+	ck_assert(mstore_ctx->notification_callback == NULL);
+
+	/* notifications are still queued for the next EcDoRpc */
+	_push_new_message(mstore_ctx, ASYNC_TEST_USER, ASYNC_TEST_FID, 0x20001);
+	ck_assert(mapistore_notification_pending(mstore_ctx));
+	ck_assert_int_eq(replies, 1);
+} END_TEST
+
+/* EcDoAsyncWaitEx parked until another session of the owner saves a
+ * message in the subscribed folder */
+START_TEST (test_async_wait_handle) {
+	struct mapistore_context	*mstore_ctx;
+	struct mapistore_context	*other_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply = { false, 0xffffffff };
+	struct GUID			uuid;
+	uint32_t			flags;
+	bool				parked;
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+	other_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+
+	/* unknown async handle */
+	uuid = GUID_random();
+	ck_assert_int_eq(emsmdbp_async_wait_handle(mem_ctx, registry, &uuid, ev, _test_reply, &reply, &flags, &parked),
+			 ecRejected);
+	ck_assert(!parked);
+
+	/* calls which cannot be parked are replied immediately */
+	ck_assert_int_eq(emsmdbp_async_wait_handle(mem_ctx, registry, &async_ctx->uuid, NULL, _test_reply, &reply,
+						   &flags, &parked), MAPI_E_SUCCESS);
+	ck_assert(!parked);
+	ck_assert_int_eq(flags, 0);
+
+	ck_assert_int_eq(emsmdbp_async_wait_handle(mem_ctx, registry, &async_ctx->uuid, ev, _test_reply, &reply,
+						   &flags, &parked), MAPI_E_SUCCESS);
+	ck_assert(parked);
+	ck_assert_int_eq(async_ctx->wait_count, 1);
+
+	_push_new_message(other_ctx, ASYNC_TEST_USER, ASYNC_TEST_FID, 0x20001);
+	_loop_until_replies(1);
+	ck_assert_int_eq(reply.flags, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+
+	/* the notification is still pending until the next EcDoRpc */
+	ck_assert_int_eq(emsmdbp_async_wait_handle(mem_ctx, registry, &async_ctx->uuid, NULL, _test_reply, &reply,
+						   &flags, &parked), MAPI_E_SUCCESS);
+	ck_assert(!parked);
+	ck_assert_int_eq(flags, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+} END_TEST
+
+/* EcDoAsyncWaitEx parked until a newmail notification is received on
+ * the owner newmail queue */
+START_TEST (test_async_newmail) {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_reply		reply = { false, 0xffffffff };
+	uint32_t			flags;
+	bool				parked;
+
+	mstore_ctx = _make_mstore_ctx(mem_ctx, ASYNC_TEST_FID);
+	async_ctx = emsmdbp_async_init(mstore_ctx, mstore_ctx, registry, ASYNC_TEST_USER, ASYNC_TEST_TIMEOUT);
+	ck_assert(async_ctx != NULL);
+
+	ck_assert_int_eq(emsmdbp_async_wait_handle(mem_ctx, registry, &async_ctx->uuid, ev, _test_reply, &reply,
+						   &flags, &parked), MAPI_E_SUCCESS);
+	ck_assert(parked);
+	ck_assert(async_ctx->mq_newmail != (mqd_t)-1);
+
+	/* a newmail in another folder does not complete the wait */
+	_send_newmail(ASYNC_TEST_USER, ASYNC_TEST_FID + 1, 0x20001);
+	ck_assert_int_eq(tevent_loop_once(ev), 0);
+	ck_assert(!reply.replied);
+	ck_assert(!mapistore_notification_pending(mstore_ctx));
+
+	_send_newmail(ASYNC_TEST_USER, ASYNC_TEST_FID, 0x20002);
+	_loop_until_replies(1);
+	ck_assert_int_eq(reply.flags, EMSMDB_ASYNC_NOTIFICATION_PENDING);
+	ck_assert(mapistore_notification_pending(mstore_ctx));
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_async_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_emsmdbp_async_suite");
+	ev = tevent_context_init(mem_ctx);
+	ck_assert(ev != NULL);
+	registry = mpm_session_registry_init(mem_ctx);
+	ck_assert(registry != NULL);
+	replies = 0;
+}
+
+static void tc_async_teardown(void)
+{
+	char	*mqueue_name;
+
+	talloc_free(mem_ctx);
+
+	mqueue_name = talloc_asprintf(NULL, MAPISTORE_MQUEUE_NEWMAIL_FMT, ASYNC_TEST_USER);
+	mq_unlink(mqueue_name);
+	talloc_free(mqueue_name);
+}
+
+Suite *mapiproxy_emsmdbp_async_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsmdbp async");
+
+	TCase *tc = tcase_create("emsmdbp_async");
+	tcase_add_checked_fixture(tc, tc_async_setup, tc_async_teardown);
+
+	tcase_add_test(tc, test_async_sanity);
+	tcase_add_test(tc, test_async_notification);
+	tcase_add_test(tc, test_async_pending_before_wait);
+	tcase_add_test(tc, test_async_timeout);
+	tcase_add_test(tc, test_async_release);
+	tcase_add_test(tc, test_async_wait_handle);
+	tcase_add_test(tc, test_async_newmail);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
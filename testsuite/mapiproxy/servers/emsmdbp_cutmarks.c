@@ -0,0 +1,182 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+
+#define	CUTMARKS_LARGE_MESSAGES		2000
+#define	CUTMARKS_LARGE_PROPERTIES	30
+#define	CUTMARKS_LARGE_BUFFER_SIZE	0x8000
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct emsmdbp_cutmarks	*cutmarks;
+
+
+/* Build the cutmarks of a contents synchronization stream the way
+ * oxcfxics_push_messageChange does: markers around each message
+ * and property values of alternating fixed and variable sizes */
+static uint32_t _make_contents_sync_cutmarks(struct emsmdbp_cutmarks *marks, uint32_t messages, uint32_t properties)
+{
+	uint32_t	offset = 0;
+	uint32_t	i, j;
+
+	for (i = 0; i < messages; i++) {
+		offset += 4;
+		emsmdbp_cutmarks_push(marks, 0, offset);
+		for (j = 0; j < properties; j++) {
+			offset += 4;
+			emsmdbp_cutmarks_push(marks, 0, offset);
+			if (j % 2) {
+				offset += 8;
+				emsmdbp_cutmarks_push(marks, 0, offset);
+			}
+			else {
+				offset += 4 + ((i * 31 + j * 17) % 600);
+				emsmdbp_cutmarks_push(marks, 8, offset);
+			}
+		}
+		offset += 4;
+		emsmdbp_cutmarks_push(marks, 0, offset);
+	}
+
+	return offset;
+}
+
+/* The linear walk the index replaces */
+static uint32_t _linear_next_buffer_size(struct emsmdbp_cutmarks *marks, uint32_t *next, uint32_t position, uint32_t request_buffer_size)
+{
+	uint32_t	buffer_size = request_buffer_size;
+	uint32_t	mark_idx = *next;
+
+	while (mark_idx < marks->count && marks->marks[mark_idx].offset < position + request_buffer_size) {
+		if (marks->marks[mark_idx].offset > position) {
+			buffer_size = marks->marks[mark_idx].offset - position;
+		}
+		mark_idx++;
+	}
+	if (buffer_size < request_buffer_size && mark_idx < marks->count) {
+		if (marks->marks[mark_idx].min_value_size &&
+		    (request_buffer_size - buffer_size > marks->marks[mark_idx].min_value_size)) {
+			buffer_size = request_buffer_size;
+		}
+	}
+	*next = mark_idx;
+
+	return buffer_size;
+}
+
+START_TEST (test_cutmarks_sanity) {
+	ck_assert(!emsmdbp_cutmarks_push(NULL, 0, 0));
+	ck_assert_int_eq(emsmdbp_cutmarks_lookup(NULL, 0), 0);
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(NULL, 0, 100), 100);
+	ck_assert_int_eq(emsmdbp_cutmarks_lookup(cutmarks, 42), 0);
+	/* without cutmarks the stream can be cut anywhere */
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(cutmarks, 0, 100), 100);
+	emsmdbp_cutmarks_pop(cutmarks);
+	ck_assert_int_eq(cutmarks->count, 0);
+} END_TEST
+
+START_TEST (test_cutmarks_next_buffer_size) {
+	ck_assert(emsmdbp_cutmarks_push(cutmarks, 0, 4));
+	ck_assert(emsmdbp_cutmarks_push(cutmarks, 0, 8));
+	ck_assert(emsmdbp_cutmarks_push(cutmarks, 8, 60));
+	ck_assert(emsmdbp_cutmarks_push(cutmarks, 0, 64));
+	ck_assert(emsmdbp_cutmarks_push(cutmarks, 0, 72));
+
+	ck_assert_int_eq(emsmdbp_cutmarks_lookup(cutmarks, 8), 1);
+	ck_assert_int_eq(emsmdbp_cutmarks_lookup(cutmarks, 9), 2);
+	ck_assert_int_eq(emsmdbp_cutmarks_lookup(cutmarks, 73), 5);
+
+	/* the 52 bytes value does not fit and is too short to be split */
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(cutmarks, 0, 14), 8);
+	/* the remaining 14 bytes of the window are enough to split it */
+	cutmarks->next = 0;
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(cutmarks, 0, 22), 22);
+	/* a buffer ending exactly on a cutmark uses the full request */
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(cutmarks, 22, 38), 38);
+	ck_assert_int_eq(emsmdbp_cutmarks_next_buffer_size(cutmarks, 60, 10), 4);
+	ck_assert_int_eq(cutmarks->next, 4);
+} END_TEST
+
+START_TEST (test_cutmarks_rebase) {
+	uint32_t	i;
+
+	for (i = 1; i <= 10; i++) {
+		ck_assert(emsmdbp_cutmarks_push(cutmarks, i % 2 ? 0 : 8, i * 10));
+	}
+
+	emsmdbp_cutmarks_rebase(cutmarks, 35);
+	ck_assert_int_eq(cutmarks->count, 7);
+	ck_assert_int_eq(cutmarks->marks[0].offset, 5);
+	ck_assert_int_eq(cutmarks->marks[0].min_value_size, 8);
+	ck_assert_int_eq(cutmarks->marks[6].offset, 65);
+
+	emsmdbp_cutmarks_pop(cutmarks);
+	ck_assert_int_eq(cutmarks->count, 6);
+	emsmdbp_cutmarks_rebase(cutmarks, 55);
+	ck_assert_int_eq(cutmarks->count, 0);
+} END_TEST
+
+/* Replay the GetBuffer calls of a large contents synchronization and
+ * check the index against the linear walk */
+START_TEST (test_cutmarks_large_stream) {
+	uint32_t	length, position, buffer_size, linear_next;
+
+	length = _make_contents_sync_cutmarks(cutmarks, CUTMARKS_LARGE_MESSAGES, CUTMARKS_LARGE_PROPERTIES);
+
+	linear_next = 0;
+	for (position = 0; position + CUTMARKS_LARGE_BUFFER_SIZE < length; position += buffer_size) {
+		buffer_size = emsmdbp_cutmarks_next_buffer_size(cutmarks, position, CUTMARKS_LARGE_BUFFER_SIZE);
+		ck_assert_int_eq(buffer_size, _linear_next_buffer_size(cutmarks, &linear_next, position, CUTMARKS_LARGE_BUFFER_SIZE));
+		ck_assert_int_ne(buffer_size, 0);
+		ck_assert_int_eq(cutmarks->next, linear_next);
+	}
+} END_TEST
+
+static void tc_cutmarks_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_emsmdbp_cutmarks_suite");
+	cutmarks = emsmdbp_cutmarks_init(mem_ctx);
+	ck_assert(cutmarks != NULL);
+}
+
+static void tc_cutmarks_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_cutmarks_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsmdbp cutmarks");
+
+	TCase *tc = tcase_create("emsmdbp_cutmarks");
+	tcase_add_checked_fixture(tc, tc_cutmarks_setup, tc_cutmarks_teardown);
+
+	tcase_add_test(tc, test_cutmarks_sanity);
+	tcase_add_test(tc, test_cutmarks_next_buffer_size);
+	tcase_add_test(tc, test_cutmarks_rebase);
+	tcase_add_test(tc, test_cutmarks_large_stream);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
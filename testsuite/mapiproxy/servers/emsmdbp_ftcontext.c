@@ -0,0 +1,255 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+
+#define	FTCONTEXT_LONG_PROPERTIES	200
+#define	FTCONTEXT_LARGE_VALUE_SIZE	10000
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct emsmdbp_object_ftcontext	*ftcontext;
+
+
+/* The properties are PT_LONG values, except for PT_BINARY tags
+ * which carry a large value */
+static void _push_property(struct emsmdbp_ftcontext_producer *producer, struct emsmdbp_cutmarks *cutmarks, uint32_t i)
+{
+	enum MAPITAGS	*properties = producer->private_data;
+	TALLOC_CTX	*value_ctx;
+	DATA_BLOB	value;
+	uint32_t	j;
+
+	ndr_push_uint32(producer->ndr, NDR_SCALARS, properties[i]);
+	emsmdbp_cutmarks_push(cutmarks, 0, producer->ndr->offset);
+
+	if ((properties[i] & 0xffff) == PT_BINARY) {
+		value_ctx = talloc_new(NULL);
+		value = data_blob_talloc(value_ctx, NULL, FTCONTEXT_LARGE_VALUE_SIZE);
+		for (j = 0; j < value.length; j++) {
+			value.data[j] = j % 251;
+		}
+		ck_assert(emsmdbp_ftcontext_producer_push_value(producer, cutmarks, value_ctx, value, 8));
+	}
+	else {
+		ndr_push_uint32(producer->ndr, NDR_SCALARS, i);
+		emsmdbp_cutmarks_push(cutmarks, 0, producer->ndr->offset);
+	}
+}
+
+/* What _push_property serializes, at once */
+static DATA_BLOB _make_stream(enum MAPITAGS *properties, uint32_t count)
+{
+	struct ndr_push	*ndr;
+	DATA_BLOB	stream;
+	uint32_t	i, j;
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	for (i = 0; i < count; i++) {
+		ndr_push_uint32(ndr, NDR_SCALARS, properties[i]);
+		if ((properties[i] & 0xffff) == PT_BINARY) {
+			ndr_push_uint32(ndr, NDR_SCALARS, FTCONTEXT_LARGE_VALUE_SIZE);
+			for (j = 0; j < FTCONTEXT_LARGE_VALUE_SIZE; j++) {
+				ndr_push_uint8(ndr, NDR_SCALARS, j % 251);
+			}
+		}
+		else {
+			ndr_push_uint32(ndr, NDR_SCALARS, i);
+		}
+	}
+	stream.data = ndr->data;
+	stream.length = ndr->offset;
+
+	return stream;
+}
+
+static void _init_producer(enum MAPITAGS *properties, uint32_t count)
+{
+	ftcontext->producer = emsmdbp_ftcontext_producer_init(ftcontext, count, _push_property, properties);
+	ck_assert(ftcontext->producer != NULL);
+}
+
+/* What FastTransferSourceGetBuffer does with a producer */
+static DATA_BLOB _get_buffer(uint32_t request_buffer_size)
+{
+	DATA_BLOB	buffer;
+	uint32_t	buffer_size = request_buffer_size;
+
+	emsmdbp_ftcontext_producer_fill(ftcontext, request_buffer_size);
+	if (ftcontext->stream.position + request_buffer_size < ftcontext->stream.buffer.length) {
+		buffer_size = emsmdbp_cutmarks_next_buffer_size(ftcontext->cutmarks, ftcontext->stream.position, request_buffer_size);
+	}
+	if (buffer_size > ftcontext->stream.buffer.length - ftcontext->stream.position) {
+		buffer_size = ftcontext->stream.buffer.length - ftcontext->stream.position;
+	}
+
+	buffer.data = ftcontext->stream.buffer.data + ftcontext->stream.position;
+	buffer.length = buffer_size;
+	ftcontext->stream.position += buffer_size;
+
+	return buffer;
+}
+
+/* Replay the GetBuffer calls until the end of the stream and check
+ * the window never grows much past two client buffers */
+static uint32_t _get_all_buffers(uint32_t request_buffer_size, DATA_BLOB *received)
+{
+	DATA_BLOB	buffer;
+	uint32_t	calls = 0;
+
+	*received = data_blob_talloc(mem_ctx, NULL, 0);
+	do {
+		buffer = _get_buffer(request_buffer_size);
+		ck_assert(buffer.length > 0);
+		ck_assert(buffer.length <= request_buffer_size);
+		ck_assert(ftcontext->stream.buffer.length <= 2 * request_buffer_size + 12);
+		ck_assert(data_blob_append(mem_ctx, received, buffer.data, buffer.length));
+		calls++;
+	} while (ftcontext->stream.position < ftcontext->stream.buffer.length ||
+		 ftcontext->producer->pending_length ||
+		 ftcontext->producer->next_property < ftcontext->producer->count);
+
+	return calls;
+}
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_ftcontext_sanity) {
+	DATA_BLOB	value = data_blob_null;
+
+	ck_assert(emsmdbp_ftcontext_producer_init(mem_ctx, 1, NULL, NULL) == NULL);
+	ck_assert(!emsmdbp_ftcontext_producer_push_value(NULL, NULL, NULL, value, 8));
+	emsmdbp_ftcontext_producer_fill(NULL, 100);
+
+	/* a context without properties produces an empty stream */
+	_init_producer(NULL, 0);
+	emsmdbp_ftcontext_producer_fill(ftcontext, 100);
+	ck_assert_int_eq(ftcontext->stream.buffer.length, 0);
+	ck_assert_int_eq(ftcontext->cutmarks->count, 0);
+} END_TEST
+
+START_TEST (test_ftcontext_window) {
+	enum MAPITAGS	properties[FTCONTEXT_LONG_PROPERTIES];
+	DATA_BLOB	buffer, expected, received;
+	uint32_t	i;
+
+	for (i = 0; i < FTCONTEXT_LONG_PROPERTIES; i++) {
+		properties[i] = PROP_TAG(PT_LONG, 0x6600 + i);
+	}
+	_init_producer(properties, FTCONTEXT_LONG_PROPERTIES);
+	expected = _make_stream(properties, FTCONTEXT_LONG_PROPERTIES);
+
+	/* the window holds a little more than two buffers, the first
+	 * buffer ends on the last cutmark that fits */
+	buffer = _get_buffer(100);
+	ck_assert_int_eq(ftcontext->stream.buffer.length, 208);
+	ck_assert_int_eq(ftcontext->cutmarks->count, 52);
+	ck_assert_int_eq(buffer.length, 96);
+	ck_assert(memcmp(buffer.data, expected.data, buffer.length) == 0);
+
+	/* the unsent bytes and their cutmarks move to the start of the window */
+	buffer = _get_buffer(100);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[0].offset, 4);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[1].offset, 8);
+	ck_assert(memcmp(ftcontext->stream.buffer.data, expected.data + 96, 112) == 0);
+	ck_assert_int_eq(IVAL(ftcontext->stream.buffer.data, 0), properties[12]);
+	ck_assert_int_eq(ftcontext->stream.buffer.length, 208);
+	ck_assert_int_eq(buffer.length, 96);
+	ck_assert(memcmp(buffer.data, expected.data + 96, buffer.length) == 0);
+
+	/* the following buffers carry the rest of the stream */
+	_get_all_buffers(100, &received);
+	ck_assert_int_eq(received.length, expected.length - 192);
+	ck_assert(memcmp(received.data, expected.data + 192, received.length) == 0);
+} END_TEST
+
+START_TEST (test_ftcontext_large_value) {
+	enum MAPITAGS	properties[] = { PidTagImportance, PidTagRtfCompressed, PidTagMessageFlags };
+	DATA_BLOB	buffer, expected, received;
+	uint32_t	calls;
+
+	_init_producer(properties, 3);
+	expected = _make_stream(properties, 3);
+
+	/* the value is only copied up to the end of the window, which
+	 * ends on a provisional cutmark */
+	buffer = _get_buffer(1000);
+	ck_assert_int_eq(ftcontext->stream.buffer.length, 2001);
+	ck_assert_int_eq(ftcontext->producer->pending_length, FTCONTEXT_LARGE_VALUE_SIZE - (2001 - 16));
+	ck_assert(ftcontext->producer->pending_ctx != NULL);
+	ck_assert_int_eq(ftcontext->cutmarks->count, 4);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[2].offset, 12);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[3].offset, 2001);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[3].min_value_size, 8);
+	/* and the value is split instead of sent alone */
+	ck_assert_int_eq(buffer.length, 1000);
+	ck_assert(memcmp(buffer.data, expected.data, buffer.length) == 0);
+
+	/* the provisional cutmark is replaced at the end of the next window */
+	buffer = _get_buffer(1000);
+	ck_assert_int_eq(ftcontext->cutmarks->count, 1);
+	ck_assert_int_eq(ftcontext->cutmarks->marks[0].offset, 2001);
+	ck_assert_int_eq(buffer.length, 1000);
+	ck_assert(memcmp(buffer.data, expected.data + 1000, buffer.length) == 0);
+
+	calls = _get_all_buffers(1000, &received);
+	ck_assert(calls > 5);
+	ck_assert_int_eq(received.length, expected.length - 2000);
+	ck_assert(memcmp(received.data, expected.data + 2000, received.length) == 0);
+
+	/* the value is released once copied */
+	ck_assert(ftcontext->producer->pending_ctx == NULL);
+	ck_assert(ftcontext->producer->pending_data == NULL);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_ftcontext_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "mapiproxy_emsmdbp_ftcontext_suite");
+	ftcontext = talloc_zero(mem_ctx, struct emsmdbp_object_ftcontext);
+	ck_assert(ftcontext != NULL);
+	ftcontext->cutmarks = emsmdbp_cutmarks_init(ftcontext);
+	ck_assert(ftcontext->cutmarks != NULL);
+}
+
+static void tc_ftcontext_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_ftcontext_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsmdbp ftcontext");
+
+	TCase *tc = tcase_create("emsmdbp_ftcontext");
+	tcase_add_checked_fixture(tc, tc_ftcontext_setup, tc_ftcontext_teardown);
+
+	tcase_add_test(tc, test_ftcontext_sanity);
+	tcase_add_test(tc, test_ftcontext_window);
+	tcase_add_test(tc, test_ftcontext_large_value);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
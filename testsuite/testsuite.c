@@ -101,19 +101,38 @@ int main(int argc, const char *argv[])
 
 	/* libmapi */
 	srunner_add_suite(sr, libmapi_property_suite());
+	srunner_add_suite(sr, libmapi_lzxpress_suite());
+	srunner_add_suite(sr, libmapi_lzfu_suite());
+	srunner_add_suite(sr, libmapi_idset_suite());
+	srunner_add_suite(sr, libmapi_mapi_batch_suite());
+	srunner_add_suite(sr, libmapi_emsmdb_suite());
+	srunner_add_suite(sr, libmapi_property_tags_suite());
+	/* libexchange2ical */
+	srunner_add_suite(sr, libexchange2ical_sync_suite());
 	/* libmapiproxy */
 	srunner_add_suite(sr, mapiproxy_openchangedb_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_ldb_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_multitenancy_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_logger_suite());
+	srunner_add_suite(sr, mapiproxy_openchangedb_cache_suite());
+	srunner_add_suite(sr, mapiproxy_session_registry_suite());
+	srunner_add_suite(sr, mapiproxy_mapi_handles_suite());
 	/* libmapistore */
 	srunner_add_suite(sr, mapistore_namedprops_suite());
 	srunner_add_suite(sr, mapistore_namedprops_mysql_suite());
 	srunner_add_suite(sr, mapistore_namedprops_tdb_suite());
 	srunner_add_suite(sr, mapistore_indexing_mysql_suite());
 	srunner_add_suite(sr, mapistore_indexing_tdb_suite());
+	srunner_add_suite(sr, mapistore_processing_suite());
+	srunner_add_suite(sr, mapistore_backend_suite());
+	srunner_add_suite(sr, mapistore_mgmt_suite());
 	/* mapiproxy */
 	srunner_add_suite(sr, mapiproxy_util_mysql_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_cutmarks_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_ftcontext_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_async_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_gal_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_oab_suite());
 
 	srunner_run_all(sr, CK_NORMAL);
 	nf = srunner_ntests_failed(sr);
@@ -45,19 +45,38 @@ __BEGIN_DECLS
 
 /* libmapi */
 Suite *libmapi_property_suite(void);
+Suite *libmapi_lzxpress_suite(void);
+Suite *libmapi_lzfu_suite(void);
+Suite *libmapi_idset_suite(void);
+Suite *libmapi_mapi_batch_suite(void);
+Suite *libmapi_emsmdb_suite(void);
+Suite *libmapi_property_tags_suite(void);
+/* libexchange2ical */
+Suite *libexchange2ical_sync_suite(void);
 /* libmapiproxy */
 Suite *mapiproxy_openchangedb_mysql_suite(void);
 Suite *mapiproxy_openchangedb_ldb_suite(void);
 Suite *mapiproxy_openchangedb_multitenancy_mysql_suite(void);
 Suite *mapiproxy_openchangedb_logger_suite(void);
+Suite *mapiproxy_openchangedb_cache_suite(void);
+Suite *mapiproxy_session_registry_suite(void);
+Suite *mapiproxy_mapi_handles_suite(void);
 /* libmapistore */
 Suite *mapistore_namedprops_suite(void);
 Suite *mapistore_namedprops_mysql_suite(void);
 Suite *mapistore_namedprops_tdb_suite(void);
 Suite *mapistore_indexing_mysql_suite(void);
 Suite *mapistore_indexing_tdb_suite(void);
+Suite *mapistore_processing_suite(void);
+Suite *mapistore_backend_suite(void);
+Suite *mapistore_mgmt_suite(void);
 /* mapiproxy */
 Suite *mapiproxy_util_mysql_suite(void);
+Suite *mapiproxy_emsmdbp_cutmarks_suite(void);
+Suite *mapiproxy_emsmdbp_ftcontext_suite(void);
+Suite *mapiproxy_emsmdbp_async_suite(void);
+Suite *mapiproxy_emsabp_gal_suite(void);
+Suite *mapiproxy_emsabp_oab_suite(void);
 
 __END_DECLS
 
@@ -54,6 +54,66 @@ static char* read_stream(char *s, size_t size, void *d)
   return c;
 }
 
+static int write_component(icalcomponent *vcal, void *private_data)
+{
+	FILE	*fp = (FILE *) private_data;
+	char	*cal;
+	int	ret;
+
+	cal = icalcomponent_as_ical_string_r(vcal);
+	if (!cal) return -1;
+	ret = (fputs(cal, fp) < 0);
+	free(cal);
+
+	return ret;
+}
+
+static bool read_state(TALLOC_CTX *mem_ctx, const char *filename, DATA_BLOB *state)
+{
+	FILE	*fp;
+	long	size;
+	bool	ret;
+
+	*state = data_blob_null;
+	if ((fp = fopen(filename, "r")) == NULL) {
+		/* first synchronization */
+		return (errno == ENOENT);
+	}
+
+	ret = (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0);
+	if (ret && size) {
+		*state = data_blob_talloc(mem_ctx, NULL, size);
+		ret = (fread(state->data, size, 1, fp) == 1);
+	}
+	fclose(fp);
+
+	return ret;
+}
+
+static bool write_state(TALLOC_CTX *mem_ctx, const char *filename, DATA_BLOB *state)
+{
+	FILE	*fp;
+	char	*tmp;
+	bool	ret;
+
+	/* never leave a truncated state behind */
+	tmp = talloc_asprintf(mem_ctx, "%s.tmp", filename);
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		talloc_free(tmp);
+		return false;
+	}
+	ret = (fwrite(state->data, state->length, 1, fp) == 1);
+	ret = (fclose(fp) == 0) && ret;
+	if (ret) {
+		ret = (rename(tmp, filename) == 0);
+	} else {
+		unlink(tmp);
+	}
+	talloc_free(tmp);
+
+	return ret;
+}
+
 int main(int argc, const char *argv[])
 {
 	enum MAPISTATUS			retval;
@@ -68,6 +128,7 @@ int main(int argc, const char *argv[])
 	const char			*opt_filename = NULL;
 	const char			*opt_icalsync = NULL;
 	const char			*opt_range = NULL;
+	const char			*opt_state = NULL;
 	bool				opt_dumpdata = false;
 	FILE 	 			*fp = NULL;
 	mapi_id_t			fid;
@@ -80,10 +141,12 @@ int main(int argc, const char *argv[])
 	icalcomponent			*ical;
 	icalcomponent			*vevent;
 	TALLOC_CTX			*mem_ctx;
+	DATA_BLOB			state;
+	int				ret = 0;
 
 	
 
-	enum { OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_DEBUG, OPT_DUMPDATA, OPT_FILENAME, OPT_RANGE, OPT_ICALSYNC };
+	enum { OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_DEBUG, OPT_DUMPDATA, OPT_FILENAME, OPT_RANGE, OPT_ICALSYNC, OPT_STATE };
 
 	struct poptOption long_options[] = {
 		POPT_AUTOHELP
@@ -93,6 +156,7 @@ int main(int argc, const char *argv[])
 		{ "icalsync", 	'i', POPT_ARG_STRING, NULL, OPT_ICALSYNC,	"set the icalendar to convert to exchange",	NULL },
 		{ "filename",	'o', POPT_ARG_STRING, NULL, OPT_FILENAME,	"set the output iCalendar filename",		NULL },
 		{ "range",	'R', POPT_ARG_STRING, NULL, OPT_RANGE,		"set the range of accepted start dates", 	NULL },
+		{ "state",	's', POPT_ARG_STRING, NULL, OPT_STATE,		"only export the changes since the state saved in this file", NULL },
 		{ "debuglevel",	'd', POPT_ARG_STRING, NULL, OPT_DEBUG,		"set the debug level",				NULL },
 		{ "dump-data",	  0, POPT_ARG_NONE,   NULL, OPT_DUMPDATA,	"dump the hex data",				NULL },
 		POPT_OPENCHANGE_VERSION
@@ -116,6 +180,9 @@ int main(int argc, const char *argv[])
 		case OPT_RANGE:
 			opt_range = poptGetOptArg(pc);
 			break;
+		case OPT_STATE:
+			opt_state = poptGetOptArg(pc);
+			break;
 		case OPT_PROFILE:
 			opt_profname = poptGetOptArg(pc);
 			break;
@@ -207,7 +274,31 @@ int main(int argc, const char *argv[])
 		}
 	}
 	
-	if(opt_range){
+	if (opt_state) {
+		/* Incremental export, written out one appointment at a time */
+		if (!read_state(mem_ctx, opt_state, &state)) {
+			perror("Can not read the synchronization state");
+			exit (1);
+		}
+		if (!opt_filename) {
+			fp = stdout;
+		} else if ((fp = fopen(opt_filename, "w")) == NULL) {
+			perror("fopen");
+			exit (1);
+		}
+		retval = Exchange2IcalSync(mem_ctx, &obj_folder, &state, write_component, fp);
+		if (fp != stdout) {
+			fclose(fp);
+		}
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_errstr("Exchange2IcalSync", retval);
+			ret = 1;
+		} else if (!write_state(mem_ctx, opt_state, &state)) {
+			perror("Can not save the synchronization state");
+			ret = 1;
+		}
+		vcal = NULL;
+	} else if(opt_range){
 		getRange(opt_range, &start, &end);
 		vcal = Exchange2IcalRange(&obj_folder, &start, &end);
 	} else {
@@ -242,7 +333,7 @@ int main(int argc, const char *argv[])
 	MAPIUninitialize(mapi_ctx);
 	talloc_free(mem_ctx);	
 
-	return 0;
+	return ret;
 }
 
 
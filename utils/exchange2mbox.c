@@ -37,6 +37,7 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "libmapi/fxics.h"
 #include "openchange-tools.h"
 
 /* Ugly and lazy but working ... */
@@ -56,6 +57,15 @@
  */
 #define	MAX_READ_SIZE	12000
 
+/* number of messages opened and read per round trip */
+#define	EXPORT_BATCH_SIZE	32
+
+/* bytes encoded on a single base64 line */
+#define	BASE64_LINE_BYTES	57
+
+/* profile attribute storing the ICS state of a folder */
+#define	ICS_STATE_ATTR		"IcsState-%"PRIx64
+
 static int message_error = 0;	/* did we get an error processing message */
 
 static bool opt_test = false;
@@ -100,6 +110,128 @@ static char *find_header(char *cp, char *hdr)
 }
 
 
+/*
+ * Message-ID index, so that each message of the mailbox can be
+ * looked up without scanning the whole profile
+ */
+
+struct msgid_entry {
+	struct msgid_entry	*next;
+	char			*msgid;
+};
+
+struct msgid_index {
+	struct msgid_entry	**buckets;
+	uint32_t		size;
+	uint32_t		count;
+};
+
+static uint32_t msgid_hash(const char *msgid)
+{
+	uint32_t hash = 2166136261U;
+
+	for (; *msgid; msgid++) {
+		hash = (hash ^ (unsigned char)*msgid) * 16777619U;
+	}
+	return hash;
+}
+
+static struct msgid_index *msgid_index_init(TALLOC_CTX *mem_ctx, uint32_t count)
+{
+	struct msgid_index *idx;
+
+	idx = talloc_zero(mem_ctx, struct msgid_index);
+	if (!idx) return NULL;
+
+	for (idx->size = 1024; idx->size < count * 2; idx->size <<= 1);
+	idx->buckets = talloc_zero_array(idx, struct msgid_entry *, idx->size);
+	if (!idx->buckets) {
+		talloc_free(idx);
+		return NULL;
+	}
+
+	return idx;
+}
+
+static bool msgid_index_find(struct msgid_index *idx, const char *msgid)
+{
+	struct msgid_entry *entry;
+
+	for (entry = idx->buckets[msgid_hash(msgid) & (idx->size - 1)]; entry; entry = entry->next) {
+		if (!strcmp(entry->msgid, msgid)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void msgid_index_add(struct msgid_index *idx, const char *msgid)
+{
+	struct msgid_entry	**buckets;
+	struct msgid_entry	*entry;
+	struct msgid_entry	*next;
+	uint32_t		bucket;
+	uint32_t		i;
+
+	if (msgid_index_find(idx, msgid)) return;
+
+	/* keep chains short by doubling the table once it is full */
+	if (idx->count >= idx->size) {
+		buckets = talloc_zero_array(idx, struct msgid_entry *, idx->size * 2);
+		if (buckets) {
+			for (i = 0; i < idx->size; i++) {
+				for (entry = idx->buckets[i]; entry; entry = next) {
+					next = entry->next;
+					bucket = msgid_hash(entry->msgid) & (idx->size * 2 - 1);
+					entry->next = buckets[bucket];
+					buckets[bucket] = entry;
+				}
+			}
+			talloc_free(idx->buckets);
+			idx->buckets = buckets;
+			idx->size *= 2;
+		}
+	}
+
+	entry = talloc_zero(idx, struct msgid_entry);
+	if (!entry) return;
+	entry->msgid = talloc_strdup(entry, msgid);
+
+	bucket = msgid_hash(msgid) & (idx->size - 1);
+	entry->next = idx->buckets[bucket];
+	idx->buckets[bucket] = entry;
+	idx->count++;
+}
+
+/**
+ * Load the Message-IDs stored in the profile, in a single ldb search
+ */
+static struct msgid_index *msgid_index_load(TALLOC_CTX *mem_ctx, struct mapi_profile *profile)
+{
+	enum MAPISTATUS		retval;
+	struct msgid_index	*idx;
+	char			**prof_msgids = NULL;
+	unsigned int		count = 0;
+	unsigned int		i;
+
+	retval = GetProfileAttr(profile, "Message-ID", &count, &prof_msgids);
+	if (retval != MAPI_E_SUCCESS) {
+		count = 0;
+	}
+
+	idx = msgid_index_init(mem_ctx, count);
+	if (!idx) return NULL;
+
+	for (i = 0; i < count; i++) {
+		msgid_index_add(idx, prof_msgids[i]);
+	}
+	if (prof_msgids) {
+		talloc_free(prof_msgids);
+	}
+
+	return idx;
+}
+
 /**
  * delete a message on the exchange server
  */
@@ -116,7 +248,9 @@ static bool delete_messages(
 	mapi_id_t		id_inbox;
 	struct SPropTagArray	*SPropTagArray;
 	struct SRowSet		SRowSet;
-	uint32_t		i, j;
+	struct msgid_index	*del_index;
+	uint32_t		i;
+	int			j;
 	uint64_t		id_message;
 	struct mapi_profile	*profile;
 
@@ -126,6 +260,12 @@ static bool delete_messages(
 
 	profile = session->profile;
 
+	del_index = msgid_index_init(mem_ctx, del_count);
+	if (!del_index) return false;
+	for (j = 0; j < del_count; j++) {
+		msgid_index_add(del_index, del_msgid[j]);
+	}
+
 	/* Open the default message store */
 	mapi_object_init(&obj_store);
 	retval = OpenMsgStore(session, &obj_store);
@@ -153,7 +293,7 @@ static bool delete_messages(
 	if (retval != MAPI_E_SUCCESS)
 		return false;
 
-	while ((retval = QueryRows(&obj_table, 0xa, TBL_ADVANCE, &SRowSet)) == MAPI_E_SUCCESS) {
+	while ((retval = QueryRows(&obj_table, 0x100, TBL_ADVANCE, &SRowSet)) == MAPI_E_SUCCESS) {
 		if (!SRowSet.cRows)
 			break;
 
@@ -162,31 +302,28 @@ static bool delete_messages(
 
 			message_id = (const char *)find_SPropValue_data(&(SRowSet.aRow[i]), PR_INTERNET_MESSAGE_ID);
 
-			if (!message_id)
+			if (!message_id || !msgid_index_find(del_index, message_id))
 				continue;
 
-			for (j = 0; j < del_count; j++) {
-				if (strcmp(message_id, del_msgid[j]) == 0) {
-					id_message = SRowSet.aRow[i].lpProps[1].value.d;
-					retval = DeleteMessage(&obj_inbox, &id_message, 1);
-					if (retval == MAPI_E_SUCCESS) {
-						printf("%s deleted from the Exchange server\n",
-								del_msgid[j]);
-						retval =
-						mapi_profile_delete_string_attr(profile->mapi_ctx,
-								profile->profname, "Message-ID", del_msgid[j]);
-						if (retval)
-							printf("%s not deleted from profile %s: err=0x%x\n",
-									del_msgid[j], profile->profname, retval);
-					} else {
-						printf("%s NOT deleted from the Exchange server\n",
-								del_msgid[j]);
-					}
-				}
+			id_message = SRowSet.aRow[i].lpProps[1].value.d;
+			retval = DeleteMessage(&obj_inbox, &id_message, 1);
+			if (retval == MAPI_E_SUCCESS) {
+				printf("%s deleted from the Exchange server\n",
+						message_id);
+				retval =
+				mapi_profile_delete_string_attr(profile->mapi_ctx,
+						profile->profname, "Message-ID", message_id);
+				if (retval)
+					printf("%s not deleted from profile %s: err=0x%x\n",
+							message_id, profile->profname, retval);
+			} else {
+				printf("%s NOT deleted from the Exchange server\n",
+						message_id);
 			}
 		}
 	}
 	
+	talloc_free(del_index);
 	mapi_object_release(&obj_table);
 	mapi_object_release(&obj_inbox);
 	mapi_object_release(&obj_store);
@@ -210,18 +347,23 @@ static uint32_t update(
 #endif
 	const char		*msgid;
 	char     		*id;
-	char			**mbox_msgids;
+	struct msgid_index	*mbox_index;
+	struct msgid_index	*prof_index;
 	char			**prof_msgids;
 	unsigned int		mbox_count = 0;
 	unsigned int		count;
-	unsigned int		i, j;
-	bool			found = false;
+	unsigned int		i;
 	char			**del_msgids;
 	unsigned int		del_count = 0;
 
 	profile = session->profile;
 
-	mbox_msgids = talloc_zero(mem_ctx, char *);
+	prof_index = msgid_index_load(mem_ctx, profile);
+	mbox_index = msgid_index_init(mem_ctx, prof_index ? prof_index->count : 0);
+	if (!prof_index || !mbox_index) {
+		return MAPI_E_NOT_ENOUGH_MEMORY;
+	}
+
 	/* Add Message-ID attribute to the profile if it is missing */
 #if defined(__FreeBSD__)
 	while ((line = fgetln(fp, &read_size)) != NULL) {
@@ -233,12 +375,10 @@ static uint32_t update(
 			id = talloc_strdup(mem_ctx, msgid + strlen(MESSAGEID));
 			id[strlen(id) - 1] = 0;
 
-			mbox_msgids = talloc_realloc(mem_ctx, mbox_msgids, char *, mbox_count + 2);
-			mbox_msgids[mbox_count] = talloc_strdup(mem_ctx, id);
+			msgid_index_add(mbox_index, id);
 			mbox_count++;
 
-			retval = FindProfileAttr(profile, "Message-ID", id);
-			if (GetLastError() == MAPI_E_NOT_FOUND) {
+			if (!msgid_index_find(prof_index, id)) {
 				errno = 0;
 				printf("[+] Adding %s to %s\n", id, profile->profname);
 				retval = mapi_profile_add_string_attr(profile->mapi_ctx, profile->profname, "Message-ID", id);
@@ -250,6 +390,7 @@ static uint32_t update(
 #endif
 					return -1;
 				}
+				msgid_index_add(prof_index, id);
 			}
 			talloc_free(id);
 		}
@@ -277,13 +418,7 @@ static uint32_t update(
 		del_count = 0;
 
 		for (i = 0; i < count; i++) {
-			found = false;
-			for (j = 0; j < mbox_count; j++) {
-				if (!strcmp(prof_msgids[i], mbox_msgids[j])) {
-					found = true;
-				}
-			}
-			if (found == false) {
+			if (!msgid_index_find(mbox_index, prof_msgids[i])) {
 				del_msgids = talloc_realloc(mem_ctx, del_msgids, char *, del_count + 2);
 				del_msgids[del_count] = talloc_strdup(mem_ctx, prof_msgids[i]);
 				del_count++;
@@ -299,7 +434,8 @@ static uint32_t update(
 	}
 
 	talloc_free(prof_msgids);
-	talloc_free(mbox_msgids);
+	talloc_free(mbox_index);
+	talloc_free(prof_index);
 
 	return MAPI_E_SUCCESS;
 }
@@ -317,100 +453,105 @@ static const char *get_filename(const char *filename)
 }
 
 
-static char *get_base64_attachment(TALLOC_CTX *mem_ctx, mapi_object_t *obj_attach, const uint32_t size, char **magic)
+#define WRAP_LINES_AT	76
+
+static void write_base64_data(FILE *fp, const char *buf)
+{
+	int len = strlen(buf);
+	size_t n;
+
+	while (len > 0) {
+		int chunk = len > WRAP_LINES_AT ? WRAP_LINES_AT : len;
+
+		n = fwrite(buf, len > WRAP_LINES_AT ? WRAP_LINES_AT : len, 1, fp);
+		if (n != 1)
+			fprintf(stderr, "Error writing %d bytes of base64 attachment: %d\n",
+				chunk, ferror(fp));
+		len -= chunk;
+		buf += chunk;
+		fwrite("\n", 1, 1, fp);
+	}
+}
+
+/*
+ * Stream an attachment into the mbox as a base64 MIME part, one
+ * ReadStream chunk at a time, instead of loading it whole first. The
+ * part headers are written once the first chunk is read, so that the
+ * mime type can be guessed from it when the attachment has none.
+ */
+static bool write_base64_attachment(TALLOC_CTX *mem_ctx, FILE *fp, mapi_object_t *obj_attach,
+				    const char *attach_filename, const char *mime_tag, int base_level)
 {
 	enum MAPISTATUS	retval;
-	const char     	*tmp;
-	char            *ret;
 	mapi_object_t	obj_stream;
-	uint32_t	stream_size;
-	uint16_t	read_size;
-	DATA_BLOB	data;
+	uint8_t		buf[MAX_READ_SIZE + BASE64_LINE_BYTES];
+	uint32_t	pending = 0;
+	uint32_t	encode_size;
+	uint16_t	read_size = 0;
+	char		*magic = NULL;
+	char		*data;
+	bool		header_done = false;
 	magic_t		cookie = NULL;
 
 	mapi_object_init(&obj_stream);
 	retval = OpenStream(obj_attach, PR_ATTACH_DATA_BIN, 0, &obj_stream);
 	if (retval != MAPI_E_SUCCESS) {
 		fprintf(stderr, "OpenStream failed %x\n", retval);
-		return NULL;
+		return false;
 	}
 
-	data.length = 0;
-	data.data = talloc_zero_size(mem_ctx, size);
-
-	for (stream_size = 0; stream_size < size; ) {
+	do {
 		/*
 		 * exchange can only handle about 4K chunks at a time,  and don't
 		 * ask for more or you get none
 		 */
-		retval = ReadStream(&obj_stream, data.data + stream_size,
-				(stream_size + MAX_READ_SIZE < size) ? MAX_READ_SIZE :
-					(size - stream_size), &read_size);
-		if ((retval != MAPI_E_SUCCESS) || read_size == 0)
+		retval = ReadStream(&obj_stream, buf + pending, MAX_READ_SIZE, &read_size);
+		if (retval != MAPI_E_SUCCESS) {
+			fprintf(stderr, "ReadStream failed retval=%x\n", retval);
 			break;
-		stream_size += read_size;
-	}
-	if (retval != MAPI_E_SUCCESS) {
-		fprintf(stderr, "ReadStream failed retval=%x read_size=%d "
-		                "stream_size=%d size=%d\n",
-						retval, read_size, stream_size, size);
-		talloc_free(data.data);
-		mapi_object_release(&obj_stream);
-		return NULL;
-	}
-
-	data.length = stream_size;
-
-	if (magic) {
-		/* if they want a mime magic string try and autodetect one */
-		cookie = magic_open(MAGIC_MIME);
-		if (cookie == NULL) {
-			fprintf(stderr, "%s,%d - NULL\n", __FILE__, __LINE__);
-			printf("%s\n", magic_error(cookie));
-			talloc_free(data.data);
-			mapi_object_release(&obj_stream);
-			return NULL;
 		}
-		if (magic_load(cookie, NULL) == -1) {
-			fprintf(stderr, "%s,%d - NULL\n", __FILE__, __LINE__);
-			printf("%s\n", magic_error(cookie));
-			talloc_free(data.data);
-			mapi_object_release(&obj_stream);
-			return NULL;
+		pending += read_size;
+
+		if (!header_done) {
+			if (!mime_tag) {
+				/* try and autodetect a mime magic string */
+				cookie = magic_open(MAGIC_MIME);
+				if (cookie == NULL || magic_load(cookie, NULL) == -1) {
+					fprintf(stderr, "%s,%d - NULL\n", __FILE__, __LINE__);
+					printf("%s\n", magic_error(cookie));
+					if (cookie) magic_close(cookie);
+					mapi_object_release(&obj_stream);
+					return false;
+				}
+				magic = talloc_strdup(mem_ctx, magic_buffer(cookie, (void *)buf, pending));
+				magic_close(cookie);
+				mime_tag = magic;
+			}
+
+			fprintf(fp, "\n\n--%s\n", boundary(base_level));
+			fprintf(fp, "Content-Disposition: attachment; filename=\"%s\"\n", attach_filename);
+			fprintf(fp, "Content-Type: %s\n", mime_tag);
+			fprintf(fp, "Content-Transfer-Encoding: base64\n\n");
+			talloc_free(magic);
+			header_done = true;
 		}
-		tmp = magic_buffer(cookie, (void *)data.data, data.length);
-		*magic = talloc_strdup(mem_ctx, tmp);
-		magic_close(cookie);
-	}
 
-	/* convert attachment to base64 */
-	ret = ldb_base64_encode(mem_ctx, (const char *)data.data, data.length);
+		/* encode whole lines only, the remainder goes with the next chunk */
+		encode_size = read_size ? pending - (pending % BASE64_LINE_BYTES) : pending;
+		if (encode_size) {
+			data = ldb_base64_encode(mem_ctx, (const char *)buf, encode_size);
+			if (data) {
+				write_base64_data(fp, data);
+				talloc_free(data);
+			}
+			memmove(buf, buf + encode_size, pending - encode_size);
+			pending -= encode_size;
+		}
+	} while (read_size);
 
-	talloc_free(data.data);
 	mapi_object_release(&obj_stream);
 
-	return ret;
-}
-
-
-#define WRAP_LINES_AT	76
-
-static void write_base64_data(FILE *fp, const char *buf)
-{
-	int len = strlen(buf);
-	size_t n;
-
-	while (len > 0) {
-		int chunk = len > WRAP_LINES_AT ? WRAP_LINES_AT : len;
-
-		n = fwrite(buf, len > WRAP_LINES_AT ? WRAP_LINES_AT : len, 1, fp);
-		if (n != 1)
-			fprintf(stderr, "Error writing %d bytes of base64 attachment: %d\n",
-				chunk, ferror(fp));
-		len -= chunk;
-		buf += chunk;
-		fwrite("\n", 1, 1, fp);
-	}
+	return (retval == MAPI_E_SUCCESS);
 }
 
 
@@ -551,17 +692,12 @@ static bool message2mbox(TALLOC_CTX *mem_ctx, FILE *fp,
 	const char			*msgid;
 	const char                      *msgheaders = NULL;
 	const char			*attach_filename;
-	const uint32_t			*attach_size;
-	char				*attachment_data;
 	const uint8_t			*has_attach = NULL;
 	const uint32_t			*attach_num = NULL;
-	char				*magic;
 	char				*line = NULL;
 	struct SPropTagArray		*SPropTagArray = NULL;
-	struct SPropValue		*lpProps;
 	struct SRow			aRow2;
 	struct SRowSet			rowset_attach;
-	uint32_t			count;
 	unsigned int			i;
 	int				header_done = 0;
 	body_stuff_t			body[3];
@@ -830,35 +966,29 @@ old_code:
 		mapi_object_init(&obj_tb_attach);
 		retval = GetAttachmentTable(obj_message, &obj_tb_attach);
 		if (retval == MAPI_E_SUCCESS) {
-			SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_ATTACH_NUM);
+			/* read the attachment properties with the table rows
+			 * rather than with a GetProps per attachment */
+			SPropTagArray = set_SPropTagArray(mem_ctx, 0x6,
+							  PR_ATTACH_NUM,
+							  PR_ATTACH_FILENAME_UNICODE,
+							  PR_ATTACH_LONG_FILENAME_UNICODE,
+							  PR_ATTACH_SIZE,
+							  PR_ATTACH_MIME_TAG_UNICODE,
+							  PR_ATTACH_METHOD);
 			retval = SetColumns(&obj_tb_attach, SPropTagArray);
 			MAPIFreeBuffer(SPropTagArray);
 			MAPI_RETVAL_IF(retval, retval, NULL);
 			
-			retval = QueryRows(&obj_tb_attach, 0xa, TBL_ADVANCE, &rowset_attach);
-			MAPI_RETVAL_IF(retval, retval, NULL);
-			
-			for (i = 0; i < rowset_attach.cRows; i++) {
-				//attach_num = (const uint32_t *)find_SPropValue_data(&(rowset_attach.aRow[i]), PR_ATTACH_NUM);
-				uint32_t n = rowset_attach.aRow[i].lpProps[0].value.l;
-				attach_num = &n;
-				retval = OpenAttach(obj_message, *attach_num, &obj_attach);
-				if (retval == MAPI_E_SUCCESS) {
-					SPropTagArray = set_SPropTagArray(mem_ctx, 0x5,
-									  PR_ATTACH_FILENAME,
-									  PR_ATTACH_LONG_FILENAME,
-									  PR_ATTACH_SIZE,
-									  PR_ATTACH_MIME_TAG,
-									  PR_ATTACH_METHOD);
-					lpProps = NULL;
-					retval = GetProps(&obj_attach, MAPI_UNICODE, SPropTagArray, &lpProps, &count);
-					MAPIFreeBuffer(SPropTagArray);
+			while ((retval = QueryRows(&obj_tb_attach, 0x100, TBL_ADVANCE, &rowset_attach)) == MAPI_E_SUCCESS && rowset_attach.cRows) {
+				for (i = 0; i < rowset_attach.cRows; i++) {
+					uint32_t n = rowset_attach.aRow[i].lpProps[0].value.l;
+					attach_num = &n;
+					mapi_object_init(&obj_attach);
+					retval = OpenAttach(obj_message, *attach_num, &obj_attach);
 					if (retval == MAPI_E_SUCCESS) {
 						uint32_t *mp, method = -1;
 
-						aRow2.ulAdrEntryPad = 0;
-						aRow2.cValues = count;
-						aRow2.lpProps = lpProps;
+						aRow2 = rowset_attach.aRow[i];
 
 						mp = (uint32_t *) octool_get_propval(&aRow2, PR_ATTACH_METHOD);
 						if (mp)
@@ -868,29 +998,15 @@ old_code:
 						if (!attach_filename || (attach_filename && !strcmp(attach_filename, ""))) {
 							attach_filename = get_filename(octool_get_propval(&aRow2, PR_ATTACH_FILENAME));
 						}
-						attach_size = (const uint32_t *) octool_get_propval(&aRow2, PR_ATTACH_SIZE);						
 
-						attachment_data = NULL;
 						switch (method) {
 						case ATTACH_BY_VALUE:
-							magic = (char *) octool_get_propval(&aRow2, PR_ATTACH_MIME_TAG);						
-							if (magic)
-								magic = talloc_strdup(mem_ctx, magic);
-							attachment_data = get_base64_attachment(mem_ctx,
-									&obj_attach, *attach_size,
-									magic ? NULL : &magic);
-							if (attachment_data == NULL) {
+							if (!write_base64_attachment(mem_ctx, fp, &obj_attach, attach_filename,
+										     (const char *) octool_get_propval(&aRow2, PR_ATTACH_MIME_TAG),
+										     base_level+0)) {
 								message_error = 1;
 								fprintf(stderr, "Failed to read attachment for message %s\n", msgid ? msgid : "unknown");
-								break;
 							}
-							fprintf(fp, "\n\n--%s\n", boundary(base_level+0));
-							fprintf(fp, "Content-Disposition: attachment; filename=\"%s\"\n", attach_filename);
-							fprintf(fp, "Content-Type: %s\n", magic);
-							fprintf(fp, "Content-Transfer-Encoding: base64\n\n");
-							write_base64_data(fp, attachment_data);
-							talloc_free(attachment_data);
-							talloc_free(magic);
 							break;
 						case ATTACH_BY_REFERENCE:
 							fprintf(stderr,"ATTACH_BY_REFERENCE unsupported\n");
@@ -965,6 +1081,7 @@ old_code:
 							message2mbox(mem_ctx, fp, &eRow, NULL, NULL, &obj_embeddedmsg,
 									base_level + 2 /* 0 = main, 1 = alt */);
 							talloc_free(embProps);
+							mapi_object_release(&obj_embeddedmsg);
 							} break;
 						case ATTACH_OLE:
 							fprintf(stderr,"ATTACH_OLE unsupported - "
@@ -976,10 +1093,11 @@ old_code:
 							message_error = 1;
 							break;
 						}
+						mapi_object_release(&obj_attach);
 					}
-					MAPIFreeBuffer(lpProps);
 				}
 			}
+			mapi_object_release(&obj_tb_attach);
 
 			line = talloc_asprintf(mem_ctx, "\n\n--%s--\n\n\n", boundary(base_level+0));
 			if (line) {
@@ -999,6 +1117,531 @@ old_code:
 
 
 
+/*
+ * Properties read on each exported message
+ */
+static struct SPropTagArray *message_properties(TALLOC_CTX *mem_ctx)
+{
+	return set_SPropTagArray(mem_ctx, 0x1c,
+				 PR_INTERNET_MESSAGE_ID,
+				 PR_INTERNET_MESSAGE_ID_UNICODE,
+				 PR_CONVERSATION_TOPIC,
+				 PR_CONVERSATION_TOPIC_UNICODE,
+				 PR_MESSAGE_DELIVERY_TIME,
+				 PR_MSG_EDITOR_FORMAT,
+				 PR_BODY,
+				 PR_BODY_UNICODE,
+				 PR_HTML,
+				 PR_RTF_COMPRESSED,
+				 PR_RTF_IN_SYNC,
+				 PR_SENT_REPRESENTING_NAME,
+				 PR_SENT_REPRESENTING_NAME_UNICODE,
+				 PR_DISPLAY_TO,
+				 PR_DISPLAY_TO_UNICODE,
+				 PR_DISPLAY_CC,
+				 PR_DISPLAY_CC_UNICODE,
+				 PR_DISPLAY_BCC,
+				 PR_DISPLAY_BCC_UNICODE,
+				 PR_HASATTACH,
+				 PR_TRANSPORT_MESSAGE_HEADERS,
+				 PR_SUBJECT_PREFIX,
+				 PR_SUBJECT_PREFIX_UNICODE,
+				 PR_NORMALIZED_SUBJECT,
+				 PR_NORMALIZED_SUBJECT_UNICODE,
+				 PR_SUBJECT,
+				 PR_SUBJECT_UNICODE,
+				 PR_ENTRYID);
+}
+
+/**
+ * Append messages to the mbox and record their Message-ID in the
+ * profile. Messages are opened and read EXPORT_BATCH_SIZE at a time,
+ * with a single round trip per batch.
+ *
+ * Returns false if any of the messages could not be exported
+ */
+static bool export_messages(TALLOC_CTX *mem_ctx, FILE *fp,
+			    struct mapi_profile *profile,
+			    mapi_object_t *obj_store,
+			    mapi_object_t *obj_folder,
+			    mapi_id_t id_folder,
+			    const mapi_id_t *id_messages,
+			    uint32_t count,
+			    struct msgid_index *known_msgids)
+{
+	struct mapi_batch	*batch;
+	struct SPropTagArray	*SPropTagArray;
+	mapi_object_t		obj_messages[EXPORT_BATCH_SIZE];
+	struct SPropValue	*lpProps[EXPORT_BATCH_SIZE];
+	uint32_t		prop_count[EXPORT_BATCH_SIZE];
+	enum MAPISTATUS		open_results[EXPORT_BATCH_SIZE];
+	enum MAPISTATUS		props_results[EXPORT_BATCH_SIZE];
+	struct SRow		aRow;
+	const char		*msgid;
+	uint32_t		first;
+	uint32_t		n;
+	uint32_t		i;
+	bool			ok;
+	bool			ret = true;
+
+	if (!count) return true;
+
+	batch = mapi_batch_init(mem_ctx, obj_store);
+	if (!batch) return false;
+
+	SPropTagArray = message_properties(mem_ctx);
+
+	for (first = 0; first < count; first += n) {
+		n = (count - first > EXPORT_BATCH_SIZE) ? EXPORT_BATCH_SIZE : (count - first);
+
+		for (i = 0; i < n; i++) {
+			mapi_object_init(&obj_messages[i]);
+			lpProps[i] = NULL;
+			prop_count[i] = 0;
+			open_results[i] = MAPI_E_CALL_FAILED;
+			props_results[i] = MAPI_E_CALL_FAILED;
+			if (mapi_batch_OpenMessage(batch, obj_store, id_folder, id_messages[first + i],
+						   &obj_messages[i], 0, &open_results[i]) == MAPI_E_SUCCESS) {
+				mapi_batch_GetProps(batch, &obj_messages[i], MAPI_UNICODE, SPropTagArray,
+						    &lpProps[i], &prop_count[i], &props_results[i]);
+			}
+		}
+		mapi_batch_dispatch(batch);
+
+		for (i = 0; i < n; i++) {
+			if (open_results[i] != MAPI_E_SUCCESS) {
+				fprintf(stderr, "could not open message 0x%"PRIx64": retval=0x%x\n",
+					id_messages[first + i], open_results[i]);
+				ret = false;
+				continue;
+			}
+
+			if (props_results[i] != MAPI_E_SUCCESS) {
+				fprintf(stderr, "Badness getting message 0x%"PRIx64" attrs\n", id_messages[first + i]);
+				ret = false;
+			} else {
+				/* Build a SRow structure */
+				aRow.ulAdrEntryPad = 0;
+				aRow.cValues = prop_count[i];
+				aRow.lpProps = lpProps[i];
+
+				msgid = (const char *) octool_get_propval(&aRow, PR_INTERNET_MESSAGE_ID);
+				if (!msgid) {
+					fprintf(stderr, "%s: message with no msgid cannot be downloaded\n", profile->profname);
+				} else if (msgid_index_find(known_msgids, msgid)) {
+					printf("Message-ID: %s already in profile %s\n", msgid, profile->profname);
+				} else {
+					message_error = 0;
+					ok = message2mbox(mem_ctx, fp, &aRow, obj_store, obj_folder, &obj_messages[i], 0);
+					if (!ok) {
+						printf("Message-ID: %s error, not added to %s\n", msgid, profile->profname);
+						ret = false;
+					} else if (message_error) {
+						printf("Message-ID: %s error, ignoring\n", msgid);
+						fprintf(stderr, "Message-ID: %s error, ignoring message (check with OWA if you can, will retry next time)\n", msgid);
+						ret = false;
+					} else if (opt_test) {
+						printf("Message-ID: %s saved but not updated in %s\n", msgid, profile->profname);
+					} else if
+					(mapi_profile_add_string_attr(profile->mapi_ctx, profile->profname, "Message-ID", msgid) != MAPI_E_SUCCESS) {
+						mapi_errstr("mapi_profile_add_string_attr", GetLastError());
+						ret = false;
+					} else {
+						msgid_index_add(known_msgids, msgid);
+						printf("Message-ID: %s added to profile %s\n", msgid, profile->profname);
+					}
+				}
+				MAPIFreeBuffer(lpProps[i]);
+			}
+			mapi_batch_Release(batch, &obj_messages[i]);
+			errno = 0;
+		}
+
+		/* release the whole batch in a single round trip */
+		mapi_batch_dispatch(batch);
+	}
+
+	MAPIFreeBuffer(SPropTagArray);
+	talloc_free(batch);
+
+	return ret;
+}
+
+/**
+ * Append the messages of the folder missing from the profile to the
+ * mbox, reading the Message-IDs from its contents table
+ */
+static bool table_export_messages(TALLOC_CTX *mem_ctx, FILE *fp,
+				  struct mapi_profile *profile,
+				  mapi_object_t *obj_store,
+				  mapi_object_t *obj_folder,
+				  mapi_id_t id_folder,
+				  struct msgid_index *known_msgids)
+{
+	enum MAPISTATUS		retval;
+	mapi_object_t		obj_table;
+	struct SPropTagArray	*SPropTagArray;
+	struct SRowSet		rowset;
+	mapi_id_t		id_messages[EXPORT_BATCH_SIZE];
+	const char		*msgid;
+	uint32_t		count;
+	uint32_t		i;
+	bool			ret = true;
+
+	mapi_object_init(&obj_table);
+	retval = GetContentsTable(obj_folder, &obj_table, 0, &count);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("GetContentsTable", retval);
+		return false;
+	}
+
+	SPropTagArray = set_SPropTagArray(mem_ctx, 0x5,
+					  PR_FID,
+					  PR_MID,
+					  PR_INST_ID,
+					  PR_INSTANCE_NUM,
+					  PR_INTERNET_MESSAGE_ID);
+	retval = SetColumns(&obj_table, SPropTagArray);
+	MAPIFreeBuffer(SPropTagArray);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("SetColumns", retval);
+		mapi_object_release(&obj_table);
+		return false;
+	}
+
+	while ((retval = QueryRows(&obj_table, EXPORT_BATCH_SIZE, TBL_ADVANCE, &rowset)) != MAPI_E_NOT_FOUND && rowset.cRows) {
+		/* only open the messages whose Message-ID is not known yet */
+		count = 0;
+		for (i = 0; i < rowset.cRows; i++) {
+			msgid = (const char *) octool_get_propval(&rowset.aRow[i], PR_INTERNET_MESSAGE_ID);
+			if (msgid && msgid_index_find(known_msgids, msgid)) {
+				printf("Message-ID: %s already in profile %s\n", msgid, profile->profname);
+				continue;
+			}
+			id_messages[count++] = rowset.aRow[i].lpProps[1].value.d;
+		}
+		if (!export_messages(mem_ctx, fp, profile, obj_store, obj_folder, id_folder,
+				     id_messages, count, known_msgids)) {
+			ret = false;
+		}
+		MAPIFreeBuffer(rowset.aRow);
+	}
+
+	mapi_object_release(&obj_table);
+
+	return ret;
+}
+
+/*
+ * ICS incremental download: the state reached by the last
+ * synchronization of a folder is kept in the profile, so that the
+ * server only sends the messages changed since then
+ */
+
+struct ics_state_prop {
+	uint32_t	tag;
+	DATA_BLOB	data;
+};
+
+struct ics_download {
+	TALLOC_CTX		*mem_ctx;
+	bool			in_state;
+	uint32_t		depth;		/* attachments and embedded messages */
+	mapi_id_t		*id_messages;
+	char			**msgids;
+	uint32_t		count;
+	uint32_t		size;
+	struct ics_state_prop	*state;
+	uint32_t		state_count;
+};
+
+static enum MAPISTATUS ics_marker(uint32_t marker, void *priv)
+{
+	struct ics_download	*download = priv;
+
+	switch (marker) {
+	case IncrSyncChg:
+		if (download->count == download->size) {
+			download->size = download->size ? download->size * 2 : 256;
+			download->id_messages = talloc_realloc(download->mem_ctx, download->id_messages,
+							       mapi_id_t, download->size);
+			download->msgids = talloc_realloc(download->mem_ctx, download->msgids,
+							  char *, download->size);
+			if (!download->id_messages || !download->msgids) {
+				return MAPI_E_NOT_ENOUGH_MEMORY;
+			}
+		}
+		download->id_messages[download->count] = 0;
+		download->msgids[download->count] = NULL;
+		download->count++;
+		download->depth = 0;
+		break;
+	case NewAttach:
+	case StartEmbed:
+		download->depth++;
+		break;
+	case EndAttach:
+	case EndEmbed:
+		if (download->depth) download->depth--;
+		break;
+	case IncrSyncStateBegin:
+		download->in_state = true;
+		break;
+	case IncrSyncStateEnd:
+		download->in_state = false;
+		break;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS ics_property(struct SPropValue prop, void *priv)
+{
+	struct ics_download	*download = priv;
+	struct ics_state_prop	*state;
+	uint32_t		tag = prop.ulPropTag;
+
+	if (download->in_state) {
+		/* some servers send MetaTagIdsetGiven with a binary type */
+		if ((tag >> 16) == (MetaTagIdsetGiven >> 16)) {
+			tag = MetaTagIdsetGiven;
+		}
+		if (tag != MetaTagIdsetGiven && tag != MetaTagCnsetSeen &&
+		    tag != MetaTagCnsetSeenFAI && tag != MetaTagCnsetRead) {
+			return MAPI_E_SUCCESS;
+		}
+
+		download->state = talloc_realloc(download->mem_ctx, download->state,
+						 struct ics_state_prop, download->state_count + 1);
+		if (!download->state) return MAPI_E_NOT_ENOUGH_MEMORY;
+
+		state = &download->state[download->state_count];
+		state->tag = tag;
+		state->data = data_blob_talloc(download->state, prop.value.bin.lpb, prop.value.bin.cb);
+		download->state_count++;
+		return MAPI_E_SUCCESS;
+	}
+
+	if (!download->count || download->depth) {
+		return MAPI_E_SUCCESS;
+	}
+
+	switch (tag) {
+	case PR_MID:
+		download->id_messages[download->count - 1] = prop.value.d;
+		break;
+	case PR_INTERNET_MESSAGE_ID_UNICODE:
+		download->msgids[download->count - 1] = talloc_strdup(download->mem_ctx, prop.value.lpszW);
+		break;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+ * Load the ICS state of a folder from the profile. The state is stored
+ * as a list of "tag:base64" words.
+ */
+static void ics_state_load(TALLOC_CTX *mem_ctx, struct mapi_profile *profile,
+			   mapi_id_t id_folder, struct ics_state_prop **state,
+			   uint32_t *state_count)
+{
+	enum MAPISTATUS		retval;
+	char			*attr;
+	char			**values = NULL;
+	unsigned int		count = 0;
+	char			*str;
+	char			*word;
+	char			*saveptr = NULL;
+	char			*data;
+	int			length;
+
+	*state = NULL;
+	*state_count = 0;
+
+	attr = talloc_asprintf(mem_ctx, ICS_STATE_ATTR, id_folder);
+	retval = GetProfileAttr(profile, attr, &count, &values);
+	talloc_free(attr);
+	if (retval != MAPI_E_SUCCESS || !count) {
+		return;
+	}
+
+	str = talloc_strdup(mem_ctx, values[0]);
+	talloc_free(values);
+
+	for (word = strtok_r(str, " ", &saveptr); word; word = strtok_r(NULL, " ", &saveptr)) {
+		data = strchr(word, ':');
+		if (!data) continue;
+		*data++ = '\0';
+
+		length = ldb_base64_decode(data);
+		if (length < 0) continue;
+
+		*state = talloc_realloc(mem_ctx, *state, struct ics_state_prop, *state_count + 1);
+		if (!*state) {
+			*state_count = 0;
+			break;
+		}
+		(*state)[*state_count].tag = strtoul(word, NULL, 16);
+		(*state)[*state_count].data = data_blob_talloc(*state, data, length);
+		(*state_count)++;
+	}
+
+	talloc_free(str);
+}
+
+static enum MAPISTATUS ics_state_save(TALLOC_CTX *mem_ctx, struct mapi_profile *profile,
+				      mapi_id_t id_folder, struct ics_state_prop *state,
+				      uint32_t state_count)
+{
+	enum MAPISTATUS		retval;
+	char			*attr;
+	char			*value;
+	char			*data;
+	uint32_t		i;
+
+	value = talloc_strdup(mem_ctx, "");
+	for (i = 0; i < state_count; i++) {
+		data = ldb_base64_encode(mem_ctx, (const char *)state[i].data.data, state[i].data.length);
+		value = talloc_asprintf_append(value, "%s%08x:%s", i ? " " : "", state[i].tag, data);
+		talloc_free(data);
+	}
+
+	attr = talloc_asprintf(mem_ctx, ICS_STATE_ATTR, id_folder);
+	retval = mapi_profile_modify_string_attr(profile->mapi_ctx, profile->profname, attr, value);
+	talloc_free(attr);
+	talloc_free(value);
+
+	return retval;
+}
+
+/**
+ * Configure an ICS contents synchronization of the folder from its
+ * stored state, and collect the IDs and Message-IDs of the changed
+ * messages along with the new state
+ */
+static enum MAPISTATUS ics_download_changes(TALLOC_CTX *mem_ctx,
+					    struct mapi_profile *profile,
+					    mapi_object_t *obj_folder,
+					    mapi_id_t id_folder,
+					    struct ics_download *download)
+{
+	enum MAPISTATUS			retval;
+	mapi_object_t			obj_sync_context;
+	struct SPropTagArray		*SPropTagArray;
+	struct fx_parser_context	*parser;
+	struct ics_state_prop		*state;
+	uint32_t			state_count;
+	DATA_BLOB			restriction;
+	DATA_BLOB			transfer_data;
+	enum TransferStatus		transfer_status;
+	uint16_t			progress;
+	uint16_t			total_steps;
+	uint32_t			i;
+
+	ics_state_load(mem_ctx, profile, id_folder, &state, &state_count);
+
+	/* only the Message-ID is needed, the messages are read afterwards */
+	mapi_object_init(&obj_sync_context);
+	SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_INTERNET_MESSAGE_ID_UNICODE);
+	restriction.length = 0;
+	restriction.data = NULL;
+	retval = ICSSyncConfigure(obj_folder, Contents, FastTransfer_Unicode,
+				  SynchronizationFlag_Unicode | SynchronizationFlag_Normal |
+				  SynchronizationFlag_NoDeletions | SynchronizationFlag_OnlySpecifiedProperties,
+				  Eid | Cn, restriction, SPropTagArray, &obj_sync_context);
+	MAPIFreeBuffer(SPropTagArray);
+	if (retval != MAPI_E_SUCCESS) goto end;
+
+	for (i = 0; i < state_count; i++) {
+		retval = ICSSyncUploadStateBegin(&obj_sync_context, (enum StateProperty) state[i].tag,
+						 state[i].data.length);
+		if (retval != MAPI_E_SUCCESS) goto end;
+		retval = ICSSyncUploadStateContinue(&obj_sync_context, state[i].data);
+		if (retval != MAPI_E_SUCCESS) goto end;
+		retval = ICSSyncUploadStateEnd(&obj_sync_context);
+		if (retval != MAPI_E_SUCCESS) goto end;
+	}
+
+	parser = fxparser_init(download->mem_ctx, download);
+	fxparser_set_marker_callback(parser, ics_marker);
+	fxparser_set_property_callback(parser, ics_property);
+
+	do {
+		retval = FXGetBuffer(&obj_sync_context, 0, &transfer_status, &progress, &total_steps, &transfer_data);
+		if (retval != MAPI_E_SUCCESS) break;
+		retval = fxparser_parse(parser, &transfer_data);
+		if (retval != MAPI_E_SUCCESS) break;
+	} while ((transfer_status == TransferStatus_Partial) || (transfer_status == TransferStatus_NoRoom));
+
+	talloc_free(parser);
+
+end:
+	mapi_object_release(&obj_sync_context);
+	talloc_free(state);
+
+	return retval;
+}
+
+/**
+ * Append the messages changed since the last synchronization to the
+ * mbox, then store the new synchronization state of the folder. The
+ * state is left untouched if a message could not be exported, so that
+ * it is retried next time.
+ */
+static bool ics_export_messages(TALLOC_CTX *mem_ctx, FILE *fp,
+				struct mapi_profile *profile,
+				mapi_object_t *obj_store,
+				mapi_object_t *obj_folder,
+				mapi_id_t id_folder,
+				struct msgid_index *known_msgids)
+{
+	enum MAPISTATUS		retval;
+	struct ics_download	*download;
+	mapi_id_t		*id_messages;
+	uint32_t		count = 0;
+	uint32_t		i;
+	bool			ret;
+
+	download = talloc_zero(mem_ctx, struct ics_download);
+	if (!download) return false;
+	download->mem_ctx = download;
+
+	retval = ics_download_changes(mem_ctx, profile, obj_folder, id_folder, download);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_errstr("ICS synchronization", retval);
+		talloc_free(download);
+		return false;
+	}
+	printf("[+] %u messages changed since the last synchronization\n", download->count);
+
+	id_messages = talloc_array(download, mapi_id_t, download->count + 1);
+	for (i = 0; i < download->count; i++) {
+		if (!download->id_messages[i]) continue;
+		if (download->msgids[i] && msgid_index_find(known_msgids, download->msgids[i])) {
+			printf("Message-ID: %s already in profile %s\n", download->msgids[i], profile->profname);
+			continue;
+		}
+		id_messages[count++] = download->id_messages[i];
+	}
+
+	ret = export_messages(mem_ctx, fp, profile, obj_store, obj_folder, id_folder,
+			      id_messages, count, known_msgids);
+	if (!ret) {
+		printf("[!] Synchronization state not saved, failed messages will be retried next time\n");
+	} else if (!opt_test && download->state_count) {
+		retval = ics_state_save(mem_ctx, profile, id_folder, download->state, download->state_count);
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_errstr("ics_state_save", retval);
+			ret = false;
+		}
+	}
+
+	talloc_free(download);
+
+	return ret;
+}
+
 int main(int argc, const char *argv[])
 {
 	TALLOC_CTX			*mem_ctx = NULL;
@@ -1008,29 +1651,22 @@ int main(int argc, const char *argv[])
 	struct mapi_profile		*profile = NULL;
 	mapi_object_t			obj_store;
 	mapi_object_t			obj_inbox;
-	mapi_object_t			obj_table;
-	mapi_object_t			obj_message;
 	mapi_id_t			id_inbox;
-	uint32_t			count;
-	struct SPropTagArray		*SPropTagArray = NULL;
-	struct SPropValue		*lpProps;
-	struct SRow			aRow;
-	struct SRowSet			rowset;
+	struct msgid_index		*known_msgids;
 	poptContext			pc;
 	int				opt;
 	FILE				*fp;
-	unsigned int			i;
 	const char			*opt_profdb = NULL;
 	char				*opt_profname = NULL;
 	const char			*opt_password = NULL;
 	const char			*opt_mbox = NULL;
 	bool				opt_update = false;
+	bool				opt_incremental = false;
 	bool				opt_dumpdata = false;
 	const char			*opt_debug = NULL;
-	const char			*msgid;
 
 	enum {OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_MBOX, OPT_UPDATE,
-	      OPT_DEBUG, OPT_DUMPDATA, OPT_TEST};
+	      OPT_INCREMENTAL, OPT_DEBUG, OPT_DUMPDATA, OPT_TEST};
 
 	struct poptOption long_options[] = {
 		POPT_AUTOHELP
@@ -1040,6 +1676,7 @@ int main(int argc, const char *argv[])
 		{"password", 'P', POPT_ARG_STRING, NULL, OPT_PASSWORD, "set the profile password", "PASSWORD"},
 		{"mbox", 'm', POPT_ARG_STRING, NULL, OPT_MBOX, "set the mbox file", "FILENAME"},
 		{"update", 'u', POPT_ARG_NONE, 0, OPT_UPDATE, "mirror mbox changes back to the Exchange server", NULL},
+		{"incremental", 'i', POPT_ARG_NONE, 0, OPT_INCREMENTAL, "only download the messages changed since the last run", NULL},
 		{"debuglevel", 'd', POPT_ARG_STRING, NULL, OPT_DEBUG, "set the debug level", "LEVEL"},
 		{"dump-data", 0, POPT_ARG_NONE, NULL, OPT_DUMPDATA, "dump the hex data", NULL},
 		POPT_OPENCHANGE_VERSION
@@ -1069,6 +1706,9 @@ int main(int argc, const char *argv[])
 		case OPT_UPDATE:
 			opt_update = true;
 			break;
+		case OPT_INCREMENTAL:
+			opt_incremental = true;
+			break;
 		case OPT_TEST:
 			opt_test = true;
 			break;
@@ -1164,107 +1804,20 @@ int main(int argc, const char *argv[])
 	retval = OpenFolder(&obj_store, id_inbox, &obj_inbox);
 	MAPI_RETVAL_IF(retval, retval, mem_ctx);
 
-	mapi_object_init(&obj_table);
-	retval = GetContentsTable(&obj_inbox, &obj_table, 0, &count);
-	MAPI_RETVAL_IF(retval, retval, mem_ctx);
-
-	SPropTagArray = set_SPropTagArray(mem_ctx, 0x5,
-					  PR_FID,
-					  PR_MID,
-					  PR_INST_ID,
-					  PR_INSTANCE_NUM,
-					  PR_INTERNET_MESSAGE_ID);
-	retval = SetColumns(&obj_table, SPropTagArray);
-	MAPIFreeBuffer(SPropTagArray);
-	MAPI_RETVAL_IF(retval, retval, mem_ctx);
-
-	while ((retval = QueryRows(&obj_table, 0xa, TBL_ADVANCE, &rowset)) != MAPI_E_NOT_FOUND && rowset.cRows) {
-		for (i = 0; i < rowset.cRows; i++) {
-			mapi_object_init(&obj_message);
-			retval = OpenMessage(&obj_store, 
-					     rowset.aRow[i].lpProps[0].value.d, 
-					     rowset.aRow[i].lpProps[1].value.d, 
-					     &obj_message, 0);
-			if (retval == MAPI_E_SUCCESS) {
-				SPropTagArray = set_SPropTagArray(mem_ctx, 0x1c,
-								  PR_INTERNET_MESSAGE_ID,
-								  PR_INTERNET_MESSAGE_ID_UNICODE,
-								  PR_CONVERSATION_TOPIC,
-								  PR_CONVERSATION_TOPIC_UNICODE,
-								  PR_MESSAGE_DELIVERY_TIME,
-								  PR_MSG_EDITOR_FORMAT,
-								  PR_BODY,
-								  PR_BODY_UNICODE,
-								  PR_HTML,
-								  PR_RTF_COMPRESSED,
-								  PR_RTF_IN_SYNC,
-								  PR_SENT_REPRESENTING_NAME,
-								  PR_SENT_REPRESENTING_NAME_UNICODE,
-								  PR_DISPLAY_TO,
-								  PR_DISPLAY_TO_UNICODE,
-								  PR_DISPLAY_CC,
-								  PR_DISPLAY_CC_UNICODE,
-								  PR_DISPLAY_BCC,
-								  PR_DISPLAY_BCC_UNICODE,
-								  PR_HASATTACH,
-								  PR_TRANSPORT_MESSAGE_HEADERS,
-								  PR_SUBJECT_PREFIX,
-								  PR_SUBJECT_PREFIX_UNICODE,
-								  PR_NORMALIZED_SUBJECT,
-								  PR_NORMALIZED_SUBJECT_UNICODE,
-								  PR_SUBJECT,
-								  PR_SUBJECT_UNICODE,
-								  PR_ENTRYID);
-				retval = GetProps(&obj_message, MAPI_UNICODE, SPropTagArray, &lpProps, &count);
-				MAPIFreeBuffer(SPropTagArray);
-				if (retval != MAPI_E_SUCCESS) {
-					fprintf(stderr, "Badness getting row %d attrs\n", i);
-					exit (1);
-				}
-
-				/* Build a SRow structure */
-				aRow.ulAdrEntryPad = 0;
-				aRow.cValues = count;
-				aRow.lpProps = lpProps;
+	/* Message-IDs already exported */
+	known_msgids = msgid_index_load(mem_ctx, profile);
+	if (!known_msgids) {
+		printf("Not enough memory to load the Message-IDs of %s\n", profile->profname);
+		exit (1);
+	}
 
-				msgid = (const char *) octool_get_propval(&aRow, PR_INTERNET_MESSAGE_ID);
-				if (msgid) {
-					retval = FindProfileAttr(profile, "Message-ID", msgid);
-					if (GetLastError() == MAPI_E_NOT_FOUND) {
-						bool ok;
-						
-						message_error = 0;
-						ok = message2mbox(mem_ctx, fp, &aRow, &obj_store, &obj_inbox, &obj_message, 0);
-						if (!ok) {
-							printf("Message-ID: %s error, not added to %s\n", msgid, profile->profname);
-						} else if (message_error) {
-							printf("Message-ID: %s error, ignoring\n", msgid);
-							fprintf(stderr, "Message-ID: %s error, ignoring message (check with OWA if you can, will retry next time)\n", msgid);
-						} else if (opt_test) {
-							printf("Message-ID: %s saved but not updated in %s\n", msgid, profile->profname);
-						} else if
-						(mapi_profile_add_string_attr(profile->mapi_ctx, profile->profname, "Message-ID", msgid) != MAPI_E_SUCCESS) {
-							mapi_errstr("mapi_profile_add_string_attr", GetLastError());
-						} else {
-							printf("Message-ID: %s added to profile %s\n", msgid, profile->profname);
-						}
-					} else {
-						printf("Message-ID: %s already in profile %s\n", msgid, profile->profname);
-					}
-				} else {
-					fprintf(stderr, "%s: message with no msgid cannot be downloaded\n", profile->profname);
-				}
-				talloc_free(lpProps);
-			} else {
-				fprintf(stderr, "could not open row %d: retval=%d GetLastError=%d\n", i, retval, GetLastError());
-			}
-			mapi_object_release(&obj_message);
-			errno = 0;
-		}
+	if (opt_incremental) {
+		ics_export_messages(mem_ctx, fp, profile, &obj_store, &obj_inbox, id_inbox, known_msgids);
+	} else {
+		table_export_messages(mem_ctx, fp, profile, &obj_store, &obj_inbox, id_inbox, known_msgids);
 	}
 
 	fclose(fp);
-	mapi_object_release(&obj_table);
 	mapi_object_release(&obj_inbox);
 	mapi_object_release(&obj_store);
 	MAPIUninitialize(mapi_ctx);
@@ -185,6 +185,7 @@ struct mt_common_tf_ctx
 #define	MAPITEST_ERROR		-1
 
 #define	MT_STREAM_MAX_SIZE	0x3000
+#define	MT_CHAINED_STREAM_SIZE	0x400000
 
 #define	MT_YES			"[yes]"
 #define	MT_NO			"[no]"
@@ -164,6 +164,7 @@ _PUBLIC_ uint32_t module_oxcmsg_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "OPEN-EMBEDDED-MESSAGE", "Open a message embedded in another message", mapitest_oxcmsg_OpenEmbeddedMessage);
 	mapitest_suite_add_test_flagged(suite, "GET-VALID-ATTACHMENTS", "Get valid attachment IDs for a message", mapitest_oxcmsg_GetValidAttachments, NotInExchange2010);
 	mapitest_suite_add_test(suite, "RELOAD-CACHED-INFORMATION", "Reload cached information for a message", mapitest_oxcmsg_ReloadCachedInformation);
+	mapitest_suite_add_test(suite, "BATCH-ROUND-TRIPS", "Round trips per message with and without ROP batching", mapitest_oxcmsg_BatchRoundTrips);
 
 	mapitest_suite_register(mt, suite);
 
@@ -300,6 +301,7 @@ _PUBLIC_ uint32_t module_oxcfxics_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "SYNC-CONFIGURE", "Configure ICS context for download", mapitest_oxcfxics_SyncConfigure);
 	mapitest_suite_add_test(suite, "SET-LOCAL-REPLICA-MIDSET-DELETED", "Reserve a range of local replica IDs", mapitest_oxcfxics_SetLocalReplicaMidsetDeleted);
 	mapitest_suite_add_test(suite, "SYNC-OPEN-COLLECTOR", "Test opening ICS upload collector", mapitest_oxcfxics_SyncOpenCollector);
+	mapitest_suite_add_test(suite, "CHAINED-BUFFERS", "Count the calls needed to download a large message with and without chained extended buffers", mapitest_oxcfxics_ChainedBuffers);
 
 	mapitest_suite_register(mt, suite);
 
@@ -405,10 +407,16 @@ _PUBLIC_ uint32_t module_noserver_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "LZFU-DECOMPRESS", "Test Compressed RTF decompression operations", mapitest_noserver_lzfu);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS", "Test Compressed RTF compression operations", mapitest_noserver_rtfcp);
 	mapitest_suite_add_test(suite, "LZFU-COMPRESS-LARGE", "Test RTF (de)compression operations on larger file", mapitest_noserver_rtfcp_large);
+	mapitest_suite_add_test(suite, "LZFU-BENCHMARK", "Measure RTF (de)compression throughput on sample files", mapitest_noserver_rtfcp_benchmark);
 	mapitest_suite_add_test(suite, "SROWSET", "Test SRowSet parsing", mapitest_noserver_srowset);
 	mapitest_suite_add_test(suite, "GETSETPROPS", "Test Property handling", mapitest_noserver_properties);
 	mapitest_suite_add_test(suite, "MAPIPROPS", "Test MAPI Property handling", mapitest_noserver_mapi_properties);
 	mapitest_suite_add_test(suite, "PROPTAGVALUE", "Test MAPI PropTag value handling", mapitest_noserver_proptagvalue);
+	mapitest_suite_add_test(suite, "HANDLES-BENCHMARK", "Measure MAPI handles resolution of a 1000 ROPs buffer", mapitest_noserver_handles_benchmark);
+	mapitest_suite_add_test(suite, "OPENCHANGEDB-BENCHMARK", "Measure openchangedb MySQL getters against text queries", mapitest_noserver_openchangedb_benchmark);
+	mapitest_suite_add_test(suite, "CUTMARKS-BENCHMARK", "Measure the FastTransfer cutmarks index against the linear walk", mapitest_noserver_cutmarks_benchmark);
+	mapitest_suite_add_test(suite, "PROPTAGS-BENCHMARK", "Measure property tag and named property lookups per second", mapitest_noserver_proptags_benchmark);
+	mapitest_suite_add_test(suite, "GAL-BENCHMARK", "Measure the NSPI GAL snapshot of a 50000 users directory", mapitest_noserver_gal_benchmark);
 
 	mapitest_suite_register(mt, suite);
 
@@ -509,6 +517,7 @@ _PUBLIC_ uint32_t module_lzxpress_init(struct mapitest *mt)
 	suite = mapitest_suite_init(mt, "LZXPRESS", "lzxpress algorithm test suite", false);
 
 	mapitest_suite_add_test_flagged(suite, "VALIDATE-001", "Validate LZXPRESS implementation using sample file 001", mapitest_lzxpress_validate_test_001, ExpectedFail);
+	mapitest_suite_add_test(suite, "BENCHMARK", "Measure LZXPRESS ratio and speed on sample files", mapitest_lzxpress_benchmark);
 
 	mapitest_suite_register(mt, suite);
 
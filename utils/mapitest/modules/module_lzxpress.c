@@ -149,3 +149,114 @@ _PUBLIC_ bool mapitest_lzxpress_validate_test_001(struct mapitest *mt)
 
 	return ret;
 }
+
+
+/**
+   \details Compare bytes on wire and CPU time spent per payload for
+   the LZXPRESS compressor against the captured Outlook payloads
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_lzxpress_benchmark(struct mapitest *mt)
+{
+	const char * const	samples[] = { "001_Outlook_2007_in_ModifyRecipients_comp.dat",
+					      "002_Outlook_2007_in_Tables_operations_comp.dat",
+					      NULL };
+	const uint32_t		iterations = 1000;
+	char			*filename;
+	DATA_BLOB		blob;
+	uint8_t			*data;
+	uint8_t			*comp;
+	uint8_t			*plain;
+	size_t			size;
+	struct ndr_pull		*ndr_pull;
+	struct ndr_push		*ndr_push;
+	struct EcDoRpcExt2	r;
+	struct mapi2k7_request	request;
+	enum ndr_err_code	ndr_err;
+	struct timeval		tv_start;
+	double			comp_usec;
+	double			decomp_usec;
+	ssize_t			comp_len = 0;
+	ssize_t			plain_len = -1;
+	uint32_t		i;
+	uint32_t		j;
+
+	for (i = 0; samples[i]; i++) {
+		/* Step 1. Load and decode the captured request */
+		filename = talloc_asprintf(mt->mem_ctx, "%s/%s", LZXPRESS_DATADIR, samples[i]);
+		data = (uint8_t *)file_load(filename, &size, 0, mt->mem_ctx);
+		talloc_free(filename);
+		if (!data) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Error while loading %s", samples[i]);
+			return false;
+		}
+		blob.data = data;
+		blob.length = size;
+
+		ndr_pull = ndr_pull_init_blob(&blob, mt->mem_ctx);
+		ndr_pull->flags |= LIBNDR_FLAG_REF_ALLOC;
+		ndr_err = ndr_pull_EcDoRpcExt2(ndr_pull, NDR_IN, &r);
+		talloc_free(ndr_pull);
+		if (ndr_err != NDR_ERR_SUCCESS) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Error while pulling %s", samples[i]);
+			return false;
+		}
+
+		blob.data = r.in.rgbIn;
+		blob.length = r.in.cbIn;
+		ndr_pull = ndr_pull_init_blob(&blob, mt->mem_ctx);
+		ndr_set_flags(&ndr_pull->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+		ndr_err = ndr_pull_mapi2k7_request(ndr_pull, NDR_SCALARS|NDR_BUFFERS, &request);
+		talloc_free(ndr_pull);
+		if (ndr_err != NDR_ERR_SUCCESS) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Error while decompressing %s", samples[i]);
+			return false;
+		}
+
+		ndr_push = ndr_push_init_ctx(mt->mem_ctx);
+		ndr_set_flags(&ndr_push->flags, LIBNDR_FLAG_NOALIGN);
+		ndr_push_mapi_request(ndr_push, NDR_SCALARS|NDR_BUFFERS, request.mapi_request);
+
+		comp = talloc_array(mt->mem_ctx, uint8_t, LZXPRESS_COMPRESS_BOUND(ndr_push->offset));
+		plain = talloc_array(mt->mem_ctx, uint8_t, ndr_push->offset);
+
+		/* Step 2. Time compression */
+		tv_start = timeval_current();
+		for (j = 0; j < iterations; j++) {
+			comp_len = lzxpress_compress_buffer(ndr_push->data, ndr_push->offset, comp,
+							    LZXPRESS_COMPRESS_BOUND(ndr_push->offset));
+		}
+		comp_usec = timeval_elapsed(&tv_start) * 1000000 / iterations;
+		if (comp_len < 0) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Compression of %s failed", samples[i]);
+			return false;
+		}
+
+		/* Step 3. Time decompression and check round trip */
+		tv_start = timeval_current();
+		for (j = 0; j < iterations; j++) {
+			plain_len = lzxpress_decompress_buffer(comp, comp_len, plain, ndr_push->offset);
+		}
+		decomp_usec = timeval_elapsed(&tv_start) * 1000000 / iterations;
+		if ((plain_len != ndr_push->offset) || memcmp(plain, ndr_push->data, plain_len)) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Round trip of %s failed", samples[i]);
+			return false;
+		}
+
+		mapitest_print(mt, "* %s\n", samples[i]);
+		mapitest_print(mt, "  plain: %d bytes, Outlook: %d bytes, OpenChange: %d bytes\n",
+			       ndr_push->offset, request.header.Size, (int)comp_len);
+		mapitest_print(mt, "  compression: %.2f usec/payload, decompression: %.2f usec/payload\n",
+			       comp_usec, decomp_usec);
+
+		talloc_free(comp);
+		talloc_free(plain);
+		talloc_free(ndr_push);
+		talloc_free(data);
+	}
+
+	return true;
+}
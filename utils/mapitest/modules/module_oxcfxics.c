@@ -761,3 +761,166 @@ cleanup:
 	return ret;
 }
 
+
+/**
+   \details Compare the number of EcDoRpcExt2 calls needed to download
+   a large message with FastTransferSourceGetBuffer (0x4E) with and
+   without chained extended buffers
+
+   This function:
+   -# Log on private message store and create the test folder
+   -# Write a 4MB PR_HTML stream to a test message
+   -# Download the message with FXCopyTo, using the default rgbOut
+      size (no chaining), then the largest one (chaining)
+   -# Report the number of calls per GB downloaded for each size and
+      check chaining needs fewer calls
+ */
+_PUBLIC_ bool mapitest_oxcfxics_ChainedBuffers(struct mapitest *mt)
+{
+	const uint32_t			sizes[] = { EMSMDB_RGBOUT_DEFAULT_SIZE, EMSMDB_RGBOUT_MAX_SIZE };
+	enum MAPISTATUS			retval;
+	struct mt_common_tf_ctx		*context;
+	mapi_object_t			obj_htable;
+	mapi_object_t			obj_stream;
+	mapi_object_t			obj_context;
+	struct SPropTagArray		*propsToExclude;
+	bool				ret = true;
+	enum TransferStatus		transferStatus;
+	uint16_t			progress;
+	uint16_t			totalSteps;
+	DATA_BLOB			data;
+	DATA_BLOB			transferdata;
+	char				*stream;
+	uint16_t			write_len;
+	uint32_t			offset;
+	uint32_t			calls[2];
+	uint32_t			calls_start;
+	uint32_t			calls_end;
+	uint64_t			bytes_start;
+	uint64_t			bytes_end;
+	uint64_t			downloaded;
+	uint32_t			i;
+
+	/* Logon */
+	if (! mapitest_common_setup(mt, &obj_htable, NULL)) {
+		return false;
+	}
+
+	context = mt->priv;
+	mapi_object_init(&obj_stream);
+	mapi_object_init(&obj_context);
+
+	/* Write a body large enough to need many buffers */
+	stream = mapitest_common_genblob(mt->mem_ctx, MT_CHAINED_STREAM_SIZE);
+	if (stream == NULL) {
+		ret = false;
+		goto cleanup;
+	}
+
+	retval = OpenStream(&(context->obj_test_msg[0]), PR_HTML, 2, &obj_stream);
+	mapitest_print_retval_clean(mt, "OpenStream", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+
+	retval = SetStreamSize(&obj_stream, MT_CHAINED_STREAM_SIZE);
+	mapitest_print_retval_clean(mt, "SetStreamSize", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+
+	for (offset = 0; offset < MT_CHAINED_STREAM_SIZE; offset += write_len) {
+		data.data = (uint8_t *)stream + offset;
+		data.length = MIN(MT_STREAM_MAX_SIZE, MT_CHAINED_STREAM_SIZE - offset);
+		retval = WriteStream(&obj_stream, &data, &write_len);
+		if (retval != MAPI_E_SUCCESS || !write_len) {
+			mapitest_print_retval_clean(mt, "WriteStream", retval);
+			ret = false;
+			goto cleanup;
+		}
+	}
+	talloc_free(stream);
+
+	retval = CommitStream(&obj_stream);
+	mapitest_print_retval_clean(mt, "CommitStream", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+	mapi_object_release(&obj_stream);
+	mapi_object_init(&obj_stream);
+
+	retval = SaveChangesMessage(&(context->obj_test_folder), &(context->obj_test_msg[0]), KeepOpenReadWrite);
+	mapitest_print_retval_clean(mt, "SaveChangesMessage", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+
+	propsToExclude = talloc_zero(mt->mem_ctx, struct SPropTagArray);
+	for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+		retval = emsmdb_set_max_rgbout(mt->session, sizes[i]);
+		mapitest_print_retval_clean(mt, "emsmdb_set_max_rgbout", retval);
+		if (retval != MAPI_E_SUCCESS) {
+			ret = false;
+			goto cleanup;
+		}
+
+		retval = FXCopyTo(&(context->obj_test_msg[0]), 0, 0, FastTransfer_Unicode, propsToExclude, &obj_context);
+		mapitest_print_retval_clean(mt, "FXCopyTo", retval);
+		if (retval != MAPI_E_SUCCESS) {
+			ret = false;
+			goto cleanup;
+		}
+
+		emsmdb_get_transaction_stats(mt->session, &calls_start, &bytes_start);
+		downloaded = 0;
+		do {
+			retval = FXGetBuffer(&obj_context, 0, &transferStatus, &progress, &totalSteps, &transferdata);
+			if (retval != MAPI_E_SUCCESS) {
+				mapitest_print_retval_clean(mt, "FXGetBuffer", retval);
+				ret = false;
+				goto cleanup;
+			}
+			downloaded += transferdata.length;
+			talloc_free(transferdata.data);
+		} while (transferStatus == TransferStatus_Partial);
+		emsmdb_get_transaction_stats(mt->session, &calls_end, &bytes_end);
+		calls[i] = calls_end - calls_start;
+
+		mapitest_print(mt, "* rgbOut 0x%.5x: %u calls for %llu bytes (%llu on wire), %.1f calls per GB\n",
+			       sizes[i], calls[i], (unsigned long long)downloaded,
+			       (unsigned long long)(bytes_end - bytes_start),
+			       downloaded ? (double)calls[i] * 1073741824.0 / downloaded : 0.0);
+
+		if (downloaded < MT_CHAINED_STREAM_SIZE) {
+			mapitest_print(mt, "* %-35s: [FAILURE]\n", "Downloaded the whole stream");
+			ret = false;
+			goto cleanup;
+		}
+
+		mapi_object_release(&obj_context);
+		mapi_object_init(&obj_context);
+	}
+
+	/* calls is 0 on EcDoRpc sessions, which cannot chain */
+	if (calls[0]) {
+		mapitest_print(mt, "* %-35s: %s\n", "Chaining saves calls",
+			       (calls[1] < calls[0]) ? "[PASSED]" : "[FAILURE]");
+		if (calls[1] >= calls[0]) {
+			ret = false;
+		}
+	}
+
+cleanup:
+	/* Cleanup and release */
+	emsmdb_set_max_rgbout(mt->session, EMSMDB_RGBOUT_DEFAULT_SIZE);
+	mapi_object_release(&obj_context);
+	mapi_object_release(&obj_stream);
+	mapi_object_release(&obj_htable);
+	mapitest_common_cleanup(mt);
+
+	return ret;
+}
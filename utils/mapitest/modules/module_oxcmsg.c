@@ -1694,3 +1694,134 @@ cleanup:
 
 	return ret;
 }
+
+
+/**
+   \details Measure the round trips needed to read messages, with and
+   without ROP batching
+
+   This function:
+   -# Logs on the private message store and creates the test messages
+   -# Opens each message, gets its properties and releases it, one
+      operation at a time
+   -# Does the same through a ROP batch
+   -# Reports the EcDoRpcExt2 calls made per message in each case
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_oxcmsg_BatchRoundTrips(struct mapitest *mt)
+{
+	enum MAPISTATUS		retval;
+	struct mt_common_tf_ctx	*context;
+	struct mapi_batch	*batch;
+	struct SPropTagArray	*SPropTagArray;
+	struct SPropValue	*lpProps;
+	mapi_object_t		obj_htable;
+	mapi_object_t		obj_message[10];
+	mapi_id_t		id_folder;
+	mapi_id_t		id_msgs[10];
+	uint32_t		count;
+	uint32_t		start, unbatched, batched;
+	uint32_t		rops, batch_transactions;
+	uint64_t		bytes;
+	uint32_t		i;
+	bool			ret = true;
+
+	/* Step 1. Logon and create the test messages */
+	if (! mapitest_common_setup(mt, &obj_htable, NULL)) {
+		return false;
+	}
+
+	context = mt->priv;
+	id_folder = mapi_object_get_id(&(context->obj_test_folder));
+	for (i = 0; i < 10; i++) {
+		id_msgs[i] = mapi_object_get_id(&(context->obj_test_msg[i]));
+		mapi_object_init(&obj_message[i]);
+	}
+	SPropTagArray = set_SPropTagArray(mt->mem_ctx, 0x3,
+					  PR_SUBJECT_UNICODE,
+					  PR_MESSAGE_FLAGS,
+					  PR_HASATTACH);
+
+	/* Only EcDoRpcExt2 calls are counted */
+	retval = emsmdb_get_transaction_stats(mt->session, &start, &bytes);
+	mapitest_print_retval_clean(mt, "emsmdb_get_transaction_stats", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+
+	/* Step 2. One operation at a time */
+	for (i = 0; i < 10; i++) {
+		retval = OpenMessage(&(context->obj_store), id_folder, id_msgs[i], &obj_message[i], 0);
+		if (retval != MAPI_E_SUCCESS) break;
+		retval = GetProps(&obj_message[i], MAPI_UNICODE, SPropTagArray, &lpProps, &count);
+		if (retval != MAPI_E_SUCCESS) break;
+		MAPIFreeBuffer(lpProps);
+		mapi_object_release(&obj_message[i]);
+		mapi_object_init(&obj_message[i]);
+	}
+	mapitest_print_retval_clean(mt, "OpenMessage, GetProps and Release", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		ret = false;
+		goto cleanup;
+	}
+	emsmdb_get_transaction_stats(mt->session, &unbatched, &bytes);
+	unbatched -= start;
+
+	/* Step 3. Through a ROP batch */
+	batch = mapi_batch_init(mt->mem_ctx, &(context->obj_store));
+	if (!batch) {
+		mapitest_print(mt, "* %-40s: unable to create the batch\n", "mapi_batch_init");
+		ret = false;
+		goto cleanup;
+	}
+	start += unbatched;
+	for (i = 0; i < 10; i++) {
+		retval = mapi_batch_OpenMessage(batch, &(context->obj_store), id_folder, id_msgs[i], &obj_message[i], 0, NULL);
+		if (retval != MAPI_E_SUCCESS) break;
+		retval = mapi_batch_GetProps(batch, &obj_message[i], MAPI_UNICODE, SPropTagArray, &lpProps, &count, NULL);
+		if (retval != MAPI_E_SUCCESS) break;
+		retval = mapi_batch_Release(batch, &obj_message[i]);
+		if (retval != MAPI_E_SUCCESS) break;
+	}
+	if (retval == MAPI_E_SUCCESS) {
+		retval = mapi_batch_dispatch(batch);
+	}
+	mapitest_print_retval_clean(mt, "mapi_batch_dispatch", retval);
+	if (retval != MAPI_E_SUCCESS) {
+		talloc_free(batch);
+		ret = false;
+		goto cleanup;
+	}
+	mapi_batch_get_stats(batch, &rops, &batch_transactions);
+	talloc_free(batch);
+	emsmdb_get_transaction_stats(mt->session, &batched, &bytes);
+	batched -= start;
+
+	/* Step 4. Report */
+	if (!unbatched) {
+		mapitest_print(mt, "* %-40s: not measured, the session does not use EcDoRpcExt2\n", "Round trips");
+		goto cleanup;
+	}
+	mapitest_print(mt, "* %-30s: %.2f round trips per message\n", "Without batching",
+		       (double)unbatched / 10);
+	mapitest_print(mt, "* %-30s: %.2f round trips per message (%u ROPs in %u calls)\n", "With batching",
+		       (double)batched / 10, rops, batch_transactions);
+	if (batched >= unbatched) {
+		mapitest_print(mt, "* %-40s: batching did not save any round trip\n", "Round trips");
+		ret = false;
+	}
+
+cleanup:
+	MAPIFreeBuffer(SPropTagArray);
+	for (i = 0; i < 10; i++) {
+		mapi_object_release(&obj_message[i]);
+	}
+	mapi_object_release(&obj_htable);
+	mapitest_common_cleanup(mt);
+
+	return ret;
+}
@@ -383,7 +383,7 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	TALLOC_CTX			*mem_ctx;
 	mapi_object_t			obj_tis;
 	mapi_object_t			obj_inbox;
-	mapi_object_t			obj_message;
+	mapi_object_t			*obj_messages;
 	mapi_object_t			obj_table;
 	mapi_object_t			obj_tb_attach;
 	mapi_object_t			obj_attach;
@@ -397,6 +397,12 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	const uint32_t			*attach_num;
 	const char			*attach_filename;
 	const uint32_t			*attach_size;
+	struct mapi_batch		*batch;
+	struct SPropValue		**message_props;
+	uint32_t			*message_props_count;
+	enum MAPISTATUS			*message_retvals;
+	enum MAPISTATUS			*props_retvals;
+	uint32_t			rops, transactions;
 	
 	mem_ctx = talloc_named(NULL, 0, "openchangeclient_fetchmail");
 
@@ -442,63 +448,86 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	MAPIFreeBuffer(SPropTagArray);
 	MAPI_RETVAL_IF(retval, retval, mem_ctx);
 
+	batch = mapi_batch_init(mem_ctx, obj_store);
+	MAPI_RETVAL_IF(!batch, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_HASATTACH);
+
 	while ((retval = QueryRows(&obj_table, count, TBL_ADVANCE, &rowset)) != MAPI_E_NOT_FOUND && rowset.cRows) {
 		count -= rowset.cRows;
+
+		/* Open the messages of the row set and fetch PR_HASATTACH in as few round trips as possible */
+		obj_messages = talloc_array(mem_ctx, mapi_object_t, rowset.cRows);
+		message_props = talloc_zero_array(mem_ctx, struct SPropValue *, rowset.cRows);
+		message_props_count = talloc_zero_array(mem_ctx, uint32_t, rowset.cRows);
+		message_retvals = talloc_array(mem_ctx, enum MAPISTATUS, rowset.cRows);
+		props_retvals = talloc_array(mem_ctx, enum MAPISTATUS, rowset.cRows);
 		for (i = 0; i < rowset.cRows; i++) {
-			mapi_object_init(&obj_message);
-			retval = OpenMessage(obj_store,
-					     rowset.aRow[i].lpProps[0].value.d,
-					     rowset.aRow[i].lpProps[1].value.d,
-					     &obj_message, 0);
-			if (GetLastError() == MAPI_E_SUCCESS) {
+			mapi_object_init(&obj_messages[i]);
+			message_retvals[i] = props_retvals[i] = MAPI_E_NOT_FOUND;
+		}
+		for (i = 0; i < rowset.cRows; i++) {
+			retval = mapi_batch_OpenMessage(batch, obj_store,
+							rowset.aRow[i].lpProps[0].value.d,
+							rowset.aRow[i].lpProps[1].value.d,
+							&obj_messages[i], 0, &message_retvals[i]);
+			if (retval != MAPI_E_SUCCESS) break;
+			if (!oclient->summary) {
+				mapi_batch_GetProps(batch, &obj_messages[i], 0, SPropTagArray,
+						    &message_props[i], &message_props_count[i], &props_retvals[i]);
+			}
+		}
+		mapi_batch_dispatch(batch);
+
+		for (i = 0; i < rowset.cRows; i++) {
+			if (message_retvals[i] == MAPI_E_SUCCESS) {
 				if (oclient->summary) {
-					mapidump_message_summary(&obj_message);
+					mapidump_message_summary(&obj_messages[i]);
 				} else {
-					struct SPropValue	*lpProps;
 					struct SRow		aRow;
 					
-					SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_HASATTACH);
-					lpProps = NULL;
-					retval = GetProps(&obj_message, 0, SPropTagArray, &lpProps, &count);
-					MAPIFreeBuffer(SPropTagArray);
-					if (retval != MAPI_E_SUCCESS) return retval;
-					
+					if (props_retvals[i] != MAPI_E_SUCCESS && props_retvals[i] != MAPI_W_ERRORS_RETURNED) {
+						talloc_free(mem_ctx);
+						return props_retvals[i];
+					}
+
 					aRow.ulAdrEntryPad = 0;
-					aRow.cValues = count;
-					aRow.lpProps = lpProps;
+					aRow.cValues = message_props_count[i];
+					aRow.lpProps = message_props[i];
 					
-					retval = octool_message(mem_ctx, &obj_message);
+					retval = octool_message(mem_ctx, &obj_messages[i]);
 					
 					has_attach = (const uint8_t *) get_SPropValue_SRow_data(&aRow, PR_HASATTACH);
 					
 					/* If we have attachments, retrieve them */
 					if (has_attach && *has_attach) {
 						mapi_object_init(&obj_tb_attach);
-						retval = GetAttachmentTable(&obj_message, &obj_tb_attach);
+						retval = GetAttachmentTable(&obj_messages[i], &obj_tb_attach);
 						if (retval == MAPI_E_SUCCESS) {
-							SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_ATTACH_NUM);
-							retval = SetColumns(&obj_tb_attach, SPropTagArray);
+							struct SPropTagArray	*SPropTagArray2;
+
+							SPropTagArray2 = set_SPropTagArray(mem_ctx, 0x1, PR_ATTACH_NUM);
+							retval = SetColumns(&obj_tb_attach, SPropTagArray2);
 							if (retval != MAPI_E_SUCCESS) return retval;
-							MAPIFreeBuffer(SPropTagArray);
+							MAPIFreeBuffer(SPropTagArray2);
 							
 							retval = QueryRows(&obj_tb_attach, 0xa, TBL_ADVANCE, &rowset_attach);
 							if (retval != MAPI_E_SUCCESS) return retval;
 							
 							for (j = 0; j < rowset_attach.cRows; j++) {
 								attach_num = (const uint32_t *)find_SPropValue_data(&(rowset_attach.aRow[j]), PR_ATTACH_NUM);
-								retval = OpenAttach(&obj_message, *attach_num, &obj_attach);
+								retval = OpenAttach(&obj_messages[i], *attach_num, &obj_attach);
 								if (retval == MAPI_E_SUCCESS) {
 									struct SPropValue	*lpProps2;
 									uint32_t		count2;
 									
-									SPropTagArray = set_SPropTagArray(mem_ctx, 0x4, 
-													  PR_ATTACH_FILENAME,
-													  PR_ATTACH_LONG_FILENAME,
-													  PR_ATTACH_SIZE,
-													  PR_ATTACH_CONTENT_ID);
+									SPropTagArray2 = set_SPropTagArray(mem_ctx, 0x4, 
+													   PR_ATTACH_FILENAME,
+													   PR_ATTACH_LONG_FILENAME,
+													   PR_ATTACH_SIZE,
+													   PR_ATTACH_CONTENT_ID);
 									lpProps2 = NULL;
-									retval = GetProps(&obj_attach, MAPI_UNICODE, SPropTagArray, &lpProps2, &count2);
-									MAPIFreeBuffer(SPropTagArray);
+									retval = GetProps(&obj_attach, MAPI_UNICODE, SPropTagArray2, &lpProps2, &count2);
+									MAPIFreeBuffer(SPropTagArray2);
 									if (retval != MAPI_E_SUCCESS) return retval;
 									
 									aRow.ulAdrEntryPad = 0;
@@ -525,13 +554,27 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 							}
 							errno = 0;
 						}
-						MAPIFreeBuffer(lpProps);
 					}
+					MAPIFreeBuffer(message_props[i]);
 				}
 			}
-			mapi_object_release(&obj_message);
+			if (message_retvals[i] == MAPI_E_SUCCESS) {
+				mapi_batch_Release(batch, &obj_messages[i]);
+			}
 		}
+		mapi_batch_dispatch(batch);
+
+		talloc_free(obj_messages);
+		talloc_free(message_props);
+		talloc_free(message_props_count);
+		talloc_free(message_retvals);
+		talloc_free(props_retvals);
 	}
+
+	mapi_batch_get_stats(batch, &rops, &transactions);
+	DEBUG(3, ("fetchmail: %u ROPs sent in %u batched round trips\n", rops, transactions));
+	MAPIFreeBuffer(SPropTagArray);
+
  end:
 	mapi_object_release(&obj_table);
 	mapi_object_release(&obj_inbox);
@@ -0,0 +1,178 @@
+/*
+   Generate the OpenChange offline address book
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+#include <popt.h>
+#include <param.h>
+#include <util/debug.h>
+
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+/**
+   Retrieve the name of the Exchange organization the way provisioning
+   records it
+ */
+static const char *oabgen_get_organization(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx)
+{
+	const char * const	attrs[] = { "name", NULL };
+	struct ldb_result	*res = NULL;
+	int			ret;
+
+	ret = ldb_search(emsabp_ctx->samdb_ctx, mem_ctx, &res, ldb_get_config_basedn(emsabp_ctx->samdb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=msExchOrganizationContainer)");
+	if (ret != LDB_SUCCESS || res->count != 1) {
+		return NULL;
+	}
+
+	return ldb_msg_find_attr_as_string(res->msgs[0], "name", NULL);
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX			*mem_ctx;
+	struct loadparm_context		*lp_ctx;
+	struct emsabp_context		*emsabp_ctx;
+	struct emsabp_oab_stats		stats;
+	enum MAPISTATUS			retval;
+	poptContext			pc;
+	int				opt;
+	const char			*opt_debug = NULL;
+	const char			*opt_output = NULL;
+	const char			*opt_organization = NULL;
+	uint32_t			opt_interval = 0;
+
+	enum {
+		OPT_DEBUG = 1000,
+		OPT_OUTPUT,
+		OPT_ORGANIZATION,
+		OPT_INTERVAL
+	};
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "debuglevel",		'd', POPT_ARG_STRING, NULL, OPT_DEBUG,		"set the debug level", NULL },
+		{ "output",		'o', POPT_ARG_STRING, NULL, OPT_OUTPUT,		"directory the offline address book is written to", NULL },
+		{ "organization",	0, POPT_ARG_STRING, NULL, OPT_ORGANIZATION,	"Exchange organization name", NULL },
+		{ "interval",		0, POPT_ARG_STRING, NULL, OPT_INTERVAL,		"generate every SECONDS instead of once", "SECONDS" },
+		{ NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	mem_ctx = talloc_named(NULL, 0, "openchangeoabgen");
+
+	pc = poptGetContext("openchangeoabgen", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_DEBUG:
+			opt_debug = poptGetOptArg(pc);
+			break;
+		case OPT_OUTPUT:
+			opt_output = poptGetOptArg(pc);
+			break;
+		case OPT_ORGANIZATION:
+			opt_organization = poptGetOptArg(pc);
+			break;
+		case OPT_INTERVAL:
+			opt_interval = strtoul(poptGetOptArg(pc), NULL, 10);
+			break;
+		}
+	}
+
+	/* Initialize configuration */
+	lp_ctx = loadparm_init(mem_ctx);
+	if (opt_debug) {
+		lpcfg_set_cmdline(lp_ctx, "log level", opt_debug);
+	}
+	lpcfg_load_default(lp_ctx);
+
+	if (!opt_output) {
+		opt_output = lpcfg_parm_string(lp_ctx, NULL, "dcerpc_mapiproxy", "oab_path");
+	}
+
+	/**
+	 * Sanity checks
+	 */
+
+	if (!opt_output) {
+		poptPrintUsage(pc, stderr, 0);
+		talloc_free(mem_ctx);
+		return 1;
+	}
+
+	emsabp_ctx = emsabp_init(lp_ctx, NULL);
+	if (!emsabp_ctx) {
+		fprintf(stderr, "Failed to initialize the address book provider\n");
+		talloc_free(mem_ctx);
+		return 1;
+	}
+
+	if (!opt_organization) {
+		opt_organization = oabgen_get_organization(mem_ctx, emsabp_ctx);
+	}
+	if (!opt_organization) {
+		fprintf(stderr, "Unable to find the Exchange organization, use --organization\n");
+		emsabp_destructor(emsabp_ctx);
+		talloc_free(mem_ctx);
+		return 1;
+	}
+	emsabp_ctx->organization_name = opt_organization;
+
+	while (true) {
+		retval = emsabp_oab_generate(emsabp_ctx, opt_output, &stats);
+		if (retval != MAPI_E_SUCCESS) {
+			fprintf(stderr, "Offline address book generation failed: %s\n", mapi_get_errstr(retval));
+			if (!opt_interval) break;
+		} else {
+			printf("Offline address book %u: %u records, %u added, %u modified, %u deleted\n",
+			       stats.sequence, stats.records, stats.added, stats.modified, stats.deleted);
+			fflush(stdout);
+		}
+
+		if (!opt_interval) break;
+		sleep(opt_interval);
+	}
+
+	emsabp_destructor(emsabp_ctx);
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return (retval == MAPI_E_SUCCESS) ? 0 : 1;
+}